@@ -190,6 +190,53 @@ public:
 	 */
 	virtual uint64_t			getBoundaryTime(const char* stdPID, uint32_t tDate, bool isSession = false, bool isStart = true) = 0;  // 纯虚函数：获取边界时间
 
+	/**
+	 * @brief 获取之后第days个交易日
+	 * @param pid 品种代码，isTpl为true时为节假日模板ID
+	 * @param uDate 基准日期，格式为YYYYMMDD
+	 * @param days 交易日数，默认为1
+	 * @param isTpl 是否直接使用节假日模板，默认为false
+	 * @return uint32_t 返回交易日，格式为YYYYMMDD
+	 * 
+	 * 日历区间内直接查预计算的交易日历，区间以外逐日计算。
+	 * 纯虚函数，子类必须实现。
+	 */
+	virtual uint32_t			getNextTDate(const char* pid, uint32_t uDate, int days = 1, bool isTpl = false) = 0;  // 纯虚函数：获取之后的交易日
+
+	/**
+	 * @brief 获取之前第days个交易日
+	 * @param pid 品种代码，isTpl为true时为节假日模板ID
+	 * @param uDate 基准日期，格式为YYYYMMDD
+	 * @param days 交易日数，默认为1
+	 * @param isTpl 是否直接使用节假日模板，默认为false
+	 * @return uint32_t 返回交易日，格式为YYYYMMDD
+	 * 
+	 * 纯虚函数，子类必须实现。
+	 */
+	virtual uint32_t			getPrevTDate(const char* pid, uint32_t uDate, int days = 1, bool isTpl = false) = 0;  // 纯虚函数：获取之前的交易日
+
+	/**
+	 * @brief 获取两个日期之间的交易日数
+	 * @param pid 品种代码，isTpl为true时为节假日模板ID
+	 * @param uBeginDate 开始日期，格式为YYYYMMDD
+	 * @param uEndDate 结束日期，格式为YYYYMMDD
+	 * @param isTpl 是否直接使用节假日模板，默认为false
+	 * @return uint32_t 返回[uBeginDate, uEndDate]之间的交易日数
+	 * 
+	 * 纯虚函数，子类必须实现。
+	 */
+	virtual uint32_t			getTradingDays(const char* pid, uint32_t uBeginDate, uint32_t uEndDate, bool isTpl = false) = 0;  // 纯虚函数：获取区间内的交易日数
+
+	/**
+	 * @brief 设置交易日历的预计算区间
+	 * @param uBeginDate 开始日期，格式为YYYYMMDD
+	 * @param uEndDate 结束日期，格式为YYYYMMDD
+	 * 
+	 * 对应配置项basefiles.calendar的begin和end，区间以外的日期按逐日计算。
+	 * 纯虚函数，子类必须实现。
+	 */
+	virtual void				setCalendarRange(uint32_t uBeginDate, uint32_t uEndDate) = 0;  // 纯虚函数：设置交易日历区间
+
 	/**
 	 * @brief 获取合约数量
 	 * @param exchg 交易所代码，默认为空字符串（所有交易所）
@@ -157,6 +157,17 @@ public:
 	 */
 	virtual void on_bactest_end() {};  // 虚函数：回测结束事件回调，默认实现为空
 
+	/**
+	 * @brief 主备接管时恢复状态
+	 * @param rtype 状态类型，见ShmStandby.hpp中的StandbyRecordType
+	 * @param data 主进程镜像的状态数据
+	 * @param len 数据长度
+	 * 
+	 * 备进程接管交易时，用主进程最后写入的状态覆盖本地状态。
+	 * 默认实现为空，子类可以重写此函数。
+	 */
+	virtual void restore_state(uint32_t rtype, const char* data, std::size_t len) {}  // 虚函数：恢复镜像状态，默认实现为空
+
 	/**
 	 * @brief 重算完成回调
 	 * @param curDate 当前日期
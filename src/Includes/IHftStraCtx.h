@@ -32,6 +32,7 @@ class WTSTickSlice;  // 前向声明：WTS Tick切片类
 class WTSKlineSlice;  // 前向声明：WTS K线切片类
 class WTSTickData;  // 前向声明：WTS Tick数据类
 struct WTSBarStruct;  // 前向声明：WTS K线结构体
+struct WTSOptGreeksStruct;  // 前向声明：期权希腊字母快照结构体
 
 /**
  * @brief 订单标记常量定义
@@ -183,6 +184,17 @@ public:
 	 */
 	virtual void on_bactest_end() {};  // 虚函数：回测结束事件回调，默认实现为空
 
+	/**
+	 * @brief 主备接管时恢复状态
+	 * @param rtype 状态类型，见ShmStandby.hpp中的StandbyRecordType
+	 * @param data 主进程镜像的状态数据
+	 * @param len 数据长度
+	 * 
+	 * 备进程接管交易时，用主进程最后写入的状态覆盖本地状态。
+	 * 默认实现为空，子类可以重写此函数。
+	 */
+	virtual void restore_state(uint32_t rtype, const char* data, std::size_t len) {}  // 虚函数：恢复镜像状态，默认实现为空
+
 	/**
 	 * @brief Tick数据更新回调
 	 * @param stdCode 标准合约代码
@@ -246,6 +258,19 @@ public:
 	 */
 	virtual OrderIDs	stra_cancel(const char* stdCode, bool isBuy, double qty) = 0;  // 纯虚函数：撤销指定合约和方向的订单
 
+	/**
+	 * @brief 修改指定本地ID的订单
+	 * @param localid 本地订单ID
+	 * @param price 新的委托价格，0表示市价单
+	 * @param qty 新的剩余数量
+	 * @return uint32_t 改单以后的本地订单ID，失败返回0
+	 * 
+	 * 该函数修改在途订单的价格和数量。
+	 * 交易通道支持原生改单的，订单ID不变；不支持的，先撤单再重新下单，返回新的订单ID。
+	 * 纯虚函数，子类必须实现。
+	 */
+	virtual uint32_t	stra_modify(uint32_t localid, double price, double qty) = 0;  // 纯虚函数：修改指定本地ID的订单
+
 	/**
 	 * @brief 买入下单接口
 	 * @param stdCode 合约代码
@@ -410,6 +435,21 @@ public:
 	 */
 	virtual WTSTickData*	stra_get_last_tick(const char* stdCode) = 0;  // 纯虚函数：获取最新Tick数据
 
+	/**
+	 * @brief 获取期权的隐含波动率和希腊字母
+	 * @param stdCode 期权标准合约代码
+	 * @return 引擎内的快照，不需要释放，未启用希腊字母服务或者不是配置的期权时返回NULL
+	 */
+	virtual const WTSOptGreeksStruct* stra_get_greeks(const char* stdCode) { return NULL; }
+
+	/**
+	 * @brief 获取整条期权链的隐含波动率和希腊字母
+	 * @param underlying 标的标准代码
+	 * @param count 返回期权链的合约数
+	 * @return 连续存放的快照表首地址，不需要释放
+	 */
+	virtual const WTSOptGreeksStruct* stra_get_greeks_chain(const char* underlying, uint32_t& count) { count = 0; return NULL; }
+
 	/**
 	 * @brief 获取分月合约代码
 	 * @param stdCode 标准合约代码
@@ -230,6 +230,23 @@ public:
 	 * 默认实现为空，子类可以重写此函数。
 	 */
 	virtual void registerSpi(IParserSpi* spi) {}  // 虚函数：注册回调接口，默认实现为空
+
+	/**
+	 * @brief 切换到轮询模式
+	 * @return bool 支持轮询模式返回true
+	 * 
+	 * 要在connect之前调用，切换成功以后解析模块不再启动自己的接收线程，
+	 * 所有回调都在调用poll的线程里同步触发。默认不支持，返回false。
+	 */
+	virtual bool enablePolling() { return false; }  // 虚函数：切换到轮询模式，默认不支持
+
+	/**
+	 * @brief 轮询一次
+	 * @return uint32_t 本次处理的数据条数
+	 * 
+	 * 处理当前已经到达的数据，不阻塞，没有数据立即返回0。
+	 */
+	virtual uint32_t poll() { return 0; }  // 虚函数：轮询一次，默认返回0
 };
 
 NS_WTP_END  // 结束WonderTrader命名空间
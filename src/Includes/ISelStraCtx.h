@@ -117,6 +117,12 @@ public:
 	 */
 	virtual void on_bactest_end() {};
 
+	/**
+	 * @brief 主备接管时恢复状态
+	 * 用主进程最后写入的状态覆盖本地状态，rtype见StandbyRecordType
+	 */
+	virtual void restore_state(uint32_t rtype, const char* data, std::size_t len) {}
+
 	/**
 	 * @brief K线闭合回调
 	 * @param stdCode 标准化合约代码
@@ -322,6 +322,21 @@ public:
 	 */
 	virtual bool isConnected() { return false; }
 
+	/**
+	 * @brief 切换到轮询模式
+	 * @return 支持轮询模式返回true
+	 * 
+	 * 要在connect之前调用，切换成功以后交易模块不再启动自己的工作线程，
+	 * 所有回报都在调用poll的线程里同步触发
+	 */
+	virtual bool enablePolling() { return false; }
+
+	/**
+	 * @brief 轮询一次，处理已经到达的回报，不阻塞
+	 * @return 本次处理的事件数
+	 */
+	virtual uint32_t poll() { return 0; }
+
 	/**
 	 * @brief 生成委托单号
 	 * @param buffer 缓冲区指针
@@ -352,6 +367,25 @@ public:
 	 */
 	virtual int orderInsert(WTSEntrust* eutrust) { return -1; }
 
+	/**
+	 * @brief 预置下单模板
+	 * @details 合约、方向、开平、价格类型、订单标志等静态字段在这里一次性转换成通道的委托结构，
+	 *          下单的时候只需要填价格、数量和用户标记，要在下单线程里调用
+	 * @param entrust 模板委托，价格和数量忽略
+	 * @return 模板编号，不支持或者失败返回0，调用方退回到orderInsert
+	 */
+	virtual uint32_t stageOrder(WTSEntrust* entrust) { return 0; }
+
+	/**
+	 * @brief 按预置模板下单
+	 * @param stageid stageOrder返回的模板编号
+	 * @param price 委托价格
+	 * @param qty 委托数量
+	 * @param userTag 用户标记，回报通过用户标记对应到本地订单
+	 * @return 下单结果，成功返回0，失败返回负值
+	 */
+	virtual int orderInsertStaged(uint32_t stageid, double price, double qty, const char* userTag) { return -1; }
+
 	/**
 	 * @brief 订单操作接口
 	 * @param action 操作的具体数据结构
@@ -359,6 +393,22 @@ public:
 	 */
 	virtual int orderAction(WTSEntrustAction* action) { return -1; }
 
+	/**
+	 * @brief 是否支持原生改单
+	 * @details 不支持原生改单的通道，由上层通过先撤单再下单的方式模拟
+	 * @return 支持返回true，否则返回false
+	 */
+	virtual bool isModifySupported() { return false; }
+
+	/**
+	 * @brief 改单接口
+	 * @details 修改在途订单的价格和数量，新的价格和数量通过action的getNewPrice和getNewVolume获取
+	 *          新数量为修改后的剩余数量，订单号保持不变，修改结果通过onPushOrder回报
+	 * @param action 操作的具体数据结构，操作标志为WAF_MODIFY
+	 * @return 操作结果，成功返回0，失败返回负值
+	 */
+	virtual int orderModify(WTSEntrustAction* action) { return -1; }
+
 	/**
 	 * @brief 查询账户信息
 	 * @return 查询结果，成功返回0，失败返回负值
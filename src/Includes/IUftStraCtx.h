@@ -32,6 +32,7 @@ class WTSTickSlice;          // Tick数据切片类
 class WTSKlineSlice;         // K线数据切片类
 class WTSTickData;           // Tick数据结构
 struct WTSBarStruct;         // K线数据结构
+struct WTSOptGreeksStruct;   // 期权希腊字母快照
 
 /**
  * @brief 订单标记常量定义
@@ -140,6 +141,12 @@ public:
 	 */
 	virtual void	on_bactest_end() {};
 
+	/**
+	 * @brief 主备接管时恢复状态
+	 * 用主进程最后写入的状态覆盖本地状态，rtype见StandbyRecordType
+	 */
+	virtual void	restore_state(uint32_t rtype, const char* data, std::size_t len) {}
+
 	/**
 	 * @brief Tick数据更新回调
 	 * @param stdCode 标准化合约代码
@@ -359,6 +366,16 @@ public:
 	 */
 	virtual OrderIDs	stra_cancel_all(const char* stdCode) = 0;
 
+	/**
+	 * @brief 改单接口
+	 * @details 交易通道支持原生改单的，订单号不变；不支持的，先撤单再重新下单，返回新的订单号
+	 * @param localid 本地单号
+	 * @param price 新的委托价格，0则是市价单
+	 * @param qty 新的剩余数量
+	 * @return 改单以后的本地单号，失败返回0
+	 */
+	virtual uint32_t	stra_modify(uint32_t localid, double price, double qty) = 0;
+
 	/**
 	 * @brief 买入下单接口
 	 * @param stdCode 合约代码
@@ -421,6 +438,28 @@ public:
 	 */
 	virtual uint32_t	stra_exit_short(const char* stdCode, double price, double qty, bool isToday = false, int flag = 0) { return 0; }
 
+	/**
+	 * @brief 预置下单模板
+	 * @details 合约、方向、开平和订单标志提前解析好，下单的时候只需要填价格和数量，
+	 *          适合在on_init里把要反复下单的合约和方向都预置好
+	 * @param stdCode 代码，格式如SHFE.rb2205
+	 * @param isLong 多头还是空头
+	 * @param isOpen 开仓还是平仓
+	 * @param isToday 平仓时是否平今，SHFE、INE专用
+	 * @param flag 下单标志: 0-normal，1-fak，2-fok，默认0
+	 * @return 模板编号，失败返回0
+	 */
+	virtual uint32_t	stra_stage_order(const char* stdCode, bool isLong, bool isOpen, bool isToday = false, int flag = 0) { return 0; }
+
+	/**
+	 * @brief 按预置模板下单
+	 * @param stageid stra_stage_order返回的模板编号
+	 * @param price 委托价格，0则退回到普通下单
+	 * @param qty 下单数量
+	 * @return 本地订单ID
+	 */
+	virtual uint32_t	stra_send_staged(uint32_t stageid, double price, double qty) { return 0; }
+
 	/**
 	 * @brief 获取品种信息
 	 * @param stdCode 代码，格式如SSE.600000
@@ -476,6 +515,21 @@ public:
 	 */
 	virtual WTSTickData*	stra_get_last_tick(const char* stdCode) = 0;
 
+	/**
+	 * @brief 获取期权的隐含波动率和希腊字母
+	 * @param stdCode 期权代码
+	 * @return 引擎内的快照，不需要释放，未启用希腊字母服务时返回NULL
+	 */
+	virtual const WTSOptGreeksStruct* stra_get_greeks(const char* stdCode) { return NULL; }
+
+	/**
+	 * @brief 获取整条期权链的隐含波动率和希腊字母
+	 * @param underlying 标的代码
+	 * @param count 期权链的合约数
+	 * @return 连续存放的快照表首地址，不需要释放
+	 */
+	virtual const WTSOptGreeksStruct* stra_get_greeks_chain(const char* underlying, uint32_t& count) { count = 0; return NULL; }
+
 	/**
 	 * @brief 获取持仓
 	 * @param stdCode 代码，格式如SSE.600000
@@ -227,6 +227,15 @@ public:
 		return (m_ccCategory == CC_FutOption || m_ccCategory == CC_ETFOption || m_ccCategory == CC_SpotOption);
 	}
 
+	/**
+	 * @brief 是否为期货期权
+	 * @return 是期货期权返回true，否则返回false
+	 */
+	inline bool isFutOption() const
+	{
+		return m_ccCategory == CC_FutOption;
+	}
+
 	/**
 	 * @brief 检查是否为期货
 	 * @return 是期货返回true，否则返回false
@@ -448,6 +457,19 @@ public:
 		m_expireDate = expireDate;
 	}
 
+	/**
+	 * @brief 设置期权信息
+	 * @param optType 期权类型
+	 * @param underlying 标的合约代码
+	 * @param strikePrice 行权价
+	 */
+	inline void setOptionInfo(OptionType optType, const char* underlying, double strikePrice)
+	{
+		m_optType = optType;
+		m_strUnderlying = underlying;
+		m_dStrikePrice = strikePrice;
+	}
+
 	/**
 	 * @brief 设置保证金比例
 	 * @param longRatio 多头保证金比例
@@ -533,6 +555,24 @@ public:
 	 */
 	inline uint32_t	getExpireDate() const { return m_expireDate; }
 
+	/**
+	 * @brief 获取期权类型
+	 * @return 期权类型，非期权为OT_None
+	 */
+	inline OptionType	getOptionType() const { return m_optType; }
+
+	/**
+	 * @brief 获取期权标的合约代码
+	 * @return 标的合约代码，不带交易所
+	 */
+	inline const char*	getUnderlying() const { return m_strUnderlying.c_str(); }
+
+	/**
+	 * @brief 获取期权行权价
+	 * @return 行权价
+	 */
+	inline double	getStrikePrice() const { return m_dStrikePrice; }
+
 	/**
 	 * @brief 获取多头保证金比例
 	 * @return 多头保证金比例
@@ -702,6 +742,7 @@ protected:
 	 */
 	WTSContractInfo()
 		: m_commInfo(NULL), m_openDate(19900101), m_expireDate(30991231)
+		, m_optType(OT_None), m_dStrikePrice(0)
 		, m_lMarginRatio(0), m_sMarginRatio(0), m_nFeeAlg(-1), m_uMarginFlag(0)
 		, m_uHotFlag(0), m_uTotalIdx(UINT_MAX), m_pExtData(NULL){}
 	
@@ -727,6 +768,10 @@ private:
 	uint32_t	m_openDate;		// 上市日期
 	uint32_t	m_expireDate;	// 交割日
 
+	OptionType	m_optType;			// 期权类型
+	std::string	m_strUnderlying;	// 期权标的合约代码
+	double		m_dStrikePrice;		// 期权行权价
+
 	double		m_lMarginRatio;	// 交易所多头保证金率
 	double		m_sMarginRatio;	// 交易所空头保证金率
 	uint32_t	m_uMarginFlag;	// 0-合约信息读取的，1-手工设置的
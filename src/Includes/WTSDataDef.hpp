@@ -265,6 +265,7 @@ private:
 	typedef std::pair<WTSBarStruct*, uint32_t> BarBlock;  // 数据块类型：指针+大小
 	std::vector<BarBlock> _blocks;                 // 数据块列表
 	uint32_t		_count;                         // 总数据条数
+	std::vector<WTSBarStruct> _buffer;             // detach以后切片自己持有的数据
 
 protected:
 	WTSKlineSlice()
@@ -317,6 +318,23 @@ public:
 		return true;
 	}
 
+	/*
+	 *	把引用的数据块拷贝到切片自己的缓冲区中
+	 *	拷贝以后切片不再依赖底层缓存，底层缓存扩容或者被其他线程改写都不影响切片
+	 */
+	inline void detach()
+	{
+		std::vector<WTSBarStruct> buf;
+		buf.reserve(_count);
+		for (auto& item : _blocks)  // 按顺序拷贝所有数据块
+			buf.insert(buf.end(), item.first, item.first + item.second);
+
+		_buffer.swap(buf);
+		_blocks.clear();
+		if (!_buffer.empty())
+			_blocks.emplace_back(BarBlock(_buffer.data(), (uint32_t)_buffer.size()));
+	}
+
 	/*
 	 *	获取数据块的数量
 	 *	@return 数据块总数
@@ -1332,9 +1350,10 @@ private:
 	typedef std::pair<WTSTickStruct*, uint32_t> TickBlock;
 	std::vector<TickBlock> _blocks;
 	uint32_t		_count;
+	std::vector<WTSTickStruct> _buffer;	//detach以后切片自己持有的数据
 
 protected:
-	WTSTickSlice() { _blocks.clear(); }
+	WTSTickSlice() :_count(0) { _blocks.clear(); }
 	inline int32_t		translateIdx(int32_t idx) const
 	{
 		if (idx < 0)
@@ -1382,6 +1401,20 @@ public:
 		return true;
 	}
 
+	//把引用的数据块拷贝到切片自己的缓冲区中，之后切片不再依赖底层缓存
+	inline void detach()
+	{
+		std::vector<WTSTickStruct> buf;
+		buf.reserve(_count);
+		for (auto& item : _blocks)
+			buf.insert(buf.end(), item.first, item.first + item.second);
+
+		_buffer.swap(buf);
+		_blocks.clear();
+		if (!_buffer.empty())
+			_blocks.emplace_back(TickBlock(_buffer.data(), (uint32_t)_buffer.size()));
+	}
+
 	inline std::size_t	get_block_counts() const
 	{
 		return _blocks.size();
@@ -1437,11 +1470,13 @@ class WTSOrdDtlSlice : public WTSObject
 {
 private:
 	char				m_strCode[MAX_INSTRUMENT_LENGTH];
-	WTSOrdDtlStruct*	m_ptrBegin;
+	typedef std::pair<WTSOrdDtlStruct*, uint32_t> DataBlock;
+	std::vector<DataBlock>	m_ayBlocks;
 	uint32_t			m_uCount;
+	std::vector<WTSOrdDtlStruct>	m_ayBuffer;	//detach以后切片自己持有的数据
 
 protected:
-	WTSOrdDtlSlice() :m_ptrBegin(NULL), m_uCount(0) {}
+	WTSOrdDtlSlice() :m_uCount(0) {}
 	inline int32_t		translateIdx(int32_t idx) const
 	{
 		if (idx < 0)
@@ -1460,22 +1495,75 @@ public:
 
 		WTSOrdDtlSlice* slice = new WTSOrdDtlSlice();
 		wt_strcpy(slice->m_strCode, code);
-		slice->m_ptrBegin = firstItem;
+		slice->m_ayBlocks.emplace_back(DataBlock(firstItem, count));
 		slice->m_uCount = count;
 
 		return slice;
 	}
 
+	inline bool appendBlock(WTSOrdDtlStruct* items, uint32_t count)
+	{
+		if (items == NULL || count == 0)
+			return false;
+
+		m_uCount += count;
+		m_ayBlocks.emplace_back(DataBlock(items, count));
+		return true;
+	}
+
+	//把引用的数据块拷贝到切片自己的缓冲区中，之后切片不再依赖底层缓存
+	inline void detach()
+	{
+		std::vector<WTSOrdDtlStruct> buf;
+		buf.reserve(m_uCount);
+		for (auto& item : m_ayBlocks)
+			buf.insert(buf.end(), item.first, item.first + item.second);
+
+		m_ayBuffer.swap(buf);
+		m_ayBlocks.clear();
+		if (!m_ayBuffer.empty())
+			m_ayBlocks.emplace_back(DataBlock(m_ayBuffer.data(), (uint32_t)m_ayBuffer.size()));
+	}
+
+	inline std::size_t	get_block_counts() const
+	{
+		return m_ayBlocks.size();
+	}
+
+	inline WTSOrdDtlStruct*	get_block_addr(std::size_t blkIdx)
+	{
+		if (blkIdx >= m_ayBlocks.size())
+			return NULL;
+
+		return m_ayBlocks[blkIdx].first;
+	}
+
+	inline uint32_t get_block_size(std::size_t blkIdx)
+	{
+		if (blkIdx >= m_ayBlocks.size())
+			return INVALID_UINT32;
+
+		return m_ayBlocks[blkIdx].second;
+	}
+
 	inline uint32_t size() const { return m_uCount; }
 
-	inline bool empty() const { return (m_uCount == 0) || (m_ptrBegin == NULL); }
+	inline bool empty() const { return (m_uCount == 0); }
 
 	inline const WTSOrdDtlStruct* at(int32_t idx)
 	{
-		if (m_ptrBegin == NULL)
+		if (m_uCount == 0)
 			return NULL;
+
 		idx = translateIdx(idx);
-		return m_ptrBegin + idx;
+		for (auto& item : m_ayBlocks)
+		{
+			if ((uint32_t)idx >= item.second)
+				idx -= item.second;
+			else
+				return item.first + idx;
+		}
+		return NULL;
 	}
 };
 
@@ -1489,11 +1577,13 @@ class WTSOrdQueSlice : public WTSObject
 {
 private:
 	char				m_strCode[MAX_INSTRUMENT_LENGTH];
-	WTSOrdQueStruct*	m_ptrBegin;
+	typedef std::pair<WTSOrdQueStruct*, uint32_t> DataBlock;
+	std::vector<DataBlock>	m_ayBlocks;
 	uint32_t			m_uCount;
+	std::vector<WTSOrdQueStruct>	m_ayBuffer;	//detach以后切片自己持有的数据
 
 protected:
-	WTSOrdQueSlice() :m_ptrBegin(NULL), m_uCount(0) {}
+	WTSOrdQueSlice() :m_uCount(0) {}
 	inline int32_t		translateIdx(int32_t idx) const
 	{
 		if (idx < 0)
@@ -1512,22 +1602,75 @@ public:
 
 		WTSOrdQueSlice* slice = new WTSOrdQueSlice();
 		wt_strcpy(slice->m_strCode, code);
-		slice->m_ptrBegin = firstItem;
+		slice->m_ayBlocks.emplace_back(DataBlock(firstItem, count));
 		slice->m_uCount = count;
 
 		return slice;
 	}
 
+	inline bool appendBlock(WTSOrdQueStruct* items, uint32_t count)
+	{
+		if (items == NULL || count == 0)
+			return false;
+
+		m_uCount += count;
+		m_ayBlocks.emplace_back(DataBlock(items, count));
+		return true;
+	}
+
+	//把引用的数据块拷贝到切片自己的缓冲区中，之后切片不再依赖底层缓存
+	inline void detach()
+	{
+		std::vector<WTSOrdQueStruct> buf;
+		buf.reserve(m_uCount);
+		for (auto& item : m_ayBlocks)
+			buf.insert(buf.end(), item.first, item.first + item.second);
+
+		m_ayBuffer.swap(buf);
+		m_ayBlocks.clear();
+		if (!m_ayBuffer.empty())
+			m_ayBlocks.emplace_back(DataBlock(m_ayBuffer.data(), (uint32_t)m_ayBuffer.size()));
+	}
+
+	inline std::size_t	get_block_counts() const
+	{
+		return m_ayBlocks.size();
+	}
+
+	inline WTSOrdQueStruct*	get_block_addr(std::size_t blkIdx)
+	{
+		if (blkIdx >= m_ayBlocks.size())
+			return NULL;
+
+		return m_ayBlocks[blkIdx].first;
+	}
+
+	inline uint32_t get_block_size(std::size_t blkIdx)
+	{
+		if (blkIdx >= m_ayBlocks.size())
+			return INVALID_UINT32;
+
+		return m_ayBlocks[blkIdx].second;
+	}
+
 	inline uint32_t size() const { return m_uCount; }
 
-	inline bool empty() const { return (m_uCount == 0) || (m_ptrBegin == NULL); }
+	inline bool empty() const { return (m_uCount == 0); }
 
 	inline const WTSOrdQueStruct* at(int32_t idx)
 	{
-		if (m_ptrBegin == NULL)
+		if (m_uCount == 0)
 			return NULL;
+
 		idx = translateIdx(idx);
-		return m_ptrBegin + idx;
+		for (auto& item : m_ayBlocks)
+		{
+			if ((uint32_t)idx >= item.second)
+				idx -= item.second;
+			else
+				return item.first + idx;
+		}
+		return NULL;
 	}
 };
 
@@ -1540,12 +1683,14 @@ public:
 class WTSTransSlice : public WTSObject
 {
 private:
-	char			m_strCode[MAX_INSTRUMENT_LENGTH];
-	WTSTransStruct*	m_ptrBegin;
-	uint32_t		m_uCount;
+	char				m_strCode[MAX_INSTRUMENT_LENGTH];
+	typedef std::pair<WTSTransStruct*, uint32_t> DataBlock;
+	std::vector<DataBlock>	m_ayBlocks;
+	uint32_t			m_uCount;
+	std::vector<WTSTransStruct>	m_ayBuffer;	//detach以后切片自己持有的数据
 
 protected:
-	WTSTransSlice() :m_ptrBegin(NULL), m_uCount(0) {}
+	WTSTransSlice() :m_uCount(0) {}
 	inline int32_t		translateIdx(int32_t idx) const
 	{
 		if (idx < 0)
@@ -1564,22 +1709,75 @@ public:
 
 		WTSTransSlice* slice = new WTSTransSlice();
 		wt_strcpy(slice->m_strCode, code);
-		slice->m_ptrBegin = firstItem;
+		slice->m_ayBlocks.emplace_back(DataBlock(firstItem, count));
 		slice->m_uCount = count;
 
 		return slice;
 	}
 
+	inline bool appendBlock(WTSTransStruct* items, uint32_t count)
+	{
+		if (items == NULL || count == 0)
+			return false;
+
+		m_uCount += count;
+		m_ayBlocks.emplace_back(DataBlock(items, count));
+		return true;
+	}
+
+	//把引用的数据块拷贝到切片自己的缓冲区中，之后切片不再依赖底层缓存
+	inline void detach()
+	{
+		std::vector<WTSTransStruct> buf;
+		buf.reserve(m_uCount);
+		for (auto& item : m_ayBlocks)
+			buf.insert(buf.end(), item.first, item.first + item.second);
+
+		m_ayBuffer.swap(buf);
+		m_ayBlocks.clear();
+		if (!m_ayBuffer.empty())
+			m_ayBlocks.emplace_back(DataBlock(m_ayBuffer.data(), (uint32_t)m_ayBuffer.size()));
+	}
+
+	inline std::size_t	get_block_counts() const
+	{
+		return m_ayBlocks.size();
+	}
+
+	inline WTSTransStruct*	get_block_addr(std::size_t blkIdx)
+	{
+		if (blkIdx >= m_ayBlocks.size())
+			return NULL;
+
+		return m_ayBlocks[blkIdx].first;
+	}
+
+	inline uint32_t get_block_size(std::size_t blkIdx)
+	{
+		if (blkIdx >= m_ayBlocks.size())
+			return INVALID_UINT32;
+
+		return m_ayBlocks[blkIdx].second;
+	}
+
 	inline uint32_t size() const { return m_uCount; }
 
-	inline bool empty() const { return (m_uCount == 0) || (m_ptrBegin == NULL); }
+	inline bool empty() const { return (m_uCount == 0); }
 
 	inline const WTSTransStruct* at(int32_t idx)
 	{
-		if (m_ptrBegin == NULL)
+		if (m_uCount == 0)
 			return NULL;
+
 		idx = translateIdx(idx);
-		return m_ptrBegin + idx;
+		for (auto& item : m_ayBlocks)
+		{
+			if ((uint32_t)idx >= item.second)
+				idx -= item.second;
+			else
+				return item.first + idx;
+		}
+		return NULL;
 	}
 };
 
@@ -488,6 +488,39 @@ struct WTSTransStruct
 	}
 };
 
+/**
+ * 期权希腊字母快照结构体
+ * 
+ * 由引擎内的希腊字母服务维护，策略直接读取服务内部的快照表，不做拷贝
+ * seq为偶数时数据完整，写入过程中为奇数，跨线程读取可以据此判断是否读到了一致的数据
+ * 无法计算隐含波动率时(价格越界、已到期等)，iv和希腊字母为NaN
+ */
+struct WTSOptGreeksStruct
+{
+	volatile uint64_t	seq;		// 更新序号，全表单调递增
+	char		exchg[MAX_EXCHANGE_LENGTH];		// 交易所代码
+	char		code[MAX_INSTRUMENT_LENGTH];		// 期权合约代码
+
+	uint32_t	action_date;		// 最后更新的自然日期，格式：YYYYMMDD
+	uint32_t	action_time;		// 最后更新的时间，格式：HHMMSSmmm
+	uint32_t	expire_date;		// 到期日，格式：YYYYMMDD
+	uint32_t	is_call;			// 1-看涨，0-看跌
+
+	double		strike;				// 行权价
+	double		underlying;			// 计算时使用的标的价格
+	double		price;				// 计算时使用的期权价格
+	double		iv;					// 隐含波动率
+	double		delta;				// delta
+	double		gamma;				// gamma
+	double		vega;				// vega，波动率变动1%的价格变动
+	double		theta;				// theta，每个自然日的价格变动
+
+	WTSOptGreeksStruct()
+	{
+		memset((void*)this, 0, sizeof(WTSOptGreeksStruct));
+	}
+};
+
 #pragma pack(pop)  // 恢复默认的内存对齐设置
 
 NS_WTP_END  // 结束WonderTrader命名空间
@@ -221,6 +221,21 @@ public:
 		return NULL;  // 创建失败返回NULL
 	}
 
+	// 静态工厂方法：创建改单操作对象
+	static inline WTSEntrustAction* createModifyAction(const char* code, const char* exchg, double newPrice, double newVolume) noexcept
+	{
+		WTSEntrustAction* pRet = WTSEntrustAction::create(code, exchg);  // 从对象池分配内存
+		if(pRet)  // 如果分配成功
+		{
+			pRet->m_actionFlag = WAF_MODIFY;     // 设置操作标志为修改
+			pRet->m_dNewPrice = newPrice;        // 设置新的委托价格
+			pRet->m_dNewVolume = newVolume;      // 设置新的剩余数量
+			return pRet;                         // 返回创建的对象
+		}
+
+		return NULL;  // 分配失败返回NULL
+	}
+
 public:
 	// 获取交易所代码
 	inline const char* getExchg() const  noexcept { return m_strExchg; }
@@ -276,12 +291,24 @@ public:
 	// 获取合约信息指针
 	inline WTSContractInfo* getContractInfo() const  noexcept { return m_pContract; }
 
+	// 设置改单的新委托价格
+	inline void setNewPrice(double price) noexcept { m_dNewPrice = price; }
+	// 获取改单的新委托价格
+	inline double getNewPrice() const noexcept { return m_dNewPrice; }
+
+	// 设置改单的新剩余数量
+	inline void setNewVolume(double volume) noexcept { m_dNewVolume = volume; }
+	// 获取改单的新剩余数量
+	inline double getNewVolume() const noexcept { return m_dNewVolume; }
+
 protected:
 	char			m_strExchg[MAX_EXCHANGE_LENGTH];  // 交易所代码字符串
 	char			m_strCode[MAX_INSTRUMENT_LENGTH];  // 合约代码字符串
 
 	char			m_strEnturstID[64] = { 0 };     // 委托编号字符串
 	WTSActionFlag	m_actionFlag;                    // 操作标志（撤销/修改）
+	double			m_dNewPrice = 0;                // 改单的新委托价格
+	double			m_dNewVolume = 0;               // 改单的新剩余数量
 
 	char			m_strOrderID[64] = { 0 };       // 订单编号字符串
 	char			m_strUserTag[64] = { 0 };       // 用户标签字符串
@@ -309,6 +309,7 @@ typedef enum tagErrorCode
 	WEC_ORDERCANCEL,				// 撤单错误：撤单操作失败
 	WEC_EXECINSERT,					// 行权指令错误：行权指令操作失败
 	WEC_EXECCANCEL,					// 行权撤销错误：行权撤销操作失败
+	WEC_ORDERMODIFY,				// 改单错误：改单操作失败
 	WEC_UNKNOWN			=	9999	// 未知错误：未识别的错误类型
 } WTSErroCode;
 
@@ -1,276 +1,450 @@
-﻿/*!
- * \file ParserShm.cpp
- * \project	WonderTrader
- *
- * \author Wesley
- * \date 2020/03/30
- * 
- * \brief 
- */
-#include "ParserShm.h"
-#include "../Includes/WTSVariant.hpp"
-#include "../Includes/WTSDataDef.hpp"
-
-#include <boost/bind.hpp>
-
- //By Wesley @ 2022.01.05
-#include "../Share/fmtlib.h"
-template<typename... Args>
-inline void write_log(IParserSpi* sink, WTSLogLevel ll, const char* format, const Args&... args)
-{
-	if (sink == NULL)
-		return;
-
-	static thread_local char buffer[512] = { 0 };
-	fmtutil::format_to(buffer, format, args...);
-
-	sink->handleParserLog(ll, buffer);
-}
-
-#define UDP_MSG_SUBSCRIBE	0x100
-#define UDP_MSG_PUSHTICK	0x200
-#define UDP_MSG_PUSHORDQUE	0x201	//委托队列
-#define UDP_MSG_PUSHORDDTL	0x202	//委托明细
-#define UDP_MSG_PUSHTRANS	0x203	//逐笔成交
-
-#define NODATA_FLAG 0xfffffffffffffffe
-
-
-extern "C"
-{
-	EXPORT_FLAG IParserApi* createParser()
-	{
-		ParserShm* parser = new ParserShm();
-		return parser;
-	}
-
-	EXPORT_FLAG void deleteParser(IParserApi* &parser)
-	{
-		if (NULL != parser)
-		{
-			delete parser;
-			parser = NULL;
-		}
-	}
-};
-
-
-
-ParserShm::ParserShm()
-	: _stopped(false)
-	, _sink(NULL)
-	, _queue(NULL)
-	, _check_span(0)
-{
-}
-
-
-ParserShm::~ParserShm()
-{
-}
-
-bool ParserShm::init( WTSVariant* config )
-{
-	_path = config->getCString("path");
-	_gpsize = config->getUInt32("gpsize");
-	if (_gpsize == 0)
-		_gpsize = 1000;
-	_check_span = config->getUInt32("checkspan");
-
-	return true;
-}
-
-void ParserShm::release()
-{
-	
-}
-
-bool ParserShm::connect()
-{
-	_thrd_parser.reset(new StdThread([this]() {
-
-		write_log(_sink, LL_INFO, "[ParserShm] loading {} ...", _path);
-		while (!StdFile::exists(_path.c_str()))
-		{
-			write_log(_sink, LL_WARN, "[ParserShm] {} not exist yet, waiting for 2 seconds", _path);
-			std::this_thread::sleep_for(std::chrono::seconds(2));
-			continue;
-		}
-
-		_mapfile.reset(new BoostMappingFile);
-		_mapfile->map(_path.c_str());
-		_queue = (CastQueue*)_mapfile->addr();
-		uint32_t cast_pid = _queue->_pid;
-
-		if (_sink)
-		{
-			_sink->handleEvent(WPE_Connect, 0);
-			_sink->handleEvent(WPE_Login, 0);
-		}
-		write_log(_sink, LL_INFO, "[ParserShm] {} loaded, start to receiving", _path);
-
-		uint64_t lastIdx = UINT64_MAX;
-		while(!_stopped)
+﻿/*!
+ * \file ParserShm.cpp
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ * 
+ * \brief 
+ */
+#include "ParserShm.h"
+#include "../Includes/WTSVariant.hpp"
+#include "../Includes/WTSDataDef.hpp"
+#include "../Share/TimeUtils.hpp"
+
+#include <algorithm>
+#include <boost/bind.hpp>
+
+ //By Wesley @ 2022.01.05
+#include "../Share/fmtlib.h"
+template<typename... Args>
+inline void write_log(IParserSpi* sink, WTSLogLevel ll, const char* format, const Args&... args)
+{
+	if (sink == NULL)
+		return;
+
+	static thread_local char buffer[512] = { 0 };
+	fmtutil::format_to(buffer, format, args...);
+
+	sink->handleParserLog(ll, buffer);
+}
+
+#define UDP_MSG_SUBSCRIBE	0x100
+#define UDP_MSG_PUSHTICK	0x200
+#define UDP_MSG_PUSHORDQUE	0x201	//委托队列
+#define UDP_MSG_PUSHORDDTL	0x202	//委托明细
+#define UDP_MSG_PUSHTRANS	0x203	//逐笔成交
+
+#define NODATA_FLAG 0xfffffffffffffffe
+
+
+extern "C"
+{
+	EXPORT_FLAG IParserApi* createParser()
+	{
+		ParserShm* parser = new ParserShm();
+		return parser;
+	}
+
+	EXPORT_FLAG void deleteParser(IParserApi* &parser)
+	{
+		if (NULL != parser)
 		{
-			//如果pid不同，说明datakit重启了
-			if(cast_pid != _queue->_pid)
-			{
-				lastIdx = UINT64_MAX;
-				write_log(_sink, LL_WARN, "ShareMemory queue has been reset justnow");
-				cast_pid = _queue->_pid;
-			}
-			
-			if (_queue->_readable == UINT64_MAX)	//刚分配好，还没数据进来
-			{
-				lastIdx = NODATA_FLAG;
-				if(_check_span != 0)
-					std::this_thread::sleep_for(std::chrono::microseconds(_check_span));
-				continue;
-			}
+			delete parser;
+			parser = NULL;
+		}
+	}
+};
 
-			if (lastIdx == UINT64_MAX)	//有数据，第一次检查，则直接定位到最后一条数据
-			{
-				lastIdx = _queue->_readable;
-				if (_check_span != 0)
-					std::this_thread::sleep_for(std::chrono::microseconds(_check_span));
-				continue;
-			}
-			else if (lastIdx == NODATA_FLAG)	//之前没数据的时候检查了一次，现在有数据了，从0开始读取
-			{
-				lastIdx = 0;
-			}
-			else if (lastIdx >= _queue->_readable)	//没有新的数据进来
-			{
-				if (_check_span != 0)
-					std::this_thread::sleep_for(std::chrono::microseconds(_check_span));
+
+
+ParserShm::ParserShm()
+	: _catalog_pid(0)
+	, _type_mask(shmcast::ALL_TYPES_MASK)
+	, _subs_changed(false)
+	, _gpsize(0)
+	, _check_span(0)
+	, _sink(NULL)
+	, _stopped(false)
+	, _connected(false)
+	, _poll_mode(false)
+	, _next_load(0)
+{
+}
+
+
+ParserShm::~ParserShm()
+{
+}
+
+bool ParserShm::init( WTSVariant* config )
+{
+	_path = config->getCString("path");
+	_gpsize = config->getUInt32("gpsize");
+	if (_gpsize == 0)
+		_gpsize = 1000;
+	_check_span = config->getUInt32("checkspan");
+
+	//需要的数据类型，tick/ordque/orddtl/trans，为空表示全部类型
+	//只要tick的话，L2数据所在的分区就不会挂载
+	_type_mask = shmcast::parse_type_mask(config->getCString("types"));
+
+	return true;
+}
+
+void ParserShm::release()
+{
+	
+}
+
+void ParserShm::attach_partitions()
+{
+	std::vector<std::string> paths;
+
+	std::string catPath = shmcast::catalog_path(_path.c_str());
+	if (!_catalog && StdFile::exists(catPath.c_str()))
+	{
+		_catalog.reset(new BoostMappingFile);
+		if (!_catalog->map(catPath.c_str()) || _catalog->size() < sizeof(shmcast::PartitionCatalog))
+			_catalog.reset();
+	}
+
+	//写入端最后写pid，pid为0说明目录还没写完
+	shmcast::PartitionCatalog* catalog = _catalog ? (shmcast::PartitionCatalog*)_catalog->addr() : NULL;
+	_catalog_pid = (catalog != NULL) ? catalog->_pid : 0;
+	if (catalog != NULL && _catalog_pid != 0 && catalog->_count > 0 
+		&& memcmp(catalog->_flag, shmcast::PARTS_FLAG, sizeof(shmcast::PARTS_FLAG)) == 0)
+	{
+		uint32_t count = std::min(catalog->_count, shmcast::MAX_PARTITIONS);
+		shmcast::PartitionRules rules;
+		for (uint32_t i = 0; i < count; i++)
+			rules.emplace_back(shmcast::PartitionRule(catalog->_parts[i]));
+
+		//按照和写入端一样的规则，算出每个订阅代码的每种数据落在哪个分区
+		std::vector<bool> needed(count, false);
+		for (const auto& fullCode : _set_subs)
+		{
+			auto pos = fullCode.find('.');
+			if (pos == std::string::npos)
 				continue;
-			}
-			else
-			{
-				lastIdx++;	//普通情况，下标递增
-			}
-
-			DataItem& item = _queue->_items[lastIdx % _queue->_capacity];
-			switch (item._type)
-			{
-			case 0:
-			{
-				const char* fullCode = fmtutil::format("{}.{}", item._tick.exchg, item._tick.code);
-				auto it = _set_subs.find(fullCode);
-				if (it != _set_subs.end())
-				{
-					WTSTickData* newData = WTSTickData::create(item._tick);
-					if (_sink)
-						_sink->handleQuote(newData, 0);
-					newData->release();
-
-					static uint32_t recv_cnt = 0;
-					recv_cnt++;
-					if (recv_cnt % _gpsize == 0)
-						write_log(_sink, LL_DEBUG, "[ParserShm] {} ticks received in total", recv_cnt);
-				}
-			}
-			break;
-			case 1:
-			{
-				const char* fullCode = fmtutil::format("{}.{}", item._queue.exchg, item._queue.code);
-				auto it = _set_subs.find(fullCode);
-				if (it != _set_subs.end())
-				{
-					WTSOrdQueData* newData = WTSOrdQueData::create(item._queue);
-					if (_sink)
-						_sink->handleOrderQueue(newData);
-					newData->release();
-
-					static uint32_t recv_cnt = 0;
-					recv_cnt++;
-					if (recv_cnt % _gpsize == 0)
-						write_log(_sink, LL_DEBUG, "[ParserShm] {} queues received in total", recv_cnt);
-				}
-			}
-			break;
-			case 2:
-			{
-				const char* fullCode = fmtutil::format("{}.{}", item._order.exchg, item._order.code);
-				auto it = _set_subs.find(fullCode);
-				if (it != _set_subs.end())
-				{
-					WTSOrdDtlData* newData = WTSOrdDtlData::create(item._order);
-					if (_sink)
-						_sink->handleOrderDetail(newData);
-					newData->release();
-
-					static uint32_t recv_cnt = 0;
-					recv_cnt++;
-					if (recv_cnt % _gpsize == 0)
-						write_log(_sink, LL_DEBUG, "[ParserShm] {} orders received in total", recv_cnt);
-				}
-			}
-			break;
-			case 3:
+
+			std::string exchg = fullCode.substr(0, pos);
+			const char* code = fullCode.c_str() + pos + 1;
+			for (uint32_t t = 0; t < shmcast::CDT_Count; t++)
 			{
-				const char* fullCode = fmtutil::format("{}.{}", item._trans.exchg, item._trans.code);
-				auto it = _set_subs.find(fullCode);
-				if (it != _set_subs.end())
-				{
-					WTSTransData* newData = WTSTransData::create(item._trans);
-					if (_sink)
-						_sink->handleTransaction(newData);
-					newData->release();
-
-					static uint32_t recv_cnt = 0;
-					recv_cnt++;
-					if (recv_cnt % _gpsize == 0)
-						write_log(_sink, LL_DEBUG, "[ParserShm] {} transactions received in total", recv_cnt);
-				}
+				if ((_type_mask & (1 << t)) == 0)
+					continue;
+
+				int32_t idx = shmcast::route(rules, t, exchg.c_str(), code);
+				if (idx >= 0)
+					needed[idx] = true;
 			}
-			break;
-			default:
-				break;
-			}
-		}
-	}));
-
-	return true;
-}
-
-bool ParserShm::disconnect()
-{
-	_stopped = true;
-
-	return true;
-}
-
-bool ParserShm::isConnected()
-{
-	return _queue!=NULL;
-}
-
-
-void ParserShm::subscribe( const CodeSet &vecSymbols )
-{
-	auto cit = vecSymbols.begin();
-	for(; cit != vecSymbols.end(); cit++)
-	{
-		const auto &code = *cit;
-		if(_set_subs.find(code) == _set_subs.end())
-		{
-			_set_subs.insert(code);
-		}
-	}
-}
-
-void ParserShm::unsubscribe(const CodeSet &setSymbols)
-{
-
-}
-
-void ParserShm::registerSpi( IParserSpi* listener )
-{
-	bool bReplaced = (_sink!=NULL);
-	_sink = listener;
-	if(bReplaced && _sink)
-	{
-		write_log(_sink, LL_WARN, "Listener is replaced");
-	}
+		}
+
+		for (uint32_t i = 0; i < count; i++)
+		{
+			if (needed[i])
+				paths.emplace_back(catalog->_parts[i]._path);
+		}
+
+		write_log(_sink, LL_INFO, "[ParserShm] {} of {} partitions needed for {} codes", paths.size(), count, _set_subs.size());
+	}
+	else
+	{
+		paths.emplace_back(_path);
+	}
+
+	//已经挂载的分区保留读取进度，不再需要的分区直接卸载
+	std::vector<ShmPartition> parts;
+	for (const std::string& path : paths)
+	{
+		auto it = std::find_if(_partitions.begin(), _partitions.end(), [&path](const ShmPartition& p) {
+			return p._path == path;
+		});
+
+		if (it != _partitions.end())
+		{
+			parts.emplace_back(*it);
+			continue;
+		}
+
+		ShmPartition part;
+		part._path = path;
+		part._mapfile.reset(new BoostMappingFile);
+		if (!part._mapfile->map(path.c_str()))
+		{
+			write_log(_sink, LL_ERROR, "[ParserShm] mapping partition {} failed", path);
+			continue;
+		}
+		part._queue = (CastQueue*)part._mapfile->addr();
+		part._cast_pid = part._queue->_pid;
+		parts.emplace_back(part);
+		write_log(_sink, LL_INFO, "[ParserShm] partition {} attached", path);
+	}
+
+	_partitions.swap(parts);
+}
+
+bool ParserShm::poll_partition(ShmPartition& part)
+{
+	CastQueue* queue = part._queue;
+	uint64_t& lastIdx = part._last_idx;
+
+	//如果pid不同，说明datakit重启了
+	if (part._cast_pid != queue->_pid)
+	{
+		lastIdx = UINT64_MAX;
+		write_log(_sink, LL_WARN, "ShareMemory queue {} has been reset justnow", part._path);
+		part._cast_pid = queue->_pid;
+	}
+
+	if (queue->_readable == UINT64_MAX)	//刚分配好，还没数据进来
+	{
+		lastIdx = NODATA_FLAG;
+		return false;
+	}
+
+	if (lastIdx == UINT64_MAX)	//有数据，第一次检查，则直接定位到最后一条数据
+	{
+		lastIdx = queue->_readable;
+		return false;
+	}
+	else if (lastIdx == NODATA_FLAG)	//之前没数据的时候检查了一次，现在有数据了，从0开始读取
+	{
+		lastIdx = 0;
+	}
+	else if (lastIdx >= queue->_readable)	//没有新的数据进来
+	{
+		return false;
+	}
+	else
+	{
+		lastIdx++;	//普通情况，下标递增
+	}
+
+	handle_item(queue->_items[lastIdx % queue->_capacity]);
+	return true;
+}
+
+void ParserShm::handle_item(DataItem& item)
+{
+	//默认队列和没有分区的旧版队列里什么类型都有，不需要的类型和挂载分区时一样按掩码过滤掉
+	if (item._type >= shmcast::CDT_Count || (_type_mask & (1 << item._type)) == 0)
+		return;
+
+	switch (item._type)
+	{
+	case shmcast::CDT_Tick:
+	{
+		const char* fullCode = fmtutil::format("{}.{}", item._tick.exchg, item._tick.code);
+		auto it = _set_subs.find(fullCode);
+		if (it != _set_subs.end())
+		{
+			WTSTickData* newData = WTSTickData::create(item._tick);
+			if (_sink)
+				_sink->handleQuote(newData, 0);
+			newData->release();
+
+			static uint32_t recv_cnt = 0;
+			recv_cnt++;
+			if (recv_cnt % _gpsize == 0)
+				write_log(_sink, LL_DEBUG, "[ParserShm] {} ticks received in total", recv_cnt);
+		}
+	}
+	break;
+	case shmcast::CDT_OrdQue:
+	{
+		const char* fullCode = fmtutil::format("{}.{}", item._queue.exchg, item._queue.code);
+		auto it = _set_subs.find(fullCode);
+		if (it != _set_subs.end())
+		{
+			WTSOrdQueData* newData = WTSOrdQueData::create(item._queue);
+			if (_sink)
+				_sink->handleOrderQueue(newData);
+			newData->release();
+
+			static uint32_t recv_cnt = 0;
+			recv_cnt++;
+			if (recv_cnt % _gpsize == 0)
+				write_log(_sink, LL_DEBUG, "[ParserShm] {} queues received in total", recv_cnt);
+		}
+	}
+	break;
+	case shmcast::CDT_OrdDtl:
+	{
+		const char* fullCode = fmtutil::format("{}.{}", item._order.exchg, item._order.code);
+		auto it = _set_subs.find(fullCode);
+		if (it != _set_subs.end())
+		{
+			WTSOrdDtlData* newData = WTSOrdDtlData::create(item._order);
+			if (_sink)
+				_sink->handleOrderDetail(newData);
+			newData->release();
+
+			static uint32_t recv_cnt = 0;
+			recv_cnt++;
+			if (recv_cnt % _gpsize == 0)
+				write_log(_sink, LL_DEBUG, "[ParserShm] {} orders received in total", recv_cnt);
+		}
+	}
+	break;
+	case shmcast::CDT_Trans:
+	{
+		const char* fullCode = fmtutil::format("{}.{}", item._trans.exchg, item._trans.code);
+		auto it = _set_subs.find(fullCode);
+		if (it != _set_subs.end())
+		{
+			WTSTransData* newData = WTSTransData::create(item._trans);
+			if (_sink)
+				_sink->handleTransaction(newData);
+			newData->release();
+
+			static uint32_t recv_cnt = 0;
+			recv_cnt++;
+			if (recv_cnt % _gpsize == 0)
+				write_log(_sink, LL_DEBUG, "[ParserShm] {} transactions received in total", recv_cnt);
+		}
+	}
+	break;
+	default:
+		break;
+	}
+}
+
+bool ParserShm::try_load()
+{
+	if (!StdFile::exists(_path.c_str()))
+		return false;
+
+	_subs_changed = false;
+	attach_partitions();
+	_connected = true;
+
+	if (_sink)
+	{
+		_sink->handleEvent(WPE_Connect, 0);
+		_sink->handleEvent(WPE_Login, 0);
+	}
+	write_log(_sink, LL_INFO, "[ParserShm] {} loaded, start to receiving", _path);
+	return true;
+}
+
+uint32_t ParserShm::poll_once()
+{
+	//订阅发生变化，或者datakit重启以后分区目录变了，要重新挂载分区
+	bool bCatalogReset = (_catalog && ((shmcast::PartitionCatalog*)_catalog->addr())->_pid != _catalog_pid);
+	if (_subs_changed.exchange(false) || bCatalogReset)
+	{
+		if (bCatalogReset)
+		{
+			write_log(_sink, LL_WARN, "[ParserShm] partition catalog has been reset justnow");
+			_partitions.clear();
+		}
+		attach_partitions();
+	}
+
+	uint32_t count = 0;
+	for (ShmPartition& part : _partitions)
+	{
+		if (poll_partition(part))
+			count++;
+	}
+
+	return count;
+}
+
+bool ParserShm::enablePolling()
+{
+	_poll_mode = true;
+	write_log(_sink, LL_INFO, "[ParserShm] polling mode enabled, no receiving thread will be started");
+	return true;
+}
+
+uint32_t ParserShm::poll()
+{
+	if (_stopped)
+		return 0;
+
+	if (!_connected)
+	{
+		//共享内存还没就绪，每2秒检查一次，不能每次轮询都去访问文件系统
+		int64_t now = TimeUtils::getLocalTimeNow();
+		if (now < _next_load)
+			return 0;
+
+		_next_load = now + 2000;
+		if (!try_load())
+		{
+			write_log(_sink, LL_WARN, "[ParserShm] {} not exist yet, waiting for 2 seconds", _path);
+			return 0;
+		}
+	}
+
+	return poll_once();
+}
+
+bool ParserShm::connect()
+{
+	write_log(_sink, LL_INFO, "[ParserShm] loading {} ...", _path);
+	if (_poll_mode)
+		return true;
+
+	_thrd_parser.reset(new StdThread([this]() {
+
+		while (!try_load())
+		{
+			write_log(_sink, LL_WARN, "[ParserShm] {} not exist yet, waiting for 2 seconds", _path);
+			std::this_thread::sleep_for(std::chrono::seconds(2));
+		}
+
+		while(!_stopped)
+		{
+			if (poll_once() == 0 && _check_span != 0)
+				std::this_thread::sleep_for(std::chrono::microseconds(_check_span));
+		}
+	}));
+
+	return true;
+}
+
+bool ParserShm::disconnect()
+{
+	_stopped = true;
+
+	return true;
+}
+
+bool ParserShm::isConnected()
+{
+	return _connected;
+}
+
+
+void ParserShm::subscribe( const CodeSet &vecSymbols )
+{
+	auto cit = vecSymbols.begin();
+	for(; cit != vecSymbols.end(); cit++)
+	{
+		const auto &code = *cit;
+		if(_set_subs.find(code) == _set_subs.end())
+		{
+			_set_subs.insert(code);
+			_subs_changed = true;
+		}
+	}
+}
+
+void ParserShm::unsubscribe(const CodeSet &setSymbols)
+{
+
+}
+
+void ParserShm::registerSpi( IParserSpi* listener )
+{
+	bool bReplaced = (_sink!=NULL);
+	_sink = listener;
+	if(bReplaced && _sink)
+	{
+		write_log(_sink, LL_WARN, "Listener is replaced");
+	}
 }
\ No newline at end of file
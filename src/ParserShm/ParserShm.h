@@ -1,90 +1,111 @@
-﻿/*!
- * \file ParserShm.h
- * \project	WonderTrader
- *
- * \author Wesley
- * \date 2020/03/30
- * 
- * \brief 
- */
-#pragma once
-#include "../Includes/IParserApi.h"
-#include "../Share/StdUtils.hpp"
+﻿/*!
+ * \file ParserShm.h
+ * \project	WonderTrader
+ *
+ * \author Wesley
+ * \date 2020/03/30
+ * 
+ * \brief 
+ */
+#pragma once
+#include "../Includes/IParserApi.h"
+#include "../Share/StdUtils.hpp"
 #include "../Includes/WTSStruct.h"
-#include "../Share/BoostMappingFile.hpp"
-
-#include <boost/asio.hpp>
-#include <boost/asio/io_service.hpp>
-
-USING_NS_WTP;
-using namespace boost::asio;
-
-class ParserShm : public IParserApi
-{
-public:
-	ParserShm();
-	~ParserShm();
-
-#pragma pack(push, 8)
-	typedef struct _DataItem
-	{
-		uint32_t	_type;	//数据类型， 0-tick,1-委托队列,2-逐笔委托,3-逐笔成交
-		union
-		{
-			WTSTickStruct	_tick;
-			WTSOrdQueStruct _queue;
-			WTSOrdDtlStruct	_order;
-			WTSTransStruct	_trans;
-		};
-
-		_DataItem() { memset(this, 0, sizeof(_DataItem)); }
-	} DataItem;
-
-	template <int N = 8 * 1024>
-	struct _DataQueue
+#include "../Share/BoostMappingFile.hpp"
+#include "../Share/ShmCastDefs.hpp"
+
+#include <atomic>
+#include <boost/asio.hpp>
+#include <boost/asio/io_service.hpp>
+
+USING_NS_WTP;
+using namespace boost::asio;
+
+class ParserShm : public IParserApi
+{
+public:
+	ParserShm();
+	~ParserShm();
+
+	typedef shmcast::DataItem	DataItem;
+	typedef shmcast::CastQueue	CastQueue;
+
+public:
+	virtual bool init(WTSVariant* config) override;
+
+	virtual void release() override;
+
+	virtual bool connect() override;
+
+	virtual bool disconnect() override;
+
+	virtual bool isConnected() override;
+
+	virtual void subscribe(const CodeSet &vecSymbols) override;
+	virtual void unsubscribe(const CodeSet &vecSymbols) override;
+
+	virtual void registerSpi(IParserSpi* listener) override;
+
+	virtual bool enablePolling() override;
+
+	virtual uint32_t poll() override;
+
+private:
+	typedef std::shared_ptr<BoostMappingFile> MappedFilePtr;
+
+	typedef struct _ShmPartition
 	{
-		uint64_t	_capacity = N;
-		volatile uint64_t	_readable;
-		volatile uint64_t	_writable;
-		uint32_t	_pid;
-		DataItem	_items[N];
-
-		_DataQueue() :_readable(UINT64_MAX), _writable(0), _pid(0) {}
-	};
-
-	typedef _DataQueue<8 * 1024>	CastQueue;
-
-#pragma pack(pop)
-
-public:
-	virtual bool init(WTSVariant* config) override;
-
-	virtual void release() override;
-
-	virtual bool connect() override;
-
-	virtual bool disconnect() override;
-
-	virtual bool isConnected() override;
-
-	virtual void subscribe(const CodeSet &vecSymbols) override;
-	virtual void unsubscribe(const CodeSet &vecSymbols) override;
-
-	virtual void registerSpi(IParserSpi* listener) override;
-
-private:
+		std::string		_path;
+		MappedFilePtr	_mapfile;
+		CastQueue*		_queue;
+		uint32_t		_cast_pid;
+		uint64_t		_last_idx;
+
+		_ShmPartition() :_queue(NULL), _cast_pid(0), _last_idx(UINT64_MAX){}
+	} ShmPartition;
+
+	/*
+	 *	根据分区目录和订阅的代码，挂载需要的分区
+	 *	没有分区目录的时候，只挂载默认队列
+	 */
+	void	attach_partitions();
+
+	/*
+	 *	读取一个分区的下一条数据，没有新数据返回false
+	 */
+	bool	poll_partition(ShmPartition& part);
+
+	void	handle_item(DataItem& item);
+
+	/*
+	 *	共享内存就绪以后挂载分区，共享内存还不存在返回false
+	 */
+	bool	try_load();
+
+	/*
+	 *	检查分区变化，并从每个分区读取一条数据，返回读到的条数
+	 */
+	uint32_t	poll_once();
+
+private:
 	std::string		_path;
-	typedef std::shared_ptr<BoostMappingFile> MappedFilePtr;
-	MappedFilePtr	_mapfile;
-	CastQueue*		_queue;
-	uint32_t		_gpsize;
-	uint32_t		_check_span;
-
-	IParserSpi*		_sink;
-	bool			_stopped;
-
-	CodeSet			_set_subs;
-
-	StdThreadPtr	_thrd_parser;
-};
-
+	std::vector<ShmPartition>	_partitions;
+	MappedFilePtr	_catalog;
+	uint32_t		_catalog_pid;
+	uint32_t		_type_mask;
+	std::atomic<bool>	_subs_changed;
+
+	uint32_t		_gpsize;
+	uint32_t		_check_span;
+
+	IParserSpi*		_sink;
+	bool			_stopped;
+	std::atomic<bool>	_connected;
+	bool			_poll_mode;		//轮询模式，不启动接收线程
+	int64_t			_next_load;		//轮询模式下下次检查共享内存是否就绪的时间
+
+	CodeSet			_set_subs;
+
+	StdThreadPtr	_thrd_parser;
+};
+
@@ -86,6 +86,7 @@ ParserUDP::ParserUDP()
 	, _sink(NULL)
 	, _connecting(false)
 	, _s_inited(false)
+	, _poll_mode(false)
 {
 }
 
@@ -245,7 +246,8 @@ bool ParserUDP::connect()
 {
 	if(reconnect(3))
 	{
-		_thrd_parser.reset(new StdThread(boost::bind(&io_service::run, &_io_service)));
+		if (!_poll_mode)
+			_thrd_parser.reset(new StdThread(boost::bind(&io_service::run, &_io_service)));
 	}
 	else
 	{
@@ -294,6 +296,25 @@ void ParserUDP::unsubscribe(const CodeSet &setSymbols)
 
 }
 
+bool ParserUDP::enablePolling()
+{
+	_poll_mode = true;
+	write_log(_sink, LL_INFO, "[ParserUDP] polling mode enabled, no io thread will be started");
+	return true;
+}
+
+uint32_t ParserUDP::poll()
+{
+	if (_stopped)
+		return 0;
+
+	//没有挂起的异步操作时io_service会进入停止状态，要重置以后才能继续轮询
+	if (_io_service.stopped())
+		_io_service.reset();
+
+	return (uint32_t)_io_service.poll();
+}
+
 void ParserUDP::registerSpi( IParserSpi* listener )
 {
 	bool bReplaced = (_sink!=NULL);
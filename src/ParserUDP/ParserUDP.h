@@ -43,6 +43,10 @@ public:
 
 	virtual void registerSpi(IParserSpi* listener) override;
 
+	virtual bool enablePolling() override;
+
+	virtual uint32_t poll() override;
+
 
 private:
 	void	handle_read(const boost::system::error_code& e, std::size_t bytes_transferred, bool isBroad);
@@ -82,6 +86,7 @@ private:
 	IParserSpi*				_sink;
 	bool					_stopped;
 	bool					_connecting;
+	bool					_poll_mode;	//轮询模式，不启动io线程，由调用方驱动io_service
 
 	CodeSet					_set_subs;
 
@@ -144,6 +144,13 @@ void initialize(const std::string& filename)
 		}
 	}
 
+	//交易日历的预计算区间，不配置的话默认为19900101-20501231
+	if (cfgBF->has("calendar"))
+	{
+		WTSVariant* cfgCal = cfgBF->get("calendar");
+		g_baseDataMgr.setCalendarRange(cfgCal->getUInt32("begin"), cfgCal->getUInt32("end"));
+	}
+
 	if (cfgBF->get("holiday"))
 	{
 		g_baseDataMgr.loadHolidays(cfgBF->getCString("holiday"));
@@ -23,6 +23,10 @@
 #include <boost/interprocess/file_mapping.hpp>  // boost内存映射文件头文件
 #include <boost/interprocess/mapped_region.hpp> // boost内存映射区域头文件
 
+#ifndef _WIN32
+#include <sys/mman.h>                           // madvise
+#endif
+
 /**
  * @brief Boost内存映射文件封装类
  * 
@@ -158,6 +162,37 @@ public:
 		return true;                            // 映射成功，返回true
 	}
 
+	/**
+	 * @brief 释放映射区域中的一段
+	 * 
+	 * @param offset 起始偏移（字节）
+	 * @param len 长度（字节）
+	 * @return true 释放成功，false 平台或者文件系统不支持
+	 * 
+	 * 对应的文件区域会被打洞，不再占用磁盘空间和页缓存，之后读出来都是0。
+	 * 起止位置向内对齐到页边界，不足一页的部分保留。
+	 */
+	bool discard(size_t offset, size_t len)
+	{
+#if !defined(_WIN32) && defined(MADV_REMOVE)
+		if (_map_region == NULL)                // 检查映射区域是否有效
+			return false;
+
+		size_t page = boost::interprocess::mapped_region::get_page_size();
+		size_t from = (offset + page - 1) / page * page;  // 起点向后对齐
+		size_t to = (offset + len) / page * page;         // 终点向前对齐
+		if (to > _map_region->get_size())
+			to = _map_region->get_size() / page * page;
+		if (to <= from)                         // 不足一页，没有可以释放的
+			return true;
+
+		char* base = (char*)_map_region->get_address();
+		return madvise(base + from, to - from, MADV_REMOVE) == 0;  // 释放页面并对文件打洞
+#else
+		return false;
+#endif
+	}
+
 	/**
 	 * @brief 获取映射的文件名
 	 * 
@@ -0,0 +1,403 @@
+﻿/*!
+ * \file OptionGreeks.hpp
+ * \project	WonderTrader
+ *
+ * \brief 期权链隐含波动率和希腊字母服务
+ *
+ * 1、按照配置的期权品种，把期权合约按标的分组成期权链，链内的输入和输出都按列连续存放
+ * 2、期权tick只重算该合约，标的tick重算整条链，定价内核是固定迭代次数、没有分支的循环，编译器可以直接向量化
+ * 3、计算结果写入每条链连续的快照表，策略直接读表，不做拷贝，每行带全表单调递增的更新序号
+ */
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "TimeUtils.hpp"
+#include "StrUtil.hpp"
+#include "SpinMutex.hpp"
+#include "../Includes/FasterDefs.h"
+#include "../Includes/WTSStruct.h"
+#include "../Includes/WTSVariant.hpp"
+#include "../Includes/WTSDataDef.hpp"
+#include "../Includes/WTSContractInfo.hpp"
+#include "../Includes/IBaseDataMgr.h"
+
+NS_WTP_BEGIN
+
+namespace greeks
+{
+	const double INV_SQRT_2PI = 0.39894228040143267794;
+	const double MS_PER_YEAR = 365.0 * 86400000.0;
+
+	//标准正态分布的累积分布函数，Abramowitz-Stegun 26.2.17，误差小于7.5e-8
+	//正负号用copysign处理，没有分支
+	inline double norm_cdf(double x)
+	{
+		double ax = fabs(x);
+		double t = 1.0 / (1.0 + 0.2316419 * ax);
+		double poly = t * (0.319381530 + t * (-0.356563782 + t * (1.781477937 + t * (-1.821255978 + t * 1.330274429))));
+		double p = 1.0 - INV_SQRT_2PI * exp(-0.5 * x * x) * poly;
+		return 0.5 + copysign(p - 0.5, x);
+	}
+
+	inline double norm_pdf(double x)
+	{
+		return INV_SQRT_2PI * exp(-0.5 * x * x);
+	}
+
+	/*
+	 *	批量计算隐含波动率和希腊字母，广义BSM模型，b为持有成本，期货期权b=0
+	 *	所有数组长度都是n，sign为1是看涨，-1是看跌，tau为剩余年化时间
+	 *	隐含波动率用Manaster-Koehler初值加固定次数的牛顿迭代，循环内没有数据相关的分支
+	 *	价格越界、已到期或者迭代结束时定价残差仍然超过容差的合约，输出NaN
+	 */
+	inline void calc_greeks(uint32_t n, double spot, double rate,
+		const double* strike, const double* tau, const double* sign, const double* carry, const double* price,
+		double* iv, double* delta, double* gamma, double* vega, double* theta)
+	{
+		const uint32_t ITERATIONS = 10;
+		const double MIN_VOL = 1e-4;
+		const double MAX_VOL = 5.0;
+		const double TOLERANCE = 1e-6;	//定价残差的相对容差
+		const double NaN = std::numeric_limits<double>::quiet_NaN();
+
+		for (uint32_t i = 0; i < n; i++)
+		{
+			double K = strike[i];
+			double T = fmax(tau[i], 1e-8);
+			double s = sign[i];
+			double b = carry[i];
+			double px = price[i];
+
+			double sqrtT = sqrt(T);
+			double df = exp(-rate * T);
+			double cdf = exp((b - rate) * T);
+			double fwdS = spot * cdf;
+			double fwdK = K * df;
+			double lnSK = log(spot / K);
+
+			//无套利区间，看涨在(S*e^((b-r)T)-K*e^(-rT), S*e^((b-r)T))之间，看跌对称
+			double lower = fmax(s * (fwdS - fwdK), 0.0);
+			double upper = s > 0 ? fwdS : fwdK;
+			bool valid = tau[i] > 0 && spot > 0 && px > lower && px < upper;
+
+			double sigma = sqrt(2.0 * fabs(lnSK + b * T) / T);
+			sigma = fmin(fmax(sigma, 0.2), MAX_VOL);
+			for (uint32_t k = 0; k < ITERATIONS; k++)
+			{
+				double sd = sigma * sqrtT;
+				double d1 = (lnSK + (b + 0.5 * sigma * sigma) * T) / sd;
+				double d2 = d1 - sd;
+				double model = s * (fwdS * norm_cdf(s * d1) - fwdK * norm_cdf(s * d2));
+				double vg = fmax(fwdS * norm_pdf(d1) * sqrtT, 1e-12);
+				sigma = fmin(fmax(sigma - (model - px) / vg, MIN_VOL), MAX_VOL);
+			}
+
+			double sd = sigma * sqrtT;
+			double d1 = (lnSK + (b + 0.5 * sigma * sigma) * T) / sd;
+			double d2 = d1 - sd;
+			double nd1 = norm_pdf(d1);
+			double Nd1 = norm_cdf(s * d1);
+			double Nd2 = norm_cdf(s * d2);
+
+			double thetaY = -fwdS * nd1 * sigma / (2.0 * sqrtT) - s * (b - rate) * fwdS * Nd1 - s * rate * fwdK * Nd2;
+
+			//没有收敛的(比如卡在波动率上下限)不能当成有效结果
+			double fit = s * (fwdS * Nd1 - fwdK * Nd2);
+			valid = valid && fabs(fit - px) <= fmax(px * TOLERANCE, 1e-10);
+
+			iv[i] = valid ? sigma : NaN;
+			delta[i] = valid ? s * cdf * Nd1 : NaN;
+			gamma[i] = valid ? cdf * nd1 / (spot * sd) : NaN;
+			vega[i] = valid ? fwdS * nd1 * sqrtT / 100.0 : NaN;
+			theta[i] = valid ? thetaY / 365.0 : NaN;
+		}
+	}
+
+	//按照seq读取一致的快照，主要给不在数据线程里的读取方用
+	inline void read_snapshot(const WTSOptGreeksStruct* row, WTSOptGreeksStruct& out)
+	{
+		for (;;)
+		{
+			uint64_t seq = row->seq;
+			std::atomic_thread_fence(std::memory_order_acquire);
+			memcpy((void*)&out, (const void*)row, sizeof(WTSOptGreeksStruct));
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if ((seq & 1) == 0 && seq == row->seq)
+				return;
+		}
+	}
+}
+
+class OptionGreeksSvc
+{
+private:
+	//一个标的下的全部期权，输入输出都按列存放，快照表不再扩容，地址固定
+	typedef struct _OptionChain
+	{
+		std::string	_underlying;
+		double		_spot;
+
+		std::vector<double>		_strike;
+		std::vector<int64_t>	_expire_ms;
+		std::vector<double>		_tau;
+		std::vector<double>		_sign;
+		std::vector<double>		_carry;
+		std::vector<double>		_price;
+
+		std::vector<double>		_iv;
+		std::vector<double>		_delta;
+		std::vector<double>		_gamma;
+		std::vector<double>		_vega;
+		std::vector<double>		_theta;
+
+		std::vector<WTSOptGreeksStruct>	_rows;
+
+		//不同的行情线程可能同时推送同一条链的期权和标的，写入整条链都要持有该锁
+		SpinMutex	_mtx;
+		uint32_t	_base_date;
+		int64_t		_base_time;
+
+		_OptionChain() :_spot(0), _base_date(0), _base_time(0) {}
+
+		inline uint32_t size() const { return (uint32_t)_rows.size(); }
+	} OptionChain;
+	typedef std::shared_ptr<OptionChain> OptionChainPtr;
+
+	typedef struct _OptionPos
+	{
+		OptionChain*	_chain;
+		uint32_t		_idx;
+	} OptionPos;
+
+public:
+	OptionGreeksSvc() :_active(false), _rate(0), _use_mid(true), _seq(0) {}
+
+	/*
+	 *	初始化，按照配置的期权品种构建期权链
+	 *	products	期权品种列表，如["SSE.ETFO","CFFEX.IO"]
+	 *	underlyings	可选，品种对应的标的代码前缀，默认是期权的交易所，如{"CFFEX.IO":"SSE."}
+	 *	rate		无风险利率，默认0
+	 *	dividend	现货期权标的的分红率，默认0
+	 *	price		期权价格取值，mid-买卖一中间价(默认)，last-最新价
+	 */
+	bool init(WTSVariant* cfg, IBaseDataMgr* bdMgr)
+	{
+		if (cfg == NULL || !cfg->getBoolean("active") || bdMgr == NULL)
+			return false;
+
+		_rate = cfg->getDouble("rate");
+		double dividend = cfg->getDouble("dividend");
+		_use_mid = wt_stricmp(cfg->getCString("price"), "last") != 0;
+
+		WTSVariant* cfgUnder = cfg->get("underlyings");
+		WTSVariant* cfgProds = cfg->get("products");
+		if (cfgProds == NULL || cfgProds->type() != WTSVariant::VT_Array)
+			return false;
+
+		for (uint32_t i = 0; i < cfgProds->size(); i++)
+		{
+			const char* fullPid = cfgProds->get(i)->asCString();
+			WTSCommodityInfo* commInfo = bdMgr->getCommodity(fullPid);
+			if (commInfo == NULL || !commInfo->isOption())
+				continue;
+
+			std::string prefix = StrUtil::printf("%s.", commInfo->getExchg());
+			if (cfgUnder && cfgUnder->has(fullPid))
+				prefix = cfgUnder->getCString(fullPid);
+
+			//期货期权按Black76计算，持有成本为0
+			double carry = commInfo->isFutOption() ? 0.0 : _rate - dividend;
+
+			for (const auto& code : commInfo->getCodes())
+			{
+				WTSContractInfo* cInfo = bdMgr->getContract(code.c_str(), commInfo->getExchg());
+				if (cInfo == NULL || cInfo->getOptionType() == OT_None || strlen(cInfo->getUnderlying()) == 0)
+					continue;
+
+				std::string underlying = prefix + cInfo->getUnderlying();
+				OptionChainPtr& chain = _chains[underlying];
+				if (chain == NULL)
+				{
+					chain.reset(new OptionChain);
+					chain->_underlying = underlying;
+				}
+
+				chain->_strike.emplace_back(cInfo->getStrikePrice());
+				chain->_expire_ms.emplace_back(TimeUtils::makeTime(cInfo->getExpireDate(), 150000000));
+				chain->_sign.emplace_back(cInfo->getOptionType() == OT_Call ? 1.0 : -1.0);
+				chain->_carry.emplace_back(carry);
+
+				WTSOptGreeksStruct row;
+				wt_strcpy(row.exchg, cInfo->getExchg());
+				wt_strcpy(row.code, cInfo->getCode());
+				row.expire_date = cInfo->getExpireDate();
+				row.is_call = cInfo->getOptionType() == OT_Call ? 1 : 0;
+				row.strike = cInfo->getStrikePrice();
+				chain->_rows.emplace_back(row);
+			}
+		}
+
+		for (auto& v : _chains)
+		{
+			OptionChain* chain = v.second.get();
+			uint32_t cnt = chain->size();
+			chain->_tau.resize(cnt, 0);
+			chain->_price.resize(cnt, 0);
+			chain->_iv.resize(cnt, 0);
+			chain->_delta.resize(cnt, 0);
+			chain->_gamma.resize(cnt, 0);
+			chain->_vega.resize(cnt, 0);
+			chain->_theta.resize(cnt, 0);
+
+			for (uint32_t idx = 0; idx < cnt; idx++)
+			{
+				const WTSOptGreeksStruct& row = chain->_rows[idx];
+				std::string stdCode = StrUtil::printf("%s.%s", row.exchg, row.code);
+				_options[stdCode] = { chain, idx };
+			}
+		}
+
+		_active = !_options.empty();
+		return _active;
+	}
+
+	inline bool		is_active() const { return _active; }
+	inline uint64_t	seq() const { return _seq.load(std::memory_order_relaxed); }
+	inline uint32_t	chain_count() const { return (uint32_t)_chains.size(); }
+	inline uint32_t	option_count() const { return (uint32_t)_options.size(); }
+
+	/*
+	 *	处理tick，标的tick重算整条链，期权tick只重算该合约
+	 *	返回是否有快照被更新
+	 */
+	bool on_tick(const char* stdCode, WTSTickData* curTick)
+	{
+		if (!_active)
+			return false;
+
+		auto oit = _options.find(stdCode);
+		if (oit != _options.end())
+		{
+			const OptionPos& pos = oit->second;
+			OptionChain* chain = pos._chain;
+			double px = curTick->price();
+			if (_use_mid && curTick->bidprice(0) > 0 && curTick->askprice(0) > 0)
+				px = (curTick->bidprice(0) + curTick->askprice(0)) / 2;
+
+			SpinLock lock(chain->_mtx);
+			chain->_price[pos._idx] = px;
+
+			if (chain->_spot <= 0)
+				return false;
+
+			update_chain(chain, curTick->actiondate(), curTick->actiontime(), pos._idx, 1);
+			return true;
+		}
+
+		auto cit = _chains.find(stdCode);
+		if (cit != _chains.end())
+		{
+			OptionChain* chain = cit->second.get();
+			double spot = curTick->price();
+			if (spot <= 0 && curTick->bidprice(0) > 0 && curTick->askprice(0) > 0)
+				spot = (curTick->bidprice(0) + curTick->askprice(0)) / 2;
+			if (spot <= 0)
+				return false;
+
+			SpinLock lock(chain->_mtx);
+			chain->_spot = spot;
+			update_chain(chain, curTick->actiondate(), curTick->actiontime(), 0, chain->size());
+			return true;
+		}
+
+		return false;
+	}
+
+	//单个期权的快照，不存在返回NULL
+	inline const WTSOptGreeksStruct* get_greeks(const char* stdCode) const
+	{
+		auto it = _options.find(stdCode);
+		if (it == _options.end())
+			return NULL;
+
+		return &it->second._chain->_rows[it->second._idx];
+	}
+
+	//整条期权链的快照，按照合约配置的顺序连续存放
+	inline const WTSOptGreeksStruct* get_chain(const char* underlying, uint32_t& count) const
+	{
+		auto it = _chains.find(underlying);
+		if (it == _chains.end())
+		{
+			count = 0;
+			return NULL;
+		}
+
+		count = it->second->size();
+		return it->second->_rows.data();
+	}
+
+private:
+	static inline int64_t to_ms(OptionChain* chain, uint32_t uDate, uint32_t uTime)
+	{
+		if (uDate != chain->_base_date)
+		{
+			chain->_base_date = uDate;
+			chain->_base_time = TimeUtils::makeTime(uDate, 0);
+		}
+
+		return chain->_base_time + (uTime / 10000000 * 3600 + uTime % 10000000 / 100000 * 60) * 1000 + uTime % 100000;
+	}
+
+	//调用方需要持有chain->_mtx
+	void update_chain(OptionChain* chain, uint32_t uDate, uint32_t uTime, uint32_t from, uint32_t cnt)
+	{
+		int64_t now = to_ms(chain, uDate, uTime);
+		for (uint32_t i = from; i < from + cnt; i++)
+			chain->_tau[i] = (double)(chain->_expire_ms[i] - now) / greeks::MS_PER_YEAR;
+
+		greeks::calc_greeks(cnt, chain->_spot, _rate,
+			&chain->_strike[from], &chain->_tau[from], &chain->_sign[from], &chain->_carry[from], &chain->_price[from],
+			&chain->_iv[from], &chain->_delta[from], &chain->_gamma[from], &chain->_vega[from], &chain->_theta[from]);
+
+		//写入期间seq为奇数，写完以后为偶数
+		uint64_t seq = _seq.fetch_add(2, std::memory_order_relaxed) + 2;
+		for (uint32_t i = from; i < from + cnt; i++)
+		{
+			WTSOptGreeksStruct& row = chain->_rows[i];
+			row.seq = seq - 1;
+			std::atomic_thread_fence(std::memory_order_release);
+
+			row.action_date = uDate;
+			row.action_time = uTime;
+			row.underlying = chain->_spot;
+			row.price = chain->_price[i];
+			row.iv = chain->_iv[i];
+			row.delta = chain->_delta[i];
+			row.gamma = chain->_gamma[i];
+			row.vega = chain->_vega[i];
+			row.theta = chain->_theta[i];
+
+			std::atomic_thread_fence(std::memory_order_release);
+			row.seq = seq;
+		}
+	}
+
+private:
+	bool		_active;
+	double		_rate;
+	bool		_use_mid;
+	std::atomic<uint64_t>	_seq;
+
+	wt_hashmap<std::string, OptionChainPtr>	_chains;
+	wt_hashmap<std::string, OptionPos>		_options;
+};
+
+NS_WTP_END
@@ -0,0 +1,310 @@
+﻿/*!
+ * \file PosDetailQueue.hpp
+ * \project	WonderTrader
+ *
+ * \brief CTA持仓明细队列
+ *
+ * 1、明细按开仓顺序存放，平仓只从队头出队，按标签建了索引，按标签查明细不用遍历
+ * 2、持仓量和开仓成本做汇总，每个tick的浮盈直接用汇总值计算，和明细笔数无关
+ * 3、每笔明细的浮盈、最大浮盈、最大浮亏、最高价、最低价在读取的时候才计算，
+ *    计算需要的区间最高价和最低价用单调队列维护，结果和逐tick更新每笔明细完全一致
+ */
+#pragma once
+#include <stdint.h>
+#include <deque>
+#include <string>
+#include <limits>
+#include <algorithm>
+
+#include "decimal.h"
+#include "../Includes/FasterDefs.h"
+
+NS_WTP_BEGIN
+
+/*
+ *	DetailType要求有以下字段:
+ *	_long, _price, _volume, _profit, _max_profit, _max_loss, _max_price, _min_price, _opentag
+ */
+template<typename DetailType>
+class PosDetailQueue
+{
+private:
+	typedef struct _LotNode
+	{
+		DetailType	_detail;	//明细的基准值，读取的时候会把基准之后的行情合并进来
+		double		_seg_hi;	//该笔明细作为最新一笔期间的最高价
+		double		_seg_lo;	//该笔明细作为最新一笔期间的最低价
+
+		_LotNode(const DetailType& d) : _detail(d)
+			, _seg_hi(std::numeric_limits<double>::lowest())
+			, _seg_lo(std::numeric_limits<double>::max())
+		{}
+	} LotNode;
+
+	typedef std::deque<uint64_t>	SeqQueue;
+
+public:
+	PosDetailQueue()
+		: _head_seq(0), _volume(0), _cost(0), _last_px(0), _vol_scale(1)
+		, _rebased(false)
+		, _head_hi(std::numeric_limits<double>::lowest())
+		, _head_lo(std::numeric_limits<double>::max())
+	{}
+
+public:
+	inline bool		empty() const { return _lots.empty(); }
+	inline size_t	size() const { return _lots.size(); }
+
+	//所有明细的持仓量之和
+	inline double	volume() const { return _volume; }
+	//所有明细的开仓金额之和
+	inline double	cost() const { return _cost; }
+
+	/*
+	 *	所有明细按最新价计算的浮盈
+	 *	明细的方向都是一致的，所以直接用汇总值计算
+	 */
+	inline double	dyn_profit() const
+	{
+		if (_lots.empty())
+			return 0;
+
+		double profit = (_last_px*_volume - _cost)*_vol_scale;
+		return _lots.front()._detail._long ? profit : -profit;
+	}
+
+	void emplace_back(const DetailType& d)
+	{
+		uint64_t seq = _head_seq + _lots.size();
+		_lots.emplace_back(d);
+
+		//新的一笔还没有行情，最高价取最小值，所以前面所有没有行情的明细都可以出队
+		push_seq(_hi_q, seq, true);
+		push_seq(_lo_q, seq, false);
+
+		_tag_idx[d._opentag].emplace_back(seq);
+
+		_volume += d._volume;
+		_cost += d._volume*d._price;
+	}
+
+	void pop_front()
+	{
+		if (_lots.empty())
+			return;
+
+		const DetailType& d = _lots.front()._detail;
+		uint64_t seq = _head_seq;
+		if (!_hi_q.empty() && _hi_q.front() == seq)
+			_hi_q.pop_front();
+		if (!_lo_q.empty() && _lo_q.front() == seq)
+			_lo_q.pop_front();
+
+		auto it = _tag_idx.find(d._opentag);
+		if (it != _tag_idx.end())
+		{
+			SeqQueue& seqs = it->second;
+			if (!seqs.empty() && seqs.front() == seq)
+				seqs.pop_front();
+			if (seqs.empty())
+				_tag_idx.erase(it);
+		}
+
+		_volume -= d._volume;
+		_cost -= d._volume*d._price;
+
+		_lots.pop_front();
+		_head_seq++;
+		_rebased = false;
+
+		if (_lots.empty())
+		{
+			_volume = 0;
+			_cost = 0;
+		}
+	}
+
+	/*
+	 *	队头的明细减少数量
+	 *	减完了就出队，没减完的话，先把当前的统计值固化下来，后面的行情用新的数量计算
+	 */
+	void reduce_front(double qty)
+	{
+		if (_lots.empty())
+			return;
+
+		sync(0);
+		DetailType& d = _lots.front()._detail;
+		d._volume -= qty;
+		_volume -= qty;
+		_cost -= qty*d._price;
+
+		if (decimal::eq(d._volume, 0))
+		{
+			pop_front();
+		}
+		else
+		{
+			_rebased = true;
+			_head_hi = std::numeric_limits<double>::lowest();
+			_head_lo = std::numeric_limits<double>::max();
+		}
+	}
+
+	void clear()
+	{
+		_lots.clear();
+		_hi_q.clear();
+		_lo_q.clear();
+		_tag_idx.clear();
+		_head_seq = 0;
+		_volume = 0;
+		_cost = 0;
+		_rebased = false;
+	}
+
+	/*
+	 *	最新价更新，均摊O(1)
+	 *	只更新最新一笔明细的区间极值，以及部分平仓以后的队头极值
+	 */
+	void update(double price, double volScale)
+	{
+		_last_px = price;
+		_vol_scale = volScale;
+		if (_lots.empty())
+			return;
+
+		uint64_t tail = _head_seq + _lots.size() - 1;
+		LotNode& node = _lots.back();
+		if (price > node._seg_hi)
+		{
+			node._seg_hi = price;
+			_hi_q.pop_back();
+			push_seq(_hi_q, tail, true);
+		}
+
+		if (price < node._seg_lo)
+		{
+			node._seg_lo = price;
+			_lo_q.pop_back();
+			push_seq(_lo_q, tail, false);
+		}
+
+		if (_rebased)
+		{
+			_head_hi = std::max(_head_hi, price);
+			_head_lo = std::min(_head_lo, price);
+		}
+	}
+
+	/*
+	 *	下面几个接口返回的明细，动态统计值都已经计算到最新
+	 */
+	inline const DetailType& front() const { return sync(0); }
+	inline const DetailType& back() const { return sync(_lots.size() - 1); }
+	inline const DetailType& at(size_t idx) const { return sync(idx); }
+
+	//按开仓标签查找，同一个标签有多笔的，返回最早的一笔
+	const DetailType* find(const char* tag) const
+	{
+		auto it = _tag_idx.find(tag);
+		if (it == _tag_idx.end() || it->second.empty())
+			return NULL;
+
+		return &sync((size_t)(it->second.front() - _head_seq));
+	}
+
+private:
+	inline const LotNode& node(uint64_t seq) const { return _lots[(size_t)(seq - _head_seq)]; }
+
+	void push_seq(SeqQueue& q, uint64_t seq, bool bHigh)
+	{
+		const LotNode& cur = node(seq);
+		while (!q.empty())
+		{
+			const LotNode& last = node(q.back());
+			if (bHigh ? (last._seg_hi > cur._seg_hi) : (last._seg_lo < cur._seg_lo))
+				break;
+
+			q.pop_back();
+		}
+		q.emplace_back(seq);
+	}
+
+	//从seq开始到最新一笔明细之间的区间极值
+	inline double range_extreme(const SeqQueue& q, uint64_t seq, bool bHigh) const
+	{
+		auto it = std::lower_bound(q.begin(), q.end(), seq);
+		if (it == q.end())
+			return bHigh ? std::numeric_limits<double>::lowest() : std::numeric_limits<double>::max();
+
+		return bHigh ? node(*it)._seg_hi : node(*it)._seg_lo;
+	}
+
+	inline double profit_at(const DetailType& d, double price) const
+	{
+		return d._volume*(price - d._price)*_vol_scale*(d._long ? 1 : -1);
+	}
+
+	/*
+	 *	把基准之后的行情合并到明细里
+	 *	合并是幂等的，合并过的明细再合并一次结果不变
+	 */
+	const DetailType& sync(size_t idx) const
+	{
+		LotNode& n = _lots[idx];
+		DetailType& d = n._detail;
+
+		double hi, lo;
+		if (idx == 0 && _rebased)
+		{
+			hi = _head_hi;
+			lo = _head_lo;
+		}
+		else
+		{
+			uint64_t seq = _head_seq + idx;
+			hi = range_extreme(_hi_q, seq, true);
+			lo = range_extreme(_lo_q, seq, false);
+		}
+
+		//基准以后还没有行情
+		if (hi < lo)
+			return d;
+
+		d._profit = profit_at(d, _last_px);
+
+		double pHi = profit_at(d, hi);
+		double pLo = profit_at(d, lo);
+		double best = std::max(pHi, pLo);
+		double worst = std::min(pHi, pLo);
+		if (best > 0)
+			d._max_profit = std::max(best, d._max_profit);
+		if (worst < 0)
+			d._max_loss = std::min(worst, d._max_loss);
+
+		d._max_price = std::max(d._max_price, hi);
+		d._min_price = std::min(d._min_price, lo);
+		return d;
+	}
+
+private:
+	//统计值是读取的时候才计算的，所以这里要用mutable
+	mutable std::deque<LotNode>	_lots;
+	SeqQueue		_hi_q;		//区间最高价的单调队列，存的是明细序号
+	SeqQueue		_lo_q;		//区间最低价的单调队列
+	wt_hashmap<std::string, SeqQueue>	_tag_idx;	//开仓标签到明细序号的索引
+
+	uint64_t	_head_seq;	//队头明细的序号
+	double		_volume;
+	double		_cost;
+	double		_last_px;
+	double		_vol_scale;
+
+	//队头部分平仓以后，要用新的数量计算，所以单独记录部分平仓以后的极值
+	bool		_rebased;
+	double		_head_hi;
+	double		_head_lo;
+};
+
+NS_WTP_END
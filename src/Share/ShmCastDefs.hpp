@@ -0,0 +1,202 @@
+﻿/*!
+ * \file ShmCastDefs.hpp
+ * \project	WonderTrader
+ *
+ * \brief 共享内存行情广播的数据结构定义，ShmCaster和ParserShm共用
+ *
+ * 行情可以按照交易所、数据类型和代码哈希拆分到多个分区，每个分区是一个独立的环形队列文件
+ * 分区目录写在<path>.parts中，读取端根据自己的订阅只挂载需要的分区
+ * 一条数据按照分区目录的顺序匹配，落到第一个匹配的分区，最后一个分区是兜底的默认队列，即<path>本身
+ */
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "StrUtil.hpp"
+#include "../Includes/WTSStruct.h"
+
+NS_WTP_BEGIN
+namespace shmcast
+{
+	typedef enum tagCastDataType
+	{
+		CDT_Tick = 0,	//tick
+		CDT_OrdQue,		//委托队列
+		CDT_OrdDtl,		//逐笔委托
+		CDT_Trans,		//逐笔成交
+		CDT_Count
+	} CastDataType;
+
+	const uint32_t ALL_TYPES_MASK = (1 << CDT_Count) - 1;
+
+	const char PARTS_FLAG[] = "WTSHMP\0";
+
+	const uint32_t MAX_PARTITIONS = 64;
+
+#pragma pack(push, 8)
+	typedef struct _DataItem
+	{
+		uint32_t	_type;	//数据类型， 0-tick,1-委托队列,2-逐笔委托,3-逐笔成交
+		union
+		{
+			WTSTickStruct	_tick;
+			WTSOrdQueStruct _queue;
+			WTSOrdDtlStruct	_order;
+			WTSTransStruct	_trans;
+		};
+
+		//tick是联合体中最大的成员，值初始化tick即可清零整个联合体
+		_DataItem() : _type(0), _tick() {}
+	} DataItem;
+
+	template <int N = 8 * 1024>
+	struct _DataQueue
+	{
+		uint64_t	_capacity = N;
+		volatile uint64_t	_readable;
+		volatile uint64_t	_writable;
+		uint32_t	_pid;
+		DataItem	_items[N];
+
+		_DataQueue() :_readable(UINT64_MAX), _writable(0), _pid(0) {}
+	};
+
+	typedef _DataQueue<8 * 1024>	CastQueue;
+
+	typedef struct _PartitionEntry
+	{
+		char		_path[256];		//分区队列文件
+		char		_exchg[128];	//交易所，逗号分隔，为空表示全部交易所
+		uint32_t	_type_mask;		//数据类型掩码，第i位对应CastDataType
+		uint32_t	_buckets;		//代码哈希的桶数，1表示不按代码拆分
+		uint32_t	_bucket;		//本分区对应的桶号
+		uint32_t	_reserved;
+	} PartitionEntry;
+
+	typedef struct _PartitionCatalog
+	{
+		char		_flag[8];
+		volatile uint32_t	_pid;	//写入进程的pid，datakit重启以后会变化
+		uint32_t	_count;
+		PartitionEntry	_parts[MAX_PARTITIONS];
+	} PartitionCatalog;
+#pragma pack(pop)
+
+	inline std::string catalog_path(const char* path)
+	{
+		std::string ret = path;
+		ret += ".parts";
+		return ret;
+	}
+
+	/*
+	 *	代码哈希(FNV-1a)，读写两端必须一致
+	 */
+	inline uint32_t code_hash(const char* code)
+	{
+		uint32_t h = 2166136261U;
+		for (; *code != '\0'; code++)
+		{
+			h ^= (uint8_t)*code;
+			h *= 16777619U;
+		}
+		return h;
+	}
+
+	/*
+	 *	把"tick,ordque,orddtl,trans"格式的类型列表转成掩码，为空表示全部类型
+	 */
+	inline uint32_t parse_type_mask(const char* types)
+	{
+		if (types == NULL || strlen(types) == 0)
+			return ALL_TYPES_MASK;
+
+		uint32_t mask = 0;
+		StringVector ay = StrUtil::split(types, ",");
+		for (std::string& t : ay)
+		{
+			StrUtil::trim(t);
+			StrUtil::toLowerCase(t);
+			if (t == "tick")
+				mask |= 1 << CDT_Tick;
+			else if (t == "ordque")
+				mask |= 1 << CDT_OrdQue;
+			else if (t == "orddtl")
+				mask |= 1 << CDT_OrdDtl;
+			else if (t == "trans")
+				mask |= 1 << CDT_Trans;
+		}
+		return mask;
+	}
+
+	/*
+	 *	分区的匹配规则，读写两端共用
+	 */
+	class PartitionRule
+	{
+	public:
+		PartitionRule() :_type_mask(ALL_TYPES_MASK), _buckets(1), _bucket(0){}
+
+		PartitionRule(const PartitionEntry& entry)
+			: _type_mask(entry._type_mask)
+			, _buckets(entry._buckets == 0 ? 1 : entry._buckets)
+			, _bucket(entry._bucket)
+		{
+			if (strlen(entry._exchg) > 0)
+			{
+				_exchgs = StrUtil::split(entry._exchg, ",");
+				for (std::string& e : _exchgs)
+					StrUtil::trim(e);
+			}
+		}
+
+		inline bool matches(uint32_t dType, const char* exchg, const char* code) const
+		{
+			if ((_type_mask & (1 << dType)) == 0)
+				return false;
+
+			if (!_exchgs.empty())
+			{
+				bool bFound = false;
+				for (const std::string& e : _exchgs)
+				{
+					if (e == exchg)
+					{
+						bFound = true;
+						break;
+					}
+				}
+
+				if (!bFound)
+					return false;
+			}
+
+			return _buckets == 1 || code_hash(code) % _buckets == _bucket;
+		}
+
+	private:
+		StringVector	_exchgs;
+		uint32_t		_type_mask;
+		uint32_t		_buckets;
+		uint32_t		_bucket;
+	};
+
+	/*
+	 *	按照分区目录的顺序找到第一个匹配的分区
+	 *	返回分区的序号，没有匹配的分区返回-1
+	 */
+	typedef std::vector<PartitionRule>	PartitionRules;
+
+	inline int32_t route(const PartitionRules& rules, uint32_t dType, const char* exchg, const char* code)
+	{
+		for (std::size_t i = 0; i < rules.size(); i++)
+		{
+			if (rules[i].matches(dType, exchg, code))
+				return (int32_t)i;
+		}
+		return -1;
+	}
+}
+NS_WTP_END
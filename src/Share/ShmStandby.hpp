@@ -0,0 +1,540 @@
+﻿/*!
+ * \file ShmStandby.hpp
+ * \project	WonderTrader
+ *
+ * \brief 基于共享内存的主备热切换组件
+ *
+ * 同一台机器上的主备两个进程通过同名共享内存协作：
+ * 1、租约：共享内存头部记录租约编号(epoch)和主进程的心跳，主进程定时刷新心跳
+ *    备进程发现心跳超时以后，把epoch加1抢占租约，成为新的主进程
+ * 2、fencing：下单、撤单之前检查本进程持有的epoch是否仍然是当前的epoch
+ *    被抢占的旧主进程即使恢复运行，也不能再发出任何交易指令
+ * 3、状态日志：主进程把状态变化(策略数据、用户数据、组合数据、本地订单号等)写入环形日志
+ *    备进程持续读取并保留每个key的最新状态，接管时一次性恢复到引擎中
+ *    备进程读取落后太多或者刚刚启动时，会请求主进程把全部最新状态重新写一遍
+ */
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <functional>
+
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include "StdUtils.hpp"
+#include "SpinMutex.hpp"
+#include "../Includes/FasterDefs.h"
+
+#ifdef _MSC_VER
+#include <process.h>
+#define wt_getpid	_getpid
+#else
+#include <unistd.h>
+#define wt_getpid	getpid
+#endif
+
+#pragma warning(disable:4200)
+
+NS_WTP_BEGIN
+
+/*
+ *	状态日志记录类型
+ */
+typedef enum tagStandbyRecordType
+{
+	SRT_Padding = 0,	//填充记录，环形日志尾部放不下一条记录时使用
+	SRT_OrderID,		//本地订单号，key为交易通道id
+	SRT_PortData,		//组合数据，即portfolio/datas.json的内容
+	SRT_StraData,		//策略数据，key为策略名称
+	SRT_StraUserData,	//策略用户数据，key为策略名称
+	SRT_UftPosition		//UFT策略持仓块，key为策略名称
+} StandbyRecordType;
+
+class ShmStandby
+{
+private:
+	static const uint32_t STANDBY_VERSION = 1;
+	static const uint32_t MAX_KEY_LENGTH = 64;
+
+	typedef struct _StandbyHeader
+	{
+		std::atomic<uint32_t>	_inited;	//0-未初始化，1-初始化中，2-已初始化
+		uint32_t				_version;
+		uint64_t				_capacity;	//日志区大小
+
+		std::atomic<uint64_t>	_epoch;		//租约编号，每次接管加1
+		std::atomic<uint64_t>	_writer;	//正在写日志的epoch，0表示没有写入
+		std::atomic<uint32_t>	_leader;	//主进程的pid
+		std::atomic<uint32_t>	_snapshot;	//备进程请求全量状态的标记
+		std::atomic<int64_t>	_heartbeat;	//主进程的心跳，单调时钟的毫秒数
+		std::atomic<uint64_t>	_write_pos;	//日志写入位置，单调递增，对容量取余为实际偏移
+		std::atomic<uint64_t>	_seq;		//记录序号
+	} StandbyHeader;
+
+	typedef struct _StandbyRecord
+	{
+		uint32_t	_size;		//整条记录的大小，8字节对齐
+		uint32_t	_type;
+		uint64_t	_seq;
+		uint32_t	_len;		//数据长度
+		char		_key[MAX_KEY_LENGTH];
+		char		_data[0];
+	} StandbyRecord;
+
+	typedef struct _LatestItem
+	{
+		uint32_t	_type;
+		std::string	_key;
+		std::string	_data;
+	} LatestItem;
+	typedef wt_hashmap<std::string, LatestItem> LatestMap;
+
+public:
+	/*
+	 *	读到一条状态记录
+	 */
+	typedef std::function<void(uint32_t rtype, const char* key, const char* data, std::size_t len)>	RecordHandler;
+	/*
+	 *	角色变化：接管成功(true)，被其他进程抢占(false)
+	 */
+	typedef std::function<void(bool bLeader)>	RoleHandler;
+
+	typedef std::function<void(const char* message)>	StandbyLogger;
+
+public:
+	ShmStandby()
+		: _obj(NULL), _region(NULL), _header(NULL), _buffer(NULL)
+		, _my_epoch(0), _read_pos(0), _lost(false), _stopped(true)
+		, _timeout(100), _hb_span(10)
+	{
+	}
+
+	~ShmStandby()
+	{
+		stop();
+
+		if (_header && is_leader())
+			_header->_heartbeat.store(0);
+
+		if (_region)
+			delete _region;
+
+		if (_obj)
+			delete _obj;
+	}
+
+public:
+	/*
+	 *	打开或者创建共享内存
+	 *	@name		共享内存名称，主备进程必须一致
+	 *	@capacity	日志区大小，已经存在的共享内存以原大小为准
+	 *	@timeout	心跳超时时间(毫秒)，超时以后备进程接管
+	 *	@hbSpan		心跳间隔(毫秒)
+	 */
+	bool init(const char* name, uint64_t capacity, uint32_t timeout, uint32_t hbSpan, StandbyLogger logger = nullptr)
+	{
+		namespace bip = boost::interprocess;
+
+		_logger = logger;
+		_timeout = timeout;
+		_hb_span = hbSpan;
+		try
+		{
+			_obj = new bip::shared_memory_object(bip::open_or_create, name, bip::read_write);
+			bip::offset_t curSize = 0;
+			_obj->get_size(curSize);
+			if (curSize == 0)
+				_obj->truncate(sizeof(StandbyHeader) + capacity);
+
+			_region = new bip::mapped_region(*_obj, bip::read_write);
+		}
+		catch (...)
+		{
+			log("opening shared memory of standby group failed");
+			return false;
+		}
+
+		_header = (StandbyHeader*)_region->get_address();
+		_buffer = (char*)_region->get_address() + sizeof(StandbyHeader);
+
+		uint32_t expected = 0;
+		if (_header->_inited.compare_exchange_strong(expected, 1))
+		{
+			_header->_version = STANDBY_VERSION;
+			_header->_capacity = _region->get_size() - sizeof(StandbyHeader);
+			_header->_epoch = 0;
+			_header->_writer = 0;
+			_header->_leader = 0;
+			_header->_snapshot = 0;
+			_header->_heartbeat = 0;
+			_header->_write_pos = 0;
+			_header->_seq = 0;
+			_header->_inited.store(2);
+		}
+		else
+		{
+			while (_header->_inited.load() != 2)
+				std::this_thread::yield();
+		}
+
+		if (_header->_version != STANDBY_VERSION)
+		{
+			log("version of standby shared memory mismatch");
+			return false;
+		}
+
+		//单条记录不能超过日志区的1/8，读取时按这个余量检查数据是否被覆盖
+		_max_record = _header->_capacity / 8;
+		//新加入的进程从当前位置开始读，历史状态通过全量请求获取
+		_read_pos = _header->_write_pos.load();
+		return true;
+	}
+
+	inline bool is_inited() const { return _header != NULL; }
+
+	/*
+	 *	当前进程是否持有有效的租约
+	 *	下单撤单之前调用，这就是fencing检查
+	 */
+	inline bool is_leader() const
+	{
+		return _my_epoch != 0 && _header->_epoch.load(std::memory_order_acquire) == _my_epoch;
+	}
+
+	inline uint64_t epoch() const { return _my_epoch; }
+
+	/*
+	 *	主进程是否还活着
+	 */
+	inline bool is_leader_alive() const
+	{
+		int64_t hb = _header->_heartbeat.load(std::memory_order_acquire);
+		return hb != 0 && now() - hb <= (int64_t)_timeout;
+	}
+
+	/*
+	 *	尝试获取租约
+	 *	@bForce	是否忽略当前主进程的心跳，一般只在主进程已经确认退出时使用
+	 */
+	bool try_acquire(bool bForce = false)
+	{
+		if (is_leader())
+			return true;
+
+		if (!bForce && is_leader_alive())
+			return false;
+
+		uint64_t curEpoch = _header->_epoch.load();
+		if (!_header->_epoch.compare_exchange_strong(curEpoch, curEpoch + 1))
+			return false;
+
+		_my_epoch = curEpoch + 1;
+		_header->_leader.store(wt_getpid());
+		_header->_heartbeat.store(now(), std::memory_order_release);
+
+		//接管以后先把全量状态写一遍，保证其他备进程的状态和新的主进程一致
+		_header->_snapshot.store(1);
+		return true;
+	}
+
+	inline void heartbeat()
+	{
+		if (is_leader())
+			_header->_heartbeat.store(now(), std::memory_order_release);
+	}
+
+	/*
+	 *	写入一条状态记录，只有主进程写入，同时保留在最新状态表中
+	 */
+	bool append(uint32_t rtype, const char* key, const char* data, std::size_t len)
+	{
+		if (!is_leader())
+			return false;
+
+		SpinLock lock(_mtx_write);
+		LatestItem& item = _latest[make_key(rtype, key)];
+		item._type = rtype;
+		item._key = key;
+		item._data.assign(data, len);
+
+		return write_record(rtype, key, data, len);
+	}
+
+	/*
+	 *	读取新的状态记录，只有备进程调用
+	 *	如果读取落后太多，日志已经被覆盖，就请求主进程重新写一遍全量状态
+	 */
+	uint32_t poll(RecordHandler cb)
+	{
+		uint32_t count = 0;
+		uint64_t wPos = _header->_write_pos.load(std::memory_order_acquire);
+		if (wPos - _read_pos > _header->_capacity - _max_record)
+		{
+			if (!_lost)
+				log("standby journal overrun, requesting snapshot");
+			_lost = true;
+			_read_pos = wPos;
+			_header->_snapshot.store(1);
+			return 0;
+		}
+
+		uint64_t capacity = _header->_capacity;
+		while (_read_pos < wPos)
+		{
+			uint64_t offset = _read_pos % capacity;
+			if (capacity - offset < sizeof(StandbyRecord))
+			{
+				_read_pos += capacity - offset;
+				continue;
+			}
+
+			StandbyRecord* rec = (StandbyRecord*)(_buffer + offset);
+			uint32_t rtype = rec->_type;
+			uint32_t rsize = rec->_size;
+			if (rtype != SRT_Padding)
+			{
+				char key[MAX_KEY_LENGTH];
+				memcpy(key, rec->_key, MAX_KEY_LENGTH);
+				_read_buf.assign(rec->_data, rec->_len);
+
+				//拷贝完成以后再确认一下这段数据没有被写入方覆盖
+				if (_header->_write_pos.load(std::memory_order_acquire) - _read_pos > capacity - _max_record)
+					break;
+
+				{
+					SpinLock lock(_mtx_write);
+					LatestItem& item = _latest[make_key(rtype, key)];
+					item._type = rtype;
+					item._key = key;
+					item._data = _read_buf;
+				}
+
+				if (cb)
+					cb(rtype, key, _read_buf.data(), _read_buf.size());
+				count++;
+			}
+
+			_read_pos += rsize;
+		}
+
+		if (count > 0)
+			_lost = false;
+
+		return count;
+	}
+
+	/*
+	 *	遍历最新状态表，接管时用于恢复引擎状态
+	 */
+	void enum_latest(RecordHandler cb)
+	{
+		//先拷贝一份，回调里可能会写入新的状态
+		LatestMap items;
+		{
+			SpinLock lock(_mtx_write);
+			items = _latest;
+		}
+
+		for (auto& m : items)
+		{
+			const LatestItem& item = m.second;
+			cb(item._type, item._key.c_str(), item._data.data(), item._data.size());
+		}
+	}
+
+	/*
+	 *	启动后台线程
+	 *	主进程定时刷新心跳，响应全量请求；备进程读取日志，主进程心跳超时以后接管
+	 */
+	void start(RecordHandler cbRecord, RoleHandler cbRole)
+	{
+		if (!_stopped)
+			return;
+
+		_stopped = false;
+		if (!is_leader())
+			_header->_snapshot.store(1);
+
+		_thrd_worker.reset(new StdThread([this, cbRecord, cbRole]() {
+			while (!_stopped)
+			{
+				if (_my_epoch != 0)
+				{
+					if (!is_leader())
+					{
+						log("lease of standby group taken over by another process");
+						_my_epoch = 0;
+						_read_pos = _header->_write_pos.load();
+						if (cbRole)
+							cbRole(false);
+						continue;
+					}
+
+					heartbeat();
+
+					uint32_t expected = 1;
+					if (_header->_snapshot.compare_exchange_strong(expected, 0))
+						write_snapshot();
+
+					std::this_thread::sleep_for(std::chrono::milliseconds(_hb_span));
+				}
+				else
+				{
+					poll(cbRecord);
+
+					if (!is_leader_alive() && try_acquire())
+					{
+						//接管之前把剩余的日志读完
+						poll(cbRecord);
+						log("lease of standby group acquired");
+						if (cbRole)
+							cbRole(true);
+						continue;
+					}
+
+					std::this_thread::sleep_for(std::chrono::milliseconds(1));
+				}
+			}
+		}));
+	}
+
+	void stop()
+	{
+		if (_stopped)
+			return;
+
+		_stopped = true;
+		if (_thrd_worker)
+			_thrd_worker->join();
+		_thrd_worker.reset();
+	}
+
+private:
+	static inline int64_t now()
+	{
+		return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static inline std::string make_key(uint32_t rtype, const char* key)
+	{
+		std::string ret(1, (char)('0' + rtype));
+		ret += key;
+		return ret;
+	}
+
+	inline void log(const char* message)
+	{
+		if (_logger)
+			_logger(message);
+	}
+
+	/*
+	 *	共享内存里的写锁，锁里记录持有者的epoch
+	 *	如果持有者的epoch已经过期，说明持有者已经被抢占，可以直接接管这把锁
+	 */
+	bool lock_writer()
+	{
+		for (;;)
+		{
+			uint64_t cur = _header->_writer.load();
+			if ((cur == 0 || cur < _header->_epoch.load()) && _header->_writer.compare_exchange_weak(cur, _my_epoch))
+				break;
+
+			std::this_thread::yield();
+		}
+
+		if (!is_leader())
+		{
+			unlock_writer();
+			return false;
+		}
+
+		return true;
+	}
+
+	inline void unlock_writer()
+	{
+		uint64_t expected = _my_epoch;
+		_header->_writer.compare_exchange_strong(expected, 0);
+	}
+
+	bool write_record(uint32_t rtype, const char* key, const char* data, std::size_t len)
+	{
+		std::size_t rsize = (sizeof(StandbyRecord) + len + 7) & ~((std::size_t)7);
+		if (rsize > _max_record)
+		{
+			log("standby record too large, ignored");
+			return false;
+		}
+
+		if (!lock_writer())
+			return false;
+
+		uint64_t capacity = _header->_capacity;
+		uint64_t wPos = _header->_write_pos.load(std::memory_order_relaxed);
+		uint64_t offset = wPos % capacity;
+		if (capacity - offset < rsize)
+		{
+			//尾部放不下，写一条填充记录，然后从头开始写
+			if (capacity - offset >= sizeof(StandbyRecord))
+			{
+				StandbyRecord* pad = (StandbyRecord*)(_buffer + offset);
+				pad->_type = SRT_Padding;
+				pad->_size = (uint32_t)(capacity - offset);
+				pad->_len = 0;
+			}
+			wPos += capacity - offset;
+			offset = 0;
+		}
+
+		StandbyRecord* rec = (StandbyRecord*)(_buffer + offset);
+		rec->_size = (uint32_t)rsize;
+		rec->_type = rtype;
+		rec->_seq = _header->_seq.fetch_add(1) + 1;
+		rec->_len = (uint32_t)len;
+		strncpy(rec->_key, key, MAX_KEY_LENGTH - 1);
+		rec->_key[MAX_KEY_LENGTH - 1] = '\0';
+		memcpy(rec->_data, data, len);
+
+		_header->_write_pos.store(wPos + rsize, std::memory_order_release);
+
+		unlock_writer();
+		return true;
+	}
+
+	void write_snapshot()
+	{
+		SpinLock lock(_mtx_write);
+		for (auto& m : _latest)
+		{
+			const LatestItem& item = m.second;
+			write_record(item._type, item._key.c_str(), item._data.data(), item._data.size());
+		}
+	}
+
+private:
+	boost::interprocess::shared_memory_object*	_obj;
+	boost::interprocess::mapped_region*			_region;
+	StandbyHeader*	_header;
+	char*			_buffer;
+	uint64_t		_max_record;
+
+	std::atomic<uint64_t>	_my_epoch;	//本进程持有的租约编号，0表示没有租约
+	uint64_t		_read_pos;
+	std::string		_read_buf;
+	bool			_lost;
+
+	SpinMutex		_mtx_write;
+	LatestMap		_latest;	//主进程是已写入的最新状态，备进程是已读到的最新状态
+
+	StdThreadPtr	_thrd_worker;
+	std::atomic<bool>	_stopped;
+	uint32_t		_timeout;
+	uint32_t		_hb_span;
+	StandbyLogger	_logger;
+};
+
+NS_WTP_END
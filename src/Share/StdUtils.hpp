@@ -31,6 +31,7 @@
 #include <memory>  // 包含智能指针支持
 #include <thread>  // 包含线程支持
 #include <mutex>  // 包含互斥量支持
+#include <shared_mutex>  // 包含读写锁支持
 #include <condition_variable>  // 包含条件变量支持
 #include <stdint.h>  // 包含固定大小整数类型
 #include <string>  // 包含字符串支持
@@ -54,6 +55,10 @@ typedef std::condition_variable_any	StdCondVariable;  // 任意类型互斥量
 
 typedef std::unique_lock<StdUniqueMutex>	StdUniqueLock;  // 唯一锁类型别名，RAII风格的锁管理
 
+typedef std::shared_mutex					StdSharedMutex;  // 读写锁类型别名
+typedef std::shared_lock<StdSharedMutex>	StdSharedLock;  // 读写锁的共享锁
+typedef std::unique_lock<StdSharedMutex>	StdExclusiveLock;  // 读写锁的独占锁
+
 /**
  * @class StdLocker
  * @brief 标准锁RAII包装器模板类
@@ -0,0 +1,675 @@
+﻿/*!
+ * \file StraProfiler.hpp
+ * \project	WonderTrader
+ *
+ * \brief 策略回调耗时统计和慢策略隔离
+ *
+ * 1、每个策略每种回调(tick、bar、计算、L2、事件)统计墙钟耗时的分布，CPU耗时按调用次数抽样
+ *    耗时分布用固定的对数桶直方图记录，写入只有relaxed的原子加，没有锁
+ * 2、按照统计窗口汇总，输出窗口内的次数、均值、p50、p99和最大值
+ * 3、窗口p99连续超过阈值的策略按照配置的策略处理：
+ *    warn		只告警
+ *    isolate	把该策略的回调投递到独立的线程，不再拖慢同一分发线程上的其他策略
+ *    conflate	在isolate的基础上，积压的同代码tick只保留最新的一笔
+ */
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <future>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "StdUtils.hpp"
+#include "StrUtil.hpp"
+#include "../Includes/FasterDefs.h"
+#include "../Includes/WTSVariant.hpp"
+
+NS_WTP_BEGIN
+
+typedef enum tagProfileCallback
+{
+	PCB_Tick = 0,	//on_tick
+	PCB_Bar,		//on_bar
+	PCB_Calc,		//on_schedule/on_calculate
+	PCB_L2,			//委托队列、逐笔委托、逐笔成交
+	PCB_Event,		//初始化、交易日开始结束等
+	PCB_Count
+} ProfileCallback;
+
+inline const char* profile_callback_name(uint32_t cbType)
+{
+	static const char* NAMES[PCB_Count] = { "tick", "bar", "calc", "l2", "event" };
+	return cbType < PCB_Count ? NAMES[cbType] : "";
+}
+
+typedef enum tagSlowPolicy
+{
+	SP_Warn = 0,
+	SP_Isolate,
+	SP_Conflate
+} SlowPolicy;
+
+/*
+ *	耗时直方图
+ *	每个2的幂次区间再分4个子桶，相对误差不超过25%，最大统计到4秒多
+ *	同一个策略的回调可能在多个行情线程、线程池和工作线程上执行，写入用原子加，汇总线程只读
+ */
+class LatencyHist
+{
+public:
+	static const uint32_t BUCKETS = 128;
+
+	LatencyHist()
+	{
+		for (uint32_t i = 0; i < BUCKETS; i++)
+			_buckets[i].store(0, std::memory_order_relaxed);
+	}
+
+	static inline uint32_t bucket_of(uint64_t ns)
+	{
+		if (ns < 4)
+			return (uint32_t)ns;
+
+		uint32_t msb = 63;
+		while (((ns >> msb) & 1) == 0)
+			msb--;
+
+		uint32_t idx = (msb - 1) * 4 + (uint32_t)((ns >> (msb - 2)) & 3);
+		return idx < BUCKETS ? idx : BUCKETS - 1;
+	}
+
+	//桶的上界，汇总的时候用上界作为估计值
+	static inline uint64_t upper_of(uint32_t idx)
+	{
+		if (idx < 4)
+			return idx + 1;
+
+		uint32_t msb = idx / 4 + 1;
+		uint32_t sub = idx % 4;
+		return (uint64_t)(5 + sub) << (msb - 2);
+	}
+
+	inline void add(uint64_t ns)
+	{
+		_buckets[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+	}
+
+	inline void snapshot(uint32_t* out) const
+	{
+		for (uint32_t i = 0; i < BUCKETS; i++)
+			out[i] = _buckets[i].load(std::memory_order_relaxed);
+	}
+
+	static uint64_t percentile(const uint32_t* buckets, uint64_t total, double pct)
+	{
+		if (total == 0)
+			return 0;
+
+		uint64_t target = (uint64_t)(total * pct);
+		if (target >= total)
+			target = total - 1;
+
+		uint64_t acc = 0;
+		for (uint32_t i = 0; i < BUCKETS; i++)
+		{
+			acc += buckets[i];
+			if (acc > target)
+				return upper_of(i);
+		}
+
+		return upper_of(BUCKETS - 1);
+	}
+
+private:
+	std::atomic<uint32_t>	_buckets[BUCKETS];
+};
+
+/*
+ *	单个回调类型的统计
+ *	写入有多个线程，计数都用原子加，汇总线程用上一次的快照计算窗口增量
+ */
+typedef struct _CallbackStat
+{
+	LatencyHist				_hist;
+	std::atomic<uint64_t>	_count;
+	std::atomic<uint64_t>	_wall_ns;
+	std::atomic<uint64_t>	_max_ns;	//窗口内最大值，汇总的时候清零
+	std::atomic<uint64_t>	_cpu_ns;
+	std::atomic<uint64_t>	_cpu_samples;
+
+	//汇总线程使用
+	uint32_t	_last_buckets[LatencyHist::BUCKETS];
+	uint64_t	_last_count;
+	uint64_t	_last_wall;
+	uint64_t	_last_cpu;
+	uint64_t	_last_cpu_samples;
+
+	_CallbackStat() :_count(0), _wall_ns(0), _max_ns(0), _cpu_ns(0), _cpu_samples(0)
+		, _last_count(0), _last_wall(0), _last_cpu(0), _last_cpu_samples(0)
+	{
+		memset(_last_buckets, 0, sizeof(_last_buckets));
+	}
+
+	inline void record(uint64_t wall, uint64_t cpu, bool bCpu)
+	{
+		_hist.add(wall);
+		_count.fetch_add(1, std::memory_order_relaxed);
+		_wall_ns.fetch_add(wall, std::memory_order_relaxed);
+		uint64_t curMax = _max_ns.load(std::memory_order_relaxed);
+		while (wall > curMax && !_max_ns.compare_exchange_weak(curMax, wall, std::memory_order_relaxed));
+
+		if (bCpu)
+		{
+			_cpu_ns.fetch_add(cpu, std::memory_order_relaxed);
+			_cpu_samples.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+} CallbackStat;
+
+/*
+ *	慢策略的独立工作线程
+ *	任务按照投递顺序执行，开启合并以后，队列里还没执行的同key任务会被新任务替换
+ *	没有key的任务是屏障，之前的任务不会再被合并，以保证bar、计算等回调前后的顺序
+ */
+class StraWorker
+{
+public:
+	typedef std::function<void()>	Task;
+
+	StraWorker(bool bConflate) :_conflate(bConflate), _stopped(false), _running(false), _conflated(0) {}
+	~StraWorker() { stop(); }
+
+	inline bool is_conflating() const { return _conflate; }
+
+	//当前线程是不是某个策略工作线程，数据管理器据此决定是否返回数据快照
+	static inline bool on_worker_thread() { return worker_flag(); }
+	inline uint64_t conflated() const { return _conflated.load(std::memory_order_relaxed); }
+
+	std::size_t backlog()
+	{
+		StdUniqueLock lock(_mtx);
+		return _queue.size();
+	}
+
+	void start()
+	{
+		if (_thrd)
+			return;
+
+		StdUniqueLock lock(_mtx);
+		_running = true;
+		_thrd.reset(new StdThread([this]() {
+			worker_flag() = true;
+			while (true)
+			{
+				ItemPtr item;
+				{
+					StdUniqueLock lock(_mtx);
+					while (!_stopped && _queue.empty())
+						_cond.wait(lock);
+
+					//队列清空以后才退出，退出前一直在锁内，post_and_wait据此判断任务会不会被执行
+					if (_queue.empty())
+					{
+						_running = false;
+						break;
+					}
+
+					item = _queue.front();
+					_queue.pop_front();
+					if (!item->_key.empty())
+					{
+						auto it = _pending.find(item->_key);
+						if (it != _pending.end() && it->second == item)
+							_pending.erase(it);
+					}
+				}
+
+				item->_task();
+			}
+		}));
+	}
+
+	void stop()
+	{
+		{
+			StdUniqueLock lock(_mtx);
+			if (_stopped)
+				return;
+
+			_stopped = true;
+		}
+		_cond.notify_all();
+
+		if (_thrd)
+		{
+			_thrd->join();
+			_thrd.reset();
+		}
+	}
+
+	void post(const char* key, Task task)
+	{
+		{
+			StdUniqueLock lock(_mtx);
+			if (_conflate && key != NULL && key[0] != '\0')
+			{
+				auto it = _pending.find(key);
+				if (it != _pending.end())
+				{
+					//还没执行，直接替换成最新的
+					it->second->_task = std::move(task);
+					_conflated.fetch_add(1, std::memory_order_relaxed);
+					return;
+				}
+
+				ItemPtr item(new Item(key, std::move(task)));
+				_pending[item->_key] = item;
+				_queue.emplace_back(item);
+			}
+			else
+			{
+				_pending.clear();
+				_queue.emplace_back(ItemPtr(new Item("", std::move(task))));
+			}
+		}
+		_cond.notify_all();
+	}
+
+	/*
+	 *	投递并等待执行完成
+	 *	工作线程没有启动或者已经退出，以及在工作线程内部调用时，直接在当前线程执行
+	 *	正在停止的工作线程会先把队列执行完再退出，所以这时仍然投递
+	 */
+	void post_and_wait(Task task)
+	{
+		std::shared_ptr<std::promise<void>> done(new std::promise<void>());
+		std::future<void> fut = done->get_future();
+		{
+			StdUniqueLock lock(_mtx);
+			if (_running && _thrd->get_id() != std::this_thread::get_id())
+			{
+				_pending.clear();
+				_queue.emplace_back(ItemPtr(new Item("", [task, done]() {
+					task();
+					done->set_value();
+				})));
+			}
+			else
+			{
+				lock.unlock();
+				task();
+				return;
+			}
+		}
+		_cond.notify_all();
+		fut.wait();
+	}
+
+private:
+	static inline bool& worker_flag()
+	{
+		thread_local static bool bWorker = false;
+		return bWorker;
+	}
+
+	typedef struct _Item
+	{
+		std::string	_key;
+		Task		_task;
+
+		_Item(const char* key, Task&& task) :_key(key), _task(std::move(task)) {}
+	} Item;
+	typedef std::shared_ptr<Item>	ItemPtr;
+
+	bool					_conflate;
+	StdUniqueMutex			_mtx;
+	StdCondVariable			_cond;
+	StdThreadPtr			_thrd;
+	bool					_stopped;
+	bool					_running;	//工作线程还在处理队列
+	std::deque<ItemPtr>		_queue;
+	wt_hashmap<std::string, ItemPtr>	_pending;
+	std::atomic<uint64_t>	_conflated;
+};
+typedef std::shared_ptr<StraWorker>	StraWorkerPtr;
+
+class StraProfile
+{
+public:
+	StraProfile(uint32_t sid, const char* name) :_sid(sid), _name(name), _calls(0)
+		, _slow_windows(0), _isolated(false), _last_conflated(0) {}
+
+	inline uint32_t		id() const { return _sid; }
+	inline const char*	name() const { return _name.c_str(); }
+
+	inline bool			is_isolated() const { return _isolated.load(std::memory_order_acquire); }
+	inline StraWorker*	worker() { return _worker.get(); }
+
+	inline CallbackStat&	stat(uint32_t cbType) { return _stats[cbType]; }
+
+private:
+	friend class StraProfiler;
+	friend class StraProfileScope;
+
+	uint32_t		_sid;
+	std::string		_name;
+	CallbackStat	_stats[PCB_Count];
+	std::atomic<uint32_t>	_calls;		//用于CPU耗时抽样
+
+	uint32_t		_slow_windows;	//连续超过阈值的窗口数
+	std::atomic<bool>	_isolated;
+	StraWorkerPtr	_worker;
+	uint64_t		_last_conflated;
+};
+typedef std::shared_ptr<StraProfile>	StraProfilePtr;
+
+class StraProfiler
+{
+public:
+	typedef enum tagProfileAction
+	{
+		PA_None = 0,	//正常
+		PA_Warn,		//持续超过阈值，告警
+		PA_Isolated		//本窗口刚刚被隔离
+	} ProfileAction;
+
+	//一个统计窗口内，单个策略单个回调类型的汇总结果
+	typedef struct _ProfileReport
+	{
+		const char*	_stra;
+		uint32_t	_cb_type;
+		uint64_t	_count;
+		double		_avg_us;
+		double		_p50_us;
+		double		_p99_us;
+		double		_max_us;
+		double		_cpu_us;	//抽样的平均CPU耗时
+		uint64_t	_conflated;	//窗口内被合并掉的tick数
+		uint32_t	_slow_windows;
+		uint32_t	_action;
+	} ProfileReport;
+	typedef std::vector<ProfileReport>	ProfileReports;
+
+public:
+	StraProfiler() :_active(false), _span_ns(60000000000ULL), _cpu_sample(16), _threshold_ns(1000000)
+		, _persist(3), _policy(SP_Warn), _next_report(0) {}
+
+	~StraProfiler() { stop(); }
+
+	/*
+	 *	初始化
+	 *	@cfg			profiler配置项
+	 *	@bIsolation		引擎是否支持把策略迁移到独立线程，不支持的话isolate和conflate都降级为warn
+	 */
+	bool init(WTSVariant* cfg, bool bIsolation = true)
+	{
+		if (cfg == NULL || !cfg->getBoolean("active"))
+			return false;
+
+		_active = true;
+		if (cfg->has("span"))
+			_span_ns = (uint64_t)cfg->getUInt32("span") * 1000000000ULL;
+		if (cfg->has("cpu_sample"))
+			_cpu_sample = cfg->getUInt32("cpu_sample");
+		if (cfg->has("threshold"))
+			_threshold_ns = (uint64_t)cfg->getUInt32("threshold") * 1000;
+		if (cfg->has("persist"))
+			_persist = (std::max)(cfg->getUInt32("persist"), (uint32_t)1);
+
+		const char* policy = cfg->getCString("policy");
+		if (wt_stricmp(policy, "isolate") == 0)
+			_policy = SP_Isolate;
+		else if (wt_stricmp(policy, "conflate") == 0)
+			_policy = SP_Conflate;
+		else
+			_policy = SP_Warn;
+
+		if (!bIsolation)
+			_policy = SP_Warn;
+
+		_next_report = now_ns() + _span_ns;
+		return true;
+	}
+
+	inline bool			is_active() const { return _active; }
+	inline SlowPolicy	policy() const { return _policy; }
+	inline uint64_t		threshold_us() const { return _threshold_ns / 1000; }
+
+	//策略要在引擎开始分发之前注册
+	void add_strategy(uint32_t sid, const char* name)
+	{
+		if (!_active)
+			return;
+
+		StraProfilePtr& prof = _profiles[sid];
+		if (!prof)
+			prof.reset(new StraProfile(sid, name));
+	}
+
+	//没有开启的时候返回NULL，调用方只需要一次判断
+	inline StraProfile* find(uint32_t sid) const
+	{
+		if (!_active)
+			return NULL;
+
+		auto it = _profiles.find(sid);
+		if (it == _profiles.end())
+			return NULL;
+
+		return it->second.get();
+	}
+
+	static inline uint64_t now_ns()
+	{
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	static inline uint64_t thread_cpu_ns()
+	{
+#ifdef _MSC_VER
+		FILETIME c, e, k, u;
+		if (!GetThreadTimes(GetCurrentThread(), &c, &e, &k, &u))
+			return 0;
+
+		uint64_t kt = ((uint64_t)k.dwHighDateTime << 32) | k.dwLowDateTime;
+		uint64_t ut = ((uint64_t)u.dwHighDateTime << 32) | u.dwLowDateTime;
+		return (kt + ut) * 100;
+#else
+		timespec ts;
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+		return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+	}
+
+	inline bool need_cpu(StraProfile* prof)
+	{
+		if (_cpu_sample == 0)
+			return false;
+
+		uint32_t calls = prof->_calls.fetch_add(1, std::memory_order_relaxed);
+		return (calls % _cpu_sample) == 0;
+	}
+
+	/*
+	 *	到了统计窗口就汇总一次
+	 *	多个分发线程同时调用，只有一个会真正汇总
+	 *	慢策略的处理也在这里完成
+	 */
+	bool collect(ProfileReports& reports)
+	{
+		if (!_active)
+			return false;
+
+		uint64_t now = now_ns();
+		uint64_t next = _next_report.load(std::memory_order_relaxed);
+		if (now < next)
+			return false;
+
+		if (!_next_report.compare_exchange_strong(next, now + _span_ns))
+			return false;
+
+		uint32_t buckets[LatencyHist::BUCKETS];
+		for (auto& v : _profiles)
+		{
+			StraProfile* prof = v.second.get();
+			bool bSlow = false;
+			std::size_t start = reports.size();
+
+			uint64_t conflated = 0;
+			if (prof->_worker)
+			{
+				uint64_t total = prof->_worker->conflated();
+				conflated = total - prof->_last_conflated;
+				prof->_last_conflated = total;
+			}
+
+			for (uint32_t t = 0; t < PCB_Count; t++)
+			{
+				CallbackStat& st = prof->_stats[t];
+				uint64_t count = st._count.load(std::memory_order_relaxed);
+				uint64_t wall = st._wall_ns.load(std::memory_order_relaxed);
+				uint64_t cpu = st._cpu_ns.load(std::memory_order_relaxed);
+				uint64_t cpuCnt = st._cpu_samples.load(std::memory_order_relaxed);
+				uint64_t maxNs = st._max_ns.exchange(0, std::memory_order_relaxed);
+				st._hist.snapshot(buckets);
+
+				uint64_t dCnt = count - st._last_count;
+				uint64_t dWall = wall - st._last_wall;
+				uint64_t dCpu = cpu - st._last_cpu;
+				uint64_t dCpuCnt = cpuCnt - st._last_cpu_samples;
+				for (uint32_t i = 0; i < LatencyHist::BUCKETS; i++)
+				{
+					uint32_t cur = buckets[i];
+					buckets[i] = cur - st._last_buckets[i];
+					st._last_buckets[i] = cur;
+				}
+				st._last_count = count;
+				st._last_wall = wall;
+				st._last_cpu = cpu;
+				st._last_cpu_samples = cpuCnt;
+
+				if (dCnt == 0)
+					continue;
+
+				ProfileReport r;
+				r._stra = prof->name();
+				r._cb_type = t;
+				r._count = dCnt;
+				r._avg_us = dWall / 1000.0 / dCnt;
+				r._p50_us = LatencyHist::percentile(buckets, dCnt, 0.50) / 1000.0;
+				r._p99_us = LatencyHist::percentile(buckets, dCnt, 0.99) / 1000.0;
+				r._max_us = maxNs / 1000.0;
+				r._cpu_us = dCpuCnt == 0 ? 0 : dCpu / 1000.0 / dCpuCnt;
+				r._conflated = (t == PCB_Tick) ? conflated : 0;
+				r._slow_windows = 0;
+				r._action = PA_None;
+				reports.emplace_back(r);
+
+				if (r._p99_us * 1000 > _threshold_ns)
+					bSlow = true;
+			}
+
+			prof->_slow_windows = bSlow ? prof->_slow_windows + 1 : 0;
+
+			uint32_t action = PA_None;
+			if (prof->_slow_windows >= _persist)
+			{
+				action = PA_Warn;
+				if (_policy != SP_Warn && !prof->is_isolated())
+				{
+					prof->_worker.reset(new StraWorker(_policy == SP_Conflate));
+					prof->_worker->start();
+					prof->_isolated.store(true, std::memory_order_release);
+					action = PA_Isolated;
+				}
+			}
+
+			for (std::size_t i = start; i < reports.size(); i++)
+			{
+				reports[i]._slow_windows = prof->_slow_windows;
+				reports[i]._action = action;
+			}
+		}
+
+		return true;
+	}
+
+	void stop()
+	{
+		for (auto& v : _profiles)
+		{
+			if (v.second->_worker)
+				v.second->_worker->stop();
+		}
+	}
+
+	static std::string to_json(const ProfileReport& r)
+	{
+		return StrUtil::printf("{\"strategy\":\"%s\",\"callback\":\"%s\",\"count\":%llu,\"avg_us\":%.1f,\"p50_us\":%.1f,\"p99_us\":%.1f,\"max_us\":%.1f,\"cpu_us\":%.1f,\"conflated\":%llu,\"slow_windows\":%u,\"action\":%u}",
+			r._stra, profile_callback_name(r._cb_type), (unsigned long long)r._count, r._avg_us, r._p50_us, r._p99_us, r._max_us, r._cpu_us,
+			(unsigned long long)r._conflated, r._slow_windows, r._action);
+	}
+
+private:
+	bool		_active;
+	uint64_t	_span_ns;
+	uint32_t	_cpu_sample;
+	uint64_t	_threshold_ns;
+	uint32_t	_persist;
+	SlowPolicy	_policy;
+
+	std::atomic<uint64_t>	_next_report;
+	wt_hashmap<uint32_t, StraProfilePtr>	_profiles;
+};
+
+/*
+ *	回调耗时统计的作用域对象
+ *	prof为NULL的时候什么都不做
+ */
+class StraProfileScope
+{
+public:
+	StraProfileScope(StraProfiler& profiler, StraProfile* prof, uint32_t cbType)
+		: _prof(prof), _cb_type(cbType), _start(0), _cpu_start(0), _cpu(false)
+	{
+		if (_prof == NULL)
+			return;
+
+		_cpu = profiler.need_cpu(_prof);
+		if (_cpu)
+			_cpu_start = StraProfiler::thread_cpu_ns();
+		_start = StraProfiler::now_ns();
+	}
+
+	~StraProfileScope()
+	{
+		if (_prof == NULL)
+			return;
+
+		uint64_t wall = StraProfiler::now_ns() - _start;
+		uint64_t cpu = _cpu ? (StraProfiler::thread_cpu_ns() - _cpu_start) : 0;
+		_prof->_stats[_cb_type].record(wall, cpu, _cpu);
+	}
+
+private:
+	StraProfile*	_prof;
+	uint32_t		_cb_type;
+	uint64_t		_start;
+	uint64_t		_cpu_start;
+	bool			_cpu;
+};
+
+NS_WTP_END
@@ -0,0 +1,185 @@
+﻿/*!
+ * \file TradingCalendar.hpp
+ * \project	WonderTrader
+ *
+ * \brief 预计算的稠密交易日历
+ *
+ * 按节假日模板在指定的日期区间内预先算好：
+ * 1、自然日序号到交易日序号的映射(当天或之后的第一个交易日)
+ * 2、交易日序号到日期的映射
+ * 这样判断是否交易日、前后N个交易日、两个日期之间的交易日数都变成O(1)的数组查询
+ * 区间以外的日期由调用方回退到逐日计算
+ */
+#pragma once
+#include <stdint.h>
+#include <vector>
+
+class TradingCalendar
+{
+public:
+	TradingCalendar() :_begin_days(0), _end_days(-1) {}
+
+public:
+	/*
+	 *	自然日序号，1970-01-01为0
+	 *	纯整数运算，不依赖时区和mktime
+	 */
+	static inline int32_t date_to_days(uint32_t uDate)
+	{
+		int32_t y = (int32_t)(uDate / 10000);
+		int32_t m = (int32_t)((uDate % 10000) / 100);
+		int32_t d = (int32_t)(uDate % 100);
+		y -= (m <= 2) ? 1 : 0;
+		int32_t era = (y >= 0 ? y : y - 399) / 400;
+		int32_t yoe = y - era * 400;
+		int32_t doy = (153 * (m > 2 ? m - 3 : m + 9) + 2) / 5 + d - 1;
+		int32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+		return era * 146097 + doe - 719468;
+	}
+
+	static inline uint32_t days_to_date(int32_t days)
+	{
+		days += 719468;
+		int32_t era = (days >= 0 ? days : days - 146096) / 146097;
+		int32_t doe = days - era * 146097;
+		int32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+		int32_t y = yoe + era * 400;
+		int32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+		int32_t mp = (5 * doy + 2) / 153;
+		int32_t d = doy - (153 * mp + 2) / 5 + 1;
+		int32_t m = mp < 10 ? mp + 3 : mp - 9;
+		y += (m <= 2) ? 1 : 0;
+		return (uint32_t)(y * 10000 + m * 100 + d);
+	}
+
+	//星期几，0为周日
+	static inline uint32_t weekday(uint32_t uDate)
+	{
+		int32_t w = (date_to_days(uDate) + 4) % 7;
+		return (uint32_t)(w < 0 ? w + 7 : w);
+	}
+
+	/*
+	 *	构建日历
+	 *	@uBeginDate	开始日期
+	 *	@uEndDate	结束日期
+	 *	@holidays	节假日集合，需要支持find和end
+	 */
+	template<typename HolidayContainer>
+	void build(uint32_t uBeginDate, uint32_t uEndDate, const HolidayContainer& holidays)
+	{
+		_tdates.clear();
+		_ceil_idx.clear();
+
+		_begin_days = date_to_days(uBeginDate);
+		_end_days = date_to_days(uEndDate);
+		if (_end_days < _begin_days)
+			return;
+
+		uint32_t total = (uint32_t)(_end_days - _begin_days + 1);
+		_ceil_idx.resize(total);
+		_tdates.reserve(total * 5 / 7 + 1);
+
+		for (uint32_t i = 0; i < total; i++)
+		{
+			int32_t days = _begin_days + (int32_t)i;
+			_ceil_idx[i] = (uint32_t)_tdates.size();
+
+			int32_t w = (days + 4) % 7;
+			if (w < 0) w += 7;
+			if (w == 0 || w == 6)
+				continue;
+
+			uint32_t uDate = days_to_date(days);
+			if (holidays.find(uDate) != holidays.end())
+				continue;
+
+			_tdates.emplace_back(uDate);
+		}
+	}
+
+	inline bool	is_empty() const { return _ceil_idx.empty(); }
+
+	inline bool	in_range(uint32_t uDate) const
+	{
+		int32_t days = date_to_days(uDate);
+		return days >= _begin_days && days <= _end_days;
+	}
+
+	inline uint32_t	size() const { return (uint32_t)_tdates.size(); }
+
+	//按交易日序号取日期
+	inline uint32_t	tdate_at(uint32_t idx) const { return idx < _tdates.size() ? _tdates[idx] : 0; }
+
+	/*
+	 *	当天或之后的第一个交易日的序号
+	 *	调用前需要确认在区间内
+	 */
+	inline uint32_t	ceil_index(uint32_t uDate) const
+	{
+		return _ceil_idx[date_to_days(uDate) - _begin_days];
+	}
+
+	inline bool	is_trading_date(uint32_t uDate) const
+	{
+		uint32_t idx = ceil_index(uDate);
+		return idx < _tdates.size() && _tdates[idx] == uDate;
+	}
+
+	/*
+	 *	之后第days个交易日，超出日历区间返回0
+	 */
+	inline uint32_t	next_tdate(uint32_t uDate, int days = 1) const
+	{
+		if (!in_range(uDate))
+			return 0;
+
+		int64_t idx = ceil_index(uDate);
+		if (idx < (int64_t)_tdates.size() && _tdates[(std::size_t)idx] == uDate)
+			idx += days;
+		else
+			idx += days - 1;
+
+		if (idx < 0 || idx >= (int64_t)_tdates.size())
+			return 0;
+
+		return _tdates[(std::size_t)idx];
+	}
+
+	/*
+	 *	之前第days个交易日，超出日历区间返回0
+	 */
+	inline uint32_t	prev_tdate(uint32_t uDate, int days = 1) const
+	{
+		if (!in_range(uDate))
+			return 0;
+
+		int64_t idx = (int64_t)ceil_index(uDate) - days;
+		if (idx < 0 || idx >= (int64_t)_tdates.size())
+			return 0;
+
+		return _tdates[(std::size_t)idx];
+	}
+
+	/*
+	 *	[uBeginDate, uEndDate]之间的交易日数，两端都要在区间内
+	 */
+	inline uint32_t	count_tdates(uint32_t uBeginDate, uint32_t uEndDate) const
+	{
+		if (uBeginDate > uEndDate)
+			return 0;
+
+		uint32_t sIdx = ceil_index(uBeginDate);
+		uint32_t eIdx = ceil_index(uEndDate);
+		if (eIdx < _tdates.size() && _tdates[eIdx] == uEndDate)
+			eIdx++;
+
+		return eIdx - sIdx;
+	}
+
+private:
+	int32_t		_begin_days;
+	int32_t		_end_days;
+	std::vector<uint32_t>	_tdates;	//交易日序号到日期
+	std::vector<uint32_t>	_ceil_idx;	//自然日到交易日序号，非交易日指向之后的第一个交易日
+};
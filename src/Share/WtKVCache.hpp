@@ -4,34 +4,42 @@
  * 
  * 该文件提供了高性能的键值对缓存系统，主要包括：
  * 1. 基于内存映射文件的持久化缓存存储
- * 2. 支持自动扩容的缓存管理
- * 3. 线程安全的缓存操作
- * 4. 基于哈希表的快速索引查找
+ * 2. 预留容量的分段存储，扩容不会重新映射已有文件
+ * 3. 读操作无锁，写操作通过自旋锁串行化
+ * 4. 存放在文件中的开放寻址哈希索引，启动时不需要重建
  * 5. 日期感知的缓存重置机制
  * 
  * 设计逻辑：
- * - 使用Boost的内存映射文件实现持久化存储
- * - 通过自旋锁保证线程安全
- * - 使用哈希表提供O(1)的查找性能
- * - 支持自动扩容，避免缓存溢出
+ * - 每个分段文件一次性按容量创建（稀疏文件），映射之后地址不再变化
+ * - 分段写满以后新建一个容量翻倍的分段文件，已有分段不动
+ * - 索引槽位保存数据项下标+1，写入时先写数据项再发布槽位，读取时按acquire语义读槽位
+ * - 哈希函数使用FNV-1a，保证不同进程和不同编译器下索引一致
  * - 基于日期的缓存重置，支持每日数据更新
- * - 使用结构化的缓存块管理内存布局
  * 
  * 主要作用：
- * - 为WonderTrader框架提供高性能的数据缓存能力
- * - 支持高频交易等对性能要求极高的场景
+ * - 为交易通道提供委托编号和订单编号之间的映射缓存
+ * - 回调线程查询时不会被扩容阻塞
  * - 提供持久化的缓存存储，支持程序重启后的数据恢复
- * - 通过内存映射实现高效的磁盘I/O操作
  */
 #pragma once  // 防止头文件重复包含
+#include <atomic>
+#include <algorithm>
+#include <string>
+#include <vector>
 #include "SpinMutex.hpp"  // 包含自旋锁支持
 #include "BoostFile.hpp"  // 包含Boost文件操作支持
 #include "BoostMappingFile.hpp"  // 包含Boost内存映射文件支持
 #include "../Includes/FasterDefs.h"  // 包含Faster库定义
 
-#define SIZE_STEP 200  // 定义缓存初始大小步长
+//第一个分段的默认预留容量，每项128字节，16384项约2M
+//不够用的时候会按倍数追加分段，也可以在编译的时候定义或者在init的时候传入
+#ifndef CACHE_RESERVE
+#define CACHE_RESERVE 16384
+#endif
 #define CACHE_FLAG "&^%$#@!\0"  // 定义缓存文件标识符
 #define FLAG_SIZE 8  // 定义标识符大小
+#define CACHE_VERSION 2  // 定义缓存文件布局版本，带索引的布局从2开始
+#define CACHE_MAX_SEGS 8  // 定义最大分段数
 
 typedef std::shared_ptr<BoostMappingFile> BoostMFPtr;  // Boost内存映射文件智能指针类型别名
 
@@ -45,9 +53,9 @@ typedef std::function<void(const char*)> CacheLogger;  // 缓存日志记录器
  * @class WtKVCache
  * @brief WonderTrader键值缓存类
  * 
- * 该类提供了高性能的键值对缓存系统，支持持久化存储和自动扩容。
- * 使用内存映射文件实现高效的磁盘I/O操作，通过哈希表提供快速的查找性能。
- * 支持线程安全操作和基于日期的缓存重置。
+ * 该类提供了高性能的键值对缓存系统，支持持久化存储和分段扩容。
+ * get和has不加锁，可以在任意线程中和put并发调用。
+ * 同一个键的值被并发改写时，读到的值不保证完整，交易通道里的映射都是一次写入，不受影响。
  */
 class WtKVCache
 {
@@ -57,7 +65,7 @@ public:
 	 * 
 	 * 初始化WtKVCache对象，不执行任何特殊操作。
 	 */
-	WtKVCache() {}  // 默认构造函数
+	WtKVCache() : _seg_cnt(0), _date(0) {}  // 默认构造函数
 
 	/**
 	 * @brief 删除拷贝构造函数
@@ -85,16 +93,16 @@ private:
 	 */
 	typedef struct _CacheItem
 	{
-		char	_key[64] = { 0 };  // 缓存项键，最大64字符
-		char	_val[64] = { 0 };  // 缓存项值，最大64字符
+		char	_key[64] = { 0 };  // 缓存项键，最大63字符
+		char	_val[64] = { 0 };  // 缓存项值，最大63字符
 	} CacheItem;  // 缓存项类型别名
 
 	/**
 	 * @struct CacheBlock
 	 * @brief 缓存块结构体
 	 * 
-	 * 该结构体表示一个缓存块，包含块头信息和缓存项数组。
-	 * 使用零长度数组实现动态大小的缓存项存储。
+	 * 该结构体是分段文件的文件头，后面依次是_slots个索引槽位和_capacity个缓存项。
+	 * 前四个字段和旧版本布局一致，旧版本文件通过_version区分。
 	 */
 	typedef struct CacheBlock
 	{
@@ -102,99 +110,295 @@ private:
 		uint32_t	_size;  // 当前缓存项数量
 		uint32_t	_capacity;  // 缓存块容量（最大缓存项数量）
 		uint32_t	_date;  // 缓存日期，用于判断是否需要重置
-		CacheItem	_items[0];  // 缓存项数组，零长度数组实现动态大小
+		uint32_t	_version;  // 布局版本
+		uint32_t	_slots;  // 索引槽位数量，2的整数次幂，不小于容量的2倍
+		uint32_t	_reserved[3];  // 保留字段
 	} CacheBlock;  // 缓存块类型别名
 
 	/**
-	 * @struct _CacheBlockPair
-	 * @brief 缓存块和文件映射对结构体
+	 * @struct _CacheSegment
+	 * @brief 缓存分段结构体
 	 * 
-	 * 该结构体将缓存块与对应的内存映射文件关联起来。
-	 * 提供统一的缓存访问接口。
+	 * 该结构体将分段文件头、索引、缓存项和对应的内存映射文件关联起来。
 	 */
-	typedef struct _CacheBlockPair
+	typedef struct _CacheSegment
 	{
-		CacheBlock*		_block;  // 缓存块指针
+		CacheBlock*		_block;  // 分段文件头
+		uint32_t*		_slots;  // 索引槽位，0表示空槽位，否则为缓存项下标+1
+		CacheItem*		_items;  // 缓存项数组
 		BoostMFPtr		_file;   // 内存映射文件智能指针
 
-		/**
-		 * @brief 默认构造函数
-		 * 
-		 * 初始化缓存块对，将指针设为NULL。
-		 */
-		_CacheBlockPair()
+		_CacheSegment() : _block(NULL), _slots(NULL), _items(NULL) {}
+	} CacheSegment;  // 缓存分段类型别名
+
+	static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "atomic<uint32_t> must be lock-free and plain sized");
+
+	CacheSegment	_segs[CACHE_MAX_SEGS];  // 缓存分段，只追加不替换
+	std::atomic<uint32_t>	_seg_cnt;  // 已发布的分段数量
+	SpinMutex		_lock;   // 自旋锁，串行化写操作
+	std::string		_filename;  // 第一个分段的文件名
+	uint32_t		_date;  // 缓存日期
+
+private:
+	static inline std::atomic<uint32_t>& as_atomic(uint32_t& v)
+	{
+		return *reinterpret_cast<std::atomic<uint32_t>*>(&v);
+	}
+
+	/**
+	 * @brief 计算键的哈希值
+	 * 
+	 * 索引保存在文件中，所以哈希函数必须在不同进程之间保持一致，这里使用FNV-1a。
+	 * 超出键长度的部分不参与计算，和存储时的截断保持一致。
+	 */
+	static inline uint32_t hash_key(const char* key)
+	{
+		uint32_t h = 2166136261U;
+		for (std::size_t i = 0; key[i] != '\0' && i < sizeof(CacheItem::_key) - 1; i++)
 		{
-			_block = NULL;  // 初始化缓存块指针为NULL
-			_file = NULL;   // 初始化文件指针为NULL
+			h ^= (uint8_t)key[i];
+			h *= 16777619U;
 		}
-	} CacheBlockPair;  // 缓存块对类型别名
+		return h;
+	}
 
-	CacheBlockPair	_cache;  // 缓存块和文件映射对
-	SpinMutex		_lock;   // 自旋锁，保证线程安全
-	wt_hashmap<std::string, uint32_t> _indice;  // 哈希表索引，键到索引位置的映射
+	static inline std::string seg_filename(const std::string& filename, uint32_t idx)
+	{
+		if (idx == 0)
+			return filename;
+
+		return filename + "." + std::to_string(idx);
+	}
+
+	static inline uint64_t seg_filesize(uint32_t capacity, uint32_t slots)
+	{
+		return sizeof(CacheBlock) + sizeof(uint32_t)*slots + sizeof(CacheItem)*capacity;
+	}
+
+	static inline void bind_segment(CacheSegment& seg)
+	{
+		seg._block = (CacheBlock*)seg._file->addr();
+		seg._slots = (uint32_t*)(seg._block + 1);
+		seg._items = (CacheItem*)(seg._slots + seg._block->_slots);
+	}
 
-private:
 	/**
-	 * @brief 调整缓存大小
-	 * @param newCap 新的容量大小
-	 * @param logger 日志记录器，默认为nullptr
-	 * @return bool 调整成功返回true，失败返回false
+	 * @brief 在一个分段中查找键
 	 * 
-	 * 该函数通过扩展文件大小来增加缓存容量。
-	 * 调用前应确保线程安全，函数内部会重新映射文件。
+	 * 槽位数量至少是容量的2倍，所以探测一定会遇到空槽位而结束。
 	 */
-	bool	resize(uint32_t newCap, CacheLogger logger = nullptr)
+	static inline CacheItem* find_in(const CacheSegment& seg, const char* key, uint32_t h)
 	{
-		if (_cache._file == NULL)  // 检查文件是否已映射
-			return false;  // 文件未映射，返回失败
-
-		//调用该函数之前,应该保证线程安全了
-		CacheBlock* cBlock = _cache._block;  // 获取当前缓存块指针
-		if (cBlock->_capacity >= newCap)  // 如果当前容量已经足够
-			return _cache._file->addr();  // 返回文件地址（表示成功）
-
-		std::string filename = _cache._file->filename();  // 获取文件名
-		uint64_t uOldSize = sizeof(CacheBlock) + sizeof(CacheItem)*cBlock->_capacity;  // 计算旧文件大小
-		uint64_t uNewSize = sizeof(CacheBlock) + sizeof(CacheItem)*newCap;  // 计算新文件大小
-		std::string data;  // 声明数据字符串
-		data.resize((std::size_t)(uNewSize - uOldSize), 0);  // 调整数据大小，填充0
-		try  // 使用异常处理确保安全性
+		uint32_t mask = seg._block->_slots - 1;
+		for (uint32_t i = h & mask; ; i = (i + 1) & mask)
 		{
-			BoostFile f;  // 创建Boost文件对象
-			f.open_existing_file(filename.c_str());  // 打开现有文件
-			f.seek_to_end();  // 移动到文件末尾
-			f.write_file(data.c_str(), data.size());  // 写入扩展数据
-			f.close_file();  // 关闭文件
+			uint32_t v = as_atomic(seg._slots[i]).load(std::memory_order_acquire);
+			if (v == 0)
+				return NULL;
+
+			CacheItem* item = &seg._items[v - 1];
+			if (strncmp(item->_key, key, sizeof(item->_key) - 1) == 0)
+				return item;
 		}
-		catch (std::exception&)  // 捕获所有异常
+	}
+
+	inline CacheItem* find(const char* key) const
+	{
+		uint32_t cnt = _seg_cnt.load(std::memory_order_acquire);
+		if (cnt == 0)
+			return NULL;
+
+		uint32_t h = hash_key(key);
+		for (uint32_t i = 0; i < cnt; i++)
 		{
-			if (logger) logger("Got an exception while resizing cache file");  // 记录调整大小异常
-			return false;  // 返回失败
+			CacheItem* item = find_in(_segs[i], key, h);
+			if (item != NULL)
+				return item;
 		}
 
+		return NULL;
+	}
+
+	/**
+	 * @brief 创建一个新的分段文件
+	 * @param seg 分段对象
+	 * @param filename 分段文件名
+	 * @param capacity 分段容量
+	 * @param logger 日志记录器
+	 * @return bool 创建成功返回true，失败返回false
+	 * 
+	 * 文件直接截断到最终大小，没有写过的页不占用磁盘空间，读出来都是0。
+	 * 已存在的同名文件会被清空重建。
+	 */
+	bool	create_segment(CacheSegment& seg, const std::string& filename, uint32_t capacity, CacheLogger logger)
+	{
+		uint32_t slots = 4;
+		while (slots < capacity * 2)
+			slots <<= 1;
 
-		_cache._file.reset();  // 重置文件映射
-		BoostMappingFile* pNewMf = new BoostMappingFile();  // 创建新的内存映射文件对象
-		try  // 使用异常处理确保安全性
+		seg._file.reset();
+		try
 		{
-			if (!pNewMf->map(filename.c_str()))  // 尝试映射文件
+			BoostFile bf;  // 创建Boost文件对象
+			if (!bf.create_new_file(filename.c_str()))
 			{
-				delete pNewMf;  // 映射失败，删除对象
-				if (logger) logger("Mapping cache file failed");  // 记录映射失败
-				return false;  // 返回失败
+				if (logger) logger("Creating cache file failed");
+				return false;
 			}
+			bf.truncate_file((std::size_t)seg_filesize(capacity, slots));  // 设置文件大小
+			bf.close_file();  // 关闭文件
 		}
-		catch (std::exception&)  // 捕获所有异常
+		catch (std::exception&)
 		{
-			if (logger) logger("Got an exception while mapping cache file");  // 记录映射异常
-			return false;  // 返回失败
+			if (logger) logger("Got an exception while creating cache file");
+			return false;
 		}
 
-		_cache._file.reset(pNewMf);  // 重置文件映射为新的映射文件
+		BoostMFPtr mf(new BoostMappingFile);
+		try
+		{
+			if (!mf->map(filename.c_str()))
+			{
+				if (logger) logger("Mapping cache file failed");
+				return false;
+			}
+		}
+		catch (std::exception&)
+		{
+			if (logger) logger("Got an exception while mapping cache file");
+			return false;
+		}
 
-		_cache._block = (CacheBlock*)_cache._file->addr();  // 更新缓存块指针
-		_cache._block->_capacity = newCap;  // 更新容量
-		return true;  // 返回成功
+		CacheBlock* cBlock = (CacheBlock*)mf->addr();
+		memcpy(cBlock->_blk_flag, CACHE_FLAG, FLAG_SIZE);  // 设置块标识符
+		cBlock->_size = 0;
+		cBlock->_capacity = capacity;
+		cBlock->_date = _date;
+		cBlock->_version = CACHE_VERSION;
+		cBlock->_slots = slots;
+
+		seg._file = mf;
+		bind_segment(seg);
+		return true;
+	}
+
+	/**
+	 * @brief 打开一个已有的分段文件
+	 * @return bool 文件布局和日期都有效返回true，否则返回false，映射仍然保留在seg中供调用者检查
+	 */
+	bool	open_segment(CacheSegment& seg, const std::string& filename, CacheLogger logger)
+	{
+		seg._file.reset(new BoostMappingFile);
+		try
+		{
+			if (!seg._file->map(filename.c_str()))
+			{
+				seg._file.reset();
+				if (logger) logger("Mapping cache file failed");
+				return false;
+			}
+		}
+		catch (std::exception&)
+		{
+			seg._file.reset();
+			if (logger) logger("Got an exception while mapping cache file");
+			return false;
+		}
+
+		std::size_t realSz = seg._file->size();
+		if (realSz < sizeof(CacheBlock))
+			return false;
+
+		CacheBlock* cBlock = (CacheBlock*)seg._file->addr();
+		if (cBlock->_version != CACHE_VERSION || cBlock->_date != _date)
+			return false;
+
+		uint32_t slots = cBlock->_slots;
+		if (slots == 0 || (slots & (slots - 1)) != 0 || slots < cBlock->_capacity * 2 
+			|| realSz != seg_filesize(cBlock->_capacity, slots) || cBlock->_size > cBlock->_capacity)
+		{
+			if (logger) logger("Cache file corrupted");
+			return false;
+		}
+
+		bind_segment(seg);
+		return true;
+	}
+
+	/**
+	 * @brief 读取旧版本布局中同一天的数据，用于迁移
+	 */
+	void	read_legacy(CacheSegment& seg, std::vector<std::pair<std::string, std::string>>& items)
+	{
+		if (seg._file == NULL)
+			return;
+
+		std::size_t realSz = seg._file->size();
+		const std::size_t hdrSz = FLAG_SIZE + sizeof(uint32_t) * 3;
+		if (realSz < hdrSz)
+			return;
+
+		CacheBlock* cBlock = (CacheBlock*)seg._file->addr();
+		if (memcmp(cBlock->_blk_flag, CACHE_FLAG, FLAG_SIZE) != 0 || cBlock->_date != _date)
+			return;
+
+		//新布局的文件损坏了就直接丢弃
+		if (realSz >= sizeof(CacheBlock) && cBlock->_version == CACHE_VERSION)
+			return;
+
+		uint32_t realCap = (uint32_t)((realSz - hdrSz) / sizeof(CacheItem));
+		uint32_t cnt = std::min(cBlock->_size, realCap);
+		const CacheItem* oldItems = (const CacheItem*)((char*)cBlock + hdrSz);
+		for (uint32_t i = 0; i < cnt; i++)
+		{
+			const CacheItem& item = oldItems[i];
+			items.emplace_back(std::string(item._key, strnlen(item._key, sizeof(item._key))), std::string(item._val, strnlen(item._val, sizeof(item._val))));
+		}
+	}
+
+	/**
+	 * @brief 写入新的缓存项，调用前应该已经加锁
+	 */
+	bool	append(const char* key, uint32_t h, const char* val, std::size_t len, CacheLogger logger)
+	{
+		uint32_t cnt = _seg_cnt.load(std::memory_order_relaxed);
+		if (cnt == 0)
+			return false;
+
+		uint32_t segIdx = 0;
+		while (segIdx < cnt && _segs[segIdx]._block->_size == _segs[segIdx]._block->_capacity)
+			segIdx++;
+
+		if (segIdx == cnt)
+		{
+			//所有分段都满了，新建一个容量翻倍的分段，已有分段不做任何改动
+			if (cnt == CACHE_MAX_SEGS)
+			{
+				if (logger) logger("Cache is full, no more segments can be added");
+				return false;
+			}
+
+			CacheSegment& last = _segs[cnt - 1];
+			if (!create_segment(_segs[cnt], seg_filename(_filename, cnt), last._block->_capacity * 2, logger))
+				return false;
+
+			_seg_cnt.store(cnt + 1, std::memory_order_release);
+		}
+
+		CacheSegment& seg = _segs[segIdx];
+		uint32_t idx = seg._block->_size;
+		CacheItem& item = seg._items[idx];
+		wt_strcpy(item._key, key, std::min(strlen(key), sizeof(item._key) - 1));  // 设置新项的键
+		wt_strcpy(item._val, val, std::min(len, sizeof(item._val) - 1));  // 设置新项的值
+		as_atomic(seg._block->_size).store(idx + 1, std::memory_order_release);
+
+		//最后发布索引槽位，读线程看到槽位时数据项已经写完了
+		uint32_t mask = seg._block->_slots - 1;
+		uint32_t i = h & mask;
+		while (seg._slots[i] != 0)
+			i = (i + 1) & mask;
+		as_atomic(seg._slots[i]).store(idx + 1, std::memory_order_release);
+		return true;
 	}
 
 public:
@@ -203,74 +407,82 @@ public:
 	 * @param filename 缓存文件名
 	 * @param uDate 缓存日期
 	 * @param logger 日志记录器，默认为nullptr
+	 * @param capacity 第一个分段的预留容量
 	 * @return bool 初始化成功返回true，失败返回false
 	 * 
 	 * 该函数初始化缓存系统，如果文件不存在则创建新文件。
-	 * 支持基于日期的缓存重置，自动恢复损坏的缓存文件。
+	 * 日期不一致或者文件损坏时重建缓存，旧版本布局中同一天的数据会迁移到新文件中。
 	 */
-	bool	init(const char* filename, uint32_t uDate, CacheLogger logger = nullptr)
+	bool	init(const char* filename, uint32_t uDate, CacheLogger logger = nullptr, uint32_t capacity = CACHE_RESERVE)
 	{
-		bool isNew = false;  // 标记是否为新文件
-		if (!BoostFile::exists(filename))  // 如果文件不存在
-		{
-			uint64_t uSize = sizeof(CacheBlock) + sizeof(CacheItem) * SIZE_STEP;  // 计算初始文件大小
-			BoostFile bf;  // 创建Boost文件对象
-			bf.create_new_file(filename);  // 创建新文件
-			bf.truncate_file((uint32_t)uSize);  // 设置文件大小
-			bf.close_file();  // 关闭文件
+		SpinLock lock(_lock);
 
-			isNew = true;  // 标记为新文件
-		}
+		_seg_cnt.store(0, std::memory_order_release);
+		for (CacheSegment& seg : _segs)
+			seg = CacheSegment();
 
-		_cache._file.reset(new BoostMappingFile);  // 创建新的内存映射文件对象
-		if (!_cache._file->map(filename))  // 尝试映射文件
+		_filename = filename;
+		_date = uDate;
+
+		bool bValid = false;
+		std::vector<std::pair<std::string, std::string>> legacy;
+		if (BoostFile::exists(filename))
 		{
-			_cache._file.reset();  // 映射失败，重置文件对象
-			if (logger) logger("Mapping cache file failed");  // 记录映射失败
-			return false;  // 返回失败
+			bValid = open_segment(_segs[0], _filename, logger);
+			if (!bValid)
+				read_legacy(_segs[0], legacy);
 		}
-		_cache._block = (CacheBlock*)_cache._file->addr();  // 获取缓存块指针
 
-		if (!isNew &&  _cache._block->_date != uDate)  // 如果不是新文件且日期不匹配
+		if (bValid)
 		{
-			 _cache._block->_size = 0;  // 重置缓存项数量
-			 _cache._block->_date = uDate;  // 更新缓存日期
+			//后续分段按编号依次打开
+			uint32_t cnt = 1;
+			for (; cnt < CACHE_MAX_SEGS; cnt++)
+			{
+				std::string segFile = seg_filename(_filename, cnt);
+				if (!BoostFile::exists(segFile.c_str()))
+					break;
 
-			memset(& _cache._block->_items, 0, sizeof(CacheItem)* _cache._block->_capacity);  // 清空所有缓存项
+				if (!open_segment(_segs[cnt], segFile, logger))
+				{
+					_segs[cnt] = CacheSegment();
+					break;
+				}
+			}
 
-			if (logger) logger("Cache file reset due to a different date");  // 记录日期重置日志
+			_seg_cnt.store(cnt, std::memory_order_release);
+			return true;
 		}
 
-		if (isNew)  // 如果是新文件
+		_segs[0] = CacheSegment();
+		for (uint32_t i = 1; i < CACHE_MAX_SEGS; i++)
 		{
-			 _cache._block->_capacity = SIZE_STEP;  // 设置初始容量
-			 _cache._block->_size = 0;  // 设置初始大小
-			 _cache._block->_date = uDate;  // 设置缓存日期
-			strcpy( _cache._block->_blk_flag, CACHE_FLAG);  // 设置块标识符
+			std::string segFile = seg_filename(_filename, i);
+			if (BoostFile::exists(segFile.c_str()))
+				BoostFile::delete_file(segFile.c_str());
 		}
-		else  // 如果是现有文件
-		{
-			//检查缓存文件是否有问题,要自动恢复
-			do  // 使用do-while循环（只执行一次）
-			{
-				uint64_t uSize = sizeof(CacheBlock) + sizeof(CacheItem) *  _cache._block->_capacity;  // 计算期望文件大小
-				uint64_t realSz =  _cache._file->size();  // 获取实际文件大小
-				if (realSz != uSize)  // 如果大小不匹配
-				{
-					uint32_t realCap = (uint32_t)((realSz - sizeof(CacheBlock)) / sizeof(CacheItem));  // 计算实际容量
-					uint32_t markedCap =  _cache._block->_capacity;  // 获取标记容量
-					//文件大小不匹配,一般是因为capacity改了,但是实际没扩容
-					//这是做一次扩容即可
-					 _cache._block->_capacity = realCap;  // 更新为实际容量
-					 _cache._block->_size = (realCap < markedCap) ? realCap : markedCap;  // 取较小值作为实际大小
-				}
 
-			} while (false);  // 循环条件为false，只执行一次
+		bool isNew = !BoostFile::exists(filename);
+		if (!create_segment(_segs[0], _filename, std::max(capacity, 1U), logger))
+		{
+			_segs[0] = CacheSegment();
+			return false;
 		}
+		_seg_cnt.store(1, std::memory_order_release);
 
-		//这里把索引加到hashmap中
-		for (uint32_t i = 0; i < _cache._block->_size; i++)  // 遍历所有缓存项
-			_indice[_cache._block->_items[i]._key] = i;  // 将键和索引添加到哈希表
+		if (!isNew)
+		{
+			if (!legacy.empty())
+			{
+				for (auto& item : legacy)
+					append(item.first.c_str(), hash_key(item.first.c_str()), item.second.c_str(), item.second.size(), logger);
+				if (logger) logger("Cache file upgraded to indexed layout");
+			}
+			else
+			{
+				if (logger) logger("Cache file reset due to a different date");  // 记录日期重置日志
+			}
+		}
 
 		return true;  // 返回成功
 	}
@@ -278,22 +490,21 @@ public:
 	/**
 	 * @brief 清空缓存
 	 * 
-	 * 该函数清空所有缓存项和索引，重置缓存大小。
-	 * 使用自旋锁保证线程安全。
+	 * 该函数清空所有缓存项和索引，分段文件保留。
+	 * 清空期间读线程最多读到部分旧数据。
 	 */
 	inline void clear()
 	{
-		_lock.lock();  // 获取锁
+		SpinLock lock(_lock);
 
-		if (_cache._block == NULL)  // 如果缓存块未初始化
-			return;  // 直接返回
-
-		_indice.clear();  // 清空索引哈希表
-
-		memset(_cache._block->_items, 0, sizeof(CacheItem)*_cache._block->_capacity);  // 清空所有缓存项
-		_cache._block->_size = 0;  // 重置缓存大小
-
-		_lock.unlock();  // 释放锁
+		uint32_t cnt = _seg_cnt.load(std::memory_order_relaxed);
+		for (uint32_t i = 0; i < cnt; i++)
+		{
+			CacheSegment& seg = _segs[i];
+			memset(seg._slots, 0, sizeof(uint32_t)*seg._block->_slots);  // 清空索引
+			std::fill(seg._items, seg._items + seg._block->_size, CacheItem());  // 清空已使用的缓存项
+			as_atomic(seg._block->_size).store(0, std::memory_order_release);
+		}
 	}
 
 	/**
@@ -301,16 +512,15 @@ public:
 	 * @param key 缓存键
 	 * @return const char* 返回缓存值，如果不存在返回空字符串
 	 * 
-	 * 该函数通过哈希表快速查找缓存值。
-	 * 线程安全，无需加锁。
+	 * 该函数通过文件中的索引查找缓存值，不加锁。
 	 */
 	inline const char*	get(const char* key) const
 	{
-		auto it = _indice.find(key);  // 在哈希表中查找键
-		if (it == _indice.end())  // 如果未找到
+		const CacheItem* item = find(key);
+		if (item == NULL)  // 如果未找到
 			return "";  // 返回空字符串
 
-		return _cache._block->_items[it->second]._val;  // 返回对应的值
+		return item->_val;  // 返回对应的值
 	}
 
 	/**
@@ -321,26 +531,24 @@ public:
 	 * @param logger 日志记录器，默认为nullptr
 	 * 
 	 * 该函数设置或更新缓存值。如果键已存在则更新，否则添加新项。
-	 * 支持自动扩容，使用自旋锁保证线程安全。
+	 * 当前分段写满时追加新的分段，已有的映射不会失效。
 	 */
 	void	put(const char* key, const char*val, std::size_t len = 0, CacheLogger logger = nullptr)
 	{
-		auto it = _indice.find(key);  // 在哈希表中查找键
-		if (it != _indice.end())  // 如果键已存在
+		if (len == 0)
+			len = strlen(val);
+
+		SpinLock lock(_lock);
+		CacheItem* item = find(key);  // 查找键
+		if (item != NULL)  // 如果键已存在
 		{
-			wt_strcpy(_cache._block->_items[it->second]._val, val, len);  // 更新现有值
+			len = std::min(len, sizeof(item->_val) - 1);
+			if (strncmp(item->_val, val, len) != 0 || item->_val[len] != '\0')
+				wt_strcpy(item->_val, val, len);  // 值有变化才改写，减少读线程看到半截数据的机会
 		}
 		else  // 如果键不存在
 		{
-			_lock.lock();  // 获取锁
-			if(_cache._block->_size == _cache._block->_capacity)  // 如果缓存已满
-				resize(_cache._block->_capacity*2, logger);  // 扩容为原来的2倍
-
-			_indice[key] = _cache._block->_size;  // 添加新键到索引
-			wt_strcpy(_cache._block->_items[_cache._block->_size]._key, key);  // 设置新项的键
-			wt_strcpy(_cache._block->_items[_cache._block->_size]._val, val, len);  // 设置新项的值
-			_cache._block->_size += 1;  // 增加缓存大小
-			_lock.unlock();  // 释放锁
+			append(key, hash_key(key), val, len, logger);
 		}
 	}
 
@@ -349,42 +557,43 @@ public:
 	 * @param key 要检查的键
 	 * @return bool 键存在返回true，不存在返回false
 	 * 
-	 * 该函数通过哈希表快速检查键是否存在。
-	 * 线程安全，无需加锁。
+	 * 该函数通过文件中的索引检查键是否存在，不加锁。
 	 */
 	inline bool	has(const char* key) const 
 	{
-		return (_indice.find(key) != _indice.end());  // 在哈希表中查找键
+		return (find(key) != NULL);
 	}
 
 	/**
 	 * @brief 获取缓存项数量
 	 * @return uint32_t 返回当前缓存项数量
 	 * 
-	 * 该函数返回当前缓存中的项数量。
-	 * 线程安全，无需加锁。
+	 * 该函数返回所有分段中缓存项的数量之和。
 	 */
 	inline uint32_t size() const
 	{
-		if (_cache._block == 0)  // 如果缓存块未初始化
-			return 0;  // 返回0
+		uint32_t ret = 0;
+		uint32_t cnt = _seg_cnt.load(std::memory_order_acquire);
+		for (uint32_t i = 0; i < cnt; i++)
+			ret += as_atomic(_segs[i]._block->_size).load(std::memory_order_acquire);
 
-		return _cache._block->_size;  // 返回缓存大小
+		return ret;  // 返回缓存大小
 	}
 
 	/**
 	 * @brief 获取缓存容量
 	 * @return uint32_t 返回当前缓存容量
 	 * 
-	 * 该函数返回当前缓存的最大容量。
-	 * 线程安全，无需加锁。
+	 * 该函数返回所有分段的容量之和。
 	 */
 	inline uint32_t capacity() const
 	{
-		if (_cache._block == 0)  // 如果缓存块未初始化
-			return 0;  // 返回0
+		uint32_t ret = 0;
+		uint32_t cnt = _seg_cnt.load(std::memory_order_acquire);
+		for (uint32_t i = 0; i < cnt; i++)
+			ret += _segs[i]._block->_capacity;
 
-		return _cache._block->_capacity;  // 返回缓存容量
+		return ret;  // 返回缓存容量
 	}
 };
 
@@ -0,0 +1,86 @@
+#include "../WTSTools/CsvHelper.h"
+#include "../Includes/WTSStruct.h"
+#include "gtest/gtest/gtest.h"
+
+#include <fstream>
+#include <boost/filesystem.hpp>
+
+USING_NS_WTP;
+
+static void make_bars_csv(const char* filename, uint32_t rows)
+{
+	std::ofstream ofs(filename, std::ios::binary);
+	ofs << "\xEF\xBB\xBF<Date>,<Time>,Open,High,Low,Close,Volume,Turnover,Open_Interest,Diff_Interest,Settle\r\n";
+	for (uint32_t i = 0; i < rows; i++)
+	{
+		ofs << "2023/6/" << (i % 28 + 1) << ",09:" << (i % 50 + 10) << ":00,"
+			<< 3000 + i << ".5,3001.25,2999,3000.75," << i << "," << i * 10 << ".5,1200,-3,0\r\n";
+	}
+}
+
+//测试文件写到临时目录里，用完删掉
+class test_csvhelper : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		_dir = boost::filesystem::temp_directory_path() / boost::filesystem::unique_path("csvtest_%%%%-%%%%-%%%%");
+		boost::filesystem::create_directories(_dir);
+		_file = (_dir / "bars.csv").string();
+	}
+
+	void TearDown() override
+	{
+		boost::system::error_code ec;
+		boost::filesystem::remove_all(_dir, ec);
+	}
+
+	boost::filesystem::path	_dir;
+	std::string	_file;
+};
+
+TEST_F(test_csvhelper, test_reader)
+{
+	make_bars_csv(_file.c_str(), 3);
+
+	CsvReader reader;
+	EXPECT_TRUE(reader.load_from_file(_file.c_str()));
+	EXPECT_EQ(reader.col_count(), 11);
+
+	EXPECT_TRUE(reader.next_row());
+	EXPECT_EQ(reader.get_date("date"), 20230601);
+	EXPECT_EQ(reader.get_time("time"), 910);
+	EXPECT_EQ(reader.get_time("time", true), 91000);
+	EXPECT_EQ(reader.get_millitime("time"), 91000000);
+	EXPECT_DOUBLE_EQ(reader.get_double("open"), 3000.5);
+	EXPECT_DOUBLE_EQ(reader.get_double("high"), 3001.25);
+	EXPECT_EQ(reader.get_int32("diff_interest"), -3);
+	EXPECT_STREQ(reader.get_string("settle"), "0");
+	EXPECT_STREQ(reader.get_string("not_exists"), "");
+
+	EXPECT_TRUE(reader.next_row());
+	EXPECT_TRUE(reader.next_row());
+	EXPECT_FALSE(reader.next_row());
+}
+
+TEST_F(test_csvhelper, test_parallel_load)
+{
+	make_bars_csv(_file.c_str(), 200000);
+
+	std::vector<WTSBarStruct> single, multi;
+	EXPECT_EQ(CsvLoader::load_bars(_file.c_str(), single, false, 1), 200000);
+	EXPECT_EQ(CsvLoader::load_bars(_file.c_str(), multi, false, 4), 200000);
+	EXPECT_EQ(memcmp(single.data(), multi.data(), sizeof(WTSBarStruct)*single.size()), 0);
+
+	CsvReader reader;
+	reader.load_from_file(_file.c_str());
+	std::vector<CsvReader> readers;
+	reader.split(4, readers);
+	uint32_t rows = 0;
+	for (CsvReader& r : readers)
+	{
+		while (r.next_row())
+			rows++;
+	}
+	EXPECT_EQ(rows, 200000);
+}
@@ -92,4 +92,36 @@ TEST(test_kvcache, test_perform)
 	uint64_t b = ticker.nano_seconds();
 
 	fmt::print("cache: {} - ini: {}\n", a, b);
+}
+
+TEST(test_kvcache, test_segments)
+{
+	{
+		WtKVCache cache;
+		EXPECT_TRUE(cache.init("./segcache.dat", 20220325, nullptr, 16));
+		cache.clear();
+
+		char buffer[16] = { 0 };
+		for (uint32_t i = 0; i < 100; i++)
+		{
+			char* s = fmt::format_to(buffer, "{}", i);
+			s[0] = '\0';
+			cache.put(buffer, buffer);
+		}
+
+		//写满之后追加分段，已有数据仍然可以读到
+		EXPECT_EQ(cache.size(), 100);
+		EXPECT_GE(cache.capacity(), 100);
+		EXPECT_STREQ(cache.get("0"), "0");
+		EXPECT_STREQ(cache.get("99"), "99");
+	}
+
+	{
+		//重新打开时直接使用文件中的索引
+		WtKVCache cache;
+		EXPECT_TRUE(cache.init("./segcache.dat", 20220325, nullptr, 16));
+		EXPECT_EQ(cache.size(), 100);
+		EXPECT_TRUE(cache.has("50"));
+		EXPECT_FALSE(cache.has("100"));
+	}
 }
\ No newline at end of file
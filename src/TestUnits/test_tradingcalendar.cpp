@@ -0,0 +1,94 @@
+﻿#include "../Share/TradingCalendar.hpp"
+#include "gtest/gtest/gtest.h"
+
+#include <set>
+
+//2024年元旦和春节
+class test_tradingcalendar : public testing::Test
+{
+protected:
+	void SetUp() override
+	{
+		std::set<uint32_t> holidays = { 20240101, 20240212, 20240213, 20240214, 20240215, 20240216 };
+		_cal.build(20231225, 20240229, holidays);
+	}
+
+	TradingCalendar	_cal;
+};
+
+TEST_F(test_tradingcalendar, date_days)
+{
+	EXPECT_EQ(TradingCalendar::date_to_days(19700101), 0);
+	EXPECT_EQ(TradingCalendar::days_to_date(0), 19700101);
+	EXPECT_EQ(TradingCalendar::date_to_days(19691231), -1);
+
+	//闰年和世纪年
+	EXPECT_EQ(TradingCalendar::date_to_days(20000301) - TradingCalendar::date_to_days(20000228), 2);
+	EXPECT_EQ(TradingCalendar::date_to_days(19000301) - TradingCalendar::date_to_days(19000228), 1);
+	EXPECT_EQ(TradingCalendar::days_to_date(TradingCalendar::date_to_days(20240229)), 20240229);
+
+	for (int32_t days = -30000; days < 60000; days++)
+	{
+		uint32_t uDate = TradingCalendar::days_to_date(days);
+		EXPECT_EQ(TradingCalendar::date_to_days(uDate), days);
+	}
+
+	EXPECT_EQ(TradingCalendar::weekday(19700101), 4);
+	EXPECT_EQ(TradingCalendar::weekday(20240101), 1);
+	EXPECT_EQ(TradingCalendar::weekday(20240210), 6);
+}
+
+TEST_F(test_tradingcalendar, is_trading_date)
+{
+	EXPECT_FALSE(_cal.is_empty());
+	EXPECT_TRUE(_cal.is_trading_date(20231225));
+	EXPECT_FALSE(_cal.is_trading_date(20240101));
+	EXPECT_TRUE(_cal.is_trading_date(20240102));
+	EXPECT_FALSE(_cal.is_trading_date(20240210));
+	EXPECT_FALSE(_cal.is_trading_date(20240214));
+	EXPECT_TRUE(_cal.is_trading_date(20240229));
+}
+
+TEST_F(test_tradingcalendar, next_prev)
+{
+	//跨周末
+	EXPECT_EQ(_cal.next_tdate(20240105), 20240108);
+	EXPECT_EQ(_cal.prev_tdate(20240108), 20240105);
+	EXPECT_EQ(_cal.next_tdate(20240106), 20240108);
+	EXPECT_EQ(_cal.prev_tdate(20240107), 20240105);
+
+	//跨元旦
+	EXPECT_EQ(_cal.next_tdate(20231229), 20240102);
+	EXPECT_EQ(_cal.prev_tdate(20240102), 20231229);
+	EXPECT_EQ(_cal.next_tdate(20240101), 20240102);
+
+	//跨春节
+	EXPECT_EQ(_cal.next_tdate(20240209), 20240219);
+	EXPECT_EQ(_cal.prev_tdate(20240219), 20240209);
+	EXPECT_EQ(_cal.next_tdate(20240214), 20240219);
+	EXPECT_EQ(_cal.prev_tdate(20240214), 20240209);
+	EXPECT_EQ(_cal.next_tdate(20240209, 2), 20240220);
+	EXPECT_EQ(_cal.prev_tdate(20240219, 2), 20240208);
+}
+
+TEST_F(test_tradingcalendar, range_edges)
+{
+	EXPECT_EQ(_cal.size(), 43);
+	EXPECT_EQ(_cal.count_tdates(20231225, 20240229), 43);
+	EXPECT_EQ(_cal.count_tdates(20240205, 20240218), 5);
+	EXPECT_EQ(_cal.count_tdates(20240210, 20240218), 0);
+	EXPECT_EQ(_cal.count_tdates(20240229, 20231225), 0);
+	EXPECT_EQ(_cal.count_tdates(20231225, 20231225), 1);
+
+	EXPECT_EQ(_cal.tdate_at(0), 20231225);
+	EXPECT_EQ(_cal.tdate_at(42), 20240229);
+	EXPECT_EQ(_cal.tdate_at(43), 0);
+
+	//超出区间返回0，由调用方回退到逐日计算
+	EXPECT_EQ(_cal.prev_tdate(20231225), 0);
+	EXPECT_EQ(_cal.next_tdate(20240229), 0);
+	EXPECT_EQ(_cal.next_tdate(20231224), 0);
+	EXPECT_EQ(_cal.prev_tdate(20240301), 0);
+	EXPECT_FALSE(_cal.in_range(20231224));
+	EXPECT_FALSE(_cal.in_range(20240301));
+}
@@ -331,15 +331,8 @@ int TraderCTP::logout()
 	return 0;
 }
 
-int TraderCTP::orderInsert(WTSEntrust* entrust)
+void TraderCTP::fillOrderField(WTSEntrust* entrust, CThostFtdcInputOrderField& req)
 {
-	if (m_pUserAPI == NULL || m_wrapperState != WS_ALLREADY)
-	{
-		write_log(m_sink, LL_ERROR, "[TraderCTP] Trading channel not ready");
-		return -1;
-	}
-
-	CThostFtdcInputOrderField req;
 	memset(&req, 0, sizeof(req));
 	wt_strcpy(req.BrokerID, m_strBroker.c_str(), m_strBroker.size());
 	wt_strcpy(req.InvestorID, m_strUser.c_str(), m_strUser.size());
@@ -347,26 +340,6 @@ int TraderCTP::orderInsert(WTSEntrust* entrust)
 	wt_strcpy(req.InstrumentID, entrust->getCode());
 	wt_strcpy(req.ExchangeID, entrust->getExchg());
 
-	if (strlen(entrust->getUserTag()) == 0)
-	{
-		///报单引用
-		fmt::format_to(req.OrderRef, "{}", m_orderRef.fetch_add(0));
-	}
-	else
-	{
-		uint32_t fid, sid, orderref;
-		extractEntrustID(entrust->getEntrustID(), fid, sid, orderref);
-		///报单引用
-		fmt::format_to(req.OrderRef, "{}", orderref);
-	}
-
-	if (strlen(entrust->getUserTag()) > 0)
-	{
-		m_eidCache.put(entrust->getEntrustID(), entrust->getUserTag(), 0, [this](const char* message) {
-			write_log(m_sink, LL_WARN, message);
-		});
-	}
-
 	///报单价格条件: 限价
 	req.OrderPriceType = wrapPriceType(entrust->getPriceType(), strcmp(entrust->getExchg(), "CFFEX") == 0);
 	///买卖方向: 
@@ -375,10 +348,6 @@ int TraderCTP::orderInsert(WTSEntrust* entrust)
 	req.CombOffsetFlag[0] = wrapOffsetType(entrust->getOffsetType());
 	///组合投机套保标志
 	req.CombHedgeFlag[0] = THOST_FTDC_HF_Speculation;
-	///价格
-	req.LimitPrice = entrust->getPrice();
-	///数量: 1
-	req.VolumeTotalOriginal = (int)entrust->getVolume();
 
 	if(entrust->getOrderFlag() == WOF_NOR)
 	{
@@ -405,6 +374,89 @@ int TraderCTP::orderInsert(WTSEntrust* entrust)
 	req.IsAutoSuspend = 0;
 	///用户强评标志: 否
 	req.UserForceClose = 0;
+}
+
+int TraderCTP::orderInsert(WTSEntrust* entrust)
+{
+	if (m_pUserAPI == NULL || m_wrapperState != WS_ALLREADY)
+	{
+		write_log(m_sink, LL_ERROR, "[TraderCTP] Trading channel not ready");
+		return -1;
+	}
+
+	CThostFtdcInputOrderField req;
+	fillOrderField(entrust, req);
+
+	if (strlen(entrust->getUserTag()) == 0)
+	{
+		///报单引用
+		fmt::format_to(req.OrderRef, "{}", m_orderRef.fetch_add(0));
+	}
+	else
+	{
+		uint32_t fid, sid, orderref;
+		extractEntrustID(entrust->getEntrustID(), fid, sid, orderref);
+		///报单引用
+		fmt::format_to(req.OrderRef, "{}", orderref);
+	}
+
+	if (strlen(entrust->getUserTag()) > 0)
+	{
+		m_eidCache.put(entrust->getEntrustID(), entrust->getUserTag(), 0, [this](const char* message) {
+			write_log(m_sink, LL_WARN, message);
+		});
+	}
+
+	///价格
+	req.LimitPrice = entrust->getPrice();
+	///数量: 1
+	req.VolumeTotalOriginal = (int)entrust->getVolume();
+
+	int iResult = m_pUserAPI->ReqOrderInsert(&req, genRequestID());
+	if (iResult != 0)
+	{
+		write_log(m_sink, LL_ERROR, "[TraderCTP] Order inserting failed: {}", iResult);
+	}
+
+	return 0;
+}
+
+uint32_t TraderCTP::stageOrder(WTSEntrust* entrust)
+{
+	if (entrust == NULL)
+		return 0;
+
+	m_stagedOrders.emplace_back();
+	fillOrderField(entrust, m_stagedOrders.back());
+	return (uint32_t)m_stagedOrders.size();
+}
+
+int TraderCTP::orderInsertStaged(uint32_t stageid, double price, double qty, const char* userTag)
+{
+	if (m_pUserAPI == NULL || m_wrapperState != WS_ALLREADY)
+	{
+		write_log(m_sink, LL_ERROR, "[TraderCTP] Trading channel not ready");
+		return -1;
+	}
+
+	if (stageid == 0 || stageid > m_stagedOrders.size())
+		return -1;
+
+	//模板里的静态字段已经填好了，这里只改报单引用、价格和数量
+	CThostFtdcInputOrderField req = m_stagedOrders[stageid - 1];
+	uint32_t orderref = m_orderRef.fetch_add(1) + 1;
+	fmtutil::format_to(req.OrderRef, "{}", orderref);
+	req.LimitPrice = price;
+	req.VolumeTotalOriginal = (int)qty;
+
+	if (userTag != NULL && userTag[0] != '\0')
+	{
+		char entrustid[64];
+		generateEntrustID(entrustid, m_frontID, m_sessionID, orderref);
+		m_eidCache.put(entrustid, userTag, 0, [this](const char* message) {
+			write_log(m_sink, LL_WARN, message);
+		});
+	}
 
 	int iResult = m_pUserAPI->ReqOrderInsert(&req, genRequestID());
 	if (iResult != 0)
@@ -11,6 +11,7 @@
 
 #include <string>
 #include <queue>
+#include <vector>
 #include <stdint.h>
 
 #include "../Includes/WTSTypes.h"
@@ -77,6 +78,10 @@ public:
 
 	virtual int orderInsert(WTSEntrust* eutrust) override;
 
+	virtual uint32_t stageOrder(WTSEntrust* entrust) override;
+
+	virtual int orderInsertStaged(uint32_t stageid, double price, double qty, const char* userTag) override;
+
 	virtual int orderAction(WTSEntrustAction* action) override;
 
 	virtual int queryAccount() override;
@@ -159,6 +164,11 @@ private:
 	WTSError*		makeError(CThostFtdcRspInfoField* rspInfo, WTSErroCode ec = WEC_NONE);
 	WTSTradeInfo*	makeTradeInfo(CThostFtdcTradeField *tradeField);
 
+	/*
+	 *	填充委托结构里除了报单引用、价格和数量以外的字段
+	 */
+	void			fillOrderField(WTSEntrust* entrust, CThostFtdcInputOrderField& req);
+
 	void			generateEntrustID(char* buffer, uint32_t frontid, uint32_t sessionid, uint32_t orderRef);
 	bool			extractEntrustID(const char* entrustid, uint32_t &frontid, uint32_t &sessionid, uint32_t &orderRef);
 
@@ -224,5 +234,8 @@ protected:
 	WtKVCache		m_eidCache;
 	//订单标记缓存器
 	WtKVCache		m_oidCache;
+
+	//预置的下单模板，下标为模板编号-1
+	std::vector<CThostFtdcInputOrderField>	m_stagedOrders;
 };
 
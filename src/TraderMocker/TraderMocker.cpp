@@ -1,6 +1,7 @@
 ﻿#include "TraderMocker.h"
 
 #include "../Includes/WTSVariant.hpp"
+#include "../Includes/WTSStruct.h"
 #include "../Includes/WTSDataDef.hpp"
 #include "../Includes/WTSTradeDef.hpp"
 #include "../Includes/WTSContractInfo.hpp"
@@ -49,9 +50,75 @@ extern "C"
 	}
 }
 
-std::vector<uint32_t> splitVolume(uint32_t vol, uint32_t minQty = 1, uint32_t maxQty = 100)
+void LatencyModel::init(WTSVariant* cfg)
 {
-	uint32_t length = maxQty - minQty + 1;
+	_mode = LM_Fixed;
+	_p1 = 0;
+	_p2 = 0;
+
+	if (cfg == NULL)
+		return;
+
+	if (!cfg->isObject())
+	{
+		_p1 = cfg->asDouble();
+		return;
+	}
+
+	const char* mode = cfg->getCString("mode");
+	if (strcmp(mode, "uniform") == 0)
+	{
+		_mode = LM_Uniform;
+		_p1 = cfg->getDouble("min");
+		_p2 = cfg->getDouble("max");
+		if (_p2 < _p1)
+			_p2 = _p1;
+	}
+	else if (strcmp(mode, "normal") == 0)
+	{
+		_mode = LM_Normal;
+		_p1 = cfg->getDouble("mean");
+		_p2 = cfg->getDouble("stdev");
+	}
+	else if (strcmp(mode, "exponential") == 0)
+	{
+		_mode = LM_Exponential;
+		_p1 = cfg->getDouble("mean");
+	}
+	else
+	{
+		_p1 = cfg->getDouble("value");
+	}
+}
+
+int64_t LatencyModel::sample(std::mt19937_64& rng) const
+{
+	double ret = _p1;
+	switch (_mode)
+	{
+	case LM_Uniform:
+		ret = std::uniform_real_distribution<double>(_p1, _p2)(rng);
+		break;
+	case LM_Normal:
+		if (_p2 > 0)
+			ret = std::normal_distribution<double>(_p1, _p2)(rng);
+		break;
+	case LM_Exponential:
+		if (_p1 > 0)
+			ret = std::exponential_distribution<double>(1.0 / _p1)(rng);
+		break;
+	default:
+		break;
+	}
+
+	//正态分布可能采样出负数，延迟最小为0
+	return (ret > 0) ? (int64_t)ret : 0;
+}
+
+std::vector<uint32_t> TraderMocker::split_volume(uint32_t vol)
+{
+	uint32_t minQty = (uint32_t)_min_qty;
+	uint32_t maxQty = (uint32_t)_max_qty;
 	std::vector<uint32_t> ret;
 	if (vol <= minQty)
 	{
@@ -59,11 +126,11 @@ std::vector<uint32_t> splitVolume(uint32_t vol, uint32_t minQty = 1, uint32_t ma
 	}
 	else
 	{
+		std::uniform_int_distribution<uint32_t> dist(minQty, maxQty);
 		uint32_t left = vol;
-		srand((uint32_t)time(NULL));
 		while (left > 0)
 		{
-			uint32_t curVol = minQty + (uint32_t)rand() % length;
+			uint32_t curVol = dist(_rng);
 
 			if (curVol >= left)
 				curVol = left;
@@ -78,20 +145,32 @@ std::vector<uint32_t> splitVolume(uint32_t vol, uint32_t minQty = 1, uint32_t ma
 
 	return ret;
 }
+
 TraderMocker::TraderMocker()
 	: _terminated(false)
+	, _poll_mode(false)
+	, _logined(false)
 	, _listener(NULL)
-	, _ticks(NULL)
+	, _bd_mgr(NULL)
 	, _orders(NULL)
-	, _awaits(NULL)
 	, _trades(NULL)
+	, _staged(NULL)
+	, _last_due(0)
+	, _timer_armed(false)
+	, _pos_dirty(false)
+	, _persist_span(1000)
 	, _b_socket(NULL)
-	, _max_tick_time(0)
-	, _last_match_time(0)
 {
 	_auto_order_id = (uint32_t)((TimeUtils::getLocalTimeNow() - TimeUtils::makeTime(20200101, 0)) / 1000 * 100);
 	_auto_trade_id = (uint32_t)((TimeUtils::getLocalTimeNow() - TimeUtils::makeTime(20200101, 0)) / 1000 * 300);
 	_auto_entrust_id = (uint32_t)((TimeUtils::getLocalTimeNow() - TimeUtils::makeTime(20200101, 0)) / 1000 * 100);
+
+	//时间戳都从单调时钟换算，只在启动的时候读一次本地时间
+	_anchor_us = now_us();
+	_anchor_ms = TimeUtils::getLocalTimeNow();
+	_cur_date = TimeUtils::getCurDate();
+
+	_timer = new boost::asio::steady_timer(_io_service);
 }
 
 
@@ -103,8 +182,10 @@ TraderMocker::~TraderMocker()
 	if (_trades)
 		_trades->release();
 
-	if (_ticks)
-		_ticks->release();
+	if (_staged)
+		_staged->release();
+
+	delete _timer;
 }
 
 uint32_t TraderMocker::makeTradeID()
@@ -124,7 +205,7 @@ bool TraderMocker::makeEntrustID(char* buffer, int length)
 
 	try
 	{
-		fmtutil::format_to(buffer, "me.{}.{}.{}", TimeUtils::getCurDate(), _mocker_id, _auto_entrust_id++);
+		fmtutil::format_to(buffer, "me.{}.{}.{}", _cur_date, _mocker_id, _auto_entrust_id++);
 		return true;
 	}
 	catch (...)
@@ -135,6 +216,62 @@ bool TraderMocker::makeEntrustID(char* buffer, int length)
 	return false;
 }
 
+TraderMocker::OrderBook* TraderMocker::get_book(WTSContractInfo* ct)
+{
+	OrderBookPtr& book = _books[ct->getFullCode()];
+	if (book == NULL)
+	{
+		book.reset(new OrderBook);
+		book->_ct = ct;
+
+		write_log(_listener, LL_INFO, "共有{}个品种有待撮合订单", _books.size());
+	}
+
+	return book.get();
+}
+
+void TraderMocker::schedule(const LatencyModel& latency, DelayedTask task)
+{
+	int64_t now = now_us();
+	if (latency.is_zero() && _delayed.empty())
+	{
+		task(now);
+		return;
+	}
+
+	int64_t due = std::max(now + latency.sample(_rng), _last_due);
+	_last_due = due;
+	_delayed.emplace_back(DelayedItem{ due, std::move(task) });
+
+	if (!_timer_armed)
+		arm_timer();
+}
+
+void TraderMocker::arm_timer()
+{
+	_timer_armed = true;
+	_timer->expires_after(std::chrono::microseconds(std::max(_delayed.front()._due - now_us(), (int64_t)0)));
+	_timer->async_wait(boost::bind(&TraderMocker::on_timer, this, boost::asio::placeholders::error));
+}
+
+void TraderMocker::on_timer(const boost::system::error_code& e)
+{
+	_timer_armed = false;
+	if (e || _terminated)
+		return;
+
+	int64_t now = now_us();
+	while (!_delayed.empty() && _delayed.front()._due <= now)
+	{
+		DelayedItem item = std::move(_delayed.front());
+		_delayed.pop_front();
+		item._task(item._due);
+	}
+
+	if (!_delayed.empty())
+		arm_timer();
+}
+
 int TraderMocker::orderInsert(WTSEntrust* entrust)
 {	
 	if (entrust == NULL)
@@ -144,8 +281,6 @@ int TraderMocker::orderInsert(WTSEntrust* entrust)
 
 	entrust->retain();
 	_io_service.post([this, entrust](){
-		StdUniqueLock lock(_mutex_api);
-
 		WTSContractInfo* ct = entrust->getContractInfo();
 		if(ct == NULL) 
 			ct = _bd_mgr->getContract(entrust->getCode(), entrust->getExchg());
@@ -231,6 +366,7 @@ int TraderMocker::orderInsert(WTSEntrust* entrust)
 			}
 
 			//如果没有持仓或者持仓不够,也要
+			SpinLock lock(_mtx_pos);
 			auto it = _positions.find(ct->getFullCode());
 			if(it == _positions.end())
 			{
@@ -259,6 +395,7 @@ int TraderMocker::orderInsert(WTSEntrust* entrust)
 			{
 				pItem._short._frozen += entrust->getVolume();
 			}
+			_pos_dirty = true;
 
 			bPass = true;
 			msg = "下单成功";
@@ -267,257 +404,284 @@ int TraderMocker::orderInsert(WTSEntrust* entrust)
 		
 		if(bPass)
 		{
-			WTSOrderInfo* ordInfo = WTSOrderInfo::create();
-			ordInfo->setContractInfo(ct);
-			ordInfo->setCode(entrust->getCode());
-			ordInfo->setExchange(entrust->getExchg());
-			ordInfo->setDirection(entrust->getDirection());
-			ordInfo->setOffsetType(entrust->getOffsetType());
-			ordInfo->setUserTag(entrust->getUserTag());
-			ordInfo->setPrice(entrust->getPrice());
-			thread_local static char str[64];
-			fmtutil::format_to(str, "mo.{}.{}", _mocker_id, makeOrderID());
-			ordInfo->setOrderID(str);
-			ordInfo->setStateMsg(msg.c_str());
-			ordInfo->setOrderState(WOS_NotTraded_Queuing);
-			ordInfo->setOrderTime(TimeUtils::getLocalTimeNow());
-			ordInfo->setVolume(entrust->getVolume());
-			ordInfo->setVolLeft(entrust->getVolume());
-			ordInfo->setPriceType(entrust->getPriceType());
-			ordInfo->setOrderFlag(entrust->getOrderFlag());
-
-			if (_listener != NULL)
-			{
-				_listener->onRspEntrust(entrust, NULL);
-				_listener->onPushOrder(ordInfo);
-			}
-
-			_codes.insert(ct->getFullCode());
-
-			if(_listener)
-			{
-				write_log(_listener,LL_INFO, "共有{}个品种有待撮合订单", _codes.size());
-			}
-
-			if (_orders == NULL)
-				_orders = WTSArray::create();
-			_orders->append(ordInfo, false);
-
-			if (_awaits == NULL)
-				_awaits = OrderCache::create();
-
-			_awaits->add(ordInfo->getOrderID(), ordInfo, true);
+			//委托到达交易所的时候才回报，同时进入订单簿
+			schedule(_ack_latency, [this, entrust, ct, msg](int64_t evtTime) {
+				WTSOrderInfo* ordInfo = WTSOrderInfo::create();
+				ordInfo->setContractInfo(ct);
+				ordInfo->setCode(entrust->getCode());
+				ordInfo->setExchange(entrust->getExchg());
+				ordInfo->setDirection(entrust->getDirection());
+				ordInfo->setOffsetType(entrust->getOffsetType());
+				ordInfo->setUserTag(entrust->getUserTag());
+				ordInfo->setPrice(entrust->getPrice());
+				thread_local static char str[64];
+				fmtutil::format_to(str, "mo.{}.{}", _mocker_id, makeOrderID());
+				ordInfo->setOrderID(str);
+				ordInfo->setStateMsg(msg.c_str());
+				ordInfo->setOrderState(WOS_NotTraded_Queuing);
+				ordInfo->setOrderTime(to_local_time(evtTime));
+				ordInfo->setVolume(entrust->getVolume());
+				ordInfo->setVolLeft(entrust->getVolume());
+				ordInfo->setPriceType(entrust->getPriceType());
+				ordInfo->setOrderFlag(entrust->getOrderFlag());
+
+				if (_listener != NULL)
+				{
+					StdUniqueLock lock(_mutex_api);
+					_listener->onRspEntrust(entrust, NULL);
+					_listener->onPushOrder(ordInfo);
+				}
 
-			save_positions();
+				if (_orders == NULL)
+					_orders = WTSArray::create();
+				_orders->append(ordInfo, false);
+
+				BookOrderPtr bOrder(new BookOrder);
+				bOrder->_order = ordInfo;
+				bOrder->_price = entrust->getPrice();
+				bOrder->_volume = entrust->getVolume();
+				bOrder->_left = entrust->getVolume();
+				bOrder->_is_buy = (entrust->getDirection() == WDT_LONG && entrust->getOffsetType() == WOT_OPEN) || (entrust->getDirection() != WDT_LONG && entrust->getOffsetType() != WOT_OPEN);
+				bOrder->_closed = false;
+
+				_awaits[ordInfo->getOrderID()] = bOrder;
+				OrderBook* book = get_book(ct);
+				book->_orders.emplace_back(bOrder);
+
+				//如果已经有行情了，先用最新行情撮合一次，不然要等到下一笔行情才能成交
+				auto tit = _last_ticks.find(ct->getFullCode());
+				if (tit != _last_ticks.end() && match_order(bOrder.get(), ct, tit->second) && bOrder->_closed)
+					book->_orders.pop_back();
+
+				entrust->release();
+			});
 		}
 		else
 		{
 			WTSError* err = WTSError::create(WEC_ORDERINSERT, msg.c_str());
 			if (_listener != NULL)
 			{
+				StdUniqueLock lock(_mutex_api);
 				_listener->onRspEntrust(entrust, err);
 			}
 			err->release();
+			entrust->release();
 		}
-		entrust->release();
 	});
 
 	return 0;
 }
 
-int32_t TraderMocker::match_once()
+uint32_t TraderMocker::stageOrder(WTSEntrust* entrust)
 {
-	if (_terminated || _orders == NULL || _orders->size() == 0 || _ticks == NULL)
+	if (entrust == NULL || _bd_mgr == NULL)
 		return 0;
-	
-	int32_t count = 0;
-	for (const std::string& fullcode : _codes)
+
+	WTSContractInfo* ct = entrust->getContractInfo();
+	if (ct == NULL)
+		ct = _bd_mgr->getContract(entrust->getCode(), entrust->getExchg());
+
+	if (ct == NULL)
+		return 0;
+
+	WTSEntrust* tpl = WTSEntrust::create(entrust->getCode(), 0, 0, entrust->getExchg(), entrust->getBusinessType());
+	tpl->setContractInfo(ct);
+	tpl->setDirection(entrust->getDirection());
+	tpl->setOffsetType(entrust->getOffsetType());
+	tpl->setPriceType(entrust->getPriceType());
+	tpl->setOrderFlag(entrust->getOrderFlag());
+
+	if (_staged == NULL)
+		_staged = WTSArray::create();
+	_staged->append(tpl, false);
+
+	return _staged->size();
+}
+
+int TraderMocker::orderInsertStaged(uint32_t stageid, double price, double qty, const char* userTag)
+{
+	if (_staged == NULL || stageid == 0 || stageid > _staged->size())
+		return -1;
+
+	WTSEntrust* tpl = (WTSEntrust*)_staged->at(stageid - 1);
+	WTSEntrust* entrust = WTSEntrust::create(tpl->getCode(), qty, price, tpl->getExchg(), tpl->getBusinessType());
+	entrust->setContractInfo(tpl->getContractInfo());
+	entrust->setDirection(tpl->getDirection());
+	entrust->setOffsetType(tpl->getOffsetType());
+	entrust->setPriceType(tpl->getPriceType());
+	entrust->setOrderFlag(tpl->getOrderFlag());
+	makeEntrustID(entrust->getEntrustID(), 64);
+	entrust->setUserTag(userTag);
+
+	int ret = orderInsert(entrust);
+	entrust->release();
+	return ret;
+}
+
+uint32_t TraderMocker::match_book(OrderBook* book, const WTSTickStruct& curTick)
+{
+	if (!decimal::gt(curTick.price, 0))
+		return 0;
+
+	uint32_t count = 0;
+	std::size_t keep = 0;
+	auto& orders = book->_orders;
+	for (std::size_t idx = 0; idx < orders.size(); idx++)
 	{
-		if (_terminated)
-			return count;
+		BookOrder* bOrder = orders[idx].get();
+		if (match_order(bOrder, book->_ct, curTick))
+			count++;
 
-		std::string code, exchg;
-		auto pos = fullcode.find(".");
-		exchg = fullcode.substr(0, pos);
-		code = fullcode.substr(pos + 1);
+		if (!bOrder->_closed)
+		{
+			if (keep != idx)
+				orders[keep] = orders[idx];
+			keep++;
+		}
+	}
+	orders.resize(keep);
+
+	return count;
+}
 
-		WTSContractInfo* ct = _bd_mgr->getContract(code.c_str(), exchg.c_str());
-		if (ct == NULL)
+bool TraderMocker::match_order(BookOrder* bOrder, WTSContractInfo* ct, const WTSTickStruct& curTick)
+{
+	if (!decimal::gt(curTick.price, 0))
+		return false;
+
+	WTSCommodityInfo* commInfo = ct->getCommInfo();
+
+	//已经撤单或者成交完的不再撮合
+	if (bOrder->_closed)
+		return false;
+
+	double uPrice, uVolume;
+	if (bOrder->_is_buy)
+	{
+		uPrice = curTick.ask_prices[0];
+		uVolume = curTick.ask_qty[0];
+	}
+	else
+	{
+		uPrice = curTick.bid_prices[0];
+		uVolume = curTick.bid_qty[0];
+	}
+
+	if (decimal::eq(uVolume, 0))
+		return false;
+
+	if (_use_newpx)
+	{
+		uPrice = curTick.price;
+	}
+
+	if (decimal::eq(uPrice, 0))
+		return false;
+
+	WTSOrderInfo* ordInfo = bOrder->_order;
+	double target = bOrder->_price;
+	//买入的时候,委托价格小于最新价则不成交,卖出的时候,委托价大于最新价则不成交
+	if (ordInfo->getPriceType() == WPT_LIMITPRICE && ((bOrder->_is_buy && decimal::lt(target, uPrice)) || (!bOrder->_is_buy && decimal::gt(target, uPrice))))
+		return false;
+
+	double maxVolume = min(uVolume, bOrder->_left);
+	std::vector<uint32_t> ayVol = split_volume((uint32_t)maxVolume);
+	for (uint32_t curVol : ayVol)
+	{
+		if (curVol == 0)
 			continue;
 
-		WTSCommodityInfo* commInfo = ct->getCommInfo();
+		//交易所端的订单和持仓马上更新，订单对象等回报的时候再更新
+		bOrder->_left -= curVol;
+		if (decimal::eq(bOrder->_left, 0))
+		{
+			bOrder->_left = 0;
+			bOrder->_closed = true;
+			_awaits.erase(ordInfo->getOrderID());
+		}
 
-		WTSTickData* curTick = (WTSTickData*)_ticks->grab(fullcode);
-		if (curTick && strcmp(curTick->code(), ct->getCode())==0)
+		if(commInfo->getCoverMode() != CM_None)
 		{
-			StdUniqueLock lock(_mtx_awaits);
-			uint64_t tickTime = (uint64_t)curTick->actiondate() * 1000000000 + curTick->actiontime();
-			if (decimal::gt(curTick->price(), 0) /*&& tickTime >= _last_match_time*/)
+			SpinLock lock(_mtx_pos);
+			PosItem& pItem = _positions[ct->getFullCode()];
+			//第一次的话要给代码和交易所赋值
+			if(strlen(pItem._code) == 0)
 			{
-				//开始处理订单
-				//处理记录
-				std::vector<std::string> to_erase;
-
-				for (auto it = _awaits->begin(); it != _awaits->end(); it++)
-				{
-					WTSOrderInfo* ordInfo = (WTSOrderInfo*)it->second;
-					if (ordInfo->getVolLeft() == 0 || strcmp(ordInfo->getCode(), curTick->code()) != 0)
-						continue;
-
-					bool isBuy = (ordInfo->getDirection() == WDT_LONG && ordInfo->getOffsetType() == WOT_OPEN) || (ordInfo->getDirection() != WDT_LONG && ordInfo->getOffsetType() != WOT_OPEN);
-
-					double uPrice, uVolume;
-					if (isBuy)
-					{
-						uPrice = curTick->askprice(0);
-						uVolume = curTick->askqty(0);
-					}
-					else
-					{
-						uPrice = curTick->bidprice(0);
-						uVolume = curTick->bidqty(0);
-					}
-
-					if (decimal::eq(uVolume, 0))
-						continue;					
-
-					if (_use_newpx)
-					{
-						uPrice = curTick->price();
-					}
-
-					if (decimal::eq(uPrice, 0))
-						continue;
-
-					double target = ordInfo->getPrice();
-					//买入的时候,委托价格小于最新价则不成交,卖出的时候,委托价大于最新价则不成交
-					if (ordInfo->getPriceType() == WPT_LIMITPRICE && ((isBuy && decimal::lt(target, uPrice)) || (!isBuy && decimal::gt(target, uPrice))))
-						continue;
-
-					count++;
-
-					double maxVolume = min(uVolume, ordInfo->getVolLeft());
-					std::vector<uint32_t> ayVol = splitVolume((uint32_t)maxVolume, (uint32_t)_min_qty, (uint32_t)_max_qty);
-					for (uint32_t curVol : ayVol)
-					{
-
-						WTSTradeInfo* trade = WTSTradeInfo::create(curTick->code(), curTick->exchg());
-						trade->setDirection(ordInfo->getDirection());
-						trade->setOffsetType(ordInfo->getOffsetType());
-						trade->setContractInfo(ct);
-
-						trade->setPrice(uPrice);
-						trade->setVolume(curVol);
-
-						trade->setRefOrder(ordInfo->getOrderID());
-
-						char str[64];
-						fmtutil::format_to(str, "mt.{}.{}", _mocker_id, makeTradeID());
-						trade->setTradeID(str);
-
-						trade->setTradeTime(TimeUtils::getLocalTimeNow());
-						trade->setUserTag(ordInfo->getUserTag());
-
-						//更新订单数据
-						ordInfo->setVolLeft(ordInfo->getVolLeft() - curVol);
-						ordInfo->setVolTraded(ordInfo->getVolTraded() - curVol);
-						if (decimal::eq(ordInfo->getVolLeft(), 0))
-						{
-							ordInfo->setOrderState(WOS_AllTraded);
-							ordInfo->setStateMsg("AllTrd");
-							to_erase.emplace_back(ordInfo->getOrderID());
-						}
-						else
-						{
-							ordInfo->setOrderState(WOS_PartTraded_Queuing);
-							ordInfo->setStateMsg("PartTrd");
-						}
-
-						PosItem& pItem = _positions[ct->getFullCode()];
-						//第一次的话要给代码和交易所赋值
-						if(strlen(pItem._code) == 0)
-						{
-							strcpy(pItem._code, ct->getCode());
-							strcpy(pItem._exchg, ct->getExchg());
-						}
-
-						if(commInfo->getCoverMode() == CM_None)
-						{
-
-						}
-						else
-						{
-							if (ordInfo->getDirection() == WDT_LONG)
-							{
-								if (ordInfo->getOffsetType() == WOT_OPEN)
-								{
-									pItem._long._volume += curVol;
-								}
-								else
-								{
-									pItem._long._volume -= curVol;
-									pItem._long._frozen -= curVol;
-								}
-							}
-							else
-							{
-								if (ordInfo->getOffsetType() == WOT_OPEN)
-								{
-									pItem._short._volume += curVol;
-								}
-								else
-								{
-									pItem._short._volume -= curVol;
-									pItem._short._frozen -= curVol;
-								}
-							}
-						}
-						
-
-						if (_listener)
-						{
-							StdUniqueLock lock(_mutex_api);
-							_listener->onPushOrder(ordInfo);
-							_listener->onPushTrade(trade);
-						}
-
-						if (_trades == NULL)
-							_trades = WTSArray::create();
-
-						_trades->append(trade, false);
-					}
-				}
+				wt_strcpy(pItem._code, ct->getCode());
+				wt_strcpy(pItem._exchg, ct->getExchg());
+			}
 
-				if (count > 0)
-				{
-					//write_log(_listener,LL_INFO, "[TraderMocker]触发 %s.%s 开多 %u 条,价格:%u", tick->exchg(), tick->code(), iCount, uPrice);
-					for (const std::string& oid : to_erase)
-					{
-						_awaits->remove(oid);
-					}
-				}
+			PosUnit& pUnit = (ordInfo->getDirection() == WDT_LONG) ? pItem._long : pItem._short;
+			if (ordInfo->getOffsetType() == WOT_OPEN)
+			{
+				pUnit._volume += curVol;
+			}
+			else
+			{
+				pUnit._volume -= curVol;
+				pUnit._frozen -= curVol;
 			}
+			_pos_dirty = true;
 		}
 
-		if(curTick)
-			curTick->release();
-	}
+		double leftQty = bOrder->_left;
+		double tradedQty = bOrder->_volume - bOrder->_left;
+		schedule(_fill_latency, [this, ordInfo, ct, uPrice, curVol, leftQty, tradedQty](int64_t evtTime) {
+			WTSTradeInfo* trade = WTSTradeInfo::create(ordInfo->getCode(), ordInfo->getExchg());
+			trade->setDirection(ordInfo->getDirection());
+			trade->setOffsetType(ordInfo->getOffsetType());
+			trade->setContractInfo(ct);
 
-	_last_match_time = _max_tick_time;
+			trade->setPrice(uPrice);
+			trade->setVolume(curVol);
 
-	_ticks->clear();
+			trade->setRefOrder(ordInfo->getOrderID());
 
-	if(count > 0)
-		save_positions();
+			char str[64];
+			fmtutil::format_to(str, "mt.{}.{}", _mocker_id, makeTradeID());
+			trade->setTradeID(str);
 
-	return count;
+			trade->setTradeTime(to_local_time(evtTime));
+			trade->setUserTag(ordInfo->getUserTag());
+
+			//更新订单数据
+			ordInfo->setVolLeft(leftQty);
+			ordInfo->setVolTraded(tradedQty);
+			if (decimal::eq(leftQty, 0))
+			{
+				ordInfo->setOrderState(WOS_AllTraded);
+				ordInfo->setStateMsg("AllTrd");
+			}
+			else
+			{
+				ordInfo->setOrderState(WOS_PartTraded_Queuing);
+				ordInfo->setStateMsg("PartTrd");
+			}
+
+			if (_listener)
+			{
+				StdUniqueLock lock(_mutex_api);
+				_listener->onPushOrder(ordInfo);
+				_listener->onPushTrade(trade);
+			}
+
+			if (_trades == NULL)
+				_trades = WTSArray::create();
+
+			_trades->append(trade, false);
+		});
+
+		if (bOrder->_closed)
+			break;
+	}
+
+	return true;
 }
 
 //////////////////////////////////////////////////////////////////////////
 
 bool TraderMocker::init(WTSVariant *params)
 {
-	_millisecs = params->getUInt32("span");
 	_use_newpx = params->getBoolean("newpx");
 	_mocker_id = params->getUInt32("mockerid");
 	_max_qty = params->getDouble("maxqty");
@@ -534,6 +698,19 @@ bool TraderMocker::init(WTSVariant *params)
 	if (decimal::eq(_min_qty, 0))
 		_min_qty = 1;
 
+	//回报延迟，单位微秒，默认没有延迟
+	_ack_latency.init(params->get("ack_latency"));
+	_fill_latency.init(params->get("fill_latency"));
+
+	//固定随机种子可以让压测结果可复现
+	if (params->has("seed"))
+		_rng.seed(params->getUInt64("seed"));
+	else
+		_rng.seed(std::random_device()());
+
+	if (params->has("persist_span"))
+		_persist_span = max(params->getUInt32("persist_span"), (uint32_t)1);
+
 	//加载持仓数据
 	std::stringstream ss;
 	ss << "./mocker_" << _mocker_id << "/";
@@ -559,6 +736,7 @@ void TraderMocker::load_positions()
 	if (root.HasParseError())
 		return;
 
+	SpinLock lock(_mtx_pos);
 	if(root.HasMember("positions"))
 	{//读取仓位
 		double total_profit = 0;
@@ -591,6 +769,15 @@ void TraderMocker::load_positions()
 
 void TraderMocker::save_positions()
 {
+	//先拷贝一份快照，序列化和写文件都不占用锁
+	std::vector<PosItem> snapshot;
+	{
+		SpinLock lock(_mtx_pos);
+		snapshot.reserve(_positions.size());
+		for (auto& v : _positions)
+			snapshot.emplace_back(v.second);
+	}
+
 	rj::Document root(rj::kObjectType);
 
 	{//持仓数据保存
@@ -598,11 +785,8 @@ void TraderMocker::save_positions()
 
 		rj::Document::AllocatorType &allocator = root.GetAllocator();
 
-		for (auto& v : _positions)
+		for (const PosItem& pInfo : snapshot)
 		{
-			const char* fullcode = v.first.c_str();
-			const PosItem& pInfo = v.second;
-
 			rj::Value pItem(rj::kObjectType);
 			pItem.AddMember("exchg", rj::Value(pInfo._exchg, allocator), allocator);
 			pItem.AddMember("code", rj::Value(pInfo._code, allocator), allocator);
@@ -644,9 +828,10 @@ void TraderMocker::release()
 
 	_terminated = true;
 
-	if (_thrd_match)
+	if (_thrd_persist)
 	{
-		_thrd_match->join();
+		_thrd_persist->join();
+		_thrd_persist.reset();
 	}
 
 	if (_thrd_worker)
@@ -690,7 +875,21 @@ void TraderMocker::connect()
 {
 	reconn_udp();
 
-	_thrd_worker.reset(new StdThread(boost::bind(&boost::asio::io_service::run, &_io_service)));
+	if (!_poll_mode)
+		_thrd_worker.reset(new StdThread(boost::bind(&boost::asio::io_service::run, &_io_service)));
+
+	//持仓异步落盘，有变化才写文件
+	_thrd_persist.reset(new StdThread([this]() {
+		while (!_terminated)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(_persist_span));
+			if (_pos_dirty.exchange(false))
+				save_positions();
+		}
+
+		if (_pos_dirty.exchange(false))
+			save_positions();
+	}));
 
 	_io_service.post([this](){
 		StdUniqueLock lock(_mutex_api);
@@ -709,34 +908,45 @@ void TraderMocker::disconnect()
 
 	_terminated = true;
 
-	if (_thrd_match)
+	if (_thrd_persist)
 	{
-		_thrd_match->join();
+		_thrd_persist->join();
+		_thrd_persist.reset();
 	}
 }
 
 bool TraderMocker::isConnected()
 {
-	return _thrd_match != NULL;
+	return _logined;
 }
 
-int TraderMocker::login(const char* user, const char* pass, const char* productInfo)
+bool TraderMocker::enablePolling()
 {
-	_thrd_match.reset(new StdThread([this]() {
-		while (!_terminated)
-		{
-			match_once();
+	_poll_mode = true;
+	return true;
+}
 
-			//等待5毫秒
-			std::this_thread::sleep_for(std::chrono::milliseconds(5));
-		}
-	}));
+uint32_t TraderMocker::poll()
+{
+	if (_terminated)
+		return 0;
+
+	if (_io_service.stopped())
+		_io_service.reset();
+
+	//撮合由行情驱动，延迟回报由定时器驱动，都在io_service里完成
+	return (uint32_t)_io_service.poll();
+}
+
+int TraderMocker::login(const char* user, const char* pass, const char* productInfo)
+{
+	_logined = true;
 
 	_io_service.post([this](){
 		StdUniqueLock lock(_mutex_api);
 
 		if (_listener)
-			_listener->onLoginResult(true, "", TimeUtils::getCurDate());
+			_listener->onLoginResult(true, "", _cur_date);
 	});
 
 	return 0;
@@ -752,8 +962,7 @@ int TraderMocker::orderAction(WTSEntrustAction* action)
 	action->retain();
 	
 	_io_service.post([this, action](){
-		StdUniqueLock lck(_mtx_awaits);	//一定要把awaits锁起来,不然可能会导致一边撮合一边撤单
-		WTSOrderInfo* ordInfo = (WTSOrderInfo*)_awaits->grab(action->getOrderID());
+		auto it = _awaits.find(action->getOrderID());
 
 		/*
 		 *	撤单也要考虑几个问题
@@ -761,67 +970,155 @@ int TraderMocker::orderAction(WTSEntrustAction* action)
 		 *	2、如果是开仓,则直接撤销
 		 *	3、如果是平仓,要释放冻结
 		 */
-		if(ordInfo == NULL)
+		if(it == _awaits.end())
 		{
 			write_log(_listener,LL_ERROR, "订单{}不存在或者已完成", action->getOrderID());
 			WTSError* err = WTSError::create(WEC_ORDERCANCEL, "订单不存在或者处于不可撤销状态");
 			if (_listener)
+			{
+				StdUniqueLock lock(_mutex_api);
 				_listener->onTraderError(err);
+			}
 			err->release();
+			action->release();
 			return;
 		}
 
+		//交易所端马上撤销，订单簿撮合的时候再移走
+		BookOrderPtr bOrder = it->second;
+		_awaits.erase(it);
+		bOrder->_closed = true;
+
+		WTSOrderInfo* ordInfo = bOrder->_order;
 		WTSContractInfo* ct = ordInfo->getContractInfo();
 		WTSCommodityInfo* commInfo = ct->getCommInfo();
 
+		//开仓委托和不区分开平的直接撤销，平仓要释放冻结持仓
+		if (ordInfo->getOffsetType() != WOT_OPEN && commInfo->getCoverMode() != CM_None)
+		{
+			SpinLock lock(_mtx_pos);
+			PosItem& pItem = _positions[ct->getFullCode()];
+			bool isLong = ordInfo->getDirection() == WDT_LONG;
+			if(isLong)
+			{
+				pItem._long._frozen -= bOrder->_left;
+			}
+			else
+			{
+				pItem._short._frozen -= bOrder->_left;
+			}
+			_pos_dirty = true;
+		}
+
+		action->release();
+
+		schedule(_ack_latency, [this, ordInfo](int64_t evtTime) {
+			ordInfo->setStateMsg("撤单成功");
+			ordInfo->setOrderState(WOS_Canceled);
+
+			if (_listener)
+			{
+				StdUniqueLock lock(_mutex_api);
+				_listener->onPushOrder(ordInfo);
+			}
+		});
+	});
+
+	return 0;
+}
+
+int TraderMocker::orderModify(WTSEntrustAction* action)
+{
+	action->retain();
+
+	_io_service.post([this, action](){
+		auto it = _awaits.find(action->getOrderID());
+		BookOrder* bOrder = (it == _awaits.end()) ? NULL : it->second.get();
+
+		/*
+		 *	改单要考虑几个问题
+		 *	1、订单是否还在待撮合队列里
+		 *	2、新的价格是否合法
+		 *	3、如果是平仓,数量增加要检查可平,并调整冻结
+		 */
+		std::string msg;
 		bool bPass = false;
+		double newPrice = action->getNewPrice();
+		double newLeft = action->getNewVolume();
 		do 
 		{
-			//开仓委托直接撤单
-			if (ordInfo->getOffsetType() == WOT_OPEN)
+			if (bOrder == NULL)
 			{
-				bPass = true;
+				msg = "订单不存在或者处于不可修改状态";
 				break;
 			}
-			
-			//不区分开平的,也直接撤销
-			if (commInfo->getCoverMode() == CM_None)
+
+			WTSOrderInfo* ordInfo = bOrder->_order;
+			WTSContractInfo* ct = ordInfo->getContractInfo();
+			WTSCommodityInfo* commInfo = ct->getCommInfo();
+			if (decimal::le(newLeft, 0))
 			{
-				bPass = true;
+				msg = "委托数量不合法";
 				break;
 			}
 
-			//释放冻结持仓
-			PosItem& pItem = _positions[ct->getFullCode()];
-			bool isLong = ordInfo->getDirection() == WDT_LONG;
-			if(isLong)
+			if (!decimal::eq(newPrice, 0) && !decimal::eq(decimal::mod(newPrice, commInfo->getPriceTick()), 0))
 			{
-				pItem._long._frozen -= ordInfo->getVolLeft();
+				msg = "委托价格不合法";
+				break;
 			}
-			else
+
+			double diff = newLeft - bOrder->_left;
+			if (ordInfo->getOffsetType() != WOT_OPEN && commInfo->getCoverMode() != CM_None)
 			{
-				pItem._short._frozen -= ordInfo->getVolLeft();
+				SpinLock lock(_mtx_pos);
+				PosItem& pItem = _positions[ct->getFullCode()];
+				PosUnit& pUnit = (ordInfo->getDirection() == WDT_LONG) ? pItem._long : pItem._short;
+				if (decimal::lt(pUnit._volume - pUnit._frozen, diff))
+				{
+					msg = "没有足够的可平仓位";
+					break;
+				}
+
+				pUnit._frozen += diff;
+				_pos_dirty = true;
 			}
-			bPass = true;
 
+			bOrder->_price = newPrice;
+			bOrder->_volume += diff;
+			bOrder->_left = newLeft;
+			bPass = true;
 		} while (false);
 
-		ordInfo->setStateMsg("撤单成功");
-		ordInfo->setOrderState(WOS_Canceled);
-		//ordInfo->setVolLeft(0);	
-
-		if (_listener)
+		if(!bPass)
 		{
-			StdUniqueLock lock(_mutex_api);
-			_listener->onPushOrder(ordInfo);
+			write_log(_listener, LL_ERROR, "订单{}改单失败: {}", action->getOrderID(), msg);
+			WTSError* err = WTSError::create(WEC_ORDERMODIFY, msg.c_str());
+			if (_listener)
+			{
+				StdUniqueLock lock(_mutex_api);
+				_listener->onTraderError(err);
+			}
+			err->release();
+		}
+		else
+		{
+			WTSOrderInfo* ordInfo = bOrder->_order;
+			double newVolume = bOrder->_volume;
+			schedule(_ack_latency, [this, ordInfo, newPrice, newVolume, newLeft](int64_t evtTime) {
+				ordInfo->setPrice(newPrice);
+				ordInfo->setVolume(newVolume);
+				ordInfo->setVolLeft(newLeft);
+				ordInfo->setStateMsg("改单成功");
+				if (_listener)
+				{
+					StdUniqueLock lock(_mutex_api);
+					_listener->onPushOrder(ordInfo);
+				}
+			});
 		}
 
-		ordInfo->release();
 		action->release();
-
-		_awaits->remove(action->getOrderID());
-
-		save_positions();
 	});
 
 	return 0;
@@ -991,17 +1288,17 @@ void TraderMocker::extract_buffer(uint32_t length, bool isBroad /* = true */)
 		UDPTickPacket* packet = (UDPTickPacket*)header;
 		thread_local static char fullcode[64] = { 0 };
 		fmtutil::format_to(fullcode, "{}.{}", packet->_data.exchg, packet->_data.code);
-		auto it = _codes.find(fullcode);
-		if (it == _codes.end())
-			return;
 
-		WTSTickData* curTick = WTSTickData::create(packet->_data);
-		
-		if (_ticks == NULL)
-			_ticks = TickCache::create();
+		//缓存最新行情，新挂单到达的时候用来撮合
+		_last_ticks[fullcode] = packet->_data;
 
-		_ticks->add(fullcode, curTick, false);
+		auto it = _books.find(fullcode);
+		if (it == _books.end())
+			return;
 
-		_max_tick_time = max(_max_tick_time, (uint64_t)curTick->actiondate() * 1000000000 + curTick->actiontime());
+		//行情驱动撮合，只撮合这个合约的订单簿
+		OrderBook* book = it->second.get();
+		if (!book->_orders.empty())
+			match_book(book, packet->_data);
 	}
 }
\ No newline at end of file
@@ -1,24 +1,64 @@
 ﻿#pragma once
 #include <atomic>
+#include <deque>
+#include <random>
+#include <functional>
 
 #include <boost/asio.hpp>
 #include <boost/array.hpp>
 #include <boost/asio/io_service.hpp>
+#include <boost/asio/steady_timer.hpp>
 
 #include "../Includes/FasterDefs.h"
 #include "../Includes/ITraderApi.h"
 #include "../Share/StdUtils.hpp"
+#include "../Share/SpinMutex.hpp"
 #include "../Includes/WTSCollection.hpp"
 
 
 NS_WTP_BEGIN
-	class WTSTickData;
+	struct WTSTickStruct;
+	class WTSContractInfo;
+	class WTSOrderInfo;
 NS_WTP_END
 
 USING_NS_WTP;
 
+/*
+ *	延迟分布，单位微秒
+ *	配置可以直接是一个数字，即固定延迟，也可以是一个对象
+ *	{"mode":"uniform","min":100,"max":300}
+ *	{"mode":"normal","mean":200,"stdev":50}
+ *	{"mode":"exponential","mean":200}
+ */
+class LatencyModel
+{
+public:
+	typedef enum tagLatencyMode
+	{
+		LM_Fixed,
+		LM_Uniform,
+		LM_Normal,
+		LM_Exponential
+	} LatencyMode;
+
+	LatencyModel() :_mode(LM_Fixed), _p1(0), _p2(0) {}
+
+	void	init(WTSVariant* cfg);
+	int64_t	sample(std::mt19937_64& rng) const;
+
+	inline bool is_zero() const { return _mode == LM_Fixed && _p1 <= 0; }
+
+private:
+	LatencyMode	_mode;
+	double		_p1;
+	double		_p2;
+};
+
 /*
  *	仿真交易器
+ *	每个合约一个订单簿，收到行情的时候只撮合对应合约的订单簿
+ *	回报按照配置的延迟分布，通过io线程上的定时器按顺序推送
  */
 class TraderMocker : public ITraderApi
 {
@@ -28,9 +68,60 @@ public:
 
 private:
 	/*
-	*	撮合 定时器
-	*/
-	int32_t		match_once();
+	 *	交易所端的挂单
+	 *	撮合只看这里的价格和剩余数量，WTSOrderInfo只在回报的时候更新
+	 *	这样有回报延迟的时候，推送出去的订单状态和成交也是一一对应的
+	 *	订单对象由_orders持有，这里不再引用计数
+	 */
+	typedef struct _BookOrder
+	{
+		WTSOrderInfo*	_order;
+		double			_price;
+		double			_volume;
+		double			_left;
+		bool			_is_buy;
+		bool			_closed;	//已经全部成交或者已经撤销
+	} BookOrder;
+	typedef std::shared_ptr<BookOrder> BookOrderPtr;
+
+	//单个合约的订单簿，按照到达顺序排列
+	typedef struct _OrderBook
+	{
+		WTSContractInfo*			_ct;
+		std::vector<BookOrderPtr>	_orders;
+	} OrderBook;
+	typedef std::shared_ptr<OrderBook> OrderBookPtr;
+
+	//延迟回报任务，参数为事件发生的时间，微秒
+	typedef std::function<void(int64_t)> DelayedTask;
+	typedef struct _DelayedItem
+	{
+		int64_t		_due;
+		DelayedTask	_task;
+	} DelayedItem;
+
+private:
+	/*
+	 *	用一笔行情撮合一个合约的订单簿
+	 */
+	uint32_t	match_book(OrderBook* book, const WTSTickStruct& curTick);
+
+	/*
+	 *	用一笔行情撮合一个挂单，有成交返回true
+	 */
+	bool		match_order(BookOrder* bOrder, WTSContractInfo* ct, const WTSTickStruct& curTick);
+
+	OrderBook*	get_book(WTSContractInfo* ct);
+
+	/*
+	 *	按照延迟分布安排回报
+	 *	回报通道是有序的，后发生的事件不会比先发生的事件先推送
+	 */
+	void		schedule(const LatencyModel& latency, DelayedTask task);
+	void		arm_timer();
+	void		on_timer(const boost::system::error_code& e);
+
+	std::vector<uint32_t>	split_volume(uint32_t vol);
 
 	uint32_t	makeTradeID();
 	uint32_t	makeOrderID();
@@ -38,10 +129,22 @@ private:
 	void		load_positions();
 	void		save_positions();
 
+	inline int64_t	now_us() const
+	{
+		return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+
+	//把单调时钟换算成本地时间戳，毫秒
+	inline uint64_t	to_local_time(int64_t us) const
+	{
+		return (uint64_t)(_anchor_ms + (us - _anchor_us) / 1000);
+	}
+
 
 private:
-	StdThreadPtr	_thrd_match;
 	bool			_terminated;
+	bool			_poll_mode;		//轮询模式，不启动io线程，由poll驱动
+	bool			_logined;
 
 	StdUniqueMutex		_mutex_api;
 
@@ -54,25 +157,32 @@ private:
 
 	StdThreadPtr		_thrd_worker;
 
-	uint32_t		_millisecs;
 	uint32_t		_mocker_id;
+	uint32_t		_cur_date;
 	bool			_use_newpx;
 	double			_max_qty;
 	double			_min_qty;
 
 	WTSArray*		_orders;
 	WTSArray*		_trades;
-	typedef WTSHashMap<std::string> TickCache;
-	TickCache*		_ticks;
 
-	typedef WTSHashMap<std::string> OrderCache;
-	OrderCache*			_awaits;
-	StdUniqueMutex	_mtx_awaits;
+	wt_hashmap<std::string, OrderBookPtr>	_books;
+	wt_hashmap<std::string, BookOrderPtr>	_awaits;	//未完成的挂单，按订单号索引
+	wt_hashmap<std::string, WTSTickStruct>	_last_ticks;	//各合约的最新行情，新挂单进入订单簿的时候先撮合一次
 
-	wt_hashset<std::string>	_codes;
+	WTSArray*		_staged;	//预置的下单模板，合约信息已经解析好
 
-	uint64_t		_max_tick_time;
-	uint64_t		_last_match_time;
+	LatencyModel	_ack_latency;	//下单、撤单、改单的回报延迟
+	LatencyModel	_fill_latency;	//成交回报延迟
+	std::mt19937_64	_rng;
+
+	std::deque<DelayedItem>	_delayed;
+	int64_t			_last_due;
+	bool			_timer_armed;
+	boost::asio::steady_timer*	_timer;
+
+	int64_t			_anchor_us;
+	int64_t			_anchor_ms;
 
 	typedef struct _PosUnit
 	{
@@ -94,8 +204,16 @@ private:
 		}
 	} PosItem;
 
+	/*
+	 *	持仓在io线程里修改，落盘线程定时把有变化的持仓写到文件
+	 *	修改和落盘线程拷贝快照的时候要加锁
+	 */
 	wt_hashmap<std::string, PosItem> _positions;
 	std::string		_pos_file;
+	SpinMutex		_mtx_pos;
+	std::atomic<bool>	_pos_dirty;
+	uint32_t		_persist_span;	//落盘间隔，毫秒
+	StdThreadPtr	_thrd_persist;
 
 private:
 	int			_udp_port;
@@ -128,6 +246,10 @@ public:
 
 	virtual bool isConnected() override;
 
+	virtual bool enablePolling() override;
+
+	virtual uint32_t poll() override;
+
 	virtual bool makeEntrustID(char* buffer, int length) override;
 
 	virtual int login(const char* user, const char* pass, const char* productInfo) override;
@@ -136,8 +258,16 @@ public:
 
 	virtual int orderInsert(WTSEntrust* eutrust) override;
 
+	virtual uint32_t stageOrder(WTSEntrust* entrust) override;
+
+	virtual int orderInsertStaged(uint32_t stageid, double price, double qty, const char* userTag) override;
+
 	virtual int orderAction(WTSEntrustAction* action) override;
 
+	virtual bool isModifySupported() override { return true; }
+
+	virtual int orderModify(WTSEntrustAction* action) override;
+
 	virtual int queryAccount() override;
 
 	virtual int queryPositions() override;
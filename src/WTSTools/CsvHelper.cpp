@@ -1,12 +1,441 @@
 #include "CsvHelper.h"
 
 #include <limits.h>
+#include <thread>
 
 #include "../Share/StdUtils.hpp"
 #include "../Share/StrUtil.hpp"
+#include "../Share/TimeUtils.hpp"
+#include "../Share/BoostMappingFile.hpp"
+#include "../Includes/WTSStruct.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define CSV_USE_SSE2
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+namespace
+{
+	//单个线程至少处理的字节数，低于这个量级多线程的开销比收益大
+	const size_t MIN_BYTES_PER_THREAD = 4 * 1024 * 1024;
+
+	const double POW10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+	};
+
+#ifdef CSV_USE_SSE2
+	inline uint32_t first_bit(uint32_t mask)
+	{
+#ifdef _MSC_VER
+		unsigned long idx;
+		_BitScanForward(&idx, mask);
+		return idx;
+#else
+		return __builtin_ctz(mask);
+#endif
+	}
+#endif
+
+	/*
+	 *	查找第一个分隔符或者换行符
+	 *	每次比较16个字节，没有命中的时候一条指令就跳过16个字节
+	 */
+	inline const char* find_token(const char* p, const char* end, char splitter)
+	{
+#ifdef CSV_USE_SSE2
+		const __m128i vSplit = _mm_set1_epi8(splitter);
+		const __m128i vLF = _mm_set1_epi8('\n');
+		while (p + 16 <= end)
+		{
+			__m128i chunk = _mm_loadu_si128((const __m128i*)p);
+			__m128i hit = _mm_or_si128(_mm_cmpeq_epi8(chunk, vSplit), _mm_cmpeq_epi8(chunk, vLF));
+			uint32_t mask = (uint32_t)_mm_movemask_epi8(hit);
+			if (mask != 0)
+				return p + first_bit(mask);
+
+			p += 16;
+		}
+#endif
+		while (p < end && *p != splitter && *p != '\n')
+			p++;
+
+		return p;
+	}
+
+	inline const char* find_line_end(const char* p, const char* end)
+	{
+		const char* ret = (const char*)memchr(p, '\n', end - p);
+		return ret == NULL ? end : ret;
+	}
+
+	inline const char* skip_blank(const char* p, const char* end)
+	{
+		while (p < end && (*p == ' ' || *p == '\t' || *p == '"' || *p == '\''))
+			p++;
+
+		return p;
+	}
+
+	template<typename T>
+	inline T parse_uint(const char* p, const char* end)
+	{
+		T ret = 0;
+		for (; p < end; p++)
+		{
+			uint32_t d = (uint32_t)(*p - '0');
+			if (d > 9)
+				break;
+
+			ret = ret * 10 + d;
+		}
+		return ret;
+	}
+
+	template<typename T>
+	inline T parse_int(const char* p, const char* end)
+	{
+		p = skip_blank(p, end);
+		bool bNeg = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			bNeg = (*p == '-');
+			p++;
+		}
+
+		typedef typename std::make_unsigned<T>::type UT;
+		UT ret = parse_uint<UT>(p, end);
+		return bNeg ? (T)(0 - ret) : (T)ret;
+	}
+
+	inline double parse_double_slow(const char* p, const char* end)
+	{
+		char buf[64];
+		size_t len = std::min((size_t)(end - p), sizeof(buf) - 1);
+		memcpy(buf, p, len);
+		buf[len] = '\0';
+		return strtod(buf, NULL);
+	}
+
+	/*
+	 *	快速解析浮点数
+	 *	有效数字不超过15位并且小数位数不超过22位的时候（行情数据基本都满足），尾数和10的幂次都能精确表示，
+	 *	一次乘除得到的就是正确舍入的结果，其他情况交给strtod处理
+	 */
+	inline double parse_double(const char* p, const char* end)
+	{
+		p = skip_blank(p, end);
+		const char* s = p;
+		bool bNeg = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			bNeg = (*p == '-');
+			p++;
+		}
+
+		uint64_t mant = 0;
+		int32_t digits = 0;
+		int32_t exp10 = 0;
+		for (; p < end; p++)
+		{
+			uint32_t d = (uint32_t)(*p - '0');
+			if (d > 9)
+				break;
+
+			mant = mant * 10 + d;
+			if (mant != 0)
+				digits++;
+		}
+
+		if (p < end && *p == '.')
+		{
+			p++;
+			for (; p < end; p++)
+			{
+				uint32_t d = (uint32_t)(*p - '0');
+				if (d > 9)
+					break;
+
+				mant = mant * 10 + d;
+				if (mant != 0)
+					digits++;
+				exp10--;
+			}
+		}
+
+		if (p < end && (*p == 'e' || *p == 'E' || *p == 'n' || *p == 'N' || *p == 'i' || *p == 'I'))
+			return parse_double_slow(s, end);
+
+		if (digits > 15 || exp10 < -22)
+			return parse_double_slow(s, end);
+
+		double ret = (double)mant;
+		if (exp10 < 0)
+			ret /= POW10[-exp10];
+
+		return bNeg ? -ret : ret;
+	}
+
+	inline uint32_t parse_date(const char* p, const char* end)
+	{
+		p = skip_blank(p, end);
+		uint32_t parts[3] = { 0 };
+		uint32_t idx = 0;
+		for (; p < end; p++)
+		{
+			char c = *p;
+			if (c >= '0' && c <= '9')
+				parts[idx] = parts[idx] * 10 + (c - '0');
+			else if ((c == '/' || c == '-') && idx < 2)
+				idx++;
+			else
+				break;
+		}
+
+		if (idx == 0)
+			return parts[0];
+
+		return parts[0] * 10000 + parts[1] * 100 + parts[2];
+	}
+
+	//将hh:mm:ss.fff的各个部分读出来，返回整数部分的位数
+	inline uint32_t parse_time_parts(const char* p, const char* end, uint32_t& value, uint32_t& millisec, bool& bHasMs)
+	{
+		p = skip_blank(p, end);
+		value = 0;
+		millisec = 0;
+		bHasMs = false;
+		uint32_t digits = 0;
+		for (; p < end; p++)
+		{
+			char c = *p;
+			if (c >= '0' && c <= '9')
+			{
+				value = value * 10 + (c - '0');
+				digits++;
+			}
+			else if (c != ':')
+				break;
+		}
+
+		if (p < end && *p == '.')
+		{
+			bHasMs = true;
+			p++;
+			uint32_t cnt = 0;
+			for (; p < end && cnt < 3; p++, cnt++)
+			{
+				uint32_t d = (uint32_t)(*p - '0');
+				if (d > 9)
+					break;
+				millisec = millisec * 10 + d;
+			}
+			for (; cnt < 3; cnt++)
+				millisec *= 10;
+		}
+
+		return digits;
+	}
+
+	typedef struct _BarSchema
+	{
+		int32_t	_date, _time, _open, _high, _low, _close;
+		int32_t	_vol, _money, _hold, _add, _settle;
+
+		void init(const CsvReader& reader)
+		{
+			_date = reader.get_col_by_filed("date");
+			_time = reader.get_col_by_filed("time");
+			_open = reader.get_col_by_filed("open");
+			_high = reader.get_col_by_filed("high");
+			_low = reader.get_col_by_filed("low");
+			_close = reader.get_col_by_filed("close");
+			_vol = reader.get_col_by_filed("volume");
+			_money = reader.get_col_by_filed("turnover");
+			_hold = reader.get_col_by_filed("open_interest");
+			_add = reader.get_col_by_filed("diff_interest");
+			_settle = reader.get_col_by_filed("settle");
+		}
+
+		void read(CsvReader& reader, WTSBarStruct& bs, bool isDay) const
+		{
+			bs.date = reader.get_date(_date);
+			if (!isDay)
+				bs.time = TimeUtils::timeToMinBar(bs.date, reader.get_time(_time));
+			bs.open = reader.get_double(_open);
+			bs.high = reader.get_double(_high);
+			bs.low = reader.get_double(_low);
+			bs.close = reader.get_double(_close);
+			bs.vol = reader.get_double(_vol);
+			bs.money = reader.get_double(_money);
+			bs.hold = reader.get_double(_hold);
+			bs.add = reader.get_double(_add);
+			bs.settle = reader.get_double(_settle);
+		}
+	} BarSchema;
+
+	typedef struct _TickSchema
+	{
+		int32_t	_exchg, _code;
+		int32_t	_tdate, _adate, _atime;
+		int32_t	_price, _open, _high, _low, _settle;
+		int32_t	_volume, _total_volume, _turnover, _total_turnover;
+		int32_t	_open_interest, _diff_interest;
+		int32_t	_pre_close, _pre_settle, _pre_interest;
+		int32_t	_upper_limit, _lower_limit;
+		int32_t	_bid_prices[10], _ask_prices[10], _bid_qty[10], _ask_qty[10];
+
+		void init(const CsvReader& reader)
+		{
+			_exchg = reader.get_col_by_filed("exchg");
+			_code = reader.get_col_by_filed("code");
+			_tdate = reader.get_col_by_filed("trading_date");
+			_adate = reader.get_col_by_filed("action_date");
+			if (_adate == INT_MAX)
+				_adate = reader.get_col_by_filed("date");
+			_atime = reader.get_col_by_filed("action_time");
+			if (_atime == INT_MAX)
+				_atime = reader.get_col_by_filed("time");
+			_price = reader.get_col_by_filed("price");
+			_open = reader.get_col_by_filed("open");
+			_high = reader.get_col_by_filed("high");
+			_low = reader.get_col_by_filed("low");
+			_settle = reader.get_col_by_filed("settle_price");
+			_volume = reader.get_col_by_filed("volume");
+			_total_volume = reader.get_col_by_filed("total_volume");
+			_turnover = reader.get_col_by_filed("turnover");
+			_total_turnover = reader.get_col_by_filed("total_turnover");
+			_open_interest = reader.get_col_by_filed("open_interest");
+			_diff_interest = reader.get_col_by_filed("diff_interest");
+			_pre_close = reader.get_col_by_filed("pre_close");
+			_pre_settle = reader.get_col_by_filed("pre_settle");
+			_pre_interest = reader.get_col_by_filed("pre_interest");
+			_upper_limit = reader.get_col_by_filed("upper_limit");
+			_lower_limit = reader.get_col_by_filed("lower_limit");
+
+			char key[32];
+			for (uint32_t i = 0; i < 10; i++)
+			{
+				sprintf(key, "bid_price_%u", i);
+				_bid_prices[i] = reader.get_col_by_filed(key);
+				sprintf(key, "ask_price_%u", i);
+				_ask_prices[i] = reader.get_col_by_filed(key);
+				sprintf(key, "bid_qty_%u", i);
+				_bid_qty[i] = reader.get_col_by_filed(key);
+				sprintf(key, "ask_qty_%u", i);
+				_ask_qty[i] = reader.get_col_by_filed(key);
+			}
+		}
+
+		void read(CsvReader& reader, WTSTickStruct& ts) const
+		{
+			if (_exchg != INT_MAX)
+				wt_strcpy(ts.exchg, reader.get_string(_exchg));
+			if (_code != INT_MAX)
+				wt_strcpy(ts.code, reader.get_string(_code));
+
+			ts.action_date = reader.get_date(_adate);
+			ts.trading_date = (_tdate == INT_MAX) ? ts.action_date : reader.get_date(_tdate);
+
+			ts.action_time = reader.get_millitime(_atime);
+
+			ts.price = reader.get_double(_price);
+			ts.open = reader.get_double(_open);
+			ts.high = reader.get_double(_high);
+			ts.low = reader.get_double(_low);
+			ts.settle_price = reader.get_double(_settle);
+			ts.volume = reader.get_double(_volume);
+			ts.total_volume = reader.get_double(_total_volume);
+			ts.turn_over = reader.get_double(_turnover);
+			ts.total_turnover = reader.get_double(_total_turnover);
+			ts.open_interest = reader.get_double(_open_interest);
+			ts.diff_interest = reader.get_double(_diff_interest);
+			ts.pre_close = reader.get_double(_pre_close);
+			ts.pre_settle = reader.get_double(_pre_settle);
+			ts.pre_interest = reader.get_double(_pre_interest);
+			ts.upper_limit = reader.get_double(_upper_limit);
+			ts.lower_limit = reader.get_double(_lower_limit);
+
+			for (uint32_t i = 0; i < 10; i++)
+			{
+				ts.bid_prices[i] = reader.get_double(_bid_prices[i]);
+				ts.ask_prices[i] = reader.get_double(_ask_prices[i]);
+				ts.bid_qty[i] = reader.get_double(_bid_qty[i]);
+				ts.ask_qty[i] = reader.get_double(_ask_qty[i]);
+			}
+		}
+	} TickSchema;
+
+	/*
+	 *	通用的并行加载流程
+	 *	先按行边界切分，每个线程写自己的数组，最后按顺序拼接，保证结果和单线程读取完全一致
+	 */
+	template<typename T, typename Fn>
+	uint32_t parallel_load(CsvReader& reader, std::vector<T>& items, uint32_t threads, Fn fn)
+	{
+		if (threads == 0)
+			threads = std::max(1U, std::thread::hardware_concurrency());
+
+		threads = (uint32_t)std::min((size_t)threads, std::max((size_t)1, reader.data_size() / MIN_BYTES_PER_THREAD));
+
+		std::vector<CsvReader> readers;
+		reader.split(threads, readers);
+
+		std::vector<std::vector<T>> parts(readers.size());
+		auto proc = [&](std::size_t idx) {
+			CsvReader& r = readers[idx];
+			std::vector<T>& ay = parts[idx];
+			//按每行100字节估算，避免反复扩容
+			ay.reserve(r.data_size() / 100 + 1);
+			while (r.next_row())
+			{
+				ay.emplace_back();
+				fn(r, ay.back());
+			}
+		};
+
+		if (readers.size() == 1)
+		{
+			proc(0);
+		}
+		else
+		{
+			std::vector<std::thread> workers;
+			for (std::size_t i = 0; i < readers.size(); i++)
+				workers.emplace_back(proc, i);
+
+			for (auto& t : workers)
+				t.join();
+		}
+
+		std::size_t total = 0;
+		for (auto& ay : parts)
+			total += ay.size();
+
+		if (parts.size() == 1)
+		{
+			items.swap(parts[0]);
+		}
+		else
+		{
+			items.clear();
+			items.reserve(total);
+			for (auto& ay : parts)
+				items.insert(items.end(), ay.begin(), ay.end());
+		}
+
+		return (uint32_t)total;
+	}
+}
 
 CsvReader::CsvReader(const char* item_splitter /* = "," */)
-	: _item_splitter(item_splitter)
+	: _data(NULL)
+	, _pos(0)
+	, _end(0)
+	, _item_splitter(item_splitter[0])
 {
 
 }
@@ -16,16 +445,34 @@ bool CsvReader::load_from_file(const char* filename)
 	if (!StdFile::exists(filename))
 		return false;
 
-	_ifs.open(filename);
+	_data = NULL;
+	_pos = _end = 0;
+	_fields_map.clear();
+	_current_cells.clear();
+
+	//空文件不能映射，直接当成没有数据处理
+	if (boost::filesystem::file_size(filename) == 0)
+		return true;
+
+	_mapping.reset(new BoostMappingFile);
+	if (!_mapping->map(filename, boost::interprocess::read_only, boost::interprocess::read_only))
+	{
+		_mapping.reset();
+		return false;
+	}
+
+	_data = (const char*)_mapping->addr();
+	_end = _mapping->size();
 
-	_ifs.getline(_buffer, 1024);
 	//判断是不是UTF-8BOM 编码
 	static char flag[] = { (char)0xEF, (char)0xBB, (char)0xBF };
-	char* buf = _buffer;
-	if (memcmp(_buffer, flag, sizeof(char) * 3) == 0)
-		buf += 3;
+	if (_end >= 3 && memcmp(_data, flag, sizeof(char) * 3) == 0)
+		_pos = 3;
 
-	std::string row = buf;
+	const char* head = _data + _pos;
+	const char* lineEnd = find_line_end(head, _data + _end);
+	std::string row(head, lineEnd - head);
+	_pos = (lineEnd == _data + _end) ? _end : (lineEnd - _data + 1);
 
 	//替换掉一些字段的特殊符号
 	StrUtil::replace(row, "<", "");
@@ -36,7 +483,8 @@ bool CsvReader::load_from_file(const char* filename)
 	//将字段名转成小写
 	StrUtil::toLowerCase(row);
 
-	StringVector fields = StrUtil::split(row, _item_splitter.c_str());
+	char splitter[2] = { _item_splitter, '\0' };
+	StringVector fields = StrUtil::split(row, splitter);
 	for (uint32_t i = 0; i < fields.size(); i++)
 	{
 		StrUtil::trim(fields[i], " ");
@@ -49,36 +497,85 @@ bool CsvReader::load_from_file(const char* filename)
 		_fields_map[fields[i]] = i;
 	}
 
+	_current_cells.reserve(fields.size());
 	return true;
 }
 
-bool CsvReader::next_row()
+bool CsvReader::split(uint32_t parts, std::vector<CsvReader>& readers) const
 {
-	if (_ifs.eof())
-		return false;
+	readers.clear();
+	if (parts <= 1 || data_size() == 0)
+	{
+		readers.emplace_back(*this);
+		return true;
+	}
 
-	while (!_ifs.eof())
+	size_t step = data_size() / parts;
+	size_t start = _pos;
+	for (uint32_t i = 0; i < parts && start < _end; i++)
 	{
-		_ifs.getline(_buffer, 1024);
-		if(strlen(_buffer) == 0)
-			continue;
-		else
-			break;
-	} 
-	
-	if (strlen(_buffer) == 0)
-		return false;
-	_current_cells.clear();
-	StrUtil::split(_buffer, _current_cells, _item_splitter.c_str());
+		size_t stop = _end;
+		if (i != parts - 1)
+		{
+			stop = std::max(start, _pos + step * (i + 1));
+			//把切分点挪到下一个换行符之后，保证每一段都是完整的行
+			const char* lineEnd = find_line_end(_data + stop, _data + _end);
+			stop = (lineEnd == _data + _end) ? _end : (lineEnd - _data + 1);
+		}
+
+		readers.emplace_back(*this);
+		CsvReader& reader = readers.back();
+		reader._pos = start;
+		reader._end = stop;
+		reader._current_cells.clear();
+
+		start = stop;
+	}
+
 	return true;
 }
 
+bool CsvReader::next_row()
+{
+	const char* end = _data + _end;
+	while (_pos < _end)
+	{
+		const char* p = _data + _pos;
+		const char* lineEnd = find_line_end(p, end);
+		_pos = (lineEnd == end) ? _end : (lineEnd - _data + 1);
+
+		//去掉windows换行的\r
+		const char* rowEnd = lineEnd;
+		if (rowEnd > p && rowEnd[-1] == '\r')
+			rowEnd--;
+
+		if (rowEnd == p)
+			continue;
+
+		_current_cells.clear();
+		for (;;)
+		{
+			const char* q = find_token(p, rowEnd, _item_splitter);
+			_current_cells.push_back({ p, (uint32_t)(q - p) });
+			if (q >= rowEnd)
+				break;
+
+			p = q + 1;
+		}
+
+		return true;
+	}
+
+	return false;
+}
+
 int32_t CsvReader::get_int32(int32_t col)
 {
 	if (!check_cell(col))
 		return 0;
 
-	return strtol(_current_cells[col].c_str(), NULL, 10);
+	const Cell& cell = _current_cells[col];
+	return parse_int<int32_t>(cell._ptr, cell._ptr + cell._len);
 }
 
 uint32_t CsvReader::get_uint32(int32_t col)
@@ -86,7 +583,8 @@ uint32_t CsvReader::get_uint32(int32_t col)
 	if (!check_cell(col))
 		return 0;
 
-	return strtoul(_current_cells[col].c_str(), NULL, 10);
+	const Cell& cell = _current_cells[col];
+	return (uint32_t)parse_int<int64_t>(cell._ptr, cell._ptr + cell._len);
 }
 
 int64_t CsvReader::get_int64(int32_t col)
@@ -94,7 +592,8 @@ int64_t CsvReader::get_int64(int32_t col)
 	if (!check_cell(col))
 		return 0;
 
-	return strtoll(_current_cells[col].c_str(), NULL, 10);
+	const Cell& cell = _current_cells[col];
+	return parse_int<int64_t>(cell._ptr, cell._ptr + cell._len);
 }
 
 uint64_t CsvReader::get_uint64(int32_t col)
@@ -102,7 +601,9 @@ uint64_t CsvReader::get_uint64(int32_t col)
 	if (!check_cell(col))
 		return 0;
 
-	return strtoull(_current_cells[col].c_str(), NULL, 10);
+	const Cell& cell = _current_cells[col];
+	const char* p = skip_blank(cell._ptr, cell._ptr + cell._len);
+	return parse_uint<uint64_t>(p, cell._ptr + cell._len);
 }
 
 double CsvReader::get_double(int32_t col)
@@ -110,7 +611,8 @@ double CsvReader::get_double(int32_t col)
 	if (!check_cell(col))
 		return 0;
 
-	return strtod(_current_cells[col].c_str(), NULL);
+	const Cell& cell = _current_cells[col];
+	return parse_double(cell._ptr, cell._ptr + cell._len);
 }
 
 const char* CsvReader::get_string(int32_t col)
@@ -118,7 +620,55 @@ const char* CsvReader::get_string(int32_t col)
 	if (!check_cell(col))
 		return "";
 
-	return _current_cells[col].c_str();
+	//映射区是只读的，没法原地补'\0'，拷贝到复用的缓存里
+	const Cell& cell = _current_cells[col];
+	_str_buf.assign(cell._ptr, cell._len);
+	return _str_buf.c_str();
+}
+
+uint32_t CsvReader::get_date(int32_t col)
+{
+	if (!check_cell(col))
+		return 0;
+
+	const Cell& cell = _current_cells[col];
+	return parse_date(cell._ptr, cell._ptr + cell._len);
+}
+
+uint32_t CsvReader::get_time(int32_t col, bool bKeepSec /* = false */)
+{
+	if (!check_cell(col))
+		return 0;
+
+	const Cell& cell = _current_cells[col];
+	uint32_t value, millisec;
+	bool bHasMs;
+	uint32_t digits = parse_time_parts(cell._ptr, cell._ptr + cell._len, value, millisec, bHasMs);
+	if (digits > 4 && !bKeepSec)
+		value /= 100;
+
+	return value;
+}
+
+uint32_t CsvReader::get_millitime(int32_t col)
+{
+	if (!check_cell(col))
+		return 0;
+
+	const Cell& cell = _current_cells[col];
+	uint32_t value, millisec;
+	bool bHasMs;
+	uint32_t digits = parse_time_parts(cell._ptr, cell._ptr + cell._len, value, millisec, bHasMs);
+	if (bHasMs)
+		return value * 1000 + millisec;
+
+	//没有小数部分的时候，按位数判断是HHmm、HHmmss还是已经带了毫秒的HHmmssfff
+	if (digits <= 4)
+		return value * 100000;
+	else if (digits <= 6)
+		return value * 1000;
+
+	return value;
 }
 
 int32_t CsvReader::get_int32(const char* field)
@@ -157,22 +707,67 @@ const char* CsvReader::get_string(const char* field)
 	return get_string(col);
 }
 
+uint32_t CsvReader::get_date(const char* field)
+{
+	int32_t col = get_col_by_filed(field);
+	return get_date(col);
+}
+
+uint32_t CsvReader::get_time(const char* field, bool bKeepSec /* = false */)
+{
+	int32_t col = get_col_by_filed(field);
+	return get_time(col, bKeepSec);
+}
+
+uint32_t CsvReader::get_millitime(const char* field)
+{
+	int32_t col = get_col_by_filed(field);
+	return get_millitime(col);
+}
+
 bool CsvReader::check_cell(int32_t col)
 {
 	if (col == INT_MAX )
 		return false;
 
-	if (col < 0 || col >= (int32_t)_fields_map.size())
+	if (col < 0 || col >= (int32_t)_fields_map.size() || col >= (int32_t)_current_cells.size())
 		return false;
 
 	return true;
 }
 
-int32_t CsvReader::get_col_by_filed(const char* field)
+int32_t CsvReader::get_col_by_filed(const char* field) const
 {
 	auto it = _fields_map.find(field);
 	if (it == _fields_map.end())
 		return INT_MAX;
 
 	return it->second;
-}
\ No newline at end of file
+}
+
+
+uint32_t CsvLoader::load_bars(const char* filename, std::vector<WTSBarStruct>& bars, bool isDay, uint32_t threads /* = 0 */)
+{
+	CsvReader reader;
+	if (!reader.load_from_file(filename))
+		return 0;
+
+	BarSchema schema;
+	schema.init(reader);
+	return parallel_load(reader, bars, threads, [&schema, isDay](CsvReader& r, WTSBarStruct& bs) {
+		schema.read(r, bs, isDay);
+	});
+}
+
+uint32_t CsvLoader::load_ticks(const char* filename, std::vector<WTSTickStruct>& ticks, uint32_t threads /* = 0 */)
+{
+	CsvReader reader;
+	if (!reader.load_from_file(filename))
+		return 0;
+
+	TickSchema schema;
+	schema.init(reader);
+	return parallel_load(reader, ticks, threads, [&schema](CsvReader& r, WTSTickStruct& ts) {
+		schema.read(r, ts);
+	});
+}
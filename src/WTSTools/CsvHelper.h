@@ -3,10 +3,28 @@
 #include <string>
 #include <unordered_map>
 #include <stdint.h>
-#include <fstream>
 #include <vector>
+#include <memory>
 #include <sstream>
 
+#include "../Includes/WTSMarcos.h"
+
+NS_WTP_BEGIN
+struct WTSBarStruct;
+struct WTSTickStruct;
+NS_WTP_END
+
+USING_NS_WTP;
+
+class BoostMappingFile;
+
+/*
+ *	CsvReader采用内存映射文件+按行原地分词的实现
+ *	1、文件通过mmap映射进来，不再用getline逐行拷贝，也没有1024字节的行长限制
+ *	2、分词直接记录单元格在映射区中的起止位置，不再生成std::string
+ *	3、数值和日期时间直接从映射区解析，不做任何内存分配
+ *	4、支持按行边界把文件切分成多段，交给多个线程并行解析
+ */
 class CsvReader
 {
 public:
@@ -15,9 +33,20 @@ public:
 public:
 	bool	load_from_file(const char* filename);
 
+	/*
+	 *	按行边界将数据区切分成若干段
+	 *	每一段都是一个独立的CsvReader，共享同一个映射文件和表头，可以在不同线程中分别调用next_row
+	 *	@parts		期望切分的段数，实际段数可能因为文件过小而更少
+	 *	@readers	切分后的读取器
+	 */
+	bool	split(uint32_t parts, std::vector<CsvReader>& readers) const;
+
 public:
 	inline uint32_t	col_count() { return (uint32_t)_fields_map.size(); }
 
+	//数据区的字节数（不含表头）
+	inline size_t	data_size() const { return _end - _pos; }
+
 	int32_t		get_int32(int32_t col);
 	uint32_t	get_uint32(int32_t col);
 
@@ -26,8 +55,30 @@ public:
 
 	double		get_double(int32_t col);
 
+	/*
+	 *	返回的字符串存放在读取器内部的缓存里，下一次调用get_string以后就失效了
+	 *	需要保留的，调用方自己拷贝
+	 */
 	const char*	get_string(int32_t col);
 
+	/*
+	 *	解析日期，支持20230612、2023/6/12、2023-06-12以及带时间的2023/6/12 09:30:00
+	 *	返回值格式为yyyyMMdd
+	 */
+	uint32_t	get_date(int32_t col);
+
+	/*
+	 *	解析时间，支持0930、09:30、09:30:00等格式
+	 *	bKeepSec为false时返回HHmm，否则返回HHmmss
+	 */
+	uint32_t	get_time(int32_t col, bool bKeepSec = false);
+
+	/*
+	 *	解析带毫秒的时间，支持09:30:00.500、093000500、09:30:00等格式
+	 *	返回值格式为HHmmssfff，和WTSTickStruct::action_time一致
+	 */
+	uint32_t	get_millitime(int32_t col);
+
 	int32_t		get_int32(const char* field);
 	uint32_t	get_uint32(const char* field);
 
@@ -38,10 +89,20 @@ public:
 
 	const char*	get_string(const char* field);
 
+	uint32_t	get_date(const char* field);
+	uint32_t	get_time(const char* field, bool bKeepSec = false);
+	uint32_t	get_millitime(const char* field);
+
 	bool		next_row();
 
-	const char* fields() const 
-	{ 
+	/*
+	 *	根据字段名获取列号，字段不存在返回INT_MAX
+	 *	批量读取的时候，先把列号确定下来，再按列号读取，可以省掉每行的字段查找
+	 */
+	int32_t		get_col_by_filed(const char* field) const;
+
+	const char* fields() const
+	{
 		static std::string s;
 		if(s.empty())
 		{
@@ -58,13 +119,50 @@ public:
 
 private:
 	bool		check_cell(int32_t col);
-	int32_t		get_col_by_filed(const char* field);
 
 private:
-	std::ifstream	_ifs;
-	char			_buffer[1024];
-	std::string		_item_splitter;
+	typedef struct _Cell
+	{
+		const char*	_ptr;
+		uint32_t	_len;
+	} Cell;
+
+	typedef std::shared_ptr<BoostMappingFile> MappingPtr;
+	MappingPtr		_mapping;
+	const char*		_data;
+	size_t			_pos;
+	size_t			_end;
+
+	char			_item_splitter;
 
 	std::unordered_map<std::string, int32_t> _fields_map;
-	std::vector<std::string> _current_cells;
+	std::vector<Cell>	_current_cells;
+	std::string			_str_buf;
+};
+
+/*
+ *	CSV历史数据批量加载器
+ *	表头只解析一次，确定每个字段的列号以后，直接把每一行写入WTSBarStruct/WTSTickStruct数组
+ *	文件较大时按行边界切分，多线程并行解析，最后按原始顺序拼接
+ */
+class CsvLoader
+{
+public:
+	/*
+	 *	加载K线数据
+	 *	字段：date,time,open,high,low,close,volume,turnover,open_interest,diff_interest,settle
+	 *	@isDay		是否是日线，日线不读取time字段
+	 *	@threads	解析线程数，0为自动，文件较小时会退化为单线程
+	 *	return		读取的条数
+	 */
+	static uint32_t load_bars(const char* filename, std::vector<WTSBarStruct>& bars, bool isDay, uint32_t threads = 0);
+
+	/*
+	 *	加载tick数据
+	 *	字段：trading_date,action_date,action_time,price,open,high,low,volume,total_volume,turnover,
+	 *	total_turnover,open_interest,diff_interest,pre_close,pre_settle,pre_interest,upper_limit,lower_limit,
+	 *	bid_price_0~9,ask_price_0~9,bid_qty_0~9,ask_qty_0~9
+	 *	不存在的字段保持为0，action_time支持09:30:00.500和093000500两种格式
+	 */
+	static uint32_t load_ticks(const char* filename, std::vector<WTSTickStruct>& ticks, uint32_t threads = 0);
 };
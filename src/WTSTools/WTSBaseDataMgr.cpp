@@ -21,7 +21,9 @@
 const char* DEFAULT_HOLIDAY_TPL = "CHINA";
 
 WTSBaseDataMgr::WTSBaseDataMgr()
-	: m_mapExchgContract(NULL)
+	: m_uCalBegin(19900101)
+	, m_uCalEnd(20501231)
+	, m_mapExchgContract(NULL)
 	, m_mapSessions(NULL)
 	, m_mapCommodities(NULL)
 	, m_mapContracts(NULL)
@@ -240,15 +242,16 @@ WTSSessionInfo* WTSBaseDataMgr::getSessionByCode(const char* code, const char* e
 
 bool WTSBaseDataMgr::isHoliday(const char* pid, uint32_t uDate, bool isTpl /* = false */)
 {
-	uint32_t wd = TimeUtils::getWeekDay(uDate);
+	const TradingCalendar* cal = getCalendar(pid, isTpl);
+	if (cal != NULL && cal->in_range(uDate))
+		return !cal->is_trading_date(uDate);
+
+	uint32_t wd = TradingCalendar::weekday(uDate);
 	if (wd == 0 || wd == 6)
 		return true;
 
-	std::string tplid = pid;
-	if (!isTpl)
-		tplid = getTplIDByPID(pid);
-
-	auto it = m_mapTradingDay.find(tplid.c_str());
+	const char* tplid = isTpl ? pid : getTplIDByPID(pid);
+	auto it = m_mapTradingDay.find(tplid);
 	if(it != m_mapTradingDay.end())
 	{
 		const TradingDayTpl& tpl = it->second;
@@ -527,6 +530,12 @@ bool WTSBaseDataMgr::loadContracts(const char* filename)
 				sMargin = jcInfo->getDouble("shortmarginratio");
 			cInfo->setMarginRatios(lMargin, sMargin);
 
+			WTSVariant* jOption = jcInfo->get("option");
+			if (jOption != NULL)
+			{
+				cInfo->setOptionInfo((OptionType)jOption->getUInt32("optiontype"), jOption->getCString("underlying"), jOption->getDouble("strikeprice"));
+			}
+
 			WTSContractList* contractList = (WTSContractList*)m_mapExchgContract->get(std::string(cInfo->getExchg()));
 			if (contractList == NULL)
 			{
@@ -585,22 +594,62 @@ bool WTSBaseDataMgr::loadHolidays(const char* filename)
 
 	root->release();
 
+	buildCalendars();
+
 	return true;
 }
 
+void WTSBaseDataMgr::setCalendarRange(uint32_t uBeginDate, uint32_t uEndDate)
+{
+	if (uBeginDate == 0 || uEndDate < uBeginDate)
+	{
+		WTSLogger::error("Invalid trading calendar range {}-{}, ignored", uBeginDate, uEndDate);
+		return;
+	}
+
+	m_uCalBegin = uBeginDate;
+	m_uCalEnd = uEndDate;
+
+	if (!m_mapTradingDay.empty())
+		buildCalendars();
+}
+
+void WTSBaseDataMgr::buildCalendars()
+{
+	m_mapCalendars.clear();
+	for (auto& v : m_mapTradingDay)
+	{
+		TradingCalendar& cal = m_mapCalendars[v.first];
+		cal.build(m_uCalBegin, m_uCalEnd, v.second._holidays);
+	}
+
+	WTSLogger::info("Trading calendars of {} templates built, range {}-{}", m_mapCalendars.size(), m_uCalBegin, m_uCalEnd);
+}
+
+const TradingCalendar* WTSBaseDataMgr::getCalendar(const char* pid, bool isTpl)
+{
+	if (m_mapCalendars.empty())
+		return NULL;
+
+	const char* tplid = isTpl ? pid : getTplIDByPID(pid);
+	auto it = m_mapCalendars.find(tplid);
+	if (it == m_mapCalendars.end() || it->second.is_empty())
+		return NULL;
+
+	return &it->second;
+}
+
 uint64_t WTSBaseDataMgr::getBoundaryTime(const char* stdPID, uint32_t tDate, bool isSession /* = false */, bool isStart /* = true */)
 {
 	if(tDate == 0)
 		tDate = TimeUtils::getCurDate();
 	
-	std::string tplid = stdPID;
-	bool isTpl = false;
+	//直接用品种的节假日模板，避免后面每次都要解析品种代码
+	const char* tplid = DEFAULT_HOLIDAY_TPL;
 	WTSSessionInfo* sInfo = NULL;
 	if (isSession)
 	{
 		sInfo = getSession(stdPID);
-		tplid = DEFAULT_HOLIDAY_TPL;
-		isTpl = true;
 	}
 	else
 	{
@@ -609,18 +658,19 @@ uint64_t WTSBaseDataMgr::getBoundaryTime(const char* stdPID, uint32_t tDate, boo
 			return 0;
 
 		sInfo = cInfo->getSessionInfo();
+		tplid = cInfo->getTradingTpl();
 	}
 
 	if (sInfo == NULL)
 		return 0;
 
-	uint32_t weekday = TimeUtils::getWeekDay(tDate);
+	uint32_t weekday = TradingCalendar::weekday(tDate);
 	if (weekday == 6 || weekday == 0)
 	{
 		if (isStart)
-			tDate = getNextTDate(tplid.c_str(), tDate, 1, isTpl);
+			tDate = getNextTDate(tplid, tDate, 1, true);
 		else
-			tDate = getPrevTDate(tplid.c_str(), tDate, 1, isTpl);
+			tDate = getPrevTDate(tplid, tDate, 1, true);
 	}
 
 	//不偏移的最简单,只需要直接返回开盘和收盘时间即可
@@ -651,7 +701,7 @@ uint64_t WTSBaseDataMgr::getBoundaryTime(const char* stdPID, uint32_t tDate, boo
 
 		//想到一个简单的办法,就是不管怎么样,开始时间一定是上一个交易日的晚上
 		//所以我只需要拿到上一个交易日即可
-		tDate = getPrevTDate(tplid.c_str(), tDate, 1, isTpl);
+		tDate = getPrevTDate(tplid, tDate, 1, true);
 		return (uint64_t)tDate * 10000 + sInfo->getOpenTime();
 	}
 }
@@ -664,14 +714,11 @@ uint32_t WTSBaseDataMgr::calcTradingDate(const char* stdPID, uint32_t uDate, uin
 		uTime /= 100000;
 	}
 
-	std::string tplid = stdPID;
-	bool isTpl = false;
+	const char* tplid = DEFAULT_HOLIDAY_TPL;
 	WTSSessionInfo* sInfo = NULL;
 	if(isSession)
 	{
 		sInfo = getSession(stdPID);
-		tplid = DEFAULT_HOLIDAY_TPL;
-		isTpl = true;
 	}
 	else
 	{
@@ -680,6 +727,7 @@ uint32_t WTSBaseDataMgr::calcTradingDate(const char* stdPID, uint32_t uDate, uin
 			return uDate;
 		
 		sInfo = cInfo->getSessionInfo();
+		tplid = cInfo->getTradingTpl();
 	}
 
 	if (sInfo == NULL)
@@ -702,7 +750,7 @@ uint32_t WTSBaseDataMgr::calcTradingDate(const char* stdPID, uint32_t uDate, uin
 		return uDate;
 	}
 
-	uint32_t weekday = TimeUtils::getWeekDay(uDate);
+	uint32_t weekday = TradingCalendar::weekday(uDate);
 	if (sInfo->getOffsetMins() > 0)
 	{
 		//如果向后偏移,且当前时间大于偏移时间,说明向后跨日了
@@ -710,12 +758,12 @@ uint32_t WTSBaseDataMgr::calcTradingDate(const char* stdPID, uint32_t uDate, uin
 		if (uTime > offMin)
 		{
 			//如,20151016 23:00,偏移300分钟,为5:00
-			return getNextTDate(tplid.c_str(), uDate, 1, isTpl);
+			return getNextTDate(tplid, uDate, 1, true);
 		}
 		else if (weekday == 6 || weekday == 0)
 		{
 			//如,20151017 1:00,周六,交易日为20151019
-			return getNextTDate(tplid.c_str(), uDate, 1, isTpl);
+			return getNextTDate(tplid, uDate, 1, true);
 		}
 	}
 	else if (sInfo->getOffsetMins() < 0)
@@ -725,18 +773,18 @@ uint32_t WTSBaseDataMgr::calcTradingDate(const char* stdPID, uint32_t uDate, uin
 		if (uTime < offMin)
 		{
 			//如20151017 1:00,偏移-300分钟,为20:00
-			return getPrevTDate(tplid.c_str(), uDate, 1, isTpl);
+			return getPrevTDate(tplid, uDate, 1, true);
 		}
 		else if (weekday == 6 || weekday == 0)
 		{
 			//因为向前偏移,如果在周末,则直接到下一个交易日
-			return getNextTDate(tplid.c_str(), uDate, 1, isTpl);
+			return getNextTDate(tplid, uDate, 1, true);
 		}
 	}
 	else if (weekday == 6 || weekday == 0)
 	{
 		//如果没有偏移,且在周末,则直接读取下一个交易日
-		return getNextTDate(tplid.c_str(), uDate, 1, isTpl);;
+		return getNextTDate(tplid, uDate, 1, true);;
 	}
 
 	//其他情况,交易日=自然日
@@ -761,7 +809,7 @@ uint32_t WTSBaseDataMgr::getTradingDate(const char* pid, uint32_t uOffDate /* =
 	if (uOffDate == 0)
 		uOffDate = curDate;
 
-	uint32_t weekday = TimeUtils::getWeekDay(uOffDate);
+	uint32_t weekday = TradingCalendar::weekday(uOffDate);
 
 	if (weekday == 6 || weekday == 0)
 	{
@@ -776,6 +824,17 @@ uint32_t WTSBaseDataMgr::getTradingDate(const char* pid, uint32_t uOffDate /* =
 
 uint32_t WTSBaseDataMgr::getNextTDate(const char* pid, uint32_t uDate, int days /* = 1 */, bool isTpl /* = false */)
 {
+	if (days > 0)
+	{
+		const TradingCalendar* cal = getCalendar(pid, isTpl);
+		if (cal != NULL)
+		{
+			uint32_t ret = cal->next_tdate(uDate, days);
+			if (ret != 0)
+				return ret;
+		}
+	}
+
 	uint32_t curDate = uDate;
 	int left = days;
 	while (true)
@@ -803,6 +862,17 @@ uint32_t WTSBaseDataMgr::getNextTDate(const char* pid, uint32_t uDate, int days
 
 uint32_t WTSBaseDataMgr::getPrevTDate(const char* pid, uint32_t uDate, int days /* = 1 */, bool isTpl /* = false */)
 {
+	if (days > 0)
+	{
+		const TradingCalendar* cal = getCalendar(pid, isTpl);
+		if (cal != NULL)
+		{
+			uint32_t ret = cal->prev_tdate(uDate, days);
+			if (ret != 0)
+				return ret;
+		}
+	}
+
 	uint32_t curDate = uDate;
 	int left = days;
 	while (true)
@@ -830,13 +900,27 @@ uint32_t WTSBaseDataMgr::getPrevTDate(const char* pid, uint32_t uDate, int days
 
 bool WTSBaseDataMgr::isTradingDate(const char* pid, uint32_t uDate, bool isTpl /* = false */)
 {
-	uint32_t wd = TimeUtils::getWeekDay(uDate);
-	if (wd != 0 && wd != 6 && !isHoliday(pid, uDate, isTpl))
+	return !isHoliday(pid, uDate, isTpl);
+}
+
+uint32_t WTSBaseDataMgr::getTradingDays(const char* pid, uint32_t uBeginDate, uint32_t uEndDate, bool isTpl /* = false */)
+{
+	if (uBeginDate > uEndDate)
+		return 0;
+
+	const TradingCalendar* cal = getCalendar(pid, isTpl);
+	if (cal != NULL && cal->in_range(uBeginDate) && cal->in_range(uEndDate))
+		return cal->count_tdates(uBeginDate, uEndDate);
+
+	//超出日历区间的，逐日累加
+	uint32_t count = 0;
+	for (uint32_t curDate = uBeginDate; curDate <= uEndDate; curDate = TimeUtils::getNextDate(curDate))
 	{
-		return true;
+		if (!isHoliday(pid, curDate, isTpl))
+			count++;
 	}
 
-	return false;
+	return count;
 }
 
 void WTSBaseDataMgr::setTradingDate(const char* pid, uint32_t uDate, bool isTpl /* = false */)
@@ -865,8 +949,16 @@ CodeSet* WTSBaseDataMgr::getSessionComms(const char* sid)
 
 const char* WTSBaseDataMgr::getTplIDByPID(const char* pid)
 {
+	//绝大部分传进来的都是EXCHG.PID，直接查表，不用再拆分
+	WTSCommodityInfo* commInfo = getCommodity(pid);
+	if (commInfo != NULL)
+		return commInfo->getTradingTpl();
+
 	const StringVector& ay = StrUtil::split(pid, ".");
-	WTSCommodityInfo* commInfo = getCommodity(ay[0].c_str(), ay[1].c_str());
+	if (ay.size() < 2)
+		return "";
+
+	commInfo = getCommodity(ay[0].c_str(), ay[1].c_str());
 	if (commInfo == NULL)
 		return "";
 
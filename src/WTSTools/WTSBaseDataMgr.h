@@ -11,10 +11,12 @@
 #include "../Includes/IBaseDataMgr.h"
 #include "../Includes/WTSCollection.hpp"
 #include "../Includes/FasterDefs.h"
+#include "../Share/TradingCalendar.hpp"
 
 USING_NS_WTP;
 
 typedef wt_hashmap<std::string, TradingDayTpl>	TradingDayTplMap;
+typedef wt_hashmap<std::string, TradingCalendar>	TradingCalendarMap;
 
 typedef WTSHashMap<std::string>		WTSContractList;
 typedef WTSHashMap<std::string>		WTSExchgContract;
@@ -55,20 +57,38 @@ public:
 	bool		loadContracts(const char* filename);
 	bool		loadHolidays(const char* filename);
 
+	/*
+	 *	设置交易日历的预计算区间，默认为19900101-20501231
+	 *	区间以外的日期按原来的方式逐日计算
+	 */
+	virtual void		setCalendarRange(uint32_t uBeginDate, uint32_t uEndDate) override;
+
 public:
 	uint32_t	getTradingDate(const char* stdPID, uint32_t uOffDate = 0, uint32_t uOffMinute = 0, bool isTpl = false);
-	uint32_t	getNextTDate(const char* stdPID, uint32_t uDate, int days = 1, bool isTpl = false);
-	uint32_t	getPrevTDate(const char* stdPID, uint32_t uDate, int days = 1, bool isTpl = false);
+	virtual uint32_t	getNextTDate(const char* stdPID, uint32_t uDate, int days = 1, bool isTpl = false) override;
+	virtual uint32_t	getPrevTDate(const char* stdPID, uint32_t uDate, int days = 1, bool isTpl = false) override;
 	bool		isTradingDate(const char* stdPID, uint32_t uDate, bool isTpl = false);
 	void		setTradingDate(const char* stdPID, uint32_t uDate, bool isTpl = false);
 
+	/*
+	 *	[uBeginDate, uEndDate]之间的交易日数
+	 */
+	virtual uint32_t	getTradingDays(const char* stdPID, uint32_t uBeginDate, uint32_t uEndDate, bool isTpl = false) override;
+
 	CodeSet*	getSessionComms(const char* sid);
 
 private:
 	const char* getTplIDByPID(const char* stdPID);
 
+	const TradingCalendar* getCalendar(const char* stdPID, bool isTpl);
+
+	void		buildCalendars();
+
 private:
 	TradingDayTplMap	m_mapTradingDay;
+	TradingCalendarMap	m_mapCalendars;
+	uint32_t			m_uCalBegin;
+	uint32_t			m_uCalEnd;
 
 	SessionCodeMap		m_mapSessionCode;
 
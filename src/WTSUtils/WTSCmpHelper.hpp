@@ -26,14 +26,36 @@ public:
 		return desBuf;
 	}
 
+	/*
+	 *	解压数据，支持多个压缩帧直接拼接的数据
+	 *	盘中封存的实时数据分段，收盘的时候直接拼接写入历史文件
+	 */
 	static std::string uncompress_data(const void* data, size_t dataLen)
 	{
 		std::string desBuf;
-		unsigned long long const desLen = ZSTD_getFrameContentSize(data, dataLen);
-		desBuf.resize((std::size_t)desLen, 0);
-		size_t const dSize = ZSTD_decompress((void*)desBuf.data(), (size_t)desLen, data, dataLen);
-		if (dSize != desLen)
-			throw std::runtime_error("uncompressed data size does not match calculated data size");
+		const char* src = (const char*)data;
+		size_t left = dataLen;
+		while (left > 0)
+		{
+			size_t frameLen = ZSTD_findFrameCompressedSize(src, left);
+			if (ZSTD_isError(frameLen))
+			{
+				//第一帧保持原来的处理方式，后面的无效数据忽略
+				if (src != (const char*)data)
+					break;
+				frameLen = left;
+			}
+
+			unsigned long long const desLen = ZSTD_getFrameContentSize(src, frameLen);
+			std::size_t offset = desBuf.size();
+			desBuf.resize(offset + (std::size_t)desLen, 0);
+			size_t const dSize = ZSTD_decompress((void*)(desBuf.data() + offset), (size_t)desLen, src, frameLen);
+			if (dSize != desLen)
+				throw std::runtime_error("uncompressed data size does not match calculated data size");
+
+			src += frameLen;
+			left -= frameLen;
+		}
 		return desBuf;
 	}
 };
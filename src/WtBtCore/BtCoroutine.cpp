@@ -0,0 +1,144 @@
+﻿/*!
+ * \file BtCoroutine.cpp
+ * \project	WonderTrader
+ *
+ * \brief 回测单步推进用的有栈协程实现
+ */
+#include "BtCoroutine.h"
+
+#include "../WTSTools/WTSLogger.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <ucontext.h>
+#include <stdlib.h>
+#endif
+
+BtCoroutine::BtCoroutine(Routine routine, std::size_t stackSize /* = 16 * 1024 * 1024 */)
+	: _routine(routine)
+	, _stack_size(stackSize)
+	, _started(false)
+	, _finished(false)
+	, _in_routine(false)
+	, _context(NULL)
+	, _caller(NULL)
+	, _stack(NULL)
+{
+}
+
+BtCoroutine::~BtCoroutine()
+{
+	if (_started && !_finished)
+		WTSLogger::warn("Coroutine released before finished");
+
+#ifdef _WIN32
+	if (_context)
+		DeleteFiber(_context);
+#else
+	delete (ucontext_t*)_context;
+	delete (ucontext_t*)_caller;
+	if (_stack)
+		free(_stack);
+#endif
+}
+
+#ifdef _WIN32
+void __stdcall BtCoroutine::fiber_entry(void* param)
+{
+	BtCoroutine* co = (BtCoroutine*)param;
+	co->run_routine();
+	//Fiber的执行体不能返回，直接切回调用方
+	SwitchToFiber(co->_caller);
+}
+#else
+void BtCoroutine::context_entry(uint32_t lo, uint32_t hi)
+{
+	BtCoroutine* co = (BtCoroutine*)(((uintptr_t)hi << 16 << 16) | (uintptr_t)lo);
+	co->run_routine();
+	//返回以后通过uc_link回到调用方
+}
+#endif
+
+void BtCoroutine::run_routine()
+{
+	try
+	{
+		_routine();
+	}
+	catch (std::exception& ex)
+	{
+		WTSLogger::error("Exception raised in coroutine: {}", ex.what());
+	}
+	catch (...)
+	{
+		WTSLogger::error("Exception raised in coroutine");
+	}
+
+	_finished = true;
+}
+
+bool BtCoroutine::resume()
+{
+	if (_finished || _in_routine)
+		return false;
+
+#ifdef _WIN32
+	//调用方线程要先转成Fiber才能切换
+	if (IsThreadAFiber())
+		_caller = GetCurrentFiber();
+	else
+		_caller = ConvertThreadToFiber(NULL);
+
+	if (!_started)
+	{
+		_context = CreateFiber(_stack_size, (LPFIBER_START_ROUTINE)&BtCoroutine::fiber_entry, this);
+		if (_context == NULL)
+		{
+			WTSLogger::error("Creating fiber failed");
+			_finished = true;
+			return false;
+		}
+		_started = true;
+	}
+
+	_in_routine = true;
+	SwitchToFiber(_context);
+	_in_routine = false;
+#else
+	if (!_started)
+	{
+		_stack = (char*)malloc(_stack_size);
+		_context = new ucontext_t;
+		_caller = new ucontext_t;
+
+		ucontext_t* ctx = (ucontext_t*)_context;
+		getcontext(ctx);
+		ctx->uc_stack.ss_sp = _stack;
+		ctx->uc_stack.ss_size = _stack_size;
+		ctx->uc_link = (ucontext_t*)_caller;
+
+		uintptr_t ptr = (uintptr_t)this;
+		makecontext(ctx, (void(*)())&BtCoroutine::context_entry, 2, (uint32_t)ptr, (uint32_t)(ptr >> 16 >> 16));
+		_started = true;
+	}
+
+	_in_routine = true;
+	swapcontext((ucontext_t*)_caller, (ucontext_t*)_context);
+	_in_routine = false;
+#endif
+
+	return !_finished;
+}
+
+void BtCoroutine::yield()
+{
+	if (!_in_routine)
+		return;
+
+#ifdef _WIN32
+	SwitchToFiber(_caller);
+#else
+	swapcontext((ucontext_t*)_context, (ucontext_t*)_caller);
+#endif
+}
@@ -0,0 +1,64 @@
+﻿/*!
+ * \file BtCoroutine.h
+ * \project	WonderTrader
+ *
+ * \brief 回测单步推进用的有栈协程
+ *
+ * 回放在协程自己的栈上运行，但是和调用方在同一个线程里
+ * 调用方resume以后回放一直跑到策略的挂起点yield回来，中间没有线程切换，也不需要锁和条件变量
+ * linux下用ucontext实现，windows下用Fiber实现
+ */
+#pragma once
+#include <stdint.h>
+#include <functional>
+
+class BtCoroutine
+{
+public:
+	typedef std::function<void()> Routine;
+
+	/*
+	 *	@routine	协程的执行体，第一次resume的时候开始执行
+	 *	@stackSize	协程栈大小
+	 */
+	BtCoroutine(Routine routine, std::size_t stackSize = 16 * 1024 * 1024);
+	~BtCoroutine();
+
+public:
+	/*
+	 *	切换到协程执行，协程yield或者执行完成以后返回
+	 *	返回协程是否还没有执行完成
+	 */
+	bool	resume();
+
+	/*
+	 *	从协程切回调用方，只能在协程里调用
+	 */
+	void	yield();
+
+	inline bool	finished() const { return _finished; }
+
+	//当前是否在协程里执行
+	inline bool	in_routine() const { return _in_routine; }
+
+private:
+	void	run_routine();
+
+#ifdef _WIN32
+	static void __stdcall fiber_entry(void* param);
+#else
+	//makecontext只能传int参数，指针拆成两半传进去
+	static void	context_entry(uint32_t lo, uint32_t hi);
+#endif
+
+private:
+	Routine		_routine;
+	std::size_t	_stack_size;
+	bool		_started;
+	bool		_finished;
+	bool		_in_routine;
+
+	void*		_context;	//协程的上下文
+	void*		_caller;	//调用方的上下文
+	char*		_stack;
+};
@@ -0,0 +1,692 @@
+﻿/*!
+ * \file BtOutputTable.cpp
+ * \project	WonderTrader
+ *
+ * \brief 回测结果输出表实现
+ */
+#include "BtOutputTable.h"
+
+#include "../Share/StrUtil.hpp"
+#include "../Share/StdUtils.hpp"
+#include "../Share/fmtlib.h"
+#include "../WTSUtils/WTSCmpHelper.hpp"
+
+#include <iterator>
+
+namespace
+{
+	//csv缓存超过这个大小就写入文件
+	const std::size_t CSV_FLUSH_SIZE = 1024 * 1024;
+
+	//二进制格式每个数据块的行数
+	const uint32_t CHUNK_ROWS = 8192;
+
+	const char WTC_FILE_FLAG[8] = { 'W', 'T', 'C', 'O', 'L', 'F', 'I', 'L' };
+	const char WTC_INDEX_FLAG[8] = { 'W', 'T', 'C', 'O', 'L', 'I', 'D', 'X' };
+	const uint32_t WTC_VERSION = 1;
+
+#pragma pack(push, 1)
+	//文件头，后面紧跟字段名字符串和类型字符串
+	typedef struct _WtcFileHeader
+	{
+		char		_flag[8];
+		uint32_t	_version;
+		uint32_t	_col_count;
+		uint32_t	_fields_len;
+		int32_t		_date_col;
+	} WtcFileHeader;
+
+	//数据块头，后面紧跟每一列压缩后的大小，再后面是每一列压缩后的数据
+	typedef struct _WtcChunkHeader
+	{
+		uint32_t	_rows;
+		uint32_t	_sdate;
+		uint32_t	_edate;
+		uint32_t	_col_count;
+	} WtcChunkHeader;
+
+	//文件尾，前面是数据块索引
+	typedef struct _WtcFooter
+	{
+		uint64_t	_index_offset;
+		uint32_t	_chunk_count;
+		uint32_t	_reserve;
+		uint64_t	_total_rows;
+		char		_flag[8];
+	} WtcFooter;
+#pragma pack(pop)
+
+	inline uint32_t to_date(uint64_t val)
+	{
+		//yyyyMMddHHmm这类以日期开头的时间，截取到8位就是日期
+		while (val >= 100000000)
+			val /= 10;
+		return (uint32_t)val;
+	}
+
+	inline void format_double(std::string& buf, char type, double val)
+	{
+		if (type == BtOutputTable::CT_Double2)
+			fmt::format_to(std::back_inserter(buf), "{:.2f}", val);
+		else if (type == BtOutputTable::CT_DoubleR)
+			fmt::format_to(std::back_inserter(buf), "{}", val);
+		else
+			fmt::format_to(std::back_inserter(buf), "{:g}", val);
+	}
+
+	template<typename T>
+	inline T read_value(const char*& p)
+	{
+		T ret;
+		memcpy(&ret, p, sizeof(T));
+		p += sizeof(T);
+		return ret;
+	}
+
+	/*
+	 *	校验offset处的数据块是否完整落在文件内
+	 *	返回数据块的总长度，不完整或者列数不一致返回0
+	 */
+	inline std::size_t check_chunk(const std::string& content, uint64_t offset, uint32_t colCnt)
+	{
+		std::size_t total = content.size();
+		if (offset > total || total - offset < sizeof(WtcChunkHeader) + sizeof(uint32_t)*colCnt)
+			return 0;
+
+		const WtcChunkHeader* cHeader = (const WtcChunkHeader*)(content.data() + offset);
+		if (cHeader->_col_count != colCnt)
+			return 0;
+
+		uint64_t chunkSize = sizeof(WtcChunkHeader) + sizeof(uint32_t)*colCnt;
+		const uint32_t* sizes = (const uint32_t*)(content.data() + offset + sizeof(WtcChunkHeader));
+		for (uint32_t i = 0; i < colCnt; i++)
+			chunkSize += sizes[i];
+
+		if (chunkSize > total - offset)
+			return 0;
+
+		return (std::size_t)chunkSize;
+	}
+}
+
+BtOutputTable::BtOutputTable()
+	: _date_col(-1)
+	, _opened(false)
+	, _binary(false)
+	, _file_offset(0)
+	, _cur_col(0)
+	, _total_rows(0)
+	, _chunk_rows(0)
+	, _chunk_sdate(0)
+	, _chunk_edate(0)
+{
+}
+
+BtOutputTable::~BtOutputTable()
+{
+	close();
+}
+
+void BtOutputTable::setup(const char* fields, const char* types, int32_t dateCol /* = -1 */)
+{
+	_fields = fields;
+	_types = types;
+	_date_col = dateCol;
+	_names = StrUtil::split(_fields, ",");
+	_col_bufs.resize(_types.size());
+}
+
+bool BtOutputTable::open(const char* filename, bool bBinary)
+{
+	if (_opened)
+		return true;
+
+	_binary = bBinary;
+	std::string path = filename;
+	path += _binary ? ".wtc" : ".csv";
+	if (!_file.create_new_file(path.c_str()))
+		return false;
+
+	_opened = true;
+	_cur_col = 0;
+	_total_rows = 0;
+	_chunks.clear();
+
+	if (_binary)
+	{
+		WtcFileHeader header;
+		memcpy(header._flag, WTC_FILE_FLAG, sizeof(WTC_FILE_FLAG));
+		header._version = WTC_VERSION;
+		header._col_count = (uint32_t)_types.size();
+		header._fields_len = (uint32_t)_fields.size();
+		header._date_col = _date_col;
+
+		_file.write_file(&header, sizeof(header));
+		_file.write_file(_fields);
+		_file.write_file(_types);
+		_file_offset = sizeof(header) + _fields.size() + _types.size();
+
+		for (std::string& buf : _col_bufs)
+			buf.clear();
+		_chunk_rows = 0;
+	}
+	else
+	{
+		_csv_buf = _fields;
+		_csv_buf += "\n";
+	}
+
+	return true;
+}
+
+void BtOutputTable::put_double(double val)
+{
+	char type = _types[_cur_col];
+	if (_binary)
+	{
+		std::string& buf = _col_bufs[_cur_col];
+		if (type == CT_UInt)
+		{
+			uint64_t v = (uint64_t)val;
+			buf.append((const char*)&v, sizeof(v));
+		}
+		else if (type == CT_Int)
+		{
+			int64_t v = (int64_t)val;
+			buf.append((const char*)&v, sizeof(v));
+		}
+		else if (type == CT_String)
+		{
+			std::string s = fmt::format("{:g}", val);
+			put_string(s.c_str(), s.size());
+			return;
+		}
+		else
+		{
+			buf.append((const char*)&val, sizeof(val));
+		}
+	}
+	else
+	{
+		if (type == CT_UInt || type == CT_Int)
+			fmt::format_to(std::back_inserter(_csv_buf), "{}", (int64_t)val);
+		else
+			format_double(_csv_buf, type, val);
+	}
+}
+
+void BtOutputTable::put_int(int64_t val)
+{
+	char type = _types[_cur_col];
+	if (type != CT_Int && type != CT_UInt)
+	{
+		if (type == CT_String)
+		{
+			std::string s = fmt::format("{}", val);
+			put_string(s.c_str(), s.size());
+		}
+		else
+			put_double((double)val);
+		return;
+	}
+
+	if (_binary)
+		_col_bufs[_cur_col].append((const char*)&val, sizeof(val));
+	else if (type == CT_UInt)
+		fmt::format_to(std::back_inserter(_csv_buf), "{}", (uint64_t)val);
+	else
+		fmt::format_to(std::back_inserter(_csv_buf), "{}", val);
+}
+
+void BtOutputTable::put_uint(uint64_t val)
+{
+	if ((int32_t)_cur_col == _date_col)
+		update_date(val);
+
+	put_int((int64_t)val);
+}
+
+void BtOutputTable::put_string(const char* val, std::size_t len)
+{
+	if (_binary)
+	{
+		std::string& buf = _col_bufs[_cur_col];
+		uint16_t l = (uint16_t)std::min(len, (std::size_t)UINT16_MAX);
+		buf.append((const char*)&l, sizeof(l));
+		buf.append(val, l);
+	}
+	else
+	{
+		_csv_buf.append(val, len);
+	}
+}
+
+BtOutputTable& BtOutputTable::operator<<(const char* val)
+{
+	if (!_opened || _cur_col >= _types.size())
+		return *this;
+
+	if (!_binary && _cur_col > 0)
+		_csv_buf.push_back(',');
+
+	char type = _types[_cur_col];
+	if (type == CT_String)
+		put_string(val, strlen(val));
+	else if (type == CT_UInt)
+		put_uint(strtoull(val, NULL, 10));
+	else if (type == CT_Int)
+		put_int(strtoll(val, NULL, 10));
+	else
+		put_double(strtod(val, NULL));
+
+	_cur_col++;
+	return *this;
+}
+
+BtOutputTable& BtOutputTable::operator<<(double val)
+{
+	if (!_opened || _cur_col >= _types.size())
+		return *this;
+
+	if (!_binary && _cur_col > 0)
+		_csv_buf.push_back(',');
+
+	if ((int32_t)_cur_col == _date_col && val > 0)
+		update_date((uint64_t)val);
+
+	put_double(val);
+
+	_cur_col++;
+	return *this;
+}
+
+BtOutputTable& BtOutputTable::operator<<(int64_t val)
+{
+	if (!_opened || _cur_col >= _types.size())
+		return *this;
+
+	if (!_binary && _cur_col > 0)
+		_csv_buf.push_back(',');
+
+	if ((int32_t)_cur_col == _date_col && val > 0)
+		update_date((uint64_t)val);
+
+	put_int(val);
+
+	_cur_col++;
+	return *this;
+}
+
+BtOutputTable& BtOutputTable::operator<<(uint64_t val)
+{
+	if (!_opened || _cur_col >= _types.size())
+		return *this;
+
+	if (!_binary && _cur_col > 0)
+		_csv_buf.push_back(',');
+
+	put_uint(val);
+
+	_cur_col++;
+	return *this;
+}
+
+void BtOutputTable::update_date(uint64_t val)
+{
+	uint32_t uDate = to_date(val);
+	if (_chunk_sdate == 0 || uDate < _chunk_sdate)
+		_chunk_sdate = uDate;
+	if (uDate > _chunk_edate)
+		_chunk_edate = uDate;
+}
+
+void BtOutputTable::end_row()
+{
+	if (!_opened)
+		return;
+
+	//列数不够的，补上空值，保证每一行的列数和表头一致
+	while (_cur_col < _types.size())
+	{
+		char type = _types[_cur_col];
+		if (type == CT_String)
+			*this << "";
+		else
+			*this << 0.0;
+	}
+
+	_cur_col = 0;
+	_total_rows++;
+
+	if (_binary)
+	{
+		_chunk_rows++;
+		if (_chunk_rows >= CHUNK_ROWS)
+			flush_chunk();
+	}
+	else
+	{
+		_csv_buf.push_back('\n');
+		flush_csv();
+	}
+}
+
+void BtOutputTable::append_csv_row(const char* line)
+{
+	if (!_opened)
+		return;
+
+	StringVector ay = StrUtil::split(line, ",");
+	for (std::size_t i = 0; i < _types.size(); i++)
+	{
+		const char* val = (i < ay.size()) ? ay[i].c_str() : "";
+		*this << val;
+	}
+	end_row();
+}
+
+void BtOutputTable::append_csv_rows(const std::string& rows)
+{
+	std::size_t pos = 0;
+	while (pos < rows.size())
+	{
+		std::size_t eol = rows.find('\n', pos);
+		if (eol == std::string::npos)
+			eol = rows.size();
+
+		std::size_t len = eol - pos;
+		if (len > 0 && rows[pos + len - 1] == '\r')
+			len--;
+
+		if (len > 0)
+			append_csv_row(rows.substr(pos, len).c_str());
+
+		pos = eol + 1;
+	}
+}
+
+void BtOutputTable::flush_csv(bool bForce /* = false */)
+{
+	if (_csv_buf.empty())
+		return;
+
+	if (!bForce && _csv_buf.size() < CSV_FLUSH_SIZE)
+		return;
+
+	_file.write_file(_csv_buf);
+	_csv_buf.clear();
+}
+
+void BtOutputTable::flush_chunk()
+{
+	if (_chunk_rows == 0)
+		return;
+
+	uint32_t colCnt = (uint32_t)_types.size();
+	std::vector<std::string> cmpDatas(colCnt);
+	std::vector<uint32_t> sizes(colCnt);
+	for (uint32_t i = 0; i < colCnt; i++)
+	{
+		cmpDatas[i] = WTSCmpHelper::compress_data(_col_bufs[i].data(), _col_bufs[i].size());
+		sizes[i] = (uint32_t)cmpDatas[i].size();
+		_col_bufs[i].clear();
+	}
+
+	WtcChunkHeader header;
+	header._rows = _chunk_rows;
+	header._sdate = _chunk_sdate;
+	header._edate = _chunk_edate;
+	header._col_count = colCnt;
+
+	ChunkIndex idx;
+	idx._offset = _file_offset;
+	idx._rows = _chunk_rows;
+	idx._sdate = _chunk_sdate;
+	idx._edate = _chunk_edate;
+	idx._reserve = 0;
+	_chunks.emplace_back(idx);
+
+	_file.write_file(&header, sizeof(header));
+	_file.write_file(sizes.data(), sizeof(uint32_t)*colCnt);
+	_file_offset += sizeof(header) + sizeof(uint32_t)*colCnt;
+	for (const std::string& data : cmpDatas)
+	{
+		_file.write_file(data);
+		_file_offset += data.size();
+	}
+
+	_chunk_rows = 0;
+	_chunk_sdate = 0;
+	_chunk_edate = 0;
+}
+
+void BtOutputTable::close()
+{
+	if (!_opened)
+		return;
+
+	if (_binary)
+	{
+		flush_chunk();
+
+		WtcFooter footer;
+		footer._index_offset = _file_offset;
+		footer._chunk_count = (uint32_t)_chunks.size();
+		footer._reserve = 0;
+		footer._total_rows = _total_rows;
+		memcpy(footer._flag, WTC_INDEX_FLAG, sizeof(WTC_INDEX_FLAG));
+		if (!_chunks.empty())
+			_file.write_file(_chunks.data(), sizeof(ChunkIndex)*_chunks.size());
+		_file.write_file(&footer, sizeof(footer));
+	}
+	else
+	{
+		flush_csv(true);
+	}
+
+	_file.close_file();
+	_opened = false;
+}
+
+bool BtOutputTable::convert_to_csv(const char* binFile, const char* csvFile, uint32_t sDate /* = 0 */, uint32_t eDate /* = 0 */)
+{
+	if (!StdFile::exists(binFile))
+		return false;
+
+	BoostFile bf;
+	if (!bf.create_new_file(csvFile))
+		return false;
+
+	bool bSucc = decode_csv(binFile, sDate, eDate, [&bf](std::string& buf) {
+		bf.write_file(buf);
+		buf.clear();
+	});
+	bf.close_file();
+	return bSucc;
+}
+
+bool BtOutputTable::read_csv_rows(const char* filename, std::string& rows)
+{
+	rows.clear();
+
+	std::string path = filename;
+	bool bSucc = false;
+	if (StdFile::exists((path + ".wtc").c_str()))
+	{
+		bSucc = decode_csv((path + ".wtc").c_str(), 0, 0, [&rows](std::string& buf) {
+			rows += buf;
+			buf.clear();
+		});
+	}
+	else if (StdFile::exists((path + ".csv").c_str()))
+	{
+		bSucc = (StdFile::read_file_content((path + ".csv").c_str(), rows) > 0);
+	}
+
+	if (!bSucc)
+		return false;
+
+	//去掉表头
+	std::size_t eol = rows.find('\n');
+	if (eol == std::string::npos)
+		rows.clear();
+	else
+		rows.erase(0, eol + 1);
+	return true;
+}
+
+bool BtOutputTable::decode_csv(const char* binFile, uint32_t sDate, uint32_t eDate, FuncFlushCsv cb)
+{
+	std::string content;
+	if (!StdFile::read_file_content(binFile, content) || content.size() < sizeof(WtcFileHeader))
+		return false;
+
+	const WtcFileHeader* header = (const WtcFileHeader*)content.data();
+	if (memcmp(header->_flag, WTC_FILE_FLAG, sizeof(WTC_FILE_FLAG)) != 0)
+		return false;
+
+	uint32_t colCnt = header->_col_count;
+	std::size_t pos = sizeof(WtcFileHeader);
+	if ((uint64_t)header->_fields_len + colCnt > content.size() - pos)
+		return false;
+
+	std::string fields(content.data() + pos, header->_fields_len);
+	pos += header->_fields_len;
+	std::string types(content.data() + pos, colCnt);
+	pos += colCnt;
+
+	//先读取文件尾的数据块索引，如果文件没有正常关闭没有索引，就从头扫描所有数据块
+	std::vector<ChunkIndex> chunks;
+	const WtcFooter* footer = (const WtcFooter*)(content.data() + content.size() - sizeof(WtcFooter));
+	if (content.size() >= pos + sizeof(WtcFooter) && memcmp(footer->_flag, WTC_INDEX_FLAG, sizeof(WTC_INDEX_FLAG)) == 0)
+	{
+		//索引区和每个数据块都必须落在文件内，否则认为文件损坏
+		std::size_t idxEnd = content.size() - sizeof(WtcFooter);
+		if (footer->_index_offset < pos || footer->_index_offset > idxEnd
+			|| footer->_chunk_count > (idxEnd - footer->_index_offset) / sizeof(ChunkIndex))
+			return false;
+
+		const ChunkIndex* idx = (const ChunkIndex*)(content.data() + footer->_index_offset);
+		chunks.assign(idx, idx + footer->_chunk_count);
+		for (const ChunkIndex& item : chunks)
+		{
+			std::size_t chunkSize = check_chunk(content, item._offset, colCnt);
+			if (chunkSize == 0 || item._offset + chunkSize > footer->_index_offset)
+				return false;
+		}
+	}
+	else
+	{
+		while (pos + sizeof(WtcChunkHeader) <= content.size())
+		{
+			const WtcChunkHeader* cHeader = (const WtcChunkHeader*)(content.data() + pos);
+			std::size_t chunkSize = check_chunk(content, pos, colCnt);
+			if (chunkSize == 0)
+				break;
+
+			ChunkIndex idx;
+			idx._offset = pos;
+			idx._rows = cHeader->_rows;
+			idx._sdate = cHeader->_sdate;
+			idx._edate = cHeader->_edate;
+			idx._reserve = 0;
+			chunks.emplace_back(idx);
+			pos += chunkSize;
+		}
+	}
+
+	std::string buf = fields;
+	buf += "\n";
+
+	int32_t dateCol = header->_date_col;
+	bool bFilter = (dateCol >= 0 && (sDate != 0 || eDate != 0));
+	if (eDate == 0)
+		eDate = UINT32_MAX;
+
+	std::vector<std::string> cols(colCnt);
+	std::vector<const char*> cursors(colCnt);
+	std::vector<const char*> ends(colCnt);
+	for (const ChunkIndex& idx : chunks)
+	{
+		//按照日期索引跳过不需要的数据块
+		if (bFilter && (idx._edate < sDate || idx._sdate > eDate))
+			continue;
+
+		const char* p = content.data() + idx._offset + sizeof(WtcChunkHeader);
+		const uint32_t* sizes = (const uint32_t*)p;
+		p += sizeof(uint32_t)*colCnt;
+		for (uint32_t i = 0; i < colCnt; i++)
+		{
+			try
+			{
+				cols[i] = WTSCmpHelper::uncompress_data(p, sizes[i]);
+			}
+			catch (...)
+			{
+				return false;
+			}
+			cursors[i] = cols[i].data();
+			ends[i] = cursors[i] + cols[i].size();
+			p += sizes[i];
+		}
+
+		for (uint32_t r = 0; r < idx._rows; r++)
+		{
+			std::size_t rowStart = buf.size();
+			bool bSkip = false;
+			for (uint32_t i = 0; i < colCnt; i++)
+			{
+				if (i > 0)
+					buf.push_back(',');
+
+				char type = types[i];
+				const char*& cur = cursors[i];
+				//解压后的列数据不够行数，说明数据块损坏
+				std::size_t left = (std::size_t)(ends[i] - cur);
+				std::size_t need = (type == CT_String) ? sizeof(uint16_t) : sizeof(uint64_t);
+				if (left < need)
+					return false;
+
+				if (type == CT_String)
+				{
+					uint16_t len = read_value<uint16_t>(cur);
+					if (left - need < len)
+						return false;
+
+					buf.append(cur, len);
+					cur += len;
+				}
+				else if (type == CT_UInt)
+				{
+					uint64_t val = read_value<uint64_t>(cur);
+					if (bFilter && (int32_t)i == dateCol)
+					{
+						uint32_t uDate = to_date(val);
+						bSkip = (uDate < sDate || uDate > eDate);
+					}
+					fmt::format_to(std::back_inserter(buf), "{}", val);
+				}
+				else if (type == CT_Int)
+				{
+					fmt::format_to(std::back_inserter(buf), "{}", read_value<int64_t>(cur));
+				}
+				else
+				{
+					format_double(buf, type, read_value<double>(cur));
+				}
+			}
+
+			if (bSkip)
+				buf.resize(rowStart);
+			else
+				buf.push_back('\n');
+		}
+
+		if (buf.size() >= CSV_FLUSH_SIZE)
+			cb(buf);
+	}
+
+	if (!buf.empty())
+		cb(buf);
+	return true;
+}
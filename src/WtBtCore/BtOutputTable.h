@@ -0,0 +1,160 @@
+﻿/*!
+ * \file BtOutputTable.h
+ * \project	WonderTrader
+ *
+ * \brief 回测结果输出表
+ *
+ * 回测的成交、平仓、资金、持仓、信号等结果表，在回测过程中逐行写入文件，不再全部缓存在stringstream中
+ * 支持两种格式：
+ * 1、csv格式，和原来的输出完全一致，数据在内存中攒够一定大小就写入文件
+ * 2、列式二进制格式(.wtc)，按列类型存储，每满一个数据块就按列压缩写入，文件末尾有按日期的块索引
+ *    可以通过convert_to_csv转换成原来的csv格式
+ */
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "../Share/BoostFile.hpp"
+
+class BtOutputTable
+{
+public:
+	/*
+	 *	列类型，决定二进制格式下的存储方式，以及csv格式下的输出格式
+	 */
+	typedef enum tagColumnType
+	{
+		CT_String = 's',	//字符串
+		CT_UInt = 'u',		//无符号整数
+		CT_Int = 'i',		//有符号整数
+		CT_Double = 'g',	//浮点数，csv中按%g输出（和ostream的默认格式一致）
+		CT_DoubleR = 'r',	//浮点数，csv中按最短精确格式输出
+		CT_Double2 = 'f'	//浮点数，csv中保留2位小数
+	} ColumnType;
+
+public:
+	BtOutputTable();
+	~BtOutputTable();
+
+public:
+	/*
+	 *	设置表结构
+	 *	@fields		字段名，逗号分隔，也是csv的表头
+	 *	@types		每个字段的类型，每个字符对应一列，见ColumnType
+	 *	@dateCol	用于建立日期索引的列号，-1表示不建立索引
+	 *				该列的值可以是yyyyMMdd，也可以是yyyyMMddHHmm这类以日期开头的时间
+	 */
+	void	setup(const char* fields, const char* types, int32_t dateCol = -1);
+
+	/*
+	 *	打开输出文件，如果文件已经打开则直接返回
+	 *	@filename	文件名，不带扩展名，csv格式自动加.csv，二进制格式自动加.wtc
+	 *	@bBinary	是否输出列式二进制格式
+	 */
+	bool	open(const char* filename, bool bBinary);
+
+	inline bool	is_opened() const { return _opened; }
+
+	/*
+	 *	逐列写入，写满一行以后调用end_row
+	 *	数值会按照该列的类型转换，所以调用方不用关心具体的数值类型
+	 */
+	BtOutputTable& operator<<(const char* val);
+	BtOutputTable& operator<<(const std::string& val) { return *this << val.c_str(); }
+	BtOutputTable& operator<<(double val);
+	BtOutputTable& operator<<(int64_t val);
+	BtOutputTable& operator<<(uint64_t val);
+	BtOutputTable& operator<<(int32_t val) { return *this << (int64_t)val; }
+	BtOutputTable& operator<<(uint32_t val) { return *this << (uint64_t)val; }
+
+	void	end_row();
+
+	/*
+	 *	追加一行csv格式的数据，主要用于增量回测时加载之前的结果
+	 */
+	void	append_csv_row(const char* line);
+
+	/*
+	 *	追加多行csv格式的数据，每行以换行符分隔
+	 */
+	void	append_csv_rows(const std::string& rows);
+
+	/*
+	 *	将缓存的数据写入文件并关闭
+	 */
+	void	close();
+
+	inline uint64_t	row_count() const { return _total_rows; }
+
+public:
+	/*
+	 *	将二进制格式的结果文件转换成csv格式
+	 *	@binFile	二进制结果文件
+	 *	@csvFile	输出的csv文件
+	 *	@sDate		开始日期，为0则不限制，借助文件末尾的日期索引跳过不需要的数据块
+	 *	@eDate		结束日期，为0则不限制
+	 */
+	static bool	convert_to_csv(const char* binFile, const char* csvFile, uint32_t sDate = 0, uint32_t eDate = 0);
+
+	/*
+	 *	读取之前输出的结果表，返回去掉表头的csv格式数据
+	 *	主要用于增量回测，之前的结果可能是csv格式，也可能是二进制格式
+	 *	@filename	文件名，不带扩展名，优先读取.wtc，不存在再读取.csv
+	 *	@rows		读取到的数据行
+	 */
+	static bool	read_csv_rows(const char* filename, std::string& rows);
+
+private:
+	typedef std::function<void(std::string&)> FuncFlushCsv;
+	/*
+	 *	将二进制格式的结果文件解码成csv格式
+	 *	解码出来的数据按块交给cb处理，cb处理完以后需要清空缓存
+	 */
+	static bool	decode_csv(const char* binFile, uint32_t sDate, uint32_t eDate, FuncFlushCsv cb);
+
+private:
+	void	put_double(double val);
+	void	put_int(int64_t val);
+	void	put_uint(uint64_t val);
+	void	put_string(const char* val, std::size_t len);
+
+	void	flush_csv(bool bForce = false);
+	void	flush_chunk();
+
+	void	update_date(uint64_t val);
+
+private:
+	std::string			_fields;
+	std::string			_types;
+	std::vector<std::string>	_names;
+	int32_t				_date_col;
+
+	bool				_opened;
+	bool				_binary;
+	BoostFile			_file;
+	uint64_t			_file_offset;
+
+	uint32_t			_cur_col;
+	uint64_t			_total_rows;
+
+	//csv格式的写缓存
+	std::string			_csv_buf;
+
+	//二进制格式的当前数据块，每一列一个缓存
+	std::vector<std::string>	_col_bufs;
+	uint32_t			_chunk_rows;
+	uint32_t			_chunk_sdate;
+	uint32_t			_chunk_edate;
+
+	typedef struct _ChunkIndex
+	{
+		uint64_t	_offset;
+		uint32_t	_rows;
+		uint32_t	_sdate;
+		uint32_t	_edate;
+		uint32_t	_reserve;
+	} ChunkIndex;
+	std::vector<ChunkIndex>	_chunks;
+};
@@ -10,6 +10,7 @@
 #include "CtaMocker.h"
 #include "WtHelper.h"
 #include "EventNotifier.h"
+#include "BtCoroutine.h"
 
 #include <exception>
 #include <boost/filesystem.hpp>
@@ -71,11 +72,18 @@ CtaMocker::CtaMocker(HisDataReplayer* replayer, const char* name, int32_t slippa
 	, _has_hook(false)
 	, _hook_valid(true)
 	, _cur_step(0)
+	, _coroutine(NULL)
 	, _wait_calc(false)
 	, _in_backtest(false)
 	, _persist_data(persistData)
 {
 	_context_id = makeCtxId();
+
+	_trade_logs.setup("code,time,direct,action,price,qty,tag,fee,barno", "sussggsgu", 1);
+	_close_logs.setup("code,direct,opentime,openprice,closetime,closeprice,qty,profit,maxprofit,maxloss,totalprofit,entertag,exittag,openbarno,closebarno", "ssuguggggggssuu", 4);
+	_fund_logs.setup("date,closeprofit,positionprofit,dynbalance,fee", "uffff", 0);
+	_sig_logs.setup("code,target,sigprice,gentime,usertag", "sggus", 3);
+	_pos_logs.setup("date,code,volume,closeprofit,dynprofit", "usrff", 0);
 }
 
 
@@ -106,9 +114,9 @@ void CtaMocker::dump_stradata()
 			pItem.AddMember("lastexittime", pInfo._last_exittime, allocator);
 
 			rj::Value details(rj::kArrayType);
-			for (auto dit = pInfo._details.begin(); dit != pInfo._details.end(); dit++)
+			for (size_t idx = 0; idx < pInfo._details.size(); idx++)
 			{
-				const DetailInfo& dInfo = *dit;
+				const DetailInfo& dInfo = pInfo._details.at(idx);
 				rj::Value dItem(rj::kObjectType);
 				dItem.AddMember("long", dInfo._long, allocator);
 				dItem.AddMember("price", dInfo._price, allocator);
@@ -336,9 +344,9 @@ void CtaMocker::dump_chartdata()
 	}
 }
 
-void CtaMocker::dump_outputs()
+void CtaMocker::open_outputs()
 {
-	if (!_persist_data)
+	if (!_persist_data || _trade_logs.is_opened())
 		return;
 
 	std::string folder = WtHelper::getOutputDir();
@@ -346,30 +354,32 @@ void CtaMocker::dump_outputs()
 	folder += "/";
 	boost::filesystem::create_directories(folder.c_str());
 
-	std::string filename = folder + "trades.csv";
-	std::string content = "code,time,direct,action,price,qty,tag,fee,barno\n";
-	if(!_trade_logs.str().empty()) content += _trade_logs.str();
-	StdFile::write_file_content(filename.c_str(), (void*)content.c_str(), content.size());
+	bool bBinary = _replayer->is_binary_output();
+	_trade_logs.open((folder + "trades").c_str(), bBinary);
+	_close_logs.open((folder + "closes").c_str(), bBinary);
+	_fund_logs.open((folder + "funds").c_str(), bBinary);
+	_sig_logs.open((folder + "signals").c_str(), bBinary);
+	_pos_logs.open((folder + "positions").c_str(), bBinary);
+}
 
-	filename = folder + "closes.csv";
-	content = "code,direct,opentime,openprice,closetime,closeprice,qty,profit,maxprofit,maxloss,totalprofit,entertag,exittag,openbarno,closebarno\n";
-	if (!_close_logs.str().empty()) content += _close_logs.str();
-	StdFile::write_file_content(filename.c_str(), (void*)content.c_str(), content.size());
+void CtaMocker::dump_outputs()
+{
+	if (!_persist_data)
+		return;
 
-	filename = folder + "funds.csv";
-	content = "date,closeprofit,positionprofit,dynbalance,fee\n";
-	if (!_fund_logs.str().empty()) content += _fund_logs.str();
-	StdFile::write_file_content(filename.c_str(), (void*)content.c_str(), content.size());
+	//没有任何输出的时候，也要生成只有表头的文件
+	open_outputs();
 
-	filename = folder + "signals.csv";
-	content = "code,target,sigprice,gentime,usertag\n";
-	if (!_sig_logs.str().empty()) content += _sig_logs.str();
-	StdFile::write_file_content(filename.c_str(), (void*)content.c_str(), content.size());
+	_trade_logs.close();
+	_close_logs.close();
+	_fund_logs.close();
+	_sig_logs.close();
+	_pos_logs.close();
 
-	filename = folder + "positions.csv";
-	content = "date,code,volume,closeprofit,dynprofit\n";
-	if (!_pos_logs.str().empty()) content += _pos_logs.str();
-	StdFile::write_file_content(filename.c_str(), (void*)content.c_str(), content.size());
+	std::string folder = WtHelper::getOutputDir();
+	folder += _name;
+	folder += "/";
+	std::string filename;
 
 	{
 		rj::Document root(rj::kObjectType);
@@ -393,21 +403,24 @@ void CtaMocker::dump_outputs()
 
 void CtaMocker::log_signal(const char* stdCode, double target, double price, uint64_t gentime, const char* usertag /* = "" */)
 {
-	_sig_logs << stdCode << "," << target << "," << price << "," << gentime << "," << usertag << "\n";
+	_sig_logs << stdCode << target << price << gentime << usertag;
+	_sig_logs.end_row();
 }
 
 void CtaMocker::log_trade(const char* stdCode, bool isLong, bool isOpen, uint64_t curTime, double price, double qty, const char* userTag, double fee, uint32_t barNo)
 {
-	_trade_logs << stdCode << "," << curTime << "," << (isLong ? "LONG" : "SHORT") << "," << (isOpen ? "OPEN" : "CLOSE") 
-		<< "," << price << "," << qty << "," << userTag << "," << fee << "," << barNo << "\n";
+	_trade_logs << stdCode << curTime << (isLong ? "LONG" : "SHORT") << (isOpen ? "OPEN" : "CLOSE")
+		<< price << qty << userTag << fee << barNo;
+	_trade_logs.end_row();
 }
 
 void CtaMocker::log_close(const char* stdCode, bool isLong, uint64_t openTime, double openpx, uint64_t closeTime, double closepx, double qty, double profit, double maxprofit, double maxloss, 
 	double totalprofit /* = 0 */, const char* enterTag /* = "" */, const char* exitTag /* = "" */, uint32_t openBarNo /* = 0 */, uint32_t closeBarNo /* = 0 */)
 {
-	_close_logs << stdCode << "," << (isLong ? "LONG" : "SHORT") << "," << openTime << "," << openpx
-		<< "," << closeTime << "," << closepx << "," << qty << "," << profit << "," << maxprofit << "," << maxloss << ","
-		<< totalprofit << "," << enterTag << "," << exitTag << "," << openBarNo << "," << closeBarNo << "\n";
+	_close_logs << stdCode << (isLong ? "LONG" : "SHORT") << openTime << openpx
+		<< closeTime << closepx << qty << profit << maxprofit << maxloss
+		<< totalprofit << enterTag << exitTag << openBarNo << closeBarNo;
+	_close_logs.end_row();
 }
 
 bool CtaMocker::init_cta_factory(WTSVariant* cfg)
@@ -456,70 +469,23 @@ void CtaMocker::load_incremental_data(const char* incremental_backtest_base)
 	folder += "/";
 	WTSLogger::info("loading incremental data from: {}", folder);
 
-	std::string tradesFilename = folder + "trades.csv";
-	if (boost::filesystem::exists(tradesFilename))
-	{
-		std::ifstream tradesFile(tradesFilename);
-		std::string str;
-		// 跳过标题行
-		std::getline(tradesFile, str);
-		while (std::getline(tradesFile, str))
-		{
-			_trade_logs << str << "\n";
-		}
-	}
-
-	std::string closesFilename = folder + "closes.csv";
-	if (boost::filesystem::exists(closesFilename))
-	{
-		std::ifstream closesFile(closesFilename);
-		std::string str;
-		// 跳过标题行
-		std::getline(closesFile, str);
-		while (std::getline(closesFile, str))
-		{
-			_close_logs << str << "\n";
-		}
-	}
-
-	std::string fundsFilename = folder + "funds.csv";
-	if (boost::filesystem::exists(fundsFilename))
-	{
-		std::ifstream fundsFile(fundsFilename);
-		std::string str;
-		// 跳过标题行
-		std::getline(fundsFile, str);
-		while (std::getline(fundsFile, str))
-		{
-			_fund_logs << str << "\n";
-		}
-	}
-
-	std::string positionsFilename = folder + "positions.csv";
-	if (boost::filesystem::exists(positionsFilename))
-	{
-		std::ifstream positionsFile(positionsFilename);
-		std::string str;
-		// 跳过标题行
-		std::getline(positionsFile, str);
-		while (std::getline(positionsFile, str))
-		{
-			_pos_logs << str << "\n";
-		}
-	}
-
-	std::string signalsFilename = folder + "signals.csv";
-	if (boost::filesystem::exists(signalsFilename))
-	{
-		std::ifstream signalsFile(signalsFilename);
-		std::string str;
-		// 跳过标题行
-		std::getline(signalsFile, str);
-		while (std::getline(signalsFile, str))
-		{
-			_sig_logs << str << "\n";
-		}
-	}
+	/*
+	 *	增量回测的基础数据目录可能就是本次回测的输出目录
+	 *	所以要先把之前的结果全部读出来，再打开输出文件，最后把之前的结果写入新的文件
+	 */
+	std::string trades, closes, funds, positions, signals;
+	BtOutputTable::read_csv_rows((folder + "trades").c_str(), trades);
+	BtOutputTable::read_csv_rows((folder + "closes").c_str(), closes);
+	BtOutputTable::read_csv_rows((folder + "funds").c_str(), funds);
+	BtOutputTable::read_csv_rows((folder + "positions").c_str(), positions);
+	BtOutputTable::read_csv_rows((folder + "signals").c_str(), signals);
+
+	open_outputs();
+	_trade_logs.append_csv_rows(trades);
+	_close_logs.append_csv_rows(closes);
+	_fund_logs.append_csv_rows(funds);
+	_pos_logs.append_csv_rows(positions);
+	_sig_logs.append_csv_rows(signals);
 
 	std::string strategyDumpFilename = folder + fmtutil::format("{}.json", incremental_backtest_base);
 	if (boost::filesystem::exists(strategyDumpFilename))
@@ -563,7 +529,7 @@ void CtaMocker::load_incremental_data(const char* incremental_backtest_base)
 						curPosDetail._max_profit = positionDetailEntry["maxprofit"].GetDouble();
 						curPosDetail._max_loss = positionDetailEntry["maxloss"].GetDouble();
 						strcpy(curPosDetail._opentag, positionDetailEntry["opentag"].GetString());
-						pInfo._details.push_back(curPosDetail);
+						pInfo._details.emplace_back(curPosDetail);
 					}
 				}
 			}
@@ -623,6 +589,8 @@ void CtaMocker::load_incremental_data(const char* incremental_backtest_base)
 //IDataSink
 void CtaMocker::handle_init()
 {
+	open_outputs();
+
 	this->on_init();
 }
 
@@ -678,7 +646,7 @@ void CtaMocker::handle_replay_done()
 
 	dump_chartdata();
 
-	if (_has_hook && _hook_valid)
+	if (_has_hook && _hook_valid && _coroutine == NULL)
 	{
 		WTSLogger::log_dyn_raw("strategy", _name.c_str(), LL_DEBUG, "Replay done, notify control thread");
 		while(_wait_calc)
@@ -980,24 +948,10 @@ void CtaMocker::update_dyn_profit(const char* stdCode, double price)
 		}
 		else
 		{
+			//明细的统计值读取的时候才计算，这里只用汇总值算浮盈
 			WTSCommodityInfo* commInfo = _replayer->get_commodity_info(stdCode);
-			double dynprofit = 0;
-			for (auto pit = pInfo._details.begin(); pit != pInfo._details.end(); pit++)
-			{
-				DetailInfo& dInfo = *pit;
-				dInfo._profit = dInfo._volume*(price - dInfo._price)*commInfo->getVolScale()*(dInfo._long ? 1 : -1);
-				if (dInfo._profit > 0)
-					dInfo._max_profit = max(dInfo._profit, dInfo._max_profit);
-				else if (dInfo._profit < 0)
-					dInfo._max_loss = min(dInfo._profit, dInfo._max_loss);
-
-				dInfo._max_price = std::max(dInfo._max_price, price);
-				dInfo._min_price = std::min(dInfo._min_price, price);
-
-				dynprofit += dInfo._profit;
-			}
-
-			pInfo._dynprofit = dynprofit;
+			pInfo._details.update(price, commInfo->getVolScale());
+			pInfo._dynprofit = pInfo._details.dyn_profit();
 		}
 	}
 
@@ -1059,6 +1013,16 @@ bool CtaMocker::step_calc()
 		return false;
 	}
 
+	//协程模式，在调用线程里推进回放，直到下一个挂起点
+	if (_coroutine)
+	{
+		if (_coroutine->resume())
+			return true;
+
+		_hook_valid = false;
+		return false;
+	}
+
 	//总共分为4个状态
 	//0-初始状态，1-oncalc，2-oncalc结束，3-oncalcdone
 	//所以，如果出于0/2，则说明没有在执行中，需要notify
@@ -1132,7 +1096,8 @@ bool CtaMocker::on_schedule(uint32_t curDate, uint32_t curTime)
 			if (offTime <= sInfo->getCloseTime(true))
 			{
 				_condtions.clear();
-				if(_has_hook && _hook_valid)
+				//协程模式下，调用方resume的时候就已经放行了，不需要再等
+				if(_has_hook && _hook_valid && _coroutine == NULL)
 				{
 					WTSLogger::log_dyn("strategy", _name.c_str(), LL_DEBUG, "Waiting for resume notify");
 					StdUniqueLock lock(_mtx_calc);
@@ -1145,15 +1110,22 @@ bool CtaMocker::on_schedule(uint32_t curDate, uint32_t curTime)
 
 				if (_has_hook && _hook_valid)
 				{
-					WTSLogger::log_dyn("strategy", _name.c_str(), LL_DEBUG, "Calc done, notify control thread");
-					while (_cur_step==1)
-						_cond_calc.notify_all();
-
-					WTSLogger::log_dyn("strategy", _name.c_str(), LL_DEBUG, "Waiting for resume notify");
-					StdUniqueLock lock(_mtx_calc);
-					_cond_calc.wait(_mtx_calc);
-					WTSLogger::log_dyn("strategy", _name.c_str(), LL_DEBUG, "Calc resumed");
-					_cur_step = 3;
+					if (_coroutine)
+					{
+						_coroutine->yield();
+					}
+					else
+					{
+						WTSLogger::log_dyn("strategy", _name.c_str(), LL_DEBUG, "Calc done, notify control thread");
+						while (_cur_step == 1)
+							_cond_calc.notify_all();
+
+						WTSLogger::log_dyn("strategy", _name.c_str(), LL_DEBUG, "Waiting for resume notify");
+						StdUniqueLock lock(_mtx_calc);
+						_cond_calc.wait(_mtx_calc);
+						WTSLogger::log_dyn("strategy", _name.c_str(), LL_DEBUG, "Calc resumed");
+						_cur_step = 3;
+					}
 				}
 
 				if(_has_hook)
@@ -1192,9 +1164,16 @@ bool CtaMocker::on_schedule(uint32_t curDate, uint32_t curTime)
 
 				if (_has_hook && _hook_valid)
 				{
-					WTSLogger::log_dyn("strategy", _name.c_str(), LL_DEBUG, "Calc done, notify control thread");
-					while(_cur_step == 3)
-						_cond_calc.notify_all();
+					if (_coroutine)
+					{
+						_coroutine->yield();
+					}
+					else
+					{
+						WTSLogger::log_dyn("strategy", _name.c_str(), LL_DEBUG, "Calc done, notify control thread");
+						while (_cur_step == 3)
+							_cond_calc.notify_all();
+					}
 				}
 			}
 			else
@@ -1279,13 +1258,13 @@ void CtaMocker::on_session_end(uint32_t curTDate)
 		if(decimal::eq(pInfo._volume, 0.0))
 			continue;
 
-		_pos_logs << fmt::format("{},{},{},{:.2f},{:.2f}\n", curDate, stdCode,
-			pInfo._volume, pInfo._closeprofit, pInfo._dynprofit);
+		_pos_logs << curDate << stdCode << pInfo._volume << pInfo._closeprofit << pInfo._dynprofit;
+		_pos_logs.end_row();
 	}
 
-	_fund_logs << fmt::format("{},{:.2f},{:.2f},{:.2f},{:.2f}\n", curDate,
-		_fund_info._total_profit, _fund_info._total_dynprofit,
-		_fund_info._total_profit + _fund_info._total_dynprofit - _fund_info._total_fees, _fund_info._total_fees);
+	_fund_logs << curDate << _fund_info._total_profit << _fund_info._total_dynprofit
+		<< _fund_info._total_profit + _fund_info._total_dynprofit - _fund_info._total_fees << _fund_info._total_fees;
+	_fund_logs.end_row();
 	
 	if (_notifier)
 		_notifier->notifyFund("BT_FUND", curDate, _fund_info._total_profit, _fund_info._total_dynprofit,
@@ -1688,13 +1667,13 @@ void CtaMocker::do_set_position(const char* stdCode, double qty, double price /*
 		pInfo._volume = qty;
 		if (decimal::eq(pInfo._volume, 0))
 			pInfo._dynprofit = 0;
-		uint32_t count = 0;
-		for (auto it = pInfo._details.begin(); it != pInfo._details.end(); it++)
+		while (!pInfo._details.empty())
 		{
-			DetailInfo& dInfo = *it;
+			//平仓从队头开始，明细出队以后还要写日志，所以这里拷贝一份
+			DetailInfo dInfo = pInfo._details.front();
 			double maxQty = min(dInfo._volume, left);
 			if (decimal::eq(maxQty, 0))
-				continue;
+				break;
 
 			double maxProf = dInfo._max_profit * maxQty / dInfo._volume;
 			double maxLoss = dInfo._max_loss * maxQty / dInfo._volume;
@@ -1702,8 +1681,8 @@ void CtaMocker::do_set_position(const char* stdCode, double qty, double price /*
 			dInfo._volume -= maxQty;
 			left -= maxQty;
 
-			if (decimal::eq(dInfo._volume, 0))
-				count++;
+			//平完的明细直接出队
+			pInfo._details.reduce_front(maxQty);
 
 			double profit = (trdPx - dInfo._price) * maxQty * commInfo->getVolScale();
 			if (!dInfo._long)
@@ -1726,14 +1705,6 @@ void CtaMocker::do_set_position(const char* stdCode, double qty, double price /*
 				break;
 		}
 
-		//需要清理掉已经平仓完的明细
-		while (count > 0)
-		{
-			auto it = pInfo._details.begin();
-			pInfo._details.erase(it);
-			count--;
-		}
-
 		//最后,如果还有剩余的,则需要反手了
 		if (left > 0)
 		{
@@ -1942,7 +1913,7 @@ uint64_t CtaMocker::stra_get_first_entertime(const char* stdCode)
 	if (pInfo._details.empty())
 		return 0;
 
-	return pInfo._details[0]._opentime;
+	return pInfo._details.front()._opentime;
 }
 
 uint64_t CtaMocker::stra_get_last_entertime(const char* stdCode)
@@ -1955,7 +1926,7 @@ uint64_t CtaMocker::stra_get_last_entertime(const char* stdCode)
 	if (pInfo._details.empty())
 		return 0;
 
-	return pInfo._details[pInfo._details.size() - 1]._opentime;
+	return pInfo._details.back()._opentime;
 }
 
 const char* CtaMocker::stra_get_last_entertag(const char* stdCode)
@@ -1968,7 +1939,7 @@ const char* CtaMocker::stra_get_last_entertag(const char* stdCode)
 	if (pInfo._details.empty())
 		return "";
 
-	return pInfo._details[pInfo._details.size() - 1]._opentag;
+	return pInfo._details.back()._opentag;
 }
 
 uint64_t CtaMocker::stra_get_last_exittime(const char* stdCode)
@@ -1991,7 +1962,7 @@ double CtaMocker::stra_get_last_enterprice(const char* stdCode)
 	if (pInfo._details.empty())
 		return 0;
 
-	return pInfo._details[pInfo._details.size() - 1]._price;
+	return pInfo._details.back()._price;
 }
 
 double CtaMocker::stra_get_position(const char* stdCode, bool bOnlyValid /* = false */, const char* userTag /* = "" */)
@@ -2026,14 +1997,9 @@ double CtaMocker::stra_get_position(const char* stdCode, bool bOnlyValid /* = fa
 	}
 	else
 	{
-		for (auto it = pInfo._details.begin(); it != pInfo._details.end(); it++)
-		{
-			const DetailInfo& dInfo = (*it);
-			if (strcmp(dInfo._opentag, userTag) != 0)
-				continue;
-
-			return dInfo._volume;
-		}
+		const DetailInfo* dInfo = pInfo._details.find(userTag);
+		if (dInfo != NULL)
+			return dInfo->_volume;
 	}
 
 	return 0;
@@ -2049,14 +2015,7 @@ double CtaMocker::stra_get_position_avgpx(const char* stdCode)
 	if (pInfo._volume == 0)
 		return 0.0;
 
-	double amount = 0.0;
-	for (auto dit = pInfo._details.begin(); dit != pInfo._details.end(); dit++)
-	{
-		const DetailInfo& dInfo = *dit;
-		amount += dInfo._price*dInfo._volume;
-	}
-
-	return amount / pInfo._volume;
+	return pInfo._details.cost() / pInfo._volume;
 }
 
 double CtaMocker::stra_get_position_profit(const char* stdCode)
@@ -2076,14 +2035,9 @@ uint64_t CtaMocker::stra_get_detail_entertime(const char* stdCode, const char* u
 		return 0;
 
 	const PosInfo& pInfo = it->second;
-	for (auto it = pInfo._details.begin(); it != pInfo._details.end(); it++)
-	{
-		const DetailInfo& dInfo = (*it);
-		if (strcmp(dInfo._opentag, userTag) != 0)
-			continue;
-
-		return dInfo._opentime;
-	}
+	const DetailInfo* dInfo = pInfo._details.find(userTag);
+	if (dInfo != NULL)
+		return dInfo->_opentime;
 
 	return 0;
 }
@@ -2095,14 +2049,9 @@ double CtaMocker::stra_get_detail_cost(const char* stdCode, const char* userTag)
 		return 0;
 
 	const PosInfo& pInfo = it->second;
-	for (auto it = pInfo._details.begin(); it != pInfo._details.end(); it++)
-	{
-		const DetailInfo& dInfo = (*it);
-		if (strcmp(dInfo._opentag, userTag) != 0)
-			continue;
-
-		return dInfo._price;
-	}
+	const DetailInfo* dInfo = pInfo._details.find(userTag);
+	if (dInfo != NULL)
+		return dInfo->_price;
 
 	return 0.0;
 }
@@ -2114,24 +2063,21 @@ double CtaMocker::stra_get_detail_profit(const char* stdCode, const char* userTa
 		return 0;
 
 	const PosInfo& pInfo = it->second;
-	for (auto it = pInfo._details.begin(); it != pInfo._details.end(); it++)
+	const DetailInfo* dInfo = pInfo._details.find(userTag);
+	if (dInfo != NULL)
 	{
-		const DetailInfo& dInfo = (*it);
-		if (strcmp(dInfo._opentag, userTag) != 0)
-			continue;
-
 		switch (flag)
 		{
 		case 0:
-			return dInfo._profit;
+			return dInfo->_profit;
 		case 1:
-			return dInfo._max_profit;
+			return dInfo->_max_profit;
 		case -1:
-			return dInfo._max_loss;
+			return dInfo->_max_loss;
 		case 2:
-			return dInfo._max_price;
+			return dInfo->_max_price;
 		case -2:
-			return dInfo._min_price;
+			return dInfo->_min_price;
 		}
 	}
 
@@ -12,6 +12,7 @@
 #include <atomic>
 #include <unordered_map>
 #include "HisDataReplayer.h"
+#include "BtOutputTable.h"
 
 #include "../Includes/FasterDefs.h"
 #include "../Includes/ICtaStraCtx.h"
@@ -22,6 +23,7 @@
 #include "../Share/DLLHelper.hpp"
 #include "../Share/StdUtils.hpp"
 #include "../Share/fmtlib.h"
+#include "../Share/PosDetailQueue.hpp"
 
 NS_WTP_BEGIN
 class EventNotifier;
@@ -31,6 +33,7 @@ USING_NS_WTP;
 
 class HisDataReplayer;
 class CtaStrategy;
+class BtCoroutine;
 
 const char COND_ACTION_OL = 0;	//开多
 const char COND_ACTION_CL = 1;	//平多
@@ -70,6 +73,7 @@ public:
 	virtual ~CtaMocker();
 
 private:
+	void	open_outputs();
 	void	dump_outputs();
 	void	dump_stradata();
 	void	dump_chartdata();
@@ -94,6 +98,12 @@ public:
 	void	enable_hook(bool bEnabled = true);
 	bool	step_calc();
 
+	/*
+	 *	设置单步推进用的协程
+	 *	设置以后step_calc直接在调用线程里推进回放，不再通过条件变量和回放线程交互
+	 */
+	inline void	set_coroutine(BtCoroutine* co) { _coroutine = co; }
+
 public:
 	//////////////////////////////////////////////////////////////////////////
 	//IDataSink
@@ -298,7 +308,7 @@ protected:
 		uint64_t	_last_exittime;
 		double		_frozen;
 
-		std::vector<DetailInfo> _details;
+		PosDetailQueue<DetailInfo> _details;	//持仓明细，按开仓顺序排列
 
 		_PosInfo()
 		{
@@ -337,11 +347,12 @@ protected:
 	typedef wt_hashmap<std::string, SigInfo>	SignalMap;
 	SignalMap		_sig_map;
 
-	std::stringstream	_trade_logs;
-	std::stringstream	_close_logs;
-	std::stringstream	_fund_logs;
-	std::stringstream	_sig_logs;
-	std::stringstream	_pos_logs;
+	//回测结果表，回测过程中逐行写入文件
+	BtOutputTable		_trade_logs;
+	BtOutputTable		_close_logs;
+	BtOutputTable		_fund_logs;
+	BtOutputTable		_sig_logs;
+	BtOutputTable		_pos_logs;
 	std::stringstream	_index_logs;
 	std::stringstream	_mark_logs;
 
@@ -399,6 +410,7 @@ protected:
 	bool			_has_hook;		//这是人为控制是否启用钩子
 	bool			_hook_valid;	//这是根据是否是异步回测模式而确定钩子是否可用
 	std::atomic<uint32_t>		_cur_step;	//临时变量，用于控制状态
+	BtCoroutine*	_coroutine;		//单步推进的协程，为空则用回放线程
 
 	bool			_in_backtest;
 	bool			_wait_calc;
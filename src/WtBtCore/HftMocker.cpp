@@ -9,6 +9,7 @@
  */
 #include "HftMocker.h"
 #include "WtHelper.h"
+#include "BtCoroutine.h"
 
 #include <stdarg.h>
 
@@ -125,12 +126,19 @@ HftMocker::HftMocker(HisDataReplayer* replayer, const char* name)
 	, _has_hook(false)
 	, _hook_valid(true)
 	, _resumed(false)
+	, _coroutine(NULL)
 {
 	_commodities = CommodityMap::create();
 
 	_context_id = makeHftCtxId();
 
 	_ticks = TickCache::create();
+
+	_trade_logs.setup("code,time,direct,action,price,qty,fee,usertag", "sussgggs", 1);
+	_close_logs.setup("code,direct,opentime,openprice,closetime,closeprice,qty,profit,maxprofit,maxloss,totalprofit,entertag,exittag", "ssuguggggggss", 4);
+	_fund_logs.setup("date,closeprofit,positionprofit,dynbalance,fee", "uffff", 0);
+	_sig_logs.setup("time, action, position, price", "ssgg");
+	_pos_logs.setup("date,code,volume,closeprofit,dynprofit", "usrff", 0);
 }
 
 
@@ -277,6 +285,8 @@ void HftMocker::handle_bar_close(const char* stdCode, const char* period, uint32
 
 void HftMocker::handle_init()
 {
+	open_outputs();
+
 	on_init();
 	on_channel_ready();
 }
@@ -328,6 +338,14 @@ void HftMocker::step_tick()
 	if (!_has_hook)
 		return;
 
+	//协程模式，在调用线程里推进回放，直到下一个挂起点
+	if (_coroutine)
+	{
+		if (!_coroutine->resume())
+			_hook_valid = false;
+		return;
+	}
+
 	WTSLogger::log_dyn("strategy", _name.c_str(), LL_DEBUG, "Notify calc thread, wait for calc done");
 	while (!_resumed)
 		_cond_calc.notify_all();
@@ -356,7 +374,7 @@ void HftMocker::on_tick(const char* stdCode, WTSTickData* newTick)
 	//如果没开启同tick撮合，则先处理订单，再触发策略的ontick
 	if (_match_this_tick)
 	{
-		if (_has_hook && _hook_valid)
+		if (_has_hook && _hook_valid && _coroutine == NULL)
 		{
 			WTSLogger::log_dyn("strategy", _name.c_str(), LL_DEBUG, "Waiting for resume notify");
 			StdUniqueLock lock(_mtx_calc);
@@ -406,7 +424,7 @@ void HftMocker::on_tick(const char* stdCode, WTSTickData* newTick)
 			}
 		}
 
-		if (_has_hook && _hook_valid)
+		if (_has_hook && _hook_valid && _coroutine == NULL)
 		{
 			WTSLogger::log_dyn("strategy", _name.c_str(), LL_DEBUG, "Waiting for resume notify");
 			StdUniqueLock lock(_mtx_calc);
@@ -422,9 +440,16 @@ void HftMocker::on_tick(const char* stdCode, WTSTickData* newTick)
 
 	if (_has_hook && _hook_valid)
 	{
-		WTSLogger::log_dyn("strategy", _name.c_str(), LL_DEBUG, "Calc done, notify control thread");
-		while (_resumed)
-			_cond_calc.notify_all();
+		if (_coroutine)
+		{
+			_coroutine->yield();
+		}
+		else
+		{
+			WTSLogger::log_dyn("strategy", _name.c_str(), LL_DEBUG, "Calc done, notify control thread");
+			while (_resumed)
+				_cond_calc.notify_all();
+		}
 	}
 }
 
@@ -517,13 +542,13 @@ void HftMocker::on_session_end(uint32_t curTDate)
 		if (decimal::eq(pInfo._volume, 0.0))
 			continue;
 
-		_pos_logs << fmt::format("{},{},{},{:.2f},{:.2f}\n", curTDate, stdCode,
-			pInfo._volume, pInfo._closeprofit, pInfo._dynprofit);
+		_pos_logs << curTDate << stdCode << pInfo._volume << pInfo._closeprofit << pInfo._dynprofit;
+		_pos_logs.end_row();
 	}
 
-	_fund_logs << fmt::format("{},{:.2f},{:.2f},{:.2f},{:.2f}\n", curTDate,
-		_fund_info._total_profit, _fund_info._total_dynprofit,
-		_fund_info._total_profit + _fund_info._total_dynprofit - _fund_info._total_fees, _fund_info._total_fees);
+	_fund_logs << curTDate << _fund_info._total_profit << _fund_info._total_dynprofit
+		<< _fund_info._total_profit + _fund_info._total_dynprofit - _fund_info._total_fees << _fund_info._total_fees;
+	_fund_logs.end_row();
 
 	if (_strategy)
 		_strategy->on_session_end(this, curTDate);
@@ -570,6 +595,42 @@ bool HftMocker::stra_cancel(uint32_t localid)
 	return true;
 }
 
+uint32_t HftMocker::stra_modify(uint32_t localid, double price, double qty)
+{
+	if (decimal::le(qty, 0))
+	{
+		log_error("Modify error: qty {} <= 0", qty);
+		return 0;
+	}
+
+	{
+		StdLocker<StdRecurMutex> lock(_mtx_ords);
+		if (_orders.find(localid) == _orders.end())
+			return 0;
+	}
+
+	//回测撮合直接改单, 订单号保持不变
+	postTask([this, localid, price, qty](){
+		OrderInfoPtr ordInfo = NULL;
+		{
+			StdLocker<StdRecurMutex> lock(_mtx_ords);
+			auto it = _orders.find(localid);
+			if (it == _orders.end())
+				return;
+
+			ordInfo = it->second;
+		}
+
+		ordInfo->_total += qty - ordInfo->_left;
+		ordInfo->_left = qty;
+		ordInfo->_price = price;
+
+		on_order(localid, ordInfo->_code, ordInfo->_isBuy, ordInfo->_total, ordInfo->_left, ordInfo->_price, false, ordInfo->_usertag);
+	});
+
+	return localid;
+}
+
 OrderIDs HftMocker::stra_cancel(const char* stdCode, bool isBuy, double qty /* = 0 */)
 {
 	OrderIDs ret;
@@ -769,8 +830,9 @@ bool HftMocker::procOrder(uint32_t localid)
 
 		double curPos = stra_get_position(ordInfo->_code);
 
-		_sig_logs << _replayer->get_date() << "." << _replayer->get_raw_time() << "." << _replayer->get_secs() << ","
-			<< (ordInfo->_isBuy ? "+" : "-") << curQty << "," << curPos << "," << curPx << std::endl;
+		_sig_logs << fmt::format("{}.{}.{}", _replayer->get_date(), _replayer->get_raw_time(), _replayer->get_secs())
+			<< fmt::format("{}{}", ordInfo->_isBuy ? "+" : "-", curQty) << curPos << curPx;
+		_sig_logs.end_row();
 	}
 
 	//if(ordInfo->_left == 0)
@@ -892,6 +954,16 @@ WTSTickData* HftMocker::stra_get_last_tick(const char* stdCode)
 	return _replayer->get_last_tick(stdCode);
 }
 
+const WTSOptGreeksStruct* HftMocker::stra_get_greeks(const char* stdCode)
+{
+	return _replayer->get_greeks(stdCode);
+}
+
+const WTSOptGreeksStruct* HftMocker::stra_get_greeks_chain(const char* underlying, uint32_t& count)
+{
+	return _replayer->get_greeks_chain(underlying, count);
+}
+
 double HftMocker::stra_get_position(const char* stdCode, bool bOnlyValid/* = false*/, int flag/* = 3*/)
 {
 	const PosInfo& pInfo = _pos_map[stdCode];
@@ -1017,39 +1089,38 @@ void HftMocker::stra_save_user_data(const char* key, const char* val)
 	_ud_modified = true;
 }
 
-void HftMocker::dump_outputs()
+void HftMocker::open_outputs()
 {
+	if (_trade_logs.is_opened())
+		return;
+
 	std::string folder = WtHelper::getOutputDir();
 	folder += _name;
 	folder += "/";
 	boost::filesystem::create_directories(folder.c_str());
 
-	std::string filename = folder + "trades.csv";
-	std::string content = "code,time,direct,action,price,qty,fee,usertag\n";
-	content += _trade_logs.str();
-	StdFile::write_file_content(filename.c_str(), (void*)content.c_str(), content.size());
-
-	filename = folder + "closes.csv";
-	content = "code,direct,opentime,openprice,closetime,closeprice,qty,profit,maxprofit,maxloss,totalprofit,entertag,exittag\n";
-	content += _close_logs.str();
-	StdFile::write_file_content(filename.c_str(), (void*)content.c_str(), content.size());
-
-
-	filename = folder + "funds.csv";
-	content = "date,closeprofit,positionprofit,dynbalance,fee\n";
-	content += _fund_logs.str();
-	StdFile::write_file_content(filename.c_str(), (void*)content.c_str(), content.size());
+	bool bBinary = _replayer->is_binary_output();
+	_trade_logs.open((folder + "trades").c_str(), bBinary);
+	_close_logs.open((folder + "closes").c_str(), bBinary);
+	_fund_logs.open((folder + "funds").c_str(), bBinary);
+	_sig_logs.open((folder + "signals").c_str(), bBinary);
+	_pos_logs.open((folder + "positions").c_str(), bBinary);
+}
 
+void HftMocker::dump_outputs()
+{
+	open_outputs();
 
-	filename = folder + "signals.csv";
-	content = "time, action, position, price\n";
-	content += _sig_logs.str();
-	StdFile::write_file_content(filename.c_str(), (void*)content.c_str(), content.size());
+	_trade_logs.close();
+	_close_logs.close();
+	_fund_logs.close();
+	_sig_logs.close();
+	_pos_logs.close();
 
-	filename = folder + "positions.csv";
-	content = "date,code,volume,closeprofit,dynprofit\n";
-	if (!_pos_logs.str().empty()) content += _pos_logs.str();
-	StdFile::write_file_content(filename.c_str(), (void*)content.c_str(), content.size());
+	std::string folder = WtHelper::getOutputDir();
+	folder += _name;
+	folder += "/";
+	std::string filename;
 
 	{
 		rj::Document root(rj::kObjectType);
@@ -1073,16 +1144,18 @@ void HftMocker::dump_outputs()
 
 void HftMocker::log_trade(const char* stdCode, bool isLong, bool isOpen, uint64_t curTime, double price, double qty, double fee, const char* userTag/* = ""*/)
 {
-	_trade_logs << stdCode << "," << curTime << "," << (isLong ? "LONG" : "SHORT") << "," << (isOpen ? "OPEN" : "CLOSE")
-		<< "," << price << "," << qty << "," << fee << "," << userTag << "\n";
+	_trade_logs << stdCode << curTime << (isLong ? "LONG" : "SHORT") << (isOpen ? "OPEN" : "CLOSE")
+		<< price << qty << fee << userTag;
+	_trade_logs.end_row();
 }
 
 void HftMocker::log_close(const char* stdCode, bool isLong, uint64_t openTime, double openpx, uint64_t closeTime, double closepx, double qty, double profit, double maxprofit, double maxloss,
 	double totalprofit /* = 0 */, const char* enterTag/* = ""*/, const char* exitTag/* = ""*/)
 {
-	_close_logs << stdCode << "," << (isLong ? "LONG" : "SHORT") << "," << openTime << "," << openpx
-		<< "," << closeTime << "," << closepx << "," << qty << "," << profit << "," << maxprofit << "," << maxloss << ","
-		<< totalprofit << "," << enterTag << "," << exitTag << "\n";
+	_close_logs << stdCode << (isLong ? "LONG" : "SHORT") << openTime << openpx
+		<< closeTime << closepx << qty << profit << maxprofit << maxloss
+		<< totalprofit << enterTag << exitTag;
+	_close_logs.end_row();
 }
 
 void HftMocker::do_set_position(const char* stdCode, double qty, double price /* = 0.0 */, const char* userTag /*= ""*/)
@@ -12,6 +12,7 @@
 #include <sstream>
 
 #include "HisDataReplayer.h"
+#include "BtOutputTable.h"
 
 #include "../Includes/FasterDefs.h"
 #include "../Includes/IHftStraCtx.h"
@@ -22,6 +23,7 @@
 #include "../Share/fmtlib.h"
 
 class HisDataReplayer;
+class BtCoroutine;
 
 class HftMocker : public IDataSink, public IHftStraCtx
 {
@@ -97,6 +99,8 @@ public:
 
 	virtual OrderIDs stra_cancel(const char* stdCode, bool isBuy, double qty = 0) override;
 
+	virtual uint32_t stra_modify(uint32_t localid, double price, double qty) override;
+
 	virtual OrderIDs stra_buy(const char* stdCode, double price, double qty, const char* userTag, int flag = 0, bool bForceClose = false) override;
 
 	virtual OrderIDs stra_sell(const char* stdCode, double price, double qty, const char* userTag, int flag = 0, bool bForceClose = false) override;
@@ -115,6 +119,9 @@ public:
 
 	virtual WTSTickData* stra_get_last_tick(const char* stdCode) override;
 
+	virtual const WTSOptGreeksStruct* stra_get_greeks(const char* stdCode) override;
+	virtual const WTSOptGreeksStruct* stra_get_greeks_chain(const char* underlying, uint32_t& count) override;
+
 	/*
 	 *	获取分月合约代码
 	 */
@@ -168,6 +175,12 @@ public:
 	void	enable_hook(bool bEnabled = true);
 	void	step_tick();
 
+	/*
+	 *	设置单步推进用的协程
+	 *	设置以后step_tick直接在调用线程里推进回放，不再通过条件变量和回放线程交互
+	 */
+	inline void	set_coroutine(BtCoroutine* co) { _coroutine = co; }
+
 private:
 	typedef std::function<void()> Task;
 	void	postTask(Task task);
@@ -178,6 +191,7 @@ private:
 	void	do_set_position(const char* stdCode, double qty, double price = 0.0, const char* userTag = "");
 	void	update_dyn_profit(const char* stdCode, WTSTickData* newTick);
 
+	void	open_outputs();
 	void	dump_outputs();
 	inline void	log_trade(const char* stdCode, bool isLong, bool isOpen, uint64_t curTime, double price, double qty, double fee, const char* userTag);
 	inline void	log_close(const char* stdCode, bool isLong, uint64_t openTime, double openpx, uint64_t closeTime, double closepx, double qty,
@@ -306,11 +320,12 @@ private:
 	typedef wt_hashmap<std::string, PosInfo> PositionMap;
 	PositionMap		_pos_map;
 
-	std::stringstream	_trade_logs;
-	std::stringstream	_close_logs;
-	std::stringstream	_fund_logs;
-	std::stringstream	_sig_logs;
-	std::stringstream	_pos_logs;
+	//回测结果表，回测过程中逐行写入文件
+	BtOutputTable		_trade_logs;
+	BtOutputTable		_close_logs;
+	BtOutputTable		_fund_logs;
+	BtOutputTable		_sig_logs;
+	BtOutputTable		_pos_logs;
 
 	typedef struct _StraFundInfo
 	{
@@ -334,6 +349,7 @@ protected:
 	bool			_has_hook;		//这是人为控制是否启用钩子
 	bool			_hook_valid;	//这是根据是否是异步回测模式而确定钩子是否可用
 	std::atomic<bool>	_resumed;	//临时变量，用于控制状态
+	BtCoroutine*	_coroutine;		//单步推进的协程，为空则用回放线程
 
 	//tick订阅列表
 	wt_hashset<std::string> _tick_subs;
@@ -22,6 +22,7 @@
 #include "../Share/decimal.h"
 #include "../Share/StrUtil.hpp"
 #include "../Share/TimeUtils.hpp"
+#include "../Share/TradingCalendar.hpp"
 
 #include "../WTSTools/WTSLogger.h"
 #include "../WTSTools/WTSDataFactory.h"
@@ -157,6 +158,7 @@ HisDataReplayer::HisDataReplayer()
 	, _min_period("d")
 	, _cache_clear_days(0)
 	, _align_by_section(false)
+	, _bin_output(false)
 {
 }
 
@@ -225,6 +227,10 @@ bool HisDataReplayer::init(WTSVariant* cfg, EventNotifier* notifier /* = NULL */
 	_nosim_if_notrade = cfg->getBoolean("dont_simtick_if_notrade");
 	WTSLogger::info("nosim_if_notrade is {}", _nosim_if_notrade);
 
+	//回测结果输出格式，csv为默认格式，bin为列式二进制格式
+	_bin_output = wt_stricmp(cfg->getCString("output_format"), "bin") == 0;
+	WTSLogger::info("Backtest outputs will be saved as {}", _bin_output ? "binary columnar files" : "csv files");
+
 	//基础数据文件
 	WTSVariant* cfgBF = cfg->get("basefiles");
 	if (cfgBF->get("session"))
@@ -262,6 +268,13 @@ bool HisDataReplayer::init(WTSVariant* cfg, EventNotifier* notifier /* = NULL */
 		}
 	}
 
+	//交易日历的预计算区间，不配置的话默认为19900101-20501231
+	if (cfgBF->has("calendar"))
+	{
+		WTSVariant* cfgCal = cfgBF->get("calendar");
+		_bd_mgr.setCalendarRange(cfgCal->getUInt32("begin"), cfgCal->getUInt32("end"));
+	}
+
 	if (cfgBF->get("holiday"))
 		_bd_mgr.loadHolidays(cfgBF->getCString("holiday"));
 
@@ -284,6 +297,9 @@ bool HisDataReplayer::init(WTSVariant* cfg, EventNotifier* notifier /* = NULL */
 
 	loadFees(cfg->getCString("fees"));
 
+	if (_greeks.init(cfg->get("greeks"), &_bd_mgr))
+		WTSLogger::info("Option greeks service enabled, {} options in {} chains", _greeks.option_count(), _greeks.chain_count());
+
 	/*
 	 *	By Wesley @ 2021.12.20
 	 *	先从extloader加载除权因子
@@ -955,7 +971,7 @@ void HisDataReplayer::run_by_tasks(bool bNeedDump /* = false */)
 		{
 			bool fired = false;
 			//获取上一个交易日的日期
-			uint32_t preTDate = TimeUtils::getNextDate(_cur_tdate, -1);
+			uint32_t preTDate = _bd_mgr.getPrevTDate(_task->_trdtpl, _cur_tdate, 1, true);
 			if (_cur_time == endtime)
 			{
 				if (!_bd_mgr.isHoliday(_task->_trdtpl, _cur_date, true))
@@ -963,14 +979,9 @@ void HisDataReplayer::run_by_tasks(bool bNeedDump /* = false */)
 					uint32_t weekDay = TimeUtils::getWeekDay(_cur_date);
 
 
-					bool bHasHoliday = false;
-					uint32_t days = 1;
-					while (_bd_mgr.isHoliday(_task->_trdtpl, preTDate, true))
-					{
-						bHasHoliday = true;
-						preTDate = TimeUtils::getNextDate(preTDate, -1);
-						days++;
-					}
+					//days是两个交易日之间的自然日数
+					uint32_t days = (uint32_t)(TradingCalendar::date_to_days(_cur_tdate) - TradingCalendar::date_to_days(preTDate));
+					bool bHasHoliday = (days > 1);
 					uint32_t preWD = TimeUtils::getWeekDay(preTDate);
 
 					switch (_task->_period)
@@ -1196,8 +1207,8 @@ void HisDataReplayer::run_by_tasks(bool bNeedDump /* = false */)
 				//是否到了一个新的小节
 				bool bNewSec = (nextDMins - dayMins > _task->_time) && !bNewDay;
 
-				while (bNewSec && _bd_mgr.isHoliday(_task->_trdtpl, _cur_date, true))
-					_cur_date = TimeUtils::getNextDate(_cur_date);
+				if (bNewSec && _bd_mgr.isHoliday(_task->_trdtpl, _cur_date, true))
+					_cur_date = _bd_mgr.getNextTDate(_task->_trdtpl, _cur_date, 1, true);
 
 				_cur_time = newTime;
 			}
@@ -1843,6 +1854,7 @@ uint64_t HisDataReplayer::replayHftDatasByDay(uint32_t curTDate)
 				update_price(stdCode, nextTick.price);
 				WTSTickData* newTick = WTSTickData::create(nextTick);
 				newTick->setCode(stdCode);
+				_greeks.on_tick(stdCode, newTick);
 				_listener->handle_tick(stdCode, newTick, 0);
 				newTick->release();
 				
@@ -1957,6 +1969,7 @@ bool HisDataReplayer::replayHftDatas(uint64_t stime, uint64_t etime)
 				update_price(stdCode, nextItem.price);
 				WTSTickData* newData = WTSTickData::create(nextItem);
 				newData->setCode(stdCode);
+				_greeks.on_tick(stdCode, newData);
 				_listener->handle_tick(stdCode, newData, 0);
 				newData->release();
 
@@ -2100,48 +2113,8 @@ void HisDataReplayer::onMinuteEnd(uint32_t uDate, uint32_t uTime, uint32_t endTD
 		_listener->handle_schedule(uDate, uTime);
 }
 
-WTSKlineSlice* HisDataReplayer::get_kline_slice(const char* stdCode, const char* period, uint32_t count, uint32_t times /* = 1 */, bool isMain /* = false */)
+bool HisDataReplayer::cacheBarsByKey(const std::string& key, const char* stdCode, const char* period, uint32_t times)
 {
-	thread_local static char key[64] = { 0 };
-	fmtutil::format_to(key, "{}#{}#{}", stdCode, period, times);
-
-	if (isMain)
-	{
-		_main_key = key;
-		_main_period = fmt::format("{}#{}", period, times);
-	}
-
-	//if(!_tick_enabled)
-	//不做判断,主要为了防止没有tick数据,而采用第二方案
-	{
-		if(_ticker_keys.find(stdCode) == _ticker_keys.end())
-			_ticker_keys[stdCode] = key;
-		else
-		{
-			std::string oldKey = _ticker_keys[stdCode];
-			oldKey = oldKey.substr(strlen(stdCode) + 1);
-			if (strcmp(period, "m") == 0 && oldKey.at(0) == 'd')
-			{
-				_ticker_keys[stdCode] = key;
-				_min_period = period;
-			}
-			else if (oldKey.at(0) == period[0] && times < strtoul(oldKey.substr(2).c_str(), NULL, 10))
-			{
-				_ticker_keys[stdCode] = key;
-				_min_period = period;
-			}
-		}
-
-		auto len = strlen(stdCode);
-		char lastCh = stdCode[len - 1];
-		if(lastCh == SUFFIX_HFQ || lastCh == SUFFIX_QFQ)
-		{
-			//如果是复权数据，则要把原始数据放到需要的列表中，最后再做检查
-			std::string tickCode(stdCode, len - 1);
-			_unsubbed_in_need.insert(tickCode);
-		}
-	}
-
 	WTSKlinePeriod kp;
 	uint32_t realTimes = times;
 	uint32_t baseTimes = 1;
@@ -2161,8 +2134,6 @@ WTSKlineSlice* HisDataReplayer::get_kline_slice(const char* stdCode, const char*
 	else
 		kp = KP_DAY;
 
-	bool isDay = kp == KP_DAY;
-
 	auto it = _bars_cache.find(key);
 	bool bHasHisData = false;
 	bool bHasCache = (it != _bars_cache.end());
@@ -2229,16 +2200,15 @@ WTSKlineSlice* HisDataReplayer::get_kline_slice(const char* stdCode, const char*
 	}
 
 	if (!bHasHisData)
-		return NULL;
+		return false;
 
 	WTSSessionInfo* sInfo = get_session_info(stdCode, true);
 	if(sInfo == NULL)
 	{
 		WTSLogger::error("Cannot find corresponding session of {}", stdCode);
-		return NULL;
+		return false;
 	}
 
-	bool isClosed = (sInfo->offsetTime(_cur_time, true) >= sInfo->getCloseTime(true));
 	if (realTimes != 1 && !bHasCache)
 	{	
 		std::string rawKey = StrUtil::printf("%s#%s#%u", stdCode, period, baseTimes);
@@ -2265,10 +2235,67 @@ WTSKlineSlice* HisDataReplayer::get_kline_slice(const char* stdCode, const char*
 		else
 		{
 			WTSLogger::error("Resampling {}{} back kline of {} failed", period, times, stdCode);
-			return NULL;
+			return false;
 		}
 	}
 
+	return true;
+}
+
+WTSKlineSlice* HisDataReplayer::get_kline_slice(const char* stdCode, const char* period, uint32_t count, uint32_t times /* = 1 */, bool isMain /* = false */)
+{
+	thread_local static char key[64] = { 0 };
+	fmtutil::format_to(key, "{}#{}#{}", stdCode, period, times);
+
+	if (isMain)
+	{
+		_main_key = key;
+		_main_period = fmt::format("{}#{}", period, times);
+	}
+
+	//if(!_tick_enabled)
+	//不做判断,主要为了防止没有tick数据,而采用第二方案
+	{
+		if(_ticker_keys.find(stdCode) == _ticker_keys.end())
+			_ticker_keys[stdCode] = key;
+		else
+		{
+			std::string oldKey = _ticker_keys[stdCode];
+			oldKey = oldKey.substr(strlen(stdCode) + 1);
+			if (strcmp(period, "m") == 0 && oldKey.at(0) == 'd')
+			{
+				_ticker_keys[stdCode] = key;
+				_min_period = period;
+			}
+			else if (oldKey.at(0) == period[0] && times < strtoul(oldKey.substr(2).c_str(), NULL, 10))
+			{
+				_ticker_keys[stdCode] = key;
+				_min_period = period;
+			}
+		}
+
+		auto len = strlen(stdCode);
+		char lastCh = stdCode[len - 1];
+		if(lastCh == SUFFIX_HFQ || lastCh == SUFFIX_QFQ)
+		{
+			//如果是复权数据，则要把原始数据放到需要的列表中，最后再做检查
+			std::string tickCode(stdCode, len - 1);
+			_unsubbed_in_need.insert(tickCode);
+		}
+	}
+
+	WTSKlinePeriod kp = KP_DAY;
+	if (strcmp(period, "m") == 0)
+		kp = (times % 5 == 0) ? KP_Minute5 : KP_Minute1;
+
+	bool isDay = kp == KP_DAY;
+
+	if (!cacheBarsByKey(key, stdCode, period, times))
+		return NULL;
+
+	WTSSessionInfo* sInfo = get_session_info(stdCode, true);
+	bool isClosed = (sInfo->offsetTime(_cur_time, true) >= sInfo->getCloseTime(true));
+
 	BarsListPtr& kBlkPair = _bars_cache[key];
 	if(kBlkPair == NULL)
 	{
@@ -2408,6 +2435,47 @@ WTSKlineSlice* HisDataReplayer::get_kline_slice(const char* stdCode, const char*
 	return kline;
 }
 
+WTSBarStruct* HisDataReplayer::get_bars_in_range(const char* stdCode, const char* period, uint32_t times, uint32_t& count)
+{
+	count = 0;
+
+	thread_local static char key[64] = { 0 };
+	fmtutil::format_to(key, "{}#{}#{}", stdCode, period, times);
+
+	if (!cacheBarsByKey(key, stdCode, period, times))
+		return NULL;
+
+	BarsListPtr& barsList = _bars_cache[key];
+	if (barsList == NULL || barsList->_bars.empty())
+		return NULL;
+
+	auto& bars = barsList->_bars;
+	bool isDay = (barsList->_period == KP_DAY);
+
+	//日线按照交易日比较，分钟线按照yyyyMMddHHmm比较
+	auto toTime = [isDay](const WTSBarStruct& bar) -> uint64_t {
+		if (isDay)
+			return (uint64_t)bar.date * 10000;
+		else
+			return (uint64_t)bar.time + 199000000000;
+	};
+
+	uint64_t sTime = isDay ? (_begin_time / 10000 * 10000) : _begin_time;
+	uint64_t eTime = _end_time;
+	auto sit = std::lower_bound(bars.begin(), bars.end(), sTime, [&toTime](const WTSBarStruct& bar, uint64_t t) {
+		return toTime(bar) < t;
+	});
+	auto eit = std::upper_bound(sit, bars.end(), eTime, [&toTime](uint64_t t, const WTSBarStruct& bar) {
+		return t < toTime(bar);
+	});
+
+	count = (uint32_t)(eit - sit);
+	if (count == 0)
+		return NULL;
+
+	return &(*sit);
+}
+
 WTSTickSlice* HisDataReplayer::get_tick_slice(const char* stdCode, uint32_t count, uint64_t etime)
 {
 	if (!_tick_enabled)
@@ -3194,45 +3262,6 @@ void HisDataReplayer::checkUnbars()
 	}
 }
 
-uint32_t strToTime(const char* strTime, bool bHasSec = false)
-{
-	std::string str;
-	const char *pos = strTime;
-	while (strlen(pos) > 0)
-	{
-		if (pos[0] != ':')
-		{
-			str.append(pos, 1);
-		}
-		pos++;
-	}
-
-	uint32_t ret = strtoul(str.c_str(), NULL, 10);
-	if (str.size() > 4 && !bHasSec)
-		ret /= 100;
-
-	return ret;
-}
-
-uint32_t strToDate(const char* strDate)
-{
-	StringVector ay = StrUtil::split(strDate, "/");
-	if(ay.size() == 1)
-		ay = StrUtil::split(strDate, "-");
-	std::stringstream ss;
-	if (ay.size() > 1)
-	{
-		auto pos = ay[2].find(" ");
-		if (pos != std::string::npos)
-			ay[2] = ay[2].substr(0, pos);
-		ss << ay[0] << (ay[1].size() == 1 ? "0" : "") << ay[1] << (ay[2].size() == 1 ? "0" : "") << ay[2];
-	}
-	else
-		ss << ay[0];
-
-	return strtoul(ss.str().c_str(), NULL, 10);
-}
-
 bool HisDataReplayer::cacheRawTicksFromBin(const std::string& key, const char* stdCode, uint32_t uDate)
 {
 	CodeHelper::CodeInfo cInfo = CodeHelper::extractStdCode(stdCode, &_hot_mgr);
@@ -3388,11 +3417,16 @@ bool HisDataReplayer::cacheRawTicksFromLoader(const std::string& key, const char
 	dataList._date = uDate;
 	dataList._count = 0;
 
-	bool bSucc = _bt_loader->loadRawHisTicks(&dataList, stdCode, uDate, [](void* obj, WTSTickStruct* firstItem, uint32_t count) {
+	bool bSucc = _bt_loader->loadRawHisTicksRef(&dataList, stdCode, uDate, [](void* obj, WTSTickStruct* firstItem, uint32_t count) {
 		HftDataList<WTSTickStruct>* ticks = (HftDataList<WTSTickStruct>*)obj;
 		ticks->_items.resize(count);
 		ticks->_count = count;
 		memcpy(ticks->_items.data(), firstItem, sizeof(WTSTickStruct)*count);
+	}, [](void* obj, WTSTickStruct* firstItem, uint32_t count, FuncReleaseData releaser, void* ctx) {
+		//直接引用加载器的数据，不拷贝
+		HftDataList<WTSTickStruct>* ticks = (HftDataList<WTSTickStruct>*)obj;
+		ticks->_items.attach(firstItem, count, releaser, ctx);
+		ticks->_count = count;
 	});
 
 	if (!bSucc)
@@ -3441,83 +3475,55 @@ bool HisDataReplayer::cacheRawTicksFromCSV(const std::string& key, const char* s
 	}
 	else
 	{
-		WTSLogger::error("Back tick data file {} not exists", filename.c_str());
-		WTSLogger::warn("If you want to use tick data in csv mode, you can use wtpy.WtDataHelper.store_ticks to generate dsb file", filename.c_str());
-		return false;
-
 		/*
-		 *	By Wesley @ 2023.05.18
-		 *	回测的tick数据不再支持从csv读取，因为tick数据维度更多，有处理csv的时间，直接生成dsb了
+		 *	没有dsb文件的时候，从csv加载，并转储成dsb
+		 *	csv文件按表头映射字段，直接解析到WTSTickStruct数组中，大文件会按行切分多线程解析
 		 */
-		//如果没有格式化的历史数据文件, 则从csv加载
-		//std::stringstream ss;
-		//ss << _base_dir << "csv/ticks/" << stdCode << "_tick_" << uDate << ".csv";
-		//std::string csvfile = ss.str();
-
-		//if (!StdFile::exists(csvfile.c_str()))
-		//{
-		//	WTSLogger::error("Back tick data file {} not exists", csvfile.c_str());
-		//	return false;
-		//}
-
-		//std::ifstream ifs;
-		//ifs.open(csvfile.c_str());
+		std::stringstream ss;
+		ss << _base_dir << "csv/ticks/" << stdCode << "_tick_" << uDate << ".csv";
+		std::string csvfile = ss.str();
 
-		//WTSLogger::info("Reading data from {}...", csvfile.c_str());
+		if (!StdFile::exists(csvfile.c_str()))
+		{
+			WTSLogger::error("Back tick data file {} not exists", filename.c_str());
+			WTSLogger::warn("If you want to use tick data in csv mode, put it at {} or use wtpy.WtDataHelper.store_ticks to generate dsb file", csvfile);
+			return false;
+		}
 
-		//char buffer[1024];
-		//bool headerskipped = false;
-		//auto& tickList = _ticks_cache[key];
-		//tickList._code = stdCode;
-		//tickList._date = uDate;
-		//while (!ifs.eof())
-		//{
-		//	ifs.getline(buffer, 1024);
-		//	if (strlen(buffer) == 0)
-		//		continue;
+		WTSLogger::info("Reading data from {}...", csvfile);
+		auto& ticksList = _ticks_cache[key];
+		ticksList._code = stdCode;
+		ticksList._date = uDate;
+		ticksList._cursor = UINT_MAX;
+		ticksList._count = CsvLoader::load_ticks(csvfile.c_str(), ticksList._items.own());
+		if (ticksList._count == 0)
+		{
+			WTSLogger::error("No data loaded from back tick data file {}", csvfile);
+			return false;
+		}
 
-		//	//跳过头部
-		//	if (!headerskipped)
-		//	{
-		//		headerskipped = true;
-		//		continue;
-		//	}
+		CodeHelper::CodeInfo cInfo = CodeHelper::extractStdCode(stdCode, &_hot_mgr);
+		for (WTSTickStruct& curTick : ticksList._items)
+		{
+			wt_strcpy(curTick.exchg, cInfo._exchg);
+			wt_strcpy(curTick.code, cInfo._code);
+		}
 
-		//	//逐行读取
-		//	StringVector ay = StrUtil::split(buffer, ",");
-		//	WTSTickStruct ticks;
-		//	ticks.action_date = strToDate(ay[0].c_str());
-		//	ticks.action_time = strToTime(ay[1].c_str(), true) * 1000;
-		//	ticks.price = strtod(ay[2].c_str(), NULL);
-		//	ticks.volume = strtod(ay[3].c_str(), NULL);
-		//	tickList._items.emplace_back(ticks);
+		WTSLogger::info("Data file {} all loaded, totally {} items", csvfile, ticksList._count);
 
-		//	if (tickList._items.size() % 1000 == 0)
-		//	{
-		//		WTSLogger::info("{} items of data loaded", tickList._items.size());
-		//	}
-		//}
-		//tickList._count = tickList._items.size();
-		//ifs.close();
-		//WTSLogger::info("Data file {} all loaded, totally {} items", csvfile.c_str(), tickList._items.size());
+		std::string content;
+		content.resize(sizeof(HisTickBlockV2));
+		HisTickBlockV2 *tBlock = (HisTickBlockV2*)content.data();
+		strcpy(tBlock->_blk_flag, BLK_FLAG);
+		tBlock->_type = BT_HIS_Ticks;
+		tBlock->_version = BLOCK_VERSION_CMP_V2;
+
+		std::string cmpData = WTSCmpHelper::compress_data(ticksList._items.data(), sizeof(WTSTickStruct)*ticksList._count);
+		tBlock->_size = cmpData.size();
+		content.append(cmpData);
 
-		/*
-		 *	By Wesley @ 2021.12.14
-		 *	这一段之前有bug，之前没有把文件头写到文件里，所以转储的dsb解析的时候会抛出异常
-		 */
-		//std::string content;
-		//content.resize(sizeof(HisTickBlockV2));
-		//HisTickBlockV2 *pBlk = (HisTickBlockV2*)content.data();
-		//strcpy(pBlk->_blk_flag, BLK_FLAG);
-		//pBlk->_type = BT_HIS_Ticks;
-		//pBlk->_version = BLOCK_VERSION_CMP_V2;
-
-		//std::string cmpData = WTSCmpHelper::compress_data(tickList._items.data(), sizeof(WTSTickStruct)*tickList._count);
-		//pBlk->_size = cmpData.size();
-		//content.append(cmpData);
-
-		//StdFile::write_file_content(filename.c_str(), content.c_str(), content.size());
-		//WTSLogger::info("Ticks transfered to file {}", filename.c_str());
+		StdFile::write_file_content(filename.c_str(), content.c_str(), content.size());
+		WTSLogger::info("Ticks transfered to file {}", filename);
 	}
 
 	return true;
@@ -3621,14 +3627,19 @@ bool HisDataReplayer::cacheFinalBarsFromLoader(const std::string& key, const cha
 		barsList->_count = 0;
 
 		std::string buffer;
-		bool bSucc = _bt_loader->loadFinalHisBars(barsList.get(), stdCode, period, [](void* obj, WTSBarStruct* firstBar, uint32_t count) {
+		bool bSucc = _bt_loader->loadFinalHisBarsRef(barsList.get(), stdCode, period, [](void* obj, WTSBarStruct* firstBar, uint32_t count) {
 			BarsList* bars = (BarsList*)obj;
 			bars->_count = count;
 			bars->_bars.resize(count);
 			memcpy((void*)bars->_bars.data(), firstBar, sizeof(WTSBarStruct)*count);
+		}, [](void* obj, WTSBarStruct* firstBar, uint32_t count, FuncReleaseData releaser, void* ctx) {
+			//直接引用加载器的数据，不拷贝
+			BarsList* bars = (BarsList*)obj;
+			bars->_count = count;
+			bars->_bars.attach(firstBar, count, releaser, ctx);
 		});
 
-		if (!bSucc)
+		if (!bSucc || barsList->_count == 0)
 			return false;
 
 		bool isDay = (period == KP_DAY);
@@ -3761,10 +3772,7 @@ bool HisDataReplayer::cacheRawBarsFromCSV(const std::string& key, const char* st
 			return false;
 		}
 
-		CsvReader reader;
-		reader.load_from_file(csvfile.c_str());
-
-		WTSLogger::info("Reading data from {}, with fields: {}...", csvfile, reader.fields());
+		WTSLogger::info("Reading data from {}...", csvfile);
 
 		if (bSubbed)
 			_bars_cache[key].reset(new BarsList);
@@ -3774,28 +3782,12 @@ bool HisDataReplayer::cacheRawBarsFromCSV(const std::string& key, const char* st
 		BarsListPtr& barsList = bSubbed ? _bars_cache[key] : _unbars_cache[key];
 		barsList->_code = stdCode;
 		barsList->_period = period;
-		while (reader.next_row())
+		//按表头映射字段，直接解析到K线数组中，大文件会按行切分多线程解析
+		CsvLoader::load_bars(csvfile.c_str(), barsList->_bars.own(), isDay);
+		if (barsList->_bars.empty())
 		{
-			//逐行读取
-			WTSBarStruct bs;
-			bs.date = strToDate(reader.get_string("date"));
-			if (period != KP_DAY)
-				bs.time = TimeUtils::timeToMinBar(bs.date, strToTime(reader.get_string("time")));
-			bs.open = reader.get_double("open");
-			bs.high = reader.get_double("high");
-			bs.low = reader.get_double("low");
-			bs.close = reader.get_double("close");
-			bs.vol = reader.get_double("volume");
-			bs.money = reader.get_double("turnover");
-			bs.hold = reader.get_double("open_interest");
-			bs.add = reader.get_double("diff_interest");
-			bs.settle = reader.get_double("settle");
-			barsList->_bars.emplace_back(bs);
-
-			if (barsList->_bars.size() % 1000 == 0)
-			{
-				WTSLogger::info("{} lines of data loaded", barsList->_bars.size());
-			}
+			WTSLogger::error("No data loaded from back kbar data file {}", csvfile);
+			return false;
 		}
 		barsList->_count = barsList->_bars.size();
 
@@ -4463,11 +4455,28 @@ bool HisDataReplayer::cacheRawBarsFromBin(const std::string& key, const char* st
 	std::string buffer;
 	if (NULL != _bt_loader)
 	{
-		bLoaded = _bt_loader->loadRawHisBars(&buffer, stdCode, period, [](void* obj, WTSBarStruct* bars, uint32_t count) {
-			std::string* buff = (std::string*)obj;
-			buff->resize(sizeof(WTSBarStruct)*count);
-			memcpy((void*)buff->c_str(), bars, sizeof(WTSBarStruct)*count);
+		/*
+		 *	普通合约不需要拼接，外部加载器的数据直接放到缓存里
+		 *	如果加载器提供的是引用，则连拷贝都省掉了
+		 */
+		bLoaded = _bt_loader->loadRawHisBarsRef(barsList.get(), stdCode, period, [](void* obj, WTSBarStruct* bars, uint32_t count) {
+			BarsList* barsList = (BarsList*)obj;
+			barsList->_bars.resize(count);
+			memcpy((void*)barsList->_bars.data(), bars, sizeof(WTSBarStruct)*count);
+		}, [](void* obj, WTSBarStruct* bars, uint32_t count, FuncReleaseData releaser, void* ctx) {
+			BarsList* barsList = (BarsList*)obj;
+			barsList->_bars.attach(bars, count, releaser, ctx);
 		});
+
+		if (bLoaded)
+		{
+			if (barsList->_bars.empty())
+				return false;
+
+			barsList->_count = barsList->_bars.size();
+			WTSLogger::info("{} items of back {} data of {} loaded via extended loader", barsList->_count, PERIOD_NAME[period], stdCode);
+			return true;
+		}
 	}
 
 	if(!bLoaded)
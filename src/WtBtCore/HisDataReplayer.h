@@ -10,6 +10,8 @@
 #pragma once
 #include <string>
 #include <set>
+#include <vector>
+#include <memory>
 #include "HisDataMgr.h"
 #include "../WtDataStorage/DataDefine.h"
 
@@ -19,6 +21,7 @@
 
 #include "../WTSTools/WTSHotMgr.h"
 #include "../WTSTools/WTSBaseDataMgr.h"
+#include "../Share/OptionGreeks.hpp"
 
 NS_WTP_BEGIN
 class WTSTickData;
@@ -102,6 +105,138 @@ typedef void(*FuncReadOrdQue)(void* obj, WTSOrdQueStruct* firstItem, uint32_t co
  */
 typedef void(*FuncReadTrans)(void* obj, WTSTransStruct* firstItem, uint32_t count);
 
+/*
+ *	外部数据释放回调
+ *	回放器不再引用外部数据的时候调用
+ *	@ctx	引用数据时传入的上下文
+ */
+typedef void(*FuncReleaseData)(void* ctx);
+
+/*
+ *	引用外部K线数据回调，数据不拷贝，由回放器直接引用
+ *	数据必须在释放回调被调用之前保持有效
+ *	@obj		回传用的，原样返回即可
+ *	@firstBar	K线数据
+ *	@count		K线条数
+ *	@releaser	释放回调，可以为NULL
+ *	@ctx		释放回调的上下文
+ */
+typedef void(*FuncRefBars)(void* obj, WTSBarStruct* firstBar, uint32_t count, FuncReleaseData releaser, void* ctx);
+
+/*
+ *	引用外部tick数据回调，同FuncRefBars
+ */
+typedef void(*FuncRefTicks)(void* obj, WTSTickStruct* firstItem, uint32_t count, FuncReleaseData releaser, void* ctx);
+
+/*
+ *	回放器的数据缓存
+ *	默认自己持有数据，也可以直接引用外部加载器持有的数据
+ *	引用外部数据时，缓存清理或者需要改变大小的时候，才会调用释放回调把数据还给加载器
+ */
+template <typename T>
+class BtDataBuffer
+{
+private:
+	class RefHolder
+	{
+	public:
+		RefHolder(FuncReleaseData releaser, void* ctx) :_releaser(releaser), _ctx(ctx) {}
+		~RefHolder()
+		{
+			if (_releaser)
+				_releaser(_ctx);
+		}
+
+	private:
+		FuncReleaseData	_releaser;
+		void*			_ctx;
+	};
+
+public:
+	BtDataBuffer() :_ref_data(NULL), _ref_count(0) {}
+
+	inline T*			data() { return _ref_holder ? _ref_data : _items.data(); }
+	inline const T*		data() const { return _ref_holder ? _ref_data : _items.data(); }
+	inline std::size_t	size() const { return _ref_holder ? _ref_count : _items.size(); }
+	inline bool			empty() const { return size() == 0; }
+
+	inline T*			begin() { return data(); }
+	inline T*			end() { return data() + size(); }
+	inline const T*		begin() const { return data(); }
+	inline const T*		end() const { return data() + size(); }
+
+	inline T&			operator[](std::size_t idx) { return data()[idx]; }
+	inline const T&		operator[](std::size_t idx) const { return data()[idx]; }
+
+	/*
+	 *	是否引用的外部数据
+	 */
+	inline bool			is_ref() const { return (bool)_ref_holder; }
+
+	/*
+	 *	引用外部数据，原来的数据直接丢弃
+	 */
+	void attach(T* items, std::size_t count, FuncReleaseData releaser, void* ctx)
+	{
+		std::vector<T>().swap(_items);
+		_ref_holder.reset(new RefHolder(releaser, ctx));
+		_ref_data = items;
+		_ref_count = count;
+	}
+
+	/*
+	 *	改变大小
+	 *	如果引用的是外部数据，先把保留的部分拷贝出来，再释放外部数据
+	 */
+	void resize(std::size_t count)
+	{
+		if (_ref_holder)
+		{
+			std::vector<T> items(count);
+			if (count > 0)
+				memcpy((void*)items.data(), _ref_data, sizeof(T)*std::min(count, _ref_count));
+			detach();
+			_items.swap(items);
+		}
+		else
+		{
+			_items.resize(count);
+		}
+	}
+
+	inline void clear() { resize(0); }
+
+	inline void swap(std::vector<T>& items)
+	{
+		own().swap(items);
+	}
+
+	/*
+	 *	获取自己持有的数据，引用外部数据的话，先拷贝出来
+	 */
+	std::vector<T>& own()
+	{
+		if (_ref_holder)
+			resize(_ref_count);
+		return _items;
+	}
+
+private:
+	inline void detach()
+	{
+		_ref_holder.reset();
+		_ref_data = NULL;
+		_ref_count = 0;
+	}
+
+private:
+	std::vector<T>	_items;
+
+	T*				_ref_data;
+	std::size_t		_ref_count;
+	std::shared_ptr<RefHolder>	_ref_holder;
+};
+
 class IBtDataLoader
 {
 public:
@@ -144,6 +279,26 @@ public:
 	 */
 	virtual bool loadRawHisTicks(void* obj, const char* stdCode, uint32_t uDate, FuncReadTicks cb) = 0;
 
+	/*
+	 *	以下三个接口和上面的对应接口一样，多了一个引用数据的回调
+	 *	加载器可以通过cbRef把自己持有的数据直接交给回放器，不做拷贝
+	 *	默认实现退化成拷贝的方式
+	 */
+	virtual bool loadFinalHisBarsRef(void* obj, const char* stdCode, WTSKlinePeriod period, FuncReadBars cb, FuncRefBars cbRef)
+	{
+		return loadFinalHisBars(obj, stdCode, period, cb);
+	}
+
+	virtual bool loadRawHisBarsRef(void* obj, const char* stdCode, WTSKlinePeriod period, FuncReadBars cb, FuncRefBars cbRef)
+	{
+		return loadRawHisBars(obj, stdCode, period, cb);
+	}
+
+	virtual bool loadRawHisTicksRef(void* obj, const char* stdCode, uint32_t uDate, FuncReadTicks cb, FuncRefTicks cbRef)
+	{
+		return loadRawHisTicks(obj, stdCode, uDate, cb);
+	}
+
 	/*
 	 *	是否自动转储为dsb
 	 */
@@ -168,7 +323,7 @@ private:
 		std::size_t		_cursor;
 		std::size_t		_count;
 
-		std::vector<T> _items;
+		BtDataBuffer<T> _items;
 
 		HftDataList() :_cursor(UINT_MAX), _count(0), _date(0){}
 	};
@@ -192,7 +347,7 @@ private:
 		uint32_t		_count;
 		uint32_t		_times;
 
-		std::vector<WTSBarStruct>	_bars;
+		BtDataBuffer<WTSBarStruct>	_bars;
 		double			_factor;	//最后一条复权因子
 
 		uint32_t		_untouch_days;	//未用到的天数
@@ -297,6 +452,14 @@ private:
 	 */
 	bool		cacheFinalBarsFromLoader(const std::string& key, const char* stdCode, WTSKlinePeriod period, bool bSubbed = true);
 
+	/*
+	 *	按照缓存键加载K线，如果是非基础周期，还会从基础周期重采样
+	 *	@key	缓存键，格式为code#period#times
+	 *	@period	基础周期，m或者d
+	 *	@times	周期倍数
+	 */
+	bool		cacheBarsByKey(const std::string& key, const char* stdCode, const char* period, uint32_t times);
+
 	/*
 	 *	从外部加载器缓存历史tick数据
 	 */
@@ -419,6 +582,14 @@ public:
 
 	WTSKlineSlice* get_kline_slice(const char* stdCode, const char* period, uint32_t count, uint32_t times = 1, bool isMain = false);
 
+	/*
+	 *	获取回测区间内的全部K线，主要给向量化回测使用
+	 *	不会移动回放游标，也不会注册为回放的K线
+	 *	返回的指针指向K线缓存，在clear_cache之前都有效
+	 *	@count	返回的K线条数
+	 */
+	WTSBarStruct* get_bars_in_range(const char* stdCode, const char* period, uint32_t times, uint32_t& count);
+
 	WTSTickSlice* get_tick_slice(const char* stdCode, uint32_t count, uint64_t etime = 0);
 
 	WTSOrdDtlSlice* get_order_detail_slice(const char* stdCode, uint32_t count, uint64_t etime = 0);
@@ -429,6 +600,9 @@ public:
 
 	WTSTickData* get_last_tick(const char* stdCode);
 
+	inline const WTSOptGreeksStruct* get_greeks(const char* stdCode) const { return _greeks.get_greeks(stdCode); }
+	inline const WTSOptGreeksStruct* get_greeks_chain(const char* underlying, uint32_t& count) const { return _greeks.get_chain(underlying, count); }
+
 	uint32_t get_date() const{ return _cur_date; }
 	uint32_t get_min_time() const{ return _cur_time; }
 	uint32_t get_raw_time() const{ return _cur_time; }
@@ -452,6 +626,12 @@ public:
 
 	inline bool	is_tick_simulated() const { return _tick_simulated; }
 
+	/*
+	 *	回测结果是否输出为列式二进制格式
+	 *	由replayer配置中的output_format决定，bin为二进制格式，其他为csv格式
+	 */
+	inline bool	is_binary_output() const { return _bin_output; }
+
 	inline void update_price(const char* stdCode, double price)
 	{
 		_price_map[stdCode] = price;
@@ -489,6 +669,7 @@ private:
 	 *	默认为false，主要是针对涨跌停的行情，也适用于不活跃的合约
 	 */
 	bool			_nosim_if_notrade;
+	bool			_bin_output;	//回测结果是否输出为列式二进制格式
 	std::map<std::string, WTSTickStruct>	_day_cache;	//每日Tick缓存,当tick回放未开放时,会用到该缓存
 	std::map<std::string, std::string>		_ticker_keys;
 
@@ -569,5 +750,7 @@ private:
 	EventNotifier*	_notifier;
 
 	HisDataMgr		_his_dt_mgr;
+
+	OptionGreeksSvc	_greeks;	//期权希腊字母服务，和实盘一样在tick分发之前更新
 };
 
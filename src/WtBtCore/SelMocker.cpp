@@ -46,6 +46,12 @@ SelMocker::SelMocker(HisDataReplayer* replayer, const char* name, int32_t slippa
 	, _schedule_times(0)
 {
 	_context_id = makeSelCtxId();
+
+	_trade_logs.setup("code,time,direct,action,price,qty,tag,fee", "sussggsg", 1);
+	_close_logs.setup("code,direct,opentime,openprice,closetime,closeprice,qty,profit,maxprofit,maxloss,totalprofit,entertag,exittag,openbarno,closebarno", "ssuguggggggssuu", 4);
+	_fund_logs.setup("date,closeprofit,positionprofit,dynbalance,fee", "uffff", 0);
+	_sig_logs.setup("code,target,sigprice,gentime,usertag", "sggus", 3);
+	_pos_logs.setup("date,code,volume,closeprofit,dynprofit", "usrff", 0);
 }
 
 
@@ -155,39 +161,38 @@ void SelMocker::dump_stradata()
 }
 
 
-void SelMocker::dump_outputs()
+void SelMocker::open_outputs()
 {
+	if (_trade_logs.is_opened())
+		return;
+
 	std::string folder = WtHelper::getOutputDir();
 	folder += _name;
 	folder += "/";
 	boost::filesystem::create_directories(folder.c_str());
 
-	std::string filename = folder + "trades.csv";
-	std::string content = "code,time,direct,action,price,qty,tag,fee\n";
-	content += _trade_logs.str();
-	StdFile::write_file_content(filename.c_str(), (void*)content.c_str(), content.size());
-
-	filename = folder + "closes.csv";
-	content = "code,direct,opentime,openprice,closetime,closeprice,qty,profit,maxprofit,maxloss,totalprofit,entertag,exittag,openbarno,closebarno\n";
-	content += _close_logs.str();
-	StdFile::write_file_content(filename.c_str(), (void*)content.c_str(), content.size());
-
-
-	filename = folder + "funds.csv";
-	content = "date,closeprofit,positionprofit,dynbalance,fee\n";
-	content += _fund_logs.str();
-	StdFile::write_file_content(filename.c_str(), (void*)content.c_str(), content.size());
+	bool bBinary = _replayer->is_binary_output();
+	_trade_logs.open((folder + "trades").c_str(), bBinary);
+	_close_logs.open((folder + "closes").c_str(), bBinary);
+	_fund_logs.open((folder + "funds").c_str(), bBinary);
+	_sig_logs.open((folder + "signals").c_str(), bBinary);
+	_pos_logs.open((folder + "positions").c_str(), bBinary);
+}
 
+void SelMocker::dump_outputs()
+{
+	open_outputs();
 
-	filename = folder + "signals.csv";
-	content = "code,target,sigprice,gentime,usertag\n";
-	content += _sig_logs.str();
-	StdFile::write_file_content(filename.c_str(), (void*)content.c_str(), content.size());
+	_trade_logs.close();
+	_close_logs.close();
+	_fund_logs.close();
+	_sig_logs.close();
+	_pos_logs.close();
 
-	filename = folder + "positions.csv";
-	content = "date,code,volume,closeprofit,dynprofit\n";
-	if (!_pos_logs.str().empty()) content += _pos_logs.str();
-	StdFile::write_file_content(filename.c_str(), (void*)content.c_str(), content.size());
+	std::string folder = WtHelper::getOutputDir();
+	folder += _name;
+	folder += "/";
+	std::string filename;
 
 	{
 		rj::Document root(rj::kObjectType);
@@ -211,20 +216,23 @@ void SelMocker::dump_outputs()
 
 void SelMocker::log_signal(const char* stdCode, double target, double price, uint64_t gentime, const char* usertag /* = "" */)
 {
-	_sig_logs << stdCode << "," << target << "," << price << "," << gentime << "," << usertag << "\n";
+	_sig_logs << stdCode << target << price << gentime << usertag;
+	_sig_logs.end_row();
 }
 
 void SelMocker::log_trade(const char* stdCode, bool isLong, bool isOpen, uint64_t curTime, double price, double qty, const char* userTag, double fee)
 {
-	_trade_logs << stdCode << "," << curTime << "," << (isLong ? "LONG" : "SHORT") << "," << (isOpen ? "OPEN" : "CLOSE") << "," << price << "," << qty << "," << userTag << "," << fee << "\n";
+	_trade_logs << stdCode << curTime << (isLong ? "LONG" : "SHORT") << (isOpen ? "OPEN" : "CLOSE") << price << qty << userTag << fee;
+	_trade_logs.end_row();
 }
 
 void SelMocker::log_close(const char* stdCode, bool isLong, uint64_t openTime, double openpx, uint64_t closeTime, double closepx, double qty, double profit, double maxprofit, double maxloss,
 	double totalprofit /* = 0 */, const char* enterTag /* = "" */, const char* exitTag /* = "" */, uint32_t openBarNo/* = 0*/, uint32_t closeBarNo/* = 0*/)
 {
-	_close_logs << stdCode << "," << (isLong ? "LONG" : "SHORT") << "," << openTime << "," << openpx
-		<< "," << closeTime << "," << closepx << "," << qty << "," << profit << "," << maxprofit << "," << maxloss << ","
-		<< totalprofit << "," << enterTag << "," << exitTag << "," << openBarNo << "," << closeBarNo << "\n";
+	_close_logs << stdCode << (isLong ? "LONG" : "SHORT") << openTime << openpx
+		<< closeTime << closepx << qty << profit << maxprofit << maxloss
+		<< totalprofit << enterTag << exitTag << openBarNo << closeBarNo;
+	_close_logs.end_row();
 }
 
 bool SelMocker::init_sel_factory(WTSVariant* cfg)
@@ -270,6 +278,8 @@ bool SelMocker::init_sel_factory(WTSVariant* cfg)
 //IDataSink
 void SelMocker::handle_init()
 {
+	open_outputs();
+
 	this->on_init();
 }
 
@@ -563,13 +573,13 @@ void SelMocker::on_session_end(uint32_t curTDate)
 		if (decimal::eq(pInfo._volume, 0.0))
 			continue;
 
-		_pos_logs << fmt::format("{},{},{},{:.2f},{:.2f}\n", curDate, stdCode,
-			pInfo._volume, pInfo._closeprofit, pInfo._dynprofit);
+		_pos_logs << curDate << stdCode << pInfo._volume << pInfo._closeprofit << pInfo._dynprofit;
+		_pos_logs.end_row();
 	}
 
-	_fund_logs << fmt::format("{},{:.2f},{:.2f},{:.2f},{:.2f}\n", curDate,
-		_fund_info._total_profit, _fund_info._total_dynprofit,
-		_fund_info._total_profit + _fund_info._total_dynprofit - _fund_info._total_fees, _fund_info._total_fees);
+	_fund_logs << curDate << _fund_info._total_profit << _fund_info._total_dynprofit
+		<< _fund_info._total_profit + _fund_info._total_dynprofit - _fund_info._total_fees << _fund_info._total_fees;
+	_fund_logs.end_row();
 
 	//save_data();
 }
@@ -10,6 +10,7 @@
 #pragma once
 #include <sstream>
 #include "HisDataReplayer.h"
+#include "BtOutputTable.h"
 
 #include "../Includes/FasterDefs.h"
 #include "../Includes/ISelStraCtx.h"
@@ -53,6 +54,7 @@ private:
 	}
 
 private:
+	void	open_outputs();
 	void	dump_outputs();
 	void	dump_stradata();
 	inline void log_signal(const char* stdCode, double target, double price, uint64_t gentime, const char* usertag = "");
@@ -246,11 +248,12 @@ protected:
 	typedef wt_hashmap<std::string, SigInfo>	SignalMap;
 	SignalMap		_sig_map;
 
-	std::stringstream	_trade_logs;
-	std::stringstream	_close_logs;
-	std::stringstream	_fund_logs;
-	std::stringstream	_sig_logs;
-	std::stringstream	_pos_logs;
+	//回测结果表，回测过程中逐行写入文件
+	BtOutputTable		_trade_logs;
+	BtOutputTable		_close_logs;
+	BtOutputTable		_fund_logs;
+	BtOutputTable		_sig_logs;
+	BtOutputTable		_pos_logs;
 
 	//是否处于调度中的标记
 	bool			_is_in_schedule;	//是否在自动调度中
@@ -51,6 +51,11 @@ UftMocker::UftMocker(HisDataReplayer* replayer, const char* name)
 	, _match_this_tick(false)
 {
 	_context_id = makeUftCtxId();
+
+	_trade_logs.setup("code,time,direct,action,price,qty,fee,usertag", "sussgggs", 1);
+	_close_logs.setup("code,direct,opentime,openprice,closetime,closeprice,qty,profit,maxprofit,maxloss,totalprofit,entertag,exittag", "ssuguggggggss", 4);
+	_fund_logs.setup("date,closeprofit,positionprofit,dynbalance,fee", "uffff", 0);
+	_pos_logs.setup("date,code,direct,volume,closeprofit,dynprofit", "ussrff", 0);
 }
 
 
@@ -191,6 +196,8 @@ void UftMocker::handle_bar_close(const char* stdCode, const char* period, uint32
 
 void UftMocker::handle_init()
 {
+	open_outputs();
+
 	on_init();
 	on_channel_ready();
 }
@@ -382,15 +389,21 @@ void UftMocker::on_session_end(uint32_t curTDate)
 		total_dynprofit += pInfo.dynprofit();
 
 		if (!decimal::eq(pInfo._long.volume(), 0.0))
-			_pos_logs << fmt::format("{},{},LONG,{},{:.2f},{:.2f}\n", curTDate, stdCode, pInfo._long.volume(), pInfo._long._closeprofit, pInfo._long._dynprofit);
+		{
+			_pos_logs << curTDate << stdCode << "LONG" << pInfo._long.volume() << pInfo._long._closeprofit << pInfo._long._dynprofit;
+			_pos_logs.end_row();
+		}
 
 		if (!decimal::eq(pInfo._short.volume(), 0.0))
-			_pos_logs << fmt::format("{},{},LONG,{},{:.2f},{:.2f}\n", curTDate, stdCode, pInfo._short.volume(), pInfo._short._closeprofit, pInfo._short._dynprofit);
+		{
+			_pos_logs << curTDate << stdCode << "SHORT" << pInfo._short.volume() << pInfo._short._closeprofit << pInfo._short._dynprofit;
+			_pos_logs.end_row();
+		}
 	}
 
-	_fund_logs << fmt::format("{},{:.2f},{:.2f},{:.2f},{:.2f}\n", curDate,
-		_fund_info._total_profit, _fund_info._total_dynprofit,
-		_fund_info._total_profit + _fund_info._total_dynprofit - _fund_info._total_fees, _fund_info._total_fees);
+	_fund_logs << curDate << _fund_info._total_profit << _fund_info._total_dynprofit
+		<< _fund_info._total_profit + _fund_info._total_dynprofit - _fund_info._total_fees << _fund_info._total_fees;
+	_fund_logs.end_row();
 }
 
 double UftMocker::stra_get_undone(const char* stdCode)
@@ -448,6 +461,78 @@ bool UftMocker::stra_cancel(uint32_t localid)
 	return true;
 }
 
+uint32_t UftMocker::stra_modify(uint32_t localid, double price, double qty)
+{
+	if (decimal::le(qty, 0))
+	{
+		log_error("Modify error: qty {} <= 0", qty);
+		return 0;
+	}
+
+	StdLocker<StdRecurMutex> lock(_mtx_ords);
+	auto it = _orders.find(localid);
+	if (it == _orders.end())
+		return 0;
+
+	OrderInfo& ordInfo = (OrderInfo&)it->second;
+	double diff = qty - ordInfo._left;
+
+	//平仓单的数量变了, 要先调整可平量
+	if (ordInfo._offset != 0 && !decimal::eq(diff, 0))
+	{
+		PosInfo& pInfo = _pos_map[ordInfo._code];
+		PosItem& pItem = ordInfo._isLong ? pInfo._long : pInfo._short;
+		WTSCommodityInfo* commInfo = _replayer->get_commodity_info(ordInfo._code);
+		if (commInfo->getCoverMode() == CM_CoverToday)
+		{
+			double& avail = (ordInfo._offset == 2) ? pItem._newavail : pItem._preavail;
+			if (decimal::lt(avail, diff))
+			{
+				log_error("Modify error: no enough available {} position", (ordInfo._offset == 2) ? "new" : "old");
+				return 0;
+			}
+			avail -= diff;
+		}
+		else if (diff > 0)
+		{
+			if (decimal::lt(pItem.valid(), diff))
+			{
+				log_error("Modify error: no enough available position");
+				return 0;
+			}
+
+			double maxQty = std::min(diff, pItem._preavail);
+			pItem._preavail -= maxQty;
+			pItem._newavail -= diff - maxQty;
+		}
+		else
+		{
+			//和撤单一样, 先释放今仓
+			double maxQty = std::min(-diff, pItem._newvol - pItem._newavail);
+			pItem._newavail += maxQty;
+			pItem._preavail += -diff - maxQty;
+		}
+	}
+
+	//回测撮合直接改单, 订单号保持不变
+	ordInfo._total += diff;
+	ordInfo._left = qty;
+	ordInfo._price = price;
+	log_debug("Order {} modified, action: {} {} @ {}({})", localid, OFFSET_NAMES[ordInfo._offset], ordInfo._isLong ? "long" : "short", ordInfo._price, ordInfo._left);
+
+	postTask([this, localid]() {
+		StdLocker<StdRecurMutex> lock(_mtx_ords);
+		auto it = _orders.find(localid);
+		if (it == _orders.end())
+			return;
+
+		const OrderInfo& ordInfo = it->second;
+		on_order(localid, ordInfo._code, ordInfo._isLong, ordInfo._offset, ordInfo._total, ordInfo._left, ordInfo._price, false);
+	});
+
+	return localid;
+}
+
 OrderIDs UftMocker::stra_cancel_all(const char* stdCode)
 {
 	OrderIDs ret;
@@ -960,6 +1045,33 @@ bool UftMocker::procOrder(uint32_t localid)
 	return false;
 }
 
+uint32_t UftMocker::stra_stage_order(const char* stdCode, bool isLong, bool isOpen, bool isToday /* = false */, int flag /* = 0 */)
+{
+	if (_replayer->get_commodity_info(stdCode) == NULL)
+	{
+		log_error("Staging order of {} failed: commodity not found", stdCode);
+		return 0;
+	}
+
+	_staged.emplace_back(StagedOrder{ stdCode, isLong, isOpen, isToday, flag });
+	return (uint32_t)_staged.size();
+}
+
+uint32_t UftMocker::stra_send_staged(uint32_t stageid, double price, double qty)
+{
+	if (stageid == 0 || stageid > _staged.size())
+	{
+		log_error("Order template #{} not exists", stageid);
+		return 0;
+	}
+
+	const StagedOrder& so = _staged[stageid - 1];
+	if (so._is_open)
+		return so._is_long ? stra_enter_long(so._code.c_str(), price, qty, so._flag) : stra_enter_short(so._code.c_str(), price, qty, so._flag);
+	else
+		return so._is_long ? stra_exit_long(so._code.c_str(), price, qty, so._is_today, so._flag) : stra_exit_short(so._code.c_str(), price, qty, so._is_today, so._flag);
+}
+
 WTSCommodityInfo* UftMocker::stra_get_comminfo(const char* stdCode)
 {
 	return _replayer->get_commodity_info(stdCode);
@@ -1001,6 +1113,16 @@ WTSTickData* UftMocker::stra_get_last_tick(const char* stdCode)
 	return _replayer->get_last_tick(stdCode);
 }
 
+const WTSOptGreeksStruct* UftMocker::stra_get_greeks(const char* stdCode)
+{
+	return _replayer->get_greeks(stdCode);
+}
+
+const WTSOptGreeksStruct* UftMocker::stra_get_greeks_chain(const char* underlying, uint32_t& count)
+{
+	return _replayer->get_greeks_chain(underlying, count);
+}
+
 double UftMocker::stra_get_position(const char* stdCode, bool bOnlyValid /* = false */, int32_t iFlag /* = 3 */)
 {
 	const PosInfo& posInfo = _pos_map[stdCode];
@@ -1100,47 +1222,48 @@ void UftMocker::stra_log_error(const char* message)
 }
 
 
-void UftMocker::dump_outputs()
+void UftMocker::open_outputs()
 {
+	if (_trade_logs.is_opened())
+		return;
+
 	std::string folder = WtHelper::getOutputDir();
 	folder += _name;
 	folder += "/";
 	boost::filesystem::create_directories(folder.c_str());
 
-	std::string filename = folder + "trades.csv";
-	std::string content = "code,time,direct,action,price,qty,fee,usertag\n";
-	content += _trade_logs.str();
-	StdFile::write_file_content(filename.c_str(), (void*)content.c_str(), content.size());
-
-	filename = folder + "closes.csv";
-	content = "code,direct,opentime,openprice,closetime,closeprice,qty,profit,maxprofit,maxloss,totalprofit,entertag,exittag\n";
-	content += _close_logs.str();
-	StdFile::write_file_content(filename.c_str(), (void*)content.c_str(), content.size());
-
+	bool bBinary = _replayer->is_binary_output();
+	_trade_logs.open((folder + "trades").c_str(), bBinary);
+	_close_logs.open((folder + "closes").c_str(), bBinary);
+	_fund_logs.open((folder + "funds").c_str(), bBinary);
+	_pos_logs.open((folder + "positions").c_str(), bBinary);
+}
 
-	filename = folder + "funds.csv";
-	content = "date,closeprofit,positionprofit,dynbalance,fee\n";
-	content += _fund_logs.str();
-	StdFile::write_file_content(filename.c_str(), (void*)content.c_str(), content.size());
+void UftMocker::dump_outputs()
+{
+	open_outputs();
 
-	filename = folder + "positions.csv";
-	content = "date,code,direct,volume,closeprofit,dynprofit\n";
-	if (!_pos_logs.str().empty()) content += _pos_logs.str();
-	StdFile::write_file_content(filename.c_str(), (void*)content.c_str(), content.size());
+	_trade_logs.close();
+	_close_logs.close();
+	_fund_logs.close();
+	_pos_logs.close();
 }
 
 void UftMocker::log_trade(const char* stdCode, bool isLong, uint32_t offset, uint64_t curTime, double price, double qty, double fee)
 {
-	_trade_logs << stdCode << "," << curTime << "," << (isLong ? "LONG" : "SHORT") << "," << OFFSET_NAMES[offset]
-		<< "," << price << "," << qty << "," << fee  << "\n";
+	//原来的输出没有usertag列，由end_row补齐
+	_trade_logs << stdCode << curTime << (isLong ? "LONG" : "SHORT") << OFFSET_NAMES[offset]
+		<< price << qty << fee;
+	_trade_logs.end_row();
 }
 
 void UftMocker::log_close(const char* stdCode, bool isLong, uint64_t openTime, double openpx, uint64_t closeTime, double closepx, double qty, double profit, double maxprofit, double maxloss,
 	double totalprofit /* = 0 */)
 {
-	_close_logs << stdCode << "," << (isLong ? "LONG" : "SHORT") << "," << openTime << "," << openpx
-		<< "," << closeTime << "," << closepx << "," << qty << "," << profit << "," << maxprofit << "," << maxloss << ","
-		<< totalprofit << "\n";
+	_close_logs << stdCode << (isLong ? "LONG" : "SHORT") << openTime << openpx
+		<< closeTime << closepx << qty << profit << maxprofit << maxloss
+		<< totalprofit;
+	_close_logs.end_row();
 }
 
 void UftMocker::update_position(const char* stdCode, bool isLong, uint32_t offset, double qty, double price /* = 0.0 */)
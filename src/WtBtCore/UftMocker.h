@@ -12,6 +12,7 @@
 #include <sstream>
 
 #include "HisDataReplayer.h"
+#include "BtOutputTable.h"
 
 #include "../Includes/FasterDefs.h"
 #include "../Includes/IUftStraCtx.h"
@@ -97,6 +98,8 @@ public:
 
 	virtual OrderIDs stra_cancel_all(const char* stdCode) override;
 
+	virtual uint32_t stra_modify(uint32_t localid, double price, double qty) override;
+
 	virtual OrderIDs stra_buy(const char* stdCode, double price, double qty, int flag = 0) override;
 
 	virtual OrderIDs stra_sell(const char* stdCode, double price, double qty, int flag = 0) override;
@@ -139,6 +142,13 @@ public:
 	 */
 	virtual uint32_t	stra_exit_short(const char* stdCode, double price, double qty, bool isToday = false, int flag = 0) override;
 
+	/*
+	 *	预置下单模板，回测里只记录参数，下单的时候转到对应的开平接口
+	 */
+	virtual uint32_t	stra_stage_order(const char* stdCode, bool isLong, bool isOpen, bool isToday = false, int flag = 0) override;
+
+	virtual uint32_t	stra_send_staged(uint32_t stageid, double price, double qty) override;
+
 	virtual WTSCommodityInfo* stra_get_comminfo(const char* stdCode) override;
 
 	virtual WTSKlineSlice* stra_get_bars(const char* stdCode, const char* period, uint32_t count) override;
@@ -153,6 +163,9 @@ public:
 
 	virtual WTSTickData* stra_get_last_tick(const char* stdCode) override;
 
+	virtual const WTSOptGreeksStruct* stra_get_greeks(const char* stdCode) override;
+	virtual const WTSOptGreeksStruct* stra_get_greeks_chain(const char* underlying, uint32_t& count) override;
+
 	/*
 	 *	获取持仓
 	 *	@stdCode	代码，格式如SSE.600000
@@ -210,6 +223,7 @@ private:
 	void	update_position(const char* stdCode, bool isLong, uint32_t offset, double qty, double price = 0.0);
 	void	update_dyn_profit(const char* stdCode, WTSTickData* newTick);
 
+	void	open_outputs();
 	void	dump_outputs();
 	void	log_trade(const char* stdCode, bool isLong, uint32_t offset, uint64_t curTime, double price, double qty, double fee);
 	void	log_close(const char* stdCode, bool isLong, uint64_t openTime, double openpx, uint64_t closeTime, double closepx, double qty,
@@ -339,10 +353,21 @@ private:
 	typedef wt_hashmap<std::string, PosInfo> PositionMap;
 	PositionMap		_pos_map;
 
-	std::stringstream	_trade_logs;
-	std::stringstream	_close_logs;
-	std::stringstream	_fund_logs;
-	std::stringstream	_pos_logs;
+	typedef struct _StagedOrder
+	{
+		std::string	_code;
+		bool		_is_long;
+		bool		_is_open;
+		bool		_is_today;
+		int			_flag;
+	} StagedOrder;
+	std::vector<StagedOrder>	_staged;
+
+	//回测结果表，回测过程中逐行写入文件
+	BtOutputTable		_trade_logs;
+	BtOutputTable		_close_logs;
+	BtOutputTable		_fund_logs;
+	BtOutputTable		_pos_logs;
 
 	typedef struct _StraFundInfo
 	{
@@ -0,0 +1,480 @@
+﻿/*!
+ * \file VecBacktester.cpp
+ * \project	WonderTrader
+ *
+ * \brief 向量化信号回测器实现
+ */
+#include "VecBacktester.h"
+#include "HisDataReplayer.h"
+#include "WtHelper.h"
+
+#include <cmath>
+#include <algorithm>
+#include <boost/filesystem.hpp>
+
+#include "../Includes/WTSContractInfo.hpp"
+#include "../Includes/WTSSessionInfo.hpp"
+#include "../Includes/WTSStruct.h"
+#include "../Share/decimal.h"
+#include "../Share/TimeUtils.hpp"
+#include "../WTSTools/WTSLogger.h"
+
+namespace
+{
+	//滑点的处理和CtaMocker保持一致
+	inline double apply_slippage(double price, bool isBuy, int32_t slippage, bool isRatio, double priceTick)
+	{
+		if (slippage == 0)
+			return price;
+
+		if (isRatio)
+		{
+			//比率滑点按照成交价计算，再根据pricetick做一个修正
+			double slp = (slippage * price / 10000.0);
+			slp = round(slp / priceTick)*priceTick;
+			return price + slp * (isBuy ? 1 : -1);
+		}
+
+		return price + slippage * priceTick*(isBuy ? 1 : -1);
+	}
+}
+
+VecBacktester::VecBacktester(HisDataReplayer* replayer, const char* name, int32_t slippage /* = 0 */, bool isRatioSlp /* = false */, FillMode fillMode /* = FM_Close */)
+	: _replayer(replayer)
+	, _name(name)
+	, _slippage(slippage)
+	, _ratio_slippage(isRatioSlp)
+	, _fill_mode(fillMode)
+{
+	//表结构和CtaMocker完全一致，方便用同一套分析工具
+	_trade_logs.setup("code,time,direct,action,price,qty,tag,fee,barno", "sussggsgu", 1);
+	_close_logs.setup("code,direct,opentime,openprice,closetime,closeprice,qty,profit,maxprofit,maxloss,totalprofit,entertag,exittag,openbarno,closebarno", "ssuguggggggssuu", 4);
+	_fund_logs.setup("date,closeprofit,positionprofit,dynbalance,fee", "uffff", 0);
+	_sig_logs.setup("code,target,sigprice,gentime,usertag", "sggus", 3);
+	_pos_logs.setup("date,code,volume,closeprofit,dynprofit", "usrff", 0);
+}
+
+VecBacktester::~VecBacktester()
+{
+}
+
+WTSBarStruct* VecBacktester::get_bars(const char* stdCode, const char* period, uint32_t& count)
+{
+	count = 0;
+	if (strlen(period) == 0)
+		return NULL;
+
+	char basePeriod[2] = { period[0], 0 };
+	uint32_t times = 1;
+	if (strlen(period) > 1)
+		times = strtoul(period + 1, NULL, 10);
+
+	return _replayer->get_bars_in_range(stdCode, basePeriod, times, count);
+}
+
+bool VecBacktester::add_targets(const char* stdCode, const char* period, const double* targets, uint32_t count, const char* userTag /* = "" */)
+{
+	if (_replayer->get_commodity_info(stdCode) == NULL)
+	{
+		WTSLogger::error("Cannot find corresponding commodity info of {}", stdCode);
+		return false;
+	}
+
+	uint32_t barCnt = 0;
+	WTSBarStruct* bars = get_bars(stdCode, period, barCnt);
+	if (bars == NULL)
+	{
+		WTSLogger::error("No bars of {}/{} in backtest range", stdCode, period);
+		return false;
+	}
+
+	if (barCnt != count)
+	{
+		WTSLogger::error("Size of targets of {}/{} mismatched, {} targets vs {} bars", stdCode, period, count, barCnt);
+		return false;
+	}
+
+	auto it = std::find_if(_tasks.begin(), _tasks.end(), [stdCode](const CodeTask& task) {
+		return task._code == stdCode;
+	});
+
+	CodeTask* task = NULL;
+	if (it == _tasks.end())
+	{
+		_tasks.emplace_back(CodeTask());
+		task = &_tasks.back();
+	}
+	else
+	{
+		task = &(*it);
+		WTSLogger::warn("Targets of {} already added, replaced with new ones", stdCode);
+	}
+
+	task->_code = stdCode;
+	task->_period = period;
+	task->_usertag = userTag;
+	task->_targets.assign(targets, targets + count);
+	task->_bars = bars;
+	task->_count = barCnt;
+	return true;
+}
+
+bool VecBacktester::run()
+{
+	if (_tasks.empty())
+	{
+		WTSLogger::error("No targets added, vectorized backtest {} skipped", _name);
+		return false;
+	}
+
+	TimeUtils::Ticker ticker;
+
+	_trades.clear();
+	_signals.clear();
+
+	uint64_t totalBars = 0;
+	std::vector<std::vector<DayState>> dayStates(_tasks.size());
+	for (uint32_t idx = 0; idx < _tasks.size(); idx++)
+	{
+		run_code(idx, dayStates[idx]);
+		totalBars += _tasks[idx]._count;
+	}
+
+	dump_outputs(dayStates);
+
+	WTSLogger::info("Vectorized backtest {} done, {} codes, {} bars, {} trades, {} signals, {} ms elapsed", 
+		_name, _tasks.size(), totalBars, _trade_logs.row_count(), _signals.size(), ticker.milli_seconds());
+	return true;
+}
+
+void VecBacktester::run_code(uint32_t codeIdx, std::vector<DayState>& days)
+{
+	const CodeTask& task = _tasks[codeIdx];
+	const char* stdCode = task._code.c_str();
+
+	WTSCommodityInfo* commInfo = _replayer->get_commodity_info(stdCode);
+	WTSSessionInfo* sInfo = _replayer->get_session_info(stdCode, true);
+	if (commInfo == NULL || sInfo == NULL)
+	{
+		WTSLogger::error("Cannot find commodity or session info of {}, backtest of it skipped", stdCode);
+		return;
+	}
+
+	bool isDay = (task._period[0] == 'd');
+	uint32_t closeTime = sInfo->getCloseTime();
+	double volScale = commInfo->getVolScale();
+	double priceTick = commInfo->getPriceTick();
+	bool isT1 = commInfo->isT1();
+	bool canShort = commInfo->canShort();
+
+	std::vector<DetailInfo> details;
+	double volume = 0;
+	double frozen = 0;
+	double closeprofit = 0;
+	double dynprofit = 0;
+	double fees = 0;
+
+	//按照最新价更新浮盈，以及每条明细的最大浮盈浮亏
+	auto update_dyn = [&](double price) {
+		dynprofit = 0;
+		for (DetailInfo& dInfo : details)
+		{
+			double profit = dInfo._volume*(price - dInfo._price)*volScale*(dInfo._long ? 1 : -1);
+			if (profit > 0)
+				dInfo._max_profit = std::max(profit, dInfo._max_profit);
+			else if (profit < 0)
+				dInfo._max_loss = std::min(profit, dInfo._max_loss);
+
+			dynprofit += profit;
+		}
+	};
+
+	auto add_trade = [&](uint64_t curTm, bool isLong, bool isOpen, double price, double qty, double fee, uint32_t barNo) {
+		TradeEvent evt = {};
+		evt._time = curTm;
+		evt._type = ET_Trade;
+		evt._code_idx = codeIdx;
+		evt._long = isLong;
+		evt._open = isOpen;
+		evt._price = price;
+		evt._qty = qty;
+		evt._fee = fee;
+		evt._barno = barNo;
+		_trades.emplace_back(evt);
+	};
+
+	auto open_detail = [&](bool isLong, double price, double qty, uint64_t curTm, uint32_t curTDate, uint32_t barNo) {
+		DetailInfo dInfo = {};
+		dInfo._long = isLong;
+		dInfo._price = price;
+		dInfo._volume = qty;
+		dInfo._opentime = curTm;
+		dInfo._opentdate = curTDate;
+		dInfo._open_barno = barNo;
+		details.emplace_back(dInfo);
+
+		double fee = _replayer->calc_fee(stdCode, price, qty, 0);
+		fees += fee;
+		add_trade(curTm, isLong, true, price, qty, fee, barNo);
+	};
+
+	//调整到目标仓位，逻辑和CtaMocker::do_set_position一致
+	auto do_fill = [&](double qty, double curPx, uint64_t curTm, uint32_t curTDate, uint32_t barNo) -> bool {
+		if (decimal::eq(volume, qty))
+			return true;
+
+		//T+1规则下，目标仓位不能小于冻结仓位
+		if (isT1 && decimal::lt(qty, frozen))
+		{
+			WTSLogger::error("New position of {} cannot be set to {} due to {} being frozen", stdCode, qty, frozen);
+			return false;
+		}
+
+		double diff = qty - volume;
+		bool isBuy = decimal::gt(diff, 0.0);
+		double trdPx = apply_slippage(curPx, isBuy, _slippage, _ratio_slippage, priceTick);
+
+		if (decimal::gt(volume*diff, 0))
+		{
+			//当前持仓和仓位变化方向一致，增加一条明细
+			volume = qty;
+			if (isT1)
+				frozen += diff;
+
+			open_detail(decimal::gt(qty, 0), trdPx, abs(diff), curTm, curTDate, barNo);
+			return true;
+		}
+
+		//持仓方向和仓位变化方向不一致，需要先平仓
+		double left = abs(diff);
+		volume = qty;
+		std::size_t count = 0;
+		for (DetailInfo& dInfo : details)
+		{
+			double maxQty = std::min(dInfo._volume, left);
+			if (decimal::eq(maxQty, 0))
+				continue;
+
+			double maxProf = dInfo._max_profit * maxQty / dInfo._volume;
+			double maxLoss = dInfo._max_loss * maxQty / dInfo._volume;
+
+			dInfo._volume -= maxQty;
+			left -= maxQty;
+
+			if (decimal::eq(dInfo._volume, 0))
+				count++;
+
+			double profit = (trdPx - dInfo._price) * maxQty * volScale;
+			if (!dInfo._long)
+				profit *= -1;
+			closeprofit += profit;
+
+			double fee = _replayer->calc_fee(stdCode, trdPx, maxQty, dInfo._opentdate == curTDate ? 2 : 1);
+			fees += fee;
+			add_trade(curTm, dInfo._long, false, trdPx, maxQty, fee, barNo);
+
+			TradeEvent evt = {};
+			evt._time = curTm;
+			evt._type = ET_Close;
+			evt._code_idx = codeIdx;
+			evt._long = dInfo._long;
+			evt._price = trdPx;
+			evt._qty = maxQty;
+			evt._profit = profit;
+			evt._max_profit = maxProf;
+			evt._max_loss = maxLoss;
+			evt._opentime = dInfo._opentime;
+			evt._openprice = dInfo._price;
+			evt._open_barno = dInfo._open_barno;
+			evt._barno = barNo;
+			_trades.emplace_back(evt);
+
+			if (decimal::eq(left, 0))
+				break;
+		}
+
+		//平完的明细都在前面，直接清理掉
+		details.erase(details.begin(), details.begin() + count);
+
+		//还有剩余的，则需要反手
+		if (decimal::gt(left, 0))
+		{
+			if (isT1)
+				frozen += left;
+
+			open_detail(decimal::gt(qty, 0), trdPx, left, curTm, curTDate, barNo);
+		}
+
+		return true;
+	};
+
+	double lastTarget = 0;
+	double pending = 0;
+	bool hasPending = false;
+	for (uint32_t i = 0; i < task._count; i++)
+	{
+		const WTSBarStruct& bar = task._bars[i];
+		uint32_t barNo = i + 1;
+
+		//分钟线的time是(date-19900000)*10000+HHMM，日线用收盘时间
+		uint64_t curTm = isDay ? ((uint64_t)bar.date * 10000 + closeTime) : ((uint64_t)bar.time + 199000000000);
+
+		//交易日切换，先记下上一个交易日的状态，再释放冻结仓位
+		if (i > 0 && bar.date != task._bars[i - 1].date)
+		{
+			days.emplace_back(DayState{ task._bars[i - 1].date, volume, closeprofit, dynprofit, fees });
+			frozen = 0;
+		}
+
+		//上一根K线的信号，在这根K线的开盘价成交
+		if (hasPending)
+		{
+			hasPending = false;
+			if (!do_fill(pending, bar.open, curTm, bar.date, barNo))
+				lastTarget = volume;
+		}
+
+		update_dyn(bar.close);
+
+		double target = task._targets[i];
+		if (std::isnan(target) || decimal::eq(target, lastTarget))
+			continue;
+
+		if (!canShort && decimal::lt(target, 0))
+		{
+			WTSLogger::error("Cannot short on {}, target {} at bar {} ignored", stdCode, target, barNo);
+			continue;
+		}
+
+		SignalEvent sig;
+		sig._gentime = (curTm / 10000) * 1000000000 + (curTm % 10000) * 100000;
+		sig._code_idx = codeIdx;
+		sig._target = target;
+		sig._price = bar.close;
+		_signals.emplace_back(sig);
+
+		lastTarget = target;
+		if (_fill_mode == FM_Close)
+		{
+			if (!do_fill(target, bar.close, curTm, bar.date, barNo))
+				lastTarget = volume;
+			update_dyn(bar.close);
+		}
+		else
+		{
+			pending = target;
+			hasPending = true;
+		}
+	}
+
+	if (task._count > 0)
+		days.emplace_back(DayState{ task._bars[task._count - 1].date, volume, closeprofit, dynprofit, fees });
+
+	if (hasPending)
+		WTSLogger::warn("Last target {} of {} has no next bar to fill, ignored", pending, stdCode);
+}
+
+void VecBacktester::dump_outputs(const std::vector<std::vector<DayState>>& dayStates)
+{
+	std::string folder = WtHelper::getOutputDir();
+	folder += _name;
+	folder += "/";
+	boost::filesystem::create_directories(folder.c_str());
+
+	bool bBinary = _replayer->is_binary_output();
+	_trade_logs.open((folder + "trades").c_str(), bBinary);
+	_close_logs.open((folder + "closes").c_str(), bBinary);
+	_fund_logs.open((folder + "funds").c_str(), bBinary);
+	_sig_logs.open((folder + "signals").c_str(), bBinary);
+	_pos_logs.open((folder + "positions").c_str(), bBinary);
+
+	//各合约的记录按时间合并，同一时间保持合约内部的先后顺序
+	std::stable_sort(_trades.begin(), _trades.end(), [](const TradeEvent& a, const TradeEvent& b) {
+		return a._time < b._time;
+	});
+
+	double totalProfit = 0;
+	double totalFees = 0;
+	for (const TradeEvent& evt : _trades)
+	{
+		const CodeTask& task = _tasks[evt._code_idx];
+		if (evt._type == ET_Trade)
+		{
+			totalFees += evt._fee;
+			_trade_logs << task._code << evt._time << (evt._long ? "LONG" : "SHORT") << (evt._open ? "OPEN" : "CLOSE")
+				<< evt._price << evt._qty << task._usertag << evt._fee << evt._barno;
+			_trade_logs.end_row();
+		}
+		else
+		{
+			totalProfit += evt._profit;
+			_close_logs << task._code << (evt._long ? "LONG" : "SHORT") << evt._opentime << evt._openprice
+				<< evt._time << evt._price << evt._qty << evt._profit << evt._max_profit << evt._max_loss
+				<< totalProfit - totalFees << task._usertag << task._usertag << evt._open_barno << evt._barno;
+			_close_logs.end_row();
+		}
+	}
+
+	std::stable_sort(_signals.begin(), _signals.end(), [](const SignalEvent& a, const SignalEvent& b) {
+		return a._gentime < b._gentime;
+	});
+
+	for (const SignalEvent& sig : _signals)
+	{
+		const CodeTask& task = _tasks[sig._code_idx];
+		_sig_logs << task._code << sig._target << sig._price << sig._gentime << task._usertag;
+		_sig_logs.end_row();
+	}
+
+	//资金和持仓按所有合约的交易日合并，某个合约当天没有K线就沿用之前的状态
+	std::vector<uint32_t> dates;
+	for (const auto& states : dayStates)
+	{
+		for (const DayState& ds : states)
+			dates.emplace_back(ds._tdate);
+	}
+	std::sort(dates.begin(), dates.end());
+	dates.erase(std::unique(dates.begin(), dates.end()), dates.end());
+
+	std::vector<std::size_t> cursors(dayStates.size(), 0);
+	std::vector<const DayState*> lasts(dayStates.size(), NULL);
+	for (uint32_t curDate : dates)
+	{
+		double closeprofit = 0;
+		double dynprofit = 0;
+		double fees = 0;
+		for (std::size_t idx = 0; idx < dayStates.size(); idx++)
+		{
+			const std::vector<DayState>& states = dayStates[idx];
+			std::size_t& cursor = cursors[idx];
+			while (cursor < states.size() && states[cursor]._tdate <= curDate)
+			{
+				lasts[idx] = &states[cursor];
+				cursor++;
+			}
+
+			const DayState* ds = lasts[idx];
+			if (ds == NULL)
+				continue;
+
+			closeprofit += ds->_closeprofit;
+			dynprofit += ds->_dynprofit;
+			fees += ds->_fees;
+
+			if (decimal::eq(ds->_volume, 0.0))
+				continue;
+
+			_pos_logs << curDate << _tasks[idx]._code << ds->_volume << ds->_closeprofit << ds->_dynprofit;
+			_pos_logs.end_row();
+		}
+
+		_fund_logs << curDate << closeprofit << dynprofit << closeprofit + dynprofit - fees << fees;
+		_fund_logs.end_row();
+	}
+
+	_trade_logs.close();
+	_close_logs.close();
+	_fund_logs.close();
+	_sig_logs.close();
+	_pos_logs.close();
+}
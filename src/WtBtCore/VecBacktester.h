@@ -0,0 +1,153 @@
+﻿/*!
+ * \file VecBacktester.h
+ * \project	WonderTrader
+ *
+ * \brief 向量化信号回测器
+ *
+ * 策略事先算好每根K线对应的目标仓位数组，回测器直接按数组循环撮合，不再逐根K线回放和回调策略
+ * 滑点、手续费、T+1和做空限制的处理和CtaMocker保持一致，输出的成交、平仓、资金、信号和持仓表格式也和CtaMocker完全相同
+ */
+#pragma once
+#include <string>
+#include <vector>
+
+#include "BtOutputTable.h"
+#include "../Includes/WTSMarcos.h"
+
+NS_WTP_BEGIN
+struct WTSBarStruct;
+NS_WTP_END
+
+USING_NS_WTP;
+
+class HisDataReplayer;
+
+class VecBacktester
+{
+public:
+	typedef enum tagFillMode
+	{
+		FM_Close = 0,	//信号K线的收盘价成交
+		FM_NextOpen		//下一根K线的开盘价成交
+	} FillMode;
+
+public:
+	VecBacktester(HisDataReplayer* replayer, const char* name, int32_t slippage = 0, bool isRatioSlp = false, FillMode fillMode = FM_Close);
+	~VecBacktester();
+
+public:
+	/*
+	 *	获取回测区间内的K线，目标仓位数组要和这里返回的K线一一对应
+	 *	@period	周期，如m1、m5、d1
+	 *	@count	返回的K线条数
+	 */
+	WTSBarStruct*	get_bars(const char* stdCode, const char* period, uint32_t& count);
+
+	/*
+	 *	添加一个合约的目标仓位数组，同一个合约重复添加会覆盖之前的数组
+	 *	目标仓位为NaN的K线表示不调整仓位
+	 *	@targets	目标仓位数组，长度必须和get_bars返回的K线条数一致
+	 */
+	bool	add_targets(const char* stdCode, const char* period, const double* targets, uint32_t count, const char* userTag = "");
+
+	/*
+	 *	运行回测并输出结果表
+	 */
+	bool	run();
+
+	inline const char* name() const { return _name.c_str(); }
+
+private:
+	typedef struct _CodeTask
+	{
+		std::string			_code;
+		std::string			_period;
+		std::string			_usertag;
+		std::vector<double>	_targets;
+		WTSBarStruct*		_bars;
+		uint32_t			_count;
+
+		_CodeTask() :_bars(NULL), _count(0){}
+	} CodeTask;
+
+	typedef struct _DetailInfo
+	{
+		bool		_long;
+		double		_price;
+		double		_volume;
+		uint64_t	_opentime;
+		uint32_t	_opentdate;
+		double		_max_profit;
+		double		_max_loss;
+		uint32_t	_open_barno;
+	} DetailInfo;
+
+	//每个交易日结束时单个合约的状态，都是累计值
+	typedef struct _DayState
+	{
+		uint32_t	_tdate;
+		double		_volume;
+		double		_closeprofit;
+		double		_dynprofit;
+		double		_fees;
+	} DayState;
+
+	typedef enum tagEventType
+	{
+		ET_Trade,
+		ET_Close
+	} EventType;
+
+	//成交和平仓记录，所有合约跑完以后按时间合并输出
+	typedef struct _TradeEvent
+	{
+		uint64_t	_time;
+		uint32_t	_type;
+		uint32_t	_code_idx;
+		bool		_long;
+		bool		_open;
+		double		_price;
+		double		_qty;
+		double		_fee;
+		double		_profit;
+		double		_max_profit;
+		double		_max_loss;
+		uint64_t	_opentime;
+		double		_openprice;
+		uint32_t	_open_barno;
+		uint32_t	_barno;
+	} TradeEvent;
+
+	typedef struct _SignalEvent
+	{
+		uint64_t	_gentime;
+		uint32_t	_code_idx;
+		double		_target;
+		double		_price;
+	} SignalEvent;
+
+private:
+	/*
+	 *	单个合约的回测主循环
+	 */
+	void	run_code(uint32_t codeIdx, std::vector<DayState>& days);
+
+	void	dump_outputs(const std::vector<std::vector<DayState>>& dayStates);
+
+private:
+	HisDataReplayer*	_replayer;
+	std::string			_name;
+	int32_t				_slippage;
+	bool				_ratio_slippage;
+	FillMode			_fill_mode;
+
+	std::vector<CodeTask>		_tasks;
+	std::vector<TradeEvent>		_trades;
+	std::vector<SignalEvent>	_signals;
+
+	BtOutputTable		_trade_logs;
+	BtOutputTable		_close_logs;
+	BtOutputTable		_fund_logs;
+	BtOutputTable		_sig_logs;
+	BtOutputTable		_pos_logs;
+};
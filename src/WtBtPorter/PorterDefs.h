@@ -71,3 +71,14 @@ typedef bool(PORTER_FLAG *FuncLoadFnlBars)(const char* stdCode, const char* peri
 typedef bool(PORTER_FLAG *FuncLoadRawBars)(const char* stdCode, const char* period);
 typedef bool(PORTER_FLAG *FuncLoadAdjFactors)(const char* stdCode);
 typedef bool(PORTER_FLAG *FuncLoadRawTicks)(const char* stdCode, uint32_t uDate);
+
+//外部数据释放回调，回放器不再引用外部数据的时候调用
+typedef void(PORTER_FLAG *FuncReleaseBuffer)(void* ctx);
+
+/*
+ *	拉取式加载器，回放器分块拉取数据，加载器直接写到回放器的缓存里
+ *	buffer为NULL的时候，返回总条数，否则往buffer里写最多capacity条，返回实际写入的条数
+ *	@offset	本块在全部数据中的起始位置
+ */
+typedef WtUInt32(PORTER_FLAG *FuncPullBars)(const char* stdCode, const char* period, WTSBarStruct* buffer, WtUInt32 offset, WtUInt32 capacity);
+typedef WtUInt32(PORTER_FLAG *FuncPullTicks)(const char* stdCode, WtUInt32 uDate, WTSTickStruct* buffer, WtUInt32 offset, WtUInt32 capacity);
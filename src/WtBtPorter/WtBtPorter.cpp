@@ -14,6 +14,8 @@
 #include "../WtBtCore/CtaMocker.h"
 #include "../WtBtCore/SelMocker.h"
 #include "../WtBtCore/HftMocker.h"
+#include "../WtBtCore/BtOutputTable.h"
+#include "../WtBtCore/VecBacktester.h"
 
 #include "../WTSTools/WTSLogger.h"
 
@@ -76,6 +78,21 @@ void feed_raw_ticks(WTSTickStruct* ticks, WtUInt32 count)
 	getRunner().feedRawTicks(ticks, count);
 }
 
+void feed_raw_bars_ref(WTSBarStruct* bars, WtUInt32 count, FuncReleaseBuffer releaser, void* ctx)
+{
+	getRunner().feedRawBarsRef(bars, count, releaser, ctx);
+}
+
+void feed_raw_ticks_ref(WTSTickStruct* ticks, WtUInt32 count, FuncReleaseBuffer releaser, void* ctx)
+{
+	getRunner().feedRawTicksRef(ticks, count, releaser, ctx);
+}
+
+void register_ext_data_puller(FuncPullBars fnlBarPuller, FuncPullBars rawBarPuller, FuncPullTicks tickPuller, WtUInt32 chunkSize, bool bAutoTrans)
+{
+	getRunner().registerExtDataPuller(fnlBarPuller, rawBarPuller, tickPuller, chunkSize, bAutoTrans);
+}
+
 void init_backtest(const char* logProfile, bool isFile, const char* outDir)
 {
 	static bool inited = false;
@@ -116,6 +133,11 @@ void run_backtest(bool bNeedDump, bool bAsync)
 	getRunner().run(bNeedDump, bAsync);
 }
 
+void run_backtest_stepping(bool bNeedDump)
+{
+	getRunner().run_stepping(bNeedDump);
+}
+
 void stop_backtest()
 {
 	getRunner().stop();
@@ -152,6 +174,59 @@ void clear_cache()
 	getRunner().clear_cache();
 }
 
+bool convert_bt_output(const char* binFile, const char* csvFile, WtUInt32 sDate, WtUInt32 eDate)
+{
+	return BtOutputTable::convert_to_csv(binFile, csvFile, sDate, eDate);
+}
+
+#pragma region "向量化回测接口"
+bool init_vec_backtester(const char* name, int slippage, bool bRatioSlp, WtUInt32 fillMode)
+{
+	return getRunner().initVecBacktester(name, slippage, bRatioSlp, fillMode);
+}
+
+WtUInt32 vec_get_bars(const char* stdCode, const char* period, FuncGetBarsCallback cb)
+{
+	VecBacktester* tester = getRunner().vec_tester();
+	if (tester == NULL)
+		return 0;
+
+	uint32_t count = 0;
+	WTSBarStruct* bars = tester->get_bars(stdCode, period, count);
+	if (bars == NULL)
+		return 0;
+
+	cb(0, stdCode, period, bars, count, true);
+	return count;
+}
+
+bool vec_add_targets(const char* stdCode, const char* period, double* targets, WtUInt32 count, const char* userTag)
+{
+	VecBacktester* tester = getRunner().vec_tester();
+	if (tester == NULL)
+		return false;
+
+	return tester->add_targets(stdCode, period, targets, count, userTag);
+}
+
+bool run_vec_backtest()
+{
+	VecBacktester* tester = getRunner().vec_tester();
+	if (tester == NULL)
+		return false;
+
+	try
+	{
+		return tester->run();
+	}
+	catch (...)
+	{
+		WTSLogger::error("Exception raised while running vectorized backtest");
+		return false;
+	}
+}
+#pragma endregion "向量化回测接口"
+
 void write_log(WtUInt32 level, const char* message, const char* catName)
 {
 	if (strlen(catName) > 0)
@@ -257,7 +332,16 @@ WtUInt32	cta_get_ticks(CtxHandler cHandle, const char* stdCode, WtUInt32 tickCnt
 		{
 			uint32_t thisCnt = min(tickCnt, (WtUInt32)tData->size());
 			if (thisCnt != 0)
-				cb(cHandle, stdCode, (WTSTickStruct*)tData->at(0), thisCnt, true);
+			{
+				//盘中封存过的数据会分成多个数据块，逐块回调
+				uint32_t left = thisCnt;
+				for (std::size_t i = 0; i < tData->get_block_counts() && left > 0; i++)
+				{
+					uint32_t blkCnt = min(left, tData->get_block_size(i));
+					left -= blkCnt;
+					cb(cHandle, stdCode, tData->get_block_addr(i), blkCnt, left == 0);
+				}
+			}
 			else
 				cb(cHandle, stdCode, NULL, 0, true);
 
@@ -496,15 +580,19 @@ void cta_sub_bar_events(CtxHandler cHandle, const char* stdCode, const char* per
 
 bool cta_step(CtxHandler cHandle)
 {
-	//只有异步模式才有意义
-	if (!getRunner().isAsync())
+	//只有异步模式和单步模式才有意义
+	if (!getRunner().isAsync() && !getRunner().isStepping())
 		return false;
 
 	CtaMocker* ctx = getRunner().cta_mocker();
 	if (ctx == NULL)
 		return false;
 
-	return ctx->step_calc();
+	bool ret = ctx->step_calc();
+	if (getRunner().finish_pending_stop())
+		return false;
+
+	return ret;
 }
 
 void cta_set_chart_kline(CtxHandler cHandle, const char* stdCode, const char* period)
@@ -697,7 +785,15 @@ WtUInt32	sel_get_ticks(CtxHandler cHandle, const char* stdCode, WtUInt32 tickCnt
 		{
 			uint32_t thisCnt = min(tickCnt, (WtUInt32)tData->size());
 			if (thisCnt != 0)
-				cb(cHandle, stdCode, (WTSTickStruct*)tData->at(0), thisCnt, true);
+			{
+				uint32_t left = thisCnt;
+				for (std::size_t i = 0; i < tData->get_block_counts() && left > 0; i++)
+				{
+					uint32_t blkCnt = min(left, tData->get_block_size(i));
+					left -= blkCnt;
+					cb(cHandle, stdCode, tData->get_block_addr(i), blkCnt, left == 0);
+				}
+			}
 			else
 				cb(cHandle, stdCode, NULL, 0, true);
 			tData->release();
@@ -934,7 +1030,15 @@ WtUInt32 hft_get_ticks(CtxHandler cHandle, const char* stdCode, WtUInt32 tickCnt
 		{
 			uint32_t thisCnt = min(tickCnt, (WtUInt32)tData->size());
 			if(thisCnt != 0)
-				cb(cHandle, stdCode, (WTSTickStruct*)tData->at(0), thisCnt, true);
+			{
+				uint32_t left = thisCnt;
+				for (std::size_t i = 0; i < tData->get_block_counts() && left > 0; i++)
+				{
+					uint32_t blkCnt = min(left, tData->get_block_size(i));
+					left -= blkCnt;
+					cb(cHandle, stdCode, tData->get_block_addr(i), blkCnt, left == 0);
+				}
+			}
 			else
 				cb(cHandle, stdCode, NULL, 0, true);
 			tData->release();
@@ -962,7 +1066,13 @@ WtUInt32 hft_get_ordque(CtxHandler cHandle, const char* stdCode, WtUInt32 itemCn
 		if (dataSlice)
 		{
 			uint32_t thisCnt = min(itemCnt, (WtUInt32)dataSlice->size());
-			cb(cHandle, stdCode, (WTSOrdQueStruct*)dataSlice->at(0), thisCnt, true);
+			uint32_t left = thisCnt;
+			for (std::size_t i = 0; i < dataSlice->get_block_counts() && left > 0; i++)
+			{
+				uint32_t blkCnt = min(left, dataSlice->get_block_size(i));
+				left -= blkCnt;
+				cb(cHandle, stdCode, dataSlice->get_block_addr(i), blkCnt, left == 0);
+			}
 			dataSlice->release();
 			return thisCnt;
 		}
@@ -988,7 +1098,13 @@ WtUInt32 hft_get_orddtl(CtxHandler cHandle, const char* stdCode, WtUInt32 itemCn
 		if (dataSlice)
 		{
 			uint32_t thisCnt = min(itemCnt, (WtUInt32)dataSlice->size());
-			cb(cHandle, stdCode, (WTSOrdDtlStruct*)dataSlice->at(0), thisCnt, true);
+			uint32_t left = thisCnt;
+			for (std::size_t i = 0; i < dataSlice->get_block_counts() && left > 0; i++)
+			{
+				uint32_t blkCnt = min(left, dataSlice->get_block_size(i));
+				left -= blkCnt;
+				cb(cHandle, stdCode, dataSlice->get_block_addr(i), blkCnt, left == 0);
+			}
 			dataSlice->release();
 			return thisCnt;
 		}
@@ -1014,7 +1130,13 @@ WtUInt32 hft_get_trans(CtxHandler cHandle, const char* stdCode, WtUInt32 itemCnt
 		if (dataSlice)
 		{
 			uint32_t thisCnt = min(itemCnt, (WtUInt32)dataSlice->size());
-			cb(cHandle, stdCode, (WTSTransStruct*)dataSlice->at(0), thisCnt, true);
+			uint32_t left = thisCnt;
+			for (std::size_t i = 0; i < dataSlice->get_block_counts() && left > 0; i++)
+			{
+				uint32_t blkCnt = min(left, dataSlice->get_block_size(i));
+				left -= blkCnt;
+				cb(cHandle, stdCode, dataSlice->get_block_addr(i), blkCnt, left == 0);
+			}
 			dataSlice->release();
 			return thisCnt;
 		}
@@ -1180,8 +1302,8 @@ WtString hft_load_userdata(CtxHandler cHandle, const char* key, const char* defV
 
 void hft_step(CtxHandler cHandle)
 {
-	//只有异步模式才有意义
-	if (!getRunner().isAsync())
+	//只有异步模式和单步模式才有意义
+	if (!getRunner().isAsync() && !getRunner().isStepping())
 		return;
 
 	HftMocker* mocker = getRunner().hft_mocker();
@@ -1189,5 +1311,6 @@ void hft_step(CtxHandler cHandle)
 		return;
 
 	mocker->step_tick();
+	getRunner().finish_pending_stop();
 }
 #pragma endregion "HFT策略接口"
\ No newline at end of file
@@ -33,6 +33,20 @@ extern "C"
 
 	EXPORT_FLAG void		feed_raw_ticks(WTSTickStruct* ticks, WtUInt32 count);
 
+	/*
+	 *	以引用的方式喂数据，回放器直接使用调用方的内存，不做拷贝
+	 *	调用方要保证数据在releaser(ctx)被调用之前一直有效
+	 */
+	EXPORT_FLAG void		feed_raw_bars_ref(WTSBarStruct* bars, WtUInt32 count, FuncReleaseBuffer releaser, void* ctx);
+
+	EXPORT_FLAG void		feed_raw_ticks_ref(WTSTickStruct* ticks, WtUInt32 count, FuncReleaseBuffer releaser, void* ctx);
+
+	/*
+	 *	注册拉取式加载器，回放器按块拉取数据，加载器直接写到回放器的缓存里
+	 *	@chunkSize	每次拉取的最大条数，0则使用默认值
+	 */
+	EXPORT_FLAG void		register_ext_data_puller(FuncPullBars fnlBarPuller, FuncPullBars rawBarPuller, FuncPullTicks tickPuller, WtUInt32 chunkSize, bool bAutoTrans);
+
 	EXPORT_FLAG void		feed_adj_factors(WtString stdCode, WtUInt32* dates, double* factors, WtUInt32 count);
 
 	EXPORT_FLAG	void		init_backtest(const char* logProfile, bool isFile, const char* outDir);
@@ -51,6 +65,12 @@ extern "C"
 
 	EXPORT_FLAG	void		run_backtest(bool bNeedDump, bool bAsync);
 
+	/*
+	 *	单步模式运行回测，由cta_step/hft_step在调用线程里推进回放
+	 *	没有回放线程，每一步没有线程切换、锁和日志
+	 */
+	EXPORT_FLAG	void		run_backtest_stepping(bool bNeedDump);
+
 	EXPORT_FLAG	void		write_log(WtUInt32 level, const char* message, const char* catName);
 
 	EXPORT_FLAG	WtString	get_version();
@@ -63,6 +83,38 @@ extern "C"
 
 	EXPORT_FLAG	WtString	get_raw_stdcode(const char* stdCode);
 
+	/*
+	 *	将列式二进制格式的回测结果文件(.wtc)转换成csv格式
+	 *	sDate和eDate为0时不限制日期
+	 */
+	EXPORT_FLAG	bool		convert_bt_output(const char* binFile, const char* csvFile, WtUInt32 sDate, WtUInt32 eDate);
+
+	//////////////////////////////////////////////////////////////////////////
+	//向量化回测接口
+	//策略在外部算好每根K线的目标仓位，直接按数组撮合，不走逐K线回放
+#pragma region "向量化回测接口"
+	/*
+	 *	初始化向量化回测器，需要先调用config_backtest
+	 *	@fillMode	成交方式，0-信号K线收盘价成交，1-下一根K线开盘价成交
+	 */
+	EXPORT_FLAG	bool		init_vec_backtester(const char* name, int slippage, bool bRatioSlp, WtUInt32 fillMode);
+
+	/*
+	 *	获取回测区间内的K线，目标仓位数组要和这些K线一一对应
+	 */
+	EXPORT_FLAG	WtUInt32	vec_get_bars(const char* stdCode, const char* period, FuncGetBarsCallback cb);
+
+	/*
+	 *	添加一个合约的目标仓位数组，NaN表示不调整仓位
+	 */
+	EXPORT_FLAG	bool		vec_add_targets(const char* stdCode, const char* period, double* targets, WtUInt32 count, const char* userTag);
+
+	/*
+	 *	运行向量化回测，结果表和CTA回测的格式一致
+	 */
+	EXPORT_FLAG	bool		run_vec_backtest();
+#pragma endregion "向量化回测接口"
+
 
 	//////////////////////////////////////////////////////////////////////////
 	//CTA策略接口
@@ -13,8 +13,11 @@
 #include "ExpHftMocker.h"
 
 #include <iomanip>
+#include <functional>
 
 #include "../WtBtCore/ExecMocker.h"
+#include "../WtBtCore/VecBacktester.h"
+#include "../WtBtCore/BtCoroutine.h"
 #include "../WtBtCore/WtHelper.h"
 
 #include "../Share/TimeUtils.hpp"
@@ -44,10 +47,7 @@ const char* getModuleName()
 #endif
 
 WtBtRunner::WtBtRunner()
-	: _cta_mocker(NULL)
-	, _sel_mocker(NULL)
-
-	, _cb_cta_init(NULL)
+	: _cb_cta_init(NULL)
 	, _cb_cta_tick(NULL)
 	, _cb_cta_calc(NULL)
 	, _cb_cta_calc_done(NULL)
@@ -80,10 +80,26 @@ WtBtRunner::WtBtRunner()
 	, _ext_raw_bar_loader(NULL)
 	, _ext_adj_fct_loader(NULL)
 	, _ext_tick_loader(NULL)
+	, _ext_fnl_bar_puller(NULL)
+	, _ext_raw_bar_puller(NULL)
+	, _ext_tick_puller(NULL)
+	, _pull_chunk_size(0)
+
+	, _cta_mocker(NULL)
+	, _sel_mocker(NULL)
+	, _vec_tester(NULL)
 
 	, _inited(false)
 	, _running(false)
 	, _async(false)
+	, _stop_pending(false)
+
+	, _feed_obj(NULL)
+	, _feeder_bars(NULL)
+	, _feeder_ticks(NULL)
+	, _feeder_fcts(NULL)
+	, _feeder_bars_ref(NULL)
+	, _feeder_ticks_ref(NULL)
 {
 	install_signal_hooks([](const char* message) {
 		WTSLogger::error(message);
@@ -93,56 +109,170 @@ WtBtRunner::WtBtRunner()
 
 WtBtRunner::~WtBtRunner()
 {
+	if (_vec_tester)
+	{
+		delete _vec_tester;
+		_vec_tester = NULL;
+	}
+}
+
+inline const char* get_period_name(WTSKlinePeriod period)
+{
+	switch (period)
+	{
+	case KP_DAY: return "d1";
+	case KP_Minute1: return "m1";
+	case KP_Minute5: return "m5";
+	default: return NULL;
+	}
+}
+
+/*
+ *	分块拉取数据
+ *	先查询总条数，一次分配好缓存，再按块让加载器直接写到缓存里，中间不再有拷贝
+ */
+template<typename T>
+std::vector<T>* pull_chunks(std::function<uint32_t(T*, uint32_t, uint32_t)> puller, uint32_t chunkSize)
+{
+	uint32_t total = puller(NULL, 0, 0);
+	if (total == 0)
+		return NULL;
+
+	std::vector<T>* items = new std::vector<T>(total);
+	uint32_t offset = 0;
+	while (offset < total)
+	{
+		uint32_t capacity = std::min(chunkSize, total - offset);
+		uint32_t count = puller(items->data() + offset, offset, capacity);
+		if (count == 0)
+			break;
+
+		offset += std::min(count, capacity);
+	}
+
+	if (offset < total)
+		items->resize(offset);
+
+	return items;
+}
+
+template<typename T>
+void release_chunks(void* ctx)
+{
+	delete (std::vector<T>*)ctx;
+}
+
+const uint32_t DEFAULT_PULL_CHUNK = 64 * 1024;
+
+bool WtBtRunner::pullBars(FuncPullBars puller, void* obj, const char* stdCode, WTSKlinePeriod period, FuncReadBars cb, FuncRefBars cbRef)
+{
+	const char* pname = get_period_name(period);
+	if (pname == NULL)
+	{
+		WTSLogger::error("Unsupported period of extended data loader");
+		return false;
+	}
+
+	uint32_t chunkSize = (_pull_chunk_size == 0) ? DEFAULT_PULL_CHUNK : _pull_chunk_size;
+	std::vector<WTSBarStruct>* bars = pull_chunks<WTSBarStruct>([puller, stdCode, pname](WTSBarStruct* buffer, uint32_t offset, uint32_t capacity) {
+		return puller(stdCode, pname, buffer, offset, capacity);
+	}, chunkSize);
+	if (bars == NULL)
+		return false;
+
+	//拉取的缓存直接交给回放器，回放器释放的时候再回收
+	if (cbRef != NULL)
+	{
+		cbRef(obj, bars->data(), (uint32_t)bars->size(), release_chunks<WTSBarStruct>, bars);
+	}
+	else
+	{
+		cb(obj, bars->data(), (uint32_t)bars->size());
+		delete bars;
+	}
+	return true;
+}
+
+bool WtBtRunner::pullTicks(void* obj, const char* stdCode, uint32_t uDate, FuncReadTicks cb, FuncRefTicks cbRef)
+{
+	FuncPullTicks puller = _ext_tick_puller;
+	uint32_t chunkSize = (_pull_chunk_size == 0) ? DEFAULT_PULL_CHUNK : _pull_chunk_size;
+	std::vector<WTSTickStruct>* ticks = pull_chunks<WTSTickStruct>([puller, stdCode, uDate](WTSTickStruct* buffer, uint32_t offset, uint32_t capacity) {
+		return puller(stdCode, uDate, buffer, offset, capacity);
+	}, chunkSize);
+	if (ticks == NULL)
+		return false;
+
+	if (cbRef != NULL)
+	{
+		cbRef(obj, ticks->data(), (uint32_t)ticks->size(), release_chunks<WTSTickStruct>, ticks);
+	}
+	else
+	{
+		cb(obj, ticks->data(), (uint32_t)ticks->size());
+		delete ticks;
+	}
+	return true;
 }
 
 bool WtBtRunner::loadRawHisBars(void* obj, const char* stdCode, WTSKlinePeriod period, FuncReadBars cb)
+{
+	return loadRawHisBarsRef(obj, stdCode, period, cb, NULL);
+}
+
+bool WtBtRunner::loadRawHisBarsRef(void* obj, const char* stdCode, WTSKlinePeriod period, FuncReadBars cb, FuncRefBars cbRef)
 {
 	StdUniqueLock lock(_feed_mtx);
+	if (_ext_raw_bar_puller != NULL)
+		return pullBars(_ext_raw_bar_puller, obj, stdCode, period, cb, cbRef);
+
 	if (_ext_raw_bar_loader == NULL)
 		return false;
 
+	const char* pname = get_period_name(period);
+	if (pname == NULL)
+	{
+		WTSLogger::error("Unsupported period of extended data loader");
+		return false;
+	}
+
 	_feed_obj = obj;
 	_feeder_bars = cb;
+	_feeder_bars_ref = cbRef;
 
-	switch (period)
-	{
-	case KP_DAY:
-        return _ext_raw_bar_loader(stdCode, "d1");
-	case KP_Minute1:
-        return _ext_raw_bar_loader(stdCode, "m1");
-	case KP_Minute5:
-        return _ext_raw_bar_loader(stdCode, "m5");
-	default:
-		{
-			WTSLogger::error("Unsupported period of extended data loader");
-			return false;
-		}
-	}
+	bool ret = _ext_raw_bar_loader(stdCode, pname);
+	_feeder_bars_ref = NULL;
+	return ret;
 }
 
 bool WtBtRunner::loadFinalHisBars(void* obj, const char* stdCode, WTSKlinePeriod period, FuncReadBars cb)
+{
+	return loadFinalHisBarsRef(obj, stdCode, period, cb, NULL);
+}
+
+bool WtBtRunner::loadFinalHisBarsRef(void* obj, const char* stdCode, WTSKlinePeriod period, FuncReadBars cb, FuncRefBars cbRef)
 {
 	StdUniqueLock lock(_feed_mtx);
+	if (_ext_fnl_bar_puller != NULL)
+		return pullBars(_ext_fnl_bar_puller, obj, stdCode, period, cb, cbRef);
+
 	if (_ext_fnl_bar_loader == NULL)
 		return false;
 
+	const char* pname = get_period_name(period);
+	if (pname == NULL)
+	{
+		WTSLogger::error("Unsupported period of extended data loader");
+		return false;
+	}
+
 	_feed_obj = obj;
 	_feeder_bars = cb;
+	_feeder_bars_ref = cbRef;
 
-	switch (period)
-	{
-	case KP_DAY:
-		return _ext_fnl_bar_loader(stdCode, "d1");
-	case KP_Minute1:
-		return _ext_fnl_bar_loader(stdCode, "m1");
-	case KP_Minute5:
-		return _ext_fnl_bar_loader(stdCode, "m5");
-	default:
-		{
-			WTSLogger::error("Unsupported period of extended data loader");
-			return false;
-		}
-	}
+	bool ret = _ext_fnl_bar_loader(stdCode, pname);
+	_feeder_bars_ref = NULL;
+	return ret;
 }
 
 bool WtBtRunner::loadAllAdjFactors(void* obj, FuncReadFactors cb)
@@ -170,15 +300,26 @@ bool WtBtRunner::loadAdjFactors(void* obj, const char* stdCode, FuncReadFactors
 }
 
 bool WtBtRunner::loadRawHisTicks(void* obj, const char* stdCode, uint32_t uDate, FuncReadTicks cb)
+{
+	return loadRawHisTicksRef(obj, stdCode, uDate, cb, NULL);
+}
+
+bool WtBtRunner::loadRawHisTicksRef(void* obj, const char* stdCode, uint32_t uDate, FuncReadTicks cb, FuncRefTicks cbRef)
 {
 	StdUniqueLock lock(_feed_mtx);
+	if (_ext_tick_puller != NULL)
+		return pullTicks(obj, stdCode, uDate, cb, cbRef);
+
 	if (_ext_tick_loader == NULL)
 		return false;
 
 	_feed_obj = obj;
 	_feeder_ticks = cb;
+	_feeder_ticks_ref = cbRef;
 
-	return _ext_tick_loader(stdCode, uDate);
+	bool ret = _ext_tick_loader(stdCode, uDate);
+	_feeder_ticks_ref = NULL;
+	return ret;
 }
 
 void WtBtRunner::feedRawBars(WTSBarStruct* bars, uint32_t count)
@@ -192,6 +333,47 @@ void WtBtRunner::feedRawBars(WTSBarStruct* bars, uint32_t count)
 	_feeder_bars(_feed_obj, bars, count);
 }
 
+void WtBtRunner::feedRawBarsRef(WTSBarStruct* bars, uint32_t count, FuncReleaseBuffer releaser, void* ctx)
+{
+	if (_ext_fnl_bar_loader == NULL && _ext_raw_bar_loader == NULL)
+	{
+		WTSLogger::error("Cannot feed bars because of no extented bar loader registered.");
+		return;
+	}
+
+	//当前加载的数据不支持引用的话（比如需要拼接的主力合约），就拷贝一份，然后马上释放
+	if (_feeder_bars_ref != NULL)
+	{
+		_feeder_bars_ref(_feed_obj, bars, count, releaser, ctx);
+	}
+	else
+	{
+		_feeder_bars(_feed_obj, bars, count);
+		if (releaser)
+			releaser(ctx);
+	}
+}
+
+void WtBtRunner::feedRawTicksRef(WTSTickStruct* ticks, uint32_t count, FuncReleaseBuffer releaser, void* ctx)
+{
+	if (_ext_tick_loader == NULL)
+	{
+		WTSLogger::error("Cannot feed ticks because of no extented tick loader registered.");
+		return;
+	}
+
+	if (_feeder_ticks_ref != NULL)
+	{
+		_feeder_ticks_ref(_feed_obj, ticks, count, releaser, ctx);
+	}
+	else
+	{
+		_feeder_ticks(_feed_obj, ticks, count);
+		if (releaser)
+			releaser(ctx);
+	}
+}
+
 void WtBtRunner::feedAdjFactors(const char* stdCode, uint32_t* dates, double* factors, uint32_t count)
 {
 	if(_ext_adj_fct_loader == NULL)
@@ -314,6 +496,19 @@ uint32_t WtBtRunner::initSelMocker(const char* name, uint32_t date, uint32_t tim
 	return _sel_mocker->id();
 }
 
+bool WtBtRunner::initVecBacktester(const char* name, int32_t slippage /* = 0 */, bool isRatioSlp /* = false */, uint32_t fillMode /* = 0 */)
+{
+	if (_vec_tester)
+	{
+		delete _vec_tester;
+		_vec_tester = NULL;
+	}
+
+	_vec_tester = new VecBacktester(&_replayer, name, slippage, isRatioSlp, (VecBacktester::FillMode)fillMode);
+	WTSLogger::info("Vectorized backtester {} initialized, filled at {}", name, fillMode == 0 ? "close of signal bar" : "open of next bar");
+	return true;
+}
+
 void WtBtRunner::ctx_on_bar(uint32_t id, const char* stdCode, const char* period, WTSBarStruct* newBar, EngineType eType/*= ET_CTA*/)
 {
 	switch (eType)
@@ -466,7 +661,7 @@ void WtBtRunner::config(const char* cfgFile, bool isFile /* = true */)
 	//初始化事件推送器
 	initEvtNotifier(_cfg->get("notifier"));
 
-	_replayer.init(_cfg->get("replayer"), &_notifier, _ext_fnl_bar_loader != NULL ? this : NULL);
+	_replayer.init(_cfg->get("replayer"), &_notifier, (_ext_fnl_bar_loader != NULL || _ext_fnl_bar_puller != NULL) ? this : NULL);
 
 	WTSVariant* cfgEnv = _cfg->get("env");
 	const char* mode = cfgEnv->getCString("mocker");
@@ -549,8 +744,84 @@ void WtBtRunner::run(bool bNeedDump /* = false */, bool bAsync /* = false */)
 	}
 }
 
+void WtBtRunner::run_stepping(bool bNeedDump /* = false */)
+{
+	if (_running)
+		return;
+
+	if (_cta_mocker == NULL && _hft_mocker == NULL)
+	{
+		WTSLogger::error("Stepping mode is only supported by CTA and HFT backtesting");
+		return;
+	}
+
+	_async = false;
+
+	WTSLogger::info("Backtesting will run in stepping mode");
+
+	_stepper.reset(new BtCoroutine([this, bNeedDump]() {
+		_replayer.run(bNeedDump);
+		WTSLogger::debug("Stepping backtest finished");
+		_running = false;
+	}));
+
+	//单步模式一定要启用钩子
+	if (_cta_mocker)
+	{
+		_cta_mocker->install_hook();
+		_cta_mocker->enable_hook(true);
+		_cta_mocker->set_coroutine(_stepper.get());
+	}
+	else
+	{
+		_hft_mocker->install_hook();
+		_hft_mocker->enable_hook(true);
+		_hft_mocker->set_coroutine(_stepper.get());
+	}
+
+	_replayer.prepare();
+	_running = true;
+}
+
 void WtBtRunner::stop()
 {
+	if (_stepper)
+	{
+		//策略回调里调用的stop是在协程的栈上，不能在这里销毁协程，先停掉回放，等切回调用方再收尾
+		if (_stepper->in_routine())
+		{
+			_replayer.stop();
+			_stop_pending = true;
+			WTSLogger::debug("Stop requested inside stepping routine, deferred to the caller");
+			return;
+		}
+		_stop_pending = false;
+
+		//单步模式，关掉钩子，在当前线程里把剩下的回放跑完
+		if (_running)
+		{
+			_replayer.stop();
+
+			if (_cta_mocker)
+				_cta_mocker->enable_hook(false);
+			else if (_hft_mocker)
+				_hft_mocker->enable_hook(false);
+
+			while (_stepper->resume());
+		}
+
+		if (_cta_mocker)
+			_cta_mocker->set_coroutine(NULL);
+		else if (_hft_mocker)
+			_hft_mocker->set_coroutine(NULL);
+		_stepper.reset();
+
+		WTSLogger::freeAllDynLoggers();
+
+		WTSLogger::debug("Backtest stopped");
+		return;
+	}
+
 	if (!_running)
 	{
 		if (_worker)
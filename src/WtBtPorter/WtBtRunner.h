@@ -33,6 +33,8 @@ class SelMocker;
 class CtaMocker;
 class HftMocker;
 class ExecMocker;
+class VecBacktester;
+class BtCoroutine;
 
 class WtBtRunner : public IBtDataLoader
 {
@@ -53,6 +55,12 @@ public:
 
 	virtual bool loadRawHisTicks(void* obj, const char* stdCode, uint32_t uDate, FuncReadTicks cb) override;
 
+	virtual bool loadFinalHisBarsRef(void* obj, const char* stdCode, WTSKlinePeriod period, FuncReadBars cb, FuncRefBars cbRef) override;
+
+	virtual bool loadRawHisBarsRef(void* obj, const char* stdCode, WTSKlinePeriod period, FuncReadBars cb, FuncRefBars cbRef) override;
+
+	virtual bool loadRawHisTicksRef(void* obj, const char* stdCode, uint32_t uDate, FuncReadTicks cb, FuncRefTicks cbRef) override;
+
 	virtual bool isAutoTrans() override
 	{
 		return _loader_auto_trans;
@@ -62,6 +70,17 @@ public:
 	void feedRawTicks(WTSTickStruct* ticks, uint32_t count);
 	void feedAdjFactors(const char* stdCode, uint32_t* dates, double* factors, uint32_t count);
 
+	/*
+	 *	以引用的方式喂数据，回放器直接使用调用方的内存，不做拷贝
+	 *	回放器不再使用这块数据的时候，调用releaser(ctx)
+	 */
+	void feedRawBarsRef(WTSBarStruct* bars, uint32_t count, FuncReleaseBuffer releaser, void* ctx);
+	void feedRawTicksRef(WTSTickStruct* ticks, uint32_t count, FuncReleaseBuffer releaser, void* ctx);
+
+private:
+	bool pullBars(FuncPullBars puller, void* obj, const char* stdCode, WTSKlinePeriod period, FuncReadBars cb, FuncRefBars cbRef);
+	bool pullTicks(void* obj, const char* stdCode, uint32_t uDate, FuncReadTicks cb, FuncRefTicks cbRef);
+
 public:
 	void	registerCtaCallbacks(FuncStraInitCallback cbInit, FuncStraTickCallback cbTick, FuncStraCalcCallback cbCalc, 
 		FuncStraBarCallback cbBar, FuncSessionEvtCallback cbSessEvt, FuncStraCalcCallback cbCalcDone = NULL, FuncStraCondTriggerCallback cbCondTrigger = NULL);
@@ -85,11 +104,30 @@ public:
 		_loader_auto_trans = bAutoTrans;
 	}
 
+	/*
+	 *	注册拉取式加载器，优先于registerExtDataLoader注册的加载器
+	 *	@chunkSize	每次拉取的最大条数，0则使用默认值
+	 */
+	void		registerExtDataPuller(FuncPullBars fnlBarPuller, FuncPullBars rawBarPuller, FuncPullTicks tickPuller, uint32_t chunkSize = 0, bool bAutoTrans = true)
+	{
+		_ext_fnl_bar_puller = fnlBarPuller;
+		_ext_raw_bar_puller = rawBarPuller;
+		_ext_tick_puller = tickPuller;
+		_pull_chunk_size = chunkSize;
+		_loader_auto_trans = bAutoTrans;
+	}
+
 	uint32_t	initCtaMocker(const char* name, int32_t slippage = 0, bool hook = false, bool persistData = true, bool bIncremental = false, bool isRatioSlp = false);
 	uint32_t	initHftMocker(const char* name, bool hook = false);
 	uint32_t	initSelMocker(const char* name, uint32_t date, uint32_t time, const char* period, 
 		const char* trdtpl = "CHINA", const char* session = "TRADING", int32_t slippage = 0, bool isRatioSlp = false);
 
+	/*
+	 *	初始化向量化回测器
+	 *	@fillMode	成交方式，0-信号K线收盘价成交，1-下一根K线开盘价成交
+	 */
+	bool	initVecBacktester(const char* name, int32_t slippage = 0, bool isRatioSlp = false, uint32_t fillMode = 0);
+
 	bool	initEvtNotifier(WTSVariant* cfg);
 
 	void	ctx_on_init(uint32_t id, EngineType eType);
@@ -112,9 +150,28 @@ public:
 	void	init(const char* logProfile = "", bool isFile = true, const char* outDir = "./outputs_bt");
 	void	config(const char* cfgFile, bool isFile = true);
 	void	run(bool bNeedDump = false, bool bAsync = false);
+
+	/*
+	 *	单步模式运行回测
+	 *	不启动回放线程，回放放在协程里，由cta_step/hft_step在调用线程里逐步推进
+	 */
+	void	run_stepping(bool bNeedDump = false);
 	void	release();
 	void	stop();
 
+	/*
+	 *	单步模式下在协程里调用了stop的，由cta_step/hft_step返回前在调用方的栈上收尾
+	 *	返回是否做了收尾
+	 */
+	inline bool	finish_pending_stop()
+	{
+		if (!_stop_pending)
+			return false;
+
+		stop();
+		return true;
+	}
+
 	void	set_time_range(WtUInt64 stime, WtUInt64 etime);
 
 	void	enable_tick(bool bEnabled = true);
@@ -126,9 +183,11 @@ public:
 	inline CtaMocker*		cta_mocker() { return _cta_mocker; }
 	inline SelMocker*		sel_mocker() { return _sel_mocker; }
 	inline HftMocker*		hft_mocker() { return _hft_mocker; }
+	inline VecBacktester*	vec_tester() { return _vec_tester; }
 	inline HisDataReplayer&	replayer() { return _replayer; }
 
 	inline bool	isAsync() const { return _async; }
+	inline bool	isStepping() const { return _stepper != NULL; }
 
 public:
 	inline void on_initialize_event()
@@ -194,10 +253,16 @@ private:
 	FuncLoadRawTicks		_ext_tick_loader;	//tick加载器
 	bool					_loader_auto_trans;	//是否自动转储
 
+	FuncPullBars			_ext_fnl_bar_puller;//最终K线拉取器
+	FuncPullBars			_ext_raw_bar_puller;//原始K线拉取器
+	FuncPullTicks			_ext_tick_puller;	//tick拉取器
+	uint32_t				_pull_chunk_size;	//每次拉取的条数
+
 	CtaMocker*		_cta_mocker;
 	SelMocker*		_sel_mocker;
 	ExecMocker*		_exec_mocker;
 	HftMocker*		_hft_mocker;
+	VecBacktester*	_vec_tester;
 	HisDataReplayer	_replayer;
 	EventNotifier	_notifier;
 
@@ -206,11 +271,15 @@ private:
 
 	StdThreadPtr	_worker;
 	bool			_async;
+	std::shared_ptr<BtCoroutine>	_stepper;	//单步模式的回放协程
+	bool			_stop_pending;	//协程里请求的停止，等切回调用方再处理
 
 	void*			_feed_obj;
 	FuncReadBars	_feeder_bars;
 	FuncReadTicks	_feeder_ticks;
 	FuncReadFactors	_feeder_fcts;
+	FuncRefBars		_feeder_bars_ref;
+	FuncRefTicks	_feeder_ticks_ref;
 	StdUniqueMutex	_feed_mtx;
 	WTSVariant* _cfg;
 };
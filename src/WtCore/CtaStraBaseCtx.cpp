@@ -220,6 +220,10 @@ void CtaStraBaseCtx::log_close(const char* stdCode, bool isLong, uint64_t openTi
 }
 void CtaStraBaseCtx::save_userdata()
 {
+	//备进程不写状态文件，以免覆盖主进程的数据
+	if (_engine->is_standby_follower())
+		return;
+
 	rj::Document root(rj::kObjectType);
 	rj::Document::AllocatorType &allocator = root.GetAllocator();
 	for (auto it = _user_datas.begin(); it != _user_datas.end(); it++)
@@ -233,15 +237,18 @@ void CtaStraBaseCtx::save_userdata()
 		filename += _name;
 		filename += ".json";
 
+		rj::StringBuffer sb;
+		rj::PrettyWriter<rj::StringBuffer> writer(sb);
+		root.Accept(writer);
+
 		BoostFile bf;
 		if (bf.create_new_file(filename.c_str()))
 		{
-			rj::StringBuffer sb;
-			rj::PrettyWriter<rj::StringBuffer> writer(sb);
-			root.Accept(writer);
 			bf.write_file(sb.GetString());
 			bf.close_file();
 		}
+
+		_engine->journal_state(SRT_StraUserData, _name.c_str(), sb.GetString(), sb.GetSize());
 	}
 }
 
@@ -262,8 +269,13 @@ void CtaStraBaseCtx::load_userdata()
 	if (content.empty())
 		return;
 
+	parse_userdata(content.c_str());
+}
+
+void CtaStraBaseCtx::parse_userdata(const char* content)
+{
 	rj::Document root;
-	root.Parse(content.c_str());
+	root.Parse(content);
 
 	if (root.HasParseError())
 		return;
@@ -292,8 +304,13 @@ void CtaStraBaseCtx::load_data(uint32_t flag /* = 0xFFFFFFFF */)
 	if (content.empty())
 		return;
 
+	parse_data(content.c_str());
+}
+
+void CtaStraBaseCtx::parse_data(const char* content)
+{
 	rj::Document root;
-	root.Parse(content.c_str());
+	root.Parse(content);
 
 	if (root.HasParseError())
 		return;
@@ -496,6 +513,10 @@ void CtaStraBaseCtx::load_data(uint32_t flag /* = 0xFFFFFFFF */)
 
 void CtaStraBaseCtx::save_data(uint32_t flag /* = 0xFFFFFFFF */)
 {
+	//备进程不写状态文件，以免覆盖主进程的数据
+	if (_engine->is_standby_follower())
+		return;
+
 	rj::Document root(rj::kObjectType);
 
 	{//持仓数据保存
@@ -519,9 +540,9 @@ void CtaStraBaseCtx::save_data(uint32_t flag /* = 0xFFFFFFFF */)
 			pItem.AddMember("frozendate", pInfo._frozen_date, allocator);
 
 			rj::Value details(rj::kArrayType);
-			for (auto dit = pInfo._details.begin(); dit != pInfo._details.end(); dit++)
+			for (size_t idx = 0; idx < pInfo._details.size(); idx++)
 			{
-				const DetailInfo& dInfo = *dit;
+				const DetailInfo& dInfo = pInfo._details.at(idx);
 				rj::Value dItem(rj::kObjectType);
 				dItem.AddMember("long", dInfo._long, allocator);
 				dItem.AddMember("price", dInfo._price, allocator);
@@ -632,15 +653,41 @@ void CtaStraBaseCtx::save_data(uint32_t flag /* = 0xFFFFFFFF */)
 		filename += _name;
 		filename += ".json";
 
+		rj::StringBuffer sb;
+		rj::PrettyWriter<rj::StringBuffer> writer(sb);
+		root.Accept(writer);
+
 		BoostFile bf;
 		if (bf.create_new_file(filename.c_str()))
 		{
-			rj::StringBuffer sb;
-			rj::PrettyWriter<rj::StringBuffer> writer(sb);
-			root.Accept(writer);
 			bf.write_file(sb.GetString());
 			bf.close_file();
 		}
+
+		_engine->journal_state(SRT_StraData, _name.c_str(), sb.GetString(), sb.GetSize());
+	}
+}
+
+void CtaStraBaseCtx::restore_state(uint32_t rtype, const char* data, std::size_t len)
+{
+	std::string content(data, len);
+	if (rtype == SRT_StraData)
+	{
+		//持仓、信号和条件单都以主进程的为准
+		_pos_map.clear();
+		_sig_map.clear();
+		_condtions.clear();
+		parse_data(content.c_str());
+		save_data();
+
+		log_info("Strategy data recovered from standby mirror");
+	}
+	else if (rtype == SRT_StraUserData)
+	{
+		_user_datas.clear();
+		parse_userdata(content.c_str());
+		save_userdata();
+		_ud_modified = false;
 	}
 }
 
@@ -763,24 +810,10 @@ void CtaStraBaseCtx::update_dyn_profit(const char* stdCode, double price)
 		}
 		else
 		{
+			//明细的统计值读取的时候才计算，这里只用汇总值算浮盈
 			WTSCommodityInfo* commInfo = _engine->get_commodity_info(stdCode);
-			double dynprofit = 0;
-			for (auto pit = pInfo._details.begin(); pit != pInfo._details.end(); pit++)
-			{
-				DetailInfo& dInfo = *pit;
-				dInfo._profit = dInfo._volume*(price - dInfo._price)*commInfo->getVolScale()*(dInfo._long ? 1 : -1);
-				if (dInfo._profit > 0)
-					dInfo._max_profit = std::max(dInfo._profit, dInfo._max_profit);
-				else if (dInfo._profit < 0)
-					dInfo._max_loss = std::min(dInfo._profit, dInfo._max_loss);
-
-				dInfo._max_price = std::max(dInfo._max_price, price);
-				dInfo._min_price = std::min(dInfo._min_price, price);
-
-				dynprofit += dInfo._profit;
-			}
-
-			pInfo._dynprofit = dynprofit;
+			pInfo._details.update(price, commInfo->getVolScale());
+			pInfo._dynprofit = pInfo._details.dyn_profit();
 		}
 	}
 
@@ -1479,25 +1512,25 @@ void CtaStraBaseCtx::do_set_position(const char* stdCode, double qty, const char
 		pInfo._volume = qty;
 		if (decimal::eq(pInfo._volume, 0))
 			pInfo._dynprofit = 0;
-		uint32_t count = 0;
-		for (auto it = pInfo._details.begin(); it != pInfo._details.end(); it++)
+		while (!pInfo._details.empty())
 		{
-			DetailInfo& dInfo = *it;
+			//平仓从队头开始，明细出队以后还要写日志，所以这里拷贝一份
+			DetailInfo dInfo = pInfo._details.front();
 			if (decimal::eq(dInfo._volume, 0))
 			{
-				count++;
+				pInfo._details.pop_front();
 				continue;
 			}
 
 			double maxQty = min(dInfo._volume, left);
 			if (decimal::eq(maxQty, 0))
-				continue;
+				break;
 
 			dInfo._volume -= maxQty;
 			left -= maxQty;
 
-			if (decimal::eq(dInfo._volume, 0))
-				count++;
+			//平完的明细直接出队
+			pInfo._details.reduce_front(maxQty);
 
 			//计算平仓盈亏
 			double profit = (trdPx - dInfo._price) * maxQty * commInfo->getVolScale();
@@ -1525,14 +1558,6 @@ void CtaStraBaseCtx::do_set_position(const char* stdCode, double qty, const char
 				break;
 		}
 
-		//需要清理掉已经平仓完的明细
-		while (count > 0)
-		{
-			auto it = pInfo._details.begin();
-			pInfo._details.erase(it);
-			count--;
-		}
-
 		//最后, 如果还有剩余的, 则需要反手了
 		if (decimal::gt(left, 0))
 		{
@@ -1770,7 +1795,7 @@ uint64_t CtaStraBaseCtx::stra_get_first_entertime(const char* stdCode)
 	if (pInfo._details.empty())
 		return 0;
 
-	return pInfo._details[0]._opentime;
+	return pInfo._details.front()._opentime;
 }
 
 const char* CtaStraBaseCtx::stra_get_last_entertag(const char* stdCode)
@@ -1783,7 +1808,7 @@ const char* CtaStraBaseCtx::stra_get_last_entertag(const char* stdCode)
 	if (pInfo._details.empty())
 		return "";
 
-	return pInfo._details[0]._opentag;
+	return pInfo._details.front()._opentag;
 }
 
 
@@ -1807,7 +1832,7 @@ uint64_t CtaStraBaseCtx::stra_get_last_entertime(const char* stdCode)
 	if (pInfo._details.empty())
 		return 0;
 
-	return pInfo._details[pInfo._details.size() - 1]._opentime;
+	return pInfo._details.back()._opentime;
 }
 
 double CtaStraBaseCtx::stra_get_last_enterprice(const char* stdCode)
@@ -1820,7 +1845,7 @@ double CtaStraBaseCtx::stra_get_last_enterprice(const char* stdCode)
 	if (pInfo._details.empty())
 		return 0;
 
-	return pInfo._details[pInfo._details.size() - 1]._price;
+	return pInfo._details.back()._price;
 }
 
 double CtaStraBaseCtx::stra_get_position(const char* stdCode, bool bOnlyValid /* = false */, const char* userTag /* = "" */)
@@ -1853,14 +1878,9 @@ double CtaStraBaseCtx::stra_get_position(const char* stdCode, bool bOnlyValid /*
 	}
 	else
 	{
-		for (auto it = pInfo._details.begin(); it != pInfo._details.end(); it++)
-		{
-			const DetailInfo& dInfo = (*it);
-			if (strcmp(dInfo._opentag, userTag) != 0)
-				continue;
-
-			return dInfo._volume;
-		}
+		const DetailInfo* dInfo = pInfo._details.find(userTag);
+		if (dInfo != NULL)
+			return dInfo->_volume;
 	}
 
 	return 0;
@@ -1876,14 +1896,7 @@ double CtaStraBaseCtx::stra_get_position_avgpx(const char* stdCode)
 	if (pInfo._volume == 0)
 		return 0.0;
 
-	double amount = 0.0;
-	for (auto dit = pInfo._details.begin(); dit != pInfo._details.end(); dit++)
-	{
-		const DetailInfo& dInfo = *dit;
-		amount += dInfo._price*dInfo._volume;
-	}
-
-	return amount / pInfo._volume;
+	return pInfo._details.cost() / pInfo._volume;
 }
 
 double CtaStraBaseCtx::stra_get_position_profit(const char* stdCode)
@@ -1903,14 +1916,9 @@ uint64_t CtaStraBaseCtx::stra_get_detail_entertime(const char* stdCode, const ch
 		return 0;
 
 	const PosInfo& pInfo = it->second;
-	for (auto it = pInfo._details.begin(); it != pInfo._details.end(); it++)
-	{
-		const DetailInfo& dInfo = (*it);
-		if (strcmp(dInfo._opentag, userTag) != 0)
-			continue;
-
-		return dInfo._opentime;
-	}
+	const DetailInfo* dInfo = pInfo._details.find(userTag);
+	if (dInfo != NULL)
+		return dInfo->_opentime;
 
 	return 0;
 }
@@ -1922,14 +1930,9 @@ double CtaStraBaseCtx::stra_get_detail_cost(const char* stdCode, const char* use
 		return 0;
 
 	const PosInfo& pInfo = it->second;
-	for (auto it = pInfo._details.begin(); it != pInfo._details.end(); it++)
-	{
-		const DetailInfo& dInfo = (*it);
-		if (strcmp(dInfo._opentag, userTag) != 0)
-			continue;
-
-		return dInfo._price;
-	}
+	const DetailInfo* dInfo = pInfo._details.find(userTag);
+	if (dInfo != NULL)
+		return dInfo->_price;
 
 	return 0.0;
 }
@@ -1941,24 +1944,21 @@ double CtaStraBaseCtx::stra_get_detail_profit(const char* stdCode, const char* u
 		return 0;
 
 	const PosInfo& pInfo = it->second;
-	for (auto it = pInfo._details.begin(); it != pInfo._details.end(); it++)
+	const DetailInfo* dInfo = pInfo._details.find(userTag);
+	if (dInfo != NULL)
 	{
-		const DetailInfo& dInfo = (*it);
-		if (strcmp(dInfo._opentag, userTag) != 0)
-			continue;
-
 		switch (flag)
 		{
 		case 0:
-			return dInfo._profit;
+			return dInfo->_profit;
 		case 1:
-			return dInfo._max_profit;
+			return dInfo->_max_profit;
 		case -1:
-			return dInfo._max_loss;
+			return dInfo->_max_loss;
 		case 2:
-			return dInfo._max_price;
+			return dInfo->_max_price;
 		case -2:
-			return dInfo._min_price;
+			return dInfo->_min_price;
 		}
 	}
 
@@ -15,6 +15,7 @@
 #include "../Share/BoostFile.hpp"
 #include "../Share/fmtlib.h"
 #include "../Share/SpinMutex.hpp"
+#include "../Share/PosDetailQueue.hpp"
 
 #include <unordered_map>
 
@@ -74,6 +75,9 @@ private:
 	void	load_userdata();
 	void	save_userdata();
 
+	void	parse_data(const char* content);
+	void	parse_userdata(const char* content);
+
 	void	update_dyn_profit(const char* stdCode, double price);
 
 	void	do_set_position(const char* stdCode, double qty, const char* userTag = "", bool bFireAtOnce = false);
@@ -116,6 +120,8 @@ public:
 	virtual void on_bar(const char* stdCode, const char* period, uint32_t times, WTSBarStruct* newBar) override;
 	virtual bool on_schedule(uint32_t curDate, uint32_t curTime) override;
 
+	virtual void restore_state(uint32_t rtype, const char* data, std::size_t len) override;
+
 	virtual void enum_position(FuncEnumCtaPosCallBack cb, bool bForExecute = false) override;
 
 
@@ -270,7 +276,7 @@ protected:
 		double		_frozen;
 		uint32_t	_frozen_date;
 
-		std::vector<DetailInfo> _details;
+		PosDetailQueue<DetailInfo> _details;	//持仓明细，按开仓顺序排列
 
 		_PosInfo()
 		{
@@ -0,0 +1,152 @@
+﻿/*!
+ * \file EventCapture.h
+ * \project	WonderTrader
+ *
+ * \brief 实盘事件录制和离线回放
+ *
+ * EventCapture把引擎的所有输入事件(行情、Level2、交易回报、定时器)按照到达顺序写入二进制文件
+ * EventReplayer读取录制文件，按照同样的顺序喂给同一套引擎和策略，尽可能快地重新执行一遍
+ */
+#pragma once
+#include <string>
+#include <atomic>
+
+#include "WtCaptureDefs.h"
+#include "../Includes/ITraderApi.h"
+#include "../Share/BoostFile.hpp"
+#include "../Share/SpinMutex.hpp"
+#include "../Share/StdUtils.hpp"
+
+class BoostMappingFile;
+
+NS_WTP_BEGIN
+class WTSTickData;
+class WTSOrdQueData;
+class WTSOrdDtlData;
+class WTSTransData;
+class WTSEntrust;
+class WTSError;
+class WTSArray;
+class WTSOrderInfo;
+class WTSTradeInfo;
+class IBaseDataMgr;
+class WtEngine;
+class TraderAdapterMgr;
+
+class EventCapture
+{
+public:
+	EventCapture();
+	~EventCapture();
+
+public:
+	/*
+	 *	打开录制文件
+	 *	@filename	文件名
+	 *	@flushSpan	落盘间隔(毫秒)，录制线程只写内存缓存
+	 */
+	bool	open(const char* filename, uint32_t flushSpan = 100);
+	void	close();
+
+	inline bool	is_opened() const { return _opened; }
+	inline const char* filename() const { return _filename.c_str(); }
+
+	void	record_clock(uint32_t uDate, uint32_t uTime, uint32_t orderSeed);
+	/*
+	 *	录制本地定时器触发的事件
+	 *	@uKind	事件类型，见CaptureTimerKind
+	 */
+	void	record_timer(uint32_t uKind, uint32_t uDate, uint32_t uTime);
+
+	void	record_tick(WTSTickData* curTick);
+	void	record_order_queue(WTSOrdQueData* curOrdQue);
+	void	record_order_detail(WTSOrdDtlData* curOrdDtl);
+	void	record_transaction(WTSTransData* curTrans);
+
+	void	record_trader_event(const char* trader, WTSTraderEvent e, int32_t ec);
+	void	record_login(const char* trader, bool bSucc, const char* msg, uint32_t tradingdate, bool bModifySupported);
+	void	record_entrust(const char* trader, WTSEntrust* entrust, WTSError* err);
+	void	record_accounts(const char* trader, const WTSArray* ayAccounts);
+	void	record_positions(const char* trader, const WTSArray* ayPositions);
+	void	record_orders(const char* trader, const WTSArray* ayOrders);
+	void	record_trades(const char* trader, const WTSArray* ayTrades);
+	void	record_order(const char* trader, WTSOrderInfo* ordInfo);
+	void	record_trade(const char* trader, WTSTradeInfo* trdInfo);
+
+private:
+	//写入一条记录，到达时间在这里打上
+	void	append(uint32_t etype, const void* data, uint32_t len);
+
+	void	flush();
+
+private:
+	bool			_opened;
+	std::string		_filename;
+	BoostFile		_file;
+
+	SpinMutex		_mtx;
+	std::string		_buffer;	//录制缓存，落盘线程定时交换出去写文件
+	std::string		_flushing;
+
+	uint32_t		_flush_span;
+	std::atomic<bool>	_stopped;
+	StdThreadPtr	_thrd_flush;
+};
+
+/*
+ *	回放用的交易接口
+ *	下单撤单直接返回成功，所有回报都来自录制文件
+ */
+class ReplayTraderApi : public ITraderApi
+{
+public:
+	ReplayTraderApi() : _auto_id(0), _modify_supported(false) {}
+
+	inline void set_modify_supported(bool bSupported) { _modify_supported = bSupported; }
+
+public:
+	virtual bool init(WTSVariant *params) override { return true; }
+	virtual void release() override { delete this; }
+	virtual bool isConnected() override { return true; }
+	virtual bool makeEntrustID(char* buffer, int length) override;
+	virtual int login(const char* user, const char* pass, const char* productInfo) override { return 0; }
+	virtual int logout() override { return 0; }
+	virtual int orderInsert(WTSEntrust* eutrust) override { return 0; }
+	virtual int orderAction(WTSEntrustAction* action) override { return 0; }
+	virtual bool isModifySupported() override { return _modify_supported; }
+	virtual int orderModify(WTSEntrustAction* action) override { return 0; }
+	virtual int queryAccount() override { return 0; }
+	virtual int queryPositions() override { return 0; }
+	virtual int queryOrders() override { return 0; }
+	virtual int queryTrades() override { return 0; }
+
+private:
+	uint32_t	_auto_id;
+	bool		_modify_supported;
+};
+
+class EventReplayer
+{
+public:
+	EventReplayer();
+	~EventReplayer();
+
+public:
+	bool	open(const char* filename);
+
+	/*
+	 *	回放录制文件
+	 *	先用录制的启动时钟初始化引擎，启动引擎和交易通道，再按顺序分发所有事件
+	 *	返回回放的事件数
+	 */
+	uint64_t	replay(WtEngine* engine, TraderAdapterMgr* traders, IBaseDataMgr* bdMgr);
+
+private:
+	void	dispatch_trader(uint32_t etype, const char* data, TraderAdapterMgr* traders, IBaseDataMgr* bdMgr);
+
+private:
+	std::shared_ptr<BoostMappingFile>	_file;
+	std::string		_filename;
+};
+
+NS_WTP_END
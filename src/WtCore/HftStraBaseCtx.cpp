@@ -194,6 +194,18 @@ OrderIDs HftStraBaseCtx::stra_cancel(const char* stdCode, bool isBuy, double qty
 	return _trader->cancel(stdCode, isBuy, qty);
 }
 
+uint32_t HftStraBaseCtx::stra_modify(uint32_t localid, double price, double qty)
+{
+	uint32_t newid = _trader->modify(localid, price, qty);
+
+	//模拟改单会重新下单, 新订单沿用原来的用户标签
+	//重复改单会返回同一个新订单号, 只需要登记一次, 这样也能保持标签按订单号有序
+	if (newid != 0 && newid != localid && (_orders.empty() || _orders.back()._localid < newid))
+		setUserTag(newid, getOrderTag(localid));
+
+	return newid;
+}
+
 const char* HftStraBaseCtx::get_inner_code(const char* stdCode)
 {
 	auto it = _code_map.find(stdCode);
@@ -477,6 +489,16 @@ WTSTickData* HftStraBaseCtx::stra_get_last_tick(const char* stdCode)
 	return _engine->get_last_tick(_context_id, stdCode);
 }
 
+const WTSOptGreeksStruct* HftStraBaseCtx::stra_get_greeks(const char* stdCode)
+{
+	return _engine->get_greeks(stdCode);
+}
+
+const WTSOptGreeksStruct* HftStraBaseCtx::stra_get_greeks_chain(const char* underlying, uint32_t& count)
+{
+	return _engine->get_greeks_chain(underlying, count);
+}
+
 void HftStraBaseCtx::stra_sub_ticks(const char* stdCode)
 {
 	/*
@@ -720,6 +742,10 @@ void HftStraBaseCtx::stra_save_user_data(const char* key, const char* val)
 
 void HftStraBaseCtx::save_userdata()
 {
+	//备进程不写状态文件，以免覆盖主进程的数据
+	if (_engine->is_standby_follower())
+		return;
+
 	//ini.save(filename.c_str());
 	rj::Document root(rj::kObjectType);
 	rj::Document::AllocatorType &allocator = root.GetAllocator();
@@ -734,15 +760,18 @@ void HftStraBaseCtx::save_userdata()
 		filename += _name;
 		filename += ".json";
 
+		rj::StringBuffer sb;
+		rj::PrettyWriter<rj::StringBuffer> writer(sb);
+		root.Accept(writer);
+
 		BoostFile bf;
 		if (bf.create_new_file(filename.c_str()))
 		{
-			rj::StringBuffer sb;
-			rj::PrettyWriter<rj::StringBuffer> writer(sb);
-			root.Accept(writer);
 			bf.write_file(sb.GetString());
 			bf.close_file();
 		}
+
+		_engine->journal_state(SRT_StraUserData, _name.c_str(), sb.GetString(), sb.GetSize());
 	}
 }
 
@@ -763,8 +792,13 @@ void HftStraBaseCtx::load_userdata()
 	if (content.empty())
 		return;
 
+	parse_userdata(content.c_str());
+}
+
+void HftStraBaseCtx::parse_userdata(const char* content)
+{
 	rj::Document root;
-	root.Parse(content.c_str());
+	root.Parse(content);
 
 	if (root.HasParseError())
 		return;
@@ -777,6 +811,19 @@ void HftStraBaseCtx::load_userdata()
 	}
 }
 
+void HftStraBaseCtx::restore_state(uint32_t rtype, const char* data, std::size_t len)
+{
+	//HFT的持仓和订单以交易通道为准，这里只需要恢复用户数据
+	if (rtype != SRT_StraUserData)
+		return;
+
+	std::string content(data, len);
+	_user_datas.clear();
+	parse_userdata(content.c_str());
+	save_userdata();
+	_ud_modified = false;
+}
+
 void HftStraBaseCtx::do_set_position(const char* stdCode, double qty, double price /* = 0.0 */, const char* userTag /*= ""*/)
 {
 	PosInfo& pInfo = _pos_map[stdCode];
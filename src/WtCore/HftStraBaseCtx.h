@@ -52,10 +52,14 @@ public:
 
 	virtual void on_session_end(uint32_t uTDate) override;
 
+	virtual void restore_state(uint32_t rtype, const char* data, std::size_t len) override;
+
 	virtual bool stra_cancel(uint32_t localid) override;
 
 	virtual OrderIDs stra_cancel(const char* stdCode, bool isBuy, double qty) override;
 
+	virtual uint32_t stra_modify(uint32_t localid, double price, double qty) override;
+
 	/*
 	 *	下单接口: 买入
 	 *
@@ -132,6 +136,9 @@ public:
 
 	virtual WTSTickData* stra_get_last_tick(const char* stdCode) override;
 
+	virtual const WTSOptGreeksStruct* stra_get_greeks(const char* stdCode) override;
+	virtual const WTSOptGreeksStruct* stra_get_greeks_chain(const char* underlying, uint32_t& count) override;
+
 	/*
 	 *	获取分月合约代码
 	 */
@@ -201,6 +208,7 @@ protected:
 
 	void	load_userdata();
 	void	save_userdata();
+	void	parse_userdata(const char* content);
 
 	void	init_outputs();
 
@@ -170,6 +170,10 @@ void SelStraBaseCtx::log_close(const char* stdCode, bool isLong, uint64_t openTi
 
 void SelStraBaseCtx::save_userdata()
 {
+	//备进程不写状态文件，以免覆盖主进程的数据
+	if (_engine->is_standby_follower())
+		return;
+
 	//ini.save(filename.c_str());
 	rj::Document root(rj::kObjectType);
 	rj::Document::AllocatorType &allocator = root.GetAllocator();
@@ -184,15 +188,18 @@ void SelStraBaseCtx::save_userdata()
 		filename += _name;
 		filename += ".json";
 
+		rj::StringBuffer sb;
+		rj::PrettyWriter<rj::StringBuffer> writer(sb);
+		root.Accept(writer);
+
 		BoostFile bf;
 		if (bf.create_new_file(filename.c_str()))
 		{
-			rj::StringBuffer sb;
-			rj::PrettyWriter<rj::StringBuffer> writer(sb);
-			root.Accept(writer);
 			bf.write_file(sb.GetString());
 			bf.close_file();
 		}
+
+		_engine->journal_state(SRT_StraUserData, _name.c_str(), sb.GetString(), sb.GetSize());
 	}
 }
 
@@ -213,8 +220,13 @@ void SelStraBaseCtx::load_userdata()
 	if (content.empty())
 		return;
 
+	parse_userdata(content.c_str());
+}
+
+void SelStraBaseCtx::parse_userdata(const char* content)
+{
 	rj::Document root;
-	root.Parse(content.c_str());
+	root.Parse(content);
 
 	if (root.HasParseError())
 		return;
@@ -243,8 +255,13 @@ void SelStraBaseCtx::load_data(uint32_t flag /* = 0xFFFFFFFF */)
 	if (content.empty())
 		return;
 
+	parse_data(content.c_str());
+}
+
+void SelStraBaseCtx::parse_data(const char* content)
+{
 	rj::Document root;
-	root.Parse(content.c_str());
+	root.Parse(content);
 
 	if (root.HasParseError())
 		return;
@@ -379,6 +396,10 @@ void SelStraBaseCtx::load_data(uint32_t flag /* = 0xFFFFFFFF */)
 
 void SelStraBaseCtx::save_data(uint32_t flag /* = 0xFFFFFFFF */)
 {
+	//备进程不写状态文件，以免覆盖主进程的数据
+	if (_engine->is_standby_follower())
+		return;
+
 	rj::Document root(rj::kObjectType);
 
 	{//持仓数据保存
@@ -469,15 +490,39 @@ void SelStraBaseCtx::save_data(uint32_t flag /* = 0xFFFFFFFF */)
 		filename += _name;
 		filename += ".json";
 
+		rj::StringBuffer sb;
+		rj::PrettyWriter<rj::StringBuffer> writer(sb);
+		root.Accept(writer);
+
 		BoostFile bf;
 		if (bf.create_new_file(filename.c_str()))
 		{
-			rj::StringBuffer sb;
-			rj::PrettyWriter<rj::StringBuffer> writer(sb);
-			root.Accept(writer);
 			bf.write_file(sb.GetString());
 			bf.close_file();
 		}
+
+		_engine->journal_state(SRT_StraData, _name.c_str(), sb.GetString(), sb.GetSize());
+	}
+}
+
+void SelStraBaseCtx::restore_state(uint32_t rtype, const char* data, std::size_t len)
+{
+	std::string content(data, len);
+	if (rtype == SRT_StraData)
+	{
+		_pos_map.clear();
+		_sig_map.clear();
+		parse_data(content.c_str());
+		save_data();
+
+		log_info("Strategy data recovered from standby mirror");
+	}
+	else if (rtype == SRT_StraUserData)
+	{
+		_user_datas.clear();
+		parse_userdata(content.c_str());
+		save_userdata();
+		_ud_modified = false;
 	}
 }
 
@@ -39,6 +39,9 @@ private:
 	void	load_userdata();
 	void	save_userdata();
 
+	void	parse_data(const char* content);
+	void	parse_userdata(const char* content);
+
 	void	update_dyn_profit(const char* stdCode, double price);
 
 	void	do_set_position(const char* stdCode, double qty, const char* userTag = "", bool bTriggered = false);
@@ -77,6 +80,8 @@ public:
 	virtual void on_bar(const char* stdCode, const char* period, uint32_t times, WTSBarStruct* newBar) override;
 	virtual bool on_schedule(uint32_t curDate, uint32_t curTime, uint32_t fireTime) override;
 
+	virtual void restore_state(uint32_t rtype, const char* data, std::size_t len) override;
+
 	virtual void enum_position(FuncEnumSelPositionCallBack cb) override;
 
 	//////////////////////////////////////////////////////////////////////////
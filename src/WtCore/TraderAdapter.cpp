@@ -13,6 +13,7 @@
 #include "ActionPolicyMgr.h"
 #include "WtHelper.h"
 #include "ITrdNotifySink.h"
+#include "EventCapture.h"
 #include "../Includes/RiskMonDefs.h"
 
 #include <atomic>
@@ -38,9 +39,10 @@
 
 namespace rj = rapidjson;
 
+static std::atomic<uint32_t> _auto_order_id{ 0 };
+
 uint32_t makeLocalOrderID()
 {
-	static std::atomic<uint32_t> _auto_order_id{ 0 };
 	if (_auto_order_id == 0)
 	{
 		uint32_t curYear = TimeUtils::getCurDate() / 10000 * 10000 + 101;
@@ -83,6 +85,12 @@ TraderAdapter::TraderAdapter(EventNotifier* caster /* = NULL */)
 	, _save_data(false)
 	, _notifier(caster)
 	, _ignore_sefmatch(false)
+	, _fund_qry_span(60)
+	, _fund_drift_limit(0)
+	, _last_fund_qry(0)
+	, _standby(NULL)
+	, _fence_logged(false)
+	, _capture(NULL)
 {
 }
 
@@ -93,7 +101,7 @@ TraderAdapter::~TraderAdapter()
 		_stat_map->release();
 }
 
-bool TraderAdapter::init(const char* id, WTSVariant* params, IBaseDataMgr* bdMgr, ActionPolicyMgr* policyMgr)
+bool TraderAdapter::init(const char* id, WTSVariant* params, IBaseDataMgr* bdMgr, ActionPolicyMgr* policyMgr, ITraderApi* api /* = NULL */)
 {
 	if (params == NULL)
 		return false;
@@ -115,6 +123,15 @@ bool TraderAdapter::init(const char* id, WTSVariant* params, IBaseDataMgr* bdMgr
 	if (_save_data)
 		initSaveData();
 
+	/*
+	 *	资金数据在本地维护，柜台的资金查询只用于定期校对
+	 *	fund_query_span为查询间隔，单位为秒，默认60秒，0为不查询
+	 *	fund_drift_limit为本地和柜台动态权益的偏差报警阈值
+	 */
+	if (_cfg->get("fund_query_span"))
+		_fund_qry_span = _cfg->getUInt32("fund_query_span");
+	_fund_drift_limit = _cfg->getDouble("fund_drift_limit");
+
 	//这里解析流量风控参数
 	WTSVariant* cfgRisk = params->get("riskmon");
 	if (cfgRisk)
@@ -157,6 +174,12 @@ bool TraderAdapter::init(const char* id, WTSVariant* params, IBaseDataMgr* bdMgr
 		WTSLogger::log_dyn("trader", _id.c_str(), LL_WARN, "[{}] No risk control rule setup of trading channel", _id.c_str());
 	}
 
+	if (api != NULL)
+	{
+		_trader_api = api;
+		return _trader_api->init(params);
+	}
+
 	if (params->getString("module").empty())
 		return false;
 
@@ -481,8 +504,60 @@ OrderMap* TraderAdapter::getOrders(const char* stdCode)
 	return ret;
 }
 
-uint32_t TraderAdapter::doEntrust(WTSEntrust* entrust)
+inline bool TraderAdapter::isFenced()
 {
+	if (_standby == NULL)
+		return false;
+
+	if (_standby->is_leader())
+	{
+		//重新成为主进程以后，下一次变成备进程时还要再提示一次
+		if (_fence_logged.load(std::memory_order_relaxed))
+			_fence_logged.store(false, std::memory_order_relaxed);
+		return false;
+	}
+
+	//每次角色切换只提示一次，避免每条指令都刷一行日志
+	if (!_fence_logged.exchange(true))
+		WTSLogger::log_dyn("trader", _id.c_str(), LL_WARN, "[{}] Instructions blocked, current process is not the leader of standby group", _id.c_str());
+	return true;
+}
+
+void TraderAdapter::syncLocalOrderID(uint32_t localid)
+{
+	uint32_t curID = _auto_order_id.load();
+	while (curID <= localid && !_auto_order_id.compare_exchange_weak(curID, localid + 1));
+}
+
+uint32_t TraderAdapter::peekLocalOrderID()
+{
+	//和makeLocalOrderID一样，第一次调用的时候初始化种子
+	if (_auto_order_id == 0)
+	{
+		uint32_t curYear = TimeUtils::getCurDate() / 10000 * 10000 + 101;
+		uint32_t seed = (uint32_t)((TimeUtils::getLocalTimeNow() - TimeUtils::makeTime(curYear, 0)) / 1000 * 50);
+		uint32_t expected = 0;
+		_auto_order_id.compare_exchange_strong(expected, seed);
+	}
+
+	return _auto_order_id.load();
+}
+
+void TraderAdapter::resync()
+{
+	if (_state != AS_ALLREADY)
+		return;
+
+	WTSLogger::log_dyn("trader", _id.c_str(), LL_INFO, "[{}] Resyncing positions and orders after takeover", _id.c_str());
+	_trader_api->queryPositions();
+	_trader_api->queryOrders();
+}
+
+uint32_t TraderAdapter::doEntrust(WTSEntrust* entrust, uint32_t localid /* = 0 */)
+{
+	if (isFenced())
+		return UINT_MAX;
+
 	_trader_api->makeEntrustID(entrust->getEntrustID(), 64);
 
 	WTSContractInfo* cInfo = entrust->getContractInfo();
@@ -491,7 +566,9 @@ uint32_t TraderAdapter::doEntrust(WTSEntrust* entrust)
 	entrust->setCode(cInfo->getCode());
 	entrust->setExchange(cInfo->getExchg());
 
-	uint32_t localid = makeLocalOrderID();
+	//改单重新下单的时候, 本地订单号是提前分配好的
+	if (localid == 0)
+		localid = makeLocalOrderID();
 	char* usertag = entrust->getUserTag();
 	wt_strcpy(usertag, _order_pattern.c_str(), _order_pattern.size());
 	usertag[_order_pattern.size()] =  '.';
@@ -507,6 +584,9 @@ uint32_t TraderAdapter::doEntrust(WTSEntrust* entrust)
 	{
 		int64_t now = TimeUtils::getLocalTimeNow();
 		_order_time_cache[entrust->getCode()].emplace_back(now);
+
+		if (_standby)
+			_standby->append(SRT_OrderID, _id.c_str(), (const char*)&localid, sizeof(uint32_t));
 	}
 	return localid;
 }
@@ -665,6 +745,9 @@ OrderIDs TraderAdapter::buy(const char* stdCode, double price, double qty, int f
 		return ret;
 	}
 
+	if (isFenced())
+		return ret;
+
 	if(cInfo == NULL) cInfo = getContract(stdCode);
 	WTSCommodityInfo* commInfo = cInfo->getCommInfo();
 	WTSSessionInfo* sInfo = commInfo->getSessionInfo();
@@ -958,6 +1041,9 @@ OrderIDs TraderAdapter::sell(const char* stdCode, double price, double qty, int
 		return ret;
 	}
 
+	if (isFenced())
+		return ret;
+
 	if (cInfo == NULL) cInfo = getContract(stdCode);
 	WTSCommodityInfo* commInfo = cInfo->getCommInfo();
 	WTSSessionInfo* sInfo = commInfo->getSessionInfo();
@@ -1233,22 +1319,29 @@ OrderIDs TraderAdapter::sell(const char* stdCode, double price, double qty, int
 	return ret;
 }
 
-bool TraderAdapter::doCancel(WTSOrderInfo* ordInfo)
+std::string TraderAdapter::getStdCode(WTSContractInfo* cInfo)
 {
-	if (ordInfo == NULL || !ordInfo->isAlive())
-		return false;
-
-	WTSContractInfo* cInfo = ordInfo->getContractInfo();
 	WTSCommodityInfo* commInfo = cInfo->getCommInfo();
-	std::string stdCode;
 	if (commInfo->getCategoty() == CC_FutOption || commInfo->getCategoty() == CC_SpotOption)
-		stdCode = CodeHelper::rawFutOptCodeToStdCode(cInfo->getCode(), cInfo->getExchg());
+		return CodeHelper::rawFutOptCodeToStdCode(cInfo->getCode(), cInfo->getExchg());
 	else if (CodeHelper::isMonthlyCode(cInfo->getCode()))//如果是分月合约
-		stdCode = CodeHelper::rawMonthCodeToStdCode(cInfo->getCode(), cInfo->getExchg());
+		return CodeHelper::rawMonthCodeToStdCode(cInfo->getCode(), cInfo->getExchg());
 	else
-		stdCode = CodeHelper::rawFlatCodeToStdCode(cInfo->getCode(), cInfo->getExchg(), cInfo->getProduct());
-	//撤单频率检查
-	if (!checkCancelLimits(stdCode.c_str()))
+		return CodeHelper::rawFlatCodeToStdCode(cInfo->getCode(), cInfo->getExchg(), cInfo->getProduct());
+}
+
+bool TraderAdapter::doCancel(WTSOrderInfo* ordInfo, bool bForReplace /* = false */)
+{
+	if (ordInfo == NULL || !ordInfo->isAlive())
+		return false;
+
+	if (isFenced())
+		return false;
+
+	WTSContractInfo* cInfo = ordInfo->getContractInfo();
+	std::string stdCode = getStdCode(cInfo);
+	//撤单频率检查, 改单引起的撤单也是真实的撤单, 同样要检查, 另外还要检查是否禁止交易
+	if (!checkCancelLimits(stdCode.c_str()) || (bForReplace && !isTradeEnabled(stdCode.c_str())))
 		return false;
 
 	WTSEntrustAction* action = WTSEntrustAction::create(ordInfo->getCode(), cInfo->getExchg());
@@ -1282,6 +1375,102 @@ bool TraderAdapter::cancel(uint32_t localid)
 	return bRet;
 }
 
+uint32_t TraderAdapter::modify(uint32_t localid, double newPrice, double newQty)
+{
+	if (_orders == NULL || _orders->size() == 0 || decimal::le(newQty, 0))
+		return 0;
+
+	WTSOrderInfo* ordInfo = NULL;
+	{
+		SpinLock lock(_mtx_orders);
+		ordInfo = (WTSOrderInfo*)_orders->grab(localid);
+		if (ordInfo == NULL)
+			return 0;
+	}
+
+	uint32_t ret = 0;
+	do
+	{
+		if (!ordInfo->isAlive())
+			break;
+
+		if (isFenced())
+			break;
+
+		WTSContractInfo* cInfo = ordInfo->getContractInfo();
+		if (_trader_api->isModifySupported())
+		{
+			std::string stdCode = getStdCode(cInfo);
+			if (!isTradeEnabled(stdCode.c_str()))
+				break;
+
+			//先记下当前的委托数量, 改单回报以后根据数量变化更新未完成数量和可平量
+			{
+				SpinLock lock(_mtx_modify);
+				_modifying.emplace(localid, ordInfo->getVolume());
+			}
+
+			WTSEntrustAction* action = WTSEntrustAction::createModifyAction(ordInfo->getCode(), cInfo->getExchg(), newPrice, newQty);
+			action->setEntrustID(ordInfo->getEntrustID());
+			action->setOrderID(ordInfo->getOrderID());
+			action->setContractInfo(cInfo);
+			int iRet = _trader_api->orderModify(action);
+			action->release();
+			if (iRet < 0)
+			{
+				//改单没有发出去, 不会再有改单回报
+				{
+					SpinLock lock(_mtx_modify);
+					_modifying.erase(localid);
+				}
+				WTSLogger::log_dyn("trader", _id.c_str(), LL_ERROR, "[{}] Modifying order {} failed: {}", _id.c_str(), localid, iRet);
+				break;
+			}
+
+			WTSLogger::log_dyn("trader", _id.c_str(), LL_INFO, "[{}] Order {} modifying with price {} and qty {}", _id.c_str(), localid, newPrice, newQty);
+			ret = localid;
+			break;
+		}
+		else
+		{
+			//已经在改单中的订单, 直接更新新的价格和数量, 不再重复撤单
+			SpinLock lock(_mtx_modify);
+			auto it = _replacing.find(localid);
+			if (it != _replacing.end())
+			{
+				ReplaceItem& rItem = it->second;
+				rItem._price = newPrice;
+				rItem._qty = newQty;
+				ret = rItem._localid;
+				break;
+			}
+
+			//撤单回报可能在撤单接口返回之前就到了, 所以要先登记
+			ReplaceItem& rItem = _replacing[localid];
+			rItem._localid = makeLocalOrderID();
+			rItem._price = newPrice;
+			rItem._qty = newQty;
+			ret = rItem._localid;
+		}
+
+		if (!doCancel(ordInfo, true))
+		{
+			SpinLock lock(_mtx_modify);
+			_replacing.erase(localid);
+			ret = 0;
+			break;
+		}
+
+		//模拟改单的撤单也计入撤单频率
+		_cancel_time_cache[getStdCode(ordInfo->getContractInfo())].emplace_back(TimeUtils::getLocalTimeNow());
+
+		WTSLogger::log_dyn("trader", _id.c_str(), LL_INFO, "[{}] Order {} replacing by order {} with price {} and qty {}", _id.c_str(), localid, ret, newPrice, newQty);
+	} while (false);
+
+	ordInfo->release();
+	return ret;
+}
+
 OrderIDs TraderAdapter::cancel(const char* stdCode, bool isBuy, double qty /* = 0 */)
 {
 	CodeHelper::CodeInfo cInfo = CodeHelper::extractStdCode(stdCode, NULL);
@@ -1396,6 +1585,9 @@ uint32_t TraderAdapter::closeShort(const char* stdCode, double price, double qty
 #pragma region "ITraderSpi接口"
 void TraderAdapter::handleEvent(WTSTraderEvent e, int32_t ec)
 {
+	if (_capture)
+		_capture->record_trader_event(_id.c_str(), e, ec);
+
 	if(e == WTE_Connect)
 	{
 		if(ec == 0)
@@ -1417,6 +1609,9 @@ void TraderAdapter::handleEvent(WTSTraderEvent e, int32_t ec)
 
 void TraderAdapter::onLoginResult(bool bSucc, const char* msg, uint32_t tradingdate)
 {
+	if (_capture)
+		_capture->record_login(_id.c_str(), bSucc, msg, tradingdate, _trader_api->isModifySupported());
+
 	if(!bSucc)
 	{
 		_state = AS_LOGINFAILED;
@@ -1441,6 +1636,9 @@ void TraderAdapter::onLogout()
 
 void TraderAdapter::onRspEntrust(WTSEntrust* entrust, WTSError *err)
 {
+	if (_capture)
+		_capture->record_entrust(_id.c_str(), entrust, err);
+
 	if (err && err->getErrorCode() != WEC_NONE)
 	{
 		WTSLogger::log_dyn("trader", _id.c_str(), LL_ERROR, err->getMessage());
@@ -1505,23 +1703,22 @@ void TraderAdapter::onRspEntrust(WTSEntrust* entrust, WTSError *err)
 
 void TraderAdapter::onRspAccount(WTSArray* ayAccounts)
 {
+	if (_capture)
+		_capture->record_accounts(_id.c_str(), ayAccounts);
+
 	if (_save_data)
 	{
 		saveData(ayAccounts);
 	}
 
-	if(ayAccounts)
+	if(ayAccounts && ayAccounts->size() > 0)
 	{
-		//通知所有监听接口
-		for (auto sink : _sinks)
-		{
-			for (uint32_t idx = 0; idx < ayAccounts->size(); idx++)
-			{
-				WTSAccountInfo* fundInfo = (WTSAccountInfo*)ayAccounts->at(idx);
-				sink->on_account(fundInfo->getCurrency(), fundInfo->getPreBalance(), fundInfo->getBalance(), fundInfo->getBalance() + fundInfo->getDynProfit(), fundInfo->getAvailable(),
-					fundInfo->getCloseProfit(), fundInfo->getDynProfit(), fundInfo->getMargin(), fundInfo->getCommission(), fundInfo->getDeposit(), fundInfo->getWithdraw());
-			}
-		}
+		//每个币种第一次查询作为本地资金的初始值，之后的查询用于校对
+		for (uint32_t idx = 0; idx < ayAccounts->size(); idx++)
+			reconcileFund((WTSAccountInfo*)ayAccounts->at(idx));
+
+		//柜台资金上面已经落地了，这里只推送
+		notifyLocalFund(false);
 	}
 
 	if(_state == AS_TRADES_QRYED)
@@ -1536,6 +1733,9 @@ void TraderAdapter::onRspAccount(WTSArray* ayAccounts)
 
 void TraderAdapter::onRspPosition(const WTSArray* ayPositions)
 {
+	if (_capture)
+		_capture->record_positions(_id.c_str(), ayPositions);
+
 	if (ayPositions && ayPositions->size() > 0)
 	{
 		for (auto it = ayPositions->begin(); it != ayPositions->end(); it++)
@@ -1554,6 +1754,32 @@ void TraderAdapter::onRspPosition(const WTSArray* ayPositions)
 			else
 				stdCode = CodeHelper::rawFlatCodeToStdCode(cInfo->getCode(), cInfo->getExchg(), cInfo->getProduct());
 			PosItem& pos = _positions[stdCode];
+
+			//初始化本地资金模型的持仓成本，没有均价的用持仓成本折算
+			{
+				SpinLock lock(_mtx_fund);
+				FundPosItem& fItem = getFundPos(stdCode.c_str(), cInfo);
+				double qty = pItem->getTotalPosition();
+				double cost = pItem->getAvgPrice() * qty;
+				if (decimal::eq(cost, 0.0) && fItem._vol_scale > 0)
+					cost = pItem->getPositionCost() / fItem._vol_scale;
+
+				if (pItem->getDirection() == WDT_LONG)
+				{
+					fItem._l_volume = qty;
+					fItem._l_cost = cost;
+				}
+				else
+				{
+					fItem._s_volume = qty;
+					fItem._s_cost = cost;
+				}
+
+				if (decimal::eq(fItem._last_px, 0.0) && !decimal::eq(qty, 0.0))
+					fItem._last_px = cost / qty;
+				recalcFundPos(fItem);
+			}
+
 			if (pItem->getDirection() == WDT_LONG)
 			{
 				pos.l_newavail = pItem->getAvailNewPos();
@@ -1595,6 +1821,9 @@ void TraderAdapter::onRspPosition(const WTSArray* ayPositions)
 
 void TraderAdapter::onRspOrders(const WTSArray* ayOrders)
 {
+	if (_capture)
+		_capture->record_orders(_id.c_str(), ayOrders);
+
 	if (ayOrders)
 	{
 		if (_orders == NULL)
@@ -1728,6 +1957,9 @@ void TraderAdapter::printPosition(const char* code, const PosItem& pItem)
 
 void TraderAdapter::onRspTrades(const WTSArray* ayTrades)
 {
+	if (_capture)
+		_capture->record_trades(_id.c_str(), ayTrades);
+
 	if (ayTrades)
 	{
 		for (auto it = ayTrades->begin(); it != ayTrades->end(); it++)
@@ -1863,6 +2095,10 @@ void TraderAdapter::onPushOrder(WTSOrderInfo* orderInfo)
 	if (orderInfo == NULL)
 		return;
 
+	if (_capture)
+		_capture->record_order(_id.c_str(), orderInfo);
+
+
 
 	WTSContractInfo* cInfo = orderInfo->getContractInfo();
 	if (cInfo == NULL)
@@ -1879,6 +2115,15 @@ void TraderAdapter::onPushOrder(WTSOrderInfo* orderInfo)
 
 	bool isBuy = (orderInfo->getDirection() == WDT_LONG && orderInfo->getOffsetType() == WOT_OPEN) || (orderInfo->getDirection() == WDT_SHORT && orderInfo->getOffsetType() != WOT_OPEN);
 	
+	//模拟改单的订单结束了, 撤单照常计入撤单统计, 后面要用新的价格和数量重新下单
+	bool isReplaced = false;
+	if (!orderInfo->isAlive() && StrUtil::startsWith(orderInfo->getUserTag(), _order_pattern.c_str(), true))
+	{
+		uint32_t lid = strtoul(orderInfo->getUserTag() + _order_pattern.size() + 1, NULL, 10);
+		SpinLock lock(_mtx_modify);
+		isReplaced = (_replacing.find(lid) != _replacing.end());
+	}
+
 	//撤销的话, 要更新统计数据
 	if (orderInfo->getOrderState() == WOS_Canceled)
 	{
@@ -2101,6 +2346,8 @@ void TraderAdapter::onPushOrder(WTSOrderInfo* orderInfo)
 	//如果是wt发出去的单子则需要更新内部数据
 	if(localid != 0)
 	{
+		checkModified(localid, stdCode.c_str(), orderInfo);
+
 		{
 			SpinLock lock(_mtx_orders);
 			if (!orderInfo->isAlive() && _orders)
@@ -2119,8 +2366,14 @@ void TraderAdapter::onPushOrder(WTSOrderInfo* orderInfo)
 		//通知所有监听接口
 		for (auto sink : _sinks)
 			sink->on_order(localid, stdCode.c_str(), isBuy, orderInfo->getVolume(), orderInfo->getVolLeft(), orderInfo->getPrice(), orderInfo->getOrderState() == WOS_Canceled);
+
+		if (isReplaced)
+			doReplace(localid, stdCode.c_str(), orderInfo);
 	}
 
+	//更新开仓订单冻结的保证金
+	updateFundByOrder(orderInfo);
+
 	//不管是不是内部订单,订单结束了,都要写到日志里
 	if (_save_data && !orderInfo->isAlive())
 	{
@@ -2131,8 +2384,118 @@ void TraderAdapter::onPushOrder(WTSOrderInfo* orderInfo)
 		_notifier->notify(id(), localid, stdCode.c_str(), orderInfo);
 }
 
+void TraderAdapter::checkModified(uint32_t localid, const char* stdCode, WTSOrderInfo* ordInfo)
+{
+	double lastQty = 0;
+	{
+		SpinLock lock(_mtx_modify);
+		auto it = _modifying.find(localid);
+		if (it == _modifying.end())
+			return;
+
+		lastQty = it->second;
+		if (ordInfo->isAlive())
+			it->second = ordInfo->getVolume();
+		else
+			_modifying.erase(it);
+	}
+
+	double diff = ordInfo->getVolume() - lastQty;
+	if (decimal::eq(diff, 0))
+		return;
+
+	WTSLogger::log_dyn("trader", _id.c_str(), LL_INFO, "[{}] Order {} of {} modified, qty: {} -> {}, price: {}",
+		_id.c_str(), localid, stdCode, lastQty, ordInfo->getVolume(), ordInfo->getPrice());
+
+	bool isLong = (ordInfo->getDirection() == WDT_LONG);
+	bool isOpen = (ordInfo->getOffsetType() == WOT_OPEN);
+	bool isBuy = (isLong && isOpen) || (!isLong && !isOpen);
+	updateUndone(stdCode, diff*(isBuy ? 1 : -1), true);
+
+	//平仓单的数量变了, 可平量也要跟着调整
+	if (isOpen)
+		return;
+
+	PosItem& pItem = _positions[stdCode];
+	double& preavail = isLong ? pItem.l_preavail : pItem.s_preavail;
+	double& newavail = isLong ? pItem.l_newavail : pItem.s_newavail;
+	double prevol = isLong ? pItem.l_prevol : pItem.s_prevol;
+	if (ordInfo->getOffsetType() == WOT_CLOSETODAY)
+	{
+		newavail -= diff;
+	}
+	else if (diff > 0)
+	{
+		//数量增加, 先扣减可平昨仓, 再扣减可平今仓
+		double maxQty = min(preavail, diff);
+		preavail -= maxQty;
+		newavail -= diff - maxQty;
+	}
+	else
+	{
+		//数量减少, 先释放到昨仓, 超出昨仓的部分释放到今仓
+		preavail -= diff;
+		if (preavail > prevol)
+		{
+			newavail += (preavail - prevol);
+			preavail = prevol;
+		}
+	}
+	newavail = max(newavail, 0.0);
+	printPosition(stdCode, pItem);
+}
+
+void TraderAdapter::doReplace(uint32_t localid, const char* stdCode, WTSOrderInfo* ordInfo)
+{
+	ReplaceItem rItem;
+	{
+		SpinLock lock(_mtx_modify);
+		auto it = _replacing.find(localid);
+		if (it == _replacing.end())
+			return;
+
+		rItem = it->second;
+		_replacing.erase(it);
+	}
+
+	//撤单之前订单已经结束了, 就不再重新下单了
+	if (ordInfo->getOrderState() != WOS_Canceled)
+	{
+		WTSLogger::log_dyn("trader", _id.c_str(), LL_WARN, "[{}] Order {} of {} finished before replaced, replacing order {} dropped", 
+			_id.c_str(), localid, stdCode, rItem._localid);
+		for (auto sink : _sinks)
+			sink->on_entrust(rItem._localid, stdCode, false, "order finished before replaced");
+		return;
+	}
+
+	WTSEntrust* entrust = WTSEntrust::create(ordInfo->getCode(), rItem._qty, rItem._price, ordInfo->getExchg());
+	entrust->setContractInfo(ordInfo->getContractInfo());
+	if (decimal::eq(rItem._price, 0.0))
+		entrust->setPriceType(WPT_ANYPRICE);
+	else
+		entrust->setPriceType(WPT_LIMITPRICE);
+	entrust->setOrderFlag(ordInfo->getOrderFlag());
+	entrust->setDirection(ordInfo->getDirection());
+	entrust->setOffsetType(ordInfo->getOffsetType());
+
+	uint32_t ret = doEntrust(entrust, rItem._localid);
+	entrust->release();
+	if (ret == UINT_MAX)
+	{
+		for (auto sink : _sinks)
+			sink->on_entrust(rItem._localid, stdCode, false, "replacing order placing failed");
+		return;
+	}
+
+	bool isBuy = (ordInfo->getDirection() == WDT_LONG && ordInfo->getOffsetType() == WOT_OPEN) || (ordInfo->getDirection() == WDT_SHORT && ordInfo->getOffsetType() != WOT_OPEN);
+	updateUndone(stdCode, rItem._qty*(isBuy ? 1 : -1), true);
+}
+
 void TraderAdapter::onPushTrade(WTSTradeInfo* tradeRecord)
 {
+	if (_capture)
+		_capture->record_trade(_id.c_str(), tradeRecord);
+
 	WTSContractInfo* cInfo = tradeRecord->getContractInfo();
 	if (cInfo == NULL)
 		return;
@@ -2224,6 +2587,9 @@ void TraderAdapter::onPushTrade(WTSTradeInfo* tradeRecord)
 
 	printPosition(stdCode.c_str(), pItem);
 
+	uint32_t offset = isOpen ? 0 : (tradeRecord->getOffsetType() == WOT_CLOSETODAY ? 2 : 1);
+	updateFundByTrade(stdCode.c_str(), cInfo, isLong, offset, vol, tradeRecord->getPrice());
+
 	//如果是自己的订单，则更新未完成单
 	uint32_t localid = 0;
 	if (StrUtil::startsWith(tradeRecord->getUserTag(), _order_pattern.c_str(), true))
@@ -2248,7 +2614,11 @@ void TraderAdapter::onPushTrade(WTSTradeInfo* tradeRecord)
 	if (_notifier)
 		_notifier->notify(id(), localid, stdCode.c_str(), tradeRecord);
 
-	_trader_api->queryAccount();
+	/*
+	 *	成交以后不再查询柜台资金，直接推送本地计算的资金
+	 *	柜台查询有流控，成交密集的时候查询会被拒绝，资金数据反而更滞后
+	 */
+	notifyLocalFund();
 }
 
 void TraderAdapter::onTraderError(WTSError* err, void* pData /* = NULL */)
@@ -2275,9 +2645,227 @@ void TraderAdapter::queryFund()
 	if (_state != AS_ALLREADY)
 		return;
 
+	//本地资金是实时的，直接推送，不用等柜台回报
+	notifyLocalFund();
+
+	//按照设定的间隔查询柜台资金，用于校对
+	if (_fund_qry_span == 0)
+		return;
+
+	uint64_t now = TimeUtils::getLocalTimeNow();
+	if (now - _last_fund_qry < _fund_qry_span * 1000ULL)
+		return;
+
+	_last_fund_qry = now;
 	_trader_api->queryAccount();
 }
 
+TraderAdapter::FundPosItem& TraderAdapter::getFundPos(const char* stdCode, WTSContractInfo* cInfo)
+{
+	FundPosItem& fItem = _fund_pos[stdCode];
+	if (fItem._cinfo == NULL && cInfo != NULL)
+	{
+		fItem._cinfo = cInfo;
+		fItem._currency = cInfo->getCommInfo()->getCurrency();
+		fItem._vol_scale = cInfo->getCommInfo()->getVolScale();
+	}
+	return fItem;
+}
+
+void TraderAdapter::recalcFundPos(FundPosItem& fItem)
+{
+	if (fItem._cinfo == NULL)
+		return;
+
+	double dynprofit = (fItem._last_px*fItem._l_volume - fItem._l_cost + fItem._s_cost - fItem._last_px*fItem._s_volume)*fItem._vol_scale;
+	double margin = (fItem._l_cost*fItem._cinfo->getLongMarginRatio() + fItem._s_cost*fItem._cinfo->getShortMarginRatio())*fItem._vol_scale;
+
+	LocalFund& fund = _local_funds[fItem._currency];
+	fund._dynprofit += dynprofit - fItem._dynprofit;
+	fund._margin += margin - fItem._margin;
+	fItem._dynprofit = dynprofit;
+	fItem._margin = margin;
+}
+
+void TraderAdapter::updatePrice(const char* stdCode, double price)
+{
+	SpinLock lock(_mtx_fund);
+	auto it = _fund_pos.find(stdCode);
+	if (it == _fund_pos.end())
+		return;
+
+	//价格变动只影响浮动盈亏，按净持仓增量更新
+	FundPosItem& fItem = it->second;
+	double delta = (price - fItem._last_px)*(fItem._l_volume - fItem._s_volume)*fItem._vol_scale;
+	fItem._last_px = price;
+	fItem._dynprofit += delta;
+	if (fItem._cinfo != NULL)
+		_local_funds[fItem._currency]._dynprofit += delta;
+}
+
+TraderAdapter::LocalFund TraderAdapter::getLocalFund(const char* currency)
+{
+	SpinLock lock(_mtx_fund);
+	auto it = _local_funds.find(currency);
+	if (it == _local_funds.end())
+		return LocalFund();
+
+	return it->second;
+}
+
+void TraderAdapter::updateFundByTrade(const char* stdCode, WTSContractInfo* cInfo, bool isLong, uint32_t offset, double vol, double price)
+{
+	SpinLock lock(_mtx_fund);
+	FundPosItem& fItem = getFundPos(stdCode, cInfo);
+	LocalFund& fund = _local_funds[fItem._currency];
+	if (decimal::eq(fItem._last_px, 0.0))
+		fItem._last_px = price;
+
+	double& posVol = isLong ? fItem._l_volume : fItem._s_volume;
+	double& posCost = isLong ? fItem._l_cost : fItem._s_cost;
+	if (offset == 0)
+	{
+		posVol += vol;
+		posCost += price * vol;
+	}
+	else
+	{
+		//平仓按持仓均价结转成本
+		double closeVol = min(vol, posVol);
+		double avgPx = decimal::eq(posVol, 0.0) ? price : posCost / posVol;
+		double profit = (price - avgPx)*closeVol*fItem._vol_scale;
+		fund._closeprofit += isLong ? profit : -profit;
+
+		posVol -= closeVol;
+		posCost -= avgPx * closeVol;
+		if (decimal::eq(posVol, 0.0))
+		{
+			posVol = 0;
+			posCost = 0;
+		}
+	}
+
+	fund._fee += cInfo->calcFee(price, vol, offset);
+	recalcFundPos(fItem);
+}
+
+void TraderAdapter::updateFundByOrder(WTSOrderInfo* ordInfo)
+{
+	const char* orderid = ordInfo->getOrderID();
+	if (strlen(orderid) == 0 || ordInfo->getOffsetType() != WOT_OPEN)
+		return;
+
+	WTSContractInfo* cInfo = ordInfo->getContractInfo();
+	double newFrozen = 0;
+	if (ordInfo->isAlive())
+	{
+		double ratio = (ordInfo->getDirection() == WDT_LONG) ? cInfo->getLongMarginRatio() : cInfo->getShortMarginRatio();
+		newFrozen = ordInfo->getPrice()*ordInfo->getVolLeft()*cInfo->getCommInfo()->getVolScale()*ratio;
+	}
+
+	SpinLock lock(_mtx_fund);
+	auto it = _frozen_margins.find(orderid);
+	double oldFrozen = (it == _frozen_margins.end()) ? 0 : it->second;
+	_local_funds[cInfo->getCommInfo()->getCurrency()]._frozen_margin += newFrozen - oldFrozen;
+
+	if (ordInfo->isAlive())
+		_frozen_margins[orderid] = newFrozen;
+	else if (it != _frozen_margins.end())
+		_frozen_margins.erase(it);
+}
+
+void TraderAdapter::reconcileFund(WTSAccountInfo* fundInfo)
+{
+	SpinLock lock(_mtx_fund);
+	const char* currency = fundInfo->getCurrency();
+	LocalFund& fund = _local_funds[currency];
+	if (fund._inited)
+	{
+		double localBal = fund.dynbalance();
+		double remoteBal = fundInfo->getBalance() + fundInfo->getDynProfit();
+		double drift = localBal - remoteBal;
+		bool bExceeded = (_fund_drift_limit > 0 && fabs(drift) > _fund_drift_limit);
+		WTSLogger::log_dyn("trader", _id.c_str(), bExceeded ? LL_WARN : LL_INFO,
+			"[{}] Fund of {} reconciled, local dynbalance: {:.2f}, remote dynbalance: {:.2f}, drift: {:.2f}, closeprofit drift: {:.2f}, dynprofit drift: {:.2f}, margin drift: {:.2f}, fee drift: {:.2f}",
+			_id.c_str(), currency, localBal, remoteBal, drift, fund._closeprofit - fundInfo->getCloseProfit(), fund._dynprofit - fundInfo->getDynProfit(),
+			fund._margin - fundInfo->getMargin(), fund._fee - fundInfo->getCommission());
+
+		if (bExceeded)
+		{
+			//偏差超限，保证金和浮动盈亏也以柜台为准，之后再按持仓增量更新
+			fund._margin = fundInfo->getMargin();
+			fund._dynprofit = fundInfo->getDynProfit();
+
+			if (_notifier)
+				_notifier->notify(id(), fmt::format("Fund drift of {} {:.2f} exceeds limit {:.2f}, rebased to broker", currency, drift, _fund_drift_limit).c_str());
+		}
+	}
+	else
+	{
+		fund._inited = true;
+		WTSLogger::log_dyn("trader", _id.c_str(), LL_INFO, "[{}] Local fund of {} initialized, prebalance: {:.2f}, balance: {:.2f}",
+			_id.c_str(), currency, fundInfo->getPreBalance(), fundInfo->getBalance());
+	}
+
+	//出入金、平仓盈亏和手续费是累计量，直接以柜台为准
+	//保证金和浮动盈亏是根据持仓实时计算的，偏差超限才重新校准
+	fund._prebalance = fundInfo->getPreBalance();
+	fund._closeprofit = fundInfo->getCloseProfit();
+	fund._fee = fundInfo->getCommission();
+	fund._deposit = fundInfo->getDeposit();
+	fund._withdraw = fundInfo->getWithdraw();
+}
+
+void TraderAdapter::notifyLocalFund(bool bSave /* = true */)
+{
+	wt_hashmap<std::string, LocalFund> funds;
+	{
+		SpinLock lock(_mtx_fund);
+		for (auto& v : _local_funds)
+		{
+			if (v.second._inited)
+				funds[v.first] = v.second;
+		}
+	}
+
+	if (funds.empty())
+		return;
+
+	if (_save_data && bSave)
+	{
+		WTSArray* ayFunds = WTSArray::create();
+		for (auto& v : funds)
+		{
+			const LocalFund& fund = v.second;
+			WTSAccountInfo* fundInfo = WTSAccountInfo::create();
+			fundInfo->setCurrency(v.first.c_str());
+			fundInfo->setPreBalance(fund._prebalance);
+			fundInfo->setBalance(fund.balance());
+			fundInfo->setCloseProfit(fund._closeprofit);
+			fundInfo->setDynProfit(fund._dynprofit);
+			fundInfo->setMargin(fund._margin);
+			fundInfo->setFrozenMargin(fund._frozen_margin);
+			fundInfo->setCommission(fund._fee);
+			fundInfo->setAvailable(fund.available());
+			fundInfo->setDeposit(fund._deposit);
+			fundInfo->setWithdraw(fund._withdraw);
+			ayFunds->append(fundInfo, false);
+		}
+		saveData(ayFunds);
+		ayFunds->release();
+	}
+
+	for (auto sink : _sinks)
+	{
+		for (auto& v : funds)
+		{
+			const LocalFund& fund = v.second;
+			sink->on_account(v.first.c_str(), fund._prebalance, fund.balance(), fund.dynbalance(), fund.available(),
+				fund._closeprofit, fund._dynprofit, fund._margin, fund._fee, fund._deposit, fund._withdraw);
+		}
+	}
+}
+
 #pragma endregion "ITraderSpi接口"
 
 
@@ -2337,4 +2925,36 @@ void TraderAdapterMgr::refresh_funds()
 	{
 		it->second->queryFund();
 	}
+}
+
+void TraderAdapterMgr::update_price(const char* stdCode, double price)
+{
+	for (auto it = _adapters.begin(); it != _adapters.end(); it++)
+	{
+		it->second->updatePrice(stdCode, price);
+	}
+}
+
+void TraderAdapterMgr::set_standby(ShmStandby* standby)
+{
+	for (auto it = _adapters.begin(); it != _adapters.end(); it++)
+	{
+		it->second->setStandby(standby);
+	}
+}
+
+void TraderAdapterMgr::set_capture(EventCapture* capture)
+{
+	for (auto it = _adapters.begin(); it != _adapters.end(); it++)
+	{
+		it->second->setCapture(capture);
+	}
+}
+
+void TraderAdapterMgr::resync()
+{
+	for (auto it = _adapters.begin(); it != _adapters.end(); it++)
+	{
+		it->second->resync();
+	}
 }
\ No newline at end of file
@@ -15,14 +15,17 @@
 #include "../Share/BoostFile.hpp"
 #include "../Share/StdUtils.hpp"
 #include "../Share/SpinMutex.hpp"
+#include "../Share/ShmStandby.hpp"
 
 NS_WTP_BEGIN
 class WTSVariant;
 class ActionPolicyMgr;
 class WTSContractInfo;
 class WTSCommodityInfo;
+class WTSAccountInfo;
 class WtLocalExecuter;
 class EventNotifier;
+class EventCapture;
 
 class ITrdNotifySink;
 
@@ -99,8 +102,40 @@ public:
 		}
 	} RiskParams;
 
+	/*
+	 *	本地维护的账户资金，每个币种一份
+	 *	根据成交、订单状态和最新价实时计算，柜台的资金查询只用来定期校对
+	 */
+	typedef struct _LocalFund
+	{
+		bool	_inited;		//是否已经从柜台获取了初始资金
+		double	_prebalance;	//上日结存
+		double	_closeprofit;	//平仓盈亏
+		double	_dynprofit;		//浮动盈亏
+		double	_margin;		//占用保证金
+		double	_frozen_margin;	//冻结保证金
+		double	_fee;			//手续费
+		double	_deposit;		//入金
+		double	_withdraw;		//出金
+
+		_LocalFund()
+		{
+			memset(this, 0, sizeof(_LocalFund));
+		}
+
+		//静态权益
+		inline double balance() const { return _prebalance + _closeprofit - _fee + _deposit - _withdraw; }
+		//动态权益
+		inline double dynbalance() const { return balance() + _dynprofit; }
+		//可用资金
+		inline double available() const { return dynbalance() - _margin - _frozen_margin; }
+	} LocalFund;
+
 public:
-	bool init(const char* id, WTSVariant* params, IBaseDataMgr* bdMgr, ActionPolicyMgr* policyMgr);
+	/*
+	 *	@api	外部指定的交易接口，不为空则不再加载交易模块(回放用)
+	 */
+	bool init(const char* id, WTSVariant* params, IBaseDataMgr* bdMgr, ActionPolicyMgr* policyMgr, ITraderApi* api = NULL);
 	bool initExt(const char* id, ITraderApi* api, IBaseDataMgr* bdMgr, ActionPolicyMgr* policyMgr);
 
 	void release();
@@ -120,9 +155,64 @@ public:
 
 	void queryFund();
 
+	/*
+	 *	更新最新价，用于计算本地资金的浮动盈亏
+	 */
+	void updatePrice(const char* stdCode, double price);
+
+	/*
+	 *	获取本地维护的资金数据
+	 *	@currency	币种
+	 */
+	LocalFund getLocalFund(const char* currency);
+
+	/*
+	 *	设置主备热切换组件，没有租约的时候不能下单撤单
+	 */
+	inline void setStandby(ShmStandby* standby) { _standby = standby; }
+
+	/*
+	 *	设置事件录制组件，所有交易回报都会先录制再处理
+	 */
+	inline void setCapture(EventCapture* capture) { _capture = capture; }
+
+	inline ITraderApi* getTraderApi() { return _trader_api; }
+
+	/*
+	 *	重新查询持仓和订单，备进程接管以后调用
+	 */
+	void resync();
+
+	/*
+	 *	同步主进程已经使用的本地订单号，保证接管以后不会生成重复的订单号
+	 */
+	static void syncLocalOrderID(uint32_t localid);
+
+	/*
+	 *	查看下一个本地订单号，不消耗
+	 */
+	static uint32_t peekLocalOrderID();
+
 private:
-	uint32_t doEntrust(WTSEntrust* entrust);
-	bool	doCancel(WTSOrderInfo* ordInfo);
+	/*
+	 *	fencing检查，主备模式下只有持有租约的进程才能发出交易指令
+	 */
+	inline bool isFenced();
+
+	uint32_t doEntrust(WTSEntrust* entrust, uint32_t localid = 0);
+	bool	doCancel(WTSOrderInfo* ordInfo, bool bForReplace = false);
+
+	/*
+	 *	原生改单回报以后，订单数量可能发生变化，同步更新未完成数量和可平量
+	 */
+	void	checkModified(uint32_t localid, const char* stdCode, WTSOrderInfo* ordInfo);
+
+	/*
+	 *	模拟改单的撤单回报以后，按照新的价格和数量重新下单
+	 */
+	void	doReplace(uint32_t localid, const char* stdCode, WTSOrderInfo* ordInfo);
+
+	inline std::string	getStdCode(WTSContractInfo* cInfo);
 
 	inline void	printPosition(const char* stdCode, const PosItem& pItem);
 
@@ -140,6 +230,35 @@ private:
 
 	inline void updateUndone(const char* stdCode, double qty, bool bOuput = true);
 
+	typedef struct _FundPosItem
+	{
+		WTSContractInfo*	_cinfo;
+		const char*	_currency;	//币种，指向品种信息里的币种
+		double	_vol_scale;
+
+		double	_l_volume;	//多头持仓
+		double	_l_cost;	//多头持仓成本，开仓价*数量
+		double	_s_volume;	//空头持仓
+		double	_s_cost;	//空头持仓成本
+
+		double	_last_px;	//最新价
+		double	_dynprofit;	//当前计入的浮动盈亏
+		double	_margin;	//当前计入的保证金
+
+		_FundPosItem()
+		{
+			memset(this, 0, sizeof(_FundPosItem));
+		}
+	} FundPosItem;
+
+	inline FundPosItem& getFundPos(const char* stdCode, WTSContractInfo* cInfo);
+	inline void	recalcFundPos(FundPosItem& fItem);
+
+	void	updateFundByTrade(const char* stdCode, WTSContractInfo* cInfo, bool isLong, uint32_t offset, double vol, double price);
+	void	updateFundByOrder(WTSOrderInfo* ordInfo);
+	void	reconcileFund(WTSAccountInfo* fundInfo);
+	void	notifyLocalFund(bool bSave = true);
+
 public:
 	double getPosition(const char* stdCode, bool bValidOnly, int32_t flag = 3);
 	OrderMap* getOrders(const char* stdCode);
@@ -164,6 +283,19 @@ public:
 	bool	cancel(uint32_t localid);
 	OrderIDs cancel(const char* stdCode, bool isBuy, double qty = 0);
 
+	/*
+	 *	改单接口
+	 *	交易通道支持原生改单的，直接改单，本地订单号不变
+	 *	不支持的，先撤单，等撤单回报以后再用新的价格和数量重新下单，返回重新下单的本地订单号
+	 *	改单引起的撤单不计入撤单统计，也不参与撤单频率控制
+	 *
+	 *	@localid	要修改的本地订单号
+	 *	@newPrice	新的委托价格，0则是市价单
+	 *	@newQty		新的剩余数量
+	 *	@return		改单以后的本地订单号，失败返回0
+	 */
+	uint32_t modify(uint32_t localid, double newPrice, double newQty);
+
 	inline bool	isTradeEnabled(const char* stdCode) const;
 
 	bool	checkCancelLimits(const char* stdCode);
@@ -245,6 +377,17 @@ private:
 
 	wt_hashmap<std::string, double> _undone_qty;	//未完成数量
 
+	//模拟改单的订单，撤单回报以后重新下单
+	typedef struct _ReplaceItem
+	{
+		uint32_t	_localid;	//重新下单的本地订单号
+		double		_price;
+		double		_qty;
+	} ReplaceItem;
+	SpinMutex	_mtx_modify;
+	wt_hashmap<uint32_t, ReplaceItem>	_replacing;
+	wt_hashmap<uint32_t, double>		_modifying;	//原生改单的订单，value为最后一次确认的委托数量
+
 	typedef WTSHashMap<std::string>	TradeStatMap;
 	TradeStatMap*	_stat_map;	//统计数据
 
@@ -265,6 +408,19 @@ private:
 	BoostFilePtr	_trades_log;		//交易数据日志
 	BoostFilePtr	_orders_log;		//订单数据日志
 	std::string		_rt_data_file;		//实时数据文件
+
+	//本地资金模型
+	SpinMutex		_mtx_fund;
+	wt_hashmap<std::string, LocalFund>		_local_funds;	//按币种区分的本地资金
+	wt_hashmap<std::string, FundPosItem>	_fund_pos;		//用于计算资金的持仓数据
+	wt_hashmap<std::string, double>			_frozen_margins;	//订单冻结的保证金，key为订单号
+	uint32_t		_fund_qry_span;		//柜台资金查询的间隔(秒)，0为不查询
+	double			_fund_drift_limit;	//本地资金和柜台资金的偏差超过该值就报警，并以柜台为准重新校准
+	uint64_t		_last_fund_qry;		//上次查询柜台资金的时间
+
+	ShmStandby*		_standby;			//主备热切换组件
+	std::atomic<bool>	_fence_logged;		//本轮备机状态是否已经输出过拦截日志
+	EventCapture*	_capture;			//事件录制组件
 };
 
 typedef std::shared_ptr<TraderAdapter>				TraderAdapterPtr;
@@ -288,6 +444,14 @@ public:
 
 	void	refresh_funds();
 
+	void	update_price(const char* stdCode, double price);
+
+	void	set_standby(ShmStandby* standby);
+
+	void	set_capture(EventCapture* capture);
+
+	void	resync();
+
 private:
 	TraderAdapterMap	_adapters;
 };
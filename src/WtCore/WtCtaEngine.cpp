@@ -10,6 +10,7 @@
 #define WIN32_LEAN_AND_MEAN
 
 #include "WtCtaEngine.h"
+#include "EventCapture.h"
 #include "WtDtMgr.h"
 #include "WtCtaTicker.h"
 #include "WtHelper.h"
@@ -50,11 +51,11 @@ WtCtaEngine::~WtCtaEngine()
 		_cfg->release();
 }
 
-void WtCtaEngine::run()
+void WtCtaEngine::run(bool bReplay /* = false */)
 {
 	_tm_ticker = new WtCtaRtTicker(this);
 	WTSVariant* cfgProd = _cfg->get("product");
-	_tm_ticker->init(_data_mgr->reader(), cfgProd->getCString("session"));
+	_tm_ticker->init(_data_mgr, cfgProd->getCString("session"), _cfg->get("ticker"));
 
 	//启动之前,先把运行中的策略落地
 	{
@@ -98,13 +99,24 @@ void WtCtaEngine::run()
 		StdFile::write_file_content(filename.c_str(), sb.GetString());
 	}
 
-	_tm_ticker->run();
+	_tm_ticker->run(bReplay);
 
 	if (_risk_mon)
 		_risk_mon->self()->run();
 
 }
 
+void WtCtaEngine::replay_timer(uint32_t uKind, uint32_t uDate, uint32_t uTime)
+{
+	if (_tm_ticker == NULL)
+		return;
+
+	if (uKind == CTK_SessionEnd)
+		_tm_ticker->fire_session_end();
+	else
+		_tm_ticker->fire_minute_end();
+}
+
 void WtCtaEngine::init(WTSVariant* cfg, IBaseDataMgr* bdMgr, WtDtMgr* dataMgr, IHotMgr* hotMgr, EventNotifier* notifier /* = NULL */)
 {
 	WtEngine::init(cfg, bdMgr, dataMgr, hotMgr, notifier);
@@ -126,6 +138,7 @@ void WtCtaEngine::addContext(CtaContextPtr ctx)
 {
 	uint32_t sid = ctx->id();
 	_ctx_map[sid] = ctx;
+	_profiler.add_strategy(sid, ctx->name());
 }
 
 CtaContextPtr WtCtaEngine::getContext(uint32_t id)
@@ -214,7 +227,10 @@ void WtCtaEngine::on_session_begin()
 	for (auto it = _ctx_map.begin(); it != _ctx_map.end(); it++)
 	{
 		CtaContextPtr& ctx = (CtaContextPtr&)it->second;
-		ctx->on_session_begin(_cur_tdate);
+		uint32_t tdate = _cur_tdate;
+		dispatch_sync(ctx->id(), PCB_Event, [ctx, tdate]() {
+			ctx->on_session_begin(tdate);
+		});
 	}
 
 	if (_evt_listener)
@@ -230,7 +246,10 @@ void WtCtaEngine::on_session_end()
 	for (auto it = _ctx_map.begin(); it != _ctx_map.end(); it++)
 	{
 		CtaContextPtr& ctx = (CtaContextPtr&)it->second;
-		ctx->on_session_end(_cur_tdate);
+		uint32_t tdate = _cur_tdate;
+		dispatch_sync(ctx->id(), PCB_Event, [ctx, tdate]() {
+			ctx->on_session_end(tdate);
+		});
 	}
 
 	WTSLogger::info("Trading day {} ended", _cur_tdate);
@@ -240,9 +259,15 @@ void WtCtaEngine::on_session_end()
 
 void WtCtaEngine::on_schedule(uint32_t curDate, uint32_t curTime)
 {
+	report_profiles();
+
 	//去检查一下过滤器
 	_filter_mgr.load_filters();
-	_exec_mgr.clear_cached_targets();
+	{
+		//这里不能一直持有持仓锁，下面要等被隔离的策略执行完
+		StdLocker<StdRecurMutex> lock(_mtx_pos);
+		_exec_mgr.clear_cached_targets();
+	}
 	wt_hashmap<std::string, double> target_pos;
 	if(_pool)
 	{
@@ -256,8 +281,10 @@ void WtCtaEngine::on_schedule(uint32_t curDate, uint32_t curTime)
 		for (auto it = _ctx_map.begin(); it != _ctx_map.end(); it++)
 		{
 			CtaContextPtr& ctx = (CtaContextPtr&)it->second;
-			_pool->schedule([ctx, curDate, curTime] (){
-				ctx->on_schedule(curDate, curTime);
+			_pool->schedule([this, ctx, curDate, curTime] (){
+				dispatch_sync(ctx->id(), PCB_Calc, [ctx, curDate, curTime]() {
+					ctx->on_schedule(curDate, curTime);
+				});
 			});
 		}
 
@@ -270,39 +297,7 @@ void WtCtaEngine::on_schedule(uint32_t curDate, uint32_t curTime)
 		for (auto it = _ctx_map.begin(); it != _ctx_map.end(); it++)
 		{
 			CtaContextPtr& ctx = (CtaContextPtr&)it->second;
-			const auto& exec_ids = _exec_mgr.get_route(ctx->name());
-			ctx->enum_position([this, ctx, exec_ids, &target_pos](const char* stdCode, double qty) {
-
-				double oldQty = qty;
-				bool bFilterd = _filter_mgr.is_filtered_by_strategy(ctx->name(), qty);
-				if (!bFilterd)
-				{
-					if (!decimal::eq(qty, oldQty))
-					{
-						//输出日志
-						WTSLogger::info("[Filters] Target position of {} of strategy {} reset by strategy filter: {} -> {}",
-							stdCode, ctx->name(), oldQty, qty);
-					}
-
-					std::string realCode = stdCode;
-					CodeHelper::CodeInfo cInfo = CodeHelper::extractStdCode(stdCode, _hot_mgr);
-					if (strlen(cInfo._ruletag) > 0)
-					{
-						std::string code = _hot_mgr->getCustomRawCode(cInfo._ruletag, cInfo.stdCommID(), _cur_tdate);
-						realCode = CodeHelper::rawMonthCodeToStdCode(code.c_str(), cInfo._exchg);
-					}
-
-					double& vol = target_pos[realCode];
-					vol += qty;
-					for (auto& execid : exec_ids)
-						_exec_mgr.add_target_to_cache(realCode.c_str(), qty, execid.c_str());
-				}
-				else
-				{
-					//输出日志
-					WTSLogger::info("[Filters] Target position of {} of strategy {} ignored by strategy filter", stdCode, ctx->name());
-				}
-			}, true);
+			collect_targets(ctx, target_pos);
 		}
 	}
 	else
@@ -310,44 +305,71 @@ void WtCtaEngine::on_schedule(uint32_t curDate, uint32_t curTime)
 		for (auto it = _ctx_map.begin(); it != _ctx_map.end(); it++)
 		{
 			CtaContextPtr& ctx = (CtaContextPtr&)it->second;
-			ctx->on_schedule(curDate, curTime);
-			const auto& exec_ids = _exec_mgr.get_route(ctx->name());
-			ctx->enum_position([this, ctx, exec_ids, &target_pos](const char* stdCode, double qty) {
+			dispatch_sync(ctx->id(), PCB_Calc, [ctx, curDate, curTime]() {
+				ctx->on_schedule(curDate, curTime);
+			});
+			collect_targets(ctx, target_pos);
+		}
+	}
 
-				double oldQty = qty;
-				bool bFilterd = _filter_mgr.is_filtered_by_strategy(ctx->name(), qty);
-				if (!bFilterd)
-				{
-					if (!decimal::eq(qty, oldQty))
-					{
-						//输出日志
-						WTSLogger::info("[Filters] Target position of {} of strategy {} reset by strategy filter: {} -> {}",
-							stdCode, ctx->name(), oldQty, qty);
-					}
+	commit_targets(target_pos);
 
-					std::string realCode = stdCode;
-					CodeHelper::CodeInfo cInfo = CodeHelper::extractStdCode(stdCode, _hot_mgr);
-					if (strlen(cInfo._ruletag) > 0)
-					{
-						std::string code = _hot_mgr->getCustomRawCode(cInfo._ruletag, cInfo.stdCommID(), _cur_tdate);
-						realCode = CodeHelper::rawMonthCodeToStdCode(code.c_str(), cInfo._exchg);
-					}
+	push_task([this](){
+		update_fund_dynprofit();
+		/*
+		 *	By Wesley @ 2023.01.30
+		 *	增加一个定时刷新交易账号资金的入口
+		 */
+		_adapter_mgr->refresh_funds();
+	});
 
-					double& vol = target_pos[realCode];
-					vol += qty;
-					for (auto& execid : exec_ids)
-						_exec_mgr.add_target_to_cache(realCode.c_str(), qty, execid.c_str());
-				}
-				else
-				{
-					//输出日志
-					WTSLogger::info("[Filters] Target position of {} of strategy {} ignored by strategy filter", stdCode, ctx->name());
-				}
-			}, true);
+	save_datas();
+
+	if (_evt_listener)
+		_evt_listener->on_schedule_event(curDate, curTime);
+}
+
+void WtCtaEngine::collect_targets(CtaContextPtr& ctx, wt_hashmap<std::string, double>& target_pos)
+{
+	StdLocker<StdRecurMutex> lock(_mtx_pos);
+	const auto& exec_ids = _exec_mgr.get_route(ctx->name());
+	ctx->enum_position([this, ctx, exec_ids, &target_pos](const char* stdCode, double qty) {
+
+		double oldQty = qty;
+		bool bFilterd = _filter_mgr.is_filtered_by_strategy(ctx->name(), qty);
+		if (!bFilterd)
+		{
+			if (!decimal::eq(qty, oldQty))
+			{
+				//输出日志
+				WTSLogger::info("[Filters] Target position of {} of strategy {} reset by strategy filter: {} -> {}",
+					stdCode, ctx->name(), oldQty, qty);
+			}
+
+			std::string realCode = stdCode;
+			CodeHelper::CodeInfo cInfo = CodeHelper::extractStdCode(stdCode, _hot_mgr);
+			if (strlen(cInfo._ruletag) > 0)
+			{
+				std::string code = _hot_mgr->getCustomRawCode(cInfo._ruletag, cInfo.stdCommID(), _cur_tdate);
+				realCode = CodeHelper::rawMonthCodeToStdCode(code.c_str(), cInfo._exchg);
+			}
+
+			double& vol = target_pos[realCode];
+			vol += qty;
+			for (auto& execid : exec_ids)
+				_exec_mgr.add_target_to_cache(realCode.c_str(), qty, execid.c_str());
 		}
-	}
-	
+		else
+		{
+			//输出日志
+			WTSLogger::info("[Filters] Target position of {} of strategy {} ignored by strategy filter", stdCode, ctx->name());
+		}
+	}, true);
+}
 
+void WtCtaEngine::commit_targets(wt_hashmap<std::string, double>& target_pos)
+{
+	StdLocker<StdRecurMutex> lock(_mtx_pos);
 	bool bRiskEnabled = false;
 	if(!decimal::eq(_risk_volscale, 1.0) && _risk_date == _cur_tdate)
 	{
@@ -393,33 +415,59 @@ void WtCtaEngine::on_schedule(uint32_t curDate, uint32_t curTime)
 		}
 	}
 
-	push_task([this](){
-		update_fund_dynprofit();
-		/*
-		 *	By Wesley @ 2023.01.30
-		 *	增加一个定时刷新交易账号资金的入口
-		 */
-		_adapter_mgr->refresh_funds();
-	});
-
 	//_exec_mgr.set_positions(target_pos);
 	_exec_mgr.commit_cached_targets(bRiskEnabled ? _risk_volscale : 1);
+}
+
+void WtCtaEngine::on_takeover(ShmStandby* standby)
+{
+	WtEngine::on_takeover(standby);
+
+	standby->enum_latest([this](uint32_t rtype, const char* key, const char* data, std::size_t len) {
+		if (rtype != SRT_StraData && rtype != SRT_StraUserData)
+			return;
+
+		for (auto it = _ctx_map.begin(); it != _ctx_map.end(); it++)
+		{
+			CtaContextPtr& ctx = (CtaContextPtr&)it->second;
+			if (strcmp(ctx->name(), key) == 0)
+			{
+				ctx->restore_state(rtype, data, len);
+				break;
+			}
+		}
+	});
 
+	//用恢复以后的策略持仓重新计算一次目标仓位，交给执行器去对齐实际持仓
+	_exec_mgr.clear_cached_targets();
+	wt_hashmap<std::string, double> target_pos;
+	for (auto it = _ctx_map.begin(); it != _ctx_map.end(); it++)
+	{
+		CtaContextPtr& ctx = (CtaContextPtr&)it->second;
+		collect_targets(ctx, target_pos);
+	}
+	commit_targets(target_pos);
 	save_datas();
 
-	if (_evt_listener)
-		_evt_listener->on_schedule_event(curDate, curTime);
+	WTSLogger::info("CTA engine took over with {} strategies and {} targets", _ctx_map.size(), target_pos.size());
 }
 
 
 void WtCtaEngine::handle_push_quote(WTSTickData* newTick)
 {
+	StdSharedLock gate(_mtx_dispatch);
+	if (_capture)
+		_capture->record_tick(newTick);
+
 	if (_tm_ticker)
 		_tm_ticker->on_tick(newTick);
 }
 
 void WtCtaEngine::handle_pos_change(const char* straName, const char* stdCode, double diffPos)
 {
+	//被隔离的策略会在工作线程里调用
+	StdLocker<StdRecurMutex> lock(_mtx_pos);
+
 	//这里是持仓增量,所以不用处理未过滤的情况,因为增量情况下,不会改变目标diffQty
 	if(_filter_mgr.is_filtered_by_strategy(straName, diffPos, true))
 	{
@@ -486,6 +534,7 @@ void WtCtaEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 	 */
 	{
 		//是否主力合约代码的标记, 主要用于给执行器发数据的
+		StdLocker<StdRecurMutex> lock(_mtx_pos);
 		_exec_mgr.handle_tick(stdCode, curTick);
 	}
 
@@ -527,12 +576,18 @@ void WtCtaEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 					 */
 					if(_pool)
 					{
-						_pool->schedule([ctx, stdCode, curTick]() {
-							ctx->on_tick(stdCode, curTick);
+						_pool->schedule([this, ctx, stdCode, curTick]() {
+							dispatch_data(ctx->id(), PCB_Tick, stdCode, curTick, [ctx](const char* code, WTSTickData* tick) {
+								ctx->on_tick(code, tick);
+							});
 						});
 					}
 					else
-						ctx->on_tick(stdCode, curTick);
+					{
+						dispatch_data(ctx->id(), PCB_Tick, stdCode, curTick, [ctx](const char* code, WTSTickData* tick) {
+							ctx->on_tick(code, tick);
+						});
+					}
 				}
 				else
 				{
@@ -542,18 +597,24 @@ void WtCtaEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 					{
 						if (_pool)
 						{
-							_pool->schedule([ctx, wCode, curTick]() {
-								ctx->on_tick(wCode.c_str(), curTick);
+							_pool->schedule([this, ctx, wCode, curTick]() {
+								dispatch_data(ctx->id(), PCB_Tick, wCode.c_str(), curTick, [ctx](const char* code, WTSTickData* tick) {
+									ctx->on_tick(code, tick);
+								});
 							});
 						}
 						else
-							ctx->on_tick(wCode.c_str(), curTick);
+						{
+							dispatch_data(ctx->id(), PCB_Tick, wCode.c_str(), curTick, [ctx](const char* code, WTSTickData* tick) {
+								ctx->on_tick(code, tick);
+							});
+						}
 					}
 					else //(opt == 2)
 					{
 						if (adjTick == nullptr)
 						{
-							WTSTickData* adjTick = WTSTickData::create(curTick->getTickStruct());
+							adjTick = WTSTickData::create(curTick->getTickStruct());
 							WTSTickStruct& adjTS = adjTick->getTickStruct();
 							adjTick->setContractInfo(curTick->getContractInfo());
 
@@ -592,31 +653,42 @@ void WtCtaEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 								adjTS.pre_interest /= factor;
 							}
 
-							_price_map[wCode] = adjTS.price;
+							{
+								SpinLock lock(_mtx_price);
+								_price_map[wCode] = adjTS.price;
+							}
 						}
 
 						if (_pool)
 						{
-							_pool->schedule([ctx, wCode, adjTick]() {
-								ctx->on_tick(wCode.c_str(), adjTick);
+							_pool->schedule([this, ctx, wCode, adjTick]() {
+								dispatch_data(ctx->id(), PCB_Tick, wCode.c_str(), adjTick, [ctx](const char* code, WTSTickData* tick) {
+									ctx->on_tick(code, tick);
+								});
 							});
 						}
 						else
-							ctx->on_tick(wCode.c_str(), adjTick);
+						{
+							dispatch_data(ctx->id(), PCB_Tick, wCode.c_str(), adjTick, [ctx](const char* code, WTSTickData* tick) {
+								ctx->on_tick(code, tick);
+							});
+						}
 
 					}
 				}
 			}				
 		}
 
-		if(nullptr != adjTick)
-			adjTick->release();
 		/*
 		 *	By Wesley @ 223.06.27
 		 *	这里一定要等待线程池全部调度完成
 		 */
 		if (_pool)
 			_pool->wait();
+
+		//线程池里的任务都执行完了才能释放复权tick
+		if(nullptr != adjTick)
+			adjTick->release();
 	}
 	
 }
@@ -636,12 +708,18 @@ void WtCtaEngine::on_bar(const char* stdCode, const char* period, uint32_t times
 			CtaContextPtr& ctx = (CtaContextPtr&)cit->second;
 			if (_pool)
 			{
-				_pool->schedule([ctx, stdCode, period, times, newBar]() {
-					ctx->on_bar(stdCode, period, times, newBar);
+				_pool->schedule([this, ctx, stdCode, period, times, newBar]() {
+					dispatch_bar(ctx->id(), stdCode, period, times, newBar, [ctx](const char* code, const char* prd, uint32_t t, WTSBarStruct* bar) {
+						ctx->on_bar(code, prd, t, bar);
+					});
 				});
 			}
 			else
-				ctx->on_bar(stdCode, period, times, newBar);
+			{
+				dispatch_bar(ctx->id(), stdCode, period, times, newBar, [ctx](const char* code, const char* prd, uint32_t t, WTSBarStruct* bar) {
+					ctx->on_bar(code, prd, t, bar);
+				});
+			}
 		}
 	}
 
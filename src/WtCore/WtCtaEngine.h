@@ -38,7 +38,11 @@ public:
 	virtual void on_session_begin() override;
 	virtual void on_session_end() override;
 
-	virtual void run() override;
+	virtual void run(bool bReplay = false) override;
+
+	virtual void replay_timer(uint32_t uKind, uint32_t uDate, uint32_t uTime) override;
+
+	virtual void on_takeover(ShmStandby* standby) override;
 
 	virtual void init(WTSVariant* cfg, IBaseDataMgr* bdMgr, WtDtMgr* dataMgr, IHotMgr* hotMgr, EventNotifier* notifier) override;
 
@@ -79,6 +83,16 @@ public:
 	void notify_chart_index(uint64_t time, const char* straId, const char* idxName, const char* lineName, double val);
 	void notify_trade(const char* straId, const char* stdCode, bool isLong, bool isOpen, uint64_t curTime, double price, const char* userTag);
 
+private:
+	/*
+	 *	汇总策略的理论持仓，同时写入执行器的目标缓存
+	 */
+	void	collect_targets(CtaContextPtr& ctx, wt_hashmap<std::string, double>& target_pos);
+	/*
+	 *	更新组合持仓，并把目标仓位提交给执行器
+	 */
+	void	commit_targets(wt_hashmap<std::string, double>& target_pos);
+
 private:
 	typedef wt_hashmap<uint32_t, CtaContextPtr> ContextMap;
 	ContextMap		_ctx_map;
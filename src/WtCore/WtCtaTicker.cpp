@@ -9,7 +9,8 @@
  */
 #include "WtCtaTicker.h"
 #include "WtCtaEngine.h"
-#include "../Includes/IDataReader.h"
+#include "WtDtMgr.h"
+#include "EventCapture.h"
 
 #include "../Share/CodeHelper.hpp"
 #include "../Share/TimeUtils.hpp"
@@ -18,6 +19,7 @@
 #include "../Includes/IBaseDataMgr.h"
 #include "../Includes/IHotMgr.h"
 #include "../Includes/WTSContractInfo.hpp"
+#include "../Includes/WTSVariant.hpp"
 
 #include "../WTSTools/WTSLogger.h"
 
@@ -25,7 +27,7 @@ USING_NS_WTP;
 
 //////////////////////////////////////////////////////////////////////////
 //WtTimeTicker
-void WtCtaRtTicker::init(IDataReader* store, const char* sessionID)
+void WtCtaRtTicker::init(WtDtMgr* store, const char* sessionID, WTSVariant* cfg /* = NULL */)
 {
 	_store = store;
 	_s_info = _engine->get_session_info(sessionID);
@@ -35,6 +37,80 @@ void WtCtaRtTicker::init(IDataReader* store, const char* sessionID)
 		WTSLogger::info("CtaTicker will drive engine with session {}", sessionID);
 
 	TimeUtils::getDateTime(_date, _time);
+
+	if (cfg != NULL)
+	{
+		_grace = cfg->getUInt32("grace");
+		_sec_grace = cfg->has("section_grace") ? cfg->getUInt32("section_grace") : _grace;
+		if (cfg->has("stats_span"))
+			_stats_span = cfg->getUInt32("stats_span");
+	}
+	WTSLogger::info("CtaTicker will close bars {}ms after boundaries, {}ms after section closes", _grace, _sec_grace);
+}
+
+int64_t WtCtaRtTicker::update_clock_offset(uint32_t uDate, uint32_t uTime)
+{
+	if (uDate != _base_date)
+	{
+		_base_date = uDate;
+		_base_time = TimeUtils::makeTime(uDate, 0);
+	}
+
+	int64_t exchTime = _base_time + (uTime / 10000000 * 3600 + uTime % 10000000 / 100000 * 60) * 1000 + uTime % 100000;
+	double sample = (double)(exchTime - TimeUtils::getLocalTimeNow());
+
+	//延迟越小的样本越接近真实的时钟偏差
+	//所以偏差变大的时候快速跟上，变小的时候(多半是tick有延迟)缓慢修正
+	if (!_offset_ready)
+	{
+		_offset_est = sample;
+		_offset_ready = true;
+	}
+	else if (sample > _offset_est)
+		_offset_est += (sample - _offset_est) / 2;
+	else
+		_offset_est += (sample - _offset_est) / 64;
+
+	_clock_offset = (int64_t)_offset_est;
+	return exchTime;
+}
+
+void WtCtaRtTicker::arm_boundary(int64_t boundary)
+{
+	if (_next_boundary == boundary)
+		return;
+
+	{
+		StdUniqueLock lock(_mtx_timer);
+		_next_boundary = boundary;
+	}
+	_cond_timer.notify_all();
+}
+
+void WtCtaRtTicker::record_close(bool byTimer)
+{
+	int64_t boundary = _next_boundary;
+	if (boundary == 0)
+		return;
+
+	//闭合时刻的交易所时间和K线边界的差
+	int64_t nowUs = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+	int64_t latency = nowUs + _clock_offset * 1000 - boundary * 1000;
+
+	CloseStats& stats = _close_stats;
+	stats._count++;
+	if (byTimer)
+		stats._by_timer++;
+	stats._total_us += latency;
+	stats._max_us = std::max(stats._max_us, latency);
+	stats._min_us = std::min(stats._min_us, latency);
+
+	if (_stats_span != 0 && stats._count >= _stats_span)
+	{
+		WTSLogger::info("Latency of last {} bar closes: avg {}us, min {}us, max {}us, {} by timer, {} by data, exchange clock offset {}ms",
+			stats._count, stats._total_us / stats._count, stats._min_us, stats._max_us, stats._by_timer, stats._count - stats._by_timer, _clock_offset.load());
+		stats.reset();
+	}
 }
 
 void WtCtaRtTicker::trigger_price(WTSTickData* curTick)
@@ -58,7 +134,7 @@ void WtCtaRtTicker::trigger_price(WTSTickData* curTick)
 
 void WtCtaRtTicker::on_tick(WTSTickData* curTick)
 {
-	if (_thrd == NULL)
+	if (_thrd == NULL && !_replay)
 	{
 		trigger_price(curTick);
 		return;
@@ -67,6 +143,8 @@ void WtCtaRtTicker::on_tick(WTSTickData* curTick)
 	uint32_t uDate = curTick->actiondate();
 	uint32_t uTime = curTick->actiontime();
 
+	update_clock_offset(uDate, uTime);
+
 	if (_date != 0 && (uDate < _date || (uDate == _date && uTime < _time)))
 	{
 		//WTSLogger::info("行情时间{}小于本地时间{}", uTime, _time);
@@ -129,8 +207,9 @@ void WtCtaRtTicker::on_tick(WTSTickData* curTick)
 				bEndingTDate = true;
 
 			WTSLogger::info("Minute Bar {}.{:04d} Closed by data", _date, thisMin);
+			record_close(false);
 			if (_store)
-				_store->onMinuteEnd(_date, thisMin, bEndingTDate ? _engine->getTradingDate() : 0);
+				_store->on_minute_end(_date, thisMin, bEndingTDate ? _engine->getTradingDate() : 0);
 
 			//任务调度
 			_engine->on_schedule(_date, thisMin);
@@ -159,17 +238,24 @@ void WtCtaRtTicker::on_tick(WTSTickData* curTick)
 			_engine->set_date_time(_date, wrapMin, curSec, prevMin);
 	}
 
-	uint32_t sec = curSec / 1000;
-	uint32_t msec = curSec % 1000;
-	uint32_t left_ticks = (60 - sec) * 1000 - msec;
-	_next_check_time = TimeUtils::getLocalTimeNow() + left_ticks;
+	//当前K线的闭合边界，按交易所时间计算
+	//小节最后一分钟的tick(如11:30:00.500)归属的K线，边界就是当前分钟，其他情况是下一分钟
+	uint32_t boundaryMins = (curMin / 100) * 60 + curMin % 100 + (isSecEnd ? 0 : 1);
+	arm_boundary(_base_time + (int64_t)boundaryMins * 60000);
 }
 
-void WtCtaRtTicker::run()
+void WtCtaRtTicker::run(bool bReplay /* = false */)
 {
-	if (_thrd)
+	if (_thrd || _replay)
 		return;
 
+	if (bReplay)
+	{
+		_replay = true;
+		_date = _engine->get_date();
+		_time = _engine->get_raw_time() * 100000 + _engine->get_secs();
+	}
+
 	/*
 	 *	By Wesley @ 2022.12.06
 	 *	这里一定要在初始化之前把交易日确定下来
@@ -181,6 +267,9 @@ void WtCtaRtTicker::run()
 	_engine->on_init();
 	_engine->on_session_begin();
 
+	if (_replay)
+		return;
+
 	//先检查当前时间, 如果大于
 
 	_thrd.reset(new StdThread([this](){
@@ -190,50 +279,29 @@ void WtCtaRtTicker::run()
 
 			if (_time != UINT_MAX && _s_info->isInTradingTime(_time / 100000, true))
 			{
-				std::this_thread::sleep_for(std::chrono::milliseconds(10));
-				uint64_t now = TimeUtils::getLocalTimeNow();
-
-				if (now >= _next_check_time && _last_emit_pos < _cur_pos)
 				{
-					//触发数据回放模块
-					StdUniqueLock lock(_mtx);
-
-					//优先修改时间标记
-					_last_emit_pos = _cur_pos;
-
-					uint32_t thisMin = _s_info->minuteToTime(_cur_pos);
-					_time = thisMin*100000;//这里要还原成毫秒为单位
-
-					//如果thisMin是0, 说明换日了
-					//这里是本地计时导致的换日, 说明日期其实还是老日期, 要自动+1
-					//同时因为时间是235959xxx, 所以也要手动置为0
-					if (thisMin == 0)
+					StdUniqueLock lock(_mtx_timer);
+					int64_t boundary = _next_boundary;
+					if (boundary == 0 || _last_emit_pos >= _cur_pos)
 					{
-						uint32_t lastDate = _date;
-						_date = TimeUtils::getNextDate(_date);
-						_time = 0;
-						WTSLogger::info("Data automatically changed at time 00:00: {} -> {}", lastDate, _date);
+						//没有待闭合的K线，等新的分钟开始
+						_cond_timer.wait_for(lock, std::chrono::milliseconds(100));
+						continue;
 					}
 
-					bool bEndingTDate = false;
-					uint32_t offMin = _s_info->offsetTime(thisMin, true);
-					if (offMin == _s_info->getCloseTime(true))
-						bEndingTDate = true;
-
-					WTSLogger::info("Minute bar {}.{:04d} closed automatically", _date, thisMin);
-					if (_store)
-						_store->onMinuteEnd(_date, thisMin, bEndingTDate ? _engine->getTradingDate() : 0);
-
-					//任务调度
-					_engine->on_schedule(_date, thisMin);
-
-					if (bEndingTDate)
-						_engine->on_session_end();
-
-					//145959000
-					if (_engine)
-						_engine->set_date_time(_date, thisMin, 0);
+					//按照交易所时钟偏差换算成本地时间，再加上等待迟到tick的时间
+					uint32_t grace = _s_info->isLastOfSection(_s_info->minuteToTime(_cur_pos)) ? _sec_grace : _grace;
+					int64_t target = boundary + grace - _clock_offset;
+					int64_t now = TimeUtils::getLocalTimeNow();
+					if (now < target)
+					{
+						//分段等待，每次醒来都按最新的时钟偏差重新计算
+						_cond_timer.wait_for(lock, std::chrono::milliseconds(std::min<int64_t>(target - now, 1000)));
+						continue;
+					}
 				}
+
+				fire_minute_end();
 			}
 			else //if(offTime >= _s_info->getOpenTime(true) && offTime <= _s_info->getCloseTime(true))
 			{
@@ -242,26 +310,7 @@ void WtCtaRtTicker::run()
 				if(_time != UINT_MAX && _last_emit_pos != 0 && _last_emit_pos < total_mins && offTime >= _s_info->getCloseTime(true))
 				{
 					WTSLogger::warn("Tradingday {} will be ended forcely, last_emit_pos: {}, time: {}", _engine->getTradingDate(), _last_emit_pos.fetch_add(0), _time);
-
-					//触发数据回放模块
-					StdUniqueLock lock(_mtx);
-
-					//优先修改时间标记
-					_last_emit_pos = total_mins;
-
-					bool bEndingTDate = true;
-					uint32_t thisMin = _s_info->getCloseTime(false);
-					uint32_t offMin = _s_info->getCloseTime(true);
-
-					WTSLogger::info("Minute bar {}.{:04d} closed automatically", _date, thisMin);
-					if (_store)
-						_store->onMinuteEnd(_date, thisMin, _engine->getTradingDate());
-
-					//任务调度
-					_engine->on_schedule(_date, thisMin);
-
-					_engine->on_session_end();
-
+					fire_session_end();
 				}
 				else
 				{
@@ -272,9 +321,92 @@ void WtCtaRtTicker::run()
 	}));
 }
 
+void WtCtaRtTicker::fire_minute_end()
+{
+	//先进闸门再拿_mtx，和解析器线程的加锁顺序保持一致
+	StdSharedLock gate(_engine->dispatch_gate());
+	//触发数据回放模块
+	StdUniqueLock lock(_mtx);
+
+	//行情线程可能已经闭合了这根K线
+	if (_last_emit_pos >= _cur_pos)
+		return;
+
+	//优先修改时间标记
+	_last_emit_pos = _cur_pos;
+
+	uint32_t thisMin = _s_info->minuteToTime(_cur_pos);
+	_time = thisMin*100000;//这里要还原成毫秒为单位
+
+	//如果thisMin是0, 说明换日了
+	//这里是本地计时导致的换日, 说明日期其实还是老日期, 要自动+1
+	//同时因为时间是235959xxx, 所以也要手动置为0
+	if (thisMin == 0)
+	{
+		uint32_t lastDate = _date;
+		_date = TimeUtils::getNextDate(_date);
+		_time = 0;
+		WTSLogger::info("Data automatically changed at time 00:00: {} -> {}", lastDate, _date);
+	}
+
+	//本地计时的触发时机取决于墙上时钟，回放的时候没法重新推算，所以要录制下来
+	EventCapture* capture = _engine->get_capture();
+	if (capture)
+		capture->record_timer(CTK_MinuteEnd, _date, thisMin);
+
+	bool bEndingTDate = false;
+	uint32_t offMin = _s_info->offsetTime(thisMin, true);
+	if (offMin == _s_info->getCloseTime(true))
+		bEndingTDate = true;
+
+	WTSLogger::info("Minute bar {}.{:04d} closed automatically", _date, thisMin);
+	//回放的时候墙上时钟没有意义，不统计闭合延迟
+	if (!_replay)
+		record_close(true);
+	if (_store)
+		_store->on_minute_end(_date, thisMin, bEndingTDate ? _engine->getTradingDate() : 0);
+
+	//任务调度
+	_engine->on_schedule(_date, thisMin);
+
+	if (bEndingTDate)
+		_engine->on_session_end();
+
+	//145959000
+	if (_engine)
+		_engine->set_date_time(_date, thisMin, 0);
+}
+
+void WtCtaRtTicker::fire_session_end()
+{
+	//先进闸门再拿_mtx，和解析器线程的加锁顺序保持一致
+	StdSharedLock gate(_engine->dispatch_gate());
+	//触发数据回放模块
+	StdUniqueLock lock(_mtx);
+
+	//优先修改时间标记
+	_last_emit_pos = _s_info->getTradingMins();
+
+	uint32_t thisMin = _s_info->getCloseTime(false);
+
+	EventCapture* capture = _engine->get_capture();
+	if (capture)
+		capture->record_timer(CTK_SessionEnd, _date, thisMin);
+
+	WTSLogger::info("Minute bar {}.{:04d} closed automatically", _date, thisMin);
+	if (_store)
+		_store->on_minute_end(_date, thisMin, _engine->getTradingDate());
+
+	//任务调度
+	_engine->on_schedule(_date, thisMin);
+
+	_engine->on_session_end();
+}
+
 void WtCtaRtTicker::stop()
 {
 	_stopped = true;
+	_cond_timer.notify_all();
 	if (_thrd)
 		_thrd->join();
 }
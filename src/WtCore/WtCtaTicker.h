@@ -16,8 +16,9 @@
 
 NS_WTP_BEGIN
 class WTSSessionInfo;
-class IDataReader;
+class WtDtMgr;
 class WTSTickData;
+class WTSVariant;
 
 class WtCtaEngine;
 //////////////////////////////////////////////////////////////////////////
@@ -26,33 +27,81 @@ class WtCtaRtTicker
 {
 public:
 	WtCtaRtTicker(WtCtaEngine* engine) 
-		: _engine(engine)
-		, _stopped(false)
+		: _s_info(NULL)
+		, _engine(engine)
+		, _store(NULL)
 		, _date(0)
 		, _time(UINT_MAX)
-		, _next_check_time(0)
+		, _cur_pos(0)
+		, _next_boundary(0)
 		, _last_emit_pos(0)
-		, _cur_pos(0){}
+		, _clock_offset(0)
+		, _offset_est(0)
+		, _offset_ready(false)
+		, _base_date(0)
+		, _base_time(0)
+		, _grace(0)
+		, _sec_grace(0)
+		, _stats_span(60)
+		, _stopped(false)
+		, _replay(false){}
 	~WtCtaRtTicker(){}
 
 public:
-	void	init(IDataReader* store, const char* sessionID);
+	/*
+	 *	初始化
+	 *	@cfg	定时闭合的配置，可以为空
+	 *			grace		分钟边界之后等待迟到tick的毫秒数，默认为0
+	 *			section_grace	小节收盘边界的等待毫秒数，默认和grace一致
+	 *			stats_span	每闭合多少根K线输出一次闭合延迟统计，默认60
+	 */
+	void	init(WtDtMgr* store, const char* sessionID, WTSVariant* cfg = NULL);
 	//void	set_time(uint32_t uDate, uint32_t uTime);
 	void	on_tick(WTSTickData* curTick);
 
-	void	run();
+	/*
+	 *	@bReplay	回放模式，不启动定时线程，时间从引擎读取
+	 */
+	void	run(bool bReplay = false);
 	void	stop();
 
+	/*
+	 *	本地计时触发分钟闭合
+	 *	实盘由定时线程调用，回放时由录制的定时器事件调用
+	 */
+	void	fire_minute_end();
+
+	/*
+	 *	收盘以后强制结束交易日，调用方式同上
+	 */
+	void	fire_session_end();
+
 	bool		is_in_trading() const;
 	uint32_t	time_to_mins(uint32_t uTime) const;
 
 private:
 	void	trigger_price(WTSTickData* curTick);
 
+	/*
+	 *	用tick的交易所时间更新交易所时钟偏差的估计
+	 *	返回tick的交易所时间(毫秒)
+	 */
+	int64_t	update_clock_offset(uint32_t uDate, uint32_t uTime);
+
+	/*
+	 *	设置下一个分钟边界，边界变化时唤醒定时线程
+	 */
+	void	arm_boundary(int64_t boundary);
+
+	/*
+	 *	记录一次K线闭合的延迟，调用方要持有_mtx
+	 */
+	void	record_close(bool byTimer);
+
 private:
 	WTSSessionInfo*	_s_info;
 	WtCtaEngine*	_engine;
-	IDataReader*	_store;
+	WtDtMgr*	_store;
 
 	uint32_t	_date;
 	uint32_t	_time;
@@ -60,10 +109,47 @@ private:
 	uint32_t	_cur_pos;
 
 	StdUniqueMutex	_mtx;
-	std::atomic<uint64_t>	_next_check_time;
+	std::atomic<int64_t>	_next_boundary;	//当前K线的闭合边界，交易所时间，毫秒
 	std::atomic<uint32_t>	_last_emit_pos;
 
+	//交易所时钟偏差(交易所时间-本地时间)，毫秒
+	std::atomic<int64_t>	_clock_offset;
+	double			_offset_est;
+	bool			_offset_ready;
+
+	//tick日期对应的0点时间戳缓存，避免每个tick都调用mktime
+	uint32_t		_base_date;
+	int64_t			_base_time;
+
+	uint32_t		_grace;
+	uint32_t		_sec_grace;
+
+	StdUniqueMutex	_mtx_timer;
+	StdCondVariable	_cond_timer;
+
+	typedef struct _CloseStats
+	{
+		uint32_t	_count;
+		uint32_t	_by_timer;
+		int64_t		_total_us;
+		int64_t		_max_us;
+		int64_t		_min_us;
+
+		_CloseStats() { reset(); }
+		inline void reset()
+		{
+			_count = 0;
+			_by_timer = 0;
+			_total_us = 0;
+			_max_us = INT64_MIN;
+			_min_us = INT64_MAX;
+		}
+	} CloseStats;
+	CloseStats		_close_stats;
+	uint32_t		_stats_span;
+
 	bool			_stopped;
+	bool			_replay;
 	StdThreadPtr	_thrd;
 
 };
@@ -13,6 +13,7 @@
 
 #include "../Share/StrUtil.hpp"
 #include "../Share/CodeHelper.hpp"
+#include "../Share/StraProfiler.hpp"
 
 #include "../Includes/WTSDataDef.hpp"
 #include "../Includes/WTSVariant.hpp"
@@ -23,6 +24,19 @@
 
 WTSDataFactory g_dataFact;
 
+/*
+ *	被隔离的策略在工作线程里拿到的切片，把数据拷贝一份
+ *	切片直接引用缓存，释放数据锁以后缓存还会被行情线程和定时器线程改写
+ */
+template<typename T>
+inline T* snapshot(T* slice)
+{
+	if (slice != NULL && StraWorker::on_worker_thread())
+		slice->detach();
+
+	return slice;
+}
+
 WtDtMgr::WtDtMgr()
 	: _reader(NULL)
 	, _engine(NULL)
@@ -103,17 +117,27 @@ bool WtDtMgr::init(WTSVariant* cfg, WtEngine* engine, bool bForceCache /* = fals
 
 void WtDtMgr::on_all_bar_updated(uint32_t updateTime)
 {
-	if (_bar_notifies.empty())
-		return;
+	//这里还在数据锁内，on_bar由on_minute_end释放锁以后统一触发
+	if (!_bar_notifies.empty())
+		WTSLogger::debug("All bars updated, on_bar will be triggered");
+}
 
-	WTSLogger::debug("All bars updated, on_bar will be triggered");
+void WtDtMgr::on_minute_end(uint32_t uDate, uint32_t uTime, uint32_t endTDate /* = 0 */)
+{
+	if (_reader == NULL)
+		return;
 
-	for (const NotifyItem& item : _bar_notifies)
+	std::vector<NotifyItem> notifies;
 	{
-		_engine->on_bar(item._code, item._period, item._times, item._newBar);
+		StdLocker<StdRecurMutex> lock(_mtx_data);
+		_reader->onMinuteEnd(uDate, uTime, endTDate);
+		notifies.swap(_bar_notifies);
 	}
 
-	_bar_notifies.clear();
+	for (NotifyItem& item : notifies)
+	{
+		_engine->on_bar(item._code, item._period, item._times, &item._newBar);
+	}
 }
 
 IBaseDataMgr* WtDtMgr::get_basedata_mgr()
@@ -148,6 +172,7 @@ void WtDtMgr::reader_log(WTSLogLevel ll, const char* message)
 
 void WtDtMgr::on_bar(const char* code, WTSKlinePeriod period, WTSBarStruct* newBar)
 {
+	StdLocker<StdRecurMutex> lock(_mtx_data);
 	std::string key_pattern = fmt::format("{}-{}", code, period);
 
 	char speriod;
@@ -216,6 +241,7 @@ void WtDtMgr::handle_push_quote(const char* stdCode, WTSTickData* newTick)
 	if (newTick == NULL)
 		return;
 
+	StdLocker<StdRecurMutex> lock(_mtx_data);
 	if (_rt_tick_map == NULL)
 		_rt_tick_map = DataCacheMap::create();
 
@@ -236,6 +262,7 @@ void WtDtMgr::handle_push_quote(const char* stdCode, WTSTickData* newTick)
 
 WTSTickData* WtDtMgr::grab_last_tick(const char* code)
 {
+	StdLocker<StdRecurMutex> lock(_mtx_data);
 	if (_rt_tick_map == NULL)
 		return NULL;
 
@@ -249,6 +276,7 @@ WTSTickData* WtDtMgr::grab_last_tick(const char* code)
 
 double WtDtMgr::get_adjusting_factor(const char* stdCode, uint32_t uDate)
 {
+	StdLocker<StdRecurMutex> lock(_mtx_data);
 	if (_reader)
 		return _reader->getAdjFactorByDate(stdCode, uDate);
 
@@ -260,6 +288,7 @@ uint32_t WtDtMgr::get_adjusting_flag()
 	static uint32_t flag = UINT_MAX;
 	if(flag == UINT_MAX)
 	{
+		StdLocker<StdRecurMutex> lock(_mtx_data);
 		if (_reader)
 			flag = _reader->getAdjustingFlag();
 		else
@@ -282,9 +311,11 @@ WTSTickSlice* WtDtMgr::get_tick_slice(const char* stdCode, uint32_t count, uint6
 	auto len = strlen(stdCode);
 	bool isHFQ = (stdCode[len - 1] == SUFFIX_HFQ);
 
+	StdLocker<StdRecurMutex> lock(_mtx_data);
+
 	//不是后复权，缓存直接用底层缓存
 	if(!isHFQ)
-		return _reader->readTickSlice(stdCode, count, etime);
+		return snapshot(_reader->readTickSlice(stdCode, count, etime));
 
 	//先转成不带+的标准代码
 	std::string pureStdCode(stdCode, len - 1);
@@ -367,7 +398,7 @@ WTSTickSlice* WtDtMgr::get_tick_slice(const char* stdCode, uint32_t count, uint6
 	uint32_t cnt = min(eIdx + 1, count);
 	uint32_t sIdx = eIdx + 1 - cnt;
 	WTSTickSlice* slice = WTSTickSlice::create(stdCode, &ticks.front() + sIdx, cnt);
-	return slice;
+	return snapshot(slice);
 }
 
 WTSOrdQueSlice* WtDtMgr::get_order_queue_slice(const char* stdCode, uint32_t count, uint64_t etime /* = 0 */)
@@ -375,7 +406,8 @@ WTSOrdQueSlice* WtDtMgr::get_order_queue_slice(const char* stdCode, uint32_t cou
 	if (_reader == NULL)
 		return NULL;
 
-	return _reader->readOrdQueSlice(stdCode, count, etime);
+	StdLocker<StdRecurMutex> lock(_mtx_data);
+	return snapshot(_reader->readOrdQueSlice(stdCode, count, etime));
 }
 
 WTSOrdDtlSlice* WtDtMgr::get_order_detail_slice(const char* stdCode, uint32_t count, uint64_t etime /* = 0 */)
@@ -383,7 +415,8 @@ WTSOrdDtlSlice* WtDtMgr::get_order_detail_slice(const char* stdCode, uint32_t co
 	if (_reader == NULL)
 		return NULL;
 
-	return _reader->readOrdDtlSlice(stdCode, count, etime);
+	StdLocker<StdRecurMutex> lock(_mtx_data);
+	return snapshot(_reader->readOrdDtlSlice(stdCode, count, etime));
 }
 
 WTSTransSlice* WtDtMgr::get_transaction_slice(const char* stdCode, uint32_t count, uint64_t etime /* = 0 */)
@@ -391,7 +424,8 @@ WTSTransSlice* WtDtMgr::get_transaction_slice(const char* stdCode, uint32_t coun
 	if (_reader == NULL)
 		return NULL;
 
-	return _reader->readTransSlice(stdCode, count, etime);
+	StdLocker<StdRecurMutex> lock(_mtx_data);
+	return snapshot(_reader->readTransSlice(stdCode, count, etime));
 }
 
 WTSKlineSlice* WtDtMgr::get_kline_slice(const char* stdCode, WTSKlinePeriod period, uint32_t times, uint32_t count, uint64_t etime /* = 0 */)
@@ -402,12 +436,14 @@ WTSKlineSlice* WtDtMgr::get_kline_slice(const char* stdCode, WTSKlinePeriod peri
 	thread_local static char key[64] = { 0 };
 	fmtutil::format_to(key, "{}-{}", stdCode, (uint32_t)period);
 
+	StdLocker<StdRecurMutex> lock(_mtx_data);
+
 	// 如果不强制缓存，并且重采样倍数为1，则直接读取slice返回
 	if (times == 1 && !_force_cache)
 	{
 		_subed_basic_bars.insert(key);
 
-		return _reader->readKlineSlice(stdCode, period, count, etime);
+		return snapshot(_reader->readKlineSlice(stdCode, period, count, etime));
 	}
 
 	//只有非基础周期的会进到下面的步骤
@@ -476,5 +512,5 @@ WTSKlineSlice* WtDtMgr::get_kline_slice(const char* stdCode, WTSKlinePeriod peri
 	sIdx = closedSz - rtCnt;
 	WTSBarStruct* rtHead = kData->at(sIdx);
 	WTSKlineSlice* slice = WTSKlineSlice::create(stdCode, period, times, rtHead, rtCnt);
-	return slice;
+	return snapshot(slice);
 }
@@ -12,8 +12,11 @@
 #include "../Includes/IDataReader.h"
 #include "../Includes/IDataManager.h"
 
+#include "../Includes/WTSStruct.h"
+
 #include "../Includes/FasterDefs.h"
 #include "../Includes/WTSCollection.hpp"
+#include "../Share/StdUtils.hpp"
 
 NS_WTP_BEGIN
 class WTSVariant;
@@ -40,6 +43,12 @@ public:
 
 	void	handle_push_quote(const char* stdCode, WTSTickData* newTick);
 
+	/*
+	 *	分钟结束，由定时器调用
+	 *	K线在数据锁内闭合，释放锁以后再回调引擎的on_bar
+	 */
+	void	on_minute_end(uint32_t uDate, uint32_t uTime, uint32_t endTDate = 0);
+
 	//////////////////////////////////////////////////////////////////////////
 	//IDataManager 接口
 	virtual WTSTickSlice* get_tick_slice(const char* stdCode, uint32_t count, uint64_t etime = 0) override;
@@ -85,15 +94,18 @@ private:
 	//因为前复权和不复权，都不需要缓存
 	DataCacheMap*	_ticks_adjusted;	//复权tick缓存
 
+	//被隔离的策略在工作线程里读数据，行情线程和定时器线程同时在写缓存，所有缓存和读取器的访问都要加锁
+	StdRecurMutex	_mtx_data;
+
 	typedef struct _NotifyItem
 	{
 		char		_code[MAX_INSTRUMENT_LENGTH];
 		char		_period[2] = { 0 };
 		uint32_t	_times;
-		WTSBarStruct* _newBar;
+		WTSBarStruct _newBar;	//回调在释放锁以后进行，K线要拷贝下来
 
 		_NotifyItem(const char* code, char period, uint32_t times, WTSBarStruct* newBar)
-			: _times(times), _newBar(newBar)
+			: _times(times), _newBar(*newBar)
 		{
 			wt_strcpy(_code, code);
 			_period[0] = period;
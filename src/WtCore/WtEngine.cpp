@@ -10,6 +10,8 @@
 #include "WtEngine.h"
 #include "WtDtMgr.h"
 #include "WtHelper.h"
+#include "TraderAdapter.h"
+#include "EventNotifier.h"
 
 #include "../Share/TimeUtils.hpp"
 #include "../Share/StrUtil.hpp"
@@ -46,6 +48,8 @@ WtEngine::WtEngine()
 	, _notifier(NULL)
 	, _fund_udt_span(0)
 	, _ready(false)
+	, _standby(NULL)
+	, _capture(NULL)
 {
 	TimeUtils::getDateTime(_cur_date, _cur_time);
 	_cur_secs = _cur_time % 100000;
@@ -116,10 +120,18 @@ WTSSessionInfo* WtEngine::get_session_info(const char* sid, bool isCode /* = fal
 
 void WtEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 {
-	_price_map[stdCode] = curTick->price();
+	{
+		SpinLock lock(_mtx_price);
+		_price_map[stdCode] = curTick->price();
+	}
+
+	//交易通道本地维护资金，需要用最新价更新浮动盈亏
+	if (_adapter_mgr)
+		_adapter_mgr->update_price(stdCode, curTick->price());
 
 	//先检查是否要信号要触发
 	{
+		StdLocker<StdRecurMutex> lock(_mtx_pos);
 		bool bTriggered = false;
 		auto it = _sig_map.find(stdCode);
 		if (it != _sig_map.end())
@@ -149,12 +161,13 @@ void WtEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 	std::string code = stdCode;
 	double price = curTick->price();
 	push_task([this, code, price]{
+		StdLocker<StdRecurMutex> lock(_mtx_pos);
 		auto it = _pos_map.find(code);
 		if (it == _pos_map.end())
 			return;
 
 		PosInfoPtr& pInfo = it->second;
-		SpinLock lock(pInfo->_mtx);
+		SpinLock posLock(pInfo->_mtx);
 		if (pInfo->_volume == 0)
 		{
 			pInfo->_dynprofit = 0;
@@ -196,10 +209,13 @@ void WtEngine::update_fund_dynprofit()
 	}
 
 	double profit = 0.0;
-	for(const auto& v : _pos_map)
 	{
-		const PosInfoPtr& pItem = v.second;
-		profit += pItem->_dynprofit;
+		StdLocker<StdRecurMutex> lock(_mtx_pos);
+		for (const auto& v : _pos_map)
+		{
+			const PosInfoPtr& pItem = v.second;
+			profit += pItem->_dynprofit;
+		}
 	}
 
 	fundInfo._dynprofit = profit;
@@ -309,6 +325,38 @@ void WtEngine::init(WTSVariant* cfg, IBaseDataMgr* bdMgr, WtDtMgr* dataMgr, IHot
 		_fund_udt_span = 5;
 		WTSLogger::log_raw(LL_WARN, "RiskMon is not configured, portfilio fund will be updated every 5s");
 	}
+
+	if (_profiler.init(cfg->get("profiler")))
+	{
+		WTSLogger::info("Strategy profiler enabled, slow threshold {}us, policy {}", _profiler.threshold_us(),
+			_profiler.policy() == SP_Warn ? "warn" : (_profiler.policy() == SP_Isolate ? "isolate" : "conflate"));
+	}
+}
+
+void WtEngine::report_profiles()
+{
+	thread_local static StraProfiler::ProfileReports reports;
+	reports.clear();
+	if (!_profiler.collect(reports))
+		return;
+
+	for (const StraProfiler::ProfileReport& r : reports)
+	{
+		if (r._action == StraProfiler::PA_None)
+		{
+			WTSLogger::debug("[{}] {} callbacks: {} calls, avg {:.1f}us, p50 {:.1f}us, p99 {:.1f}us, max {:.1f}us, cpu {:.1f}us",
+				r._stra, profile_callback_name(r._cb_type), r._count, r._avg_us, r._p50_us, r._p99_us, r._max_us, r._cpu_us);
+		}
+		else
+		{
+			WTSLogger::warn("[{}] {} callbacks too slow for {} windows: {} calls, avg {:.1f}us, p99 {:.1f}us, max {:.1f}us{}",
+				r._stra, profile_callback_name(r._cb_type), r._slow_windows, r._count, r._avg_us, r._p99_us, r._max_us,
+				r._action == StraProfiler::PA_Isolated ? ", moved to a dedicated worker" : "");
+		}
+
+		if (_notifier)
+			_notifier->notify_log("PROFILE", StraProfiler::to_json(r).c_str());
+	}
 }
 
 void WtEngine::on_session_end()
@@ -362,6 +410,12 @@ void WtEngine::on_session_begin()
 
 void WtEngine::save_datas()
 {
+	//备进程不写组合数据文件，以免覆盖主进程的数据
+	if (is_standby_follower())
+		return;
+
+	StdLocker<StdRecurMutex> lock(_mtx_pos);
+
 	rj::Document root(rj::kObjectType);
 	rj::Document::AllocatorType &allocator = root.GetAllocator();
 
@@ -454,18 +508,43 @@ void WtEngine::save_datas()
 		std::string filename = WtHelper::getPortifolioDir();
 		filename += "datas.json";
 
+		rj::StringBuffer sb;
+		rj::PrettyWriter<rj::StringBuffer> writer(sb);
+		root.Accept(writer);
+
 		BoostFile bf;
 		if (bf.create_new_file(filename.c_str()))
 		{
-			rj::StringBuffer sb;
-			rj::PrettyWriter<rj::StringBuffer> writer(sb);
-			root.Accept(writer);
 			bf.write_file(sb.GetString());
 			bf.close_file();
 		}
+
+		journal_state(SRT_PortData, "portfolio", sb.GetString(), sb.GetSize());
 	}
 }
 
+void WtEngine::journal_state(uint32_t rtype, const char* key, const char* data, std::size_t len)
+{
+	if (_standby && _standby->is_leader())
+		_standby->append(rtype, key, data, len);
+}
+
+void WtEngine::on_takeover(ShmStandby* standby)
+{
+	//接管时行情已经被挡住了，但是被隔离的策略还可能在工作线程里修改持仓
+	StdLocker<StdRecurMutex> lock(_mtx_pos);
+	standby->enum_latest([this](uint32_t rtype, const char* key, const char* data, std::size_t len) {
+		if (rtype != SRT_PortData)
+			return;
+
+		std::string content(data, len);
+		parse_datas(content.c_str());
+		WTSLogger::info("Portfolio data recovered from standby mirror, {} positions", _pos_map.size());
+	});
+
+	save_datas();
+}
+
 void WtEngine::load_datas()
 {
 	_port_fund = WTSPortFundInfo::create();
@@ -483,8 +562,13 @@ void WtEngine::load_datas()
 	if (content.empty())
 		return;
 
+	parse_datas(content.c_str());
+}
+
+void WtEngine::parse_datas(const char* content)
+{
 	rj::Document root;
-	root.Parse(content.c_str());
+	root.Parse(content);
 
 	if (root.HasParseError())
 		return;
@@ -544,6 +628,8 @@ void WtEngine::load_datas()
 				total_profit += pInfo->_closeprofit;
 				total_dynprofit += pInfo->_dynprofit;
 
+				//接管时会用镜像数据覆盖现有持仓，所以先清理明细
+				pInfo->_details.clear();
 				const rj::Value& details = pItem["details"];
 				if (details.IsNull() || !details.IsArray() || details.Size() == 0)
 					continue;
@@ -672,8 +758,13 @@ double WtEngine::get_cur_price(const char* stdCode)
 	bool bAdjusted = (lastChar == SUFFIX_QFQ || lastChar == SUFFIX_HFQ);
 	//前复权需要去掉－，后复权和未复权都直接查找
 	std::string sCode = (lastChar == SUFFIX_QFQ) ? std::string(stdCode, len - 1) : stdCode;
-	auto it = _price_map.find(sCode);
-	if(it == _price_map.end())
+	{
+		SpinLock lock(_mtx_price);
+		auto it = _price_map.find(sCode);
+		if (it != _price_map.end())
+			return it->second;
+	}
+
 	{
 		//找不到的时候，先读取未复权的tick数据
 		std::string fCode = bAdjusted ? std::string(stdCode, len - 1) : stdCode;
@@ -692,13 +783,10 @@ double WtEngine::get_cur_price(const char* stdCode)
 			ret *= get_exright_factor(stdCode, cInfo->getCommInfo());
 		}
 
+		SpinLock lock(_mtx_price);
 		_price_map[sCode] = ret;
 		return ret;
 	}
-	else
-	{
-		return it->second;
-	}
 }
 
 double WtEngine::get_day_price(const char* stdCode, int flag /* = 0 */)
@@ -912,6 +1000,7 @@ double WtEngine::calc_fee(const char* stdCode, double price, double qty, uint32_
 
 void WtEngine::append_signal(const char* stdCode, double qty, bool bStandBy /* = true */)
 {
+	StdLocker<StdRecurMutex> lock(_mtx_pos);
 	/*
 	 *	By Wesley @ 2021.12.16
 	 *	这里发现一个问题，就是组合的理论成交价和策略的理论成交价不一致
@@ -950,6 +1039,7 @@ void WtEngine::append_signal(const char* stdCode, double qty, bool bStandBy /* =
 
 void WtEngine::do_set_position(const char* stdCode, double qty, double curPx /* = -1 */)
 {
+	StdLocker<StdRecurMutex> lock(_mtx_pos);
 	PosInfoPtr& pInfo = _pos_map[stdCode];
 	if (pInfo == NULL)
 		pInfo.reset(new PosInfo);
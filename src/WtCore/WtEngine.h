@@ -18,12 +18,15 @@
 
 #include "../Includes/FasterDefs.h"
 #include "../Includes/RiskMonDefs.h"
+#include "../Includes/WTSStruct.h"
 
 #include "../Share/StdUtils.hpp"
 #include "../Share/DLLHelper.hpp"
 
 #include "../Share/BoostFile.hpp"
 #include "../Share/SpinMutex.hpp"
+#include "../Share/ShmStandby.hpp"
+#include "../Share/StraProfiler.hpp"
 
 
 NS_WTP_BEGIN
@@ -46,6 +49,7 @@ class WtDtMgr;
 class TraderAdapterMgr;
 
 class EventNotifier;
+class EventCapture;
 
 typedef std::function<void()>	TaskItem;
 
@@ -133,6 +137,44 @@ public:
 		_evt_listener = listener;
 	}
 
+	inline void set_standby(ShmStandby* standby) { _standby = standby; }
+
+	/*
+	 *	是否是备进程，备进程和主进程共用数据目录，不能落地状态文件
+	 */
+	inline bool is_standby_follower() const { return _standby != NULL && !_standby->is_leader(); }
+
+	/*
+	 *	写入主备状态日志，只有主进程会真正写入
+	 *	@rtype	记录类型，见StandbyRecordType
+	 *	@key	状态的key，一般是策略名称
+	 */
+	void journal_state(uint32_t rtype, const char* key, const char* data, std::size_t len);
+
+	/*
+	 *	数据分发闸门，行情和定时器分发时持有共享锁
+	 *	主备接管时持有独占锁，保证接管期间没有解析器线程和定时器线程在改写持仓和策略状态
+	 */
+	inline StdSharedMutex& dispatch_gate() { return _mtx_dispatch; }
+
+	/*
+	 *	备进程接管，用镜像的最新状态覆盖本地状态
+	 *	调用方需要先持有dispatch_gate的独占锁
+	 */
+	virtual void on_takeover(ShmStandby* standby);
+
+	/*
+	 *	设置事件录制器，所有输入事件都会按到达顺序录制下来
+	 */
+	inline void set_capture(EventCapture* capture) { _capture = capture; }
+	inline EventCapture* get_capture() { return _capture; }
+
+	/*
+	 *	回放录制的定时器事件
+	 *	@uKind	事件类型，见CaptureTimerKind
+	 */
+	virtual void replay_timer(uint32_t uKind, uint32_t uDate, uint32_t uTime) {}
+
 	//////////////////////////////////////////////////////////////////////////
 	//WtPortContext接口
 	virtual WTSPortFundInfo* getFundInfo() override;
@@ -155,7 +197,11 @@ public:
 public:
 	virtual void init(WTSVariant* cfg, IBaseDataMgr* bdMgr, WtDtMgr* dataMgr, IHotMgr* hotMgr, EventNotifier* notifier);
 
-	virtual void run() = 0;
+	/*
+	 *	启动引擎
+	 *	@bReplay	回放模式，不启动实时定时线程，分钟闭合由录制的定时器事件驱动
+	 */
+	virtual void run(bool bReplay = false) = 0;
 
 	virtual void on_tick(const char* stdCode, WTSTickData* curTick);
 
@@ -173,6 +219,8 @@ protected:
 
 	void		save_datas();
 
+	void		parse_datas(const char* content);
+
 	void		append_signal(const char* stdCode, double qty, bool bStandBy);
 
 	void		do_set_position(const char* stdCode, double qty, double curPx = -1);
@@ -185,6 +233,103 @@ protected:
 
 	bool		init_riskmon(WTSVariant* cfg);
 
+	/*
+	 *	汇总策略回调耗时，到了统计窗口才会真正输出
+	 *	只在分钟闭合的时候调用，不放在tick的路径上，统计窗口小于1分钟时按分钟输出
+	 */
+	void		report_profiles();
+
+	/*
+	 *	带耗时统计的数据回调分发
+	 *	被隔离的策略投递到独立线程，数据对象会被引用住，tick可以按代码合并
+	 *	@fn	实际的回调，原型为fn(const char* stdCode, DataT* data)
+	 */
+	template<typename DataT, typename Fn>
+	void		dispatch_data(uint32_t sid, uint32_t cbType, const char* stdCode, DataT* data, Fn fn)
+	{
+		StraProfile* prof = _profiler.find(sid);
+		if (prof == NULL)
+		{
+			fn(stdCode, data);
+			return;
+		}
+
+		if (prof->is_isolated())
+		{
+			data->retain();
+			std::shared_ptr<DataT> holder(data, [](DataT* d) { d->release(); });
+			std::string code = stdCode;
+			StraProfiler* profiler = &_profiler;
+			prof->worker()->post(cbType == PCB_Tick ? stdCode : "", [profiler, prof, cbType, code, holder, fn]() {
+				StraProfileScope scope(*profiler, prof, cbType);
+				fn(code.c_str(), holder.get());
+			});
+			return;
+		}
+
+		StraProfileScope scope(_profiler, prof, cbType);
+		fn(stdCode, data);
+	}
+
+	/*
+	 *	带耗时统计的K线回调分发
+	 *	@fn	实际的回调，原型为fn(const char* stdCode, const char* period, uint32_t times, WTSBarStruct* newBar)
+	 */
+	template<typename Fn>
+	void		dispatch_bar(uint32_t sid, const char* stdCode, const char* period, uint32_t times, WTSBarStruct* newBar, Fn fn)
+	{
+		StraProfile* prof = _profiler.find(sid);
+		if (prof == NULL)
+		{
+			fn(stdCode, period, times, newBar);
+			return;
+		}
+
+		if (prof->is_isolated())
+		{
+			std::string code = stdCode;
+			std::string prd = period;
+			WTSBarStruct bar = *newBar;
+			StraProfiler* profiler = &_profiler;
+			prof->worker()->post(NULL, [profiler, prof, code, prd, times, bar, fn]() mutable {
+				StraProfileScope scope(*profiler, prof, PCB_Bar);
+				fn(code.c_str(), prd.c_str(), times, &bar);
+			});
+			return;
+		}
+
+		StraProfileScope scope(_profiler, prof, PCB_Bar);
+		fn(stdCode, period, times, newBar);
+	}
+
+	/*
+	 *	带耗时统计的同步回调，如重算、交易日开始结束
+	 *	被隔离的策略要等工作线程执行完，保证调用方后续的处理能看到回调的结果
+	 */
+	template<typename Fn>
+	void		dispatch_sync(uint32_t sid, uint32_t cbType, Fn fn)
+	{
+		StraProfile* prof = _profiler.find(sid);
+		if (prof == NULL)
+		{
+			fn();
+			return;
+		}
+
+		if (prof->is_isolated())
+		{
+			StraProfiler* profiler = &_profiler;
+			prof->worker()->post_and_wait([profiler, prof, cbType, fn]() {
+				StraProfileScope scope(*profiler, prof, cbType);
+				fn();
+			});
+			return;
+		}
+
+		StraProfileScope scope(_profiler, prof, cbType);
+		fn();
+	}
+
 private:
 	void		init_outputs();
 	inline void	log_trade(const char* stdCode, bool isLong, bool isOpen, uint64_t curTime, double price, double qty, double fee = 0.0);
@@ -295,11 +440,15 @@ protected:
 	typedef std::shared_ptr<PosInfo> PosInfoPtr;
 	typedef wt_hashmap<std::string, PosInfoPtr> PositionMap;
 	PositionMap		_pos_map;
+	//被隔离的策略在独立线程里也会修改持仓、信号和执行器，这些修改都要持有该锁
+	//工作线程会调用这里的接口，所以持有该锁的时候不能等待工作线程
+	StdRecurMutex	_mtx_pos;
 
 	//////////////////////////////////////////////////////////////////////////
 	//
 	typedef wt_hashmap<std::string, double> PriceMap;
 	PriceMap		_price_map;
+	SpinMutex		_mtx_price;	//行情线程和策略工作线程都会读写，持有期间不能再拿别的锁
 
 	//后台任务线程, 把风控和资金, 持仓更新都放到这个线程里去
 	typedef std::queue<TaskItem>	TaskQueue;
@@ -331,5 +480,11 @@ protected:
 
 	//用于标记是否可以推送tickle
 	bool			_ready;
+
+	ShmStandby*		_standby;	//主备热切换组件
+	StdSharedMutex	_mtx_dispatch;	//数据分发闸门
+	EventCapture*	_capture;	//输入事件录制器
+
+	StraProfiler	_profiler;	//策略回调耗时统计
 };
 NS_WTP_END
\ No newline at end of file
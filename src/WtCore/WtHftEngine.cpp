@@ -10,6 +10,7 @@
 #define WIN32_LEAN_AND_MEAN
 
 #include "WtHftEngine.h"
+#include "EventCapture.h"
 #include "WtHftTicker.h"
 #include "WtDtMgr.h"
 #include "TraderAdapter.h"
@@ -55,9 +56,12 @@ void WtHftEngine::init(WTSVariant* cfg, IBaseDataMgr* bdMgr, WtDtMgr* dataMgr, I
 
 	_cfg = cfg;
 	_cfg->retain();
+
+	if (_greeks.init(cfg->get("greeks"), bdMgr))
+		WTSLogger::info("Option greeks service enabled, {} options in {} chains", _greeks.option_count(), _greeks.chain_count());
 }
 
-void WtHftEngine::run()
+void WtHftEngine::run(bool bReplay /* = false */)
 {
 	for (auto it = _ctx_map.begin(); it != _ctx_map.end(); it++)
 	{
@@ -67,7 +71,7 @@ void WtHftEngine::run()
 
 	_tm_ticker = new WtHftRtTicker(this);
 	WTSVariant* cfgProd = _cfg->get("product");
-	_tm_ticker->init(_data_mgr->reader(), cfgProd->getCString("session"));
+	_tm_ticker->init(_data_mgr, cfgProd->getCString("session"));
 
 	//启动之前,先把运行中的策略落地
 	{
@@ -103,17 +107,36 @@ void WtHftEngine::run()
 		StdFile::write_file_content(filename.c_str(), sb.GetString());
 	}
 
-	_tm_ticker->run();
+	_tm_ticker->run(bReplay);
+}
+
+void WtHftEngine::replay_timer(uint32_t uKind, uint32_t uDate, uint32_t uTime)
+{
+	if (_tm_ticker == NULL)
+		return;
+
+	if (uKind == CTK_SessionEnd)
+		_tm_ticker->fire_session_end();
+	else
+		_tm_ticker->fire_minute_end();
 }
 
 void WtHftEngine::handle_push_quote(WTSTickData* newTick)
 {
+	StdSharedLock gate(_mtx_dispatch);
+	if (_capture)
+		_capture->record_tick(newTick);
+
 	if (_tm_ticker)
 		_tm_ticker->on_tick(newTick);
 }
 
 void WtHftEngine::handle_push_order_detail(WTSOrdDtlData* curOrdDtl)
 {
+	StdSharedLock gate(_mtx_dispatch);
+	if (_capture)
+		_capture->record_order_detail(curOrdDtl);
+
 	const char* stdCode = curOrdDtl->code();
 	auto sit = _orddtl_sub_map.find(stdCode);
 	if (sit != _orddtl_sub_map.end())
@@ -129,7 +152,9 @@ void WtHftEngine::handle_push_order_detail(WTSOrdDtlData* curOrdDtl)
 			if (cit != _ctx_map.end())
 			{
 				HftContextPtr& ctx = (HftContextPtr&)cit->second;
-				ctx->on_order_detail(stdCode, curOrdDtl);
+				dispatch_data(sid, PCB_L2, stdCode, curOrdDtl, [ctx](const char* code, WTSOrdDtlData* data) {
+					ctx->on_order_detail(code, data);
+				});
 			}
 		}
 	}
@@ -137,6 +162,10 @@ void WtHftEngine::handle_push_order_detail(WTSOrdDtlData* curOrdDtl)
 
 void WtHftEngine::handle_push_order_queue(WTSOrdQueData* curOrdQue)
 {
+	StdSharedLock gate(_mtx_dispatch);
+	if (_capture)
+		_capture->record_order_queue(curOrdQue);
+
 	const char* stdCode = curOrdQue->code();
 	auto sit = _ordque_sub_map.find(stdCode);
 	if (sit != _ordque_sub_map.end())
@@ -152,7 +181,9 @@ void WtHftEngine::handle_push_order_queue(WTSOrdQueData* curOrdQue)
 			if (cit != _ctx_map.end())
 			{
 				HftContextPtr& ctx = (HftContextPtr&)cit->second;
-				ctx->on_order_queue(stdCode, curOrdQue);
+				dispatch_data(sid, PCB_L2, stdCode, curOrdQue, [ctx](const char* code, WTSOrdQueData* data) {
+					ctx->on_order_queue(code, data);
+				});
 			}
 		}
 	}
@@ -160,6 +191,10 @@ void WtHftEngine::handle_push_order_queue(WTSOrdQueData* curOrdQue)
 
 void WtHftEngine::handle_push_transaction(WTSTransData* curTrans)
 {
+	StdSharedLock gate(_mtx_dispatch);
+	if (_capture)
+		_capture->record_transaction(curTrans);
+
 	const char* stdCode = curTrans->code();
 	auto sit = _trans_sub_map.find(stdCode);
 	if (sit != _trans_sub_map.end())
@@ -175,7 +210,9 @@ void WtHftEngine::handle_push_transaction(WTSTransData* curTrans)
 			if (cit != _ctx_map.end())
 			{
 				HftContextPtr& ctx = (HftContextPtr&)cit->second;
-				ctx->on_transaction(stdCode, curTrans);
+				dispatch_data(sid, PCB_L2, stdCode, curTrans, [ctx](const char* code, WTSTransData* data) {
+					ctx->on_transaction(code, data);
+				});
 			}
 		}
 	}
@@ -217,6 +254,9 @@ void WtHftEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 
 	_data_mgr->handle_push_quote(stdCode, curTick);
 
+	//先更新希腊字母，策略在on_tick里读到的就是最新的
+	_greeks.on_tick(stdCode, curTick);
+
 	/*
 	 *	By Wesley @ 2022.02.07
 	 *	这里做了一个彻底的调整
@@ -242,7 +282,9 @@ void WtHftEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 
 					if (opt == 0)
 					{
-						ctx->on_tick(stdCode, curTick);
+						dispatch_data(sid, PCB_Tick, stdCode, curTick, [ctx](const char* code, WTSTickData* tick) {
+							ctx->on_tick(code, tick);
+						});
 					}
 					else
 					{
@@ -250,7 +292,9 @@ void WtHftEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 						wCode = fmt::format("{}{}", stdCode, opt == 1 ? SUFFIX_QFQ : SUFFIX_HFQ);
 						if (opt == 1)
 						{
-							ctx->on_tick(wCode.c_str(), curTick);
+							dispatch_data(sid, PCB_Tick, wCode.c_str(), curTick, [ctx](const char* code, WTSTickData* tick) {
+								ctx->on_tick(code, tick);
+							});
 						}
 						else //(opt == 2)
 						{
@@ -265,9 +309,14 @@ void WtHftEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 							newTS.low *= factor;
 							newTS.price *= factor;
 
-							_price_map[wCode] = newTS.price;
+							{
+								SpinLock lock(_mtx_price);
+								_price_map[wCode] = newTS.price;
+							}
 
-							ctx->on_tick(wCode.c_str(), newTick);
+							dispatch_data(sid, PCB_Tick, wCode.c_str(), newTick, [ctx](const char* code, WTSTickData* tick) {
+								ctx->on_tick(code, tick);
+							});
 							newTick->release();
 						}
 					}
@@ -290,7 +339,9 @@ void WtHftEngine::on_bar(const char* stdCode, const char* period, uint32_t times
 		if (cit != _ctx_map.end())
 		{
 			HftContextPtr& ctx = (HftContextPtr&)cit->second;
-			ctx->on_bar(stdCode, period, times, newBar);
+			dispatch_bar(sid, stdCode, period, times, newBar, [ctx](const char* code, const char* prd, uint32_t t, WTSBarStruct* bar) {
+				ctx->on_bar(code, prd, t, bar);
+			});
 		}
 	}
 }
@@ -303,7 +354,10 @@ void WtHftEngine::on_session_begin()
 	for (auto it = _ctx_map.begin(); it != _ctx_map.end(); it++)
 	{
 		HftContextPtr& ctx = (HftContextPtr&)it->second;
-		ctx->on_session_begin(_cur_tdate);
+		uint32_t tdate = _cur_tdate;
+		dispatch_sync(ctx->id(), PCB_Event, [ctx, tdate]() {
+			ctx->on_session_begin(tdate);
+		});
 	}
 
 	if (_evt_listener)
@@ -319,7 +373,10 @@ void WtHftEngine::on_session_end()
 	for (auto it = _ctx_map.begin(); it != _ctx_map.end(); it++)
 	{
 		HftContextPtr& ctx = (HftContextPtr&)it->second;
-		ctx->on_session_end(_cur_tdate);
+		uint32_t tdate = _cur_tdate;
+		dispatch_sync(ctx->id(), PCB_Event, [ctx, tdate]() {
+			ctx->on_session_end(tdate);
+		});
 	}
 
 	WTSLogger::info("Trading day {} ended", _cur_tdate);
@@ -327,8 +384,29 @@ void WtHftEngine::on_session_end()
 		_evt_listener->on_session_event(_cur_tdate, false);
 }
 
+void WtHftEngine::on_takeover(ShmStandby* standby)
+{
+	WtEngine::on_takeover(standby);
+
+	standby->enum_latest([this](uint32_t rtype, const char* key, const char* data, std::size_t len) {
+		for (auto it = _ctx_map.begin(); it != _ctx_map.end(); it++)
+		{
+			HftContextPtr& ctx = (HftContextPtr&)it->second;
+			if (strcmp(ctx->name(), key) == 0)
+			{
+				ctx->restore_state(rtype, data, len);
+				break;
+			}
+		}
+	});
+
+	WTSLogger::info("HFT engine took over with {} strategies", _ctx_map.size());
+}
+
 void WtHftEngine::on_minute_end(uint32_t curDate, uint32_t curTime)
 {
+	report_profiles();
+
 	//已去掉高频策略的on_schedule
 	//for(auto& cit : _ctx_map)
 	//{
@@ -341,6 +419,7 @@ void WtHftEngine::addContext(HftContextPtr ctx)
 {
 	uint32_t sid = ctx->id();
 	_ctx_map[sid] = ctx;
+	_profiler.add_strategy(sid, ctx->name());
 }
 
 HftContextPtr WtHftEngine::getContext(uint32_t id)
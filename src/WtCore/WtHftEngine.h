@@ -12,6 +12,7 @@
 #include "WtLocalExecuter.h"
 
 #include "../Includes/IHftStraCtx.h"
+#include "../Share/OptionGreeks.hpp"
 
 NS_WTP_BEGIN
 
@@ -31,7 +32,9 @@ public:
 	//WtEngine 接口
 	virtual void init(WTSVariant* cfg, IBaseDataMgr* bdMgr, WtDtMgr* dataMgr, IHotMgr* hotMgr, EventNotifier* notifier) override;
 
-	virtual void run() override;
+	virtual void run(bool bReplay = false) override;
+
+	virtual void replay_timer(uint32_t uKind, uint32_t uDate, uint32_t uTime) override;
 
 	virtual void handle_push_quote(WTSTickData* newTick) override;
 	virtual void handle_push_order_detail(WTSOrdDtlData* curOrdDtl) override;
@@ -46,11 +49,16 @@ public:
 
 	virtual void on_session_end() override;
 
+	virtual void on_takeover(ShmStandby* standby) override;
+
 public:
 	WTSOrdQueSlice* get_order_queue_slice(uint32_t sid, const char* stdCode, uint32_t count);
 	WTSOrdDtlSlice* get_order_detail_slice(uint32_t sid, const char* stdCode, uint32_t count);
 	WTSTransSlice* get_transaction_slice(uint32_t sid, const char* stdCode, uint32_t count);
 
+	inline const WTSOptGreeksStruct* get_greeks(const char* stdCode) const { return _greeks.get_greeks(stdCode); }
+	inline const WTSOptGreeksStruct* get_greeks_chain(const char* underlying, uint32_t& count) const { return _greeks.get_chain(underlying, count); }
+
 public:
 	void on_minute_end(uint32_t curDate, uint32_t curTime);
 
@@ -73,6 +81,8 @@ private:
 	StraSubMap		_ordque_sub_map;	//委托队列订阅表
 	StraSubMap		_orddtl_sub_map;	//委托明细订阅表
 	StraSubMap		_trans_sub_map;		//成交明细订阅表
+
+	OptionGreeksSvc	_greeks;	//期权希腊字母服务
 };
 
 NS_WTP_END
\ No newline at end of file
@@ -3,9 +3,11 @@
 #include "WtSelTicker.h"
 #include "TraderAdapter.h"
 #include "WtHelper.h"
+#include "EventCapture.h"
 
 #include "../WTSTools/WTSLogger.h"
 #include "../Share/TimeUtils.hpp"
+#include "../Share/TradingCalendar.hpp"
 #include "../Includes/IBaseDataMgr.h"
 #include "../Includes/IHotMgr.h"
 #include "../Share/StrUtil.hpp"
@@ -47,6 +49,25 @@ void WtSelEngine::on_session_end()
 		_evt_listener->on_session_event(_cur_tdate, false);
 }
 
+void WtSelEngine::on_takeover(ShmStandby* standby)
+{
+	WtEngine::on_takeover(standby);
+
+	standby->enum_latest([this](uint32_t rtype, const char* key, const char* data, std::size_t len) {
+		for (auto it = _ctx_map.begin(); it != _ctx_map.end(); it++)
+		{
+			SelContextPtr& ctx = (SelContextPtr&)it->second;
+			if (strcmp(ctx->name(), key) == 0)
+			{
+				ctx->restore_state(rtype, data, len);
+				break;
+			}
+		}
+	});
+
+	WTSLogger::info("SEL engine took over with {} strategies", _ctx_map.size());
+}
+
 void WtSelEngine::on_session_begin()
 {
 	if (_evt_listener)
@@ -63,6 +84,10 @@ void WtSelEngine::on_init()
 
 void WtSelEngine::handle_push_quote(WTSTickData* curTick)
 {
+	StdSharedLock gate(_mtx_dispatch);
+	if (_capture)
+		_capture->record_tick(curTick);
+
 	if (_tm_ticker)
 		_tm_ticker->on_tick(curTick);
 }
@@ -80,7 +105,9 @@ void WtSelEngine::on_bar(const char* stdCode, const char* period, uint32_t times
 		if (cit != _ctx_map.end())
 		{
 			SelContextPtr& ctx = (SelContextPtr&)cit->second;
-			ctx->on_bar(stdCode, period, times, newBar);
+			dispatch_bar(sid, stdCode, period, times, newBar, [ctx](const char* code, const char* prd, uint32_t t, WTSBarStruct* bar) {
+				ctx->on_bar(code, prd, t, bar);
+			});
 		}
 	}
 
@@ -95,6 +122,7 @@ void WtSelEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 
 	//如果是真实代码, 则要传递给执行器
 	{
+		StdLocker<StdRecurMutex> lock(_mtx_pos);
 		_exec_mgr.handle_tick(stdCode, curTick);
 	}
 
@@ -144,7 +172,9 @@ void WtSelEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 
 					if (opt == 0)
 					{
-						ctx->on_tick(stdCode, curTick);
+						dispatch_data(sid, PCB_Tick, stdCode, curTick, [ctx](const char* code, WTSTickData* tick) {
+							ctx->on_tick(code, tick);
+						});
 					}
 					else
 					{
@@ -152,7 +182,9 @@ void WtSelEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 						wCode = fmt::format("{}{}", stdCode, opt == 1 ? SUFFIX_QFQ : SUFFIX_HFQ);
 						if (opt == 1)
 						{
-							ctx->on_tick(wCode.c_str(), curTick);
+							dispatch_data(sid, PCB_Tick, wCode.c_str(), curTick, [ctx](const char* code, WTSTickData* tick) {
+								ctx->on_tick(code, tick);
+							});
 						}
 						else //(opt == 2)
 						{
@@ -190,9 +222,14 @@ void WtSelEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 								newTS.pre_interest /= factor;
 							}
 
-							_price_map[wCode] = newTS.price;
+							{
+								SpinLock lock(_mtx_price);
+								_price_map[wCode] = newTS.price;
+							}
 
-							ctx->on_tick(wCode.c_str(), newTick);
+							dispatch_data(sid, PCB_Tick, wCode.c_str(), newTick, [ctx](const char* code, WTSTickData* tick) {
+								ctx->on_tick(code, tick);
+							});
 							newTick->release();
 						}
 					}
@@ -208,6 +245,8 @@ void WtSelEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 
 void WtSelEngine::on_minute_end(uint32_t curDate, uint32_t curTime)
 {
+	report_profiles();
+
 	//要比较下一分钟的时间
 	uint32_t nextTime = TimeUtils::getNextMinute(curTime, 1);
 	if (nextTime < curTime)
@@ -228,16 +267,10 @@ void WtSelEngine::on_minute_end(uint32_t curDate, uint32_t curTime)
 		if (_base_data_mgr->isHoliday(tInfo->_trdtpl, curDate, true))
 			continue;
 
-		//获取上一个交易日的日期
-		uint32_t preTDate = TimeUtils::getNextDate(_cur_date, -1);
-		bool bHasHoliday = false;
-		uint32_t days = 1;
-		while (_base_data_mgr->isHoliday(tInfo->_trdtpl, preTDate, true))
-		{
-			bHasHoliday = true;
-			preTDate = TimeUtils::getNextDate(preTDate, -1);
-			days++;
-		}
+		//获取上一个交易日的日期，直接查交易日历，days是两个日期之间的自然日数
+		uint32_t preTDate = _base_data_mgr->getPrevTDate(tInfo->_trdtpl, _cur_date, 1, true);
+		uint32_t days = (uint32_t)(TradingCalendar::date_to_days(_cur_date) - TradingCalendar::date_to_days(preTDate));
+		bool bHasHoliday = (days > 1);
 		uint32_t preWD = TimeUtils::getWeekDay(preTDate);
 
 		WTSSessionInfo* sInfo = get_session_info(tInfo->_session, false);
@@ -310,20 +343,26 @@ void WtSelEngine::on_minute_end(uint32_t curDate, uint32_t curTime)
 
 		//TODO: 回调任务
 		SelContextPtr ctx = getContext(tInfo->_id);
-		StdThreadPtr thrd(new StdThread([ctx, curDate, curTime, nextTime](){
+		StdThreadPtr thrd(new StdThread([this, ctx, curDate, curTime, nextTime](){
 			if (ctx)
-				ctx->on_schedule(curDate, curTime, nextTime);
-		}));	
+			{
+				dispatch_sync(ctx->id(), PCB_Calc, [ctx, curDate, curTime, nextTime]() {
+					ctx->on_schedule(curDate, curTime, nextTime);
+				});
+			}
+		}));
+		//线程对象马上就要析构了，不分离的话会直接terminate
+		thrd->detach();
 
 		tInfo->_last_exe_time = now;
 	}
 }
 
-void WtSelEngine::run()
+void WtSelEngine::run(bool bReplay /* = false */)
 {
 	WTSVariant* cfgProd = _cfg->get("product");
 	_tm_ticker = new WtSelRtTicker(this);
-	_tm_ticker->init(_data_mgr->reader(), cfgProd->getCString("session"));
+	_tm_ticker->init(_data_mgr, cfgProd->getCString("session"));
 
 	//启动之前,先把运行中的策略落地
 	{
@@ -359,7 +398,18 @@ void WtSelEngine::run()
 		StdFile::write_file_content(filename.c_str(), sb.GetString());
 	}
 
-	_tm_ticker->run();
+	_tm_ticker->run(bReplay);
+}
+
+void WtSelEngine::replay_timer(uint32_t uKind, uint32_t uDate, uint32_t uTime)
+{
+	if (_tm_ticker == NULL)
+		return;
+
+	if (uKind == CTK_Idle)
+		_tm_ticker->fire_idle_minute(uTime);
+	else
+		_tm_ticker->fire_minute_end();
 }
 
 void WtSelEngine::init(WTSVariant* cfg, IBaseDataMgr* bdMgr, WtDtMgr* dataMgr, IHotMgr* hotMgr, EventNotifier* notifier /* = NULL */)
@@ -396,6 +446,7 @@ void WtSelEngine::addContext(SelContextPtr ctx, uint32_t date, uint32_t time, Ta
 
 	uint32_t sid = ctx->id();
 	_ctx_map[sid] = ctx;
+	_profiler.add_strategy(sid, ctx->name());
 }
 
 SelContextPtr WtSelEngine::getContext(uint32_t id)
@@ -409,6 +460,9 @@ SelContextPtr WtSelEngine::getContext(uint32_t id)
 
 void WtSelEngine::handle_pos_change(const char* straName, const char* stdCode, double diffQty)
 {
+	//被隔离的策略会在工作线程里调用
+	StdLocker<StdRecurMutex> lock(_mtx_pos);
+
 	//这里是持仓增量,所以不用处理未过滤的情况,因为增量情况下,不会改变目标diffQty
 	if (_filter_mgr.is_filtered_by_strategy(straName, diffQty, true))
 	{
@@ -51,7 +51,9 @@ public:
 	//WtEngine接口
 	virtual void init(WTSVariant* cfg, IBaseDataMgr* bdMgr, WtDtMgr* dataMgr, IHotMgr* hotMgr, EventNotifier* notifier) override;
 
-	virtual void run() override;
+	virtual void run(bool bReplay = false) override;
+
+	virtual void replay_timer(uint32_t uKind, uint32_t uDate, uint32_t uTime) override;
 
 	virtual void on_tick(const char* stdCode, WTSTickData* curTick) override;
 
@@ -65,6 +67,8 @@ public:
 
 	virtual void on_session_end() override;
 
+	virtual void on_takeover(ShmStandby* standby) override;
+
 	///////////////////////////////////////////////////////////////////////////
 	//IExecuterStub 接口
 	virtual uint64_t get_real_time() override;
@@ -9,7 +9,8 @@
 */
 #include "WtSelTicker.h"
 #include "WtSelEngine.h"
-#include "../Includes/IDataReader.h"
+#include "WtDtMgr.h"
+#include "EventCapture.h"
 
 #include "../Share/TimeUtils.hpp"
 #include "../Includes/WTSSessionInfo.hpp"
@@ -24,13 +25,16 @@ USING_NS_WTP;
 
 
 WtSelRtTicker::WtSelRtTicker(WtSelEngine* engine)
-	: _engine(engine)
-	, _stopped(false)
+	: _s_info(NULL)
+	, _engine(engine)
+	, _store(NULL)
 	, _date(0)
 	, _time(UINT_MAX)
+	, _cur_pos(0)
 	, _next_check_time(0)
 	, _last_emit_pos(0)
-	, _cur_pos(0)
+	, _stopped(false)
+	, _replay(false)
 {
 }
 
@@ -39,7 +43,7 @@ WtSelRtTicker::~WtSelRtTicker()
 {
 }
 
-void WtSelRtTicker::init(IDataReader* store, const char* sessionID)
+void WtSelRtTicker::init(WtDtMgr* store, const char* sessionID)
 {
 	_store = store;
 	_s_info = _engine->get_session_info(sessionID);
@@ -68,7 +72,7 @@ void WtSelRtTicker::trigger_price(WTSTickData* curTick, uint32_t hotFlag /* = 0
 
 void WtSelRtTicker::on_tick(WTSTickData* curTick, uint32_t hotFlag /* = 0 */)
 {
-	if (_thrd == NULL)
+	if (_thrd == NULL && !_replay)
 	{
 		trigger_price(curTick, hotFlag);
 		return;
@@ -120,7 +124,7 @@ void WtSelRtTicker::on_tick(WTSTickData* curTick, uint32_t hotFlag /* = 0 */)
 
 			WTSLogger::info("Minute Bar {}.{:04d} Closed by data", _date, thisMin);
 			if (_store)
-				_store->onMinuteEnd(_date, thisMin);
+				_store->on_minute_end(_date, thisMin);
 
 			_engine->on_minute_end(_date, thisMin);
 
@@ -154,11 +158,18 @@ void WtSelRtTicker::on_tick(WTSTickData* curTick, uint32_t hotFlag /* = 0 */)
 	_next_check_time = TimeUtils::getLocalTimeNow() + left_ticks;
 }
 
-void WtSelRtTicker::run()
+void WtSelRtTicker::run(bool bReplay /* = false */)
 {
-	if (_thrd)
+	if (_thrd || _replay)
 		return;
 
+	if (bReplay)
+	{
+		_replay = true;
+		_date = _engine->get_date();
+		_time = _engine->get_raw_time() * 100000 + _engine->get_secs();
+	}
+
 	uint32_t curTDate = _engine->get_basedata_mgr()->calcTradingDate(_s_info->id(), _engine->get_date(), _engine->get_min_time(), true);
 	_engine->set_trading_date(curTDate);
 
@@ -166,6 +177,9 @@ void WtSelRtTicker::run()
 
 	_engine->on_session_begin();
 
+	if (_replay)
+		return;
+
 	//先检查当前时间, 如果大于
 	//uint32_t offTime = _s_info->offsetTime(_engine->get_min_time());
 
@@ -178,60 +192,78 @@ void WtSelRtTicker::run()
 				uint64_t now = TimeUtils::getLocalTimeNow();
 
 				if (now >= _next_check_time && _last_emit_pos < _cur_pos)
-				{
-					//触发数据回放模块
-					StdUniqueLock lock(_mtx);
-
-					//优先修改时间标记
-					_last_emit_pos = _cur_pos;
-
-					uint32_t thisMin = _s_info->minuteToTime(_cur_pos);
-					_time = thisMin;
-
-					//如果thisMin是0, 说明换日了
-					//这里是本地计时导致的换日, 说明日期其实还是老日期, 要自动+1
-					//同时因为时间是235959xxx, 所以也要手动置为0
-					if (thisMin == 0)
-					{
-						uint32_t lastDate = _date;
-						_date = TimeUtils::getNextDate(_date);
-						_time = 0;
-						WTSLogger::info("Data automatically changed at time 00:00: {} -> {}", lastDate, _date);
-					}
-
-					WTSLogger::info("Minute bar {}.{:04d} closed automatically", _date, thisMin);
-					if (_store)
-						_store->onMinuteEnd(_date, thisMin);
-
-					_engine->on_minute_end(_date, thisMin);
-
-					uint32_t offMin = _s_info->offsetTime(thisMin, true);
-					if (offMin >= _s_info->getCloseTime(true))
-					{
-						_engine->on_session_end();
-					}
-
-					//145959000
-					if (_engine)
-						_engine->set_date_time(_date, thisMin, 0);
-				}
+					fire_minute_end();
 			}
 			else
 			{//如果不在交易时间,则每隔10毫秒检查一次,如果分钟发生变化则触发
 				std::this_thread::sleep_for(std::chrono::milliseconds(10));
 				uint32_t curTime = TimeUtils::getCurMin();
 				if (_time != UINT_MAX && curTime != _time)
-				{
-					_engine->on_minute_end(_date, _time);
-					if (curTime < _time)
-						_date = TimeUtils::getNextDate(_date);
-					_time = curTime;
-				}
+					fire_idle_minute(curTime);
 			}
 		}
 	}));
 }
 
+void WtSelRtTicker::fire_minute_end()
+{
+	//先进闸门再拿_mtx，和解析器线程的加锁顺序保持一致
+	StdSharedLock gate(_engine->dispatch_gate());
+	//触发数据回放模块
+	StdUniqueLock lock(_mtx);
+
+	//优先修改时间标记
+	_last_emit_pos = _cur_pos;
+
+	uint32_t thisMin = _s_info->minuteToTime(_cur_pos);
+	_time = thisMin;
+
+	//如果thisMin是0, 说明换日了
+	//这里是本地计时导致的换日, 说明日期其实还是老日期, 要自动+1
+	//同时因为时间是235959xxx, 所以也要手动置为0
+	if (thisMin == 0)
+	{
+		uint32_t lastDate = _date;
+		_date = TimeUtils::getNextDate(_date);
+		_time = 0;
+		WTSLogger::info("Data automatically changed at time 00:00: {} -> {}", lastDate, _date);
+	}
+
+	//本地计时的触发时机取决于墙上时钟，回放的时候没法重新推算，所以要录制下来
+	EventCapture* capture = _engine->get_capture();
+	if (capture)
+		capture->record_timer(CTK_MinuteEnd, _date, thisMin);
+
+	WTSLogger::info("Minute bar {}.{:04d} closed automatically", _date, thisMin);
+	if (_store)
+		_store->on_minute_end(_date, thisMin);
+
+	_engine->on_minute_end(_date, thisMin);
+
+	uint32_t offMin = _s_info->offsetTime(thisMin, true);
+	if (offMin >= _s_info->getCloseTime(true))
+	{
+		_engine->on_session_end();
+	}
+
+	//145959000
+	if (_engine)
+		_engine->set_date_time(_date, thisMin, 0);
+}
+
+void WtSelRtTicker::fire_idle_minute(uint32_t curTime)
+{
+	StdSharedLock gate(_engine->dispatch_gate());
+	EventCapture* capture = _engine->get_capture();
+	if (capture)
+		capture->record_timer(CTK_Idle, _date, curTime);
+
+	_engine->on_minute_end(_date, _time);
+	if (curTime < _time)
+		_date = TimeUtils::getNextDate(_date);
+	_time = curTime;
+}
+
 void WtSelRtTicker::stop()
 {
 	_stopped = true;
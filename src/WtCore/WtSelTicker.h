@@ -17,7 +17,7 @@
 
 NS_WTP_BEGIN
 class WTSSessionInfo;
-class IDataReader;
+class WtDtMgr;
 class WTSTickData;
 
 class WtSelEngine;
@@ -29,19 +29,34 @@ public:
 	~WtSelRtTicker();
 
 public:
-	void	init(IDataReader* store, const char* sessionID);
+	void	init(WtDtMgr* store, const char* sessionID);
 	void	on_tick(WTSTickData* curTick, uint32_t hotFlag = 0);
 
-	void	run();
+	/*
+	 *	@bReplay	回放模式，不启动定时线程，时间从引擎读取
+	 */
+	void	run(bool bReplay = false);
 	void	stop();
 
+	/*
+	 *	本地计时触发分钟闭合
+	 *	实盘由定时线程调用，回放时由录制的定时器事件调用
+	 */
+	void	fire_minute_end();
+
+	/*
+	 *	非交易时间的分钟切换，调用方式同上
+	 *	@curTime	新的分钟(HHMM)
+	 */
+	void	fire_idle_minute(uint32_t curTime);
+
 private:
 	void	trigger_price(WTSTickData* curTick, uint32_t hotFlag = 0);
 
 private:
 	WTSSessionInfo*	_s_info;
 	WtSelEngine*	_engine;
-	IDataReader*		_store;
+	WtDtMgr*		_store;
 
 	uint32_t	_date;
 	uint32_t	_time;
@@ -53,6 +68,7 @@ private:
 	std::atomic<uint32_t>	_last_emit_pos;
 
 	bool			_stopped;
+	bool			_replay;
 	StdThreadPtr	_thrd;
 };
 
@@ -125,6 +125,25 @@ typedef struct _RTTickCache : RTBlockHeader
 	TickCacheItem	_ticks[0];
 } RTTickCache;
 
+//实时数据的封存文件头部
+//盘中把实时数据块里较早的数据按固定条数分段压缩，追加到同目录同名的.sdb文件里
+//文件结构: RTSealHeader + N * (RTSealChunk + 压缩数据)
+typedef struct _RTSealHeader : BlockHeader
+{
+	uint32_t	_date;		//交易日，和实时数据块一致
+	uint32_t	_sealed;	//已封存的条数，实时数据块里这之前的数据都要从封存文件读
+	uint32_t	_chunks;	//分段数
+	uint32_t	_reserved;
+	uint64_t	_size;		//有效长度，包括头部
+} RTSealHeader;
+
+typedef struct _RTSealChunk
+{
+	uint32_t	_start;		//分段第一条数据在实时数据块里的下标
+	uint32_t	_count;		//分段的数据条数
+	uint64_t	_size;		//压缩后的数据大小
+} RTSealChunk;
+
 
 //历史Tick数据
 typedef struct _HisTickBlock : BlockHeader
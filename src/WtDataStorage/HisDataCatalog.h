@@ -0,0 +1,320 @@
+﻿/*!
+ * \file HisDataCatalog.h
+ * \project	WonderTrader
+ *
+ * \brief 历史高频数据目录
+ *
+ * 每个交易所每种数据类型一个目录文件，存放在his/{ticks|orders|queue|trans}/{exchg}/catalog.csv
+ * 每一行记录一个代码一个交易日的数据文件：条数、首尾时间、文件大小、存储版本
+ * 区间读取的时候先查目录，不存在的日期和时间不重叠的文件直接跳过，不用再逐日探测文件
+ */
+#pragma once
+#include <map>
+#include <string>
+#include <fstream>
+#include <algorithm>
+
+#include "DataDefine.h"
+#include "../Includes/FasterDefs.h"
+#include "../Share/StdUtils.hpp"
+#include "../Share/StrUtil.hpp"
+#include "../WTSUtils/WTSCmpHelper.hpp"
+
+#include <sys/stat.h>
+#include <boost/filesystem.hpp>
+
+NS_WTP_BEGIN
+
+class HisDataCatalog
+{
+public:
+	typedef struct _CatalogItem
+	{
+		uint32_t	_date;		//交易日
+		uint32_t	_count;		//数据条数
+		uint64_t	_stime;		//第一条数据的时间，YYYYMMDDHHMMSSmmm
+		uint64_t	_etime;		//最后一条数据的时间，YYYYMMDDHHMMSSmmm
+		uint64_t	_size;		//文件大小
+		uint32_t	_version;	//存储版本，见BLOCK_VERSION_XXX
+
+		_CatalogItem() { memset(this, 0, sizeof(_CatalogItem)); }
+
+		//时间区间是否和数据重叠
+		inline bool overlap(uint64_t stime, uint64_t etime) const
+		{
+			return !(_etime < stime || (etime != 0 && _stime > etime));
+		}
+	} CatalogItem;
+
+	typedef std::map<uint32_t, CatalogItem>			DateItems;	//按交易日排序
+	typedef wt_hashmap<std::string, DateItems>		CodeItems;
+
+public:
+	HisDataCatalog() : _mod_time(0), _file_size(0), _dirty(false) {}
+
+	/*
+	 *	目录文件路径
+	 *	@dtype	数据类型，即his下的目录名：ticks/orders/queue/trans
+	 */
+	static inline std::string catalog_file(const char* baseDir, const char* dtype, const char* exchg)
+	{
+		return StrUtil::printf("%shis/%s/%s/catalog.csv", baseDir, dtype, exchg);
+	}
+
+	inline bool load(const char* filename)
+	{
+		_filename = filename;
+		_items.clear();
+		_mod_time = 0;
+		_file_size = 0;
+		_dirty = false;
+
+		if (!StdFile::exists(filename))
+			return false;
+
+		std::ifstream ifs(filename);
+		if (!ifs.is_open())
+			return false;
+
+		std::string line;
+		std::getline(ifs, line);	//跳过表头
+		while (std::getline(ifs, line))
+		{
+			StringVector ay = StrUtil::split(line, ",");
+			if (ay.size() < 7)
+				continue;
+
+			CatalogItem item;
+			item._date = strtoul(ay[1].c_str(), NULL, 10);
+			item._count = strtoul(ay[2].c_str(), NULL, 10);
+			item._stime = strtoull(ay[3].c_str(), NULL, 10);
+			item._etime = strtoull(ay[4].c_str(), NULL, 10);
+			item._size = strtoull(ay[5].c_str(), NULL, 10);
+			item._version = strtoul(ay[6].c_str(), NULL, 10);
+			_items[ay[0]][item._date] = item;
+		}
+
+		stat_file(filename, _mod_time, _file_size);
+		return true;
+	}
+
+	inline bool save()
+	{
+		if (_filename.empty())
+			return false;
+
+		//先写临时文件再替换，读取方不会读到写了一半的目录
+		std::string tmpfile = _filename + ".tmp";
+		{
+			std::ofstream ofs(tmpfile, std::ios::out | std::ios::trunc);
+			if (!ofs.is_open())
+				return false;
+
+			ofs << "code,date,count,stime,etime,size,version" << std::endl;
+			for (auto& v : _items)
+			{
+				for (auto& m : v.second)
+				{
+					const CatalogItem& item = m.second;
+					ofs << v.first << "," << item._date << "," << item._count << "," << item._stime << ","
+						<< item._etime << "," << item._size << "," << item._version << std::endl;
+				}
+			}
+		}
+
+		boost::system::error_code ec;
+		boost::filesystem::rename(tmpfile, _filename, ec);
+		if (ec)
+			return false;
+
+		stat_file(_filename.c_str(), _mod_time, _file_size);
+		_dirty = false;
+		return true;
+	}
+
+	/*
+	 *	目录文件是否被其他进程更新过
+	 *	修改时间只精确到秒，所以还要比较文件大小
+	 *	每次查询都会调用，只stat一次
+	 */
+	inline bool is_outdated() const
+	{
+		if (_filename.empty())
+			return false;
+
+		int64_t mtime = 0;
+		uint64_t fsize = 0;
+		stat_file(_filename.c_str(), mtime, fsize);
+		return mtime != _mod_time || fsize != _file_size;
+	}
+
+	inline bool is_dirty() const { return _dirty; }
+
+	inline bool is_empty() const { return _items.empty(); }
+
+	inline void update(const char* code, const CatalogItem& item)
+	{
+		_items[code][item._date] = item;
+		_dirty = true;
+	}
+
+	inline const CatalogItem* find(const char* code, uint32_t uDate) const
+	{
+		auto it = _items.find(code);
+		if (it == _items.end())
+			return NULL;
+
+		auto dit = it->second.find(uDate);
+		if (dit == it->second.end())
+			return NULL;
+
+		return &dit->second;
+	}
+
+	inline const DateItems* get_dates(const char* code) const
+	{
+		auto it = _items.find(code);
+		if (it == _items.end())
+			return NULL;
+
+		return &it->second;
+	}
+
+	inline const CodeItems& items() const { return _items; }
+
+public:
+	/*
+	 *	根据数据块生成目录项
+	 */
+	template<typename T>
+	static inline void make_item(CatalogItem& item, uint32_t uDate, const T* items, uint32_t count, uint64_t fsize, uint32_t version)
+	{
+		item._date = uDate;
+		item._count = count;
+		item._size = fsize;
+		item._version = version;
+		if (count > 0)
+		{
+			item._stime = (uint64_t)items[0].action_date * 1000000000 + items[0].action_time;
+			item._etime = (uint64_t)items[count - 1].action_date * 1000000000 + items[count - 1].action_time;
+		}
+	}
+
+	/*
+	 *	扫描一个历史数据文件生成目录项，重建目录用
+	 */
+	template<typename T>
+	static inline bool scan_file(const char* filename, uint32_t uDate, CatalogItem& item)
+	{
+		std::string content;
+		uint64_t fsize = StdFile::read_file_content(filename, content);
+		if (content.size() < sizeof(BlockHeader))
+			return false;
+
+		BlockHeader* header = (BlockHeader*)content.data();
+		uint32_t version = header->_version;
+		std::string buffer;
+		const char* data = NULL;
+		std::size_t len = 0;
+		if (header->is_compressed())
+		{
+			if (content.size() < sizeof(BlockHeaderV2))
+				return false;
+
+			BlockHeaderV2* headerV2 = (BlockHeaderV2*)content.data();
+			if (content.size() != sizeof(BlockHeaderV2) + headerV2->_size)
+				return false;
+
+			buffer = WTSCmpHelper::uncompress_data(content.data() + sizeof(BlockHeaderV2), (std::size_t)headerV2->_size);
+			data = buffer.data();
+			len = buffer.size();
+		}
+		else
+		{
+			data = content.data() + sizeof(BlockHeader);
+			len = content.size() - sizeof(BlockHeader);
+		}
+
+		//老版本的tick结构体不一样，时间字段的位置也不一样
+		if (header->_type == BT_HIS_Ticks && header->is_old_version())
+			make_item(item, uDate, (const WTSTickStructOld*)data, (uint32_t)(len / sizeof(WTSTickStructOld)), fsize, version);
+		else
+			make_item(item, uDate, (const T*)data, (uint32_t)(len / sizeof(T)), fsize, version);
+		return true;
+	}
+
+	/*
+	 *	扫描目录下所有日期子目录，重建目录
+	 *	@folder	his/{dtype}/{exchg}/
+	 *	返回扫描的文件数
+	 */
+	template<typename T>
+	inline uint32_t rebuild(const char* folder)
+	{
+		_items.clear();
+		_filename = StrUtil::standardisePath(folder) + "catalog.csv";
+
+		uint32_t count = 0;
+		if (!boost::filesystem::exists(folder))
+			return count;
+
+		boost::filesystem::directory_iterator end_iter;
+		for (boost::filesystem::directory_iterator dir(folder); dir != end_iter; dir++)
+		{
+			if (!boost::filesystem::is_directory(dir->path()))
+				continue;
+
+			uint32_t uDate = strtoul(dir->path().filename().string().c_str(), NULL, 10);
+			if (uDate == 0)
+				continue;
+
+			for (boost::filesystem::directory_iterator fit(dir->path()); fit != end_iter; fit++)
+			{
+				if (fit->path().extension() != ".dsb")
+					continue;
+
+				CatalogItem item;
+				if (!scan_file<T>(fit->path().string().c_str(), uDate, item))
+					continue;
+
+				_items[fit->path().stem().string()][uDate] = item;
+				count++;
+			}
+		}
+
+		_dirty = true;
+		return count;
+	}
+
+private:
+	/*
+	 *	一次stat同时取修改时间和文件大小，文件不存在则都为0
+	 */
+	static inline void stat_file(const char* filename, int64_t& mtime, uint64_t& fsize)
+	{
+#ifdef _MSC_VER
+		struct _stat64 st;
+		if (_stat64(filename, &st) != 0)
+#else
+		struct stat st;
+		if (stat(filename, &st) != 0)
+#endif
+		{
+			mtime = 0;
+			fsize = 0;
+			return;
+		}
+
+		mtime = (int64_t)st.st_mtime;
+		fsize = (uint64_t)st.st_size;
+	}
+
+private:
+	std::string	_filename;
+	CodeItems	_items;
+	int64_t		_mod_time;
+	uint64_t	_file_size;
+	bool		_dirty;
+};
+
+NS_WTP_END
@@ -0,0 +1,436 @@
+﻿/*!
+ * \file RTSealHelper.h
+ * \project	WonderTrader
+ *
+ * \brief 实时高频数据的盘中分段封存
+ *
+ * 写入端按固定条数把实时数据块里较早的数据压缩以后追加到同名的.sdb文件里，并释放实时数据块里对应的页面
+ * 读取端通过RTSealReader访问，下标小于已封存条数的从封存文件解压读取，其余的直接读实时数据块
+ * 收盘作业的时候封存的压缩帧直接拼接到历史数据文件里，不用再压缩一遍
+ */
+#pragma once
+#include <list>
+#include <string>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+#include "DataDefine.h"
+#include "../Share/BoostFile.hpp"
+#include "../Share/BoostMappingFile.hpp"
+#include "../WTSUtils/WTSCmpHelper.hpp"
+
+class RTSealHelper
+{
+public:
+	//实时数据块对应的封存文件名
+	static std::string seal_file(const char* rtFile)
+	{
+		std::string filename = rtFile;
+		std::size_t pos = filename.rfind('.');
+		if (pos != std::string::npos)
+			filename = filename.substr(0, pos);
+		filename += ".sdb";
+		return filename;
+	}
+
+	static void remove(const char* rtFile)
+	{
+		std::string filename = seal_file(rtFile);
+		if (BoostFile::exists(filename.c_str()))
+			BoostFile::delete_file(filename.c_str());
+	}
+
+	//读取已封存的条数，交易日不一致的返回0
+	static uint32_t sealed_count(const char* rtFile, uint32_t uDate)
+	{
+		std::string filename = seal_file(rtFile);
+		if (!BoostFile::exists(filename.c_str()))
+			return 0;
+
+		BoostFile f;
+		if (!f.open_existing_file(filename.c_str(), boost::interprocess::read_only))
+			return 0;
+
+		RTSealHeader header;
+		if (!f.read_file(&header, sizeof(RTSealHeader)) || header._date != uDate)
+			return 0;
+
+		return header._sealed;
+	}
+
+	/*
+	 *	追加一个封存分段
+	 *	@rtFile		实时数据块文件名
+	 *	@btype		实时数据块类型
+	 *	@uDate		交易日
+	 *	@start		分段第一条数据的下标，必须和已封存的条数一致
+	 *	@count		分段的数据条数
+	 *	@cmpData	压缩后的数据
+	 */
+	static bool append_chunk(const char* rtFile, uint16_t btype, uint32_t uDate, uint32_t start, uint32_t count, const std::string& cmpData)
+	{
+		std::string filename = seal_file(rtFile);
+
+		BoostFile f;
+		RTSealHeader header;
+		bool bReset = true;
+		if (BoostFile::exists(filename.c_str()))
+		{
+			if (!f.open_existing_file(filename.c_str()))
+				return false;
+
+			//之前交易日留下的封存文件，直接重建
+			if (f.read_file(&header, sizeof(RTSealHeader)) && header._date == uDate)
+				bReset = false;
+		}
+		else if (!f.create_new_file(filename.c_str()))
+		{
+			return false;
+		}
+
+		if (bReset)
+		{
+			memset(&header, 0, sizeof(RTSealHeader));
+			strcpy(header._blk_flag, BLK_FLAG);
+			header._type = btype;
+			header._version = BLOCK_VERSION_CMP_V2;
+			header._date = uDate;
+			header._size = sizeof(RTSealHeader);
+			f.truncate_file((uint32_t)header._size);
+		}
+
+		if (header._sealed != start)
+			return false;
+
+		RTSealChunk chunk;
+		chunk._start = start;
+		chunk._count = count;
+		chunk._size = cmpData.size();
+
+		//先写数据，再更新头部，读取端只认头部里的长度
+		f.set_file_pointer(header._size, boost::interprocess::file_begin);
+		f.write_file(&chunk, sizeof(RTSealChunk));
+		f.write_file(cmpData);
+
+		header._sealed += count;
+		header._chunks += 1;
+		header._size += sizeof(RTSealChunk) + cmpData.size();
+		f.seek_to_begin();
+		f.write_file(&header, sizeof(RTSealHeader));
+		f.close_file();
+		return true;
+	}
+
+	/*
+	 *	读取全部封存分段，收盘作业用
+	 *	@cmpData	拼接起来的压缩帧
+	 *	@rawData	解压后的原始数据
+	 *	返回已封存的条数
+	 */
+	static uint32_t load_chunks(const char* rtFile, uint32_t uDate, std::string& cmpData, std::string& rawData)
+	{
+		std::string filename = seal_file(rtFile);
+		std::string content;
+		if (!BoostFile::exists(filename.c_str()) || !BoostFile::read_file_contents(filename.c_str(), content))
+			return 0;
+
+		if (content.size() < sizeof(RTSealHeader))
+			return 0;
+
+		const RTSealHeader* header = (const RTSealHeader*)content.data();
+		if (header->_date != uDate || header->_size > content.size())
+			return 0;
+
+		uint32_t sealed = 0;
+		uint64_t offset = sizeof(RTSealHeader);
+		while (offset + sizeof(RTSealChunk) <= header->_size)
+		{
+			const RTSealChunk* chunk = (const RTSealChunk*)(content.data() + offset);
+			offset += sizeof(RTSealChunk);
+			if (chunk->_start != sealed || offset + chunk->_size > header->_size)
+				break;
+
+			cmpData.append(content.data() + offset, (std::size_t)chunk->_size);
+			rawData.append(WTSCmpHelper::uncompress_data(content.data() + offset, (std::size_t)chunk->_size));
+			sealed += chunk->_count;
+			offset += chunk->_size;
+		}
+
+		return sealed;
+	}
+
+	/*
+	 *	收盘作业用，把封存的数据和实时数据块里剩下的数据拼起来
+	 *	@sealed		传入实时数据块记录的已封存条数，返回封存文件里的条数
+	 *	@cmpData	返回封存的压缩帧
+	 *	@rawData	拼接后的数据缓存
+	 *	返回完整的数据，封存文件缺失或者不完整的时候返回NULL
+	 *	已封存部分的页面已经释放了，这种情况下不能再用实时数据块落地
+	 */
+	template<typename T>
+	static T* restore(const char* rtFile, uint32_t uDate, T* items, uint32_t count, uint32_t& sealed, std::string& cmpData, std::string& rawData)
+	{
+		uint32_t expected = sealed;
+		sealed = load_chunks(rtFile, uDate, cmpData, rawData);
+		if (sealed == 0 || sealed < expected || sealed > count || rawData.size() != sizeof(T)*sealed)
+		{
+			sealed = 0;
+			cmpData.clear();
+			rawData.clear();
+			return NULL;
+		}
+
+		rawData.append((const char*)(items + sealed), sizeof(T)*(count - sealed));
+		return (T*)rawData.data();
+	}
+};
+
+/*
+ *	实时数据块的读取辅助对象
+ *	下标小于已封存条数的数据从封存文件读取，其余的直接读实时数据块
+ *	封存分段只在查询用到的时候才解压，解压后的分段放在一个容量很小的LRU缓存里
+ *	缓存随时可能淘汰，所以用到了封存数据的切片会把数据拷贝到切片自己的缓冲区
+ */
+template<typename T>
+class RTSealReader
+{
+public:
+	RTSealReader(std::size_t maxCached = 4) : _date(0), _sealed(0), _checked(UINT32_MAX), _scanned(0), _max_cached(maxCached) {}
+
+	inline uint32_t sealed() const { return _sealed; }
+
+	/*
+	 *	刷新封存状态
+	 *	@rtFile		实时数据块文件名
+	 *	@uDate		实时数据块的交易日
+	 *	@curSize	实时数据块当前的条数，没有封存文件的时候，有新数据了才再检查一次
+	 *	返回已封存的条数
+	 */
+	uint32_t refresh(const char* rtFile, uint32_t uDate, uint32_t curSize)
+	{
+		if (_date != uDate)
+		{
+			_file.reset();
+			_cache.clear();
+			_starts.clear();
+			_offsets.clear();
+			_date = uDate;
+			_sealed = 0;
+			_checked = UINT32_MAX;
+			_scanned = 0;
+		}
+
+		if (_file == NULL)
+		{
+			if (curSize == _checked)
+				return _sealed;
+
+			_checked = curSize;
+			std::string filename = RTSealHelper::seal_file(rtFile);
+			if (!BoostFile::exists(filename.c_str()))
+				return _sealed;
+
+			_file.reset(new BoostMappingFile);
+			if (!_file->map(filename.c_str(), boost::interprocess::read_only, boost::interprocess::read_only) || _file->size() < sizeof(RTSealHeader))
+			{
+				_file.reset();
+				return _sealed;
+			}
+			_scanned = sizeof(RTSealHeader);
+		}
+
+		const RTSealHeader* header = (const RTSealHeader*)_file->addr();
+		if (header->_date != uDate)
+		{
+			//写入端还没有重建封存文件
+			_file.reset();
+			return _sealed;
+		}
+
+		if (header->_size > _file->size())
+		{
+			//封存文件变长了，重新映射
+			std::string filename = _file->filename();
+			_file.reset(new BoostMappingFile);
+			if (!_file->map(filename.c_str(), boost::interprocess::read_only, boost::interprocess::read_only))
+			{
+				_file.reset();
+				return _sealed;
+			}
+			header = (const RTSealHeader*)_file->addr();
+		}
+
+		uint64_t total = std::min<uint64_t>(header->_size, _file->size());
+		while (_scanned + sizeof(RTSealChunk) <= total)
+		{
+			const RTSealChunk* chunk = (const RTSealChunk*)((const char*)_file->addr() + _scanned);
+			if (chunk->_start != _sealed || _scanned + sizeof(RTSealChunk) + chunk->_size > total)
+				break;
+
+			//只记下分段的位置，用到的时候再解压
+			_starts.emplace_back(chunk->_start);
+			_offsets.emplace_back(_scanned);
+			_sealed += chunk->_count;
+			_scanned += sizeof(RTSealChunk) + chunk->_size;
+		}
+
+		return _sealed;
+	}
+
+	/*
+	 *	在[from, to)区间里查找第一条不小于val的数据，返回下标
+	 */
+	template<typename Cmp>
+	uint32_t lower_bound(T* items, uint32_t from, uint32_t to, const T& val, Cmp less)
+	{
+		if (from >= _sealed)
+			return (uint32_t)(std::lower_bound(items + from, items + to, val, less) - items);
+
+		//实时区间第一条已经比目标小了，只需要在实时区间里找
+		if (to > _sealed && less(items[_sealed], val))
+			return (uint32_t)(std::lower_bound(items + _sealed, items + to, val, less) - items);
+
+		trim();
+		uint32_t lo = from;
+		uint32_t hi = std::min(to, _sealed);
+		while (lo < hi)
+		{
+			uint32_t mid = lo + (hi - lo) / 2;
+			if (less(*sealed_at(mid), val))
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		return lo;
+	}
+
+	T* at(T* items, uint32_t idx)
+	{
+		if (idx >= _sealed)
+			return items + idx;
+
+		trim();
+		return sealed_at(idx);
+	}
+
+	/*
+	 *	把[sIdx, sIdx+cnt)拆成连续的数据块，依次回调cb(T* data, uint32_t count)
+	 *	封存区间按分段拆开，实时区间直接指向实时数据块，都不拷贝数据
+	 *	封存分段的指针只保证在下一次查询之前有效
+	 *	返回是否用到了封存数据
+	 */
+	template<typename Func>
+	bool for_blocks(T* items, uint32_t sIdx, uint32_t cnt, Func cb)
+	{
+		uint32_t eIdx = sIdx + cnt;
+		bool bSealed = (sIdx < _sealed && cnt > 0);
+		if (sIdx < _sealed)
+		{
+			trim();
+			std::size_t cIdx = chunk_of(sIdx);
+			while (sIdx < eIdx && sIdx < _sealed)
+			{
+				uint32_t cStart = _starts[cIdx];
+				uint32_t cEnd = (cIdx + 1 < _starts.size()) ? _starts[cIdx + 1] : _sealed;
+				uint32_t n = std::min(eIdx, cEnd) - sIdx;
+				cb((T*)chunk_data(cIdx).data() + (sIdx - cStart), n);
+				sIdx += n;
+				cIdx++;
+			}
+		}
+
+		if (sIdx < eIdx)
+			cb(items + sIdx, eIdx - sIdx);
+
+		return bSealed;
+	}
+
+	/*
+	 *	把[sIdx, sIdx+cnt)追加到切片里，切片为NULL的时候新建一个
+	 *	用到了封存数据的，切片会拷贝一份数据，不再引用分段缓存
+	 */
+	template<typename S>
+	S* append_to(S* slice, const char* code, T* items, uint32_t sIdx, uint32_t cnt)
+	{
+		bool bSealed = for_blocks(items, sIdx, cnt, [&slice, code](T* data, uint32_t count) {
+			if (slice == NULL)
+				slice = S::create(code, data, count);
+			else
+				slice->appendBlock(data, count);
+		});
+
+		if (bSealed && slice != NULL)
+			slice->detach();
+		return slice;
+	}
+
+	/*
+	 *	把[sIdx, sIdx+cnt)按顺序插入到切片的第blkIdx个数据块之前
+	 */
+	template<typename S>
+	void insert_to(S* slice, std::size_t blkIdx, T* items, uint32_t sIdx, uint32_t cnt)
+	{
+		bool bSealed = for_blocks(items, sIdx, cnt, [slice, &blkIdx](T* data, uint32_t count) {
+			slice->insertBlock(blkIdx++, data, count);
+		});
+
+		if (bSealed)
+			slice->detach();
+	}
+
+private:
+	/*
+	 *	查询开始的时候把缓存收缩到容量以内
+	 *	一次查询里用到的分段都不会被淘汰，所以查询过程中拿到的指针一直有效
+	 */
+	void trim()
+	{
+		while (_cache.size() > _max_cached)
+			_cache.pop_back();
+	}
+
+	//分段解压后的数据，没有缓存的时候才解压，最近用到的放在最前面
+	const std::string& chunk_data(std::size_t cIdx)
+	{
+		for (auto it = _cache.begin(); it != _cache.end(); it++)
+		{
+			if (it->first != cIdx)
+				continue;
+
+			if (it != _cache.begin())
+				_cache.splice(_cache.begin(), _cache, it);
+			return _cache.front().second;
+		}
+
+		const char* base = (const char*)_file->addr();
+		const RTSealChunk* chunk = (const RTSealChunk*)(base + _offsets[cIdx]);
+		_cache.emplace_front(cIdx, WTSCmpHelper::uncompress_data(base + _offsets[cIdx] + sizeof(RTSealChunk), (std::size_t)chunk->_size));
+		return _cache.front().second;
+	}
+
+	//下标所在的分段
+	inline std::size_t chunk_of(uint32_t idx) const
+	{
+		return (std::size_t)(std::upper_bound(_starts.begin(), _starts.end(), idx) - _starts.begin()) - 1;
+	}
+
+	inline T* sealed_at(uint32_t idx)
+	{
+		std::size_t cIdx = chunk_of(idx);
+		return (T*)chunk_data(cIdx).data() + (idx - _starts[cIdx]);
+	}
+
+private:
+	std::shared_ptr<BoostMappingFile>	_file;
+	uint32_t	_date;
+	uint32_t	_sealed;	//已封存的条数
+	uint32_t	_checked;	//上次检查封存文件时实时数据块的条数
+	uint64_t	_scanned;	//已经扫描过的分段的结束位置
+	std::vector<uint32_t>	_starts;	//每个分段第一条数据的下标
+	std::vector<uint64_t>	_offsets;	//每个分段在封存文件里的位置
+
+	typedef std::pair<std::size_t, std::string> CachedChunk;
+	std::list<CachedChunk>	_cache;		//解压过的分段，按最近使用排序，list里的元素不会移动
+	std::size_t				_max_cached;	//缓存的分段数上限
+};
@@ -338,25 +338,25 @@ WTSTickSlice* WtDataReader::readTickSlice(const char* stdCode, uint32_t count, u
 
 		RTTickBlock* tBlock = tPair->_block;
 
-		WTSTickStruct* pTick = std::lower_bound(tBlock->_ticks, tBlock->_ticks + (tBlock->_size - 1), eTick, [](const WTSTickStruct& a, const WTSTickStruct& b){
+		//封存过的数据从封存文件读取
+		RTSealReader<WTSTickStruct>& seal = tPair->_seal;
+		uint32_t eIdx = seal.lower_bound(tBlock->_ticks, 0, tBlock->_size - 1, eTick, [](const WTSTickStruct& a, const WTSTickStruct& b){
 			if (a.action_date != b.action_date)
 				return a.action_date < b.action_date;
 			else
 				return a.action_time < b.action_time;
 		});
-
-		uint32_t eIdx = pTick - tBlock->_ticks;
+		WTSTickStruct* pTick = seal.at(tBlock->_ticks, eIdx);
 
 		//如果光标定位的tick时间比目标时间打, 则全部回退一个
 		if (pTick->action_date > eTick.action_date || pTick->action_time>eTick.action_time)
 		{
-			pTick--;
 			eIdx--;
 		}
 
 		uint32_t cnt = min(eIdx + 1, count);
 		uint32_t sIdx = eIdx + 1 - cnt;
-		WTSTickSlice* slice = WTSTickSlice::create(stdCode, tBlock->_ticks + sIdx, cnt);
+		WTSTickSlice* slice = seal.append_to(WTSTickSlice::create(stdCode), stdCode, tBlock->_ticks, sIdx, cnt);
 		return slice;
 	}
 	else
@@ -466,25 +466,25 @@ WTSOrdQueSlice* WtDataReader::readOrdQueSlice(const char* stdCode, uint32_t coun
 
 		RTOrdQueBlock* rtBlock = tPair->_block;
 
-		WTSOrdQueStruct* pItem = std::lower_bound(rtBlock->_queues, rtBlock->_queues + (rtBlock->_size - 1), eTick, [](const WTSOrdQueStruct& a, const WTSOrdQueStruct& b) {
+		//封存过的数据从封存文件读取
+		RTSealReader<WTSOrdQueStruct>& seal = tPair->_seal;
+		uint32_t eIdx = seal.lower_bound(rtBlock->_queues, 0, rtBlock->_size - 1, eTick, [](const WTSOrdQueStruct& a, const WTSOrdQueStruct& b) {
 			if (a.action_date != b.action_date)
 				return a.action_date < b.action_date;
 			else
 				return a.action_time < b.action_time;
 		});
-
-		uint32_t eIdx = pItem - rtBlock->_queues;
+		WTSOrdQueStruct* pItem = seal.at(rtBlock->_queues, eIdx);
 
 		//如果光标定位的tick时间比目标时间打, 则全部回退一个
 		if (pItem->action_date > eTick.action_date || pItem->action_time > eTick.action_time)
 		{
-			pItem--;
 			eIdx--;
 		}
 
 		uint32_t cnt = min(eIdx + 1, count);
 		uint32_t sIdx = eIdx + 1 - cnt;
-		WTSOrdQueSlice* slice = WTSOrdQueSlice::create(stdCode, rtBlock->_queues + sIdx, cnt);
+		WTSOrdQueSlice* slice = seal.append_to<WTSOrdQueSlice>(NULL, stdCode, rtBlock->_queues, sIdx, cnt);
 		return slice;
 	}
 	else
@@ -609,25 +609,25 @@ WTSOrdDtlSlice* WtDataReader::readOrdDtlSlice(const char* stdCode, uint32_t coun
 
 		RTOrdDtlBlock* rtBlock = tPair->_block;
 
-		WTSOrdDtlStruct* pItem = std::lower_bound(rtBlock->_details, rtBlock->_details + (rtBlock->_size - 1), eTick, [](const WTSOrdDtlStruct& a, const WTSOrdDtlStruct& b) {
+		//封存过的数据从封存文件读取
+		RTSealReader<WTSOrdDtlStruct>& seal = tPair->_seal;
+		uint32_t eIdx = seal.lower_bound(rtBlock->_details, 0, rtBlock->_size - 1, eTick, [](const WTSOrdDtlStruct& a, const WTSOrdDtlStruct& b) {
 			if (a.action_date != b.action_date)
 				return a.action_date < b.action_date;
 			else
 				return a.action_time < b.action_time;
 		});
-
-		uint32_t eIdx = pItem - rtBlock->_details;
+		WTSOrdDtlStruct* pItem = seal.at(rtBlock->_details, eIdx);
 
 		//如果光标定位的tick时间比目标时间打, 则全部回退一个
 		if (pItem->action_date > eTick.action_date || pItem->action_time > eTick.action_time)
 		{
-			pItem--;
 			eIdx--;
 		}
 
 		uint32_t cnt = min(eIdx + 1, count);
 		uint32_t sIdx = eIdx + 1 - cnt;
-		WTSOrdDtlSlice* slice = WTSOrdDtlSlice::create(stdCode, rtBlock->_details + sIdx, cnt);
+		WTSOrdDtlSlice* slice = seal.append_to<WTSOrdDtlSlice>(NULL, stdCode, rtBlock->_details, sIdx, cnt);
 		return slice;
 	}
 	else
@@ -752,25 +752,25 @@ WTSTransSlice* WtDataReader::readTransSlice(const char* stdCode, uint32_t count,
 
 		RTTransBlock* rtBlock = tPair->_block;
 
-		WTSTransStruct* pItem = std::lower_bound(rtBlock->_trans, rtBlock->_trans + (rtBlock->_size - 1), eTick, [](const WTSTransStruct& a, const WTSTransStruct& b) {
+		//封存过的数据从封存文件读取
+		RTSealReader<WTSTransStruct>& seal = tPair->_seal;
+		uint32_t eIdx = seal.lower_bound(rtBlock->_trans, 0, rtBlock->_size - 1, eTick, [](const WTSTransStruct& a, const WTSTransStruct& b) {
 			if (a.action_date != b.action_date)
 				return a.action_date < b.action_date;
 			else
 				return a.action_time < b.action_time;
 		});
-
-		uint32_t eIdx = pItem - rtBlock->_trans;
+		WTSTransStruct* pItem = seal.at(rtBlock->_trans, eIdx);
 
 		//如果光标定位的tick时间比目标时间打, 则全部回退一个
 		if (pItem->action_date > eTick.action_date || pItem->action_time > eTick.action_time)
 		{
-			pItem--;
 			eIdx--;
 		}
 
 		uint32_t cnt = min(eIdx + 1, count);
 		uint32_t sIdx = eIdx + 1 - cnt;
-		WTSTransSlice* slice = WTSTransSlice::create(stdCode, rtBlock->_trans + sIdx, cnt);
+		WTSTransSlice* slice = seal.append_to<WTSTransSlice>(NULL, stdCode, rtBlock->_trans, sIdx, cnt);
 		return slice;
 	}
 	else
@@ -1797,6 +1797,9 @@ WtDataReader::TickBlockPair* WtDataReader::getRTTickBlock(const char* exchg, con
 		block._last_cap = block._block->_capacity;
 	}
 
+	//盘中封存的进度
+	block._seal.refresh(path, block._block->_date, block._block->_size);
+
 	return &block;
 }
 
@@ -1839,6 +1842,9 @@ WtDataReader::OrdDtlBlockPair* WtDataReader::getRTOrdDtlBlock(const char* exchg,
 		block._last_cap = block._block->_capacity;
 	}
 
+	//盘中封存的进度
+	block._seal.refresh(path, block._block->_date, block._block->_size);
+
 	return &block;
 }
 
@@ -1881,6 +1887,9 @@ WtDataReader::OrdQueBlockPair* WtDataReader::getRTOrdQueBlock(const char* exchg,
 		block._last_cap = block._block->_capacity;
 	}
 
+	//盘中封存的进度
+	block._seal.refresh(path, block._block->_date, block._block->_size);
+
 	return &block;
 }
 
@@ -1923,6 +1932,9 @@ WtDataReader::TransBlockPair* WtDataReader::getRTTransBlock(const char* exchg, c
 		block._last_cap = block._block->_capacity;
 	}
 
+	//盘中封存的进度
+	block._seal.refresh(path, block._block->_date, block._block->_size);
+
 	return &block;
 }
 
@@ -3,6 +3,7 @@
 #include <stdint.h>
 
 #include "DataDefine.h"
+#include "RTSealHelper.h"
 
 #include "../Includes/FasterDefs.h"
 #include "../Includes/IDataReader.h"
@@ -41,6 +42,7 @@ private:
 		RTTickBlock*	_block;
 		BoostMFPtr		_file;
 		uint64_t		_last_cap;
+		RTSealReader<WTSTickStruct>	_seal;
 
 		_TBlockPair()
 		{
@@ -56,6 +58,7 @@ private:
 		RTTransBlock*	_block;
 		BoostMFPtr		_file;
 		uint64_t		_last_cap;
+		RTSealReader<WTSTransStruct>	_seal;
 
 		std::shared_ptr< std::ofstream>	_fstream;
 
@@ -73,6 +76,7 @@ private:
 		RTOrdDtlBlock*	_block;
 		BoostMFPtr		_file;
 		uint64_t		_last_cap;
+		RTSealReader<WTSOrdDtlStruct>	_seal;
 
 		std::shared_ptr< std::ofstream>	_fstream;
 
@@ -90,6 +94,7 @@ private:
 		RTOrdQueBlock*	_block;
 		BoostMFPtr		_file;
 		uint64_t		_last_cap;
+		RTSealReader<WTSOrdQueStruct>	_seal;
 
 		std::shared_ptr< std::ofstream>	_fstream;
 
@@ -12,6 +12,7 @@
 
 #include "../Includes/IBaseDataMgr.h"
 #include "../WTSUtils/WTSCmpHelper.hpp"
+#include "RTSealHelper.h"
 
 #include <set>
 #include <algorithm>
@@ -92,6 +93,9 @@ WtDataWriter::WtDataWriter()
 	, _disable_his(false)
 	, _skip_notrade_tick(false)
 	, _skip_notrade_bar(false)
+	, _seal_chunk(0)
+	, _seal_window(0)
+	, _seal_lag(4)
 {
 }
 
@@ -147,6 +151,14 @@ bool WtDataWriter::init(WTSVariant* params, IDataWriterSink* sink)
 
 	_min_price_mode = params->getUInt32("minbar_price_mode");
 
+	//盘中分段封存，默认不开启
+	_seal_chunk = params->getUInt32("sealchunk");
+	_seal_window = params->getUInt32("sealwindow");
+	if (_seal_chunk > 0 && _seal_window == 0)
+		_seal_window = _seal_chunk;
+	if (params->has("seallag"))
+		_seal_lag = max(params->getUInt32("seallag"), 1U);
+
 	{
 		std::string filename = _base_dir + MARKER_FILE;
 		IniHelper iniHelper;
@@ -164,9 +176,9 @@ bool WtDataWriter::init(WTSVariant* params, IDataWriterSink* sink)
 	_proc_chk.reset(new StdThread(boost::bind(&WtDataWriter::check_loop, this)));
 
 	pipe_writer_log(sink, LL_INFO, "WtDataWriter initialized, root dir: {}, save_csv_tick: {}, async_mode: {}, log_group_size: {}, disable_history: {}, "
-		"disable_tick: {}, disable_min1: {}, disable_min5: {}, disable_day: {}, disable_trans: {}, disable_ordque: {}, disable_orders: {}, min_price_mode: {}", 
+		"disable_tick: {}, disable_min1: {}, disable_min5: {}, disable_day: {}, disable_trans: {}, disable_ordque: {}, disable_orders: {}, min_price_mode: {}, seal_chunk: {}, seal_window: {}, seal_lag: {}", 
 		_base_dir, _save_tick_log, _async_proc, _log_group_size, _disable_his, _disable_tick, 
-		_disable_min1, _disable_min5, _disable_day, _disable_trans, _disable_ordque, _disable_orddtl, _min_price_mode);
+		_disable_min1, _disable_min5, _disable_day, _disable_trans, _disable_ordque, _disable_orddtl, _min_price_mode, _seal_chunk, _seal_window, _seal_lag);
 	return true;
 }
 
@@ -710,6 +722,10 @@ WtDataWriter::OrdQueBlockPair* WtDataWriter::getOrdQueBlock(WTSContractInfo* ct,
 		}
 		pBlock->_block = (RTOrdQueBlock*)pBlock->_file->addr();
 
+		//之前已经封存过的，接着封存，交易日不一致的为0
+		pBlock->_sealed = RTSealHelper::sealed_count(path.c_str(), curDate);
+		pBlock->_discarded = 0;
+
 		if (!isNew &&  pBlock->_block->_date != curDate)
 		{
 			pipe_writer_log(_sink, LL_INFO, "date[{}] of orderqueue cache block[{}] is different from current date[{}], reinitializing...", pBlock->_block->_date, path.c_str(), curDate);
@@ -804,6 +820,10 @@ WtDataWriter::OrdDtlBlockPair* WtDataWriter::getOrdDtlBlock(WTSContractInfo* ct,
 		}
 		pBlock->_block = (RTOrdDtlBlock*)pBlock->_file->addr();
 
+		//之前已经封存过的，接着封存，交易日不一致的为0
+		pBlock->_sealed = RTSealHelper::sealed_count(path.c_str(), curDate);
+		pBlock->_discarded = 0;
+
 		if (!isNew &&  pBlock->_block->_date != curDate)
 		{
 			pipe_writer_log(_sink, LL_INFO, "date[{}] of orderdetail cache block[{}] is different from current date[{}], reinitializing...", pBlock->_block->_date, path.c_str(), curDate);
@@ -899,6 +919,10 @@ WtDataWriter::TransBlockPair* WtDataWriter::getTransBlock(WTSContractInfo* ct, u
 		}
 		pBlock->_block = (RTTransBlock*)pBlock->_file->addr();
 
+		//之前已经封存过的，接着封存，交易日不一致的为0
+		pBlock->_sealed = RTSealHelper::sealed_count(path.c_str(), curDate);
+		pBlock->_discarded = 0;
+
 		if (!isNew &&  pBlock->_block->_date != curDate)
 		{
 			pipe_writer_log(_sink, LL_INFO, "date[{}] of transaction cache block[{}] is different from current date[{}], reinitializing...", pBlock->_block->_date, path.c_str(), curDate);
@@ -1002,6 +1026,10 @@ WtDataWriter::TickBlockPair* WtDataWriter::getTickBlock(WTSContractInfo* ct, uin
 		}
 		pBlock->_block = (RTTickBlock*)pBlock->_file->addr();
 
+		//之前已经封存过的，接着封存，交易日不一致的为0
+		pBlock->_sealed = RTSealHelper::sealed_count(path.c_str(), curDate);
+		pBlock->_discarded = 0;
+
 		if (!isNew &&  pBlock->_block->_date != curDate)
 		{
 			pipe_writer_log(_sink, LL_INFO, "date[{}] of tick cache block[{}] is different from current date[{}], reinitializing...", pBlock->_block->_date, path.c_str(), curDate);
@@ -1304,6 +1332,62 @@ void WtDataWriter::releaseBlock(T* block)
 	block->_lasttime = 0;
 }
 
+template<typename PairType, typename T>
+uint32_t WtDataWriter::sealBlocks(wt_hashmap<std::string, PairType*>& blocks, uint16_t btype)
+{
+	uint32_t chunks = 0;
+	for (auto& v : blocks)
+	{
+		PairType* pBlock = v.second;
+		if (pBlock == NULL)
+			continue;
+
+		for (;;)
+		{
+			std::string filename, rawData;
+			uint32_t uDate = 0;
+			uint32_t start = 0;
+			{
+				SpinLock lock(pBlock->_mutex);
+				if (pBlock->_block == NULL || pBlock->_block->_size < pBlock->_sealed + _seal_window + _seal_chunk)
+					break;
+
+				filename = pBlock->_file->filename();
+				uDate = pBlock->_block->_date;
+				start = pBlock->_sealed;
+				T* items = (T*)((char*)pBlock->_block + sizeof(RTDayBlockHeader));
+				rawData.assign((const char*)(items + start), sizeof(T)*_seal_chunk);
+			}
+
+			//压缩和写文件的时候不占用锁，不影响实时数据写入
+			std::string cmpData = WTSCmpHelper::compress_data(rawData.data(), rawData.size());
+			if (!RTSealHelper::append_chunk(filename.c_str(), btype, uDate, start, _seal_chunk, cmpData))
+			{
+				pipe_writer_log(_sink, LL_ERROR, "Sealing records [{}, {}) of {} failed", start, start + _seal_chunk, filename);
+				break;
+			}
+
+			SpinLock lock(pBlock->_mutex);
+			if (pBlock->_block == NULL || pBlock->_block->_date != uDate || pBlock->_sealed != start)
+				break;
+
+			pBlock->_sealed += _seal_chunk;
+			chunks++;
+
+			//释放的进度比封存晚_seal_lag个分段，读取端在几次封存之间持有的指针不会读到已经释放的页面
+			uint64_t lagCnt = (uint64_t)_seal_chunk * _seal_lag;
+			uint32_t discardTo = (pBlock->_sealed > lagCnt) ? (uint32_t)(pBlock->_sealed - lagCnt) : 0;
+			if (discardTo > pBlock->_discarded)
+			{
+				pBlock->_file->discard(sizeof(RTDayBlockHeader), sizeof(T)*discardTo);
+				pBlock->_discarded = discardTo;
+			}
+		}
+	}
+
+	return chunks;
+}
+
 WtDataWriter::KBlockPair* WtDataWriter::getKlineBlock(WTSContractInfo* ct, WTSKlinePeriod period, bool bAutoCreate /* = true */)
 {
 	if (ct == NULL)
@@ -1598,6 +1682,22 @@ void WtDataWriter::check_loop()
 		if(_proc_thrd != NULL)
 			break;
 
+		if (_seal_chunk > 0)
+		{
+			uint32_t chunks = 0;
+			if (!_disable_tick)
+				chunks += sealBlocks<TickBlockPair, WTSTickStruct>(_rt_ticks_blocks, BT_RT_Ticks);
+			if (!_disable_trans)
+				chunks += sealBlocks<TransBlockPair, WTSTransStruct>(_rt_trans_blocks, BT_RT_Trnsctn);
+			if (!_disable_orddtl)
+				chunks += sealBlocks<OrdDtlBlockPair, WTSOrdDtlStruct>(_rt_orddtl_blocks, BT_RT_OrdDetail);
+			if (!_disable_ordque)
+				chunks += sealBlocks<OrdQueBlockPair, WTSOrdQueStruct>(_rt_ordque_blocks, BT_RT_OrdQueue);
+
+			if (chunks > 0)
+				pipe_writer_log(_sink, LL_DEBUG, "{} chunks of RT data sealed", chunks);
+		}
+
 		uint64_t now = TimeUtils::getLocalTimeNow() / 1000;
 		for (auto it = _rt_ticks_blocks.begin(); it != _rt_ticks_blocks.end(); it++)
 		{
@@ -2137,12 +2237,50 @@ uint32_t WtDataWriter::dump_bars_to_file(WTSContractInfo* ct)
 	return count;
 }
 
+template<typename T>
+void WtDataWriter::updateCatalog(const char* dtype, WTSContractInfo* ct, uint32_t uDate, const T* items, uint32_t count, uint64_t fsize)
+{
+	std::string key = fmtutil::format("{}/{}", dtype, ct->getExchg());
+	auto it = _catalogs.find(key);
+	if (it == _catalogs.end())
+	{
+		HisDataCatalog& catalog = _catalogs[key];
+		if (!catalog.load(HisDataCatalog::catalog_file(_base_dir.c_str(), dtype, ct->getExchg()).c_str()))
+		{
+			//目录文件还不存在，只记录新收盘的数据，不在收盘作业线程里扫描历史文件
+			//已有的历史文件需要用WtDtHelper的build_his_catalog重建，读取方查不到的日期会照常探测文件
+			pipe_writer_log(_sink, LL_WARN, "History data catalog of {} not found, only new files will be cataloged, rebuild it with build_his_catalog", key.c_str());
+		}
+		it = _catalogs.find(key);
+	}
+
+	HisDataCatalog::CatalogItem item;
+	HisDataCatalog::make_item(item, uDate, items, count, fsize, BLOCK_VERSION_CMP_V2);
+	it->second.update(ct->getCode(), item);
+}
+
+void WtDataWriter::saveCatalogs()
+{
+	for (auto& v : _catalogs)
+	{
+		HisDataCatalog& catalog = (HisDataCatalog&)v.second;
+		if (!catalog.is_dirty())
+			continue;
+
+		if (!catalog.save())
+			pipe_writer_log(_sink, LL_ERROR, "Saving history data catalog of {} failed", v.first.c_str());
+	}
+}
+
 void WtDataWriter::proc_loop()
 {
 	while (!_terminated)
 	{
 		if(_proc_que.empty())
 		{
+			//收盘作业一批处理完了再统一保存目录，避免每个代码都重写一次目录文件
+			saveCatalogs();
+
 			StdUniqueLock lock(_proc_mtx);
 			_proc_cond.wait(_proc_mtx);
 			continue;
@@ -2353,21 +2491,127 @@ void WtDataWriter::proc_loop()
 						pipe_writer_log(_sink, LL_INFO, "Transfering tick data of {}...", fullcode.c_str());
 						SpinLock lock(tBlkPair->_mutex);
 
+						//盘中封存过的，先把封存的数据拼回来
+						uint32_t sealed = tBlkPair->_sealed;
+						std::string sealCmp, sealRaw;
+						WTSTickStruct* ticks = tBlkPair->_block->_ticks;
+						if (tBlkPair->_sealed > 0)
+							ticks = RTSealHelper::restore(tBlkPair->_file->filename(), tBlkPair->_block->_date, ticks, tBlkPair->_block->_size, sealed, sealCmp, sealRaw);
+
+						if (ticks == NULL)
+						{
+							//盘中释放的页面已经没有数据了，拼不回来就不能落地，保留实时数据块和封存文件
+							pipe_writer_log(_sink, LL_ERROR, "ClosingTask of tick of {} aborted: restoring sealed data from {} failed", fullcode.c_str(), RTSealHelper::seal_file(tBlkPair->_file->filename()).c_str());
+						}
+						else
+						{
+							for (auto& item : _dumpers)
+							{
+								const char* id = item.first.c_str();
+								IHisDataDumper* dumper = item.second;
+								bool bSucc = dumper->dumpHisTicks(fullcode.c_str(), tBlkPair->_block->_date, ticks, tBlkPair->_block->_size);
+								if (!bSucc)
+								{
+									pipe_writer_log(_sink, LL_ERROR, "ClosingTask of tick of {} on {} via extended dumper {} failed", fullcode.c_str(), tBlkPair->_block->_date, id);
+								}
+							}
+
+							{//////////////////////////////////////////////////////////////////////////
+								//dump tick data to dsb file
+								std::stringstream ss;
+								ss << _base_dir << "his/ticks/" << ct->getExchg() << "/" << tBlkPair->_block->_date << "/";
+								std::string path = ss.str();
+								pipe_writer_log(_sink, LL_INFO, path.c_str());
+								BoostFile::create_directories(ss.str().c_str());
+								std::string filename = fmtutil::format("{}{}.dsb", path, code);
+
+								bool bNew = false;
+								if (!BoostFile::exists(filename.c_str()))
+									bNew = true;
+
+								pipe_writer_log(_sink, LL_INFO, "Openning data storage file: {}", filename.c_str());
+								BoostFile f;
+								if (f.create_new_file(filename.c_str()))
+								{
+									//先压缩数据
+									std::string cmp_data = sealCmp + WTSCmpHelper::compress_data(ticks + sealed, sizeof(WTSTickStruct)*(tBlkPair->_block->_size - sealed));
+
+									BlockHeaderV2 header;
+									strcpy(header._blk_flag, BLK_FLAG);
+									header._type = BT_HIS_Ticks;
+									header._version = BLOCK_VERSION_CMP_V2;
+									header._size = cmp_data.size();
+									f.write_file(&header, sizeof(header));
+
+									f.write_file(cmp_data.c_str(), cmp_data.size());
+									f.close_file();
+
+									updateCatalog("ticks", ct, tBlkPair->_block->_date, ticks, tBlkPair->_block->_size, sizeof(header) + cmp_data.size());
+
+									count += tBlkPair->_block->_size;
+
+									//最后将缓存清空
+									//memset(tBlkPair->_block->_ticks, 0, sizeof(WTSTickStruct)*tBlkPair->_block->_size);
+									tBlkPair->_block->_size = 0;
+
+									//封存文件已经合并到历史文件里了
+									if (tBlkPair->_sealed > 0)
+									{
+										RTSealHelper::remove(tBlkPair->_file->filename());
+										tBlkPair->_sealed = 0;
+										tBlkPair->_discarded = 0;
+									}
+								}
+								else
+								{
+									pipe_writer_log(_sink, LL_ERROR, "ClosingTask of tick failed: openning history data file {} failed", filename.c_str());
+								}
+							}
+						}
+					}
+				}
+
+				if (tBlkPair)
+					releaseBlock<TickBlockPair>(tBlkPair);
+			}
+
+			//转移实时trans数据
+			if (!_disable_trans)
+			{
+				TransBlockPair *tBlkPair = getTransBlock(ct, uDate, false);
+				if (tBlkPair != NULL && tBlkPair->_block->_size > 0)
+				{
+					pipe_writer_log(_sink, LL_INFO, "Transfering transaction data of {}...", fullcode.c_str());
+					SpinLock lock(tBlkPair->_mutex);
+
+					//盘中封存过的，先把封存的数据拼回来
+					uint32_t sealed = tBlkPair->_sealed;
+					std::string sealCmp, sealRaw;
+					WTSTransStruct* trans = tBlkPair->_block->_trans;
+					if (tBlkPair->_sealed > 0)
+						trans = RTSealHelper::restore(tBlkPair->_file->filename(), tBlkPair->_block->_date, trans, tBlkPair->_block->_size, sealed, sealCmp, sealRaw);
+
+					if (trans == NULL)
+					{
+						//盘中释放的页面已经没有数据了，拼不回来就不能落地，保留实时数据块和封存文件
+						pipe_writer_log(_sink, LL_ERROR, "ClosingTask of transaction of {} aborted: restoring sealed data from {} failed", fullcode.c_str(), RTSealHelper::seal_file(tBlkPair->_file->filename()).c_str());
+					}
+					else
+					{
 						for (auto& item : _dumpers)
 						{
 							const char* id = item.first.c_str();
 							IHisDataDumper* dumper = item.second;
-							bool bSucc = dumper->dumpHisTicks(fullcode.c_str(), tBlkPair->_block->_date, tBlkPair->_block->_ticks, tBlkPair->_block->_size);
+							bool bSucc = dumper->dumpHisTrans(fullcode.c_str(), tBlkPair->_block->_date, trans, tBlkPair->_block->_size);
 							if (!bSucc)
 							{
-								pipe_writer_log(_sink, LL_ERROR, "ClosingTask of tick of {} on {} via extended dumper {} failed", fullcode.c_str(), tBlkPair->_block->_date, id);
+								pipe_writer_log(_sink, LL_ERROR, "ClosingTask of transaction of {} on {} via extended dumper {} failed", fullcode.c_str(), tBlkPair->_block->_date, id);
 							}
 						}
 
-						{//////////////////////////////////////////////////////////////////////////
-							//dump tick data to dsb file
+						{
 							std::stringstream ss;
-							ss << _base_dir << "his/ticks/" << ct->getExchg() << "/" << tBlkPair->_block->_date << "/";
+							ss << _base_dir << "his/trans/" << ct->getExchg() << "/" << tBlkPair->_block->_date << "/";
 							std::string path = ss.str();
 							pipe_writer_log(_sink, LL_INFO, path.c_str());
 							BoostFile::create_directories(ss.str().c_str());
@@ -2382,11 +2626,11 @@ void WtDataWriter::proc_loop()
 							if (f.create_new_file(filename.c_str()))
 							{
 								//先压缩数据
-								std::string cmp_data = WTSCmpHelper::compress_data(tBlkPair->_block->_ticks, sizeof(WTSTickStruct)*tBlkPair->_block->_size);
+								std::string cmp_data = sealCmp + WTSCmpHelper::compress_data(trans + sealed, sizeof(WTSTransStruct)*(tBlkPair->_block->_size - sealed));
 
 								BlockHeaderV2 header;
 								strcpy(header._blk_flag, BLK_FLAG);
-								header._type = BT_HIS_Ticks;
+								header._type = BT_HIS_Trnsctn;
 								header._version = BLOCK_VERSION_CMP_V2;
 								header._size = cmp_data.size();
 								f.write_file(&header, sizeof(header));
@@ -2394,86 +2638,30 @@ void WtDataWriter::proc_loop()
 								f.write_file(cmp_data.c_str(), cmp_data.size());
 								f.close_file();
 
+								updateCatalog("trans", ct, tBlkPair->_block->_date, trans, tBlkPair->_block->_size, sizeof(header) + cmp_data.size());
+
 								count += tBlkPair->_block->_size;
 
 								//最后将缓存清空
 								//memset(tBlkPair->_block->_ticks, 0, sizeof(WTSTickStruct)*tBlkPair->_block->_size);
 								tBlkPair->_block->_size = 0;
+
+								//封存文件已经合并到历史文件里了
+								if (tBlkPair->_sealed > 0)
+								{
+									RTSealHelper::remove(tBlkPair->_file->filename());
+									tBlkPair->_sealed = 0;
+									tBlkPair->_discarded = 0;
+								}
 							}
 							else
 							{
-								pipe_writer_log(_sink, LL_ERROR, "ClosingTask of tick failed: openning history data file {} failed", filename.c_str());
+								pipe_writer_log(_sink, LL_ERROR, "ClosingTask of transaction failed: openning history data file {} failed", filename.c_str());
 							}
 						}
 					}
 				}
 
-				if (tBlkPair)
-					releaseBlock<TickBlockPair>(tBlkPair);
-			}
-
-			//转移实时trans数据
-			if (!_disable_trans)
-			{
-				TransBlockPair *tBlkPair = getTransBlock(ct, uDate, false);
-				if (tBlkPair != NULL && tBlkPair->_block->_size > 0)
-				{
-					pipe_writer_log(_sink, LL_INFO, "Transfering transaction data of {}...", fullcode.c_str());
-					SpinLock lock(tBlkPair->_mutex);
-
-					for (auto& item : _dumpers)
-					{
-						const char* id = item.first.c_str();
-						IHisDataDumper* dumper = item.second;
-						bool bSucc = dumper->dumpHisTrans(fullcode.c_str(), tBlkPair->_block->_date, tBlkPair->_block->_trans, tBlkPair->_block->_size);
-						if (!bSucc)
-						{
-							pipe_writer_log(_sink, LL_ERROR, "ClosingTask of transaction of {} on {} via extended dumper {} failed", fullcode.c_str(), tBlkPair->_block->_date, id);
-						}
-					}
-
-					{
-						std::stringstream ss;
-						ss << _base_dir << "his/trans/" << ct->getExchg() << "/" << tBlkPair->_block->_date << "/";
-						std::string path = ss.str();
-						pipe_writer_log(_sink, LL_INFO, path.c_str());
-						BoostFile::create_directories(ss.str().c_str());
-						std::string filename = fmtutil::format("{}{}.dsb", path, code);
-
-						bool bNew = false;
-						if (!BoostFile::exists(filename.c_str()))
-							bNew = true;
-
-						pipe_writer_log(_sink, LL_INFO, "Openning data storage file: {}", filename.c_str());
-						BoostFile f;
-						if (f.create_new_file(filename.c_str()))
-						{
-							//先压缩数据
-							std::string cmp_data = WTSCmpHelper::compress_data(tBlkPair->_block->_trans, sizeof(WTSTransStruct)*tBlkPair->_block->_size);
-
-							BlockHeaderV2 header;
-							strcpy(header._blk_flag, BLK_FLAG);
-							header._type = BT_HIS_Trnsctn;
-							header._version = BLOCK_VERSION_CMP_V2;
-							header._size = cmp_data.size();
-							f.write_file(&header, sizeof(header));
-
-							f.write_file(cmp_data.c_str(), cmp_data.size());
-							f.close_file();
-
-							count += tBlkPair->_block->_size;
-
-							//最后将缓存清空
-							//memset(tBlkPair->_block->_ticks, 0, sizeof(WTSTickStruct)*tBlkPair->_block->_size);
-							tBlkPair->_block->_size = 0;
-						}
-						else
-						{
-							pipe_writer_log(_sink, LL_ERROR, "ClosingTask of transaction failed: openning history data file {} failed", filename.c_str());
-						}
-					}
-				}
-
 				if (tBlkPair)
 					releaseBlock<TransBlockPair>(tBlkPair);
 			}
@@ -2487,55 +2675,80 @@ void WtDataWriter::proc_loop()
 					pipe_writer_log(_sink, LL_INFO, "Transfering order detail data of {}...", fullcode.c_str());
 					SpinLock lock(tBlkPair->_mutex);
 
-					for (auto& item : _dumpers)
+					//盘中封存过的，先把封存的数据拼回来
+					uint32_t sealed = tBlkPair->_sealed;
+					std::string sealCmp, sealRaw;
+					WTSOrdDtlStruct* details = tBlkPair->_block->_details;
+					if (tBlkPair->_sealed > 0)
+						details = RTSealHelper::restore(tBlkPair->_file->filename(), tBlkPair->_block->_date, details, tBlkPair->_block->_size, sealed, sealCmp, sealRaw);
+
+					if (details == NULL)
 					{
-						const char* id = item.first.c_str();
-						IHisDataDumper* dumper = item.second;
-						bool bSucc = dumper->dumpHisOrdDtl(fullcode.c_str(), tBlkPair->_block->_date, tBlkPair->_block->_details, tBlkPair->_block->_size);
-						if (!bSucc)
+						//盘中释放的页面已经没有数据了，拼不回来就不能落地，保留实时数据块和封存文件
+						pipe_writer_log(_sink, LL_ERROR, "ClosingTask of order detail of {} aborted: restoring sealed data from {} failed", fullcode.c_str(), RTSealHelper::seal_file(tBlkPair->_file->filename()).c_str());
+					}
+					else
+					{
+						for (auto& item : _dumpers)
 						{
-							pipe_writer_log(_sink, LL_ERROR, "ClosingTask of order details of {} on {} via extended dumper {} failed", fullcode.c_str(), tBlkPair->_block->_date, id);
+							const char* id = item.first.c_str();
+							IHisDataDumper* dumper = item.second;
+							bool bSucc = dumper->dumpHisOrdDtl(fullcode.c_str(), tBlkPair->_block->_date, details, tBlkPair->_block->_size);
+							if (!bSucc)
+							{
+								pipe_writer_log(_sink, LL_ERROR, "ClosingTask of order details of {} on {} via extended dumper {} failed", fullcode.c_str(), tBlkPair->_block->_date, id);
+							}
 						}
-					}
 
-					{
-						std::stringstream ss;
-						ss << _base_dir << "his/orders/" << ct->getExchg() << "/" << tBlkPair->_block->_date << "/";
-						std::string path = ss.str();
-						pipe_writer_log(_sink, LL_INFO, path.c_str());
-						BoostFile::create_directories(ss.str().c_str());
-						std::string filename = fmtutil::format("{}{}.dsb", path, code);
-
-						bool bNew = false;
-						if (!BoostFile::exists(filename.c_str()))
-							bNew = true;
-
-						pipe_writer_log(_sink, LL_INFO, "Openning data storage file: {}", filename.c_str());
-						BoostFile f;
-						if (f.create_new_file(filename.c_str()))
 						{
-							//先压缩数据
-							std::string cmp_data = WTSCmpHelper::compress_data(tBlkPair->_block->_details, sizeof(WTSOrdDtlStruct)*tBlkPair->_block->_size);
+							std::stringstream ss;
+							ss << _base_dir << "his/orders/" << ct->getExchg() << "/" << tBlkPair->_block->_date << "/";
+							std::string path = ss.str();
+							pipe_writer_log(_sink, LL_INFO, path.c_str());
+							BoostFile::create_directories(ss.str().c_str());
+							std::string filename = fmtutil::format("{}{}.dsb", path, code);
+
+							bool bNew = false;
+							if (!BoostFile::exists(filename.c_str()))
+								bNew = true;
+
+							pipe_writer_log(_sink, LL_INFO, "Openning data storage file: {}", filename.c_str());
+							BoostFile f;
+							if (f.create_new_file(filename.c_str()))
+							{
+								//先压缩数据
+								std::string cmp_data = sealCmp + WTSCmpHelper::compress_data(details + sealed, sizeof(WTSOrdDtlStruct)*(tBlkPair->_block->_size - sealed));
+
+								BlockHeaderV2 header;
+								strcpy(header._blk_flag, BLK_FLAG);
+								header._type = BT_HIS_OrdDetail;
+								header._version = BLOCK_VERSION_CMP_V2;
+								header._size = cmp_data.size();
+								f.write_file(&header, sizeof(header));
 
-							BlockHeaderV2 header;
-							strcpy(header._blk_flag, BLK_FLAG);
-							header._type = BT_HIS_OrdDetail;
-							header._version = BLOCK_VERSION_CMP_V2;
-							header._size = cmp_data.size();
-							f.write_file(&header, sizeof(header));
+								f.write_file(cmp_data.c_str(), cmp_data.size());
+								f.close_file();
 
-							f.write_file(cmp_data.c_str(), cmp_data.size());
-							f.close_file();
+								updateCatalog("orders", ct, tBlkPair->_block->_date, details, tBlkPair->_block->_size, sizeof(header) + cmp_data.size());
 
-							count += tBlkPair->_block->_size;
+								count += tBlkPair->_block->_size;
 
-							//最后将缓存清空
-							//memset(tBlkPair->_block->_ticks, 0, sizeof(WTSTickStruct)*tBlkPair->_block->_size);
-							tBlkPair->_block->_size = 0;
-						}
-						else
-						{
-							pipe_writer_log(_sink, LL_ERROR, "ClosingTask of order detail failed: openning history data file {} failed", filename.c_str());
+								//最后将缓存清空
+								//memset(tBlkPair->_block->_ticks, 0, sizeof(WTSTickStruct)*tBlkPair->_block->_size);
+								tBlkPair->_block->_size = 0;
+
+								//封存文件已经合并到历史文件里了
+								if (tBlkPair->_sealed > 0)
+								{
+									RTSealHelper::remove(tBlkPair->_file->filename());
+									tBlkPair->_sealed = 0;
+									tBlkPair->_discarded = 0;
+								}
+							}
+							else
+							{
+								pipe_writer_log(_sink, LL_ERROR, "ClosingTask of order detail failed: openning history data file {} failed", filename.c_str());
+							}
 						}
 					}
 				}
@@ -2553,55 +2766,80 @@ void WtDataWriter::proc_loop()
 					pipe_writer_log(_sink, LL_INFO, "Transfering order queue data of {}...", fullcode.c_str());
 					SpinLock lock(tBlkPair->_mutex);
 
-					for (auto& item : _dumpers)
+					//盘中封存过的，先把封存的数据拼回来
+					uint32_t sealed = tBlkPair->_sealed;
+					std::string sealCmp, sealRaw;
+					WTSOrdQueStruct* queues = tBlkPair->_block->_queues;
+					if (tBlkPair->_sealed > 0)
+						queues = RTSealHelper::restore(tBlkPair->_file->filename(), tBlkPair->_block->_date, queues, tBlkPair->_block->_size, sealed, sealCmp, sealRaw);
+
+					if (queues == NULL)
 					{
-						const char* id = item.first.c_str();
-						IHisDataDumper* dumper = item.second;
-						bool bSucc = dumper->dumpHisOrdQue(fullcode.c_str(), tBlkPair->_block->_date, tBlkPair->_block->_queues, tBlkPair->_block->_size);
-						if (!bSucc)
+						//盘中释放的页面已经没有数据了，拼不回来就不能落地，保留实时数据块和封存文件
+						pipe_writer_log(_sink, LL_ERROR, "ClosingTask of order queue of {} aborted: restoring sealed data from {} failed", fullcode.c_str(), RTSealHelper::seal_file(tBlkPair->_file->filename()).c_str());
+					}
+					else
+					{
+						for (auto& item : _dumpers)
 						{
-							pipe_writer_log(_sink, LL_ERROR, "ClosingTask of order queues of {} on {} via extended dumper {} failed", fullcode.c_str(), tBlkPair->_block->_date, id);
+							const char* id = item.first.c_str();
+							IHisDataDumper* dumper = item.second;
+							bool bSucc = dumper->dumpHisOrdQue(fullcode.c_str(), tBlkPair->_block->_date, queues, tBlkPair->_block->_size);
+							if (!bSucc)
+							{
+								pipe_writer_log(_sink, LL_ERROR, "ClosingTask of order queues of {} on {} via extended dumper {} failed", fullcode.c_str(), tBlkPair->_block->_date, id);
+							}
 						}
-					}
 
-					{
-						std::stringstream ss;
-						ss << _base_dir << "his/queue/" << ct->getExchg() << "/" << tBlkPair->_block->_date << "/";
-						std::string path = ss.str();
-						pipe_writer_log(_sink, LL_INFO, path.c_str());
-						BoostFile::create_directories(ss.str().c_str());
-						std::string filename = fmtutil::format("{}{}.dsb", path, code);
-
-						bool bNew = false;
-						if (!BoostFile::exists(filename.c_str()))
-							bNew = true;
-
-						pipe_writer_log(_sink, LL_INFO, "Openning data storage file: {}", filename.c_str());
-						BoostFile f;
-						if (f.create_new_file(filename.c_str()))
 						{
-							//先压缩数据
-							std::string cmp_data = WTSCmpHelper::compress_data(tBlkPair->_block->_queues, sizeof(WTSOrdQueStruct)*tBlkPair->_block->_size);
+							std::stringstream ss;
+							ss << _base_dir << "his/queue/" << ct->getExchg() << "/" << tBlkPair->_block->_date << "/";
+							std::string path = ss.str();
+							pipe_writer_log(_sink, LL_INFO, path.c_str());
+							BoostFile::create_directories(ss.str().c_str());
+							std::string filename = fmtutil::format("{}{}.dsb", path, code);
+
+							bool bNew = false;
+							if (!BoostFile::exists(filename.c_str()))
+								bNew = true;
 
-							BlockHeaderV2 header;
-							strcpy(header._blk_flag, BLK_FLAG);
-							header._type = BT_HIS_OrdQueue;
-							header._version = BLOCK_VERSION_CMP_V2;
-							header._size = cmp_data.size();
-							f.write_file(&header, sizeof(header));
+							pipe_writer_log(_sink, LL_INFO, "Openning data storage file: {}", filename.c_str());
+							BoostFile f;
+							if (f.create_new_file(filename.c_str()))
+							{
+								//先压缩数据
+								std::string cmp_data = sealCmp + WTSCmpHelper::compress_data(queues + sealed, sizeof(WTSOrdQueStruct)*(tBlkPair->_block->_size - sealed));
 
-							f.write_file(cmp_data.c_str(), cmp_data.size());
-							f.close_file();
+								BlockHeaderV2 header;
+								strcpy(header._blk_flag, BLK_FLAG);
+								header._type = BT_HIS_OrdQueue;
+								header._version = BLOCK_VERSION_CMP_V2;
+								header._size = cmp_data.size();
+								f.write_file(&header, sizeof(header));
 
-							count += tBlkPair->_block->_size;
+								f.write_file(cmp_data.c_str(), cmp_data.size());
+								f.close_file();
 
-							//最后将缓存清空
-							//memset(tBlkPair->_block->_ticks, 0, sizeof(WTSTickStruct)*tBlkPair->_block->_size);
-							tBlkPair->_block->_size = 0;
-						}
-						else
-						{
-							pipe_writer_log(_sink, LL_ERROR, "ClosingTask of order queue failed: openning history data file {} failed", filename.c_str());
+								updateCatalog("queue", ct, tBlkPair->_block->_date, queues, tBlkPair->_block->_size, sizeof(header) + cmp_data.size());
+
+								count += tBlkPair->_block->_size;
+
+								//最后将缓存清空
+								//memset(tBlkPair->_block->_ticks, 0, sizeof(WTSTickStruct)*tBlkPair->_block->_size);
+								tBlkPair->_block->_size = 0;
+
+								//封存文件已经合并到历史文件里了
+								if (tBlkPair->_sealed > 0)
+								{
+									RTSealHelper::remove(tBlkPair->_file->filename());
+									tBlkPair->_sealed = 0;
+									tBlkPair->_discarded = 0;
+								}
+							}
+							else
+							{
+								pipe_writer_log(_sink, LL_ERROR, "ClosingTask of order queue failed: openning history data file {} failed", filename.c_str());
+							}
 						}
 					}
 				}
@@ -1,5 +1,6 @@
 ﻿#pragma once
 #include "DataDefine.h"
+#include "HisDataCatalog.h"
 
 #include "../Includes/FasterDefs.h"
 #include "../Includes/IDataWriter.h"
@@ -37,6 +38,15 @@ private:
 
 	uint32_t  dump_bars_via_dumper(WTSContractInfo* ct);
 
+	/*
+	 *	收盘作业写入历史数据文件以后，更新对应的数据目录
+	 */
+	template<typename T>
+	void	updateCatalog(const char* dtype, WTSContractInfo* ct, uint32_t uDate, const T* items, uint32_t count, uint64_t fsize);
+
+	//保存有改动的数据目录，处理队列空闲的时候调用
+	void	saveCatalogs();
+
 private:
 	bool	dump_day_data(WTSContractInfo* ct, WTSBarStruct* newBar);
 
@@ -91,6 +101,8 @@ private:
 		BoostMFPtr		_file;
 		SpinMutex		_mutex;
 		uint64_t		_lasttime;
+		uint32_t		_sealed;		//已封存的条数
+		uint32_t		_discarded;	//已释放的条数
 
 		std::shared_ptr< std::ofstream>	_fstream;
 
@@ -98,6 +110,8 @@ private:
 		{
 			_block = NULL;
 			_file = NULL;
+			_sealed = 0;
+			_discarded = 0;
 			_fstream = NULL;
 			_lasttime = 0;
 		}
@@ -110,11 +124,15 @@ private:
 		BoostMFPtr		_file;
 		SpinMutex		_mutex;
 		uint64_t		_lasttime;
+		uint32_t		_sealed;		//已封存的条数
+		uint32_t		_discarded;	//已释放的条数
 
 		_TransBlockPair()
 		{
 			_block = NULL;
 			_file = NULL;
+			_sealed = 0;
+			_discarded = 0;
 			_lasttime = 0;
 		}
 	} TransBlockPair;
@@ -126,11 +144,15 @@ private:
 		BoostMFPtr		_file;
 		SpinMutex		_mutex;
 		uint64_t		_lasttime;
+		uint32_t		_sealed;		//已封存的条数
+		uint32_t		_discarded;	//已释放的条数
 
 		_OdeDtlBlockPair()
 		{
 			_block = NULL;
 			_file = NULL;
+			_sealed = 0;
+			_discarded = 0;
 			_lasttime = 0;
 		}
 	} OrdDtlBlockPair;
@@ -142,11 +164,15 @@ private:
 		BoostMFPtr		_file;
 		SpinMutex		_mutex;
 		uint64_t		_lasttime;
+		uint32_t		_sealed;		//已封存的条数
+		uint32_t		_discarded;	//已释放的条数
 
 		_OdeQueBlockPair()
 		{
 			_block = NULL;
 			_file = NULL;
+			_sealed = 0;
+			_discarded = 0;
 			_lasttime = 0;
 		}
 	} OrdQueBlockPair;
@@ -216,9 +242,21 @@ private:
 	 *	分钟线价格模式，0-常规模式，1-将买卖价也记录下来，这个设计时只针对期权这种不活跃的品种
 	 */
 	uint32_t		_min_price_mode;
+
+	/*
+	 *	盘中封存的分段条数，0为不封存
+	 *	实时数据块最新的_seal_window条数据一直保持不压缩
+	 *	封存以后的页面要落后_seal_lag个分段才释放，读取端跨几次封存持有的实时数据块指针仍然有效
+	 */
+	uint32_t		_seal_chunk;
+	uint32_t		_seal_window;
+	uint32_t		_seal_lag;
 	
 	std::map<std::string, uint32_t> _proc_date;
 
+	//历史数据目录，key为dtype/exchg，只在收盘作业线程里访问
+	wt_hashmap<std::string, HisDataCatalog>	_catalogs;
+
 private:
 	void loadCache();
 
@@ -238,6 +276,12 @@ private:
 	template<typename T>
 	void	releaseBlock(T* block);
 
+	/*
+	 *	盘中封存实时数据块里较早的数据，检查线程里调用
+	 */
+	template<typename PairType, typename T>
+	uint32_t	sealBlocks(wt_hashmap<std::string, PairType*>& blocks, uint16_t btype);
+
 	void pushTask(const TaskInfo& task);
 };
 
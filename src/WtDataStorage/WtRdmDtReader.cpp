@@ -166,6 +166,48 @@ void WtRdmDtReader::init(WTSVariant* cfg, IRdmDtReaderSink* sink)
 }
 
 
+const HisDataCatalog* WtRdmDtReader::getCatalog(const char* dtype, const char* exchg)
+{
+	std::string key = fmt::format("{}/{}", dtype, exchg);
+	auto it = _catalogs.find(key);
+	if (it == _catalogs.end())
+	{
+		HisDataCatalog& catalog = _catalogs[key];
+		catalog.load(HisDataCatalog::catalog_file(_base_dir.c_str(), dtype, exchg).c_str());
+		it = _catalogs.find(key);
+	}
+	else if (it->second.is_outdated())
+	{
+		HisDataCatalog& catalog = (HisDataCatalog&)it->second;
+		catalog.load(HisDataCatalog::catalog_file(_base_dir.c_str(), dtype, exchg).c_str());
+		pipe_rdmreader_log(_sink, LL_INFO, "History data catalog of {} reloaded", key.c_str());
+	}
+
+	if (it->second.is_empty())
+		return NULL;
+
+	return &it->second;
+}
+
+bool WtRdmDtReader::checkCatalog(const char* dtype, const char* exchg, const char* code, uint32_t uDate, uint64_t stime, uint64_t etime, bool& bConfirmed)
+{
+	bConfirmed = false;
+	const HisDataCatalog* catalog = getCatalog(dtype, exchg);
+	if (catalog == NULL)
+		return true;
+
+	//目录里没有这一天，可能是目录还没更新，交给调用方探测文件
+	const HisDataCatalog::CatalogItem* catItem = catalog->find(code, uDate);
+	if (catItem == NULL)
+		return true;
+
+	if (!catItem->overlap(stime, etime))
+		return false;
+
+	bConfirmed = true;
+	return true;
+}
+
 bool WtRdmDtReader::loadStkAdjFactorsFromFile(const char* adjfile)
 {
 	if (!StdFile::exists(adjfile))
@@ -353,7 +395,8 @@ WTSTickSlice* WtRdmDtReader::readTickSliceByDate(const char* stdCode, uint32_t u
 		StdUniqueLock lock(*tPair->_mtx);
 		RTTickBlock* tBlock = tPair->_block;
 		
-		WTSTickSlice* slice = WTSTickSlice::create(stdCode, tBlock->_ticks, tBlock->_size);
+		//封存过的数据从封存文件读取
+		WTSTickSlice* slice = tPair->_seal.append_to(WTSTickSlice::create(stdCode), stdCode, tBlock->_ticks, 0, tBlock->_size);
 		return slice;
 	}
 
@@ -394,6 +437,9 @@ WTSTickSlice* WtRdmDtReader::readTickSliceByRange(const char* stdCode, uint64_t
 	sTick.action_date = lDate;
 	sTick.action_time = lTime * 100000 + lSecs;
 	
+	//有目录的话先查目录，目录里有记录的交易日不用再探测文件
+	const HisDataCatalog* catalog = getCatalog("ticks", cInfo._exchg);
+
 	uint32_t nowTDate = beginTDate;
 	while(nowTDate < curTDate)
 	{
@@ -415,15 +461,37 @@ WTSTickSlice* WtRdmDtReader::readTickSliceByRange(const char* stdCode, uint64_t
 		
 		std::string key = fmt::format("{}-{}", stdCode, nowTDate);
 
+		//目录里能查到的，直接确定要读的文件，时间不重叠就跳过
+		//目录里查不到的，目录可能还没更新，照常探测文件
+		const char* hitCode = NULL;
+		bool bSkip = false;
+		if (catalog != NULL)
+		{
+			const HisDataCatalog::CatalogItem* catItem = NULL;
+			if (!hotCode.empty() && (catItem = catalog->find(hotCode.c_str(), nowTDate)) != NULL)
+				hitCode = hotCode.c_str();
+			else if ((catItem = catalog->find(curCode.c_str(), nowTDate)) != NULL)
+				hitCode = curCode.c_str();
+
+			if (catItem != NULL)
+				bSkip = !catItem->overlap(stime, etime);
+		}
+
 		auto it = _his_tick_map.find(key);
-		bool bHasHisTick = (it != _his_tick_map.end());
-		if(!bHasHisTick)
+		bool bHasHisTick = !bSkip && (it != _his_tick_map.end());
+		if(!bHasHisTick && !bSkip)
 		{
 			for(;;)
 			{
 				std::string filename;
 				bool bHitHot = false;
-				if (!hotCode.empty())
+				if (hitCode != NULL)
+				{
+					//目录已经确认了文件，不用再探测
+					filename = fmtutil::format("{}his/ticks/{}/{}/{}.dsb", _base_dir, cInfo._exchg, nowTDate, hitCode);
+					bHitHot = true;
+				}
+				else if (!hotCode.empty())
 				{
 					std::stringstream ss;
 					ss << _base_dir << "his/ticks/" << cInfo._exchg << "/" << nowTDate << "/" << hotCode << ".dsb";
@@ -558,19 +626,19 @@ WTSTickSlice* WtRdmDtReader::readTickSliceByRange(const char* stdCode, uint64_t
 			eTick.action_time = sInfo->getCloseTime() * 100000 + 59999;
 		}
 
-		WTSTickStruct* pTick = std::lower_bound(tBlock->_ticks, tBlock->_ticks + (tBlock->_size - 1), eTick, [](const WTSTickStruct& a, const WTSTickStruct& b) {
+		//封存过的数据从封存文件读取
+		RTSealReader<WTSTickStruct>& seal = tPair->_seal;
+		std::size_t eIdx = seal.lower_bound(tBlock->_ticks, 0, tBlock->_size - 1, eTick, [](const WTSTickStruct& a, const WTSTickStruct& b) {
 			if (a.action_date != b.action_date)
 				return a.action_date < b.action_date;
 			else
 				return a.action_time < b.action_time;
 		});
-
-		std::size_t eIdx = pTick - tBlock->_ticks;
+		WTSTickStruct* pTick = seal.at(tBlock->_ticks, (uint32_t)eIdx);
 
 		//如果光标定位的tick时间比目标时间大, 则全部回退一个
 		if (pTick->action_date > eTick.action_date || pTick->action_time > eTick.action_time)
 		{
-			pTick--;
 			eIdx--;
 		}
 
@@ -579,22 +647,20 @@ WTSTickSlice* WtRdmDtReader::readTickSliceByRange(const char* stdCode, uint64_t
 			//如果开始的交易日和当前的交易日不一致，则返回全部的tick数据
 			//WTSTickSlice* slice = WTSTickSlice::create(stdCode, tBlock->_ticks, eIdx + 1);
 			//ayTicks->append(slice, false);
-			slice->appendBlock(tBlock->_ticks, eIdx + 1);
+			seal.append_to(slice, stdCode, tBlock->_ticks, 0, (uint32_t)eIdx + 1);
 		}
 		else
 		{
 			//如果交易日相同，则查找起始的位置
-			pTick = std::lower_bound(tBlock->_ticks, tBlock->_ticks + eIdx, sTick, [](const WTSTickStruct& a, const WTSTickStruct& b) {
+			std::size_t sIdx = seal.lower_bound(tBlock->_ticks, 0, (uint32_t)eIdx, sTick, [](const WTSTickStruct& a, const WTSTickStruct& b) {
 				if (a.action_date != b.action_date)
 					return a.action_date < b.action_date;
 				else
 					return a.action_time < b.action_time;
 			});
-
-			std::size_t sIdx = pTick - tBlock->_ticks;
 			//WTSTickSlice* slice = WTSTickSlice::create(stdCode, tBlock->_ticks + sIdx, eIdx - sIdx + 1);
 			//ayTicks->append(slice, false);
-			slice->appendBlock(tBlock->_ticks + sIdx, eIdx - sIdx + 1);
+			seal.append_to(slice, stdCode, tBlock->_ticks, (uint32_t)sIdx, (uint32_t)(eIdx - sIdx + 1));
 		}
 		break;
 	}
@@ -651,40 +717,38 @@ WTSOrdQueSlice* WtRdmDtReader::readOrdQueSliceByRange(const char* stdCode, uint6
 
 		RTOrdQueBlock* rtBlock = tPair->_block;
 
-		WTSOrdQueStruct* pItem = std::lower_bound(rtBlock->_queues, rtBlock->_queues + (rtBlock->_size - 1), eTick, [](const WTSOrdQueStruct& a, const WTSOrdQueStruct& b) {
+		//封存过的数据从封存文件读取
+		RTSealReader<WTSOrdQueStruct>& seal = tPair->_seal;
+		std::size_t eIdx = seal.lower_bound(rtBlock->_queues, 0, rtBlock->_size - 1, eTick, [](const WTSOrdQueStruct& a, const WTSOrdQueStruct& b) {
 			if (a.action_date != b.action_date)
 				return a.action_date < b.action_date;
 			else
 				return a.action_time < b.action_time;
 		});
-
-		std::size_t eIdx = pItem - rtBlock->_queues;
+		WTSOrdQueStruct* pItem = seal.at(rtBlock->_queues, (uint32_t)eIdx);
 
 		//如果光标定位的tick时间比目标时间打, 则全部回退一个
 		if (pItem->action_date > eTick.action_date || pItem->action_time > eTick.action_time)
 		{
-			pItem--;
 			eIdx--;
 		}
 
 		if (beginTDate != endTDate)
 		{
 			//如果开始的交易日和当前的交易日不一致，则返回全部的tick数据
-			WTSOrdQueSlice* slice = WTSOrdQueSlice::create(stdCode, rtBlock->_queues, eIdx + 1);
+			WTSOrdQueSlice* slice = seal.append_to<WTSOrdQueSlice>(NULL, stdCode, rtBlock->_queues, 0, (uint32_t)eIdx + 1);
 			return slice;
 		}
 		else
 		{
 			//如果交易日相同，则查找起始的位置
-			pItem = std::lower_bound(rtBlock->_queues, rtBlock->_queues + eIdx, sTick, [](const WTSOrdQueStruct& a, const WTSOrdQueStruct& b) {
+			std::size_t sIdx = seal.lower_bound(rtBlock->_queues, 0, (uint32_t)eIdx, sTick, [](const WTSOrdQueStruct& a, const WTSOrdQueStruct& b) {
 				if (a.action_date != b.action_date)
 					return a.action_date < b.action_date;
 				else
 					return a.action_time < b.action_time;
 			});
-
-			std::size_t sIdx = pItem - rtBlock->_queues;
-			WTSOrdQueSlice* slice = WTSOrdQueSlice::create(stdCode, rtBlock->_queues + sIdx, eIdx - sIdx + 1);
+			WTSOrdQueSlice* slice = seal.append_to<WTSOrdQueSlice>(NULL, stdCode, rtBlock->_queues, (uint32_t)sIdx, (uint32_t)(eIdx - sIdx + 1));
 			return slice;
 		}
 	}
@@ -692,13 +756,18 @@ WTSOrdQueSlice* WtRdmDtReader::readOrdQueSliceByRange(const char* stdCode, uint6
 	{
 		std::string key = fmt::format("{}-{}", stdCode, endTDate);
 
+		//先查目录，时间不重叠就不用再探测和读取文件了
+		bool bConfirmed = false;
+		if (!checkCatalog("queue", cInfo._exchg, curCode.c_str(), endTDate, stime, etime, bConfirmed))
+			return NULL;
+
 		auto it = _his_ordque_map.find(key);
 		if (it == _his_ordque_map.end())
 		{
 			std::stringstream ss;
 			ss << _base_dir << "his/queue/" << cInfo._exchg << "/" << endTDate << "/" << curCode << ".dsb";
 			std::string filename = ss.str();
-			if (!StdFile::exists(filename.c_str()))
+			if (!bConfirmed && !StdFile::exists(filename.c_str()))
 				return NULL;
 
 			HisOrdQueBlockPair& hisBlkPair = _his_ordque_map[key];
@@ -826,40 +895,38 @@ WTSOrdDtlSlice* WtRdmDtReader::readOrdDtlSliceByRange(const char* stdCode, uint6
 
 		RTOrdDtlBlock* rtBlock = tPair->_block;
 
-		WTSOrdDtlStruct* pItem = std::lower_bound(rtBlock->_details, rtBlock->_details + (rtBlock->_size - 1), eTick, [](const WTSOrdDtlStruct& a, const WTSOrdDtlStruct& b) {
+		//封存过的数据从封存文件读取
+		RTSealReader<WTSOrdDtlStruct>& seal = tPair->_seal;
+		std::size_t eIdx = seal.lower_bound(rtBlock->_details, 0, rtBlock->_size - 1, eTick, [](const WTSOrdDtlStruct& a, const WTSOrdDtlStruct& b) {
 			if (a.action_date != b.action_date)
 				return a.action_date < b.action_date;
 			else
 				return a.action_time < b.action_time;
 		});
-
-		std::size_t eIdx = pItem - rtBlock->_details;
+		WTSOrdDtlStruct* pItem = seal.at(rtBlock->_details, (uint32_t)eIdx);
 
 		//如果光标定位的tick时间比目标时间打, 则全部回退一个
 		if (pItem->action_date > eTick.action_date || pItem->action_time > eTick.action_time)
 		{
-			pItem--;
 			eIdx--;
 		}
 
 		if (beginTDate != endTDate)
 		{
 			//如果开始的交易日和当前的交易日不一致，则返回全部的tick数据
-			WTSOrdDtlSlice* slice = WTSOrdDtlSlice::create(stdCode, rtBlock->_details, eIdx + 1);
+			WTSOrdDtlSlice* slice = seal.append_to<WTSOrdDtlSlice>(NULL, stdCode, rtBlock->_details, 0, (uint32_t)eIdx + 1);
 			return slice;
 		}
 		else
 		{
 			//如果交易日相同，则查找起始的位置
-			pItem = std::lower_bound(rtBlock->_details, rtBlock->_details + eIdx, sTick, [](const WTSOrdDtlStruct& a, const WTSOrdDtlStruct& b) {
+			std::size_t sIdx = seal.lower_bound(rtBlock->_details, 0, (uint32_t)eIdx, sTick, [](const WTSOrdDtlStruct& a, const WTSOrdDtlStruct& b) {
 				if (a.action_date != b.action_date)
 					return a.action_date < b.action_date;
 				else
 					return a.action_time < b.action_time;
 			});
-
-			std::size_t sIdx = pItem - rtBlock->_details;
-			WTSOrdDtlSlice* slice = WTSOrdDtlSlice::create(stdCode, rtBlock->_details + sIdx, eIdx - sIdx + 1);
+			WTSOrdDtlSlice* slice = seal.append_to<WTSOrdDtlSlice>(NULL, stdCode, rtBlock->_details, (uint32_t)sIdx, (uint32_t)(eIdx - sIdx + 1));
 			return slice;
 		}
 	}
@@ -867,13 +934,18 @@ WTSOrdDtlSlice* WtRdmDtReader::readOrdDtlSliceByRange(const char* stdCode, uint6
 	{
 		std::string key = fmt::format("{}-{}", stdCode, endTDate);
 
+		//先查目录，时间不重叠就不用再探测和读取文件了
+		bool bConfirmed = false;
+		if (!checkCatalog("orders", cInfo._exchg, curCode.c_str(), endTDate, stime, etime, bConfirmed))
+			return NULL;
+
 		auto it = _his_ordque_map.find(key);
 		if (it == _his_ordque_map.end())
 		{
 			std::stringstream ss;
 			ss << _base_dir << "his/orders/" << cInfo._exchg << "/" << endTDate << "/" << curCode << ".dsb";
 			std::string filename = ss.str();
-			if (!StdFile::exists(filename.c_str()))
+			if (!bConfirmed && !StdFile::exists(filename.c_str()))
 				return NULL;
 
 			HisOrdDtlBlockPair& hisBlkPair = _his_orddtl_map[key];
@@ -1000,40 +1072,38 @@ WTSTransSlice* WtRdmDtReader::readTransSliceByRange(const char* stdCode, uint64_
 
 		RTTransBlock* rtBlock = tPair->_block;
 
-		WTSTransStruct* pItem = std::lower_bound(rtBlock->_trans, rtBlock->_trans + (rtBlock->_size - 1), eTick, [](const WTSTransStruct& a, const WTSTransStruct& b) {
+		//封存过的数据从封存文件读取
+		RTSealReader<WTSTransStruct>& seal = tPair->_seal;
+		std::size_t eIdx = seal.lower_bound(rtBlock->_trans, 0, rtBlock->_size - 1, eTick, [](const WTSTransStruct& a, const WTSTransStruct& b) {
 			if (a.action_date != b.action_date)
 				return a.action_date < b.action_date;
 			else
 				return a.action_time < b.action_time;
 		});
-
-		std::size_t eIdx = pItem - rtBlock->_trans;
+		WTSTransStruct* pItem = seal.at(rtBlock->_trans, (uint32_t)eIdx);
 
 		//如果光标定位的tick时间比目标时间打, 则全部回退一个
 		if (pItem->action_date > eTick.action_date || pItem->action_time > eTick.action_time)
 		{
-			pItem--;
 			eIdx--;
 		}
 
 		if (beginTDate != endTDate)
 		{
 			//如果开始的交易日和当前的交易日不一致，则返回全部的tick数据
-			WTSTransSlice* slice = WTSTransSlice::create(stdCode, rtBlock->_trans, eIdx + 1);
+			WTSTransSlice* slice = seal.append_to<WTSTransSlice>(NULL, stdCode, rtBlock->_trans, 0, (uint32_t)eIdx + 1);
 			return slice;
 		}
 		else
 		{
 			//如果交易日相同，则查找起始的位置
-			pItem = std::lower_bound(rtBlock->_trans, rtBlock->_trans + eIdx, sTick, [](const WTSTransStruct& a, const WTSTransStruct& b) {
+			std::size_t sIdx = seal.lower_bound(rtBlock->_trans, 0, (uint32_t)eIdx, sTick, [](const WTSTransStruct& a, const WTSTransStruct& b) {
 				if (a.action_date != b.action_date)
 					return a.action_date < b.action_date;
 				else
 					return a.action_time < b.action_time;
 			});
-
-			std::size_t sIdx = pItem - rtBlock->_trans;
-			WTSTransSlice* slice = WTSTransSlice::create(stdCode, rtBlock->_trans + sIdx, eIdx - sIdx + 1);
+			WTSTransSlice* slice = seal.append_to<WTSTransSlice>(NULL, stdCode, rtBlock->_trans, (uint32_t)sIdx, (uint32_t)(eIdx - sIdx + 1));
 			return slice;
 		}
 	}
@@ -1041,13 +1111,18 @@ WTSTransSlice* WtRdmDtReader::readTransSliceByRange(const char* stdCode, uint64_
 	{
 		std::string key = fmt::format("{}-{}", stdCode, endTDate);
 
+		//先查目录，时间不重叠就不用再探测和读取文件了
+		bool bConfirmed = false;
+		if (!checkCatalog("trans", cInfo._exchg, curCode.c_str(), endTDate, stime, etime, bConfirmed))
+			return NULL;
+
 		auto it = _his_ordque_map.find(key);
 		if (it == _his_ordque_map.end())
 		{
 			std::stringstream ss;
 			ss << _base_dir << "his/trans/" << cInfo._exchg << "/" << endTDate << "/" << curCode << ".dsb";
 			std::string filename = ss.str();
-			if (!StdFile::exists(filename.c_str()))
+			if (!bConfirmed && !StdFile::exists(filename.c_str()))
 				return NULL;
 
 			HisTransBlockPair& hisBlkPair = _his_trans_map[key];
@@ -2025,6 +2100,9 @@ WtRdmDtReader::TickBlockPair* WtRdmDtReader::getRTTickBlock(const char* exchg, c
 		block._last_cap = block._block->_capacity;
 	}
 
+	//盘中封存的进度
+	block._seal.refresh(path.c_str(), block._block->_date, block._block->_size);
+
 	block._last_time = TimeUtils::getLocalTimeNow();
 	return &block;
 }
@@ -2065,6 +2143,9 @@ WtRdmDtReader::OrdDtlBlockPair* WtRdmDtReader::getRTOrdDtlBlock(const char* exch
 		block._last_cap = block._block->_capacity;
 	}
 
+	//盘中封存的进度
+	block._seal.refresh(path.c_str(), block._block->_date, block._block->_size);
+
 	block._last_time = TimeUtils::getLocalTimeNow();
 	return &block;
 }
@@ -2105,6 +2186,9 @@ WtRdmDtReader::OrdQueBlockPair* WtRdmDtReader::getRTOrdQueBlock(const char* exch
 		block._last_cap = block._block->_capacity;
 	}
 
+	//盘中封存的进度
+	block._seal.refresh(path.c_str(), block._block->_date, block._block->_size);
+
 	block._last_time = TimeUtils::getLocalTimeNow();
 	return &block;
 }
@@ -2145,6 +2229,9 @@ WtRdmDtReader::TransBlockPair* WtRdmDtReader::getRTTransBlock(const char* exchg,
 		block._last_cap = block._block->_capacity;
 	}
 
+	//盘中封存的进度
+	block._seal.refresh(path.c_str(), block._block->_date, block._block->_size);
+
 	block._last_time = TimeUtils::getLocalTimeNow();
 	return &block;
 }
@@ -2436,32 +2523,33 @@ WTSTickSlice* WtRdmDtReader::readTickSliceByCount(const char* stdCode, uint32_t
 			eTick.action_time = sInfo->getCloseTime() * 100000 + 59999;
 		}
 
-		WTSTickStruct* pTick = std::lower_bound(tBlock->_ticks, tBlock->_ticks + (tBlock->_size - 1), eTick, [](const WTSTickStruct& a, const WTSTickStruct& b) {
+		//封存过的数据从封存文件读取
+		RTSealReader<WTSTickStruct>& seal = tPair->_seal;
+		std::size_t eIdx = seal.lower_bound(tBlock->_ticks, 0, tBlock->_size - 1, eTick, [](const WTSTickStruct& a, const WTSTickStruct& b) {
 			if (a.action_date != b.action_date)
 				return a.action_date < b.action_date;
 			else
 				return a.action_time < b.action_time;
 		});
-
-		std::size_t eIdx = pTick - tBlock->_ticks;
+		WTSTickStruct* pTick = seal.at(tBlock->_ticks, (uint32_t)eIdx);
 
 		//如果光标定位的tick时间比目标时间大, 则全部回退一个
 		if (pTick->action_date > eTick.action_date || pTick->action_time > eTick.action_time)
 		{
-			pTick--;
 			eIdx--;
 		}
 
 		uint32_t thisCnt = min((uint32_t)eIdx + 1, left);
 		uint32_t sIdx = eIdx + 1 - thisCnt;
-		slice->insertBlock(0, tBlock->_ticks + sIdx, thisCnt);
+		seal.insert_to(slice, 0, tBlock->_ticks, sIdx, thisCnt);
 		left -= thisCnt;
 		break;
 	}
 
+	//按交易日历回溯，周末和节假日不计入missingCnt
 	uint32_t nowTDate = min(endTDate, curTDate);
 	if (nowTDate == curTDate)
-		nowTDate = TimeUtils::getNextDate(nowTDate, -1);
+		nowTDate = _base_data_mgr->getPrevTDate(stdPID, nowTDate, 1);
 	uint32_t missingCnt = 0;
 	while (left > 0)
 	{
@@ -2596,7 +2684,7 @@ WTSTickSlice* WtRdmDtReader::readTickSliceByCount(const char* stdCode, uint32_t
 			break;
 		}
 
-		nowTDate = TimeUtils::getNextDate(nowTDate, -1);
+		nowTDate = _base_data_mgr->getPrevTDate(stdPID, nowTDate, 1);
 	}
 
 	return slice;
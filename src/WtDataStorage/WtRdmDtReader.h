@@ -4,6 +4,8 @@
 #include <unordered_map>
 
 #include "DataDefine.h"
+#include "HisDataCatalog.h"
+#include "RTSealHelper.h"
 
 #include "../Includes/FasterDefs.h"
 #include "../Includes/IRdmDtReader.h"
@@ -60,6 +62,7 @@ private:
 		BoostMFPtr		_file;
 		uint64_t		_last_cap;
 		uint64_t		_last_time;
+		RTSealReader<WTSTickStruct>	_seal;
 
 		_TBlockPair()
 		{
@@ -80,6 +83,7 @@ private:
 		BoostMFPtr		_file;
 		uint64_t		_last_cap;
 		uint64_t		_last_time;
+		RTSealReader<WTSTransStruct>	_seal;
 
 		_TransBlockPair()
 		{
@@ -100,6 +104,7 @@ private:
 		BoostMFPtr		_file;
 		uint64_t		_last_cap;
 		uint64_t		_last_time;
+		RTSealReader<WTSOrdDtlStruct>	_seal;
 
 		_OdeDtlBlockPair()
 		{
@@ -120,6 +125,7 @@ private:
 		BoostMFPtr		_file;
 		uint64_t		_last_cap;
 		uint64_t		_last_time;
+		RTSealReader<WTSOrdQueStruct>	_seal;
 
 		_OdeQueBlockPair()
 		{
@@ -210,6 +216,9 @@ private:
 	HisOrdQueBlockMap	_his_ordque_map;
 	HisTransBlockMap	_his_trans_map;
 
+	//历史数据目录，key为dtype/exchg
+	wt_hashmap<std::string, HisDataCatalog>	_catalogs;
+
 private:
 	RTKlineBlockPair* getRTKilneBlock(const char* exchg, const char* code, WTSKlinePeriod period);
 	TickBlockPair* getRTTickBlock(const char* exchg, const char* code);
@@ -228,6 +237,20 @@ private:
 	WTSBarStruct*	indexBarFromCacheByCount(const std::string& key, uint64_t etime, uint32_t& count, bool isDay = false);
 
 	bool	loadStkAdjFactorsFromFile(const char* adjfile);
+
+	/*
+	 *	获取历史数据目录，目录文件不存在则返回NULL
+	 *	写入方更新了目录文件以后会自动重新加载
+	 */
+	const HisDataCatalog*	getCatalog(const char* dtype, const char* exchg);
+
+	/*
+	 *	通过目录检查某一天的历史数据文件
+	 *	返回false说明目录里当天数据的时间和查询区间不重叠
+	 *	目录里没有当天的记录不算没有数据，返回true，由调用方探测文件
+	 *	bConfirmed为true说明目录确认文件存在，不用再探测文件
+	 */
+	bool	checkCatalog(const char* dtype, const char* exchg, const char* code, uint32_t uDate, uint64_t stime, uint64_t etime, bool& bConfirmed);
 	
 
 //////////////////////////////////////////////////////////////////////////
@@ -3,103 +3,238 @@
 #include "../Includes/WTSDataDef.hpp"
 #include "../Share/StdUtils.hpp"
 #include "../Share/BoostFile.hpp"
+#include "../Share/fmtlib.h"
 #include "../WTSTools/WTSLogger.h"
 
-bool ShmCaster::init(WTSVariant* cfg)
+#ifdef _MSC_VER
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+bool ShmCaster::create_queue(CastPartition& part)
 {
-	if (cfg == NULL)
-		return false;
+	//每次启动都重置该队列
+	{
+		BoostFile bf;
+		if (!bf.create_or_open_file(part._path.c_str()))
+		{
+			WTSLogger::error("Creating shm queue {} failed", part._path);
+			return false;
+		}
+		bf.truncate_file(sizeof(CastQueue));
+		bf.close_file();
+	}
 
-	if (!cfg->getBoolean("active"))
+	part._mapfile.reset(new BoostMappingFile);
+	if (!part._mapfile->map(part._path.c_str()))
+	{
+		WTSLogger::error("Mapping shm queue {} failed", part._path);
 		return false;
+	}
+	part._queue = (CastQueue*)part._mapfile->addr();
+	new(part._mapfile->addr()) CastQueue();
 
-	_path = cfg->getCString("path");
+#ifdef _MSC_VER
+	part._queue->_pid = _getpid();
+#else
+	part._queue->_pid = getpid();
+#endif
 
-	//每次启动都重置该队列
+	return true;
+}
+
+void ShmCaster::write_catalog(const std::vector<shmcast::PartitionEntry>& entries)
+{
+	std::string path = shmcast::catalog_path(_path.c_str());
 	{
 		BoostFile bf;
-		bf.create_or_open_file(_path.c_str());
-		bf.truncate_file(sizeof(CastQueue));
+		bf.create_or_open_file(path.c_str());
+		bf.truncate_file(sizeof(shmcast::PartitionCatalog));
 		bf.close_file();
 	}
 
-	_mapfile.reset(new BoostMappingFile);
-	_mapfile->map(_path.c_str());
-	_queue = (CastQueue*)_mapfile->addr();
-	new(_mapfile->addr()) CastQueue();
+	_catalog.reset(new BoostMappingFile);
+	_catalog->map(path.c_str());
+	shmcast::PartitionCatalog* catalog = (shmcast::PartitionCatalog*)_catalog->addr();
+	memset(catalog, 0, sizeof(shmcast::PartitionCatalog));
+	for (std::size_t i = 0; i < entries.size(); i++)
+		memcpy(&catalog->_parts[i], &entries[i], sizeof(shmcast::PartitionEntry));
+	catalog->_count = (uint32_t)entries.size();
+
+	memcpy(catalog->_flag, shmcast::PARTS_FLAG, sizeof(shmcast::PARTS_FLAG));
 
+	//pid最后写，读取端看到pid变化的时候目录一定是完整的
 #ifdef _MSC_VER
-	_queue->_pid = _getpid();
+	catalog->_pid = _getpid();
 #else
-	_queue->_pid = getpid();
+	catalog->_pid = getpid();
 #endif
+}
+
+bool ShmCaster::init(WTSVariant* cfg)
+{
+	if (cfg == NULL)
+		return false;
+
+	if (!cfg->getBoolean("active"))
+		return false;
+
+	_path = cfg->getCString("path");
+
+	/*
+	 *	分区配置，按照配置顺序匹配，一条数据落到第一个匹配的分区
+	 *	name	分区名，队列文件为<path>.<name>，按代码哈希拆分时为<path>.<name>_<桶号>
+	 *	exchg	交易所，逗号分隔，为空表示全部交易所
+	 *	types	数据类型，tick/ordque/orddtl/trans，逗号分隔，为空表示全部类型
+	 *	buckets	按代码哈希拆分的桶数，默认为1
+	 *	没有匹配任何分区的数据写入默认队列<path>
+	 */
+	std::vector<shmcast::PartitionEntry> entries;
+	WTSVariant* cfgParts = cfg->get("partitions");
+	if (cfgParts != NULL && cfgParts->type() == WTSVariant::VT_Array)
+	{
+		for (uint32_t i = 0; i < cfgParts->size(); i++)
+		{
+			WTSVariant* cfgPart = cfgParts->get(i);
+			std::string name = cfgPart->getCString("name");
+			if (name.empty())
+				name = fmt::format("part{}", i);
+
+			uint32_t buckets = cfgPart->getUInt32("buckets");
+			if (buckets == 0)
+				buckets = 1;
+
+			for (uint32_t b = 0; b < buckets; b++)
+			{
+				shmcast::PartitionEntry entry;
+				memset(&entry, 0, sizeof(entry));
+				std::string path = _path + "." + name;
+				if (buckets > 1)
+					path += fmt::format("_{}", b);
+				if (path.size() >= sizeof(entry._path))
+				{
+					WTSLogger::error("Path of shm partition {} is too long", path);
+					return false;
+				}
+				wt_strcpy(entry._path, path.c_str(), path.size());
+				std::string exchgs = cfgPart->getCString("exchg");
+				wt_strcpy(entry._exchg, exchgs.c_str(), std::min(exchgs.size(), sizeof(entry._exchg) - 1));
+				entry._type_mask = shmcast::parse_type_mask(cfgPart->getCString("types"));
+				entry._buckets = buckets;
+				entry._bucket = b;
+				entries.emplace_back(entry);
+			}
+		}
+	}
+
+	//最后一个是默认队列
+	{
+		shmcast::PartitionEntry entry;
+		memset(&entry, 0, sizeof(entry));
+		wt_strcpy(entry._path, _path.c_str(), _path.size());
+		entry._type_mask = shmcast::ALL_TYPES_MASK;
+		entry._buckets = 1;
+		entries.emplace_back(entry);
+	}
+
+	if (entries.size() > shmcast::MAX_PARTITIONS)
+	{
+		WTSLogger::error("Too many shm partitions: {}, {} at most", entries.size(), shmcast::MAX_PARTITIONS);
+		return false;
+	}
+
+	_partitions.resize(entries.size());
+	for (std::size_t i = 0; i < entries.size(); i++)
+	{
+		CastPartition& part = _partitions[i];
+		part._path = entries[i]._path;
+		if (!create_queue(part))
+			return false;
+
+		_rules.emplace_back(shmcast::PartitionRule(entries[i]));
+	}
+
+	write_catalog(entries);
 
 	_inited = true;
-	WTSLogger::info("ShmCaste initialized @ {}", _path.c_str());
+	WTSLogger::info("ShmCaste initialized @ {} with {} partitions", _path.c_str(), _partitions.size());
 
 	return true;
 }
 
 void ShmCaster::broadcast(WTSTickData* curTick)
 {
-	if (curTick == NULL || _queue == NULL || !_inited)
+	if (curTick == NULL || !_inited)
 		return;
 
+	const WTSTickStruct& ts = curTick->getTickStruct();
+	CastQueue* queue = select_queue(shmcast::CDT_Tick, ts.exchg, ts.code);
+
 	/*
 	 *	先移动写的下标，然后写入数据
 	 *	写完了以后，再移动读的下标
 	 */
-	uint64_t wIdx = _queue->_writable++;
-	uint64_t realIdx = wIdx % _queue->_capacity;
-	_queue->_items[realIdx]._type = 0;
-	memcpy(&_queue->_items[realIdx]._tick, &curTick->getTickStruct(), sizeof(WTSTickStruct));
-	_queue->_readable = wIdx;
+	uint64_t wIdx = queue->_writable++;
+	uint64_t realIdx = wIdx % queue->_capacity;
+	queue->_items[realIdx]._type = shmcast::CDT_Tick;
+	memcpy(&queue->_items[realIdx]._tick, &ts, sizeof(WTSTickStruct));
+	queue->_readable = wIdx;
 }
 
 void ShmCaster::broadcast(WTSOrdQueData* curOrdQue)
 {
-	if (curOrdQue == NULL || _queue == NULL || !_inited)
+	if (curOrdQue == NULL || !_inited)
 		return;
 
+	const WTSOrdQueStruct& qs = curOrdQue->getOrdQueStruct();
+	CastQueue* queue = select_queue(shmcast::CDT_OrdQue, qs.exchg, qs.code);
+
 	/*
 	 *	先移动写的下标，然后写入数据
 	 *	写完了以后，再移动读的下标
 	 */
-	uint64_t wIdx = _queue->_writable++;
-	uint64_t realIdx = wIdx % _queue->_capacity;
-	_queue->_items[realIdx]._type = 1;
-	memcpy(&_queue->_items[realIdx]._queue, &curOrdQue->getOrdQueStruct(), sizeof(WTSOrdQueStruct));
-	_queue->_readable = wIdx;
+	uint64_t wIdx = queue->_writable++;
+	uint64_t realIdx = wIdx % queue->_capacity;
+	queue->_items[realIdx]._type = shmcast::CDT_OrdQue;
+	memcpy(&queue->_items[realIdx]._queue, &qs, sizeof(WTSOrdQueStruct));
+	queue->_readable = wIdx;
 }
 
 void ShmCaster::broadcast(WTSOrdDtlData* curOrdDtl)
 {
-	if (curOrdDtl == NULL || _queue == NULL || !_inited)
+	if (curOrdDtl == NULL || !_inited)
 		return;
 
+	const WTSOrdDtlStruct& os = curOrdDtl->getOrdDtlStruct();
+	CastQueue* queue = select_queue(shmcast::CDT_OrdDtl, os.exchg, os.code);
+
 	/*
 	 *	先移动写的下标，然后写入数据
 	 *	写完了以后，再移动读的下标
 	 */
-	uint64_t wIdx = _queue->_writable++;
-	uint64_t realIdx = wIdx % _queue->_capacity;
-	_queue->_items[realIdx]._type = 2;
-	memcpy(&_queue->_items[realIdx]._order, &curOrdDtl->getOrdDtlStruct(), sizeof(WTSOrdDtlStruct));
-	_queue->_readable = wIdx;
+	uint64_t wIdx = queue->_writable++;
+	uint64_t realIdx = wIdx % queue->_capacity;
+	queue->_items[realIdx]._type = shmcast::CDT_OrdDtl;
+	memcpy(&queue->_items[realIdx]._order, &os, sizeof(WTSOrdDtlStruct));
+	queue->_readable = wIdx;
 }
 
 void ShmCaster::broadcast(WTSTransData* curTrans)
 {
-	if (curTrans == NULL || _queue == NULL || !_inited)
+	if (curTrans == NULL || !_inited)
 		return;
 
+	const WTSTransStruct& ts = curTrans->getTransStruct();
+	CastQueue* queue = select_queue(shmcast::CDT_Trans, ts.exchg, ts.code);
+
 	/*
 	 *	先移动写的下标，然后写入数据
 	 *	写完了以后，再移动读的下标
 	 */
-	uint64_t wIdx = _queue->_writable++;
-	uint64_t realIdx = wIdx % _queue->_capacity;
-	_queue->_items[realIdx]._type = 3;
-	memcpy(&_queue->_items[realIdx]._trans, &curTrans->getTransStruct(), sizeof(WTSTransStruct));
-	_queue->_readable = wIdx;
+	uint64_t wIdx = queue->_writable++;
+	uint64_t realIdx = wIdx % queue->_capacity;
+	queue->_items[realIdx]._type = shmcast::CDT_Trans;
+	memcpy(&queue->_items[realIdx]._trans, &ts, sizeof(WTSTransStruct));
+	queue->_readable = wIdx;
 }
\ No newline at end of file
@@ -1,11 +1,13 @@
 ﻿#pragma once
 #include "IDataCaster.h"
 #include <stdint.h>
+#include <vector>
 #include "../Includes/WTSStruct.h"
 #include "../Share/BoostMappingFile.hpp"
+#include "../Share/ShmCastDefs.hpp"
 
-NS_WTP_BEGIN
-class WTSVariant;
+NS_WTP_BEGIN
+class WTSVariant;
 NS_WTP_END
 
 USING_NS_WTP;
@@ -13,52 +15,60 @@ USING_NS_WTP;
 class ShmCaster : public IDataCaster
 {
 public:
-#pragma pack(push, 8)
-	typedef struct _DataItem
-	{
-		uint32_t	_type;	//数据类型， 0-tick,1-委托队列,2-逐笔委托,3-逐笔成交
-		union
-		{
-			WTSTickStruct	_tick;
-			WTSOrdQueStruct _queue;
-			WTSOrdDtlStruct	_order;
-			WTSTransStruct	_trans;
-		};
+	typedef shmcast::DataItem	DataItem;
+	typedef shmcast::CastQueue	CastQueue;
+
+public:
+	ShmCaster():_inited(false){}
+
+	bool	init(WTSVariant* cfg);
+
+	virtual void	broadcast(WTSTickData* curTick) override;
+	virtual void	broadcast(WTSOrdQueData* curOrdQue) override;
+	virtual void	broadcast(WTSOrdDtlData* curOrdDtl) override;
+	virtual void	broadcast(WTSTransData* curTrans) override;
 
-		_DataItem() { memset(this, 0, sizeof(_DataItem)); }
-	} DataItem;
+private:
+	typedef std::shared_ptr<BoostMappingFile> MappedFilePtr;
 
-	template <int N = 8*1024>
-	struct _DataQueue
+	typedef struct _CastPartition
 	{
-		uint64_t	_capacity = N;
-		volatile uint64_t	_readable;
-		volatile uint64_t	_writable;
-		uint32_t	_pid;
-		DataItem	_items[N];
+		std::string		_path;
+		MappedFilePtr	_mapfile;
+		CastQueue*		_queue;
 
-		_DataQueue() :_readable(UINT64_MAX), _writable(0), _pid(0) {}
-	};
+		_CastPartition() :_queue(NULL){}
+	} CastPartition;
 
-	typedef _DataQueue<8*1024>	CastQueue;
+	/*
+	 *	创建并重置一个队列文件
+	 */
+	bool	create_queue(CastPartition& part);
 
-#pragma pack(pop)
+	/*
+	 *	写入分区目录，读取端据此挂载需要的分区
+	 */
+	void	write_catalog(const std::vector<shmcast::PartitionEntry>& entries);
 
-public:
-	ShmCaster():_queue(NULL), _inited(false){}
-
-	bool	init(WTSVariant* cfg);
-
-	virtual void	broadcast(WTSTickData* curTick) override;
-	virtual void	broadcast(WTSOrdQueData* curOrdQue) override;
-	virtual void	broadcast(WTSOrdDtlData* curOrdDtl) override;
-	virtual void	broadcast(WTSTransData* curTrans) override;
+	/*
+	 *	根据数据类型和代码找到对应分区的队列
+	 */
+	inline CastQueue* select_queue(uint32_t dType, const char* exchg, const char* code)
+	{
+		//没有配置分区，所有数据都走默认队列
+		if (_partitions.size() == 1)
+			return _partitions[0]._queue;
+
+		//最后一个分区是默认队列，一定能匹配上
+		int32_t idx = shmcast::route(_rules, dType, exchg, code);
+		return _partitions[idx]._queue;
+	}
 
 private:
 	std::string		_path;
-	typedef std::shared_ptr<BoostMappingFile> MappedFilePtr;
-	MappedFilePtr	_mapfile;
-	CastQueue*		_queue;
+	std::vector<CastPartition>	_partitions;
+	shmcast::PartitionRules		_rules;
+	MappedFilePtr	_catalog;
 	bool			_inited;
 };
 
@@ -0,0 +1,739 @@
+﻿/*!
+ * \file ArrowIpc.cpp
+ * \project	WonderTrader
+ *
+ * \brief Arrow IPC文件(Feather V2)的读写
+ */
+#include "ArrowIpc.h"
+#include "../Share/BoostMappingFile.hpp"
+#include "../Share/StrUtil.hpp"
+
+namespace arrow_ipc
+{
+	const char		MAGIC[] = "ARROW1";
+	const uint32_t	CONTINUATION = 0xFFFFFFFF;
+	const size_t	BUFFER_ALIGN = 64;
+
+	//Arrow的flatbuffers枚举值，见format/Schema.fbs和Message.fbs
+	const int16_t	METADATA_V5 = 4;
+	const uint8_t	MH_Schema = 1;
+	const uint8_t	MH_RecordBatch = 3;
+	const uint8_t	TYPE_Int = 2;
+	const uint8_t	TYPE_FloatingPoint = 3;
+	const uint8_t	TYPE_Utf8 = 5;
+	const int16_t	PRECISION_DOUBLE = 2;
+
+	inline size_t padded(size_t len, size_t align = BUFFER_ALIGN)
+	{
+		return (len + align - 1) / align * align;
+	}
+
+	inline uint32_t col_width(ArrowColType t)
+	{
+		switch (t)
+		{
+		case ACT_Int32:
+		case ACT_UInt32:
+			return 4;
+		case ACT_Int64:
+		case ACT_UInt64:
+		case ACT_Double:
+			return 8;
+		default:
+			return 0;
+		}
+	}
+
+	/*
+	 *	极简的flatbuffers编码器
+	 *	从前往后写，vtable放在表的前面，子对象写在父对象后面，引用写入的时候先占位，子对象写完再回填
+	 *	标量都按照自身大小相对缓冲区起始位置对齐
+	 */
+	class FbBuilder
+	{
+	public:
+		FbBuilder() :_vt_pos(0), _tbl_pos(0), _fields(0)
+		{
+			_buf.resize(4);	//根表的偏移量
+		}
+
+		inline std::string& buffer() { return _buf; }
+		inline size_t size() const { return _buf.size(); }
+
+		inline void align(size_t n)
+		{
+			while (_buf.size() % n != 0)
+				_buf.push_back(0);
+		}
+
+		template<typename T>
+		inline size_t push(T v)
+		{
+			align(sizeof(T));
+			size_t pos = _buf.size();
+			_buf.append((const char*)&v, sizeof(T));
+			return pos;
+		}
+
+		inline void patch(size_t refPos, size_t target)
+		{
+			uint32_t off = (uint32_t)(target - refPos);
+			memcpy((char*)_buf.data() + refPos, &off, sizeof(uint32_t));
+		}
+
+		inline void start_table(uint16_t fields)
+		{
+			align(2);
+			_vt_pos = _buf.size();
+			_fields = fields;
+			_buf.append(4 + 2 * fields, 0);
+			align(4);
+			_tbl_pos = _buf.size();
+			push<int32_t>((int32_t)(_tbl_pos - _vt_pos));
+		}
+
+		template<typename T>
+		inline void add(uint16_t id, T v)
+		{
+			set_field(id, push(v));
+		}
+
+		//引用字段，返回占位的位置
+		inline size_t add_ref(uint16_t id)
+		{
+			size_t pos = push<uint32_t>(0);
+			set_field(id, pos);
+			return pos;
+		}
+
+		inline size_t end_table()
+		{
+			uint16_t vtsize = (uint16_t)(4 + 2 * _fields);
+			uint16_t tblsize = (uint16_t)(_buf.size() - _tbl_pos);
+			memcpy((char*)_buf.data() + _vt_pos, &vtsize, 2);
+			memcpy((char*)_buf.data() + _vt_pos + 2, &tblsize, 2);
+			return _tbl_pos;
+		}
+
+		inline size_t add_string(const char* s)
+		{
+			uint32_t len = (uint32_t)strlen(s);
+			size_t pos = push<uint32_t>(len);
+			_buf.append(s, len);
+			_buf.push_back(0);
+			return pos;
+		}
+
+		//写入向量长度，保证长度后面的元素按elemAlign对齐，返回长度字段的位置
+		inline size_t start_vector(uint32_t count, size_t elemAlign)
+		{
+			if (elemAlign < 4)
+				elemAlign = 4;
+			while ((_buf.size() + 4) % elemAlign != 0)
+				_buf.push_back(0);
+			return push<uint32_t>(count);
+		}
+
+		template<typename T>
+		inline void append_raw(const T& v)
+		{
+			_buf.append((const char*)&v, sizeof(T));
+		}
+
+	private:
+		inline void set_field(uint16_t id, size_t pos)
+		{
+			uint16_t off = (uint16_t)(pos - _tbl_pos);
+			memcpy((char*)_buf.data() + _vt_pos + 4 + 2 * id, &off, 2);
+		}
+
+	private:
+		std::string	_buf;
+		size_t		_vt_pos;
+		size_t		_tbl_pos;
+		uint16_t	_fields;
+	};
+
+	/*
+	 *	写Schema表
+	 *	@refPos	父对象里指向Schema的引用位置
+	 */
+	void build_schema(FbBuilder& fb, size_t refPos, const ArrowFields& fields)
+	{
+		fb.start_table(4);
+		fb.add<int16_t>(0, 0);	//little endian
+		size_t fieldsRef = fb.add_ref(1);
+		fb.patch(refPos, fb.end_table());
+
+		size_t vecPos = fb.start_vector((uint32_t)fields.size(), 4);
+		fb.patch(fieldsRef, vecPos);
+		for (size_t i = 0; i < fields.size(); i++)
+			fb.push<uint32_t>(0);
+
+		for (size_t i = 0; i < fields.size(); i++)
+		{
+			const ArrowField& field = fields[i];
+			fb.start_table(7);
+			size_t nameRef = fb.add_ref(0);
+			fb.add<uint8_t>(1, 0);
+			uint8_t tt = (field._type == ACT_Utf8) ? TYPE_Utf8 : (field._type == ACT_Double ? TYPE_FloatingPoint : TYPE_Int);
+			fb.add<uint8_t>(2, tt);
+			size_t typeRef = fb.add_ref(3);
+			size_t childRef = fb.add_ref(5);
+			fb.patch(vecPos + 4 + 4 * i, fb.end_table());
+
+			fb.patch(nameRef, fb.add_string(field._name.c_str()));
+
+			if (tt == TYPE_Int)
+			{
+				fb.start_table(2);
+				fb.add<int32_t>(0, (int32_t)col_width(field._type) * 8);
+				fb.add<uint8_t>(1, (field._type == ACT_Int32 || field._type == ACT_Int64) ? 1 : 0);
+			}
+			else if (tt == TYPE_FloatingPoint)
+			{
+				fb.start_table(1);
+				fb.add<int16_t>(0, PRECISION_DOUBLE);
+			}
+			else
+			{
+				fb.start_table(0);
+			}
+			fb.patch(typeRef, fb.end_table());
+
+			//children不能省略，arrow读取的时候会检查
+			fb.patch(childRef, fb.start_vector(0, 4));
+		}
+	}
+
+	/*
+	 *	极简的flatbuffers解码器，只做读取需要的边界检查
+	 */
+	class FbTable
+	{
+	public:
+		FbTable(const char* base = NULL, size_t len = 0, size_t pos = 0) :_base(base), _len(len), _pos(pos){}
+
+		inline bool valid() const { return _base != NULL && _pos + 4 <= _len; }
+
+		template<typename T>
+		inline T scalar(uint16_t id, T def) const
+		{
+			size_t p = field_pos(id);
+			if (p == 0 || p + sizeof(T) > _len)
+				return def;
+
+			T v;
+			memcpy(&v, _base + p, sizeof(T));
+			return v;
+		}
+
+		//引用字段指向的位置，0表示不存在
+		inline size_t deref(uint16_t id) const
+		{
+			size_t p = field_pos(id);
+			if (p == 0 || p + 4 > _len)
+				return 0;
+
+			uint32_t off = read<uint32_t>(p);
+			if (p + off + 4 > _len)
+				return 0;
+			return p + off;
+		}
+
+		inline FbTable table(uint16_t id) const
+		{
+			size_t p = deref(id);
+			if (p == 0)
+				return FbTable();
+			return FbTable(_base, _len, p);
+		}
+
+		//向量，返回元素起始位置和长度
+		inline size_t vector(uint16_t id, uint32_t& count, size_t elemSize) const
+		{
+			count = 0;
+			size_t p = deref(id);
+			if (p == 0)
+				return 0;
+
+			count = read<uint32_t>(p);
+			if (p + 4 + (size_t)count * elemSize > _len)
+			{
+				count = 0;
+				return 0;
+			}
+			return p + 4;
+		}
+
+		inline FbTable vector_table(size_t elemPos, uint32_t idx) const
+		{
+			size_t p = elemPos + 4 * idx;
+			return FbTable(_base, _len, p + read<uint32_t>(p));
+		}
+
+		inline std::string string(uint16_t id) const
+		{
+			size_t p = deref(id);
+			if (p == 0)
+				return "";
+
+			uint32_t len = read<uint32_t>(p);
+			if (p + 4 + len > _len)
+				return "";
+			return std::string(_base + p + 4, len);
+		}
+
+		template<typename T>
+		inline T read(size_t p) const
+		{
+			T v;
+			memcpy(&v, _base + p, sizeof(T));
+			return v;
+		}
+
+	private:
+		inline size_t field_pos(uint16_t id) const
+		{
+			if (!valid())
+				return 0;
+
+			int64_t vt = (int64_t)_pos - read<int32_t>(_pos);
+			if (vt < 0 || (size_t)vt + 4 > _len)
+				return 0;
+
+			uint16_t vtsize = read<uint16_t>((size_t)vt);
+			if (4 + 2 * (size_t)id + 2 > vtsize || (size_t)vt + vtsize > _len)
+				return 0;
+
+			uint16_t off = read<uint16_t>((size_t)vt + 4 + 2 * id);
+			return off == 0 ? 0 : _pos + off;
+		}
+
+	private:
+		const char*	_base;
+		size_t		_len;
+		size_t		_pos;
+	};
+
+	inline FbTable root_table(const char* base, size_t len)
+	{
+		if (len < 4)
+			return FbTable();
+
+		uint32_t off;
+		memcpy(&off, base, 4);
+		return FbTable(base, len, off);
+	}
+}
+
+using namespace arrow_ipc;
+
+bool ArrowWriter::open(const char* filename, const ArrowFields& fields)
+{
+	close();
+
+	if (!_file.create_new_file(filename))
+		return false;
+
+	_fields = fields;
+	_blocks.clear();
+	_rows = 0;
+	_pos = 0;
+	_opened = true;
+
+	char head[8] = { 0 };
+	memcpy(head, MAGIC, 6);
+	_file.write_file(head, 8);
+	_pos += 8;
+
+	FbBuilder fb;
+	fb.start_table(5);
+	fb.add<int16_t>(0, METADATA_V5);
+	fb.add<uint8_t>(1, MH_Schema);
+	size_t headerRef = fb.add_ref(2);
+	fb.add<int64_t>(3, 0);
+	fb.patch(0, fb.end_table());
+	build_schema(fb, headerRef, _fields);
+
+	write_message(fb.buffer(), "");
+	return true;
+}
+
+void ArrowWriter::write_message(const std::string& meta, const std::string& body, BlockInfo* block /* = NULL */)
+{
+	//前缀加元数据整体补齐到64字节，消息体在文件里也就是64字节对齐的
+	size_t metaLen = padded(8 + meta.size());
+	std::string buf;
+	buf.reserve(metaLen);
+	buf.append((const char*)&CONTINUATION, 4);
+	int32_t fbLen = (int32_t)(metaLen - 8);
+	buf.append((const char*)&fbLen, 4);
+	buf.append(meta);
+	buf.resize(metaLen, 0);
+
+	if (block)
+	{
+		block->_offset = (int64_t)_pos;
+		block->_meta_len = (int32_t)metaLen;
+		block->_body_len = (int64_t)body.size();
+	}
+
+	_file.write_file(buf);
+	if (!body.empty())
+		_file.write_file(body);
+	_pos += metaLen + body.size();
+}
+
+bool ArrowWriter::write_batch(const void* items, uint32_t count, uint32_t stride)
+{
+	if (!_opened)
+		return false;
+
+	if (count == 0)
+		return true;
+
+	const char* base = (const char*)items;
+
+	typedef struct _BufInfo
+	{
+		int64_t _offset;
+		int64_t _length;
+	} BufInfo;
+	std::vector<BufInfo> buffers;
+
+	//按列抽取，每列都是连续的
+	std::string body;
+	for (const ArrowField& field : _fields)
+	{
+		//没有空值，有效位图长度为0
+		buffers.push_back({ (int64_t)body.size(), 0 });
+
+		if (field._type == ACT_Utf8)
+		{
+			std::vector<int32_t> offsets(count + 1);
+			std::string chars;
+			int32_t cur = 0;
+			for (uint32_t i = 0; i < count; i++)
+			{
+				const char* s = base + (size_t)i*stride + field._offset;
+				size_t len = strnlen(s, field._width);
+				chars.append(s, len);
+				offsets[i] = cur;
+				cur += (int32_t)len;
+			}
+			offsets[count] = cur;
+
+			size_t offPos = body.size();
+			body.append((const char*)offsets.data(), 4 * offsets.size());
+			body.resize(padded(body.size()), 0);
+			buffers.push_back({ (int64_t)offPos, (int64_t)4 * (count + 1) });
+
+			size_t dataPos = body.size();
+			body.append(chars);
+			body.resize(padded(body.size()), 0);
+			buffers.push_back({ (int64_t)dataPos, (int64_t)cur });
+		}
+		else
+		{
+			uint32_t width = col_width(field._type);
+			size_t dataPos = body.size();
+			body.resize(padded(dataPos + (size_t)width*count), 0);
+			char* dst = (char*)body.data() + dataPos;
+			for (uint32_t i = 0; i < count; i++)
+				memcpy(dst + (size_t)i*width, base + (size_t)i*stride + field._offset, width);
+
+			buffers.push_back({ (int64_t)dataPos, (int64_t)width*count });
+		}
+	}
+
+	FbBuilder fb;
+	fb.start_table(5);
+	fb.add<int16_t>(0, METADATA_V5);
+	fb.add<uint8_t>(1, MH_RecordBatch);
+	size_t headerRef = fb.add_ref(2);
+	fb.add<int64_t>(3, (int64_t)body.size());
+	fb.patch(0, fb.end_table());
+
+	fb.start_table(3);
+	fb.add<int64_t>(0, (int64_t)count);
+	size_t nodesRef = fb.add_ref(1);
+	size_t buffersRef = fb.add_ref(2);
+	fb.patch(headerRef, fb.end_table());
+
+	fb.patch(nodesRef, fb.start_vector((uint32_t)_fields.size(), 8));
+	for (size_t i = 0; i < _fields.size(); i++)
+	{
+		BufInfo node = { (int64_t)count, 0 };
+		fb.append_raw(node);
+	}
+
+	fb.patch(buffersRef, fb.start_vector((uint32_t)buffers.size(), 8));
+	for (const BufInfo& buf : buffers)
+		fb.append_raw(buf);
+
+	BlockInfo block;
+	write_message(fb.buffer(), body, &block);
+	_blocks.emplace_back(block);
+	_rows += count;
+	return true;
+}
+
+bool ArrowWriter::close()
+{
+	if (!_opened)
+		return false;
+
+	//流结束标记
+	uint32_t eos[2] = { CONTINUATION, 0 };
+	_file.write_file(eos, 8);
+	_pos += 8;
+
+	FbBuilder fb;
+	fb.start_table(5);
+	fb.add<int16_t>(0, METADATA_V5);
+	size_t schemaRef = fb.add_ref(1);
+	size_t dictRef = fb.add_ref(2);
+	size_t batchRef = fb.add_ref(3);
+	fb.patch(0, fb.end_table());
+
+	build_schema(fb, schemaRef, _fields);
+
+	fb.patch(dictRef, fb.start_vector(0, 8));
+
+	fb.patch(batchRef, fb.start_vector((uint32_t)_blocks.size(), 8));
+	for (const BlockInfo& b : _blocks)
+	{
+		//Block结构体: offset(8) + metaDataLength(4) + 填充(4) + bodyLength(8)
+		char raw[24] = { 0 };
+		memcpy(raw, &b._offset, 8);
+		memcpy(raw + 8, &b._meta_len, 4);
+		memcpy(raw + 16, &b._body_len, 8);
+		fb.append_raw(raw);
+	}
+
+	const std::string& footer = fb.buffer();
+	int32_t footLen = (int32_t)footer.size();
+	_file.write_file(footer);
+	_file.write_file(&footLen, 4);
+	_file.write_file(MAGIC, 6);
+	_file.close_file();
+
+	_opened = false;
+	return true;
+}
+
+bool ArrowReader::open(const char* filename, std::string& errmsg)
+{
+	_fields.clear();
+	_batches.clear();
+
+	_file.reset(new BoostMappingFile);
+	if (!_file->map(filename, boost::interprocess::read_only, boost::interprocess::read_only))
+	{
+		errmsg = StrUtil::printf("文件%s映射失败", filename);
+		return false;
+	}
+
+	const char* base = (const char*)_file->addr();
+	size_t fsize = _file->size();
+	if (fsize < 18 || memcmp(base, MAGIC, 6) != 0 || memcmp(base + fsize - 6, MAGIC, 6) != 0)
+	{
+		errmsg = StrUtil::printf("文件%s不是Arrow IPC文件", filename);
+		return false;
+	}
+
+	int32_t footLen;
+	memcpy(&footLen, base + fsize - 10, 4);
+	if (footLen <= 0 || (size_t)footLen + 18 > fsize)
+	{
+		errmsg = StrUtil::printf("文件%s文件尾长度错误", filename);
+		return false;
+	}
+
+	const char* footBase = base + fsize - 10 - footLen;
+	FbTable footer = root_table(footBase, (size_t)footLen);
+	FbTable schema = footer.table(1);
+	if (!schema.valid())
+	{
+		errmsg = StrUtil::printf("文件%s缺少schema", filename);
+		return false;
+	}
+
+	uint32_t fieldCnt = 0;
+	size_t fieldsPos = schema.vector(1, fieldCnt, 4);
+	for (uint32_t i = 0; i < fieldCnt; i++)
+	{
+		FbTable field = schema.vector_table(fieldsPos, i);
+		std::string name = field.string(0);
+		uint8_t tt = field.scalar<uint8_t>(2, 0);
+		FbTable type = field.table(3);
+
+		ArrowColType ct;
+		if (tt == TYPE_Utf8)
+		{
+			ct = ACT_Utf8;
+		}
+		else if (tt == TYPE_FloatingPoint && type.scalar<int16_t>(0, 0) == PRECISION_DOUBLE)
+		{
+			ct = ACT_Double;
+		}
+		else if (tt == TYPE_Int)
+		{
+			int32_t bits = type.scalar<int32_t>(0, 0);
+			bool bSigned = type.scalar<uint8_t>(1, 0) != 0;
+			if (bits == 32)
+				ct = bSigned ? ACT_Int32 : ACT_UInt32;
+			else if (bits == 64)
+				ct = bSigned ? ACT_Int64 : ACT_UInt64;
+			else
+			{
+				errmsg = StrUtil::printf("列%s的整数位宽%d不支持", name.c_str(), bits);
+				return false;
+			}
+		}
+		else
+		{
+			errmsg = StrUtil::printf("列%s的类型%u不支持", name.c_str(), tt);
+			return false;
+		}
+
+		_fields.emplace_back(ArrowField(name.c_str(), ct));
+	}
+
+	uint32_t blockCnt = 0;
+	size_t blocksPos = footer.vector(3, blockCnt, 24);
+	for (uint32_t b = 0; b < blockCnt; b++)
+	{
+		int64_t offset = footer.read<int64_t>(blocksPos + 24 * b);
+		int32_t metaLen = footer.read<int32_t>(blocksPos + 24 * b + 8);
+		int64_t bodyLen = footer.read<int64_t>(blocksPos + 24 * b + 16);
+		if (offset < 8 || metaLen < 8 || (size_t)(offset + metaLen + bodyLen) > fsize)
+		{
+			errmsg = StrUtil::printf("第%u个record batch的位置错误", b);
+			return false;
+		}
+
+		//老格式没有0xFFFFFFFF前缀
+		const char* msgBase = base + offset;
+		size_t fbOff = 4;
+		if (memcmp(msgBase, &CONTINUATION, 4) == 0)
+			fbOff = 8;
+
+		FbTable msg = root_table(msgBase + fbOff, (size_t)metaLen - fbOff);
+		if (msg.scalar<uint8_t>(1, 0) != MH_RecordBatch)
+			continue;
+
+		FbTable rb = msg.table(2);
+		if (rb.deref(3) != 0)
+		{
+			errmsg = StrUtil::printf("第%u个record batch是压缩的，暂不支持", b);
+			return false;
+		}
+
+		const char* body = msgBase + metaLen;
+		BatchData batch;
+		int64_t rows = rb.scalar<int64_t>(0, 0);
+		if (rows < 0 || rows > bodyLen)
+		{
+			errmsg = StrUtil::printf("第%u个record batch的行数错误", b);
+			return false;
+		}
+		batch._rows = (uint64_t)rows;
+
+		uint32_t nodeCnt = 0;
+		size_t nodePos = rb.vector(1, nodeCnt, 16);
+		if (nodeCnt < _fields.size())
+		{
+			errmsg = StrUtil::printf("第%u个record batch的字段数量不对", b);
+			return false;
+		}
+
+		uint32_t bufCnt = 0;
+		size_t bufPos = rb.vector(2, bufCnt, 16);
+		uint32_t bufIdx = 0;
+		uint32_t fieldIdx = 0;
+		for (const ArrowField& field : _fields)
+		{
+			//返回的列只是连续数组，没有有效位图，带空值的文件直接拒绝
+			int64_t nullCnt = rb.read<int64_t>(nodePos + 16 * fieldIdx + 8);
+			fieldIdx++;
+			if (nullCnt != 0)
+			{
+				errmsg = StrUtil::printf("列%s有%lld个空值，暂不支持", field._name.c_str(), (long long)nullCnt);
+				return false;
+			}
+
+			uint32_t need = (field._type == ACT_Utf8) ? 3 : 2;
+			if (bufIdx + need > bufCnt)
+			{
+				errmsg = StrUtil::printf("第%u个record batch的缓冲区数量不对", b);
+				return false;
+			}
+
+			//第一个是有效位图，上面已经确认没有空值，直接跳过
+			ColumnData col;
+			col._count = batch._rows;
+			col._offsets = NULL;
+			int64_t off1 = rb.read<int64_t>(bufPos + 16 * (bufIdx + 1));
+			int64_t len1 = rb.read<int64_t>(bufPos + 16 * (bufIdx + 1) + 8);
+			if (off1 < 0 || off1 + len1 > bodyLen)
+			{
+				errmsg = StrUtil::printf("列%s的缓冲区越界", field._name.c_str());
+				return false;
+			}
+
+			if (field._type == ACT_Utf8)
+			{
+				int64_t off2 = rb.read<int64_t>(bufPos + 16 * (bufIdx + 2));
+				int64_t len2 = rb.read<int64_t>(bufPos + 16 * (bufIdx + 2) + 8);
+				if (off2 < 0 || off2 + len2 > bodyLen)
+				{
+					errmsg = StrUtil::printf("列%s的缓冲区越界", field._name.c_str());
+					return false;
+				}
+				//偏移量要有rows+1个，并且单调不减、不超过数据缓冲区
+				if ((uint64_t)len1 < (batch._rows + 1) * sizeof(int32_t))
+				{
+					errmsg = StrUtil::printf("列%s的偏移量缓冲区长度不足", field._name.c_str());
+					return false;
+				}
+
+				const int32_t* offsets = (const int32_t*)(body + off1);
+				if (offsets[0] < 0 || offsets[batch._rows] > len2)
+				{
+					errmsg = StrUtil::printf("列%s的偏移量越界", field._name.c_str());
+					return false;
+				}
+
+				for (uint64_t r = 0; r < batch._rows; r++)
+				{
+					if (offsets[r] > offsets[r + 1])
+					{
+						errmsg = StrUtil::printf("列%s的偏移量不是递增的", field._name.c_str());
+						return false;
+					}
+				}
+
+				col._offsets = offsets;
+				col._data = body + off2;
+			}
+			else
+			{
+				if ((uint64_t)len1 < batch._rows * col_width(field._type))
+				{
+					errmsg = StrUtil::printf("列%s的数据缓冲区长度不足", field._name.c_str());
+					return false;
+				}
+				col._data = body + off1;
+			}
+
+			batch._columns.emplace_back(col);
+			bufIdx += need;
+		}
+
+		_batches.emplace_back(batch);
+	}
+
+	return true;
+}
@@ -0,0 +1,118 @@
+﻿/*!
+ * \file ArrowIpc.h
+ * \project	WonderTrader
+ *
+ * \brief Arrow IPC文件(Feather V2)的读写
+ *
+ * 不依赖arrow库，元数据的flatbuffers直接手工编码
+ * 只支持定长数值列和utf8字符串列，不压缩，没有空值，每个缓冲区按64字节对齐，
+ * 所以pyarrow.ipc.open_file(pyarrow.memory_map(...))可以直接零拷贝打开，
+ * ArrowReader也是把文件映射到内存，列数据直接指向映射区
+ */
+#pragma once
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <memory>
+
+#include "../Share/BoostFile.hpp"
+
+class BoostMappingFile;
+
+typedef enum tagArrowColType
+{
+	ACT_Int32 = 0,
+	ACT_UInt32,
+	ACT_Int64,
+	ACT_UInt64,
+	ACT_Double,
+	ACT_Utf8
+} ArrowColType;
+
+/*
+ *	列定义
+ *	写入的时候按照_offset从结构体数组里抽取，字符串列的_width是字符数组的长度
+ */
+typedef struct _ArrowField
+{
+	std::string		_name;
+	ArrowColType	_type;
+	uint32_t		_offset;
+	uint32_t		_width;
+
+	_ArrowField(const char* name, ArrowColType type, uint32_t offset = 0, uint32_t width = 0)
+		: _name(name), _type(type), _offset(offset), _width(width){}
+} ArrowField;
+typedef std::vector<ArrowField> ArrowFields;
+
+class ArrowWriter
+{
+public:
+	ArrowWriter() : _opened(false), _rows(0){}
+	~ArrowWriter() { close(); }
+
+public:
+	bool	open(const char* filename, const ArrowFields& fields);
+
+	/*
+	 *	写入一个record batch
+	 *	@items	结构体数组
+	 *	@count	数据条数
+	 *	@stride	结构体大小
+	 */
+	bool	write_batch(const void* items, uint32_t count, uint32_t stride);
+
+	//写入文件尾，关闭以后文件才能被读取
+	bool	close();
+
+	inline uint64_t rows() const { return _rows; }
+
+private:
+	typedef struct _BlockInfo
+	{
+		int64_t	_offset;
+		int32_t	_meta_len;
+		int64_t	_body_len;
+	} BlockInfo;
+
+	void	write_message(const std::string& meta, const std::string& body, BlockInfo* block = NULL);
+
+private:
+	bool		_opened;
+	BoostFile	_file;
+	uint64_t	_pos;
+	uint64_t	_rows;
+	ArrowFields	_fields;
+	std::vector<BlockInfo>	_blocks;
+};
+
+class ArrowReader
+{
+public:
+	typedef struct _ColumnData
+	{
+		const void*		_data;
+		const int32_t*	_offsets;	//字符串列的偏移量，长度为_count+1
+		uint64_t		_count;
+	} ColumnData;
+
+	typedef struct _BatchData
+	{
+		uint64_t				_rows;
+		std::vector<ColumnData>	_columns;
+	} BatchData;
+
+public:
+	ArrowReader(){}
+
+public:
+	bool	open(const char* filename, std::string& errmsg);
+
+	inline const ArrowFields&				fields() const { return _fields; }
+	inline const std::vector<BatchData>&	batches() const { return _batches; }
+
+private:
+	std::shared_ptr<BoostMappingFile>	_file;
+	ArrowFields				_fields;
+	std::vector<BatchData>	_batches;
+};
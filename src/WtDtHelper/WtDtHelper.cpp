@@ -8,11 +8,15 @@
  * \brief 
  */
 #include "WtDtHelper.h"
+#include "ArrowIpc.h"
 #include "../Share/StrUtil.hpp"
+#include "../Share/StdUtils.hpp"
 #include "../Share/TimeUtils.hpp"
 #include "../Share/BoostFile.hpp"
 
 #include "../WtDataStorage/DataDefine.h"
+#include "../WtDataStorage/HisDataCatalog.h"
+#include "../WtDataStorage/RTSealHelper.h"
 #include "../WTSUtils/WTSCmpHelper.hpp"
 #include "../WTSTools/CsvHelper.h"
 #include "../WTSTools/WTSDataFactory.h"
@@ -20,6 +24,8 @@
 #include "../Includes/WTSDataDef.hpp"
 #include "../Includes/WTSSessionInfo.hpp"
 
+#include <set>
+#include <algorithm>
 #include <rapidjson/document.h>
 
 namespace rj = rapidjson;
@@ -117,46 +123,6 @@ bool proc_block_data(std::string& content, bool isBar, bool bKeepHead /* = true
 	return true;
 }
 
-
-uint32_t strToTime(const char* strTime, bool bKeepSec = false)
-{
-	std::string str;
-	const char *pos = strTime;
-	while (strlen(pos) > 0)
-	{
-		if (pos[0] != ':')
-		{
-			str.append(pos, 1);
-		}
-		pos++;
-	}
-
-	uint32_t ret = strtoul(str.c_str(), NULL, 10);
-	if (ret > 10000 && !bKeepSec)
-		ret /= 100;
-
-	return ret;
-}
-
-uint32_t strToDate(const char* strDate)
-{
-	StringVector ay = StrUtil::split(strDate, "/");
-	if (ay.size() == 1)
-		ay = StrUtil::split(strDate, "-");
-	std::stringstream ss;
-	if (ay.size() > 1)
-	{
-		auto pos = ay[2].find(" ");
-		if (pos != std::string::npos)
-			ay[2] = ay[2].substr(0, pos);
-		ss << ay[0] << (ay[1].size() == 1 ? "0" : "") << ay[1] << (ay[2].size() == 1 ? "0" : "") << ay[2];
-	}
-	else
-		ss << ay[0];
-
-	return strtoul(ss.str().c_str(), NULL, 10);
-}
-
 void dump_bars(WtString binFolder, WtString csvFolder, WtString strFilter /* = "" */, FuncLogCallback cbLogger /* = NULL */)
 {
 	std::string srcFolder = StrUtil::standardisePath(binFolder);
@@ -399,40 +365,15 @@ void trans_csv_bars(WtString csvFolder, WtString binFolder, WtString period, Fun
 		if(cbLogger)
 			cbLogger(StrUtil::printf("正在读取数据文件%s...", path.c_str()).c_str());
 
-		CsvReader reader(",");
-		if(!reader.load_from_file(path.c_str()))
+		//按表头映射字段，直接解析到WTSBarStruct数组中，大文件会按行切分多线程解析
+		std::vector<WTSBarStruct> bars;
+		if (CsvLoader::load_bars(path.c_str(), bars, kp == KP_DAY) == 0)
 		{
 			if (cbLogger)
 				cbLogger(StrUtil::printf("读取数据文件%s失败...", path.c_str()).c_str());
 			continue;
 		}
 
-		std::vector<WTSBarStruct> bars;
-
-		while(reader.next_row())
-		{
-			//逐行读取
-			WTSBarStruct bs;
-			bs.date = strToDate(reader.get_string("date"));
-			if(kp != KP_DAY)
-				bs.time = TimeUtils::timeToMinBar(bs.date, strToTime(reader.get_string("time")));
-			bs.open = reader.get_double("open");
-			bs.high = reader.get_double("high");
-			bs.low = reader.get_double("low");
-			bs.close = reader.get_double("close");
-			bs.vol = reader.get_double("volume");
-			bs.money = reader.get_double("turnover");
-			bs.hold = reader.get_double("open_interest");
-			bs.add = reader.get_double("diff_interest");
-			bs.settle = reader.get_double("settle");
-			bars.emplace_back(bs);
-
-			if (bars.size() % 1000 == 0)
-			{
-				if (cbLogger)
-					cbLogger(StrUtil::printf("已读取数据%u条", bars.size()).c_str());
-			}
-		}
 		if (cbLogger)
 			cbLogger(StrUtil::printf("数据文件%s全部读取完成,共%u条", path.c_str(), bars.size()).c_str());
 
@@ -468,6 +409,64 @@ void trans_csv_bars(WtString csvFolder, WtString binFolder, WtString period, Fun
 	}
 }
 
+void trans_csv_ticks(WtString csvFolder, WtString binFolder, FuncLogCallback cbLogger /* = NULL */)
+{
+	if (!BoostFile::exists(csvFolder))
+		return;
+
+	if (!BoostFile::exists(binFolder))
+		BoostFile::create_directories(binFolder);
+
+	boost::filesystem::path myPath(csvFolder);
+	boost::filesystem::directory_iterator endIter;
+	for (boost::filesystem::directory_iterator iter(myPath); iter != endIter; iter++)
+	{
+		if (boost::filesystem::is_directory(iter->path()))
+			continue;
+
+		if (iter->path().extension() != ".csv")
+			continue;
+
+		const std::string& path = iter->path().string();
+
+		if (cbLogger)
+			cbLogger(StrUtil::printf("正在读取数据文件%s...", path.c_str()).c_str());
+
+		std::vector<WTSTickStruct> ticks;
+		if (CsvLoader::load_ticks(path.c_str(), ticks) == 0)
+		{
+			if (cbLogger)
+				cbLogger(StrUtil::printf("读取数据文件%s失败...", path.c_str()).c_str());
+			continue;
+		}
+
+		if (cbLogger)
+			cbLogger(StrUtil::printf("数据文件%s全部读取完成,共%u条", path.c_str(), ticks.size()).c_str());
+
+		HisTickBlockV2 tBlock;
+		strcpy(tBlock._blk_flag, BLK_FLAG);
+		tBlock._type = BT_HIS_Ticks;
+		tBlock._version = BLOCK_VERSION_CMP_V2;
+
+		std::string cmprsData = WTSCmpHelper::compress_data(ticks.data(), sizeof(WTSTickStruct)*ticks.size());
+		tBlock._size = cmprsData.size();
+
+		std::string filename = StrUtil::standardisePath(binFolder);
+		filename += iter->path().stem().string();
+		filename += ".dsb";
+
+		BoostFile bf;
+		if (bf.create_new_file(filename.c_str()))
+		{
+			bf.write_file(&tBlock, sizeof(HisTickBlockV2));
+		}
+		bf.write_file(cmprsData);
+		bf.close_file();
+		if (cbLogger)
+			cbLogger(StrUtil::printf("数据已转储至%s", filename.c_str()).c_str());
+	}
+}
+
 //bool trans_bars(WtString barFile, FuncGetBarItem getter, int count, WtString period, FuncLogCallback cbLogger /* = NULL */)
 //{
 //	if (count == 0)
@@ -815,8 +814,23 @@ WtUInt32 read_dmb_ticks(WtString tickFile, FuncGetTicksCallback cb, FuncCountDat
 		return 0;
 	}
 
+	//盘中封存过的，前面的页面已经释放了，要从封存文件拼回来
+	WTSTickStruct* ticks = tBlock->_ticks;
+	uint32_t sealed = RTSealHelper::sealed_count(path.c_str(), tBlock->_date);
+	std::string sealCmp, sealRaw;
+	if (sealed > 0)
+	{
+		ticks = RTSealHelper::restore(path.c_str(), tBlock->_date, ticks, tcnt, sealed, sealCmp, sealRaw);
+		if (ticks == NULL)
+		{
+			if (cbLogger)
+				cbLogger(StrUtil::printf("封存文件%s读取失败", RTSealHelper::seal_file(path.c_str()).c_str()).c_str());
+			return 0;
+		}
+	}
+
 	cbCnt(tcnt);
-	cb(tBlock->_ticks, tcnt, true);
+	cb(ticks, tcnt, true);
 
 	if (cbLogger)
 		cbLogger(StrUtil::printf("%s读取完成,共%u条tick数据", tickFile, tcnt).c_str());
@@ -1229,4 +1243,432 @@ bool store_transactions(WtString tickFile, WTSTransStruct* firstItem, int count,
 		cbLogger("Write transactions to file succeedd");
 
 	return true;
+}
+
+WtUInt32 build_his_catalog(WtString storageFolder, WtString dataType, WtString exchg, FuncLogCallback cbLogger/* = NULL*/)
+{
+	std::string folder = StrUtil::printf("%shis/%s/%s/", StrUtil::standardisePath(storageFolder).c_str(), dataType, exchg);
+	if (cbLogger)
+		cbLogger(StrUtil::printf("正在扫描目录%s...", folder.c_str()).c_str());
+
+	HisDataCatalog catalog;
+	uint32_t count = 0;
+	if (strcmp(dataType, "ticks") == 0)
+		count = catalog.rebuild<WTSTickStruct>(folder.c_str());
+	else if (strcmp(dataType, "orders") == 0)
+		count = catalog.rebuild<WTSOrdDtlStruct>(folder.c_str());
+	else if (strcmp(dataType, "queue") == 0)
+		count = catalog.rebuild<WTSOrdQueStruct>(folder.c_str());
+	else if (strcmp(dataType, "trans") == 0)
+		count = catalog.rebuild<WTSTransStruct>(folder.c_str());
+	else
+	{
+		if (cbLogger)
+			cbLogger(StrUtil::printf("不支持的数据类型%s", dataType).c_str());
+		return 0;
+	}
+
+	if (!catalog.save())
+	{
+		if (cbLogger)
+			cbLogger(StrUtil::printf("目录%s保存失败", folder.c_str()).c_str());
+		return 0;
+	}
+
+	if (cbLogger)
+		cbLogger(StrUtil::printf("目录%s重建完成,共扫描%u个文件", folder.c_str(), count).c_str());
+
+	return count;
+}
+
+WtUInt32 read_his_catalog(WtString storageFolder, WtString dataType, WtString exchg, WtString code, FuncGetCatalogCallback cb, FuncLogCallback cbLogger/* = NULL*/)
+{
+	std::string filename = HisDataCatalog::catalog_file(StrUtil::standardisePath(storageFolder).c_str(), dataType, exchg);
+
+	HisDataCatalog catalog;
+	if (!catalog.load(filename.c_str()))
+	{
+		if (cbLogger)
+			cbLogger(StrUtil::printf("目录文件%s不存在,请先调用build_his_catalog", filename.c_str()).c_str());
+		return 0;
+	}
+
+	uint32_t count = 0;
+	auto cbItems = [&count, cb](const std::string& curCode, const HisDataCatalog::DateItems& dates) {
+		for (auto& v : dates)
+		{
+			const HisDataCatalog::CatalogItem& item = v.second;
+			cb(curCode.c_str(), item._date, item._count, item._stime, item._etime, item._size, item._version);
+			count++;
+		}
+	};
+
+	if (code != NULL && strlen(code) > 0)
+	{
+		const HisDataCatalog::DateItems* dates = catalog.get_dates(code);
+		if (dates != NULL)
+			cbItems(code, *dates);
+	}
+	else
+	{
+		for (auto& v : catalog.items())
+			cbItems(v.first, v.second);
+	}
+
+	return count;
+}
+
+/*
+ *	Arrow导出的列定义
+ *	数组字段按元素展开成多列，列名后面加下标
+ */
+static void add_array_fields(ArrowFields& fields, const char* prefix, ArrowColType type, uint32_t offset, uint32_t count, uint32_t width)
+{
+	for (uint32_t i = 0; i < count; i++)
+		fields.emplace_back(ArrowField(StrUtil::printf("%s_%u", prefix, i).c_str(), type, offset + i * width));
+}
+
+#define ARROW_FIELD(S, name, type)	ArrowField(#name, type, (uint32_t)offsetof(S, name))
+#define ARROW_CODE_FIELDS(S)	ArrowField("exchg", ACT_Utf8, (uint32_t)offsetof(S, exchg), MAX_EXCHANGE_LENGTH), \
+								ArrowField("code", ACT_Utf8, (uint32_t)offsetof(S, code), MAX_INSTRUMENT_LENGTH)
+
+//K线结构体里没有代码，导出的时候带上代码，多个代码可以写在同一个文件里
+typedef struct _ArrowBar
+{
+	char			exchg[MAX_EXCHANGE_LENGTH];
+	char			code[MAX_INSTRUMENT_LENGTH];
+	WTSBarStruct	bar;
+} ArrowBar;
+
+static ArrowFields bar_fields()
+{
+	uint32_t base = (uint32_t)offsetof(ArrowBar, bar);
+	return {
+		ARROW_CODE_FIELDS(ArrowBar),
+		ArrowField("date", ACT_UInt32, base + (uint32_t)offsetof(WTSBarStruct, date)),
+		ArrowField("time", ACT_UInt64, base + (uint32_t)offsetof(WTSBarStruct, time)),
+		ArrowField("open", ACT_Double, base + (uint32_t)offsetof(WTSBarStruct, open)),
+		ArrowField("high", ACT_Double, base + (uint32_t)offsetof(WTSBarStruct, high)),
+		ArrowField("low", ACT_Double, base + (uint32_t)offsetof(WTSBarStruct, low)),
+		ArrowField("close", ACT_Double, base + (uint32_t)offsetof(WTSBarStruct, close)),
+		ArrowField("settle", ACT_Double, base + (uint32_t)offsetof(WTSBarStruct, settle)),
+		ArrowField("money", ACT_Double, base + (uint32_t)offsetof(WTSBarStruct, money)),
+		ArrowField("vol", ACT_Double, base + (uint32_t)offsetof(WTSBarStruct, vol)),
+		ArrowField("hold", ACT_Double, base + (uint32_t)offsetof(WTSBarStruct, hold)),
+		ArrowField("add", ACT_Double, base + (uint32_t)offsetof(WTSBarStruct, add))
+	};
+}
+
+static ArrowFields tick_fields()
+{
+	ArrowFields fields = {
+		ARROW_CODE_FIELDS(WTSTickStruct),
+		ARROW_FIELD(WTSTickStruct, price, ACT_Double),
+		ARROW_FIELD(WTSTickStruct, open, ACT_Double),
+		ARROW_FIELD(WTSTickStruct, high, ACT_Double),
+		ARROW_FIELD(WTSTickStruct, low, ACT_Double),
+		ARROW_FIELD(WTSTickStruct, settle_price, ACT_Double),
+		ARROW_FIELD(WTSTickStruct, upper_limit, ACT_Double),
+		ARROW_FIELD(WTSTickStruct, lower_limit, ACT_Double),
+		ARROW_FIELD(WTSTickStruct, total_volume, ACT_Double),
+		ARROW_FIELD(WTSTickStruct, volume, ACT_Double),
+		ARROW_FIELD(WTSTickStruct, total_turnover, ACT_Double),
+		ARROW_FIELD(WTSTickStruct, turn_over, ACT_Double),
+		ARROW_FIELD(WTSTickStruct, open_interest, ACT_Double),
+		ARROW_FIELD(WTSTickStruct, diff_interest, ACT_Double),
+		ARROW_FIELD(WTSTickStruct, trading_date, ACT_UInt32),
+		ARROW_FIELD(WTSTickStruct, action_date, ACT_UInt32),
+		ARROW_FIELD(WTSTickStruct, action_time, ACT_UInt32),
+		ARROW_FIELD(WTSTickStruct, pre_close, ACT_Double),
+		ARROW_FIELD(WTSTickStruct, pre_settle, ACT_Double),
+		ARROW_FIELD(WTSTickStruct, pre_interest, ACT_Double)
+	};
+	add_array_fields(fields, "bid_price", ACT_Double, (uint32_t)offsetof(WTSTickStruct, bid_prices), 10, sizeof(double));
+	add_array_fields(fields, "ask_price", ACT_Double, (uint32_t)offsetof(WTSTickStruct, ask_prices), 10, sizeof(double));
+	add_array_fields(fields, "bid_qty", ACT_Double, (uint32_t)offsetof(WTSTickStruct, bid_qty), 10, sizeof(double));
+	add_array_fields(fields, "ask_qty", ACT_Double, (uint32_t)offsetof(WTSTickStruct, ask_qty), 10, sizeof(double));
+	return fields;
+}
+
+static ArrowFields ordque_fields()
+{
+	ArrowFields fields = {
+		ARROW_CODE_FIELDS(WTSOrdQueStruct),
+		ARROW_FIELD(WTSOrdQueStruct, trading_date, ACT_UInt32),
+		ARROW_FIELD(WTSOrdQueStruct, action_date, ACT_UInt32),
+		ARROW_FIELD(WTSOrdQueStruct, action_time, ACT_UInt32),
+		ARROW_FIELD(WTSOrdQueStruct, side, ACT_UInt32),
+		ARROW_FIELD(WTSOrdQueStruct, price, ACT_Double),
+		ARROW_FIELD(WTSOrdQueStruct, order_items, ACT_UInt32),
+		ARROW_FIELD(WTSOrdQueStruct, qsize, ACT_UInt32)
+	};
+	add_array_fields(fields, "volume", ACT_UInt32, (uint32_t)offsetof(WTSOrdQueStruct, volumes), 50, sizeof(uint32_t));
+	return fields;
+}
+
+static ArrowFields orddtl_fields()
+{
+	return {
+		ARROW_CODE_FIELDS(WTSOrdDtlStruct),
+		ARROW_FIELD(WTSOrdDtlStruct, trading_date, ACT_UInt32),
+		ARROW_FIELD(WTSOrdDtlStruct, action_date, ACT_UInt32),
+		ARROW_FIELD(WTSOrdDtlStruct, action_time, ACT_UInt32),
+		ARROW_FIELD(WTSOrdDtlStruct, index, ACT_UInt64),
+		ARROW_FIELD(WTSOrdDtlStruct, price, ACT_Double),
+		ARROW_FIELD(WTSOrdDtlStruct, volume, ACT_UInt32),
+		ARROW_FIELD(WTSOrdDtlStruct, side, ACT_UInt32),
+		ARROW_FIELD(WTSOrdDtlStruct, otype, ACT_UInt32)
+	};
+}
+
+static ArrowFields trans_fields()
+{
+	return {
+		ARROW_CODE_FIELDS(WTSTransStruct),
+		ARROW_FIELD(WTSTransStruct, trading_date, ACT_UInt32),
+		ARROW_FIELD(WTSTransStruct, action_date, ACT_UInt32),
+		ARROW_FIELD(WTSTransStruct, action_time, ACT_UInt32),
+		ARROW_FIELD(WTSTransStruct, index, ACT_Int64),
+		ARROW_FIELD(WTSTransStruct, ttype, ACT_UInt32),
+		ARROW_FIELD(WTSTransStruct, side, ACT_UInt32),
+		ARROW_FIELD(WTSTransStruct, price, ACT_Double),
+		ARROW_FIELD(WTSTransStruct, volume, ACT_UInt32),
+		ARROW_FIELD(WTSTransStruct, askorder, ACT_Int64),
+		ARROW_FIELD(WTSTransStruct, bidorder, ACT_Int64)
+	};
+}
+
+/*
+ *	按日存储的高频数据导出，目录结构为{folder}/{date}/{code}.dsb
+ *	按代码、日期的顺序，每个文件写一个record batch
+ */
+template<typename T>
+static uint64_t export_daily_arrow(ArrowWriter& writer, const std::string& folder, StringVector codes, uint32_t sDate, uint32_t eDate, FuncLogCallback cbLogger)
+{
+	std::vector<uint32_t> dates;
+	std::set<std::string> allCodes;
+	boost::filesystem::directory_iterator endIter;
+	for (boost::filesystem::directory_iterator iter(folder); iter != endIter; iter++)
+	{
+		if (!boost::filesystem::is_directory(iter->path()))
+			continue;
+
+		uint32_t uDate = strtoul(iter->path().filename().string().c_str(), NULL, 10);
+		if (uDate == 0 || (sDate != 0 && uDate < sDate) || (eDate != 0 && uDate > eDate))
+			continue;
+
+		dates.emplace_back(uDate);
+
+		//没有指定代码，就导出全部代码
+		if (codes.empty())
+		{
+			for (boost::filesystem::directory_iterator fIter(iter->path()); fIter != endIter; fIter++)
+			{
+				if (fIter->path().extension() == ".dsb")
+					allCodes.insert(fIter->path().stem().string());
+			}
+		}
+	}
+	std::sort(dates.begin(), dates.end());
+
+	if (codes.empty())
+		codes.assign(allCodes.begin(), allCodes.end());
+
+	uint64_t total = 0;
+	for (const std::string& code : codes)
+	{
+		for (uint32_t uDate : dates)
+		{
+			std::string path = StrUtil::printf("%s%u/%s.dsb", folder.c_str(), uDate, code.c_str());
+			if (!BoostFile::exists(path.c_str()))
+				continue;
+
+			std::string content;
+			BoostFile::read_file_contents(path.c_str(), content);
+			if (content.size() < BLOCK_HEADER_SIZE || !proc_block_data(content, false, false))
+			{
+				if (cbLogger)
+					cbLogger(StrUtil::printf("文件%s头部校验失败", path.c_str()).c_str());
+				continue;
+			}
+
+			uint32_t count = (uint32_t)(content.size() / sizeof(T));
+			writer.write_batch(content.data(), count, sizeof(T));
+			total += count;
+		}
+	}
+
+	return total;
+}
+
+static uint64_t export_bars_arrow(ArrowWriter& writer, const std::string& folder, const char* exchg, StringVector codes, uint32_t sDate, uint32_t eDate, FuncLogCallback cbLogger)
+{
+	if (codes.empty())
+	{
+		boost::filesystem::directory_iterator endIter;
+		for (boost::filesystem::directory_iterator iter(folder); iter != endIter; iter++)
+		{
+			if (iter->path().extension() == ".dsb")
+				codes.emplace_back(iter->path().stem().string());
+		}
+		std::sort(codes.begin(), codes.end());
+	}
+
+	uint64_t total = 0;
+	std::vector<ArrowBar> items;
+	for (const std::string& code : codes)
+	{
+		std::string path = folder + code + ".dsb";
+		if (!BoostFile::exists(path.c_str()))
+			continue;
+
+		std::string content;
+		BoostFile::read_file_contents(path.c_str(), content);
+		if (content.size() < sizeof(HisKlineBlock) || !proc_block_data(content, true, false))
+		{
+			if (cbLogger)
+				cbLogger(StrUtil::printf("文件%s头部校验失败", path.c_str()).c_str());
+			continue;
+		}
+
+		const WTSBarStruct* bars = (const WTSBarStruct*)content.data();
+		uint32_t kcnt = (uint32_t)(content.size() / sizeof(WTSBarStruct));
+		items.clear();
+		items.reserve(kcnt);
+		for (uint32_t i = 0; i < kcnt; i++)
+		{
+			const WTSBarStruct& curBar = bars[i];
+			if ((sDate != 0 && curBar.date < sDate) || (eDate != 0 && curBar.date > eDate))
+				continue;
+
+			items.emplace_back();
+			ArrowBar& item = items.back();
+			wt_strcpy(item.exchg, exchg);
+			wt_strcpy(item.code, code.c_str());
+			item.bar = curBar;
+		}
+
+		writer.write_batch(items.data(), (uint32_t)items.size(), sizeof(ArrowBar));
+		total += items.size();
+	}
+
+	return total;
+}
+
+WtUInt64 export_his_arrow(WtString storageFolder, WtString dataType, WtString exchg, WtString codes, WtUInt32 sDate, WtUInt32 eDate, WtString arrowFile, FuncLogCallback cbLogger/* = NULL*/)
+{
+	std::string folder = StrUtil::printf("%shis/%s/%s/", StrUtil::standardisePath(storageFolder).c_str(), dataType, exchg);
+	if (!BoostFile::exists(folder.c_str()))
+	{
+		if (cbLogger)
+			cbLogger(StrUtil::printf("目录%s不存在", folder.c_str()).c_str());
+		return 0;
+	}
+
+	StringVector ayCodes;
+	if (codes != NULL && strlen(codes) > 0)
+		ayCodes = StrUtil::split(codes, ",");
+
+	bool isBar = false;
+	ArrowFields fields;
+	if (strcmp(dataType, "ticks") == 0)
+		fields = tick_fields();
+	else if (strcmp(dataType, "orders") == 0)
+		fields = orddtl_fields();
+	else if (strcmp(dataType, "queue") == 0)
+		fields = ordque_fields();
+	else if (strcmp(dataType, "trans") == 0)
+		fields = trans_fields();
+	else
+	{
+		//其他的都当作K线目录，如min1/min5/day
+		isBar = true;
+		fields = bar_fields();
+	}
+
+	ArrowWriter writer;
+	if (!writer.open(arrowFile, fields))
+	{
+		if (cbLogger)
+			cbLogger(StrUtil::printf("文件%s创建失败", arrowFile).c_str());
+		return 0;
+	}
+
+	uint64_t total = 0;
+	if (isBar)
+		total = export_bars_arrow(writer, folder, exchg, ayCodes, sDate, eDate, cbLogger);
+	else if (strcmp(dataType, "ticks") == 0)
+		total = export_daily_arrow<WTSTickStruct>(writer, folder, ayCodes, sDate, eDate, cbLogger);
+	else if (strcmp(dataType, "orders") == 0)
+		total = export_daily_arrow<WTSOrdDtlStruct>(writer, folder, ayCodes, sDate, eDate, cbLogger);
+	else if (strcmp(dataType, "queue") == 0)
+		total = export_daily_arrow<WTSOrdQueStruct>(writer, folder, ayCodes, sDate, eDate, cbLogger);
+	else
+		total = export_daily_arrow<WTSTransStruct>(writer, folder, ayCodes, sDate, eDate, cbLogger);
+
+	writer.close();
+
+	if (cbLogger)
+		cbLogger(StrUtil::printf("%s导出完成,共%llu条数据", arrowFile, total).c_str());
+
+	return total;
+}
+
+//打开的Arrow文件，句柄之间互不影响，不同的文件可以在不同的线程里并行读取
+static StdUniqueMutex	g_arrow_mtx;
+static wt_hashmap<uint32_t, std::shared_ptr<ArrowReader>>	g_arrow_files;
+static uint32_t			g_arrow_seed = 0;
+
+static std::shared_ptr<ArrowReader> get_arrow_file(WtUInt32 handle)
+{
+	StdUniqueLock lock(g_arrow_mtx);
+	auto it = g_arrow_files.find(handle);
+	if (it == g_arrow_files.end())
+		return std::shared_ptr<ArrowReader>();
+
+	return it->second;
+}
+
+WtUInt32 open_arrow_file(WtString arrowFile, FuncLogCallback cbLogger/* = NULL*/)
+{
+	std::shared_ptr<ArrowReader> reader(new ArrowReader);
+	std::string errmsg;
+	if (!reader->open(arrowFile, errmsg))
+	{
+		if (cbLogger)
+			cbLogger(errmsg.c_str());
+		return 0;
+	}
+
+	StdUniqueLock lock(g_arrow_mtx);
+	uint32_t handle = ++g_arrow_seed;
+	g_arrow_files[handle] = reader;
+	return handle;
+}
+
+WtUInt32 read_arrow_columns(WtUInt32 handle, FuncGetColumnCallback cb)
+{
+	std::shared_ptr<ArrowReader> reader = get_arrow_file(handle);
+	if (!reader)
+		return 0;
+
+	const ArrowFields& fields = reader->fields();
+	const auto& batches = reader->batches();
+	for (uint32_t b = 0; b < batches.size(); b++)
+	{
+		const ArrowReader::BatchData& batch = batches[b];
+		for (std::size_t i = 0; i < fields.size(); i++)
+		{
+			const ArrowReader::ColumnData& col = batch._columns[i];
+			cb(b, fields[i]._name.c_str(), fields[i]._type, col._data, col._offsets, col._count);
+		}
+	}
+
+	return (WtUInt32)batches.size();
+}
+
+void close_arrow_file(WtUInt32 handle)
+{
+	StdUniqueLock lock(g_arrow_mtx);
+	g_arrow_files.erase(handle);
 }
\ No newline at end of file
@@ -28,6 +28,8 @@ typedef void(PORTER_FLAG *FuncGetOrdDtlCallback)(WTSOrdDtlStruct* item, WtUInt32
 typedef void(PORTER_FLAG *FuncGetOrdQueCallback)(WTSOrdQueStruct* item, WtUInt32 count, bool isLast);
 typedef void(PORTER_FLAG *FuncGetTransCallback)(WTSTransStruct* item, WtUInt32 count, bool isLast);
 typedef void(PORTER_FLAG *FuncCountDataCallback)(WtUInt32 dataCnt);
+typedef void(PORTER_FLAG *FuncGetColumnCallback)(WtUInt32 batchIdx, WtString colName, WtUInt32 colType, const void* data, const int* offsets, WtUInt64 count);
+typedef void(PORTER_FLAG *FuncGetCatalogCallback)(WtString code, WtUInt32 uDate, WtUInt32 count, WtUInt64 stime, WtUInt64 etime, WtUInt64 fsize, WtUInt32 version);
 
 //改成直接从python传内存块的方式
 //typedef bool(PORTER_FLAG *FuncGetBarItem)(WTSBarStruct* curBar,int idx);
@@ -40,6 +42,7 @@ extern "C"
 	EXPORT_FLAG	void		dump_bars(WtString binFolder, WtString csvFolder, WtString strFilter = "", FuncLogCallback cbLogger = NULL);
 	EXPORT_FLAG	void		dump_ticks(WtString binFolder, WtString csvFolder, WtString strFilter = "", FuncLogCallback cbLogger = NULL);
 	EXPORT_FLAG	void		trans_csv_bars(WtString csvFolder, WtString binFolder, WtString period, FuncLogCallback cbLogger = NULL);
+	EXPORT_FLAG	void		trans_csv_ticks(WtString csvFolder, WtString binFolder, FuncLogCallback cbLogger = NULL);
 
 	EXPORT_FLAG	WtUInt32	read_dsb_ticks(WtString tickFile, FuncGetTicksCallback cb, FuncCountDataCallback cbCnt, FuncLogCallback cbLogger = NULL);
 	EXPORT_FLAG	WtUInt32	read_dsb_order_details(WtString dataFile, FuncGetOrdDtlCallback cb, FuncCountDataCallback cbCnt, FuncLogCallback cbLogger = NULL);
@@ -62,8 +65,37 @@ extern "C"
 	EXPORT_FLAG bool		store_order_queues(WtString tickFile, WTSOrdQueStruct* firstItem, int count, FuncLogCallback cbLogger = NULL);
 	EXPORT_FLAG bool		store_transactions(WtString tickFile, WTSTransStruct* firstItem, int count, FuncLogCallback cbLogger = NULL);
 
+	/*
+	 *	历史高频数据目录
+	 *	@storageFolder	数据存储根目录，即his的上级目录
+	 *	@dataType		ticks/orders/queue/trans
+	 *	build_his_catalog扫描所有日期目录重建目录文件，返回扫描的文件数
+	 *	read_his_catalog按代码和日期顺序回调目录项，code为空则返回全部代码，返回目录项数
+	 */
+	EXPORT_FLAG WtUInt32	build_his_catalog(WtString storageFolder, WtString dataType, WtString exchg, FuncLogCallback cbLogger = NULL);
+	EXPORT_FLAG WtUInt32	read_his_catalog(WtString storageFolder, WtString dataType, WtString exchg, WtString code, FuncGetCatalogCallback cb, FuncLogCallback cbLogger = NULL);
+
 	EXPORT_FLAG WtUInt32	resample_bars(WtString barFile, FuncGetBarsCallback cb, FuncCountDataCallback cbCnt, 
 		WtUInt64 fromTime, WtUInt64 endTime, WtString period, WtUInt32 times, WtString sessInfo, FuncLogCallback cbLogger = NULL, bool bAlignSec = false);
+
+	/*
+	 *	导出Arrow IPC文件(Feather V2)
+	 *	@storageFolder	数据存储根目录，即his的上级目录
+	 *	@dataType		ticks/orders/queue/trans，其他的当作K线目录，如min1/min5/day
+	 *	@codes			代码，多个用逗号分隔，为空则导出全部代码
+	 *	@sDate/eDate	交易日区间，0表示不限
+	 *	每个代码每个数据文件写一个record batch，返回导出的数据条数
+	 */
+	EXPORT_FLAG WtUInt64	export_his_arrow(WtString storageFolder, WtString dataType, WtString exchg, WtString codes, WtUInt32 sDate, WtUInt32 eDate, WtString arrowFile, FuncLogCallback cbLogger = NULL);
+
+	/*
+	 *	映射打开Arrow IPC文件，返回句柄，0表示失败
+	 *	read_arrow_columns按record batch、列的顺序回调，数据直接指向映射区，句柄关闭之前一直有效
+	 *	colType见ArrowColType，字符串列的offsets是count+1个int32的偏移量，其他列为NULL
+	 */
+	EXPORT_FLAG WtUInt32	open_arrow_file(WtString arrowFile, FuncLogCallback cbLogger = NULL);
+	EXPORT_FLAG WtUInt32	read_arrow_columns(WtUInt32 handle, FuncGetColumnCallback cb);
+	EXPORT_FLAG void		close_arrow_file(WtUInt32 handle);
 #ifdef __cplusplus
 }
 #endif
\ No newline at end of file
@@ -140,6 +140,13 @@ void WtDtRunner::initialize(const char* cfgFile, const char* logCfg, const char*
 		}
 	}
 
+	//交易日历的预计算区间，不配置的话默认为19900101-20501231
+	if (cfgBF->has("calendar"))
+	{
+		WTSVariant* cfgCal = cfgBF->get("calendar");
+		_bd_mgr.setCalendarRange(cfgCal->getUInt32("begin"), cfgCal->getUInt32("end"));
+	}
+
 	if (cfgBF->get("holiday"))
 	{
 		_bd_mgr.loadHolidays(cfgBF->getCString("holiday"));
@@ -25,3 +25,9 @@ typedef void(PORTER_FLAG *FuncCountDataCallback)(WtUInt32 dataCnt);
 typedef void(PORTER_FLAG *FuncOnTickCallback)(const char* stdCode, WTSTickStruct* tick);
 typedef void(PORTER_FLAG *FuncOnBarCallback)(const char* stdCode, const char* period, WTSBarStruct* bar);
 
+//批量读取，每个代码回调一次，isLast表示是最后一个代码
+typedef void(PORTER_FLAG *FuncGetBatchBarsCallback)(const char* stdCode, WTSBarStruct* bar, WtUInt32 count, bool isLast);
+typedef void(PORTER_FLAG *FuncGetBatchTicksCallback)(const char* stdCode, WTSTickStruct* tick, WtUInt32 count, bool isLast);
+//面板数据，全部代码的K线按照请求的代码顺序连续存放，counts为每个代码的K线条数
+typedef void(PORTER_FLAG *FuncGetBarsPanelCallback)(WTSBarStruct* bars, WtUInt32* counts, WtUInt32 codeCnt);
+
@@ -23,11 +23,15 @@
 #include "../Share/StdUtils.hpp"
 #include "../Share/CodeHelper.hpp"
 
+#include <deque>
+
 USING_NS_WTP;
 
 WtDtRunner::WtDtRunner()
 	: _data_store(NULL)
 	, _is_inited(false)
+	, _data_cfg(NULL)
+	, _batch_workers(0)
 {
 	install_signal_hooks([](const char* message) {
 		WTSLogger::error(message);
@@ -37,6 +41,8 @@ WtDtRunner::WtDtRunner()
 
 WtDtRunner::~WtDtRunner()
 {
+	if (_data_cfg)
+		_data_cfg->release();
 }
 #ifdef _MSC_VER
 #include "../Common/mdump.h"
@@ -112,6 +118,13 @@ void WtDtRunner::initialize(const char* cfgFile, bool isFile /* = true */, const
 		}
 	}
 
+	//交易日历的预计算区间，不配置的话默认为19900101-20501231
+	if (cfgBF->has("calendar"))
+	{
+		WTSVariant* cfgCal = cfgBF->get("calendar");
+		_bd_mgr.setCalendarRange(cfgCal->getUInt32("begin"), cfgCal->getUInt32("end"));
+	}
+
 	if (cfgBF->get("holiday"))
 	{
 		_bd_mgr.loadHolidays(cfgBF->getCString("holiday"));
@@ -198,9 +211,218 @@ void WtDtRunner::initDataMgr(WTSVariant* config)
 
 	_data_mgr.init(config, this);
 
+	//批量读取的工作线程数
+	//每个工作线程都有一份完整的数据管理器缓存，默认取CPU核数的一半，最多4个
+	_data_cfg = config;
+	_data_cfg->retain();
+	_batch_workers = config->getUInt32("batch_workers");
+	if (_batch_workers == 0)
+		_batch_workers = std::min(std::max(std::thread::hardware_concurrency() / 2, 1U), 4U);
+
 	WTSLogger::info("Data manager initialized");
 }
 
+void WtDtRunner::initBatchWorkers()
+{
+	if (!_batch_mgrs.empty() || _data_cfg == NULL)
+		return;
+
+	for (uint32_t i = 0; i < _batch_workers; i++)
+	{
+		std::shared_ptr<WtDataManager> mgr(new WtDataManager());
+		mgr->init(_data_cfg, this);
+		_batch_mgrs.emplace_back(mgr);
+	}
+
+	WTSLogger::info("{} batch workers of data manager initialized", _batch_workers);
+}
+
+template<typename T>
+uint32_t WtDtRunner::run_batch(const StringVector& codes, const std::function<void(WtDataManager*, const char*, std::vector<T>&)>& loader,
+	const std::function<void(uint32_t, const char*, std::vector<T>&)>& cb)
+{
+	//工作数据管理器不是线程安全的，同一时间只能有一个批量请求
+	StdUniqueLock lock(_mtx_batch);
+	initBatchWorkers();
+
+	if (codes.empty() || _batch_mgrs.empty())
+		return 0;
+
+	typedef struct _BatchResult
+	{
+		uint32_t		_idx;
+		std::vector<T>	_items;
+	} BatchResult;
+	typedef std::shared_ptr<BatchResult> BatchResultPtr;
+
+	std::deque<BatchResultPtr>	results;
+	StdUniqueMutex	mtx;
+	StdCondVariable	cond;
+
+	//按照代码哈希分片，分片数固定为工作数据管理器的个数，和本次请求的代码数无关
+	//这样同一个代码总是由同一个数据管理器读取，重复请求的时候可以命中缓存
+	uint32_t workers = (uint32_t)_batch_mgrs.size();
+	std::vector<std::vector<uint32_t>> shards(workers);
+	for (uint32_t idx = 0; idx < codes.size(); idx++)
+		shards[std::hash<std::string>()(codes[idx]) % workers].emplace_back(idx);
+
+	std::vector<StdThreadPtr> threads;
+	for (uint32_t wIdx = 0; wIdx < workers; wIdx++)
+	{
+		//没有分到代码的分片不用起线程
+		if (shards[wIdx].empty())
+			continue;
+
+		threads.emplace_back(new StdThread([&, wIdx]() {
+			WtDataManager* mgr = _batch_mgrs[wIdx].get();
+			for (uint32_t idx : shards[wIdx])
+			{
+				BatchResultPtr res(new BatchResult);
+				res->_idx = idx;
+				try
+				{
+					loader(mgr, codes[idx].c_str(), res->_items);
+				}
+				catch (std::exception& e)
+				{
+					WTSLogger::error("Exception raised while loading data of {} in batch: {}", codes[idx], e.what());
+					res->_items.clear();
+				}
+
+				{
+					StdUniqueLock lck(mtx);
+					results.emplace_back(res);
+				}
+				cond.notify_all();
+			}
+		}));
+	}
+
+	uint32_t total = 0;
+	for (uint32_t done = 0; done < codes.size(); done++)
+	{
+		BatchResultPtr res;
+		{
+			StdUniqueLock lck(mtx);
+			cond.wait(lck, [&results]() { return !results.empty(); });
+			res = results.front();
+			results.pop_front();
+		}
+
+		total += (uint32_t)res->_items.size();
+		cb(res->_idx, codes[res->_idx].c_str(), res->_items);
+	}
+
+	for (auto& thrd : threads)
+		thrd->join();
+
+	return total;
+}
+
+//把切片的数据拷贝出来，切片引用的是工作线程的缓存
+template<typename S, typename T>
+inline void copy_slice(S* slice, std::vector<T>& items)
+{
+	if (slice == NULL)
+		return;
+
+	items.reserve(slice->size());
+	for (std::size_t i = 0; i < slice->get_block_counts(); i++)
+	{
+		T* addr = slice->get_block_addr(i);
+		items.insert(items.end(), addr, addr + slice->get_block_size(i));
+	}
+	slice->release();
+}
+
+inline void parse_period(const char* period, WTSKlinePeriod& kp, uint32_t& realTimes)
+{
+	uint32_t times = 1;
+	if (strlen(period) > 1)
+		times = strtoul(period + 1, NULL, 10);
+
+	realTimes = times;
+	if (period[0] == 'm')
+	{
+		if (times % 5 == 0)
+		{
+			kp = KP_Minute5;
+			realTimes /= 5;
+		}
+		else
+		{
+			kp = KP_Minute1;
+		}
+	}
+	else
+		kp = KP_DAY;
+}
+
+uint32_t WtDtRunner::get_bars_batch_by_range(const StringVector& codes, const char* period, uint64_t beginTime, uint64_t endTime, FuncBatchBars cb)
+{
+	if (!_is_inited)
+	{
+		WTSLogger::error("WtDtServo not initialized");
+		return 0;
+	}
+
+	WTSKlinePeriod kp;
+	uint32_t realTimes;
+	parse_period(period, kp, realTimes);
+
+	if (endTime == 0)
+	{
+		uint32_t curDate = TimeUtils::getCurDate();
+		endTime = (uint64_t)curDate * 10000 + 2359;
+	}
+
+	return run_batch<WTSBarStruct>(codes, [kp, realTimes, beginTime, endTime](WtDataManager* mgr, const char* stdCode, std::vector<WTSBarStruct>& items) {
+		copy_slice(mgr->get_kline_slice_by_range(stdCode, kp, realTimes, beginTime, endTime), items);
+	}, cb);
+}
+
+uint32_t WtDtRunner::get_bars_batch_by_count(const StringVector& codes, const char* period, uint32_t count, uint64_t endTime, FuncBatchBars cb)
+{
+	if (!_is_inited)
+	{
+		WTSLogger::error("WtDtServo not initialized");
+		return 0;
+	}
+
+	WTSKlinePeriod kp;
+	uint32_t realTimes;
+	parse_period(period, kp, realTimes);
+
+	if (endTime == 0)
+	{
+		uint32_t curDate = TimeUtils::getCurDate();
+		endTime = (uint64_t)curDate * 10000 + 2359;
+	}
+
+	return run_batch<WTSBarStruct>(codes, [kp, realTimes, count, endTime](WtDataManager* mgr, const char* stdCode, std::vector<WTSBarStruct>& items) {
+		copy_slice(mgr->get_kline_slice_by_count(stdCode, kp, realTimes, count, endTime), items);
+	}, cb);
+}
+
+uint32_t WtDtRunner::get_ticks_batch_by_range(const StringVector& codes, uint64_t beginTime, uint64_t endTime, FuncBatchTicks cb)
+{
+	if (!_is_inited)
+	{
+		WTSLogger::error("WtDtServo not initialized");
+		return 0;
+	}
+
+	if (endTime == 0)
+	{
+		uint32_t curDate = TimeUtils::getCurDate();
+		endTime = (uint64_t)curDate * 10000 + 2359;
+	}
+
+	return run_batch<WTSTickStruct>(codes, [beginTime, endTime](WtDataManager* mgr, const char* stdCode, std::vector<WTSTickStruct>& items) {
+		copy_slice(mgr->get_tick_slices_by_range(stdCode, beginTime, endTime), items);
+	}, cb);
+}
+
 WTSKlineSlice* WtDtRunner::get_bars_by_range(const char* stdCode, const char* period, uint64_t beginTime, uint64_t endTime /* = 0 */)
 {
 	if(!_is_inited)
@@ -655,4 +877,8 @@ void WtDtRunner::trigger_bar(const char* stdCode, const char* period, WTSBarStru
 void WtDtRunner::clear_cache()
 {
 	_data_mgr.clear_cache();
+
+	StdUniqueLock lock(_mtx_batch);
+	for (auto& mgr : _batch_mgrs)
+		mgr->clear_cache();
 }
\ No newline at end of file
@@ -11,6 +11,9 @@
 #include "../WTSTools/WTSHotMgr.h"
 #include "../WTSTools/WTSBaseDataMgr.h"
 #include "../Share/StdUtils.hpp"
+#include "../Share/StrUtil.hpp"
+
+#include <functional>
 
 #include "PorterDefs.h"
 #include "ParserAdapter.h"
@@ -61,8 +64,37 @@ public:
 
 	WTSKlineSlice*	get_sbars_by_date(const char* stdCode, uint32_t secs, uint32_t uDate = 0);
 
+public:
+	/*
+	 *	批量读取回调，在调用线程上按照读取完成的顺序回调
+	 *	@idx	代码在请求列表中的下标
+	 *	@items	读取到的数据，回调中可以直接移走
+	 */
+	typedef std::function<void(uint32_t idx, const char* stdCode, std::vector<WTSBarStruct>& items)>	FuncBatchBars;
+	typedef std::function<void(uint32_t idx, const char* stdCode, std::vector<WTSTickStruct>& items)>	FuncBatchTicks;
+
+	/*
+	 *	批量读取多个代码的数据
+	 *	代码按哈希分配给内部的工作线程，每个工作线程有自己独立的数据读取器和缓存，并发读取和重采样
+	 *	返回读取到的数据总条数
+	 */
+	uint32_t	get_bars_batch_by_range(const StringVector& codes, const char* period, uint64_t beginTime, uint64_t endTime, FuncBatchBars cb);
+
+	uint32_t	get_bars_batch_by_count(const StringVector& codes, const char* period, uint32_t count, uint64_t endTime, FuncBatchBars cb);
+
+	uint32_t	get_ticks_batch_by_range(const StringVector& codes, uint64_t beginTime, uint64_t endTime, FuncBatchTicks cb);
+
 private:
 	void	initDataMgr(WTSVariant* config);
+
+	/*
+	 *	创建批量读取的工作数据管理器，第一次批量读取时调用
+	 */
+	void	initBatchWorkers();
+
+	template<typename T>
+	uint32_t	run_batch(const StringVector& codes, const std::function<void(WtDataManager*, const char*, std::vector<T>&)>& loader,
+				const std::function<void(uint32_t, const char*, std::vector<T>&)>& cb);
 	void	initParsers(WTSVariant* cfg);
 
 private:
@@ -77,6 +109,12 @@ private:
 
 	bool			_is_inited;
 
+	//批量读取的工作数据管理器，每个工作线程一个
+	WTSVariant*		_data_cfg;
+	uint32_t		_batch_workers;
+	std::vector<std::shared_ptr<WtDataManager>>	_batch_mgrs;
+	StdUniqueMutex	_mtx_batch;
+
 	typedef std::set<uint32_t> SubFlags;
 	typedef wt_hashmap<std::string, SubFlags>	StraSubMap;
 	StraSubMap		_tick_sub_map;	//tick数据订阅表
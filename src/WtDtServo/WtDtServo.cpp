@@ -224,6 +224,74 @@ WtUInt32 get_sbars_by_date(const char* stdCode, WtUInt32 secs, WtUInt32 uDate, F
 	}
 }
 
+WtUInt32 get_bars_batch_by_range(const char* stdCodes, const char* period, WtUInt64 beginTime, WtUInt64 endTime, FuncGetBatchBarsCallback cb)
+{
+	StringVector codes = StrUtil::split(stdCodes, ",");
+	uint32_t left = (uint32_t)codes.size();
+	uint32_t total = getRunner().get_bars_batch_by_range(codes, period, beginTime, endTime, [cb, &left](uint32_t idx, const char* stdCode, std::vector<WTSBarStruct>& items) {
+		left--;
+		cb(stdCode, items.data(), (WtUInt32)items.size(), left == 0);
+	});
+
+	//代码为空或者批量读取没有执行，也要回调一次isLast，调用方才能知道已经结束
+	if (codes.empty() || left > 0)
+		cb("", NULL, 0, true);
+	return total;
+}
+
+WtUInt32 get_bars_batch_by_count(const char* stdCodes, const char* period, WtUInt32 count, WtUInt64 endTime, FuncGetBatchBarsCallback cb)
+{
+	StringVector codes = StrUtil::split(stdCodes, ",");
+	uint32_t left = (uint32_t)codes.size();
+	uint32_t total = getRunner().get_bars_batch_by_count(codes, period, count, endTime, [cb, &left](uint32_t idx, const char* stdCode, std::vector<WTSBarStruct>& items) {
+		left--;
+		cb(stdCode, items.data(), (WtUInt32)items.size(), left == 0);
+	});
+
+	//代码为空或者批量读取没有执行，也要回调一次isLast，调用方才能知道已经结束
+	if (codes.empty() || left > 0)
+		cb("", NULL, 0, true);
+	return total;
+}
+
+WtUInt32 get_ticks_batch_by_range(const char* stdCodes, WtUInt64 beginTime, WtUInt64 endTime, FuncGetBatchTicksCallback cb)
+{
+	StringVector codes = StrUtil::split(stdCodes, ",");
+	uint32_t left = (uint32_t)codes.size();
+	uint32_t total = getRunner().get_ticks_batch_by_range(codes, beginTime, endTime, [cb, &left](uint32_t idx, const char* stdCode, std::vector<WTSTickStruct>& items) {
+		left--;
+		cb(stdCode, items.data(), (WtUInt32)items.size(), left == 0);
+	});
+
+	//代码为空或者批量读取没有执行，也要回调一次isLast，调用方才能知道已经结束
+	if (codes.empty() || left > 0)
+		cb("", NULL, 0, true);
+	return total;
+}
+
+WtUInt32 get_bars_panel_by_range(const char* stdCodes, const char* period, WtUInt64 beginTime, WtUInt64 endTime, FuncGetBarsPanelCallback cb)
+{
+	StringVector codes = StrUtil::split(stdCodes, ",");
+	std::vector<std::vector<WTSBarStruct>> panel(codes.size());
+	uint32_t total = getRunner().get_bars_batch_by_range(codes, period, beginTime, endTime, [&panel](uint32_t idx, const char* stdCode, std::vector<WTSBarStruct>& items) {
+		panel[idx].swap(items);
+	});
+
+	//按照请求的代码顺序拼接成一块连续内存
+	std::vector<WTSBarStruct> bars;
+	bars.reserve(total);
+	std::vector<WtUInt32> counts(codes.size());
+	for (std::size_t i = 0; i < panel.size(); i++)
+	{
+		counts[i] = (WtUInt32)panel[i].size();
+		bars.insert(bars.end(), panel[i].begin(), panel[i].end());
+		std::vector<WTSBarStruct>().swap(panel[i]);
+	}
+
+	cb(bars.data(), counts.data(), (WtUInt32)counts.size());
+	return total;
+}
+
 void subscribe_tick(const char* stdCode, bool bReplace)
 {
 	getRunner().sub_tick(stdCode, bReplace);
@@ -34,6 +34,21 @@ extern "C"
 
 	EXPORT_FLAG	WtUInt32	get_bars_by_date(const char* stdCode, const char* period, WtUInt32 uDate, FuncGetBarsCallback cb, FuncCountDataCallback cbCnt);
 
+	/*
+	 *	批量读取，stdCodes为逗号分隔的代码列表
+	 *	多个代码在内部线程池上并发读取，每个代码读取完成就回调一次
+	 */
+	EXPORT_FLAG	WtUInt32	get_bars_batch_by_range(const char* stdCodes, const char* period, WtUInt64 beginTime, WtUInt64 endTime, FuncGetBatchBarsCallback cb);
+
+	EXPORT_FLAG	WtUInt32	get_bars_batch_by_count(const char* stdCodes, const char* period, WtUInt32 count, WtUInt64 endTime, FuncGetBatchBarsCallback cb);
+
+	EXPORT_FLAG	WtUInt32	get_ticks_batch_by_range(const char* stdCodes, WtUInt64 beginTime, WtUInt64 endTime, FuncGetBatchTicksCallback cb);
+
+	/*
+	 *	批量读取K线，全部读取完成以后拼成一块连续的面板数据一次性回调
+	 */
+	EXPORT_FLAG	WtUInt32	get_bars_panel_by_range(const char* stdCodes, const char* period, WtUInt64 beginTime, WtUInt64 endTime, FuncGetBarsPanelCallback cb);
+
 	EXPORT_FLAG void		subscribe_tick(const char* stdCode, bool bReplace);
 
 	EXPORT_FLAG void		subscribe_bar(const char* stdCode, const char* period);
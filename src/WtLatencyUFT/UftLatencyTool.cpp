@@ -177,6 +177,16 @@ namespace uft
 			return 0;
 		}
 
+		virtual uint32_t stageOrder(WTSEntrust* entrust) override
+		{
+			return 1;
+		}
+
+		virtual int orderInsertStaged(uint32_t stageid, double price, double qty, const char* userTag) override
+		{
+			return 0;
+		}
+
 	private:
 		ITraderSpi*	_trader_spi;
 	};
@@ -184,7 +194,7 @@ namespace uft
 	class TestStrategy : public UftStrategy
 	{
 	public:
-		TestStrategy(const char* id) : UftStrategy(id) {}
+		TestStrategy(const char* id, bool bStaged) : UftStrategy(id), _staged(bStaged), _stage_id(0) {}
 
 		/*
 		*	执行单元名称
@@ -200,18 +210,33 @@ namespace uft
 		virtual void on_init(IUftStraCtx* ctx) override
 		{
 			ctx->stra_sub_ticks("SHFE.rb2205");
+
+			//预置下单模板，下单的时候只填价格和数量
+			if (_staged)
+				_stage_id = ctx->stra_stage_order("SHFE.rb2205", true, true, false, 0);
 		}
 
 		virtual void on_tick(IUftStraCtx* ctx, const char* code, WTSTickData* newTick)
 		{
 			//WTSLogger::debug("{}", __FUNCTION__);
-			ctx->stra_enter_long("SHFE.rb2205", 2300, 1, 0);
+			if (_stage_id != 0)
+				ctx->stra_send_staged(_stage_id, 2300, 1);
+			else
+				ctx->stra_enter_long("SHFE.rb2205", 2300, 1, 0);
 			//ctx->stra_enter_short("SHFE.rb2205", 2300, 1, 0);
 		}
+
+	private:
+		bool		_staged;
+		uint32_t	_stage_id;
 	};
 
 
 	UftLatencyTool::UftLatencyTool()
+		: _times(0)
+		, _core(0)
+		, _staged(false)
+		, _real_trader(false)
 	{
 	}
 
@@ -276,8 +301,11 @@ namespace uft
 		_core = _config->getUInt32("core");
 		WTSLogger::warn("Testing thread will be bind to core {}", _core);
 
+		_staged = _config->getBoolean("staged");
+		WTSLogger::warn("Orders will be sent {}", _staged ? "with staged templates" : "normally");
+
 		initEngine(_config->get("env"));
-		initModules();
+		initModules(_config->get("trader"));
 		initStrategies();
 
 		_config->release();
@@ -287,7 +315,7 @@ namespace uft
 	bool UftLatencyTool::initStrategies()
 	{
 		UftStraContext* ctx = new UftStraContext(&_engine, "stra");
-		ctx->set_strategy(new TestStrategy("stra"));
+		ctx->set_strategy(new TestStrategy("stra", _staged));
 
 		TraderAdapterPtr trader = _traders.getAdapter("trader");
 		ctx->setTrader(trader.get());
@@ -308,7 +336,7 @@ namespace uft
 	}
 
 
-	bool UftLatencyTool::initModules()
+	bool UftLatencyTool::initModules(WTSVariant* cfgTrader)
 	{
 		{
 			theParser = new TestParser();
@@ -317,6 +345,19 @@ namespace uft
 			_parsers.addAdapter("parser", adapter);
 		}
 
+		//配置了交易模块(如TraderMocker)的，测的是包括交易模块下单路径在内的完整延迟
+		if (cfgTrader)
+		{
+			TraderAdapterPtr adapter(new TraderAdapter());
+			if (!adapter->init("trader", cfgTrader, &_bd_mgr, NULL))
+			{
+				WTSLogger::error("Initializing trader module failed");
+				return false;
+			}
+			_traders.addAdapter("trader", adapter);
+			_real_trader = true;
+		}
+		else
 		{
 			TestTrader * tester = new TestTrader();
 			TraderAdapterPtr adapter(new TraderAdapter());
@@ -342,6 +383,20 @@ namespace uft
 			_parsers.run();
 			_traders.run();
 
+			//真实的交易模块要等登录和查询都完成
+			if (_real_trader)
+			{
+				TraderAdapterPtr trader = _traders.getAdapter("trader");
+				for (uint32_t i = 0; i < 300 && trader->state() != TraderAdapter::AS_ALLREADY; i++)
+					std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+				if (trader->state() != TraderAdapter::AS_ALLREADY)
+				{
+					WTSLogger::error("Trader module not ready, testing canceled");
+					return;
+				}
+			}
+
 			_engine.run();
 
 			theParser->run(_times);
@@ -36,7 +36,7 @@ namespace uft
 		void run();
 
 	private:
-		bool initModules();
+		bool initModules(WTSVariant* cfgTrader);
 		bool initStrategies();
 
 		bool initEngine(WTSVariant* cfg);
@@ -52,6 +52,8 @@ namespace uft
 
 		uint32_t			_times;
 		uint32_t			_core;
+		bool				_staged;		//是否用预置的下单模板下单
+		bool				_real_trader;	//是否加载了真实的交易模块
 	};
 }
 
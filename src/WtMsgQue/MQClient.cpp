@@ -26,6 +26,9 @@ USING_NS_WTP;
 #pragma warning(disable:4200)
 
 #define  RECV_BUF_SIZE  1024*1024
+#define  RECV_TIMEOUT	100		//阻塞接收的超时时间，毫秒，只用于检查退出和超时
+
+static const char* TOPIC_HEARTBEAT = "HEARTBEAT";
 
 inline uint32_t makeMQCientId()
 {
@@ -42,6 +45,7 @@ MQClient::MQClient(MQManager* mgr)
 	, _cb_message(NULL)
 	, m_iCheckTime(0)
 	, m_bNeedCheck(false)
+	, _sub_all(false)
 {
 	_id = makeMQCientId();
 }
@@ -55,7 +59,7 @@ MQClient::~MQClient()
 	if (m_thrdRecv)
 		m_thrdRecv->join();
 
-	if (_sock != 0)
+	if (_sock >= 0)
 		nn_close(_sock);
 }
 
@@ -72,11 +76,13 @@ bool MQClient::init(const char* url, FuncMQCallback cb)
 		return false;
 	}
 
-	nn_setsockopt(_sock, NN_SUB, NN_SUB_SUBSCRIBE, "", 0);
-
+	//订阅在start的时候再推到传输层，没有订阅任何topic则订阅全部
 	int bufsize = RECV_BUF_SIZE;
 	nn_setsockopt(_sock, NN_SOL_SOCKET, NN_RCVBUF, &bufsize, sizeof(bufsize));
 
+	int timeout = RECV_TIMEOUT;
+	nn_setsockopt(_sock, NN_SOL_SOCKET, NN_RCVTIMEO, &timeout, sizeof(timeout));
+
 	m_strURL = url;
 	if (nn_connect(_sock, url) < 0)
 	{
@@ -107,46 +113,47 @@ void MQClient::start()
 
 	if (m_thrdRecv == NULL)
 	{
+		if (_topics.empty())
+		{
+			subscribe("");
+			_sub_all = true;
+		}
+		else
+		{
+			//订阅了topic的话，要把心跳也订阅上，不然没有消息的时候会误报超时
+			for (const std::string& topic : _topics)
+				subscribe(topic.c_str());
+			subscribe(TOPIC_HEARTBEAT);
+		}
+
 		m_thrdRecv.reset(new StdThread([this]() {
 
 			while (!m_bTerminated)
 			{
-				bool hasData = false;
-				for(;;)
+				//阻塞接收，有消息马上返回，消息内存由nanomsg分配，处理完直接释放，不再拷贝
+				void* msg = NULL;
+				int nBytes = nn_recv(_sock, &msg, NN_MSG, 0);
+				if (nBytes >= 0)
 				{
-					int nBytes = nn_recv(_sock, _recv_buf, RECV_BUF_SIZE, NN_DONTWAIT);
-					if (nBytes > 0)
-					{
-						m_iCheckTime = TimeUtils::getLocalTimeNow();
-						m_bNeedCheck = true;
-						hasData = true;
-						_buffer.append(_recv_buf, nBytes);
-					}
-					else
-					{
-						break;
-					}
+					m_iCheckTime = TimeUtils::getLocalTimeNow();
+					m_bNeedCheck = true;
+					extract_message((const char*)msg, (std::size_t)nBytes);
+					nn_freemsg(msg);
+					continue;
 				}
 
-				if (hasData)
-					extract_buffer();
-				else
+				//超时返回的时候检查连接
+				if(m_iCheckTime != 0 && m_bNeedCheck)
 				{
-					if(m_iCheckTime != 0 && m_bNeedCheck)
+					int64_t now = TimeUtils::getLocalTimeNow();
+					int64_t elapse = now - m_iCheckTime;
+					if (elapse >= 60 * 1000)
 					{
-						int64_t now = TimeUtils::getLocalTimeNow();
-						int64_t elapse = now - m_iCheckTime;
-						if (elapse >= 60 * 1000)
-						{
-							//只通知一次，防止重复通知
-							_cb_message(_id, "TIMEOUT", "", 0);
-							m_bNeedCheck = false;
-						}
+						//只通知一次，防止重复通知
+						_cb_message(_id, "TIMEOUT", "", 0);
+						m_bNeedCheck = false;
 					}
-
-					std::this_thread::sleep_for(std::chrono::milliseconds(1));
 				}
-				
 			}
 		}));
 
@@ -159,28 +166,54 @@ void MQClient::start()
 	
 }
 
-void MQClient::extract_buffer()
+void MQClient::subscribe(const char* topic)
+{
+	std::size_t len = strlen(topic);
+	if (len > 0)
+		len = std::min(len + 1, sizeof(MQPacket::_topic));
+
+	if (nn_setsockopt(_sock, NN_SUB, NN_SUB_SUBSCRIBE, topic, len) < 0)
+		_mgr->log_client(_id, fmtutil::format("MQClient {} failed to subscribe topic {}", _id, topic));
+}
+
+void MQClient::sub_topic(const char* topic)
 {
-	uint32_t proc_len = 0;
+	if (_topics.find(topic) != _topics.end())
+		return;
+
+	_topics.insert(topic);
+
+	//已经启动了，直接推到传输层，如果之前订阅的是全部，则改成按topic订阅
+	if (m_thrdRecv == NULL)
+		return;
+
+	subscribe(topic);
+	if (_sub_all)
+	{
+		subscribe(TOPIC_HEARTBEAT);
+		nn_setsockopt(_sock, NN_SUB, NN_SUB_UNSUBSCRIBE, "", 0);
+		_sub_all = false;
+	}
+}
+
+void MQClient::extract_message(const char* data, std::size_t len)
+{
+	std::size_t proc_len = 0;
 	for(;;)
 	{
 		//先做长度检查
-		if (_buffer.length() - proc_len < sizeof(MQPacket))
+		if (len - proc_len < sizeof(MQPacket))
 			break;
 
-		MQPacket* packet = (MQPacket*)(_buffer.data() + proc_len);
+		MQPacket* packet = (MQPacket*)(data + proc_len);
 
-		if (_buffer.length() - proc_len < sizeof(MQPacket) + packet->_length)
+		if (len - proc_len < sizeof(MQPacket) + packet->_length)
 			break;
 
-		char* data = packet->_data;
-
-		if (is_allowed(packet->_topic))
+		//心跳只用来刷新超时检查，不回调
+		if (strncmp(packet->_topic, TOPIC_HEARTBEAT, sizeof(packet->_topic)) != 0)
 			_cb_message(_id, packet->_topic, packet->_data, packet->_length);
 
 		proc_len += sizeof(MQPacket) + packet->_length;
 	}
-
-	if(proc_len > 0)
-		_buffer.erase(0, proc_len);
 }
\ No newline at end of file
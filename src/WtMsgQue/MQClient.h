@@ -25,19 +25,17 @@ public:
 	~MQClient();
 
 private:
-	void	extract_buffer();
-
-	inline bool	is_allowed(const char* topic)
-	{
-		if (_topics.empty())
-			return true;
-
-		auto it = _topics.find(topic);
-		if (it != _topics.end())
-			return true;
-
-		return false;
-	}
+	/*
+	 *	处理一条消息
+	 *	nanomsg是按消息收发的，一条消息就是完整的一个或者多个MQPacket，不需要再拼包
+	 */
+	void	extract_message(const char* data, std::size_t len);
+
+	/*
+	 *	把订阅推到传输层，不需要的topic在订阅端的socket上就丢掉了
+	 *	topic在包头里是定长的，订阅的时候带上结尾的0，避免前缀误匹配
+	 */
+	void	subscribe(const char* topic);
 
 public:
 	inline uint32_t id() const { return _id; }
@@ -46,10 +44,7 @@ public:
 
 	void	start();
 
-	inline void	sub_topic(const char* topic)
-	{
-		_topics.insert(topic);
-	}
+	void	sub_topic(const char* topic);
 
 private:
 	std::string		m_strURL;
@@ -63,11 +58,10 @@ private:
 	int64_t			m_iCheckTime;
 	bool			m_bNeedCheck;
 
-	std::string		_buffer;
 	FuncMQCallback	_cb_message;
 
 	wt_hashset<std::string> _topics;
-	char			_recv_buf[1024 * 1024];
+	bool			_sub_all;	//是否订阅了全部topic
 };
 
 NS_WTP_END
\ No newline at end of file
@@ -25,6 +25,9 @@
 
 USING_NS_WTP;
 
+//心跳间隔，秒，要远小于订阅端60秒的超时
+#define HEARTBEAT_SPAN	10
+
 
 inline uint32_t makeMQSvrId()
 {
@@ -39,7 +42,6 @@ MQServer::MQServer(MQManager* mgr)
 	, _mgr(mgr)
 	, _confirm(false)
 	, m_bTerminated(false)
-	, m_bTimeout(false)
 {
 	_id = makeMQSvrId();
 }
@@ -106,7 +108,6 @@ void MQServer::publish(const char* topic, const void* data, uint32_t dataLen)
 	{
 		StdUniqueLock lock(m_mtxCast);
 		m_dataQue.push(PubData(topic, data, dataLen));
-		m_bTimeout = false;
 	}
 
 	if(m_thrdCast == NULL)
@@ -115,26 +116,31 @@ void MQServer::publish(const char* topic, const void* data, uint32_t dataLen)
 
 			if (m_sendBuf.empty())
 				m_sendBuf.resize(1024 * 1024, 0);
+			auto nextBeat = std::chrono::steady_clock::now() + std::chrono::seconds(HEARTBEAT_SPAN);
 			while (!m_bTerminated)
 			{
 				int cnt = (int)nn_get_statistic(_sock, NN_STAT_CURRENT_CONNECTIONS);
-				if(m_dataQue.empty() || (cnt == 0 && _confirm))
+				bool bIdle = false;
 				{
 					StdUniqueLock lock(m_mtxCast);
-					m_bTimeout = true;
-					m_condCast.wait_for(lock, std::chrono::seconds(60));
-					//如果有新的数据进来，timeout会被改为false
-					//如果没有新的数据进来，timeout会保持为true
-					if (m_bTimeout)
-					{
-						//等待超时以后，广播心跳包
-						m_dataQue.push(PubData("HEARTBEAT", "", 0));
-					}
-					else
-					{
-						continue;
-					}
-				}	
+					bIdle = m_dataQue.empty() || (cnt == 0 && _confirm);
+					if (bIdle)
+						m_condCast.wait_until(lock, nextBeat);
+				}
+
+				//心跳按固定间隔广播，不管有没有其他数据，订阅了冷门topic的客户端也不会误报超时
+				auto now = std::chrono::steady_clock::now();
+				if (now >= nextBeat)
+				{
+					StdUniqueLock lock(m_mtxCast);
+					m_dataQue.push(PubData("HEARTBEAT", "", 0));
+					nextBeat = now + std::chrono::seconds(HEARTBEAT_SPAN);
+				}
+				else if (bIdle)
+				{
+					//被新数据唤醒的，重新检查一下连接
+					continue;
+				}
 
 				PubDataQue tmpQue;
 				{
@@ -146,7 +152,8 @@ void MQServer::publish(const char* topic, const void* data, uint32_t dataLen)
 				{
 					const PubData& pubData = tmpQue.front();
 
-					if (!pubData._data.empty())
+					//心跳包没有数据，也要发出去，订阅端用来检查连接是否超时
+					if (!pubData._data.empty() || pubData._topic == "HEARTBEAT")
 					{
 						std::size_t len = sizeof(MQPacket) + pubData._data.size();
 						if (m_sendBuf.size() < len)
@@ -42,7 +42,6 @@ private:
 	StdCondVariable	m_condCast;
 	StdUniqueMutex	m_mtxCast;
 	bool			m_bTerminated;
-	bool			m_bTimeout;
 
 	typedef struct _PubData
 	{
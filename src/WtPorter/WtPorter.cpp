@@ -265,7 +265,14 @@ WtUInt32	cta_get_ticks(CtxHandler cHandle, const char* stdCode, WtUInt32 tickCnt
 		if (tData)
 		{
 			uint32_t thisCnt = min(tickCnt, (WtUInt32)tData->size());
-			cb(cHandle, stdCode, (WTSTickStruct*)tData->at(0), thisCnt, true);
+			//盘中封存过的数据会分成多个数据块，逐块回调
+			uint32_t left = thisCnt;
+			for (std::size_t i = 0; i < tData->get_block_counts() && left > 0; i++)
+			{
+				uint32_t blkCnt = min(left, tData->get_block_size(i));
+				left -= blkCnt;
+				cb(cHandle, stdCode, tData->get_block_addr(i), blkCnt, left == 0);
+			}
 			tData->release();
 			return thisCnt;
 		}
@@ -698,7 +705,15 @@ WtUInt32	sel_get_ticks(CtxHandler cHandle, const char* stdCode, WtUInt32 tickCnt
 		{
 			uint32_t thisCnt = min(tickCnt, (WtUInt32)tData->size());
 			if (thisCnt != 0)
-				cb(cHandle, stdCode, (WTSTickStruct*)tData->at(0), thisCnt, true);
+			{
+				uint32_t left = thisCnt;
+				for (std::size_t i = 0; i < tData->get_block_counts() && left > 0; i++)
+				{
+					uint32_t blkCnt = min(left, tData->get_block_size(i));
+					left -= blkCnt;
+					cb(cHandle, stdCode, tData->get_block_addr(i), blkCnt, left == 0);
+				}
+			}
 			else
 				cb(cHandle, stdCode, NULL, 0, true);
 			tData->release();
@@ -938,7 +953,15 @@ WtUInt32 hft_get_ticks(CtxHandler cHandle, const char* stdCode, WtUInt32 tickCnt
 		{
 			uint32_t thisCnt = min(tickCnt, (WtUInt32)tData->size());
 			if (thisCnt != 0)
-				cb(cHandle, stdCode, (WTSTickStruct*)tData->at(0), thisCnt, true);
+			{
+				uint32_t left = thisCnt;
+				for (std::size_t i = 0; i < tData->get_block_counts() && left > 0; i++)
+				{
+					uint32_t blkCnt = min(left, tData->get_block_size(i));
+					left -= blkCnt;
+					cb(cHandle, stdCode, tData->get_block_addr(i), blkCnt, left == 0);
+				}
+			}
 			else
 				cb(cHandle, stdCode, NULL, 0, true);
 			tData->release();
@@ -966,7 +989,13 @@ WtUInt32 hft_get_ordque(CtxHandler cHandle, const char* stdCode, WtUInt32 itemCn
 		if (dataSlice)
 		{
 			uint32_t thisCnt = min(itemCnt, (WtUInt32)dataSlice->size());
-			cb(cHandle, stdCode, (WTSOrdQueStruct*)dataSlice->at(0), thisCnt, true);
+			uint32_t left = thisCnt;
+			for (std::size_t i = 0; i < dataSlice->get_block_counts() && left > 0; i++)
+			{
+				uint32_t blkCnt = min(left, dataSlice->get_block_size(i));
+				left -= blkCnt;
+				cb(cHandle, stdCode, dataSlice->get_block_addr(i), blkCnt, left == 0);
+			}
 			dataSlice->release();
 			return thisCnt;
 		}
@@ -992,7 +1021,13 @@ WtUInt32 hft_get_orddtl(CtxHandler cHandle, const char* stdCode, WtUInt32 itemCn
 		if (dataSlice)
 		{
 			uint32_t thisCnt = min(itemCnt, (WtUInt32)dataSlice->size());
-			cb(cHandle, stdCode, (WTSOrdDtlStruct*)dataSlice->at(0), thisCnt, true);
+			uint32_t left = thisCnt;
+			for (std::size_t i = 0; i < dataSlice->get_block_counts() && left > 0; i++)
+			{
+				uint32_t blkCnt = min(left, dataSlice->get_block_size(i));
+				left -= blkCnt;
+				cb(cHandle, stdCode, dataSlice->get_block_addr(i), blkCnt, left == 0);
+			}
 			dataSlice->release();
 			return thisCnt;
 		}
@@ -1018,7 +1053,13 @@ WtUInt32 hft_get_trans(CtxHandler cHandle, const char* stdCode, WtUInt32 itemCnt
 		if (dataSlice)
 		{
 			uint32_t thisCnt = min(itemCnt, (WtUInt32)dataSlice->size());
-			cb(cHandle, stdCode, (WTSTransStruct*)dataSlice->at(0), thisCnt, true);
+			uint32_t left = thisCnt;
+			for (std::size_t i = 0; i < dataSlice->get_block_counts() && left > 0; i++)
+			{
+				uint32_t blkCnt = min(left, dataSlice->get_block_size(i));
+				left -= blkCnt;
+				cb(cHandle, stdCode, dataSlice->get_block_addr(i), blkCnt, left == 0);
+			}
 			dataSlice->release();
 			return thisCnt;
 		}
@@ -20,6 +20,7 @@
 #include "../WTSUtils/WTSCfgLoader.h"
 #include "../WTSUtils/SignalHook.hpp"
 #include "../Share/StrUtil.hpp"
+#include "../Share/TimeUtils.hpp"
 
 
 const char* getBinDir()
@@ -41,6 +42,7 @@ WtRunner::WtRunner()
 	: _data_store(NULL)
 	, _is_hft(false)
 	, _is_sel(false)
+	, _replay_mode(false)
 	, _to_exit(false)
 {
 	install_signal_hooks([](const char* message) {
@@ -77,6 +79,27 @@ bool WtRunner::config(const std::string& filename)
 		return false;
 	}
 
+	//回放模式，replay: {active, file, generated}
+	WTSVariant* cfgReplay = _config->get("replay");
+	if (cfgReplay && cfgReplay->getBoolean("active"))
+	{
+		const char* capFile = cfgReplay->getCString("file");
+		if (!_replayer.open(capFile))
+		{
+			WTSLogger::error("Opening capture file {} failed", capFile);
+			return false;
+		}
+
+		_replay_mode = true;
+
+		//回放的输出要和实盘分开，不然会覆盖实盘的本地数据
+		std::string genDir = cfgReplay->getString("generated");
+		if (genDir.empty())
+			genDir = "./replay/";
+		WtHelper::setGenerateDir(StrUtil::standardisePath(genDir).c_str());
+		WTSLogger::info("Replay mode activated, capture file: {}, generated dir: {}", capFile, genDir);
+	}
+
 	//基础数据文件
 	WTSVariant* cfgBF = _config->get("basefiles");
 	if (cfgBF->get("session"))
@@ -114,6 +137,13 @@ bool WtRunner::config(const std::string& filename)
 		}
 	}
 
+	//交易日历的预计算区间，不配置的话默认为19900101-20501231
+	if (cfgBF->has("calendar"))
+	{
+		WTSVariant* cfgCal = cfgBF->get("calendar");
+		_bd_mgr.setCalendarRange(cfgCal->getUInt32("begin"), cfgCal->getUInt32("end"));
+	}
+
 	if (cfgBF->get("holiday"))
 		_bd_mgr.loadHolidays(cfgBF->getCString("holiday"));
 
@@ -164,7 +194,7 @@ bool WtRunner::config(const std::string& filename)
 
 	//初始化行情通道
 	WTSVariant* cfgParser = _config->get("parsers");
-	if (cfgParser)
+	if (cfgParser && !_replay_mode)
 	{
 		if (cfgParser->type() == WTSVariant::VT_String)
 		{
@@ -279,6 +309,12 @@ bool WtRunner::config(const std::string& filename)
 		initCtaStrategies();
 	else
 		initHftStrategies();
+
+	if (!_replay_mode)
+	{
+		initStandby();
+		initCapture();
+	}
 	
 	return true;
 }
@@ -566,7 +602,10 @@ bool WtRunner::initTraders(WTSVariant* cfgTrader)
 		const char* id = cfgItem->getCString("id");
 
 		TraderAdapterPtr adapter(new TraderAdapter(&_notifier));
-		adapter->init(id, cfgItem, &_bd_mgr, &_act_policy);
+		if (_replay_mode)
+			adapter->init(id, cfgItem, &_bd_mgr, &_act_policy, new ReplayTraderApi());
+		else
+			adapter->init(id, cfgItem, &_bd_mgr, &_act_policy);
 
 		_traders.addAdapter(id, adapter);
 
@@ -578,21 +617,118 @@ bool WtRunner::initTraders(WTSVariant* cfgTrader)
 	return true;
 }
 
+bool WtRunner::initStandby()
+{
+	WTSVariant* cfg = _config->get("standby");
+	if (cfg == NULL || cfg->type() != WTSVariant::VT_Object || !cfg->getBoolean("active"))
+		return false;
+
+	const char* name = cfg->getCString("name");
+	uint32_t timeout = cfg->has("timeout") ? cfg->getUInt32("timeout") : 100;
+	uint32_t hbSpan = cfg->has("heartbeat") ? cfg->getUInt32("heartbeat") : 10;
+	uint64_t capacity = (cfg->has("capacity") ? cfg->getUInt64("capacity") : 64) * 1024 * 1024;
+
+	bool bSucc = _standby.init(name, capacity, timeout, hbSpan, [](const char* message) {
+		WTSLogger::info("[Standby] {}", message);
+	});
+	if (!bSucc)
+	{
+		WTSLogger::error("Initializing standby group {} failed", name);
+		return false;
+	}
+
+	_engine->set_standby(&_standby);
+	_traders.set_standby(&_standby);
+
+	if (cfg->getBoolean("primary") && _standby.try_acquire())
+		WTSLogger::info("Standby group {} joined as leader, epoch {}", name, _standby.epoch());
+	else
+		WTSLogger::info("Standby group {} joined as follower, waiting for leader's heartbeat timeout", name);
+
+	return true;
+}
+
+bool WtRunner::initCapture()
+{
+	WTSVariant* cfg = _config->get("capture");
+	if (cfg == NULL || cfg->type() != WTSVariant::VT_Object || !cfg->getBoolean("active"))
+		return false;
+
+	std::string path = cfg->getString("path");
+	if (path.empty())
+		path = WtHelper::getBaseDir();
+	path = StrUtil::standardisePath(path);
+	if (!StdFile::exists(path.c_str()))
+		boost::filesystem::create_directories(path);
+
+	uint32_t curDate, curTime;
+	TimeUtils::getDateTime(curDate, curTime);
+	std::string filename = StrUtil::printf("%s%u_%09u.wtcap", path.c_str(), curDate, curTime);
+
+	uint32_t flushSpan = cfg->has("flush") ? cfg->getUInt32("flush") : 100;
+	if (!_capture.open(filename.c_str(), flushSpan))
+	{
+		WTSLogger::error("Opening capture file {} failed", filename);
+		return false;
+	}
+
+	//启动时钟和订单号种子要先写入，回放的时候据此初始化
+	_capture.record_clock(curDate, curTime, TraderAdapter::peekLocalOrderID());
+
+	_engine->set_capture(&_capture);
+	_traders.set_capture(&_capture);
+
+	WTSLogger::info("Event capture started, all inputs will be recorded into {}", filename);
+	return true;
+}
+
 void WtRunner::run(bool bAsync /* = false */)
 {
 	try
 	{
+		if (_replay_mode)
+		{
+			uint64_t count = _replayer.replay(_engine, &_traders, &_bd_mgr);
+			WTSLogger::info("Replay finished, {} events replayed", count);
+			return;
+		}
+
 		_parsers.run();
 		_traders.run();
 
 		_engine->run();
 
+		if (_standby.is_inited())
+		{
+			_standby.start([](uint32_t rtype, const char* key, const char* data, std::size_t len) {
+				//本地订单号要实时同步，其他状态在接管的时候统一恢复
+				if (rtype == SRT_OrderID && len == sizeof(uint32_t))
+					TraderAdapter::syncLocalOrderID(*(uint32_t*)data);
+			}, [this](bool bLeader) {
+				if (bLeader)
+				{
+					WTSLogger::warn("Leader of standby group lost, taking over with epoch {}", _standby.epoch());
+					//回调在主备组件的线程里，接管期间要把行情和定时器的分发挡住
+					StdExclusiveLock lock(_engine->dispatch_gate());
+					_engine->on_takeover(&_standby);
+					_traders.resync();
+				}
+				else
+				{
+					WTSLogger::error("Lease of standby group lost, trading instructions will be rejected");
+				}
+			});
+		}
+
 		if(!bAsync)
 		{
 			while(!_to_exit)
 			{
 				std::this_thread::sleep_for(std::chrono::milliseconds(10));
 			}
+
+			_standby.stop();
+			_capture.close();
 		}
 	}
 	catch (...)
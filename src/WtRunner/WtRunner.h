@@ -27,6 +27,7 @@
 #include "../WtCore/ParserAdapter.h"
 #include "../WtCore/WtDtMgr.h"
 #include "../WtCore/ActionPolicyMgr.h"
+#include "../WtCore/EventCapture.h"
 
 #include "../WTSTools/WTSHotMgr.h"
 #include "../WTSTools/WTSBaseDataMgr.h"
@@ -63,6 +64,18 @@ private:
 
 	bool initEngine();
 
+	/*
+	 *	初始化主备热切换
+	 *	standby: {active, name, primary, timeout, heartbeat, capacity}
+	 */
+	bool initStandby();
+
+	/*
+	 *	初始化事件录制
+	 *	capture: {active, path, flush}
+	 */
+	bool initCapture();
+
 //////////////////////////////////////////////////////////////////////////
 //ILogHandler
 public:
@@ -95,6 +108,12 @@ private:
 	bool				_is_hft;
 	bool				_is_sel;
 
+	ShmStandby			_standby;
+
+	EventCapture		_capture;
+	EventReplayer		_replayer;
+	bool				_replay_mode;	//回放模式，不连接行情和交易通道，所有事件来自录制文件
+
 	bool				_to_exit;
 };
 
@@ -0,0 +1,738 @@
+﻿/*!
+ * \file EventCapture.cpp
+ * \project	WonderTrader
+ *
+ * \brief 实盘事件录制和离线回放
+ */
+#include "EventCapture.h"
+#include "WtUftEngine.h"
+#include "TraderAdapter.h"
+
+#include "../Includes/WTSDataDef.hpp"
+#include "../Includes/WTSTradeDef.hpp"
+#include "../Includes/WTSError.hpp"
+#include "../Includes/WTSContractInfo.hpp"
+#include "../Includes/IBaseDataMgr.h"
+
+#include "../Share/BoostMappingFile.hpp"
+#include "../Share/StrUtil.hpp"
+#include "../Share/fmtlib.h"
+
+#include "../WTSTools/WTSLogger.h"
+
+#include <chrono>
+
+USING_NS_WTP;
+using namespace uft;
+
+static const uint32_t CET_COUNT = CET_TrdTrade + 1;
+
+static const char* CET_NAMES[CET_COUNT] = {
+	"clock", "tick", "ordque", "orddtl", "trans", "timer",
+	"trd_event", "trd_login", "trd_entrust", "trd_accounts", "trd_positions",
+	"trd_orders", "trd_trades", "trd_order", "trd_trade"
+};
+
+inline int64_t nowNano()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+inline int64_t steadyNano()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//录制时合约代码是标准代码，回放时要去掉交易所前缀再查合约
+inline WTSContractInfo* getContract(IBaseDataMgr* bdMgr, const char* code, const char* exchg)
+{
+	const char* pos = strchr(code, '.');
+	if (pos != NULL)
+		code = pos + 1;
+	return bdMgr->getContract(code, exchg);
+}
+
+inline void toCapture(WTSOrderInfo* ordInfo, CapOrder& item)
+{
+	wt_strcpy(item._exchg, ordInfo->getExchg());
+	wt_strcpy(item._code, ordInfo->getCode());
+	item._volume = ordInfo->getVolume();
+	item._price = ordInfo->getPrice();
+	item._traded = ordInfo->getVolTraded();
+	item._left = ordInfo->getVolLeft();
+	item._direct = ordInfo->getDirection();
+	item._price_type = ordInfo->getPriceType();
+	item._order_flag = ordInfo->getOrderFlag();
+	item._offset = ordInfo->getOffsetType();
+	item._business = ordInfo->getBusinessType();
+	item._state = ordInfo->getOrderState();
+	item._order_type = ordInfo->getOrderType();
+	item._is_error = ordInfo->isError() ? 1 : 0;
+	item._is_net = ordInfo->isNet() ? 1 : 0;
+	item._is_buy = ordInfo->isBuy() ? 1 : 0;
+	item._date = ordInfo->getOrderDate();
+	item._time = ordInfo->getOrderTime();
+	wt_strcpy(item._entrustid, ordInfo->getEntrustID());
+	wt_strcpy(item._orderid, ordInfo->getOrderID());
+	wt_strcpy(item._usertag, ordInfo->getUserTag());
+	strncpy(item._statemsg, ordInfo->getStateMsg(), sizeof(item._statemsg) - 1);
+}
+
+inline WTSOrderInfo* fromCapture(const CapOrder& item, IBaseDataMgr* bdMgr)
+{
+	WTSOrderInfo* ordInfo = WTSOrderInfo::create();
+	ordInfo->setExchange(item._exchg);
+	ordInfo->setCode(item._code);
+	ordInfo->setVolume(item._volume);
+	ordInfo->setPrice(item._price);
+	ordInfo->setVolTraded(item._traded);
+	ordInfo->setVolLeft(item._left);
+	ordInfo->setDirection((WTSDirectionType)item._direct);
+	ordInfo->setPriceType((WTSPriceType)item._price_type);
+	ordInfo->setOrderFlag((WTSOrderFlag)item._order_flag);
+	ordInfo->setOffsetType((WTSOffsetType)item._offset);
+	ordInfo->setBusinessType((WTSBusinessType)item._business);
+	ordInfo->setOrderState((WTSOrderState)item._state);
+	ordInfo->setOrderType((WTSOrderType)item._order_type);
+	ordInfo->setError(item._is_error != 0);
+	if (item._is_net != 0)
+		ordInfo->setNetDirection(item._is_buy != 0);
+	ordInfo->setOrderDate(item._date);
+	ordInfo->setOrderTime(item._time);
+	ordInfo->setEntrustID(item._entrustid);
+	ordInfo->setOrderID(item._orderid);
+	ordInfo->setUserTag(item._usertag);
+	ordInfo->setStateMsg(item._statemsg);
+	ordInfo->setContractInfo(getContract(bdMgr, item._code, item._exchg));
+	return ordInfo;
+}
+
+inline void toCapture(WTSTradeInfo* trdInfo, CapTrade& item)
+{
+	wt_strcpy(item._exchg, trdInfo->getExchg());
+	wt_strcpy(item._code, trdInfo->getCode());
+	item._volume = trdInfo->getVolume();
+	item._price = trdInfo->getPrice();
+	item._amount = trdInfo->getAmount();
+	item._direct = trdInfo->getDirection();
+	item._offset = trdInfo->getOffsetType();
+	item._order_type = trdInfo->getOrderType();
+	item._trade_type = trdInfo->getTradeType();
+	item._business = trdInfo->getBusinessType();
+	item._is_net = trdInfo->isNet() ? 1 : 0;
+	item._is_buy = trdInfo->isBuy() ? 1 : 0;
+	item._date = trdInfo->getTradeDate();
+	item._time = trdInfo->getTradeTime();
+	wt_strcpy(item._tradeid, trdInfo->getTradeID());
+	wt_strcpy(item._reforder, trdInfo->getRefOrder());
+	wt_strcpy(item._usertag, trdInfo->getUserTag());
+}
+
+inline WTSTradeInfo* fromCapture(const CapTrade& item, IBaseDataMgr* bdMgr)
+{
+	WTSTradeInfo* trdInfo = WTSTradeInfo::create(item._code, item._exchg, (WTSBusinessType)item._business);
+	trdInfo->setVolume(item._volume);
+	trdInfo->setPrice(item._price);
+	trdInfo->setAmount(item._amount);
+	trdInfo->setDirection((WTSDirectionType)item._direct);
+	trdInfo->setOffsetType((WTSOffsetType)item._offset);
+	trdInfo->setOrderType((WTSOrderType)item._order_type);
+	trdInfo->setTradeType((WTSTradeType)item._trade_type);
+	if (item._is_net != 0)
+		trdInfo->setNetDirection(item._is_buy != 0);
+	trdInfo->setTradeDate(item._date);
+	trdInfo->setTradeTime(item._time);
+	trdInfo->setTradeID(item._tradeid);
+	trdInfo->setRefOrder(item._reforder);
+	trdInfo->setUserTag(item._usertag);
+	trdInfo->setContractInfo(getContract(bdMgr, item._code, item._exchg));
+	return trdInfo;
+}
+
+inline void toCapture(WTSPositionItem* pInfo, CapPosition& item)
+{
+	wt_strcpy(item._exchg, pInfo->getExchg());
+	wt_strcpy(item._code, pInfo->getCode());
+	wt_strcpy(item._currency, pInfo->getCurrency());
+	item._direct = pInfo->getDirection();
+	item._business = pInfo->getBusinessType();
+	item._prevol = pInfo->getPrePosition();
+	item._newvol = pInfo->getNewPosition();
+	item._preavail = pInfo->getAvailPrePos();
+	item._newavail = pInfo->getAvailNewPos();
+	item._cost = pInfo->getPositionCost();
+	item._margin = pInfo->getMargin();
+	item._avgpx = pInfo->getAvgPrice();
+	item._dynprofit = pInfo->getDynProfit();
+}
+
+inline WTSPositionItem* fromCapture(const CapPosition& item, IBaseDataMgr* bdMgr)
+{
+	WTSPositionItem* pInfo = WTSPositionItem::create(item._code, item._currency, item._exchg, (WTSBusinessType)item._business);
+	pInfo->setDirection((WTSDirectionType)item._direct);
+	pInfo->setPrePosition(item._prevol);
+	pInfo->setNewPosition(item._newvol);
+	pInfo->setAvailPrePos(item._preavail);
+	pInfo->setAvailNewPos(item._newavail);
+	pInfo->setPositionCost(item._cost);
+	pInfo->setMargin(item._margin);
+	pInfo->setAvgPrice(item._avgpx);
+	pInfo->setDynProfit(item._dynprofit);
+	pInfo->setContractInfo(getContract(bdMgr, item._code, item._exchg));
+	return pInfo;
+}
+
+inline void toCapture(WTSAccountInfo* aInfo, CapAccount& item)
+{
+	wt_strcpy(item._currency, aInfo->getCurrency());
+	item._balance = aInfo->getBalance();
+	item._prebalance = aInfo->getPreBalance();
+	item._margin = aInfo->getMargin();
+	item._commission = aInfo->getCommission();
+	item._frozen_margin = aInfo->getFrozenMargin();
+	item._frozen_commission = aInfo->getFrozenCommission();
+	item._close_profit = aInfo->getCloseProfit();
+	item._dynprofit = aInfo->getDynProfit();
+	item._deposit = aInfo->getDeposit();
+	item._withdraw = aInfo->getWithdraw();
+	item._available = aInfo->getAvailable();
+}
+
+inline WTSAccountInfo* fromCapture(const CapAccount& item)
+{
+	WTSAccountInfo* aInfo = WTSAccountInfo::create();
+	aInfo->setCurrency(item._currency);
+	aInfo->setBalance(item._balance);
+	aInfo->setPreBalance(item._prebalance);
+	aInfo->setMargin(item._margin);
+	aInfo->setCommission(item._commission);
+	aInfo->setFrozenMargin(item._frozen_margin);
+	aInfo->setFrozenCommission(item._frozen_commission);
+	aInfo->setCloseProfit(item._close_profit);
+	aInfo->setDynProfit(item._dynprofit);
+	aInfo->setDeposit(item._deposit);
+	aInfo->setWithdraw(item._withdraw);
+	aInfo->setAvailable(item._available);
+	return aInfo;
+}
+
+/*
+ *	把交易回报数组序列化成 CapTrdArray + N * T
+ *	交易回报不在行情的热路径上，这里用线程局部的缓存拼装
+ */
+template<typename T, typename O>
+inline const std::string& packArray(const char* trader, const WTSArray* ayItems)
+{
+	static thread_local std::string buffer;
+	uint32_t count = (ayItems == NULL) ? 0 : ayItems->size();
+	buffer.assign(sizeof(CapTrdArray) + sizeof(T)*count, '\0');
+
+	CapTrdArray* header = (CapTrdArray*)buffer.data();
+	wt_strcpy(header->_trader, trader);
+	header->_count = count;
+
+	T* items = (T*)(buffer.data() + sizeof(CapTrdArray));
+	for (uint32_t i = 0; i < count; i++)
+		toCapture((O*)((WTSArray*)ayItems)->at(i), items[i]);
+
+	return buffer;
+}
+
+template<typename T, typename O>
+inline const std::string& packSingle(const char* trader, O* obj)
+{
+	static thread_local std::string buffer;
+	buffer.assign(sizeof(CapTrdArray) + sizeof(T), '\0');
+
+	CapTrdArray* header = (CapTrdArray*)buffer.data();
+	wt_strcpy(header->_trader, trader);
+	header->_count = 1;
+	toCapture(obj, *(T*)(buffer.data() + sizeof(CapTrdArray)));
+
+	return buffer;
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+//EventCapture
+EventCapture::EventCapture()
+	: _opened(false)
+	, _flush_span(100)
+	, _stopped(true)
+{
+}
+
+EventCapture::~EventCapture()
+{
+	close();
+}
+
+bool EventCapture::open(const char* filename, uint32_t flushSpan /* = 100 */)
+{
+	if (_opened)
+		return false;
+
+	if (!_file.create_new_file(filename))
+	{
+		WTSLogger::error("Creating capture file {} failed", filename);
+		return false;
+	}
+
+	CaptureFileHeader header;
+	memset(&header, 0, sizeof(CaptureFileHeader));
+	memcpy(header._flag, CAP_FLAG, sizeof(header._flag));
+	header._version = CAP_VERSION;
+	_file.write_file(&header, sizeof(CaptureFileHeader));
+
+	_filename = filename;
+	_flush_span = std::max(flushSpan, (uint32_t)1);
+	_buffer.reserve(8 * 1024 * 1024);
+	_flushing.reserve(8 * 1024 * 1024);
+	_opened = true;
+	_stopped = false;
+
+	_thrd_flush.reset(new StdThread([this]() {
+		while (!_stopped)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(_flush_span));
+			flush();
+		}
+	}));
+
+	WTSLogger::info("Live events will be captured into {}", filename);
+	return true;
+}
+
+void EventCapture::close()
+{
+	if (!_opened)
+		return;
+
+	_stopped = true;
+	if (_thrd_flush)
+		_thrd_flush->join();
+	_thrd_flush.reset();
+
+	flush();
+	_file.close_file();
+	_opened = false;
+
+	WTSLogger::info("Capture file {} closed", _filename);
+}
+
+void EventCapture::flush()
+{
+	{
+		SpinLock lock(_mtx);
+		if (_buffer.empty())
+			return;
+
+		_buffer.swap(_flushing);
+	}
+
+	_file.write_file(_flushing);
+	_flushing.clear();
+}
+
+void EventCapture::append(uint32_t etype, const void* data, uint32_t len)
+{
+	if (!_opened)
+		return;
+
+	CaptureRecord rec;
+	rec._type = etype;
+	rec._len = len;
+	rec._arrival = nowNano();
+
+	SpinLock lock(_mtx);
+	_buffer.append((const char*)&rec, sizeof(CaptureRecord));
+	_buffer.append((const char*)data, len);
+}
+
+void EventCapture::record_clock(uint32_t uDate, uint32_t uTime, uint32_t orderSeed)
+{
+	CapClock item;
+	memset(&item, 0, sizeof(CapClock));
+	item._date = uDate;
+	item._time = uTime;
+	item._order_seed = orderSeed;
+	append(CET_Clock, &item, sizeof(CapClock));
+}
+
+void EventCapture::record_timer(uint32_t uDate, uint32_t uTime)
+{
+	CapTimer item;
+	item._date = uDate;
+	item._time = uTime;
+	append(CET_Timer, &item, sizeof(CapTimer));
+}
+
+void EventCapture::record_tick(WTSTickData* curTick)
+{
+	append(CET_Tick, &curTick->getTickStruct(), sizeof(WTSTickStruct));
+}
+
+void EventCapture::record_order_queue(WTSOrdQueData* curOrdQue)
+{
+	append(CET_OrdQue, &curOrdQue->getOrdQueStruct(), sizeof(WTSOrdQueStruct));
+}
+
+void EventCapture::record_order_detail(WTSOrdDtlData* curOrdDtl)
+{
+	append(CET_OrdDtl, &curOrdDtl->getOrdDtlStruct(), sizeof(WTSOrdDtlStruct));
+}
+
+void EventCapture::record_transaction(WTSTransData* curTrans)
+{
+	append(CET_Trans, &curTrans->getTransStruct(), sizeof(WTSTransStruct));
+}
+
+void EventCapture::record_trader_event(const char* trader, WTSTraderEvent e, int32_t ec)
+{
+	CapTrdEvent item;
+	memset(&item, 0, sizeof(CapTrdEvent));
+	wt_strcpy(item._trader, trader);
+	item._event = e;
+	item._ec = ec;
+	append(CET_TrdEvent, &item, sizeof(CapTrdEvent));
+}
+
+void EventCapture::record_login(const char* trader, bool bSucc, const char* msg, uint32_t tradingdate, bool bModifySupported)
+{
+	CapTrdLogin item;
+	memset(&item, 0, sizeof(CapTrdLogin));
+	wt_strcpy(item._trader, trader);
+	item._success = bSucc ? 1 : 0;
+	item._tdate = tradingdate;
+	item._features = bModifySupported ? 1 : 0;
+	if (msg)
+		strncpy(item._message, msg, sizeof(item._message) - 1);
+	append(CET_TrdLogin, &item, sizeof(CapTrdLogin));
+}
+
+void EventCapture::record_entrust(const char* trader, WTSEntrust* entrust, WTSError* err)
+{
+	static thread_local std::string buffer;
+	buffer.assign(sizeof(CapTrdArray) + sizeof(CapEntrust), '\0');
+
+	CapTrdArray* header = (CapTrdArray*)buffer.data();
+	wt_strcpy(header->_trader, trader);
+	header->_count = 1;
+
+	CapEntrust& item = *(CapEntrust*)(buffer.data() + sizeof(CapTrdArray));
+	wt_strcpy(item._exchg, entrust->getExchg());
+	wt_strcpy(item._code, entrust->getCode());
+	item._volume = entrust->getVolume();
+	item._price = entrust->getPrice();
+	item._direct = entrust->getDirection();
+	item._price_type = entrust->getPriceType();
+	item._order_flag = entrust->getOrderFlag();
+	item._offset = entrust->getOffsetType();
+	item._business = entrust->getBusinessType();
+	wt_strcpy(item._entrustid, entrust->getEntrustID());
+	wt_strcpy(item._usertag, entrust->getUserTag());
+	if (err)
+	{
+		item._errcode = err->getErrorCode();
+		strncpy(item._errmsg, err->getMessage(), sizeof(item._errmsg) - 1);
+	}
+
+	append(CET_TrdEntrust, buffer.data(), (uint32_t)buffer.size());
+}
+
+void EventCapture::record_accounts(const char* trader, const WTSArray* ayAccounts)
+{
+	const std::string& buffer = packArray<CapAccount, WTSAccountInfo>(trader, ayAccounts);
+	append(CET_TrdAccounts, buffer.data(), (uint32_t)buffer.size());
+}
+
+void EventCapture::record_positions(const char* trader, const WTSArray* ayPositions)
+{
+	const std::string& buffer = packArray<CapPosition, WTSPositionItem>(trader, ayPositions);
+	append(CET_TrdPositions, buffer.data(), (uint32_t)buffer.size());
+}
+
+void EventCapture::record_orders(const char* trader, const WTSArray* ayOrders)
+{
+	const std::string& buffer = packArray<CapOrder, WTSOrderInfo>(trader, ayOrders);
+	append(CET_TrdOrders, buffer.data(), (uint32_t)buffer.size());
+}
+
+void EventCapture::record_trades(const char* trader, const WTSArray* ayTrades)
+{
+	const std::string& buffer = packArray<CapTrade, WTSTradeInfo>(trader, ayTrades);
+	append(CET_TrdTrades, buffer.data(), (uint32_t)buffer.size());
+}
+
+void EventCapture::record_order(const char* trader, WTSOrderInfo* ordInfo)
+{
+	const std::string& buffer = packSingle<CapOrder>(trader, ordInfo);
+	append(CET_TrdOrder, buffer.data(), (uint32_t)buffer.size());
+}
+
+void EventCapture::record_trade(const char* trader, WTSTradeInfo* trdInfo)
+{
+	const std::string& buffer = packSingle<CapTrade>(trader, trdInfo);
+	append(CET_TrdTrade, buffer.data(), (uint32_t)buffer.size());
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+//ReplayTraderApi
+bool ReplayTraderApi::makeEntrustID(char* buffer, int length)
+{
+	fmtutil::format_to(buffer, "replay.{}", ++_auto_id);
+	return true;
+}
+
+
+//////////////////////////////////////////////////////////////////////////
+//EventReplayer
+EventReplayer::EventReplayer()
+{
+}
+
+EventReplayer::~EventReplayer()
+{
+}
+
+bool EventReplayer::open(const char* filename)
+{
+	_file.reset(new BoostMappingFile);
+	if (!_file->map(filename, boost::interprocess::read_only, boost::interprocess::read_only))
+	{
+		WTSLogger::error("Mapping capture file {} failed", filename);
+		_file.reset();
+		return false;
+	}
+
+	const CaptureFileHeader* header = (const CaptureFileHeader*)_file->addr();
+	if (_file->size() < sizeof(CaptureFileHeader) || memcmp(header->_flag, CAP_FLAG, sizeof(header->_flag)) != 0)
+	{
+		WTSLogger::error("{} is not a valid capture file", filename);
+		_file.reset();
+		return false;
+	}
+
+	if (header->_version != CAP_VERSION)
+	{
+		WTSLogger::error("Version of capture file {} is {}, {} is expected", filename, header->_version, CAP_VERSION);
+		_file.reset();
+		return false;
+	}
+
+	_filename = filename;
+	return true;
+}
+
+uint64_t EventReplayer::replay(WtUftEngine* engine, TraderAdapterMgr* traders, IBaseDataMgr* bdMgr)
+{
+	if (!_file)
+		return 0;
+
+	const char* cur = (const char*)_file->addr() + sizeof(CaptureFileHeader);
+	const char* end = (const char*)_file->addr() + _file->size();
+
+	//按事件类型统计处理耗时，用来定位慢的环节
+	uint64_t counts[CET_COUNT] = { 0 };
+	int64_t totals[CET_COUNT] = { 0 };
+	int64_t maxes[CET_COUNT] = { 0 };
+
+	bool bStarted = false;
+	uint64_t total = 0;
+	int64_t firstArrival = 0;
+	int64_t lastArrival = 0;
+	int64_t startTime = steadyNano();
+
+	while (cur + sizeof(CaptureRecord) <= end)
+	{
+		const CaptureRecord* rec = (const CaptureRecord*)cur;
+		const char* data = cur + sizeof(CaptureRecord);
+		if (data + rec->_len > end)
+		{
+			WTSLogger::warn("Capture file {} is truncated, last record dropped", _filename);
+			break;
+		}
+		cur = data + rec->_len;
+
+		if (rec->_type >= CET_COUNT)
+			continue;
+
+		if (!bStarted && rec->_type != CET_Clock)
+		{
+			WTSLogger::error("Capture file {} does not start with clock record", _filename);
+			break;
+		}
+
+		if (firstArrival == 0)
+			firstArrival = rec->_arrival;
+		lastArrival = rec->_arrival;
+
+		int64_t tStart = steadyNano();
+		switch (rec->_type)
+		{
+		case CET_Clock:
+			{
+				if (bStarted)
+					break;
+
+				//用录制时的时钟初始化引擎，本地订单号也从录制时的种子开始
+				const CapClock* item = (const CapClock*)data;
+				engine->set_date_time(item->_date, item->_time / 100000, item->_time % 100000, item->_time / 100000);
+				if (item->_order_seed != 0)
+					TraderAdapter::syncLocalOrderID(item->_order_seed - 1);
+
+				WTSLogger::info("Replaying capture {} from {}.{}", _filename, item->_date, item->_time);
+				engine->run(true);
+				traders->run();
+				bStarted = true;
+			}
+			break;
+		case CET_Timer:
+			engine->replay_timer();
+			break;
+		case CET_Tick:
+			{
+				WTSTickStruct& ts = *(WTSTickStruct*)data;
+				WTSTickData* newTick = WTSTickData::create(ts);
+				newTick->setContractInfo(getContract(bdMgr, ts.code, ts.exchg));
+				engine->handle_push_quote(newTick);
+				newTick->release();
+			}
+			break;
+		case CET_OrdQue:
+			{
+				WTSOrdQueData* newData = WTSOrdQueData::create(*(WTSOrdQueStruct*)data);
+				engine->handle_push_order_queue(newData);
+				newData->release();
+			}
+			break;
+		case CET_OrdDtl:
+			{
+				WTSOrdDtlData* newData = WTSOrdDtlData::create(*(WTSOrdDtlStruct*)data);
+				engine->handle_push_order_detail(newData);
+				newData->release();
+			}
+			break;
+		case CET_Trans:
+			{
+				WTSTransData* newData = WTSTransData::create(*(WTSTransStruct*)data);
+				engine->handle_push_transaction(newData);
+				newData->release();
+			}
+			break;
+		default:
+			dispatch_trader(rec->_type, data, traders, bdMgr);
+			break;
+		}
+
+		int64_t elapse = steadyNano() - tStart;
+		counts[rec->_type]++;
+		totals[rec->_type] += elapse;
+		maxes[rec->_type] = std::max(maxes[rec->_type], elapse);
+		total++;
+	}
+
+	int64_t elapse = steadyNano() - startTime;
+	WTSLogger::info("{} events replayed in {:.3f} ms, captured span {:.3f} s, {:.0f} events/s",
+		total, elapse / 1000000.0, (lastArrival - firstArrival) / 1000000000.0, elapse == 0 ? 0.0 : total * 1000000000.0 / elapse);
+	for (uint32_t i = 0; i < CET_COUNT; i++)
+	{
+		if (counts[i] == 0)
+			continue;
+
+		WTSLogger::info("{:<14} count: {:>10}, avg: {:>10.0f} ns, max: {:>10} ns", CET_NAMES[i], counts[i], totals[i] * 1.0 / counts[i], maxes[i]);
+	}
+
+	return total;
+}
+
+void EventReplayer::dispatch_trader(uint32_t etype, const char* data, TraderAdapterMgr* traders, IBaseDataMgr* bdMgr)
+{
+	//所有交易回报的头部都是交易通道ID
+	TraderAdapterPtr adapter = traders->getAdapter(data);
+	if (adapter == NULL)
+		return;
+
+	switch (etype)
+	{
+	case CET_TrdEvent:
+		{
+			const CapTrdEvent* item = (const CapTrdEvent*)data;
+			adapter->handleEvent((WTSTraderEvent)item->_event, item->_ec);
+		}
+		break;
+	case CET_TrdLogin:
+		{
+			const CapTrdLogin* item = (const CapTrdLogin*)data;
+			ReplayTraderApi* api = dynamic_cast<ReplayTraderApi*>(adapter->getTraderApi());
+			if (api)
+				api->set_modify_supported((item->_features & 1) != 0);
+			adapter->onLoginResult(item->_success != 0, item->_message, item->_tdate);
+		}
+		break;
+	case CET_TrdEntrust:
+		{
+			const CapEntrust& item = *(const CapEntrust*)(data + sizeof(CapTrdArray));
+			WTSEntrust* entrust = WTSEntrust::create(item._code, item._volume, item._price, item._exchg, (WTSBusinessType)item._business);
+			entrust->setDirection((WTSDirectionType)item._direct);
+			entrust->setPriceType((WTSPriceType)item._price_type);
+			entrust->setOrderFlag((WTSOrderFlag)item._order_flag);
+			entrust->setOffsetType((WTSOffsetType)item._offset);
+			entrust->setEntrustID(item._entrustid);
+			entrust->setUserTag(item._usertag);
+			entrust->setContractInfo(getContract(bdMgr, item._code, item._exchg));
+
+			WTSError* err = (item._errcode != WEC_NONE) ? WTSError::create((WTSErroCode)item._errcode, item._errmsg) : NULL;
+			adapter->onRspEntrust(entrust, err);
+
+			entrust->release();
+			if (err)
+				err->release();
+		}
+		break;
+	case CET_TrdOrder:
+		{
+			WTSOrderInfo* ordInfo = fromCapture(*(const CapOrder*)(data + sizeof(CapTrdArray)), bdMgr);
+			adapter->onPushOrder(ordInfo);
+			ordInfo->release();
+		}
+		break;
+	case CET_TrdTrade:
+		{
+			WTSTradeInfo* trdInfo = fromCapture(*(const CapTrade*)(data + sizeof(CapTrdArray)), bdMgr);
+			adapter->onPushTrade(trdInfo);
+			trdInfo->release();
+		}
+		break;
+	default:
+		{
+			const CapTrdArray* header = (const CapTrdArray*)data;
+			const char* items = data + sizeof(CapTrdArray);
+			WTSArray* ayItems = WTSArray::create();
+			for (uint32_t i = 0; i < header->_count; i++)
+			{
+				if (etype == CET_TrdAccounts)
+					ayItems->append(fromCapture(((const CapAccount*)items)[i]), false);
+				else if (etype == CET_TrdPositions)
+					ayItems->append(fromCapture(((const CapPosition*)items)[i], bdMgr), false);
+				else if (etype == CET_TrdOrders)
+					ayItems->append(fromCapture(((const CapOrder*)items)[i], bdMgr), false);
+				else if (etype == CET_TrdTrades)
+					ayItems->append(fromCapture(((const CapTrade*)items)[i], bdMgr), false);
+			}
+
+			if (etype == CET_TrdAccounts)
+				adapter->onRspAccount(ayItems);
+			else if (etype == CET_TrdPositions)
+				adapter->onRspPosition(ayItems);
+			else if (etype == CET_TrdOrders)
+				adapter->onRspOrders(ayItems);
+			else if (etype == CET_TrdTrades)
+				adapter->onRspTrades(ayItems);
+
+			ayItems->release();
+		}
+		break;
+	}
+}
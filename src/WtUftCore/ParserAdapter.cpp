@@ -406,4 +406,28 @@ void ParserAdapterMgr::run()
 	}
 
 	WTSLogger::info("{} parsers started", _adapters.size());
+}
+
+uint32_t ParserAdapterMgr::enable_polling()
+{
+	_pollers.clear();
+	for (auto it = _adapters.begin(); it != _adapters.end(); it++)
+	{
+		ParserAdapterPtr& adapter = it->second;
+		IParserApi* api = adapter->getParserApi();
+		if (api == NULL)
+			continue;
+
+		if (api->enablePolling())
+		{
+			_pollers.emplace_back(api);
+			WTSLogger::info("Parser {} switched to polling mode", adapter->id());
+		}
+		else
+		{
+			WTSLogger::warn("Parser {} does not support polling mode, data will still be pushed from its own threads", adapter->id());
+		}
+	}
+
+	return (uint32_t)_pollers.size();
 }
\ No newline at end of file
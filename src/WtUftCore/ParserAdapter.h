@@ -45,6 +45,8 @@ public:
 
 	const char* id() const{ return _id.c_str(); }
 
+	inline IParserApi* getParserApi() { return _parser_api; }
+
 public:
 	virtual void handleSymbolList(const WTSArray* aySymbols) override {}
 
@@ -107,9 +109,29 @@ public:
 
 	bool	addAdapter(const char* id, ParserAdapterPtr& adapter);
 
+	/*
+	 *	把支持轮询的行情通道切换到轮询模式，要在run之前调用
+	 *	返回切换成功的通道数
+	 */
+	uint32_t	enable_polling();
+
+	/*
+	 *	轮询所有轮询模式的行情通道一次，返回处理的数据条数
+	 */
+	inline uint32_t poll()
+	{
+		uint32_t count = 0;
+		for (IParserApi* api : _pollers)
+			count += api->poll();
+		return count;
+	}
+
 
 public:
 	ParserAdapterMap _adapters;
+
+private:
+	std::vector<IParserApi*>	_pollers;
 };
 
 NS_WTP_END
\ No newline at end of file
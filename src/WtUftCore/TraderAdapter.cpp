@@ -11,6 +11,7 @@
 #include "WtHelper.h"
 #include "ITrdNotifySink.h"
 #include "ActionPolicyMgr.h"
+#include "EventCapture.h"
 
 #include "../Includes/WTSError.hpp"
 #include "../Includes/WTSVariant.hpp"
@@ -35,15 +36,19 @@
 namespace rj = rapidjson;
 using namespace std;
 
-inline uint32_t makeLocalOrderID()
+static std::atomic<uint32_t> _auto_order_id{ 0 };
+
+inline uint32_t makeLocalOrderID(bool bPeek = false)
 {
-	static std::atomic<uint32_t> _auto_order_id{ 0 };
 	if (_auto_order_id == 0)
 	{
 		uint32_t curYear = TimeUtils::getCurDate() / 10000 * 10000 + 101;
 		_auto_order_id = (uint32_t)((TimeUtils::getLocalTimeNow() - TimeUtils::makeTime(curYear, 0)) / 1000 * 50);
 	}
 
+	if (bPeek)
+		return _auto_order_id.load();
+
 	return _auto_order_id.fetch_add(1);
 }
 
@@ -77,6 +82,9 @@ TraderAdapter::TraderAdapter()
 	, _orders(NULL)
 	, _risk_mon_enabled(false)
 	, _stat_map(NULL)
+	, _standby(NULL)
+	, _fence_logged(false)
+	, _capture(NULL)
 {
 }
 
@@ -100,7 +108,7 @@ bool TraderAdapter::initExt(const char* id, ITraderApi* api, IBaseDataMgr* bdMgr
 	return true;
 }
 
-bool TraderAdapter::init(const char* id, WTSVariant* params, IBaseDataMgr* bdMgr, ActionPolicyMgr* policyMgr)
+bool TraderAdapter::init(const char* id, WTSVariant* params, IBaseDataMgr* bdMgr, ActionPolicyMgr* policyMgr, ITraderApi* api /* = NULL */)
 {
 	if (params == NULL)
 		return false;
@@ -159,6 +167,12 @@ bool TraderAdapter::init(const char* id, WTSVariant* params, IBaseDataMgr* bdMgr
 		WTSLogger::log_dyn("trader", _id.c_str(), LL_WARN, "[{}] No risk control rule setup of trading channel", _id.c_str());
 	}
 
+	if (api != NULL)
+	{
+		_trader_api = api;
+		return _trader_api->init(params);
+	}
+
 	if (params->getString("module").empty())
 		return false;
 
@@ -308,8 +322,51 @@ void TraderAdapter::updateUndone(const char* stdCode, double qty)
 	undone += qty;
 }
 
-uint32_t TraderAdapter::doEntrust(WTSEntrust* entrust)
+inline bool TraderAdapter::isFenced()
 {
+	if (_standby == NULL)
+		return false;
+
+	if (_standby->is_leader())
+	{
+		//重新成为主进程以后，下一次变成备进程时还要再提示一次
+		if (_fence_logged.load(std::memory_order_relaxed))
+			_fence_logged.store(false, std::memory_order_relaxed);
+		return false;
+	}
+
+	//每次角色切换只提示一次，避免每条指令都刷一行日志
+	if (!_fence_logged.exchange(true))
+		WTSLogger::log_dyn("trader", _id.c_str(), LL_WARN, "[{}] Instructions blocked, current process is not the leader of standby group", _id.c_str());
+	return true;
+}
+
+void TraderAdapter::syncLocalOrderID(uint32_t localid)
+{
+	uint32_t curID = _auto_order_id.load();
+	while (curID <= localid && !_auto_order_id.compare_exchange_weak(curID, localid + 1));
+}
+
+uint32_t TraderAdapter::peekLocalOrderID()
+{
+	return makeLocalOrderID(true);
+}
+
+void TraderAdapter::resync()
+{
+	if (_state != AS_ALLREADY)
+		return;
+
+	WTSLogger::log_dyn("trader", _id.c_str(), LL_INFO, "[{}] Resyncing positions and orders after takeover", _id.c_str());
+	_trader_api->queryPositions();
+	_trader_api->queryOrders();
+}
+
+uint32_t TraderAdapter::doEntrust(WTSEntrust* entrust, uint32_t localid /* = 0 */)
+{
+	if (isFenced())
+		return UINT_MAX;
+
 	_trader_api->makeEntrustID(entrust->getEntrustID(), 64);
 
 	const char* stdCode = entrust->getCode();
@@ -322,7 +379,9 @@ uint32_t TraderAdapter::doEntrust(WTSEntrust* entrust)
 	//	entrust->setContractInfo(cInfo);
 	//}
 
-	uint32_t localid = makeLocalOrderID();
+	//改单重新下单的时候, 本地订单号是提前分配好的
+	if (localid == 0)
+		localid = makeLocalOrderID();
 	char* usertag = entrust->getUserTag();
 	wt_strcpy(usertag, _order_pattern.c_str(), _order_pattern.size());
 	usertag[_order_pattern.size()] = '.';
@@ -334,6 +393,9 @@ uint32_t TraderAdapter::doEntrust(WTSEntrust* entrust)
 		WTSLogger::log_dyn("trader", _id.c_str(), LL_ERROR, "[{}] Order placing failed: {}", _id, ret);
 		return UINT_MAX;
 	}
+
+	if (_standby)
+		_standby->append(SRT_OrderID, _id.c_str(), (const char*)&localid, sizeof(uint32_t));
 	//else if(_risk_mon_enabled)
 	//{
 	//	int64_t now = TimeUtils::getLocalTimeNow();
@@ -356,6 +418,9 @@ bool TraderAdapter::doCancel(WTSOrderInfo* ordInfo)
 	if (ordInfo == NULL || !ordInfo->isAlive())
 		return false;
 
+	if (isFenced())
+		return false;
+
 	WTSContractInfo* cInfo = ordInfo->getContractInfo();
 	if(cInfo == NULL)
 		cInfo = _bd_mgr->getContract(ordInfo->getCode(), ordInfo->getExchg());
@@ -396,6 +461,103 @@ bool TraderAdapter::cancel(uint32_t localid)
 	return bRet;
 }
 
+uint32_t TraderAdapter::modify(uint32_t localid, double newPrice, double newQty)
+{
+	if (_orders == NULL || _orders->size() == 0 || decimal::le(newQty, 0))
+		return 0;
+
+	WTSOrderInfo* ordInfo = NULL;
+	{
+		SpinLock lock(_mtx_orders);
+		ordInfo = (WTSOrderInfo*)_orders->grab(localid);
+		if (ordInfo == NULL)
+			return 0;
+	}
+
+	uint32_t ret = 0;
+	do
+	{
+		if (!ordInfo->isAlive())
+			break;
+
+		if (isFenced())
+			break;
+
+		if (_trader_api->isModifySupported())
+		{
+			WTSContractInfo* cInfo = ordInfo->getContractInfo();
+			if (cInfo == NULL)
+				cInfo = _bd_mgr->getContract(ordInfo->getCode(), ordInfo->getExchg());
+
+			//先记下当前的委托数量, 改单回报以后根据数量变化更新未完成数量和可平量
+			{
+				SpinLock lock(_mtx_modify);
+				_modifying.emplace(localid, ordInfo->getVolume());
+			}
+
+			WTSEntrustAction* action = WTSEntrustAction::createModifyAction(ordInfo->getCode(), cInfo->getExchg(), newPrice, newQty);
+			action->setEntrustID(ordInfo->getEntrustID());
+			action->setOrderID(ordInfo->getOrderID());
+			action->setContractInfo(cInfo);
+			int iRet = _trader_api->orderModify(action);
+			action->release();
+			if (iRet < 0)
+			{
+				//改单没有发出去, 不会再有改单回报
+				{
+					SpinLock lock(_mtx_modify);
+					_modifying.erase(localid);
+				}
+				WTSLogger::log_dyn("trader", _id.c_str(), LL_ERROR, "[{}] Modifying order {} failed: {}", _id.c_str(), localid, iRet);
+				break;
+			}
+
+			ret = localid;
+			break;
+		}
+
+		{
+			//已经在改单中的订单, 直接更新新的价格和数量, 不再重复撤单
+			SpinLock lock(_mtx_modify);
+			auto it = _replacing.find(localid);
+			if (it != _replacing.end())
+			{
+				ReplaceItem& rItem = it->second;
+				rItem._price = newPrice;
+				rItem._qty = newQty;
+				ret = rItem._localid;
+				break;
+			}
+
+			//撤单回报可能在撤单接口返回之前就到了, 所以要先登记
+			ReplaceItem& rItem = _replacing[localid];
+			rItem._localid = makeLocalOrderID();
+			rItem._price = newPrice;
+			rItem._qty = newQty;
+			ret = rItem._localid;
+		}
+
+		//模拟改单的撤单是真实的撤单, 要做撤单频率检查
+		WTSContractInfo* cInfo = ordInfo->getContractInfo();
+		if (cInfo == NULL)
+			cInfo = _bd_mgr->getContract(ordInfo->getCode(), ordInfo->getExchg());
+		std::string stdCode = cInfo->getFullCode();
+		if ((_risk_mon_enabled && !checkCancelLimits(stdCode.c_str())) || !doCancel(ordInfo))
+		{
+			SpinLock lock(_mtx_modify);
+			_replacing.erase(localid);
+			ret = 0;
+			break;
+		}
+
+		if (_risk_mon_enabled)
+			_cancel_time_cache[stdCode].emplace_back(TimeUtils::getLocalTimeNow());
+	} while (false);
+
+	ordInfo->release();
+	return ret;
+}
+
 OrderIDs TraderAdapter::cancelAll(const char* stdCode)
 {
 	OrderIDs ret;
@@ -441,6 +603,9 @@ OrderIDs TraderAdapter::buy(const char* stdCode, double price, double qty, int f
 	if (qty == 0)
 		return ret;
 
+	if (isFenced())
+		return ret;
+
 	//if(_risk_mon_enabled && !checkOrderLimits(stdCode))
 	//{
 	//	WTSLogger::log_dyn("trader", _id.c_str(), LL_WARN, "{} is forbidden to trade", stdCode);
@@ -721,6 +886,9 @@ OrderIDs TraderAdapter::sell(const char* stdCode, double price, double qty, int
 	if (qty == 0)
 		return ret;
 
+	if (isFenced())
+		return ret;
+
 	//if (_risk_mon_enabled && !checkOrderLimits(stdCode))
 	//{
 	//	WTSLogger::log_dyn("trader", _id.c_str(), LL_WARN, "{} is forbidden to trade", stdCode);
@@ -1107,10 +1275,92 @@ uint32_t TraderAdapter::closeShort(const char* stdCode, double price, double qty
 	return ret;
 }
 
+uint32_t TraderAdapter::stageOrder(const char* stdCode, bool isLong, bool isOpen, bool isToday, int flag)
+{
+	WTSContractInfo* cInfo = getContract(stdCode);
+	if (cInfo == NULL)
+	{
+		WTSLogger::log_dyn("trader", _id.c_str(), LL_ERROR, "[{}] Staging order of {} failed: contract not found", _id, stdCode);
+		return 0;
+	}
+
+	WTSEntrust* entrust = WTSEntrust::create(cInfo->getCode(), 0, 0, cInfo->getExchg());
+	entrust->setContractInfo(cInfo);
+	entrust->setPriceType(WPT_LIMITPRICE);
+	entrust->setOrderFlag((WTSOrderFlag)(WOF_NOR + flag));
+	entrust->setDirection(isLong ? WDT_LONG : WDT_SHORT);
+	entrust->setOffsetType(isOpen ? WOT_OPEN : (isToday ? WOT_CLOSETODAY : WOT_CLOSE));
+
+	StagedOrder so;
+	so._std_code = stdCode;
+	so._api_id = _trader_api->stageOrder(entrust);
+	so._is_long = isLong;
+	so._is_open = isOpen;
+	so._is_today = isToday;
+	so._flag = flag;
+	entrust->release();
+
+	//用户标记的前缀是固定的，下单的时候只需要追加本地订单号
+	//前缀最长截到缓冲区-2，保证后面至少还能放下分隔符和结束符
+	std::size_t preLen = std::min(_order_pattern.size(), sizeof(so._usertag) - 2);
+	wt_strcpy(so._usertag, _order_pattern.c_str(), preLen);
+	so._usertag[preLen] = '.';
+	so._tag_len = (uint32_t)preLen + 1;
+
+	_staged.emplace_back(so);
+	WTSLogger::log_dyn("trader", _id.c_str(), LL_INFO, "[{}] Order template #{} of {} staged, native: {}", _id, _staged.size(), stdCode, so._api_id != 0 ? "yes" : "no");
+	return (uint32_t)_staged.size();
+}
+
+uint32_t TraderAdapter::sendStaged(uint32_t stageid, double price, double qty)
+{
+	if (stageid == 0 || stageid > _staged.size())
+	{
+		WTSLogger::log_dyn("trader", _id.c_str(), LL_ERROR, "[{}] Order template #{} not exists", _id, stageid);
+		return UINT_MAX;
+	}
+
+	StagedOrder& so = _staged[stageid - 1];
+	const char* stdCode = so._std_code.c_str();
+
+	//市价单或者交易通道不支持模板，走普通下单
+	if (so._api_id == 0 || price == 0.0)
+	{
+		if (so._is_open)
+			return so._is_long ? openLong(stdCode, price, qty, so._flag) : openShort(stdCode, price, qty, so._flag);
+		else
+			return so._is_long ? closeLong(stdCode, price, qty, so._is_today, so._flag) : closeShort(stdCode, price, qty, so._is_today, so._flag);
+	}
+
+	if (isFenced())
+		return UINT_MAX;
+
+	uint32_t localid = makeLocalOrderID();
+	std::size_t maxLen = sizeof(so._usertag) - so._tag_len - 1;
+	auto res = fmt::format_to_n(so._usertag + so._tag_len, maxLen, "{}", localid);
+	so._usertag[so._tag_len + std::min((std::size_t)res.size, maxLen)] = '\0';
+
+	updateUndone(stdCode, qty);
+
+	int32_t ret = _trader_api->orderInsertStaged(so._api_id, price, qty, so._usertag);
+	if (ret < 0)
+	{
+		WTSLogger::log_dyn("trader", _id.c_str(), LL_ERROR, "[{}] Order placing failed: {}", _id, ret);
+		return UINT_MAX;
+	}
+
+	if (_standby)
+		_standby->append(SRT_OrderID, _id.c_str(), (const char*)&localid, sizeof(uint32_t));
+	return localid;
+}
+
 
 #pragma region "ITraderSpi接口"
 void TraderAdapter::handleEvent(WTSTraderEvent e, int32_t ec)
 {
+	if (_capture)
+		_capture->record_trader_event(_id.c_str(), e, ec);
+
 	if(e == WTE_Connect)
 	{
 		if(ec == 0)
@@ -1132,6 +1382,9 @@ void TraderAdapter::handleEvent(WTSTraderEvent e, int32_t ec)
 
 void TraderAdapter::onLoginResult(bool bSucc, const char* msg, uint32_t tradingdate)
 {
+	if (_capture)
+		_capture->record_login(_id.c_str(), bSucc, msg, tradingdate, _trader_api->isModifySupported());
+
 	if(!bSucc)
 	{
 		_state = AS_LOGINFAILED;
@@ -1153,6 +1406,9 @@ void TraderAdapter::onLogout()
 
 void TraderAdapter::onRspEntrust(WTSEntrust* entrust, WTSError *err)
 {
+	if (_capture)
+		_capture->record_entrust(_id.c_str(), entrust, err);
+
 	if (err && err->getErrorCode() != WEC_NONE)
 	{
 		WTSLogger::log_dyn("trader", _id.c_str(), LL_ERROR,err->getMessage());
@@ -1205,6 +1461,9 @@ void TraderAdapter::onRspEntrust(WTSEntrust* entrust, WTSError *err)
 
 void TraderAdapter::onRspAccount(WTSArray* ayAccounts)
 {
+	if (_capture)
+		_capture->record_accounts(_id.c_str(), ayAccounts);
+
 	if(_state == AS_TRADES_QRYED)
 	{
 		_state = AS_ALLREADY;
@@ -1217,6 +1476,9 @@ void TraderAdapter::onRspAccount(WTSArray* ayAccounts)
 
 void TraderAdapter::onRspPosition(const WTSArray* ayPositions)
 {
+	if (_capture)
+		_capture->record_positions(_id.c_str(), ayPositions);
+
 	if (ayPositions && ayPositions->size() > 0)
 	{
 		for (auto it = ayPositions->begin(); it != ayPositions->end(); it++)
@@ -1270,6 +1532,9 @@ void TraderAdapter::onRspPosition(const WTSArray* ayPositions)
 
 void TraderAdapter::onRspOrders(const WTSArray* ayOrders)
 {
+	if (_capture)
+		_capture->record_orders(_id.c_str(), ayOrders);
+
 	if (ayOrders)
 	{
 		if (_orders == NULL)
@@ -1404,6 +1669,9 @@ void TraderAdapter::printPosition(const char* code, const PosItem& pItem)
 
 void TraderAdapter::onRspTrades(const WTSArray* ayTrades)
 {
+	if (_capture)
+		_capture->record_trades(_id.c_str(), ayTrades);
+
 	if (ayTrades)
 	{
 		for (auto it = ayTrades->begin(); it != ayTrades->end(); it++)
@@ -1491,6 +1759,9 @@ void TraderAdapter::onPushOrder(WTSOrderInfo* orderInfo)
 	if (orderInfo == NULL)
 		return;
 
+	if (_capture)
+		_capture->record_order(_id.c_str(), orderInfo);
+
 
 	WTSContractInfo* cInfo = _bd_mgr->getContract(orderInfo->getCode(), orderInfo->getExchg());
 	if (cInfo == NULL)
@@ -1508,6 +1779,15 @@ void TraderAdapter::onPushOrder(WTSOrderInfo* orderInfo)
 	}
 	TradeStatInfo& statItem = statInfo->statInfo();
 
+	//模拟改单的订单结束了, 撤单照常计入撤单统计, 后面要用新的价格和数量重新下单
+	bool isReplaced = false;
+	if (!orderInfo->isAlive() && StrUtil::startsWith(orderInfo->getUserTag(), _order_pattern.c_str(), true))
+	{
+		uint32_t lid = strtoul(orderInfo->getUserTag() + _order_pattern.size() + 1, NULL, 10);
+		SpinLock lock(_mtx_modify);
+		isReplaced = (_replacing.find(lid) != _replacing.end());
+	}
+
 	//撤销的话, 要更新统计数据
 	if (orderInfo->getOrderState() == WOS_Canceled)
 	{
@@ -1700,6 +1980,8 @@ void TraderAdapter::onPushOrder(WTSOrderInfo* orderInfo)
 	//如果是wt发出去的单子则需要更新内部数据
 	if(localid != 0)
 	{
+		checkModified(localid, stdCode.c_str(), orderInfo);
+
 		{
 			SpinLock lock(_mtx_orders);
 			if (!orderInfo->isAlive() && _orders)
@@ -1728,11 +2010,123 @@ void TraderAdapter::onPushOrder(WTSOrderInfo* orderInfo)
 		for (auto sink : _sinks)
 			sink->on_order(localid, stdCode.c_str(), orderInfo->getDirection()==WDT_LONG, offset, 
 				orderInfo->getVolume(), orderInfo->getVolLeft(), orderInfo->getPrice(), orderInfo->getOrderState() == WOS_Canceled);
+
+		if (isReplaced)
+			doReplace(localid, stdCode.c_str(), orderInfo);
+	}
+}
+
+void TraderAdapter::checkModified(uint32_t localid, const char* stdCode, WTSOrderInfo* ordInfo)
+{
+	double lastQty = 0;
+	{
+		SpinLock lock(_mtx_modify);
+		auto it = _modifying.find(localid);
+		if (it == _modifying.end())
+			return;
+
+		lastQty = it->second;
+		if (ordInfo->isAlive())
+			it->second = ordInfo->getVolume();
+		else
+			_modifying.erase(it);
+	}
+
+	double diff = ordInfo->getVolume() - lastQty;
+	if (decimal::eq(diff, 0))
+		return;
+
+	WTSLogger::log_dyn("trader", _id.c_str(), LL_DEBUG, "[{}] Order {} of {} modified, qty: {} -> {}, price: {}",
+		_id.c_str(), localid, stdCode, lastQty, ordInfo->getVolume(), ordInfo->getPrice());
+
+	bool isLong = (ordInfo->getDirection() == WDT_LONG);
+	bool isOpen = (ordInfo->getOffsetType() == WOT_OPEN);
+	updateUndone(stdCode, diff);
+
+	//平仓单的数量变了, 可平量也要跟着调整
+	if (isOpen)
+		return;
+
+	PosItem& pItem = _positions[stdCode];
+	double& preavail = isLong ? pItem.l_preavail : pItem.s_preavail;
+	double& newavail = isLong ? pItem.l_newavail : pItem.s_newavail;
+	double prevol = isLong ? pItem.l_prevol : pItem.s_prevol;
+	if (ordInfo->getOffsetType() == WOT_CLOSETODAY)
+	{
+		newavail -= diff;
+	}
+	else if (diff > 0)
+	{
+		//数量增加, 先扣减可平昨仓, 再扣减可平今仓
+		double maxQty = min(preavail, diff);
+		preavail -= maxQty;
+		newavail -= diff - maxQty;
+	}
+	else
+	{
+		//数量减少, 先释放到昨仓, 超出昨仓的部分释放到今仓
+		preavail -= diff;
+		if (preavail > prevol)
+		{
+			newavail += (preavail - prevol);
+			preavail = prevol;
+		}
+	}
+	newavail = max(newavail, 0.0);
+	printPosition(stdCode, pItem);
+}
+
+void TraderAdapter::doReplace(uint32_t localid, const char* stdCode, WTSOrderInfo* ordInfo)
+{
+	ReplaceItem rItem;
+	{
+		SpinLock lock(_mtx_modify);
+		auto it = _replacing.find(localid);
+		if (it == _replacing.end())
+			return;
+
+		rItem = it->second;
+		_replacing.erase(it);
+	}
+
+	//撤单之前订单已经结束了, 就不再重新下单了
+	if (ordInfo->getOrderState() != WOS_Canceled)
+	{
+		WTSLogger::log_dyn("trader", _id.c_str(), LL_WARN, "[{}] Order {} of {} finished before replaced, replacing order {} dropped",
+			_id.c_str(), localid, stdCode, rItem._localid);
+		for (auto sink : _sinks)
+			sink->on_entrust(rItem._localid, stdCode, false, "order finished before replaced");
+		return;
 	}
+
+	//doEntrust里会把标准代码拆成交易所和合约代码
+	WTSEntrust* entrust = WTSEntrust::create(stdCode, rItem._qty, rItem._price);
+	entrust->setContractInfo(ordInfo->getContractInfo());
+	if (decimal::eq(rItem._price, 0.0))
+		entrust->setPriceType(WPT_ANYPRICE);
+	else
+		entrust->setPriceType(WPT_LIMITPRICE);
+	entrust->setOrderFlag(ordInfo->getOrderFlag());
+	entrust->setDirection(ordInfo->getDirection());
+	entrust->setOffsetType(ordInfo->getOffsetType());
+
+	uint32_t ret = doEntrust(entrust, rItem._localid);
+	entrust->release();
+	if (ret == UINT_MAX)
+	{
+		for (auto sink : _sinks)
+			sink->on_entrust(rItem._localid, stdCode, false, "replacing order placing failed");
+		return;
+	}
+
+	updateUndone(stdCode, rItem._qty);
 }
 
 void TraderAdapter::onPushTrade(WTSTradeInfo* tradeRecord)
 {
+	if (_capture)
+		_capture->record_trade(_id.c_str(), tradeRecord);
+
 	WTSContractInfo* cInfo = tradeRecord->getContractInfo();
 	cInfo = _bd_mgr->getContract(tradeRecord->getCode(), tradeRecord->getExchg());
 	if (cInfo == NULL)
@@ -2023,6 +2417,54 @@ void TraderAdapterMgr::run()
 	WTSLogger::info("{} trading channels started", _adapters.size());
 }
 
+uint32_t TraderAdapterMgr::enable_polling()
+{
+	_pollers.clear();
+	for (auto it = _adapters.begin(); it != _adapters.end(); it++)
+	{
+		TraderAdapterPtr& adapter = it->second;
+		ITraderApi* api = adapter->getTraderApi();
+		if (api == NULL)
+			continue;
+
+		if (api->enablePolling())
+		{
+			_pollers.emplace_back(api);
+			WTSLogger::info("Trader {} switched to polling mode", adapter->id());
+		}
+		else
+		{
+			WTSLogger::warn("Trader {} does not support polling mode, responses will still be pushed from its own threads", adapter->id());
+		}
+	}
+
+	return (uint32_t)_pollers.size();
+}
+
+void TraderAdapterMgr::set_standby(ShmStandby* standby)
+{
+	for (auto it = _adapters.begin(); it != _adapters.end(); it++)
+	{
+		it->second->setStandby(standby);
+	}
+}
+
+void TraderAdapterMgr::set_capture(EventCapture* capture)
+{
+	for (auto it = _adapters.begin(); it != _adapters.end(); it++)
+	{
+		it->second->setCapture(capture);
+	}
+}
+
+void TraderAdapterMgr::resync()
+{
+	for (auto it = _adapters.begin(); it != _adapters.end(); it++)
+	{
+		it->second->resync();
+	}
+}
+
 void TraderAdapterMgr::release()
 {
 	for (auto it = _adapters.begin(); it != _adapters.end(); it++)
@@ -15,6 +15,7 @@
 #include "../Share/StdUtils.hpp"
 #include "../Includes/WTSCollection.hpp"
 #include "../Share/SpinMutex.hpp"
+#include "../Share/ShmStandby.hpp"
 
 NS_WTP_BEGIN
 class WTSVariant;
@@ -22,6 +23,7 @@ class WTSContractInfo;
 class WTSCommodityInfo;
 class ITrdNotifySink;
 class ActionPolicyMgr;
+class EventCapture;
 
 typedef std::vector<uint32_t> OrderIDs;
 typedef WTSMap<uint32_t> OrderMap;
@@ -98,7 +100,10 @@ public:
 	} RiskParams;
 
 public:
-	bool init(const char* id, WTSVariant* params, IBaseDataMgr* bdMgr, ActionPolicyMgr* policyMgr);
+	/*
+	 *	@api	外部指定的交易接口，不为空则不再加载交易模块(回放用)
+	 */
+	bool init(const char* id, WTSVariant* params, IBaseDataMgr* bdMgr, ActionPolicyMgr* policyMgr, ITraderApi* api = NULL);
 
 	bool initExt(const char* id, ITraderApi* api, IBaseDataMgr* bdMgr, ActionPolicyMgr* policyMgr);
 
@@ -115,10 +120,52 @@ public:
 		_sinks.insert(sink);
 	}
 
+	/*
+	 *	设置主备热切换组件，没有租约的时候不能下单撤单
+	 */
+	inline void setStandby(ShmStandby* standby) { _standby = standby; }
+
+	/*
+	 *	设置事件录制组件，所有交易回报都会先录制再处理
+	 */
+	inline void setCapture(EventCapture* capture) { _capture = capture; }
+
+	inline ITraderApi* getTraderApi() { return _trader_api; }
+
+	/*
+	 *	重新查询持仓和订单，备进程接管以后调用
+	 */
+	void resync();
+
+	/*
+	 *	同步主进程已经使用的本地订单号，保证接管以后不会生成重复的订单号
+	 */
+	static void syncLocalOrderID(uint32_t localid);
+
+	/*
+	 *	查看下一个本地订单号，不消耗
+	 */
+	static uint32_t peekLocalOrderID();
+
 private:
-	uint32_t doEntrust(WTSEntrust* entrust);
+	/*
+	 *	fencing检查，主备模式下只有持有租约的进程才能发出交易指令
+	 */
+	inline bool isFenced();
+
+	uint32_t doEntrust(WTSEntrust* entrust, uint32_t localid = 0);
 	bool	doCancel(WTSOrderInfo* ordInfo);
 
+	/*
+	 *	原生改单回报以后，订单数量可能发生变化，同步更新未完成数量和可平量
+	 */
+	void	checkModified(uint32_t localid, const char* stdCode, WTSOrderInfo* ordInfo);
+
+	/*
+	 *	模拟改单的撤单回报以后，按照新的价格和数量重新下单
+	 */
+	void	doReplace(uint32_t localid, const char* stdCode, WTSOrderInfo* ordInfo);
+
 	inline void	printPosition(const char* stdCode, const PosItem& pItem);
 
 	inline WTSContractInfo* getContract(const char* stdCode);
@@ -186,10 +233,48 @@ public:
 	 *	@flag		下单标志: 0-normal，1-fak，2-fok，默认0
 	 */
 	uint32_t closeShort(const char* stdCode, double price, double qty, bool isToday, int flag);
+
+	/*
+	 *	预置下单模板
+	 *	合约、方向、开平和订单标志在这里一次性解析好，交易通道支持的话也会预先转换成通道的委托结构
+	 *	要在下单线程里调用
+	 *
+	 *	@stdCode	合约代码
+	 *	@isLong		多头还是空头
+	 *	@isOpen		开仓还是平仓
+	 *	@isToday	平仓的时候是否平今
+	 *	@flag		下单标志: 0-normal，1-fak，2-fok
+	 *	@return		模板编号，失败返回0
+	 */
+	uint32_t stageOrder(const char* stdCode, bool isLong, bool isOpen, bool isToday, int flag);
+
+	/*
+	 *	按预置模板下单，只填价格、数量和用户标记
+	 *	价格为0或者交易通道不支持模板的，退回到普通下单
+	 *
+	 *	@stageid	stageOrder返回的模板编号
+	 *	@price		下单价格
+	 *	@qty		下单数量
+	 *	@return		本地订单号
+	 */
+	uint32_t sendStaged(uint32_t stageid, double price, double qty);
 	
 	bool	cancel(uint32_t localid);
 	OrderIDs cancelAll(const char* stdCode);
 
+	/*
+	 *	改单接口
+	 *	交易通道支持原生改单的，直接改单，本地订单号不变
+	 *	不支持的，先撤单，等撤单回报以后再用新的价格和数量重新下单，返回重新下单的本地订单号
+	 *	改单引起的撤单不计入撤单统计
+	 *
+	 *	@localid	要修改的本地订单号
+	 *	@newPrice	新的委托价格，0则是市价单
+	 *	@newQty		新的剩余数量
+	 *	@return		改单以后的本地订单号，失败返回0
+	 */
+	uint32_t modify(uint32_t localid, double newPrice, double newQty);
+
 	inline bool	isTradeEnabled(const char* stdCode) const;
 
 	bool	checkCancelLimits(const char* stdCode);
@@ -248,6 +333,17 @@ private:
 
 	wt_hashmap<std::string, double> _undone_qty;	//未完成数量
 
+	//模拟改单的订单，撤单回报以后重新下单
+	typedef struct _ReplaceItem
+	{
+		uint32_t	_localid;	//重新下单的本地订单号
+		double		_price;
+		double		_qty;
+	} ReplaceItem;
+	SpinMutex	_mtx_modify;
+	wt_hashmap<uint32_t, ReplaceItem>	_replacing;
+	wt_hashmap<uint32_t, double>		_modifying;	//原生改单的订单，value为最后一次确认的委托数量
+
 	typedef WTSHashMap<std::string>	TradeStatMap;
 	TradeStatMap*	_stat_map;	//统计数据
 
@@ -263,6 +359,24 @@ private:
 	typedef wt_hashmap<std::string, RiskParams>	RiskParamsMap;
 	RiskParamsMap	_risk_params_map;
 	bool			_risk_mon_enabled;
+
+	ShmStandby*		_standby;	//主备热切换组件
+	std::atomic<bool>	_fence_logged;	//本轮备机状态是否已经输出过拦截日志
+	EventCapture*	_capture;	//事件录制组件
+
+	//预置的下单模板
+	typedef struct _StagedOrder
+	{
+		std::string	_std_code;
+		uint32_t	_api_id;		//交易通道的模板编号，0为不支持
+		bool		_is_long;
+		bool		_is_open;
+		bool		_is_today;
+		int			_flag;
+		uint32_t	_tag_len;		//用户标记前缀的长度，下单时只追加本地订单号
+		char		_usertag[64];
+	} StagedOrder;
+	std::vector<StagedOrder>	_staged;
 };
 
 typedef std::shared_ptr<TraderAdapter>					TraderAdapterPtr;
@@ -284,8 +398,32 @@ public:
 
 	bool	addAdapter(const char* tname, TraderAdapterPtr& adapter);
 
+	void	set_standby(ShmStandby* standby);
+
+	void	set_capture(EventCapture* capture);
+
+	void	resync();
+
+	/*
+	 *	把支持轮询的交易通道切换到轮询模式，要在run之前调用
+	 *	返回切换成功的通道数
+	 */
+	uint32_t	enable_polling();
+
+	/*
+	 *	轮询所有轮询模式的交易通道一次，返回处理的事件数
+	 */
+	inline uint32_t poll()
+	{
+		uint32_t count = 0;
+		for (ITraderApi* api : _pollers)
+			count += api->poll();
+		return count;
+	}
+
 private:
 	TraderAdapterMap	_adapters;
+	std::vector<ITraderApi*>	_pollers;
 };
 
 NS_WTP_END
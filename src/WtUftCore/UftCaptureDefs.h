@@ -0,0 +1,199 @@
+﻿/*!
+ * \file UftCaptureDefs.h
+ * \project	WonderTrader
+ *
+ * \brief UFT实盘事件录制文件的数据结构定义
+ *
+ * 文件结构: CaptureFileHeader + N * (CaptureRecord + 数据)
+ * 所有输入事件按照到达顺序写入，回放时按照同样的顺序喂给引擎
+ */
+#pragma once
+#include <stdint.h>
+#include <string.h>
+#include "../Includes/WTSMarcos.h"
+
+namespace uft {
+
+#pragma pack(push, 1)
+
+	const char CAP_FLAG[] = "WTCAP!\0";
+
+	const uint32_t CAP_VERSION = 1;
+
+	const int TRADER_ID_LENGTH = 32;
+
+	typedef enum tagCaptureEventType
+	{
+		CET_Clock = 0,		//启动时钟，回放的时候用来初始化引擎时间
+		CET_Tick,			//tick数据
+		CET_OrdQue,			//委托队列
+		CET_OrdDtl,			//逐笔委托
+		CET_Trans,			//逐笔成交
+		CET_Timer,			//定时器触发的分钟闭合
+		CET_TrdEvent,		//交易通道连接事件
+		CET_TrdLogin,		//交易通道登录回报
+		CET_TrdEntrust,		//下单回报
+		CET_TrdAccounts,	//资金查询回报
+		CET_TrdPositions,	//持仓查询回报
+		CET_TrdOrders,		//订单查询回报
+		CET_TrdTrades,		//成交查询回报
+		CET_TrdOrder,		//订单推送
+		CET_TrdTrade		//成交推送
+	} CaptureEventType;
+
+	typedef struct _CaptureFileHeader
+	{
+		char		_flag[8];
+		uint32_t	_version;
+		uint32_t	_reserved;
+	} CaptureFileHeader;
+
+	//每条记录的头部，后面紧跟_len字节的数据
+	typedef struct _CaptureRecord
+	{
+		uint32_t	_type;
+		uint32_t	_len;
+		int64_t		_arrival;	//到达时间，纳秒
+	} CaptureRecord;
+
+	typedef struct _CapClock
+	{
+		uint32_t	_date;
+		uint32_t	_time;			//HHMMSSmmm
+		uint32_t	_order_seed;	//本地订单号种子
+		uint32_t	_reserved;
+	} CapClock;
+
+	typedef struct _CapTimer
+	{
+		uint32_t	_date;
+		uint32_t	_time;
+	} CapTimer;
+
+	typedef struct _CapTrdEvent
+	{
+		char		_trader[TRADER_ID_LENGTH];
+		uint32_t	_event;
+		int32_t		_ec;
+	} CapTrdEvent;
+
+	typedef struct _CapTrdLogin
+	{
+		char		_trader[TRADER_ID_LENGTH];
+		uint32_t	_success;
+		uint32_t	_tdate;
+		uint32_t	_features;	//通道特性，1-支持原生改单
+		uint32_t	_reserved;
+		char		_message[128];
+	} CapTrdLogin;
+
+	//交易回报的公共头部，后面紧跟_count个对应的结构体
+	typedef struct _CapTrdArray
+	{
+		char		_trader[TRADER_ID_LENGTH];
+		uint32_t	_count;
+		uint32_t	_reserved;
+	} CapTrdArray;
+
+	typedef struct _CapEntrust
+	{
+		char		_exchg[MAX_EXCHANGE_LENGTH];
+		char		_code[MAX_INSTRUMENT_LENGTH];
+		double		_volume;
+		double		_price;
+		uint32_t	_direct;
+		uint32_t	_price_type;
+		uint32_t	_order_flag;
+		uint32_t	_offset;
+		uint32_t	_business;
+		int32_t		_errcode;
+		char		_entrustid[64];
+		char		_usertag[64];
+		char		_errmsg[128];
+	} CapEntrust;
+
+	typedef struct _CapOrder
+	{
+		char		_exchg[MAX_EXCHANGE_LENGTH];
+		char		_code[MAX_INSTRUMENT_LENGTH];
+		double		_volume;
+		double		_price;
+		double		_traded;
+		double		_left;
+		uint32_t	_direct;
+		uint32_t	_price_type;
+		uint32_t	_order_flag;
+		uint32_t	_offset;
+		uint32_t	_business;
+		uint32_t	_state;
+		uint32_t	_order_type;
+		uint8_t		_is_error;
+		uint8_t		_is_net;
+		uint8_t		_is_buy;
+		uint8_t		_reserved;
+		uint32_t	_date;
+		uint64_t	_time;
+		char		_entrustid[64];
+		char		_orderid[64];
+		char		_usertag[64];
+		char		_statemsg[64];
+	} CapOrder;
+
+	typedef struct _CapTrade
+	{
+		char		_exchg[MAX_EXCHANGE_LENGTH];
+		char		_code[MAX_INSTRUMENT_LENGTH];
+		double		_volume;
+		double		_price;
+		double		_amount;
+		uint32_t	_direct;
+		uint32_t	_offset;
+		uint32_t	_order_type;
+		uint32_t	_trade_type;
+		uint32_t	_business;
+		uint8_t		_is_net;
+		uint8_t		_is_buy;
+		uint16_t	_reserved;
+		uint32_t	_date;
+		uint64_t	_time;
+		char		_tradeid[64];
+		char		_reforder[64];
+		char		_usertag[64];
+	} CapTrade;
+
+	typedef struct _CapPosition
+	{
+		char		_exchg[MAX_EXCHANGE_LENGTH];
+		char		_code[MAX_INSTRUMENT_LENGTH];
+		char		_currency[8];
+		uint32_t	_direct;
+		uint32_t	_business;
+		double		_prevol;
+		double		_newvol;
+		double		_preavail;
+		double		_newavail;
+		double		_cost;
+		double		_margin;
+		double		_avgpx;
+		double		_dynprofit;
+	} CapPosition;
+
+	typedef struct _CapAccount
+	{
+		char		_currency[8];
+		double		_balance;
+		double		_prebalance;
+		double		_margin;
+		double		_commission;
+		double		_frozen_margin;
+		double		_frozen_commission;
+		double		_close_profit;
+		double		_dynprofit;
+		double		_deposit;
+		double		_withdraw;
+		double		_available;
+	} CapAccount;
+
+#pragma pack(pop)
+
+} //namespace uft
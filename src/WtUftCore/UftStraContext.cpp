@@ -584,6 +584,8 @@ void UftStraContext::on_trade(uint32_t localid, const char* stdCode, bool isLong
 	}
 	*/
 
+	journal_positions();
+
 	if (_strategy)
 		_strategy->on_trade(this, localid, stdCode, isLong, offset, vol, price);
 }
@@ -871,6 +873,17 @@ OrderIDs UftStraContext::stra_cancel_all(const char* stdCode)
 	return _trader->cancelAll(stdCode);
 }
 
+uint32_t UftStraContext::stra_modify(uint32_t localid, double price, double qty)
+{
+	uint32_t newid = _trader->modify(localid, price, qty);
+
+	//模拟改单会重新下单, 新订单也要登记
+	if (newid != 0 && newid != localid)
+		_order_ids[newid] = NULL;
+
+	return newid;
+}
+
 OrderIDs UftStraContext::stra_buy(const char* stdCode, double price, double qty, int flag /* = 0 */)
 {
 	auto ids = _trader->buy(stdCode, price, qty, flag, false);
@@ -920,6 +933,18 @@ uint32_t UftStraContext::stra_exit_short(const char* stdCode, double price, doub
 	return localid;
 }
 
+uint32_t UftStraContext::stra_stage_order(const char* stdCode, bool isLong, bool isOpen, bool isToday /* = false */, int flag /* = 0 */)
+{
+	return _trader->stageOrder(stdCode, isLong, isOpen, isToday, flag);
+}
+
+uint32_t UftStraContext::stra_send_staged(uint32_t stageid, double price, double qty)
+{
+	uint32_t localid = _trader->sendStaged(stageid, price, qty);
+	_order_ids[localid] = NULL;
+	return localid;
+}
+
 WTSCommodityInfo* UftStraContext::stra_get_comminfo(const char* stdCode)
 {
 	return _engine->get_commodity_info(stdCode);
@@ -984,6 +1009,16 @@ WTSTickData* UftStraContext::stra_get_last_tick(const char* stdCode)
 	return _engine->get_last_tick(_context_id, stdCode);
 }
 
+const WTSOptGreeksStruct* UftStraContext::stra_get_greeks(const char* stdCode)
+{
+	return _engine->get_greeks(stdCode);
+}
+
+const WTSOptGreeksStruct* UftStraContext::stra_get_greeks_chain(const char* underlying, uint32_t& count)
+{
+	return _engine->get_greeks_chain(underlying, count);
+}
+
 void UftStraContext::stra_sub_ticks(const char* stdCode)
 {
 	_engine->sub_tick(id(), stdCode);
@@ -1023,6 +1058,62 @@ void UftStraContext::stra_log_error(const char* message)
 	WTSLogger::log_dyn_raw("strategy", _name.c_str(), LL_ERROR, message);
 }
 
+void UftStraContext::journal_positions()
+{
+	if (_pos_blk._block == NULL)
+		return;
+
+	SpinLock lock(_pos_blk._mutex);
+	std::size_t len = sizeof(uft::PositionBlock) + sizeof(uft::DetailStruct)*_pos_blk._block->_size;
+	_engine->journal_state(SRT_UftPosition, _name.c_str(), (const char*)_pos_blk._block, len);
+}
+
+void UftStraContext::restore_state(uint32_t rtype, const char* data, std::size_t len)
+{
+	if (rtype != SRT_UftPosition || _pos_blk._block == NULL || len < sizeof(uft::PositionBlock))
+		return;
+
+	const uft::PositionBlock* srcBlk = (const uft::PositionBlock*)data;
+	uint32_t count = (uint32_t)((len - sizeof(uft::PositionBlock)) / sizeof(uft::DetailStruct));
+	count = std::min(count, srcBlk->_size);
+
+	SpinLock lock(_pos_blk._mutex);
+	if (count > _pos_blk._block->_capacity)
+	{
+		WTSLogger::log_dyn("strategy", _name.c_str(), LL_ERROR, "Mirrored position details {} exceeds capacity {}, truncated", count, _pos_blk._block->_capacity);
+		count = _pos_blk._block->_capacity;
+	}
+
+	memcpy(_pos_blk._block->_details, srcBlk->_details, sizeof(uft::DetailStruct)*count);
+	_pos_blk._block->_size = count;
+	_pos_blk._block->_date = srcBlk->_date;
+
+	//按照load_local_data的逻辑重建持仓索引
+	_positions.clear();
+	for (uint32_t i = 0; i < count; i++)
+	{
+		uft::DetailStruct& ds = _pos_blk._block->_details[i];
+
+		WTSContractInfo* cInfo = _engine->get_basedata_mgr()->getContract(ds._code, ds._exchg);
+		if (cInfo == NULL)
+			continue;
+
+		PosInfo& posInfo = _positions[cInfo->getFullCode()];
+		posInfo._total_profit += ds._closed_profit;
+
+		if (decimal::eq(ds._volume, 0))
+			continue;
+
+		posInfo._dynprofit += ds._position_profit;
+		posInfo._opencost += ds._volume*ds._open_price*cInfo->getCommInfo()->getVolScale();
+		posInfo._volume += ds._volume*(ds._direct == 0 ? 1 : -1);
+
+		posInfo._details.emplace_back(&ds);
+	}
+
+	WTSLogger::log_dyn("strategy", _name.c_str(), LL_INFO, "{} position details restored from standby mirror", count);
+}
+
 void UftStraContext::load_local_data()
 {
 	if (_tradingday == 0)
@@ -66,6 +66,8 @@ public:
 
 	virtual void on_params_updated() override;
 
+	virtual void restore_state(uint32_t rtype, const char* data, std::size_t len) override;
+
 
 public:
 	//virtual void watch_param(const char* name, const char* val) override;
@@ -109,6 +111,8 @@ public:
 
 	virtual OrderIDs stra_cancel_all(const char* stdCode) override;
 
+	virtual uint32_t stra_modify(uint32_t localid, double price, double qty) override;
+
 	/*
 	 *	下单接口: 买入
 	 *
@@ -171,6 +175,10 @@ public:
 	 */
 	virtual uint32_t	stra_exit_short(const char* stdCode, double price, double qty, bool isToday = false, int flag = 0) override;
 
+	virtual uint32_t	stra_stage_order(const char* stdCode, bool isLong, bool isOpen, bool isToday = false, int flag = 0) override;
+
+	virtual uint32_t	stra_send_staged(uint32_t stageid, double price, double qty) override;
+
 	virtual WTSCommodityInfo* stra_get_comminfo(const char* stdCode) override;
 
 	virtual WTSKlineSlice* stra_get_bars(const char* stdCode, const char* period, uint32_t count) override;
@@ -185,6 +193,9 @@ public:
 
 	virtual WTSTickData* stra_get_last_tick(const char* stdCode) override;
 
+	virtual const WTSOptGreeksStruct* stra_get_greeks(const char* stdCode) override;
+	virtual const WTSOptGreeksStruct* stra_get_greeks_chain(const char* underlying, uint32_t& count) override;
+
 	virtual void stra_log_info(const char* message) override;
 	virtual void stra_log_debug(const char* message) override;
 	virtual void stra_log_error(const char* message) override;
@@ -284,6 +295,9 @@ private:
 
 	void	load_local_data();
 
+	//把持仓明细写入主备日志
+	void	journal_positions();
+
 	PosBlkPair		_pos_blk;
 	OrdBlkPair		_ord_blk;
 	TrdBlkPair		_trd_blk;
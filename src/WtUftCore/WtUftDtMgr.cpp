@@ -12,8 +12,10 @@
 #include "WtHelper.h"
 
 #include "../Share/StrUtil.hpp"
+#include "../Share/TimeUtils.hpp"
 #include "../Includes/WTSDataDef.hpp"
 #include "../Includes/WTSVariant.hpp"
+#include "../Includes/WTSSessionInfo.hpp"
 
 #include "../WTSTools/WTSLogger.h"
 #include "../WTSTools/WTSDataFactory.h"
@@ -21,23 +23,22 @@
 
 WTSDataFactory g_dataFact;
 
+const uint32_t DEF_CAP_TICKS = 4096;
+const uint32_t DEF_CAP_L2 = 16384;
+const uint32_t DEF_CAP_BARS = 1024;
+
 WtUftDtMgr::WtUftDtMgr()
 	: _engine(NULL)
-	, _bars_cache(NULL)
-	, _ticks_cache(NULL)
 	, _rt_tick_map(NULL)
+	, _cap_ticks(DEF_CAP_TICKS)
+	, _cap_l2(DEF_CAP_L2)
+	, _cap_bars(DEF_CAP_BARS)
 {
 }
 
 
 WtUftDtMgr::~WtUftDtMgr()
 {
-	if (_bars_cache)
-		_bars_cache->release();
-
-	if (_ticks_cache)
-		_ticks_cache->release();
-
 	if (_rt_tick_map)
 		_rt_tick_map->release();
 }
@@ -46,6 +47,20 @@ bool WtUftDtMgr::init(WTSVariant* cfg, WtUftEngine* engine)
 {
 	_engine = engine;
 
+	if (cfg)
+	{
+		if (cfg->has("cache_ticks"))
+			_cap_ticks = max(1U, cfg->getUInt32("cache_ticks"));
+
+		if (cfg->has("cache_l2"))
+			_cap_l2 = max(1U, cfg->getUInt32("cache_l2"));
+
+		if (cfg->has("cache_bars"))
+			_cap_bars = max(1U, cfg->getUInt32("cache_bars"));
+	}
+
+	WTSLogger::info("Rolling window capacity of UFT data manager: {} ticks, {} L2 items, {} bars", _cap_ticks, _cap_l2, _cap_bars);
+
 	return true;
 }
 
@@ -59,16 +74,180 @@ void WtUftDtMgr::handle_push_quote(const char* stdCode, WTSTickData* newTick)
 
 	_rt_tick_map->add(stdCode, newTick, true);
 
-	if(_ticks_cache != NULL)
 	{
-		WTSHisTickData* tData = (WTSHisTickData*)_ticks_cache->get(stdCode);
-		if (tData == NULL)
-			return;
+		SpinLock lock(_mtx_windows);
+		auto it = _tick_windows.find(stdCode);
+		if (it != _tick_windows.end())
+			it->second->push(newTick->getTickStruct());
+	}
+
+	BarNotices notices;
+	{
+		SpinLock lock(_mtx_bars);
+		//先把分钟结束时闭合的K线带上，保证策略回调都在行情线程里
+		if (!_pending_notices.empty())
+			notices.swap(_pending_notices);
+
+		auto it = _bar_windows.find(stdCode);
+		if (it != _bar_windows.end())
+			update_bars(stdCode, it->second, newTick, notices);
+	}
+	notify_bars(notices);
+}
+
+void WtUftDtMgr::handle_push_order_detail(const char* stdCode, WTSOrdDtlData* curOrdDtl)
+{
+	SpinLock lock(_mtx_windows);
+	auto it = _orddtl_windows.find(stdCode);
+	if (it != _orddtl_windows.end())
+		it->second->push(curOrdDtl->getOrdDtlStruct());
+}
+
+void WtUftDtMgr::handle_push_order_queue(const char* stdCode, WTSOrdQueData* curOrdQue)
+{
+	SpinLock lock(_mtx_windows);
+	auto it = _ordque_windows.find(stdCode);
+	if (it != _ordque_windows.end())
+		it->second->push(curOrdQue->getOrdQueStruct());
+}
+
+void WtUftDtMgr::handle_push_transaction(const char* stdCode, WTSTransData* curTrans)
+{
+	SpinLock lock(_mtx_windows);
+	auto it = _trans_windows.find(stdCode);
+	if (it != _trans_windows.end())
+		it->second->push(curTrans->getTransStruct());
+}
+
+void WtUftDtMgr::sub_ticks(const char* stdCode)
+{
+	SpinLock lock(_mtx_windows);
+	find_window(_tick_windows, stdCode, _cap_ticks);
+}
+
+void WtUftDtMgr::sub_order_details(const char* stdCode)
+{
+	SpinLock lock(_mtx_windows);
+	find_window(_orddtl_windows, stdCode, _cap_l2);
+}
+
+void WtUftDtMgr::sub_order_queues(const char* stdCode)
+{
+	SpinLock lock(_mtx_windows);
+	find_window(_ordque_windows, stdCode, _cap_l2);
+}
+
+void WtUftDtMgr::sub_transactions(const char* stdCode)
+{
+	SpinLock lock(_mtx_windows);
+	find_window(_trans_windows, stdCode, _cap_l2);
+}
+
+void WtUftDtMgr::update_bars(const char* stdCode, BarWindows& windows, WTSTickData* newTick, BarNotices& notices)
+{
+	double price = newTick->price();
+	for (BarWindowPtr& bwPtr : windows)
+	{
+		BarWindow* bw = bwPtr.get();
+		WTSBarStruct& bar = bw->_cur_bar;
+
+		uint32_t uDate = newTick->tradingdate();
+		uint64_t uBarTime = 0;
+		if (bw->_period == KP_Minute1)
+		{
+			//分钟线的时间标签和WTSDataFactory::updateMin1Data保持一致，用K线的结束时间
+			WTSSessionInfo* sInfo = bw->_s_info;
+			uint32_t uTime = newTick->actiontime() / 100000;
+			uint32_t uMinute = sInfo->timeToMinutes(uTime);
+			if (uMinute == INVALID_UINT32)
+			{
+				//非交易时间的tick，有成交才并到当前K线上
+				if (!bw->_has_cur || newTick->volume() == 0)
+					continue;
+
+				uBarTime = bar.time;
+				uDate = bar.date;
+			}
+			else
+			{
+				if (sInfo->isLastOfSection(uTime))
+					uMinute--;
+
+				uint32_t uBarMin = (uMinute / bw->_times)*bw->_times + bw->_times;
+				uint32_t uOnlyMin = sInfo->minuteToTime(uBarMin);
+				uint32_t uActDate = newTick->actiondate();
+				if (uOnlyMin == 0)
+					uActDate = TimeUtils::getNextDate(uActDate);
+				uBarTime = TimeUtils::timeToMinBar(uActDate, uOnlyMin);
+			}
+		}
 
-		if (tData->isValidOnly() && newTick->volume() == 0)
-			return;
+		if (bw->_has_cur && (uBarTime > bar.time || uDate > bar.date))
+			close_bar(stdCode, bw, notices);
 
-		tData->appendTick(newTick->getTickStruct());
+		if (!bw->_has_cur)
+		{
+			bar.date = uDate;
+			bar.time = uBarTime;
+			bar.open = price;
+			bar.high = price;
+			bar.low = price;
+			bar.close = price;
+			bar.settle = 0;
+			bar.vol = newTick->volume();
+			bar.money = newTick->turnover();
+			bar.hold = newTick->openinterest();
+			bar.add = newTick->additional();
+			bw->_has_cur = true;
+		}
+		else
+		{
+			bar.close = price;
+			bar.high = max(bar.high, price);
+			bar.low = min(bar.low, price);
+			bar.vol += newTick->volume();
+			bar.money += newTick->turnover();
+			bar.hold = newTick->openinterest();
+			bar.add += newTick->additional();
+		}
+	}
+}
+
+void WtUftDtMgr::close_bar(const char* stdCode, BarWindow* bw, BarNotices& notices)
+{
+	bw->_closed.push(bw->_cur_bar);
+	bw->_has_cur = false;
+
+	notices.emplace_back(BarNotice{ stdCode, bw->_period_s, bw->_times, bw->_cur_bar });
+}
+
+void WtUftDtMgr::notify_bars(const BarNotices& notices)
+{
+	//策略在on_bar里还会读K线，所以回调的时候不能持有锁
+	if (_engine == NULL)
+		return;
+
+	for (const BarNotice& item : notices)
+		_engine->on_bar(item._code.c_str(), item._period_s, item._times, (WTSBarStruct*)&item._bar);
+}
+
+void WtUftDtMgr::on_minute_end(uint32_t curDate, uint32_t curTime)
+{
+	if (curTime == 0)
+		curDate = TimeUtils::getNextDate(curDate);
+	uint64_t uBarTime = TimeUtils::timeToMinBar(curDate, curTime);
+
+	//定时器线程里不能回调策略，闭合的K线先挂起，下一笔tick到达时在行情线程里回调
+	SpinLock lock(_mtx_bars);
+	for (auto& v : _bar_windows)
+	{
+		const char* stdCode = v.first.c_str();
+		for (BarWindowPtr& bwPtr : v.second)
+		{
+			BarWindow* bw = bwPtr.get();
+			if (bw->_period == KP_Minute1 && bw->_has_cur && bw->_cur_bar.time <= uBarTime)
+				close_bar(stdCode, bw, _pending_notices);
+		}
 	}
 }
 
@@ -87,25 +266,92 @@ WTSTickData* WtUftDtMgr::grab_last_tick(const char* code)
 
 WTSTickSlice* WtUftDtMgr::get_tick_slice(const char* stdCode, uint32_t count, uint64_t etime /* = 0 */)
 {
-	return NULL;
+	SpinLock lock(_mtx_windows);
+	UftDataWindow<WTSTickStruct>* w = find_window(_tick_windows, stdCode, _cap_ticks);
+	WTSTickStruct* head = w->tail(count);
+	return WTSTickSlice::create(stdCode, head, count);
 }
 
 WTSOrdQueSlice* WtUftDtMgr::get_order_queue_slice(const char* stdCode, uint32_t count, uint64_t etime /* = 0 */)
 {
-	return NULL;
+	SpinLock lock(_mtx_windows);
+	UftDataWindow<WTSOrdQueStruct>* w = find_window(_ordque_windows, stdCode, _cap_l2);
+	WTSOrdQueStruct* head = w->tail(count);
+	return WTSOrdQueSlice::create(stdCode, head, count);
 }
 
 WTSOrdDtlSlice* WtUftDtMgr::get_order_detail_slice(const char* stdCode, uint32_t count, uint64_t etime /* = 0 */)
 {
-	return NULL;
+	SpinLock lock(_mtx_windows);
+	UftDataWindow<WTSOrdDtlStruct>* w = find_window(_orddtl_windows, stdCode, _cap_l2);
+	WTSOrdDtlStruct* head = w->tail(count);
+	return WTSOrdDtlSlice::create(stdCode, head, count);
 }
 
 WTSTransSlice* WtUftDtMgr::get_transaction_slice(const char* stdCode, uint32_t count, uint64_t etime /* = 0 */)
 {
-	return NULL;
+	SpinLock lock(_mtx_windows);
+	UftDataWindow<WTSTransStruct>* w = find_window(_trans_windows, stdCode, _cap_l2);
+	WTSTransStruct* head = w->tail(count);
+	return WTSTransSlice::create(stdCode, head, count);
 }
 
 WTSKlineSlice* WtUftDtMgr::get_kline_slice(const char* stdCode, WTSKlinePeriod period, uint32_t times, uint32_t count, uint64_t etime /* = 0 */)
 {
-	return NULL;
+	//统一成N分钟线和日线
+	if (period == KP_Minute5)
+	{
+		period = KP_Minute1;
+		times *= 5;
+	}
+
+	if (times == 0 || (period != KP_Minute1 && period != KP_DAY) || (period == KP_DAY && times != 1))
+	{
+		WTSLogger::error("Bars of {} with period {} and times {} not supported by UFT data manager", stdCode, (uint32_t)period, times);
+		return NULL;
+	}
+
+	SpinLock lock(_mtx_bars);
+	BarWindows& windows = _bar_windows[stdCode];
+	BarWindow* bw = NULL;
+	for (BarWindowPtr& bwPtr : windows)
+	{
+		if (bwPtr->_period == period && bwPtr->_times == times)
+		{
+			bw = bwPtr.get();
+			break;
+		}
+	}
+
+	if (bw == NULL)
+	{
+		WTSSessionInfo* sInfo = _engine->get_session_info(stdCode, true);
+		if (sInfo == NULL)
+		{
+			WTSLogger::error("Session of {} not found, bars not available", stdCode);
+			return NULL;
+		}
+
+		//K线只从第一次读取之后的tick开始生成
+		BarWindowPtr bwPtr(new BarWindow(_cap_bars));
+		bwPtr->_period = period;
+		bwPtr->_times = times;
+		bwPtr->_period_s = (period == KP_DAY) ? "d" : "m";
+		bwPtr->_s_info = sInfo;
+		windows.emplace_back(bwPtr);
+		bw = bwPtr.get();
+	}
+
+	//未闭合的K线作为最后一个数据块
+	//它在锁外还会被行情线程更新，所以带上未闭合K线的切片要在锁内拷贝一份
+	uint32_t closedCnt = (bw->_has_cur && count > 0) ? count - 1 : count;
+	WTSBarStruct* head = bw->_closed.tail(closedCnt);
+	WTSKlineSlice* slice = WTSKlineSlice::create(stdCode, period, times, head, closedCnt);
+	if (bw->_has_cur && count > 0)
+	{
+		slice->appendBlock(&bw->_cur_bar, 1);
+		slice->detach();
+	}
+
+	return slice;
 }
@@ -9,20 +9,84 @@
  */
 #pragma once
 #include <vector>
+#include <memory>
 #include "../Includes/IDataReader.h"
 #include "../Includes/IDataManager.h"
 
+#include "../Includes/WTSStruct.h"
 #include "../Includes/FasterDefs.h"
 #include "../Includes/WTSCollection.hpp"
+#include "../Share/SpinMutex.hpp"
 
 NS_WTP_BEGIN
 class WTSVariant;
 class WTSTickData;
 class WTSKlineSlice;
 class WTSTickSlice;
+class WTSOrdDtlData;
+class WTSOrdQueData;
+class WTSTransData;
 class IBaseDataMgr;
 class IBaseDataMgr;
 class WtUftEngine;
+class WTSSessionInfo;
+
+/*
+ *	定长滚动窗口
+ *	每条数据同时写入i和i+capacity两个位置，这样最近的任意n(n<=capacity)条数据都是一段连续内存
+ *	切片可以直接引用窗口内存，不需要拷贝，也不会再分配内存
+ *	切片引用的数据在后续capacity-n次写入以内保持有效
+ */
+template<typename T>
+class UftDataWindow
+{
+public:
+	UftDataWindow(uint32_t capacity) : _capacity(capacity), _pos(0), _size(0)
+	{
+		_data.resize((std::size_t)capacity * 2);
+	}
+
+	inline void push(const T& item)
+	{
+		_data[_pos] = item;
+		_data[_pos + _capacity] = item;
+		if (++_pos == _capacity)
+			_pos = 0;
+		if (_size < _capacity)
+			_size++;
+	}
+
+	/*
+	 *	最近count条数据的起始地址
+	 *	count会被修正为实际可用的条数
+	 */
+	inline T* tail(uint32_t& count)
+	{
+		count = std::min(count, _size);
+		if (count == 0)
+			return NULL;
+
+		return &_data[_pos + _capacity - count];
+	}
+
+	//最新一条数据
+	inline T* back()
+	{
+		if (_size == 0)
+			return NULL;
+
+		return &_data[_pos + _capacity - 1];
+	}
+
+	inline uint32_t size() const { return _size; }
+	inline uint32_t capacity() const { return _capacity; }
+
+private:
+	std::vector<T>	_data;
+	uint32_t		_capacity;
+	uint32_t		_pos;
+	uint32_t		_size;
+};
 
 class WtUftDtMgr : public IDataManager
 {
@@ -34,6 +98,24 @@ public:
 	bool	init(WTSVariant* cfg, WtUftEngine* engine);
 
 	void	handle_push_quote(const char* stdCode, WTSTickData* newTick);
+	void	handle_push_order_detail(const char* stdCode, WTSOrdDtlData* curOrdDtl);
+	void	handle_push_order_queue(const char* stdCode, WTSOrdQueData* curOrdQue);
+	void	handle_push_transaction(const char* stdCode, WTSTransData* curTrans);
+
+	/*
+	 *	策略订阅的时候就建立滚动窗口，订阅以后推送的数据都会进入窗口
+	 *	不然第一次读取的时候才建窗口，读到的永远是空的
+	 */
+	void	sub_ticks(const char* stdCode);
+	void	sub_order_details(const char* stdCode);
+	void	sub_order_queues(const char* stdCode);
+	void	sub_transactions(const char* stdCode);
+
+	/*
+	 *	分钟结束，闭合没有等到下一笔tick的K线
+	 *	可能在定时器线程里调用，这里只闭合K线，on_bar等下一笔tick在行情线程里再回调
+	 */
+	void	on_minute_end(uint32_t curDate, uint32_t curTime);
 
 	//////////////////////////////////////////////////////////////////////////
 	//IDataManager 接口
@@ -44,24 +126,76 @@ public:
 	virtual WTSKlineSlice* get_kline_slice(const char* stdCode, WTSKlinePeriod period, uint32_t times, uint32_t count, uint64_t etime = 0) override;
 	virtual WTSTickData* grab_last_tick(const char* stdCode) override;
 
+private:
+	typedef struct _BarWindow
+	{
+		WTSKlinePeriod	_period;	//只有KP_Minute1和KP_DAY
+		uint32_t		_times;
+		const char*		_period_s;
+		WTSSessionInfo*	_s_info;
+		WTSBarStruct	_cur_bar;	//未闭合的K线
+		bool			_has_cur;
+		UftDataWindow<WTSBarStruct>	_closed;
+
+		_BarWindow(uint32_t capacity) : _s_info(NULL), _has_cur(false), _closed(capacity){}
+	} BarWindow;
+	typedef std::shared_ptr<BarWindow> BarWindowPtr;
+	typedef std::vector<BarWindowPtr> BarWindows;
+
+	//闭合的K线先记下来，释放锁以后再回调策略
+	typedef struct _BarNotice
+	{
+		std::string		_code;
+		const char*		_period_s;
+		uint32_t		_times;
+		WTSBarStruct	_bar;	//回调可能推迟到下一笔tick，K线要拷贝下来
+	} BarNotice;
+	typedef std::vector<BarNotice> BarNotices;
+
+	void	update_bars(const char* stdCode, BarWindows& windows, WTSTickData* newTick, BarNotices& notices);
+	void	close_bar(const char* stdCode, BarWindow* bw, BarNotices& notices);
+	void	notify_bars(const BarNotices& notices);
+
+	template<typename T>
+	using DataWindowPtr = std::shared_ptr<UftDataWindow<T>>;
+
+	template<typename T>
+	using DataWindowMap = wt_hashmap<std::string, DataWindowPtr<T>>;
+
+	template<typename T>
+	static UftDataWindow<T>* find_window(DataWindowMap<T>& wMap, const char* stdCode, uint32_t capacity)
+	{
+		auto it = wMap.find(stdCode);
+		if (it != wMap.end())
+			return it->second.get();
+
+		//订阅或者第一次读取时建立窗口，之后只在推送数据时写入
+		DataWindowPtr<T> w(new UftDataWindow<T>(capacity));
+		wMap[stdCode] = w;
+		return w.get();
+	}
+
 private:
 	WtUftEngine*		_engine;
 
-	wt_hashset<std::string> _subed_basic_bars;
 	typedef WTSHashMap<std::string> DataCacheMap;
-	DataCacheMap*	_bars_cache;	//K线缓存
-	DataCacheMap*	_ticks_cache;	//历史Tick缓存
 	DataCacheMap*	_rt_tick_map;	//实时tick缓存
 
-	typedef struct _NotifyItem
-	{
-		std::string _code;
-		std::string _period;
-		uint32_t	_times;
-		WTSBarStruct* _newBar;
-	} NotifyItem;
+	uint32_t		_cap_ticks;		//tick窗口容量
+	uint32_t		_cap_l2;		//逐笔数据窗口容量
+	uint32_t		_cap_bars;		//K线窗口容量
+
+	//窗口在策略线程里建立，在行情线程里写入，查找和写入都要加锁
+	SpinMutex						_mtx_windows;
+	DataWindowMap<WTSTickStruct>	_tick_windows;
+	DataWindowMap<WTSOrdDtlStruct>	_orddtl_windows;
+	DataWindowMap<WTSOrdQueStruct>	_ordque_windows;
+	DataWindowMap<WTSTransStruct>	_trans_windows;
 
-	std::vector<NotifyItem> _bar_notifies;
+	//K线在行情线程和定时器线程里都会闭合，也要加锁
+	SpinMutex							_mtx_bars;
+	wt_hashmap<std::string, BarWindows>	_bar_windows;
+	BarNotices							_pending_notices;	//分钟结束时闭合的K线，等行情线程回调
 };
 
 NS_WTP_END
\ No newline at end of file
@@ -14,6 +14,8 @@
 #include "WtUftDtMgr.h"
 #include "TraderAdapter.h"
 #include "WtHelper.h"
+#include "EventCapture.h"
+#include "EventNotifier.h"
 
 #include "../Share/decimal.h"
 #include "../Share/StrUtil.hpp"
@@ -31,6 +33,8 @@ WtUftEngine::WtUftEngine()
 	: _cfg(NULL)
 	, _tm_ticker(NULL)
 	, _notifier(NULL)
+	, _standby(NULL)
+	, _capture(NULL)
 {
 	TimeUtils::getDateTime(_cur_date, _cur_time);
 	_cur_secs = _cur_time % 100000;
@@ -108,7 +112,6 @@ WTSSessionInfo* WtUftEngine::get_session_info(const char* sid, bool isCode /* =
 
 WTSTickSlice* WtUftEngine::get_tick_slice(uint32_t sid, const char* code, uint32_t count)
 {
-	return NULL;
 	return _data_mgr->get_tick_slice(code, count);
 }
 
@@ -119,16 +122,11 @@ WTSTickData* WtUftEngine::get_last_tick(uint32_t sid, const char* stdCode)
 
 WTSKlineSlice* WtUftEngine::get_kline_slice(uint32_t sid, const char* stdCode, const char* period, uint32_t count, uint32_t times /* = 1 */, uint64_t etime /* = 0 */)
 {
-	return NULL;
-	WTSCommodityInfo* cInfo = _base_data_mgr->getCommodity(stdCode);
-	if (cInfo == NULL)
-		return NULL;
-
-	WTSSessionInfo* sInfo = cInfo->getSessionInfo();
-
 	std::string key = fmt::format("{}-{}-{}", stdCode, period, times);
-	SubList& sids = _bar_sub_map[key];
-	sids.insert(sid);
+	{
+		SpinLock lock(_mtx_bar_sub);
+		_bar_sub_map[key].insert(sid);
+	}
 
 	WTSKlinePeriod kp;
 	if (strcmp(period, "m") == 0)
@@ -153,6 +151,9 @@ void WtUftEngine::sub_tick(uint32_t sid, const char* stdCode)
 {
 	SubList& sids = _tick_sub_map[stdCode];
 	sids.insert(sid);
+
+	if (_data_mgr)
+		_data_mgr->sub_ticks(stdCode);
 }
 
 double WtUftEngine::get_cur_price(const char* stdCode)
@@ -187,9 +188,43 @@ void WtUftEngine::init(WTSVariant* cfg, IBaseDataMgr* bdMgr, WtUftDtMgr* dataMgr
 
 	_cfg = cfg;
 	if(_cfg) _cfg->retain();
+
+	//UFT的tick和逐笔切片直接引用行情线程写入的滚动窗口，不做拷贝，只能在行情线程里读，策略不能迁移到别的线程，慢策略只告警
+	if (_cfg && _profiler.init(_cfg->get("profiler"), false))
+	{
+		WTSLogger::info("Strategy profiler enabled, slow threshold {}us", _profiler.threshold_us());
+	}
+
+	if (_cfg && _greeks.init(_cfg->get("greeks"), bdMgr))
+		WTSLogger::info("Option greeks service enabled, {} options in {} chains", _greeks.option_count(), _greeks.chain_count());
+}
+
+void WtUftEngine::report_profiles()
+{
+	static StraProfiler::ProfileReports reports;
+	reports.clear();
+	if (!_profiler.collect(reports))
+		return;
+
+	for (const StraProfiler::ProfileReport& r : reports)
+	{
+		if (r._action == StraProfiler::PA_None)
+		{
+			WTSLogger::debug("[{}] {} callbacks: {} calls, avg {:.1f}us, p50 {:.1f}us, p99 {:.1f}us, max {:.1f}us, cpu {:.1f}us",
+				r._stra, profile_callback_name(r._cb_type), r._count, r._avg_us, r._p50_us, r._p99_us, r._max_us, r._cpu_us);
+		}
+		else
+		{
+			WTSLogger::warn("[{}] {} callbacks too slow for {} windows: {} calls, avg {:.1f}us, p99 {:.1f}us, max {:.1f}us",
+				r._stra, profile_callback_name(r._cb_type), r._slow_windows, r._count, r._avg_us, r._p99_us, r._max_us);
+		}
+
+		if (_notifier)
+			_notifier->notify_log("PROFILE", StraProfiler::to_json(r).c_str());
+	}
 }
 
-void WtUftEngine::run()
+void WtUftEngine::run(bool bReplay /* = false */)
 {
 	for (auto it = _ctx_map.begin(); it != _ctx_map.end(); it++)
 	{
@@ -208,18 +243,35 @@ void WtUftEngine::run()
 		_tm_ticker->init("ALLDAY");
 	}
 
-	_tm_ticker->run();
+	_tm_ticker->run(bReplay);
+}
+
+void WtUftEngine::replay_timer()
+{
+	if (_tm_ticker)
+		_tm_ticker->fire_minute_end();
 }
 
 void WtUftEngine::handle_push_quote(WTSTickData* newTick)
 {
+	StdSharedLock gate(_mtx_dispatch);
+	if (_capture)
+		_capture->record_tick(newTick);
+
 	if (_tm_ticker)
 		_tm_ticker->on_tick(newTick);
 }
 
 void WtUftEngine::handle_push_order_detail(WTSOrdDtlData* curOrdDtl)
 {
+	StdSharedLock gate(_mtx_dispatch);
+	if (_capture)
+		_capture->record_order_detail(curOrdDtl);
+
 	const char* stdCode = curOrdDtl->code();
+	if (_data_mgr)
+		_data_mgr->handle_push_order_detail(stdCode, curOrdDtl);
+
 	auto sit = _orddtl_sub_map.find(stdCode);
 	if (sit != _orddtl_sub_map.end())
 	{
@@ -234,6 +286,7 @@ void WtUftEngine::handle_push_order_detail(WTSOrdDtlData* curOrdDtl)
 			if (cit != _ctx_map.end())
 			{
 				UftContextPtr& ctx = (UftContextPtr&)cit->second;
+				StraProfileScope scope(_profiler, _profiler.find(sid), PCB_L2);
 				ctx->on_order_detail(stdCode, curOrdDtl);
 			}
 		}
@@ -242,7 +295,14 @@ void WtUftEngine::handle_push_order_detail(WTSOrdDtlData* curOrdDtl)
 
 void WtUftEngine::handle_push_order_queue(WTSOrdQueData* curOrdQue)
 {
+	StdSharedLock gate(_mtx_dispatch);
+	if (_capture)
+		_capture->record_order_queue(curOrdQue);
+
 	const char* stdCode = curOrdQue->code();
+	if (_data_mgr)
+		_data_mgr->handle_push_order_queue(stdCode, curOrdQue);
+
 	auto sit = _ordque_sub_map.find(stdCode);
 	if (sit != _ordque_sub_map.end())
 	{
@@ -257,6 +317,7 @@ void WtUftEngine::handle_push_order_queue(WTSOrdQueData* curOrdQue)
 			if (cit != _ctx_map.end())
 			{
 				UftContextPtr& ctx = (UftContextPtr&)cit->second;
+				StraProfileScope scope(_profiler, _profiler.find(sid), PCB_L2);
 				ctx->on_order_queue(stdCode, curOrdQue);
 			}
 		}
@@ -265,7 +326,14 @@ void WtUftEngine::handle_push_order_queue(WTSOrdQueData* curOrdQue)
 
 void WtUftEngine::handle_push_transaction(WTSTransData* curTrans)
 {
+	StdSharedLock gate(_mtx_dispatch);
+	if (_capture)
+		_capture->record_transaction(curTrans);
+
 	const char* stdCode = curTrans->code();
+	if (_data_mgr)
+		_data_mgr->handle_push_transaction(stdCode, curTrans);
+
 	auto sit = _trans_sub_map.find(stdCode);
 	if (sit != _trans_sub_map.end())
 	{
@@ -280,6 +348,7 @@ void WtUftEngine::handle_push_transaction(WTSTransData* curTrans)
 			if (cit != _ctx_map.end())
 			{
 				UftContextPtr& ctx = (UftContextPtr&)cit->second;
+				StraProfileScope scope(_profiler, _profiler.find(sid), PCB_L2);
 				ctx->on_transaction(stdCode, curTrans);
 			}
 		}
@@ -290,18 +359,27 @@ void WtUftEngine::sub_order_detail(uint32_t sid, const char* stdCode)
 {
 	SubList& sids = _orddtl_sub_map[stdCode];
 	sids.insert(sid);
+
+	if (_data_mgr)
+		_data_mgr->sub_order_details(stdCode);
 }
 
 void WtUftEngine::sub_order_queue(uint32_t sid, const char* stdCode)
 {
 	SubList& sids = _ordque_sub_map[stdCode];
 	sids.insert(sid);
+
+	if (_data_mgr)
+		_data_mgr->sub_order_queues(stdCode);
 }
 
 void WtUftEngine::sub_transaction(uint32_t sid, const char* stdCode)
 {
 	SubList& sids = _trans_sub_map[stdCode];
 	sids.insert(sid);
+
+	if (_data_mgr)
+		_data_mgr->sub_transactions(stdCode);
 }
 
 void WtUftEngine::on_session_begin()
@@ -311,6 +389,7 @@ void WtUftEngine::on_session_begin()
 	for (auto it = _ctx_map.begin(); it != _ctx_map.end(); it++)
 	{
 		UftContextPtr& ctx = (UftContextPtr&)it->second;
+		StraProfileScope scope(_profiler, _profiler.find(ctx->id()), PCB_Event);
 		ctx->on_session_begin(_cur_tdate);
 	}
 }
@@ -320,6 +399,7 @@ void WtUftEngine::on_session_end()
 	for (auto it = _ctx_map.begin(); it != _ctx_map.end(); it++)
 	{
 		UftContextPtr& ctx = (UftContextPtr&)it->second;
+		StraProfileScope scope(_profiler, _profiler.find(ctx->id()), PCB_Event);
 		ctx->on_session_end(_cur_tdate);
 	}
 
@@ -331,6 +411,9 @@ void WtUftEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 	if(_data_mgr)
 		_data_mgr->handle_push_quote(stdCode, curTick);
 
+	//先更新希腊字母，策略在on_tick里读到的就是最新的
+	_greeks.on_tick(stdCode, curTick);
+
 	{
 		auto sit = _tick_sub_map.find(stdCode);
 		if (sit != _tick_sub_map.end())
@@ -344,6 +427,7 @@ void WtUftEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 				if (cit != _ctx_map.end())
 				{
 					UftContextPtr& ctx = (UftContextPtr&)cit->second;
+					StraProfileScope scope(_profiler, _profiler.find(sid), PCB_Tick);
 					ctx->on_tick(stdCode, curTick);
 				}
 			}
@@ -354,7 +438,16 @@ void WtUftEngine::on_tick(const char* stdCode, WTSTickData* curTick)
 void WtUftEngine::on_bar(const char* stdCode, const char* period, uint32_t times, WTSBarStruct* newBar)
 {
 	std::string key = fmt::format("{}-{}-{}", stdCode, period, times);
-	const SubList& sids = _bar_sub_map[key];
+	SubList sids;
+	{
+		SpinLock lock(_mtx_bar_sub);
+		auto sit = _bar_sub_map.find(key);
+		if (sit == _bar_sub_map.end())
+			return;
+
+		sids = sit->second;
+	}
+
 	for (auto it = sids.begin(); it != sids.end(); it++)
 	{
 		uint32_t sid = *it;
@@ -362,6 +455,7 @@ void WtUftEngine::on_bar(const char* stdCode, const char* period, uint32_t times
 		if (cit != _ctx_map.end())
 		{
 			UftContextPtr& ctx = (UftContextPtr&)cit->second;
+			StraProfileScope scope(_profiler, _profiler.find(sid), PCB_Bar);
 			ctx->on_bar(stdCode, period, times, newBar);
 		}
 	}
@@ -369,13 +463,43 @@ void WtUftEngine::on_bar(const char* stdCode, const char* period, uint32_t times
 
 void WtUftEngine::on_minute_end(uint32_t curDate, uint32_t curTime)
 {
+	report_profiles();
 
+	if (_data_mgr)
+		_data_mgr->on_minute_end(curDate, curTime);
 }
 
 void WtUftEngine::addContext(UftContextPtr ctx)
 {
 	uint32_t sid = ctx->id();
 	_ctx_map[sid] = ctx;
+	_profiler.add_strategy(sid, ctx->name());
+}
+
+void WtUftEngine::journal_state(uint32_t rtype, const char* key, const char* data, std::size_t len)
+{
+	if (_standby && _standby->is_leader())
+		_standby->append(rtype, key, data, len);
+}
+
+void WtUftEngine::on_takeover(ShmStandby* standby)
+{
+	standby->enum_latest([this](uint32_t rtype, const char* key, const char* data, std::size_t len) {
+		if (rtype != SRT_UftPosition)
+			return;
+
+		for (auto it = _ctx_map.begin(); it != _ctx_map.end(); it++)
+		{
+			UftContextPtr& ctx = it->second;
+			if (strcmp(ctx->name(), key) == 0)
+			{
+				ctx->restore_state(rtype, data, len);
+				break;
+			}
+		}
+	});
+
+	WTSLogger::info("UFT engine took over with {} strategies", _ctx_map.size());
 }
 
 UftContextPtr WtUftEngine::getContext(uint32_t id)
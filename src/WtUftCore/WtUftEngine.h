@@ -19,9 +19,13 @@
 #include "../Includes/RiskMonDefs.h"
 
 #include "../Share/StdUtils.hpp"
+#include "../Share/SpinMutex.hpp"
 #include "../Share/DLLHelper.hpp"
 
 #include "../Share/BoostFile.hpp"
+#include "../Share/ShmStandby.hpp"
+#include "../Share/StraProfiler.hpp"
+#include "../Share/OptionGreeks.hpp"
 
 #include "../Includes/IUftStraCtx.h"
 
@@ -45,6 +49,7 @@ class WtUftDtMgr;
 class TraderAdapterMgr;
 
 class EventNotifier;
+class EventCapture;
 
 typedef std::function<void()>	TaskItem;
 
@@ -64,6 +69,38 @@ public:
 public:
 	inline void set_adapter_mgr(TraderAdapterMgr* mgr) { _adapter_mgr = mgr; }
 
+	inline void set_standby(ShmStandby* standby) { _standby = standby; }
+
+	/*
+	 *	写入主备状态日志，只有主进程会真正写入
+	 *	@rtype	记录类型，见StandbyRecordType
+	 *	@key	状态的key，一般是策略名称
+	 */
+	void journal_state(uint32_t rtype, const char* key, const char* data, std::size_t len);
+
+	/*
+	 *	数据分发闸门，行情和定时器分发时持有共享锁
+	 *	主备接管时持有独占锁，保证接管期间没有解析器线程和定时器线程在改写持仓和策略状态
+	 */
+	inline StdSharedMutex& dispatch_gate() { return _mtx_dispatch; }
+
+	/*
+	 *	备进程接管，用镜像的最新状态覆盖本地状态
+	 *	调用方需要先持有dispatch_gate的独占锁
+	 */
+	void on_takeover(ShmStandby* standby);
+
+	/*
+	 *	设置事件录制器，所有输入事件都会按到达顺序录制下来
+	 */
+	inline void set_capture(EventCapture* capture) { _capture = capture; }
+	inline EventCapture* get_capture() { return _capture; }
+
+	/*
+	 *	回放录制的定时器事件，触发一次分钟闭合
+	 */
+	void replay_timer();
+
 	void set_date_time(uint32_t curDate, uint32_t curTime, uint32_t curSecs = 0, uint32_t rawTime = 0);
 
 	void set_trading_date(uint32_t curTDate);
@@ -92,7 +129,11 @@ public:
 public:
 	void init(WTSVariant* cfg, IBaseDataMgr* bdMgr, WtUftDtMgr* dataMgr, EventNotifier* notifier);
 
-	void run();
+	/*
+	 *	启动引擎
+	 *	@bReplay	回放模式，不启动实时定时线程，分钟闭合由录制的定时器事件驱动
+	 */
+	void run(bool bReplay = false);
 
 	void on_tick(const char* stdCode, WTSTickData* curTick);
 
@@ -114,6 +155,9 @@ public:
 	WTSOrdDtlSlice* get_order_detail_slice(uint32_t sid, const char* stdCode, uint32_t count);
 	WTSTransSlice* get_transaction_slice(uint32_t sid, const char* stdCode, uint32_t count);
 
+	inline const WTSOptGreeksStruct* get_greeks(const char* stdCode) const { return _greeks.get_greeks(stdCode); }
+	inline const WTSOptGreeksStruct* get_greeks_chain(const char* underlying, uint32_t& count) const { return _greeks.get_chain(underlying, count); }
+
 public:
 	void on_minute_end(uint32_t curDate, uint32_t curTime);
 
@@ -125,6 +169,13 @@ public:
 	void sub_order_detail(uint32_t sid, const char* stdCode);
 	void sub_transaction(uint32_t sid, const char* stdCode);
 
+private:
+	/*
+	 *	汇总策略回调耗时，到了统计窗口才会真正输出
+	 *	只在分钟闭合的时候调用，不放在tick的路径上，统计窗口小于1分钟时按分钟输出
+	 */
+	void report_profiles();
+
 private:
 	uint32_t		_cur_date;	//当前日期
 	uint32_t		_cur_time;		//当前时间, 是1分钟线时间, 比如0900, 这个时候的1分钟线是0901, _cur_time也就是0901, 这个是为了CTA里面方便
@@ -144,6 +195,7 @@ private:
 	StraSubMap		_orddtl_sub_map;	//委托明细订阅表
 	StraSubMap		_trans_sub_map;		//成交明细订阅表
 	StraSubMap		_bar_sub_map;	//K线数据订阅表	
+	SpinMutex		_mtx_bar_sub;	//K线订阅在策略调用的线程里登记，在行情线程里读取
 
 	TraderAdapterMgr*	_adapter_mgr;
 
@@ -156,6 +208,13 @@ private:
 	bool			_dependent;	//子策略独立记账
 
 	EventNotifier*	_notifier;
+
+	ShmStandby*		_standby;	//主备热切换组件
+	StdSharedMutex	_mtx_dispatch;	//数据分发闸门
+	EventCapture*	_capture;	//输入事件录制器
+
+	StraProfiler	_profiler;	//策略回调耗时统计
+	OptionGreeksSvc	_greeks;	//期权希腊字母服务
 };
 
 NS_WTP_END
\ No newline at end of file
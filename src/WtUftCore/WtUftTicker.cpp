@@ -9,6 +9,7 @@
  */
 #include "WtUftTicker.h"
 #include "WtUftEngine.h"
+#include "EventCapture.h"
 #include "../Includes/IDataReader.h"
 
 #include "../Share/TimeUtils.hpp"
@@ -21,13 +22,15 @@ USING_NS_WTP;
 
 
 WtUftRtTicker::WtUftRtTicker(WtUftEngine* engine)
-	: _engine(engine)
-	, _stopped(false)
+	: _s_info(NULL)
+	, _engine(engine)
 	, _date(0)
 	, _time(UINT_MAX)
+	, _cur_pos(0)
 	, _next_check_time(0)
 	, _last_emit_pos(0)
-	, _cur_pos(0)
+	, _stopped(false)
+	, _replay(false)
 {
 }
 
@@ -45,7 +48,7 @@ void WtUftRtTicker::init(const char* sessionID)
 
 void WtUftRtTicker::on_tick(WTSTickData* curTick)
 {
-	if (_thrd == NULL)
+	if (_thrd == NULL && !_replay)
 	{
 		if (_engine)
 			_engine->on_tick(curTick->code(), curTick);
@@ -126,11 +129,18 @@ void WtUftRtTicker::on_tick(WTSTickData* curTick)
 	_next_check_time = TimeUtils::getLocalTimeNow() + left_ticks;
 }
 
-void WtUftRtTicker::run()
+void WtUftRtTicker::run(bool bReplay /* = false */)
 {
-	if (_thrd)
+	if (_thrd || _replay)
 		return;
 
+	if (bReplay)
+	{
+		_replay = true;
+		_date = _engine->get_date();
+		_time = _engine->get_raw_time() * 100000 + _engine->get_secs();
+	}
+
 	_engine->on_init();
 
 	uint32_t curTDate = _engine->get_basedata_mgr()->calcTradingDate(_s_info->id(), _engine->get_date(), _engine->get_min_time(), true);
@@ -138,6 +148,9 @@ void WtUftRtTicker::run()
 
 	_engine->on_session_begin();
 
+	if (_replay)
+		return;
+
 	//先检查当前时间, 如果大于
 	uint32_t offTime = _s_info->offsetTime(_engine->get_min_time(), true);
 
@@ -150,43 +163,7 @@ void WtUftRtTicker::run()
 				uint64_t now = TimeUtils::getLocalTimeNow();
 
 				if (now >= _next_check_time && _last_emit_pos < _cur_pos)
-				{
-					//触发数据回放模块
-					StdUniqueLock lock(_mtx);
-
-					//优先修改时间标记
-					_last_emit_pos = _cur_pos;
-
-					uint32_t thisMin = _s_info->minuteToTime(_cur_pos);
-					_time = thisMin;
-
-					//如果thisMin是0, 说明换日了
-					//这里是本地计时导致的换日, 说明日期其实还是老日期, 要自动+1
-					//同时因为时间是235959xxx, 所以也要手动置为0
-					if (thisMin == 0)
-					{
-						uint32_t lastDate = _date;
-						_date = TimeUtils::getNextDate(_date);
-						_time = 0;
-						WTSLogger::info("Data automatically changed at time 00:00: {} -> {}", lastDate, _date);
-					}
-
-					WTSLogger::info("Minute bar {}.{:04d} closed automatically", _date, thisMin);
-					//if (_store)
-					//	_store->onMinuteEnd(_date, thisMin);
-
-					_engine->on_minute_end(_date, thisMin);
-
-					uint32_t offMin = _s_info->offsetTime(thisMin, true);
-					if (offMin >= _s_info->getCloseTime(true))
-					{
-						_engine->on_session_end();
-					}
-
-					//145959000
-					if (_engine)
-						_engine->set_date_time(_date, thisMin, 0);
-				}
+					fire_minute_end();
 			}
 			else //if (offTime >= _s_info->getOpenTime(true) && offTime <= _s_info->getCloseTime(true))
 			{
@@ -199,6 +176,52 @@ void WtUftRtTicker::run()
 	}));
 }
 
+void WtUftRtTicker::fire_minute_end()
+{
+	//先进闸门再拿_mtx，和解析器线程的加锁顺序保持一致
+	StdSharedLock gate(_engine->dispatch_gate());
+	//触发数据回放模块
+	StdUniqueLock lock(_mtx);
+
+	//优先修改时间标记
+	_last_emit_pos = _cur_pos;
+
+	uint32_t thisMin = _s_info->minuteToTime(_cur_pos);
+	_time = thisMin;
+
+	//如果thisMin是0, 说明换日了
+	//这里是本地计时导致的换日, 说明日期其实还是老日期, 要自动+1
+	//同时因为时间是235959xxx, 所以也要手动置为0
+	if (thisMin == 0)
+	{
+		uint32_t lastDate = _date;
+		_date = TimeUtils::getNextDate(_date);
+		_time = 0;
+		WTSLogger::info("Data automatically changed at time 00:00: {} -> {}", lastDate, _date);
+	}
+
+	//本地计时的触发时机取决于墙上时钟，回放的时候没法重新推算，所以要录制下来
+	EventCapture* capture = _engine->get_capture();
+	if (capture)
+		capture->record_timer(_date, thisMin);
+
+	WTSLogger::info("Minute bar {}.{:04d} closed automatically", _date, thisMin);
+	//if (_store)
+	//	_store->onMinuteEnd(_date, thisMin);
+
+	_engine->on_minute_end(_date, thisMin);
+
+	uint32_t offMin = _s_info->offsetTime(thisMin, true);
+	if (offMin >= _s_info->getCloseTime(true))
+	{
+		_engine->on_session_end();
+	}
+
+	//145959000
+	if (_engine)
+		_engine->set_date_time(_date, thisMin, 0);
+}
+
 void WtUftRtTicker::stop()
 {
 	_stopped = true;
@@ -31,9 +31,18 @@ public:
 	void	init(const char* sessionID);
 	void	on_tick(WTSTickData* curTick);
 
-	void	run();
+	/*
+	 *	@bReplay	回放模式，不启动定时线程，时间从引擎读取
+	 */
+	void	run(bool bReplay = false);
 	void	stop();
 
+	/*
+	 *	本地计时触发分钟闭合
+	 *	实盘由定时线程调用，回放时由录制的定时器事件调用
+	 */
+	void	fire_minute_end();
+
 private:
 	WTSSessionInfo*	_s_info;
 	WtUftEngine*	_engine;
@@ -48,6 +57,7 @@ private:
 	std::atomic<uint32_t>	_last_emit_pos;
 
 	bool			_stopped;
+	bool			_replay;
 	StdThreadPtr	_thrd;
 };
 
@@ -21,6 +21,7 @@
 #include "../WtUftCore/ParserAdapter.h"
 #include "../WtUftCore/WtUftDtMgr.h"
 #include "../WtUftCore/ActionPolicyMgr.h"
+#include "../WtUftCore/EventCapture.h"
 
 #include "../WTSTools/WTSHotMgr.h"
 #include "../WTSTools/WTSBaseDataMgr.h"
@@ -52,6 +53,26 @@ private:
 	bool initEvtNotifier();
 	bool initEngine();
 
+	/*
+	 *	初始化主备热切换
+	 *	standby: {active, name, primary, timeout, heartbeat, capacity}
+	 */
+	bool initStandby();
+
+	/*
+	 *	初始化事件录制
+	 *	capture: {active, path, flush}
+	 */
+	bool initCapture();
+
+	/*
+	 *	初始化轮询模式
+	 *	poll: {active, core}
+	 *	行情和交易通道切换到轮询模式，run的线程绑定到指定的核心上循环轮询，
+	 *	行情处理、策略回调和下单都在这个线程里同步完成
+	 */
+	bool initPolling();
+
 //////////////////////////////////////////////////////////////////////////
 //ILogHandler
 public:
@@ -73,6 +94,15 @@ private:
 
 	ActionPolicyMgr		_act_policy;
 
+	ShmStandby			_standby;
+
+	EventCapture		_capture;
+	EventReplayer		_replayer;
+	bool				_replay_mode;	//回放模式，不连接行情和交易通道，所有事件来自录制文件
+
+	bool				_poll_mode;		//轮询模式
+	int32_t				_poll_core;		//轮询线程绑定的核心，小于0不绑定
+
 	bool				_to_exit;
 };
 